@@ -0,0 +1,1042 @@
+//
+// Copyright (c) 2024 Mackenzie High. All rights reserved.
+//
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/tree.h"
+
+/**
+ * Obtains the monotonic current time in nanoseconds.
+ */
+static int64_t bench_monotonic ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * (int64_t) 1000000000LL + (int64_t) ts.tv_nsec;
+}
+
+/**
+ * Fast deterministic pseudo-random number generator (xorshift64*).
+ */
+static uint64_t bench_random (uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * UINT64_C(2685821657736338717);
+}
+
+/**
+ * Prints one line of results, where count is the number of operations performed.
+ */
+static void bench_report (const char* name, size_t count, int64_t start, int64_t end)
+{
+    const double elapsed = ((double) (end - start)) / 1e9;
+    const double per_op = count == 0 ? 0 : ((double) (end - start)) / (double) count;
+    printf("%-40s %12zu ops %10.4f seconds %10.1f ns/op\n", name, count, elapsed, per_op);
+}
+
+/**
+ * Creates count random key-value pairs, which contain some duplicate keys.
+ */
+static void bench_random_pairs (size_t count, key_t* keys, data_t* values)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = (key_t) bench_random(&state);
+        values[i] = (data_t) i;
+    }
+}
+
+static void bench_put_loop (size_t count, key_t* keys, data_t* values)
+{
+    tree_t* p = tree_new();
+    {
+        const int64_t start = bench_monotonic();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            tree_put(p, keys[i], values[i]);
+        }
+
+        bench_report("put (loop, unsorted)", count, start, bench_monotonic());
+    }
+    tree_free(p);
+}
+
+static void bench_putArrays (size_t count, key_t* keys, data_t* values)
+{
+    tree_t* p = tree_new();
+    {
+        const int64_t start = bench_monotonic();
+        tree_putArrays(p, keys, values, count);
+        bench_report("putArrays (unsorted)", count, start, bench_monotonic());
+    }
+    tree_free(p);
+}
+
+static void bench_putArraysParallel (size_t count, key_t* keys, data_t* values, size_t threads)
+{
+    tree_t* p = tree_new();
+    {
+        const int64_t start = bench_monotonic();
+        tree_putArraysParallel(p, keys, values, count, threads);
+        bench_report("putArraysParallel (unsorted)", count, start, bench_monotonic());
+    }
+    tree_free(p);
+}
+
+/**
+ * Fills a batch with sorted operations on distinct keys, where every fourth operation is a remove.
+ */
+static void bench_sorted_batch (uint64_t* state, tree_op_t* ops, size_t batch_size)
+{
+    const uint64_t stride = UINT32_MAX / (batch_size + 1);
+    key_t key = (key_t) INT32_MIN + (key_t) (bench_random(state) % stride);
+
+    for (size_t i = 0; i < batch_size; i++)
+    {
+        ops[i].remove = (i % 4) == 3;
+        ops[i].key = key;
+        ops[i].value = (data_t) i;
+        key += 1 + (key_t) (bench_random(state) % stride);
+    }
+}
+
+static void bench_applyBatch (size_t count, key_t* keys, data_t* values, size_t batch_size)
+{
+    const size_t batches = 20;
+    tree_op_t* ops = calloc(batch_size, sizeof(tree_op_t));
+    char name[64];
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        tree_putArrays(p, keys, values, count);
+        tree_putArrays(q, keys, values, count);
+
+        uint64_t state = 42;
+        int64_t elapsed = 0;
+
+        for (size_t b = 0; b < batches; b++)
+        {
+            bench_sorted_batch(&state, ops, batch_size);
+            const int64_t start = bench_monotonic();
+
+            for (size_t i = 0; i < batch_size; i++)
+            {
+                if (ops[i].remove)
+                {
+                    tree_remove(p, ops[i].key);
+                }
+                else
+                {
+                    tree_put(p, ops[i].key, ops[i].value);
+                }
+            }
+
+            elapsed += bench_monotonic() - start;
+        }
+
+        snprintf(name, sizeof(name), "put/remove (loop, batch = %zu)", batch_size);
+        bench_report(name, batches * batch_size, 0, elapsed);
+
+        state = 42;
+        elapsed = 0;
+
+        for (size_t b = 0; b < batches; b++)
+        {
+            bench_sorted_batch(&state, ops, batch_size);
+            const int64_t start = bench_monotonic();
+            tree_applyBatch(q, ops, batch_size);
+            elapsed += bench_monotonic() - start;
+        }
+
+        snprintf(name, sizeof(name), "applyBatch (sorted, batch = %zu)", batch_size);
+        bench_report(name, batches * batch_size, 0, elapsed);
+    }
+    tree_free(p);
+    tree_free(q);
+    free(ops);
+}
+
+/**
+ * Draws a key from [0, range), where larger skews concentrate more of the draws on the smallest keys.
+ * A skew of zero is uniform; otherwise, the key is range * u^(1 + skew) for a uniform u in [0, 1).
+ */
+static key_t bench_skewed_key (uint64_t* state, size_t range, unsigned skew)
+{
+    const double u = (double) (bench_random(state) >> 11) * 0x1.0p-53;
+    double x = u;
+
+    for (unsigned i = 0; i < skew; i++)
+    {
+        x *= u;
+    }
+
+    return (key_t) (x * (double) range);
+}
+
+typedef struct
+{
+    tree_t* tree;
+
+    pthread_mutex_t* mutex;
+
+    tree_concurrent_t* concurrent;
+
+    size_t ops;
+
+    size_t range;
+
+    unsigned skew;
+
+    uint64_t seed;
+
+} bench_contention_t;
+
+/**
+ * Performs a mixed workload of 25% puts, 25% removes and 50% gets.
+ */
+static void* bench_contention_worker (void* argument)
+{
+    bench_contention_t* worker = (bench_contention_t*) argument;
+    uint64_t state = worker->seed;
+
+    for (size_t i = 0; i < worker->ops; i++)
+    {
+        const key_t key = bench_skewed_key(&state, worker->range, worker->skew);
+        const uint64_t choice = bench_random(&state) % 4;
+
+        if (NULL != worker->concurrent)
+        {
+            if (0 == choice)
+            {
+                tree_concurrent_put(worker->concurrent, key, (data_t) i);
+            }
+            else if (1 == choice)
+            {
+                tree_concurrent_remove(worker->concurrent, key);
+            }
+            else
+            {
+                tree_concurrent_get(worker->concurrent, key);
+            }
+        }
+        else
+        {
+            pthread_mutex_lock(worker->mutex);
+
+            if (0 == choice)
+            {
+                tree_put(worker->tree, key, (data_t) i);
+            }
+            else if (1 == choice)
+            {
+                tree_remove(worker->tree, key);
+            }
+            else
+            {
+                tree_get(worker->tree, key);
+            }
+
+            pthread_mutex_unlock(worker->mutex);
+        }
+    }
+
+    return NULL;
+}
+
+static void bench_contention (size_t count, size_t threads, unsigned skew, bool concurrent)
+{
+    const size_t range = count < 2 ? 2 : count;
+    pthread_t* ids = calloc(threads, sizeof(pthread_t));
+    bench_contention_t* workers = calloc(threads, sizeof(bench_contention_t));
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    char name[64];
+
+    tree_t* p = tree_new();
+    tree_concurrent_t* c = tree_concurrent_new();
+    {
+        // Prefill half of the key range, so that removes and gets find keys.
+        for (size_t i = 0; i < range; i += 2)
+        {
+            tree_put(p, (key_t) i, (data_t) i);
+            tree_concurrent_put(c, (key_t) i, (data_t) i);
+        }
+
+        const int64_t start = bench_monotonic();
+
+        for (size_t i = 0; i < threads; i++)
+        {
+            workers[i].tree = p;
+            workers[i].mutex = &mutex;
+            workers[i].concurrent = concurrent ? c : NULL;
+            workers[i].ops = count / threads;
+            workers[i].range = range;
+            workers[i].skew = skew;
+            workers[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+            pthread_create(&ids[i], NULL, &bench_contention_worker, &workers[i]);
+        }
+
+        for (size_t i = 0; i < threads; i++)
+        {
+            pthread_join(ids[i], NULL);
+        }
+
+        snprintf(name, sizeof(name), "%s (skew = %u)", concurrent ? "concurrent tree, 50% writes" : "mutex + tree, 50% writes", skew);
+        bench_report(name, threads * (count / threads), start, bench_monotonic());
+    }
+    tree_free(p);
+    tree_concurrent_free(c);
+    free(ids);
+    free(workers);
+}
+
+static void bench_snapshot (size_t count)
+{
+    FILE* file = tmpfile();
+    const int fd = fileno(file);
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    tree_t* r = tree_new();
+    {
+        // Reuse the same memory for the keys and the values.
+        key_t* keys = calloc(count, sizeof(key_t));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            keys[i] = (key_t) i;
+        }
+
+        tree_putArrays(p, keys, (data_t*) keys, count);
+        free(keys);
+
+        int64_t start = bench_monotonic();
+        tree_save(p, fd);
+        fsync(fd);
+        bench_report("save (int/int)", count, start, bench_monotonic());
+
+        lseek(fd, 0, SEEK_SET);
+        start = bench_monotonic();
+        tree_load(q, fd);
+        bench_report("load (int/int)", count, start, bench_monotonic());
+
+        // Dense keys and values, which pack into about two bits per entry.
+        FILE* packed = tmpfile();
+        start = bench_monotonic();
+        tree_savePacked(p, fileno(packed));
+        fsync(fileno(packed));
+        bench_report("savePacked (int/int)", count, start, bench_monotonic());
+
+        lseek(fileno(packed), 0, SEEK_SET);
+        start = bench_monotonic();
+        tree_loadPacked(r, fileno(packed));
+        bench_report("loadPacked (int/int)", count, start, bench_monotonic());
+
+        printf("%-40s %12lld bytes (plain) %12lld bytes (packed)\n", "snapshot size", (long long) lseek(fd, 0, SEEK_END), (long long) lseek(fileno(packed), 0, SEEK_END));
+        fclose(packed);
+    }
+    tree_free(p);
+    tree_free(q);
+    tree_free(r);
+    fclose(file);
+}
+
+static void bench_image (size_t count, key_t* keys, data_t* values)
+{
+    FILE* file = tmpfile();
+    const int fd = fileno(file);
+    char name[64];
+
+    tree_t* p = tree_new();
+    {
+        tree_putArrays(p, keys, values, count);
+        tree_saveImage(p, fd);
+        fsync(fd);
+
+        // Opening only maps the file and checks the header.
+        int64_t start = bench_monotonic();
+        tree_image_t* image = tree_image_open(fd, false);
+        snprintf(name, sizeof(name), "image open (%zu nodes)", tree_image_size(image));
+        bench_report(name, 1, start, bench_monotonic());
+
+        start = bench_monotonic();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            tree_image_get(image, keys[i]);
+        }
+
+        bench_report("image get (random)", count, start, bench_monotonic());
+        tree_image_close(image);
+    }
+    tree_free(p);
+    fclose(file);
+}
+
+typedef struct
+{
+    tree_wal_t* wal;
+
+    size_t ops;
+
+    key_t base;
+
+    bool wait;
+
+} bench_wal_t;
+
+/**
+ * Performs puts, where either each put waits until it is durable, or only the last one does.
+ */
+static void* bench_wal_worker (void* argument)
+{
+    bench_wal_t* worker = (bench_wal_t*) argument;
+
+    uint64_t sequence = 0;
+
+    for (size_t i = 0; i < worker->ops; i++)
+    {
+        sequence = tree_wal_put(worker->wal, worker->base + (key_t) i, (data_t) i);
+
+        if (worker->wait)
+        {
+            tree_wal_sync(worker->wal, sequence);
+        }
+    }
+
+    tree_wal_sync(worker->wal, sequence);
+
+    return NULL;
+}
+
+static void bench_wal (size_t count, size_t threads, size_t group_size, uint64_t max_latency_ns, bool wait)
+{
+    // Every group costs an fsync; therefore, fewer operations are performed than in the other benchmarks.
+    const size_t ops = (count < 20000 ? count : 20000) / threads;
+    char directory[] = "/tmp/bench_wal_XXXXXX";
+    char snapshot[64];
+    char log[64];
+    char name[64];
+
+    if (NULL == mkdtemp(directory))
+    {
+        return;
+    }
+
+    snprintf(snapshot, sizeof(snapshot), "%s/tree.snapshot", directory);
+    snprintf(log, sizeof(log), "%s/tree.log", directory);
+
+    pthread_t* ids = calloc(threads, sizeof(pthread_t));
+    bench_wal_t* workers = calloc(threads, sizeof(bench_wal_t));
+
+    tree_t* p = tree_new();
+    {
+        tree_wal_t* wal = tree_wal_open(p, snapshot, log, group_size, max_latency_ns);
+        const int64_t start = bench_monotonic();
+
+        for (size_t i = 0; i < threads; i++)
+        {
+            workers[i].wal = wal;
+            workers[i].ops = ops;
+            workers[i].base = (key_t) (i * ops);
+            workers[i].wait = wait;
+            pthread_create(&ids[i], NULL, &bench_wal_worker, &workers[i]);
+        }
+
+        for (size_t i = 0; i < threads; i++)
+        {
+            pthread_join(ids[i], NULL);
+        }
+
+        snprintf(name, sizeof(name), "wal put%s (group = %zu, %llu us)", wait ? " + sync" : "", group_size, (unsigned long long) (max_latency_ns / 1000));
+        bench_report(name, threads * ops, start, bench_monotonic());
+        tree_wal_close(wal);
+    }
+    tree_free(p);
+    free(ids);
+    free(workers);
+
+    unlink(snapshot);
+    unlink(log);
+    rmdir(directory);
+}
+
+static void bench_checkpoint (size_t count, key_t* keys, data_t* values)
+{
+    char directory[] = "/tmp/bench_wal_XXXXXX";
+    char snapshot[64];
+    char log[64];
+
+    if (NULL == mkdtemp(directory))
+    {
+        return;
+    }
+
+    snprintf(snapshot, sizeof(snapshot), "%s/tree.snapshot", directory);
+    snprintf(log, sizeof(log), "%s/tree.log", directory);
+
+    tree_t* p = tree_new();
+    {
+        tree_wal_t* wal = tree_wal_open(p, snapshot, log, 1024, 1000000);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            tree_wal_put(wal, keys[i], values[i]);
+        }
+
+        // A compaction holds off writers for its whole duration.
+        int64_t start = bench_monotonic();
+        tree_wal_compact(wal);
+        bench_report("wal compact (writers wait)", tree_size(p), start, bench_monotonic());
+
+        // A checkpoint only holds off writers for one chunk at a time.
+        start = bench_monotonic();
+        tree_wal_startCheckpoint(wal);
+        tree_wal_waitCheckpoint(wal);
+        bench_report("wal checkpoint", tree_size(p), start, bench_monotonic());
+
+        const tree_wal_checkpoint_stats_t stats = tree_wal_checkpointStats(wal);
+        bench_report("wal checkpoint (longest pause)", 1, 0, (int64_t) stats.last_pause_ns);
+        tree_wal_close(wal);
+    }
+    tree_free(p);
+
+    unlink(snapshot);
+    unlink(log);
+    rmdir(directory);
+}
+
+typedef struct
+{
+    key_t* keys;
+
+    data_t* values;
+
+    size_t position;
+
+    size_t count;
+
+} bench_stream_t;
+
+/**
+ * Copies each chunk into the arrays, as a stand-in for a socket or a file.
+ */
+static bool bench_stream_sink (tree_t* tree, key_t* keys, data_t* values, size_t count, void* context)
+{
+    bench_stream_t* stream = (bench_stream_t*) context;
+    memcpy(stream->keys + stream->position, keys, count * sizeof(key_t));
+    memcpy(stream->values + stream->position, values, count * sizeof(data_t));
+    stream->position += count;
+    return true;
+}
+
+static size_t bench_stream_source (tree_t* tree, key_t* keys, data_t* values, size_t capacity, void* context)
+{
+    bench_stream_t* stream = (bench_stream_t*) context;
+    const size_t count = stream->count - stream->position < capacity ? stream->count - stream->position : capacity;
+    memcpy(keys, stream->keys + stream->position, count * sizeof(key_t));
+    memcpy(values, stream->values + stream->position, count * sizeof(data_t));
+    stream->position += count;
+    return count;
+}
+
+static void bench_stream (size_t count, key_t* keys, data_t* values)
+{
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    tree_t* r = tree_new();
+    {
+        tree_putArrays(p, keys, values, count);
+        const size_t size = tree_size(p);
+        bench_stream_t stream = { calloc(size, sizeof(key_t)), calloc(size, sizeof(data_t)), 0, size };
+
+        int64_t start = bench_monotonic();
+        key_t* exported_keys = tree_keysToNewArray(p);
+        data_t* exported_values = tree_valuesToNewArray(p);
+        bench_report("keysToNewArray + valuesToNewArray", size, start, bench_monotonic());
+        free(exported_keys);
+        free(exported_values);
+
+        start = bench_monotonic();
+        tree_export(p, 4096, &bench_stream_sink, &stream);
+        bench_report("export (chunk = 4096)", size, start, bench_monotonic());
+
+        start = bench_monotonic();
+        tree_putArrays(q, stream.keys, stream.values, size);
+        bench_report("putArrays (sorted)", size, start, bench_monotonic());
+
+        stream.position = 0;
+        start = bench_monotonic();
+        tree_import(r, 4096, &bench_stream_source, &stream);
+        bench_report("import (sorted, chunk = 4096)", size, start, bench_monotonic());
+
+        free(stream.keys);
+        free(stream.values);
+    }
+    tree_free(p);
+    tree_free(q);
+    tree_free(r);
+}
+
+typedef struct
+{
+    tree_op_t* ops;
+
+    size_t count;
+
+    size_t position;
+
+} bench_patch_t;
+
+static bool bench_patch_sink (tree_t* tree, tree_op_t* ops, size_t count, void* context)
+{
+    bench_patch_t* patch = (bench_patch_t*) context;
+    memcpy(patch->ops + patch->count, ops, count * sizeof(tree_op_t));
+    patch->count += count;
+    return true;
+}
+
+static size_t bench_patch_source (tree_t* tree, tree_op_t* ops, size_t capacity, void* context)
+{
+    bench_patch_t* patch = (bench_patch_t*) context;
+    const size_t count = patch->count - patch->position < capacity ? patch->count - patch->position : capacity;
+    memcpy(ops, patch->ops + patch->position, count * sizeof(tree_op_t));
+    patch->position += count;
+    return count;
+}
+
+static void bench_diff (size_t count, key_t* keys, data_t* values)
+{
+    char name[64];
+
+    tree_t* p = tree_new();
+    {
+        tree_putArrays(p, keys, values, count);
+        tree_t* q = tree_copy(p);
+        tree_t* r = tree_copy(p);
+
+        // Change about 1% of the entries.
+        uint64_t state = 7;
+
+        for (size_t i = 0; i < count / 100; i++)
+        {
+            const key_t key = keys[bench_random(&state) % count];
+
+            if (i % 2 == 0)
+            {
+                tree_remove(q, key);
+            }
+            else
+            {
+                tree_put(q, key, -1);
+            }
+        }
+
+        bench_patch_t patch = { calloc(tree_size(p) + tree_size(q), sizeof(tree_op_t)), 0, 0 };
+
+        int64_t start = bench_monotonic();
+        tree_diff(p, q, &bench_patch_sink, &patch);
+        snprintf(name, sizeof(name), "diff (1%% changed, %zu ops)", patch.count);
+        bench_report(name, tree_size(p), start, bench_monotonic());
+
+        start = bench_monotonic();
+        tree_applyPatch(r, 4096, &bench_patch_source, &patch);
+        bench_report("applyPatch", patch.count, start, bench_monotonic());
+
+        free(patch.ops);
+        tree_free(q);
+        tree_free(r);
+    }
+    tree_free(p);
+}
+
+static bool bench_same_value (tree_node_t* x, tree_node_t* y, void* context)
+{
+    return x->value == y->value;
+}
+
+static bool bench_mismatch_counter (tree_t* tree, key_t* lo, key_t* hi, void* context)
+{
+    ++*((size_t*) context);
+    return true;
+}
+
+static void bench_subtree_hash (size_t count, key_t* keys, data_t* values)
+{
+    char name[64];
+
+    tree_t* p = tree_new();
+    {
+        tree_putArrays(p, keys, values, count);
+        tree_t* q = tree_copy(p);
+
+        int64_t start = bench_monotonic();
+        const bool equal = tree_isEqual(p, q, &bench_same_value, NULL);
+        snprintf(name, sizeof(name), "isEqual (%s)", equal ? "equal" : "different");
+        bench_report(name, count, start, bench_monotonic());
+
+        start = bench_monotonic();
+        const bool same_hash = tree_hash(p) == tree_hash(q);
+        snprintf(name, sizeof(name), "hash compare (%s)", same_hash ? "equal" : "different");
+        bench_report(name, count, start, bench_monotonic());
+
+        // Change a handful of entries.
+        uint64_t state = 11;
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            tree_put(q, keys[bench_random(&state) % count], -1);
+        }
+
+        size_t ranges = 0;
+        start = bench_monotonic();
+        tree_mismatches(p, q, 64, &bench_mismatch_counter, &ranges);
+        snprintf(name, sizeof(name), "mismatches (16 changed, %zu ranges)", ranges);
+        bench_report(name, count, start, bench_monotonic());
+
+        tree_free(q);
+    }
+    tree_free(p);
+}
+
+/**
+ * Expires the lowest tenth of the keys, either one node at a time, or by splitting the tree.
+ */
+static void bench_split (size_t count, key_t* keys, data_t* values)
+{
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        tree_putArrays(p, keys, values, count);
+        tree_putArrays(q, keys, values, count);
+
+        const size_t expired = tree_size(p) / 10;
+        const key_t cutoff = tree_nthNode(p, expired)->key;
+
+        // The expired nodes are freed separately, so that only the detaching is measured.
+        tree_t* below = NULL;
+        tree_t* above = NULL;
+        int64_t start = bench_monotonic();
+        tree_split(q, cutoff, &below, &above);
+        bench_report("split expiry", expired, start, bench_monotonic());
+
+        start = bench_monotonic();
+
+        while (tree_firstNode(p)->key < cutoff)
+        {
+            tree_removeFirst(p);
+        }
+
+        bench_report("removeFirst expiry", expired, start, bench_monotonic());
+
+        tree_free(below);
+        tree_free(above);
+    }
+    tree_free(p);
+    tree_free(q);
+}
+
+/**
+ * Draws random nodes, either by one nthNode() descent per node, or by a single sorted walk.
+ */
+static void bench_sample (size_t count, key_t* keys, data_t* values)
+{
+    tree_t* p = tree_new();
+    tree_node_t** nodes = calloc(count / 10, sizeof(tree_node_t*));
+
+    if (NULL != nodes)
+    {
+        tree_putArrays(p, keys, values, count);
+
+        const size_t k = count / 10;
+        const size_t size = tree_size(p);
+        tree_random_t rng = tree_random_seed(13);
+
+        int64_t start = bench_monotonic();
+
+        for (size_t i = 0; i < k; i++)
+        {
+            nodes[i] = tree_nthNode(p, tree_random_next(&rng) % size);
+        }
+
+        bench_report("nthNode sample", k, start, bench_monotonic());
+
+        start = bench_monotonic();
+        tree_sample(p, k, &rng, nodes);
+        bench_report("sample", k, start, bench_monotonic());
+    }
+    free(nodes);
+    tree_free(p);
+}
+
+static int bench_compare_keys (const void* x, const void* y)
+{
+    const key_t a = *(const key_t*) x;
+    const key_t b = *(const key_t*) y;
+    return a < b ? -1 : (a > b ? +1 : 0);
+}
+
+/**
+ * Looks up batches of random keys, either by a loop of get(), or by getMany() with unsorted and with sorted batches.
+ */
+static void bench_getMany (size_t count, key_t* keys, data_t* values, size_t batch_size)
+{
+    static const char* names[] = { "get loop", "getMany (unsorted)", "getMany (sorted)" };
+    char name[64];
+
+    tree_t* p = tree_new();
+    key_t* batch = calloc(batch_size, sizeof(key_t));
+    data_t* results = calloc(batch_size, sizeof(data_t));
+    bool* found = calloc(batch_size, sizeof(bool));
+
+    if (NULL != batch && NULL != results && NULL != found)
+    {
+        tree_putArrays(p, keys, values, count);
+
+        for (int mode = 0; mode < 3; mode++)
+        {
+            uint64_t state = 17;
+            int64_t elapsed = 0;
+
+            for (size_t base = 0; base < count; base += batch_size)
+            {
+                for (size_t i = 0; i < batch_size; i++)
+                {
+                    batch[i] = keys[bench_random(&state) % count];
+                }
+
+                if (2 == mode)
+                {
+                    qsort(batch, batch_size, sizeof(key_t), &bench_compare_keys);
+                }
+
+                const int64_t start = bench_monotonic();
+
+                if (0 == mode)
+                {
+                    for (size_t i = 0; i < batch_size; i++)
+                    {
+                        results[i] = tree_get(p, batch[i]);
+                    }
+                }
+                else
+                {
+                    tree_getMany(p, batch, results, found, batch_size);
+                }
+
+                elapsed += bench_monotonic() - start;
+            }
+
+            snprintf(name, sizeof(name), "%s (batch %zu)", names[mode], batch_size);
+            bench_report(name, count, 0, elapsed);
+        }
+    }
+    free(batch);
+    free(results);
+    free(found);
+    tree_free(p);
+}
+
+/**
+ * Looks up keys near the previous one, either by get() or by a finger, in a scan with occasional random seeks.
+ */
+static void bench_finger (size_t count, key_t* keys, data_t* values)
+{
+    tree_t* p = tree_new();
+    key_t* sorted = calloc(count, sizeof(key_t));
+
+    if (NULL != sorted)
+    {
+        tree_putArrays(p, keys, values, count);
+        memcpy(sorted, keys, count * sizeof(key_t));
+        qsort(sorted, count, sizeof(key_t), &bench_compare_keys);
+
+        for (int mode = 0; mode < 2; mode++)
+        {
+            tree_finger_t finger;
+            tree_finger_init(&finger, p);
+
+            uint64_t state = 19;
+            size_t position = 0;
+            volatile data_t sum = 0;
+
+            const int64_t start = bench_monotonic();
+
+            for (size_t i = 0; i < count; i++)
+            {
+                // Every 1000th access seeks to a random key, and the others step to the next key.
+                position = 0 == i % 1000 ? bench_random(&state) % count : (position + 1) % count;
+                sum += 0 == mode ? tree_get(p, sorted[position]) : tree_finger_get(&finger, sorted[position]);
+            }
+
+            bench_report(0 == mode ? "get (local)" : "finger_get (local)", count, start, bench_monotonic());
+        }
+    }
+    free(sorted);
+    tree_free(p);
+}
+
+/**
+ * Evicts a file from the page cache of the operating system, so that reading it goes to the device.
+ */
+static void bench_drop_cache (const char* path)
+{
+    const int fd = open(path, O_RDONLY);
+
+    if (fd >= 0)
+    {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/**
+ * Looks up random keys in a freshly opened disk tree, either one by one, or in batches using io_uring or threads.
+ */
+static void bench_disk_lookups (const char* path, size_t cache_pages, size_t count, key_t* keys, int mode)
+{
+    static const char* names[] = { "disk get (cold)", "disk getMany (io_uring, cold)", "disk getMany (threads, cold)" };
+
+    bench_drop_cache(path);
+    tree_disk_t* disk = tree_disk_open(path, cache_pages);
+
+    if (NULL == disk || (1 == mode && false == tree_disk_setIoUring(disk, true)))
+    {
+        tree_disk_close(disk);
+        return;
+    }
+
+    tree_disk_setIoUring(disk, 1 == mode);
+
+    const size_t lookups = count / 10;
+    key_t* batch = calloc(lookups, sizeof(key_t));
+    data_t* values = calloc(lookups, sizeof(data_t));
+    uint64_t state = 13;
+
+    for (size_t i = 0; i < lookups; i++)
+    {
+        batch[i] = keys[bench_random(&state) % count];
+    }
+
+    const int64_t start = bench_monotonic();
+
+    if (0 == mode)
+    {
+        for (size_t i = 0; i < lookups; i++)
+        {
+            values[i] = tree_disk_get(disk, batch[i]);
+        }
+    }
+    else
+    {
+        tree_disk_getMany(disk, batch, values, NULL, lookups);
+    }
+
+    bench_report(names[mode], lookups, start, bench_monotonic());
+
+    free(batch);
+    free(values);
+    tree_disk_close(disk);
+}
+
+static void bench_disk (size_t count, key_t* keys, data_t* values)
+{
+    char directory[] = "/tmp/bench_disk_XXXXXX";
+    char path[64];
+    char name[64];
+
+    if (NULL == mkdtemp(directory))
+    {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s/tree.disk", directory);
+
+    // The tree is four times larger than the cache (a page holds about 500 entries of int/int).
+    const size_t cache_pages = count / 500 / 4;
+    tree_disk_t* disk = tree_disk_open(path, cache_pages);
+
+    if (NULL != disk)
+    {
+        int64_t start = bench_monotonic();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            tree_disk_put(disk, keys[i], values[i]);
+        }
+
+        tree_disk_stats_t stats = tree_disk_stats(disk);
+        snprintf(name, sizeof(name), "disk put (%zu cached pages)", stats.cache_pages);
+        bench_report(name, count, start, bench_monotonic());
+
+        start = bench_monotonic();
+        tree_disk_close(disk);
+        bench_report("disk close", count, start, bench_monotonic());
+
+        for (int mode = 0; mode < 3; mode++)
+        {
+            bench_disk_lookups(path, cache_pages, count, keys, mode);
+        }
+    }
+
+    unlink(path);
+    rmdir(directory);
+}
+
+int main (int argc, const char** argv)
+{
+    const size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    const size_t threads = argc > 2 ? strtoull(argv[2], NULL, 10) : 4;
+    const unsigned skew = argc > 3 ? (unsigned) strtoul(argv[3], NULL, 10) : 2;
+
+    printf("Benchmark: count = %zu, threads = %zu, skew = %u\n", count, threads, skew);
+
+    key_t* keys = calloc(count, sizeof(key_t));
+    data_t* values = calloc(count, sizeof(data_t));
+
+    if (NULL == keys || NULL == values)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_random_pairs(count, keys, values);
+
+    bench_put_loop(count, keys, values);
+    bench_putArrays(count, keys, values);
+    bench_putArraysParallel(count, keys, values, threads);
+    bench_applyBatch(count, keys, values, 10000);
+    bench_applyBatch(count, keys, values, 100000);
+    bench_contention(count, threads, skew, false);
+    bench_contention(count, threads, skew, true);
+    bench_stream(count, keys, values);
+    bench_diff(count, keys, values);
+    bench_subtree_hash(count, keys, values);
+    bench_split(count, keys, values);
+    bench_sample(count, keys, values);
+    bench_getMany(count, keys, values, 64);
+    bench_getMany(count, keys, values, 512);
+    bench_finger(count, keys, values);
+    bench_snapshot(count);
+    bench_image(count, keys, values);
+    bench_wal(count, threads, 1, 0, true);
+    bench_wal(count, threads, 1, 0, false);
+    bench_wal(count, threads, 1024, 1000000, false);
+    bench_checkpoint(count, keys, values);
+    bench_disk(count, keys, values);
+
+    free(keys);
+    free(values);
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,18 @@
 #include "tree.h"
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
 typedef struct
 {
     size_t allocated;
@@ -30,6 +43,82 @@ static size_t size_of (tree_node_t* node)
     return NULL == node ? 0 : node->size;
 }
 
+static uint64_t hash_of (tree_node_t* node)
+{
+    return NULL == node ? 0 : node->hash;
+}
+
+/**
+ * Finalizer of the splitmix64 generator, which spreads every input bit over the whole word.
+ */
+static uint64_t hash_mix (uint64_t x)
+{
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+static uint64_t hash_entry (key_t* key, data_t* value)
+{
+    unsigned char bytes[sizeof(key_t) + sizeof(data_t)];
+    memcpy(bytes, key, sizeof(key_t));
+    memcpy(bytes + sizeof(key_t), value, sizeof(data_t));
+
+    uint64_t hash = UINT64_C(0x9E3779B97F4A7C15);
+    size_t i = 0;
+
+    for (; i + 8 <= sizeof(bytes); i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = hash_mix(hash ^ word);
+    }
+
+    if (i < sizeof(bytes))
+    {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, sizeof(bytes) - i);
+        hash = hash_mix(hash ^ word);
+    }
+
+    return hash_mix(hash ^ sizeof(bytes));
+}
+
+static int64_t aggregate_entry (key_t* K, data_t* V)
+{
+    return *V;
+}
+
+static int64_t aggregate_combine (int64_t* X, int64_t* Y)
+{
+    return *X + *Y;
+}
+
+static int64_t aggregate_of (tree_node_t* node)
+{
+    if (NULL == node)
+    {
+        int64_t identity = 0;
+        return identity;
+    }
+    else
+    {
+        return node->aggregate;
+    }
+}
+
+/**
+ * Combines the aggregates of the left subtree, the node itself and the right subtree, in this order.
+ */
+static int64_t aggregate_node (tree_node_t* node)
+{
+    int64_t left = aggregate_of(node->left);
+    int64_t entry = aggregate_entry(&node->key, &node->value);
+    int64_t right = aggregate_of(node->right);
+    int64_t result = aggregate_combine(&left, &entry);
+    return aggregate_combine(&result, &right);
+}
+
 static int8_t balance_of (tree_node_t* node)
 {
     if (NULL == node)
@@ -42,6 +131,24 @@ static int8_t balance_of (tree_node_t* node)
     }
 }
 
+/**
+ * Turns a freshly allocated node into a leaf with the given key, and counts it in the size of the tree.
+ */
+static tree_node_t* init_node (tree_t* self, tree_node_t* node, key_t* key)
+{
+    ++self->size;
+    node->key = *key;
+    // The hash and the aggregate of the node cover its value, which must therefore be defined, until the caller sets it.
+    memset(&node->value, 0, sizeof(data_t));
+    node->hash = hash_entry(&node->key, &node->value);
+    node->aggregate = aggregate_entry(&node->key, &node->value);
+    node->height = 0;
+    node->size = 1;
+    node->left = NULL;
+    node->right = NULL;
+    return node;
+}
+
 static tree_node_t* create_node (tree_t* self, key_t* key)
 {
     tree_node_t* node = self->allocator->allocate(self->allocator);
@@ -52,13 +159,7 @@ static tree_node_t* create_node (tree_t* self, key_t* key)
     }
     else
     {
-        ++self->size;
-        node->key = *key;
-        node->height = 0;
-        node->size = 1;
-        node->left = NULL;
-        node->right = NULL;
-        return node;
+        return init_node(self, node, key);
     }
 }
 
@@ -72,6 +173,8 @@ static void update_size (tree_node_t* node)
     if (NULL != node)
     {
         node->size = 1 + size_of(node->left) + size_of(node->right);
+        node->hash = hash_entry(&node->key, &node->value) + hash_of(node->left) + hash_of(node->right);
+        node->aggregate = aggregate_node(node);
     }
 }
 
@@ -190,36 +293,190 @@ static tree_node_t* rebalance (tree_t* self, tree_node_t* node, key_t* key)
     return node;
 }
 
-static tree_node_t* insert_node (tree_t* self, tree_node_t* node, key_t* key)
+/**
+ * Restores the balance of a node, whose subtrees differ in height by at most two,
+ * without consulting any keys (unlike rebalance(), which is specific to a single insertion).
+ */
+static tree_node_t* balance_node (tree_node_t* node)
 {
-    if (node == NULL)
+    if (NULL == node)
     {
-        return create_node(self, key);
+        return NULL;
     }
-    else if (self->comparator(self, key, &node->key) < 0)
+
+    update_height(node);
+    update_size(node);
+
+    const int8_t balance = balance_of(node);
+
+    if (balance > 1)
     {
-        node->left = insert_node(self, node->left, key);
-        return rebalance(self, node, key);
+        if (balance_of(node->left) < 0)
+        {
+            node->left = rotate_left(node->left);
+        }
+
+        node = rotate_right(node);
     }
-    else if (self->comparator(self, key, &node->key) > 0)
+    else if (balance < -1)
     {
-        node->right = insert_node(self, node->right, key);
-        return rebalance(self, node, key);
+        if (balance_of(node->right) > 0)
+        {
+            node->right = rotate_right(node->right);
+        }
+
+        node = rotate_left(node);
+    }
+
+    return node;
+}
+
+static tree_node_t* join_right (tree_node_t* left, tree_node_t* pivot, tree_node_t* right)
+{
+    // Descend the right spine of the taller left tree, until the heights are close enough.
+    if (height_of(left->right) <= height_of(right) + 1)
+    {
+        pivot->left = left->right;
+        pivot->right = right;
+        update_height(pivot);
+        update_size(pivot);
+        left->right = pivot;
     }
     else
     {
-        return node;
+        left->right = join_right(left->right, pivot, right);
+    }
+
+    return balance_node(left);
+}
+
+static tree_node_t* join_left (tree_node_t* left, tree_node_t* pivot, tree_node_t* right)
+{
+    // Descend the left spine of the taller right tree, until the heights are close enough.
+    if (height_of(right->left) <= height_of(left) + 1)
+    {
+        pivot->left = left;
+        pivot->right = right->left;
+        update_height(pivot);
+        update_size(pivot);
+        right->left = pivot;
+    }
+    else
+    {
+        right->left = join_left(left, pivot, right->left);
+    }
+
+    return balance_node(right);
+}
+
+/**
+ * Joins two trees and a pivot node into one balanced tree in O(|height(left) - height(right)|),
+ * provided that every key in the left tree is less than the pivot key,
+ * which is in turn less than every key in the right tree.
+ */
+static tree_node_t* join_nodes (tree_node_t* left, tree_node_t* pivot, tree_node_t* right)
+{
+    if (height_of(left) > height_of(right) + 1)
+    {
+        return join_right(left, pivot, right);
+    }
+    else if (height_of(right) > height_of(left) + 1)
+    {
+        return join_left(left, pivot, right);
+    }
+    else
+    {
+        pivot->left = left;
+        pivot->right = right;
+        update_height(pivot);
+        update_size(pivot);
+        return pivot;
+    }
+}
+
+/**
+ * Detaches the minimum node of a (non-empty) subtree and returns the rebalanced remainder.
+ */
+static tree_node_t* detach_first (tree_node_t* node, tree_node_t** first)
+{
+    if (NULL == node->left)
+    {
+        *first = node;
+        return node->right;
+    }
+    else
+    {
+        node->left = detach_first(node->left, first);
+        return balance_node(node);
+    }
+}
+
+/**
+ * Joins two trees without a pivot node, where every key in the left tree is less than every key in the right tree.
+ */
+static tree_node_t* join_trees (tree_node_t* left, tree_node_t* right)
+{
+    if (NULL == left)
+    {
+        return right;
+    }
+    else if (NULL == right)
+    {
+        return left;
+    }
+    else
+    {
+        tree_node_t* pivot = NULL;
+        right = detach_first(right, &pivot);
+        return join_nodes(left, pivot, right);
     }
 }
 
-static tree_node_t* find_min_value_node (tree_node_t* node)
+/**
+ * Inserts a node with a key, unless the key is already in the subtree, and sets its value, unless the value is NULL.
+ * The inserted or found node is stored in the output, or NULL if the allocation failed.
+ * Since the path is rebalanced as the recursion unwinds, the sizes, hashes, and aggregates on it are also updated.
+ */
+static tree_node_t* insert_node (tree_t* self, tree_node_t* node, key_t* key, data_t* value, tree_node_t** inserted)
 {
-    tree_node_t* current = node;
-    while (current->left != NULL)
+    if (node == NULL)
+    {
+        node = create_node(self, key);
+        *inserted = node;
+
+        if (NULL != node && NULL != value)
+        {
+            node->value = *value;
+            update_size(node);
+        }
+
+        return node;
+    }
+
+    const int ordering = self->comparator(self, key, &node->key);
+
+    if (ordering < 0)
+    {
+        node->left = insert_node(self, node->left, key, value, inserted);
+        return rebalance(self, node, key);
+    }
+    else if (ordering > 0)
+    {
+        node->right = insert_node(self, node->right, key, value, inserted);
+        return rebalance(self, node, key);
+    }
+    else
     {
-        current = current->left;
+        *inserted = node;
+
+        if (NULL != value)
+        {
+            node->value = *value;
+            update_size(node);
+        }
+
+        return node;
     }
-    return current;
 }
 
 static tree_node_t* delete_node (tree_t* self, tree_node_t* node, key_t* key, tree_node_t** deleted)
@@ -262,17 +519,17 @@ static tree_node_t* delete_node (tree_t* self, tree_node_t* node, key_t* key, tr
     {
         *deleted = node;
 
-        // Find the inorder successor, which has no left subtree by-definition.
-        tree_node_t* successor = find_min_value_node(node->right);
-
-        // Delete the inorder successor
-        tree_node_t* deleted_successor = NULL;
+        // Detach the inorder successor, which has no left subtree by-definition,
+        // and then put the successor in place of the deleted node.
+        tree_node_t* successor = NULL;
+        tree_node_t* right = detach_first(node->right, &successor);
         successor->left = node->left;
-        successor->right = delete_node(self, node->right, &successor->key, &deleted_successor);
+        successor->right = right;
         node = successor;
     }
 
-    return rebalance(self, node, key);
+    // The rotations needed after a deletion cannot be chosen by comparing keys, unlike after an insertion.
+    return balance_node(node);
 }
 
 static tree_node_t* find_node (tree_t* self, tree_node_t* node, key_t* key)
@@ -308,12 +565,10 @@ static tree_node_t* dynamic_allocate (tree_allocator_t* self)
 
 static void wipe (tree_node_t* self)
 {
-
     if (NULL != self)
     {
         memset(self, 0, sizeof(tree_node_t));
     }
-
 }
 
 static void dynamic_release (tree_allocator_t* self, tree_node_t* node)
@@ -572,9 +827,7 @@ void tree_allocator_free (tree_allocator_t* self)
 
 static int tree_naturalOrder (tree_t* self, key_t* X, key_t* Y)
 {
-
     return *X < *Y ? -1 : (*X > *Y ? +1 : 0);
-
 }
 
 static int tree_reverseOrder (tree_t* self, key_t* X, key_t* Y)
@@ -606,9 +859,7 @@ tree_comparator_t tree_comparator_reverseOrder ()
  */
 key_t tree_defaultKey ()
 {
-
     return NULL;
-
 }
 
 /**
@@ -617,9 +868,7 @@ key_t tree_defaultKey ()
  */
 data_t tree_defaultValue ()
 {
-
     return NULL;
-
 }
 
 /**
@@ -679,6 +928,8 @@ void tree_free (tree_t* self)
 tree_t tree_make_stackalloc (tree_allocator_t* allocator, tree_comparator_t comparator)
 {
     tree_t result;
+    result.size = 0;
+    result.root = NULL;
     result.allocator = allocator;
     result.comparator = comparator;
     return result;
@@ -722,6 +973,96 @@ tree_t* tree_copy (tree_t* self)
     }
 }
 
+/**
+ * Splits a subtree into the nodes less than a key and the rest, by joining the subtrees along the path to the key.
+ * The cost of the joins telescopes to O(log n) in total.
+ */
+static void split_nodes (tree_t* self, tree_node_t* node, key_t* key, tree_node_t** left, tree_node_t** right)
+{
+    if (NULL == node)
+    {
+        *left = NULL;
+        *right = NULL;
+    }
+    else if (self->comparator(self, key, &node->key) <= 0)
+    {
+        tree_node_t* greater = node->right;
+        tree_node_t* middle = NULL;
+        split_nodes(self, node->left, key, left, &middle);
+        *right = join_nodes(middle, node, greater);
+    }
+    else
+    {
+        tree_node_t* lesser = node->left;
+        tree_node_t* middle = NULL;
+        split_nodes(self, node->right, key, &middle, right);
+        *left = join_nodes(lesser, node, middle);
+    }
+}
+
+/**
+ * @brief Splits an AVL tree at a key into two new trees in logarithmic time.
+ * @param self Pointer to the AVL tree, which is empty afterwards.
+ * @param key Key at which to split the tree.
+ * @param left Receives the new tree with the keys less than the key.
+ * @param right Receives the new tree with the keys greater than or equal to the key.
+ * @return true if the tree was split, false if a new tree could not be allocated (the tree is unchanged).
+ */
+bool tree_split (tree_t* self, key_t key, tree_t** left, tree_t** right)
+{
+    tree_t* lesser = tree_make(self->allocator, self->comparator);
+    tree_t* greater = tree_make(self->allocator, self->comparator);
+
+    if (NULL == lesser || NULL == greater)
+    {
+        tree_free(lesser);
+        tree_free(greater);
+        return false;
+    }
+
+    split_nodes(self, self->root, &key, &lesser->root, &greater->root);
+    lesser->size = size_of(lesser->root);
+    greater->size = size_of(greater->root);
+
+    self->root = NULL;
+    self->size = 0;
+
+    *left = lesser;
+    *right = greater;
+    return true;
+}
+
+/**
+ * @brief Moves all of the nodes of one AVL tree to the end of another in logarithmic time.
+ * @param left Pointer to the AVL tree, which receives the nodes.
+ * @param right Pointer to the AVL tree, whose keys must all be greater than the keys of the left tree.
+ * @return true if the trees were joined (the right tree is empty afterwards), false otherwise (both are unchanged).
+ */
+bool tree_join (tree_t* left, tree_t* right)
+{
+    if (left == right || left->allocator != right->allocator || left->comparator != right->comparator)
+    {
+        return false;
+    }
+    else if (NULL != left->root && NULL != right->root)
+    {
+        tree_node_t* last = tree_lastNode(left);
+        tree_node_t* first = tree_firstNode(right);
+
+        if (left->comparator(left, &last->key, &first->key) >= 0)
+        {
+            return false;
+        }
+    }
+
+    left->root = join_trees(left->root, right->root);
+    left->size += right->size;
+
+    right->root = NULL;
+    right->size = 0;
+    return true;
+}
+
 /**
  * @brief Retrieves the number of nodes in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -804,19 +1145,20 @@ bool tree_containsValue (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*,
  * @param self Pointer to the AVL tree.
  * @param key Key for the node to insert.
  * @return Pointer to the created node.
+ *
+ * The value of a new node is zeroed; set it through setNode(), which keeps the hashes and aggregates up to date.
  */
 tree_node_t* tree_putNode (tree_t* self, key_t key)
 {
-    tree_node_t* root = insert_node(self, self->root, &key);
-    if (NULL == root)
-    {
-        return NULL;
-    }
-    else
+    tree_node_t* node = NULL;
+    tree_node_t* root = insert_node(self, self->root, &key, NULL, &node);
+
+    if (NULL != root)
     {
         self->root = root;
-        return find_node(self, self->root, &key); // TODO: improve performance
     }
+
+    return node;
 }
 
 /**
@@ -960,262 +1302,686 @@ tree_node_t* tree_lowerNode (tree_t* self, key_t key)
     return predecessor;
 }
 
-static tree_node_t* find_nth (size_t prior, tree_node_t* node, size_t index)
+/**
+ * @brief Finds the node with the greatest key less than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the floor node.
+ * @return Pointer to the floor node or NULL if not found.
+ */
+tree_node_t* tree_floorNode (tree_t* self, key_t key)
 {
-    if (NULL == node)
-    {
-        return NULL; // Base case: If the node is null, return null.
-    }
-
-    // Get the size of the left subtree.
-    const size_t left_size = size_of(node->left);
+    tree_node_t* current = self->root;
+    tree_node_t* floor = NULL;
 
-    if (prior + left_size == index)
-    {
-        // If prior + left_size matches the index, we've found the nth node.
-        return node;
-    }
-    else if (prior + left_size > index)
-    {
-        // If the index is less than the size of the left subtree,
-        // we need to search in the left subtree.
-        return find_nth(prior, node->left, index);
-    }
-    else
+    while (current != NULL)
     {
-        // If the index is greater, we search in the right subtree.
-        // Update the prior value to include the current node and left subtree size.
-        return find_nth(prior + left_size + 1, node->right, index);
+        const int ordering = self->comparator(self, &key, &current->key);
+
+        if (ordering == 0)
+        {
+            return current;
+        }
+        else if (ordering < 0)
+        {
+            current = current->left;
+        }
+        else
+        {
+            floor = current;
+            current = current->right;
+        }
     }
+
+    return floor;
 }
 
 /**
- * @brief Finds the nth node (0-based index) in the AVL tree.
+ * @brief Finds the node with the least key greater than or equal to a given key.
  * @param self Pointer to the AVL tree.
- * @param index The index of the node to find.
- * @return Pointer to the nth node or NULL if not found.
+ * @param key Key for which to find the ceiling node.
+ * @return Pointer to the ceiling node or NULL if not found.
  */
-tree_node_t* tree_nthNode (tree_t* self, size_t index)
+tree_node_t* tree_ceilingNode (tree_t* self, key_t key)
 {
-    return find_nth(0, self->root, index);
-}
+    tree_node_t* current = self->root;
+    tree_node_t* ceiling = NULL;
 
+    while (current != NULL)
+    {
+        const int ordering = self->comparator(self, &key, &current->key);
 
+        if (ordering == 0)
+        {
+            return current;
+        }
+        else if (ordering < 0)
+        {
+            ceiling = current;
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
 
-/**
- * @brief Adds a value as the first element in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param value Data value to add.
- * @return true if the addition was successful, false otherwise.
- */
-bool tree_addFirst (tree_t* self, data_t value)
-{
-    return tree_pushFirst(self, value);
+    return ceiling;
 }
 
 /**
- * @brief Adds a value as the last element in the AVL tree.
+ * @brief Finds the lower node, the exact node and the higher node of a given key in a single descent.
  * @param self Pointer to the AVL tree.
- * @param value Data value to add.
- * @return true if the addition was successful, false otherwise.
+ * @param key Key for which to find the neighbors.
+ * @return The lower, exact and higher nodes, each of which is NULL if not found.
  */
-bool tree_addLast (tree_t* self, data_t value)
+tree_neighbors_t tree_neighbors (tree_t* self, key_t key)
 {
-    return tree_pushLast(self, value);
+    tree_neighbors_t result = { NULL, NULL, NULL };
+    tree_node_t* current = self->root;
+
+    while (current != NULL)
+    {
+        const int ordering = self->comparator(self, &key, &current->key);
+
+        if (ordering < 0)
+        {
+            result.higher = current;
+            current = current->left;
+        }
+        else if (ordering > 0)
+        {
+            result.lower = current;
+            current = current->right;
+        }
+        else
+        {
+            // The descent continues to the last node of the left subtree, and to the first node of the right subtree.
+            result.exact = current;
+
+            for (tree_node_t* p = current->left; NULL != p; p = p->right)
+            {
+                result.lower = p;
+            }
+
+            for (tree_node_t* p = current->right; NULL != p; p = p->left)
+            {
+                result.higher = p;
+            }
+
+            break;
+        }
+    }
+
+    return result;
 }
 
-/**
- * @brief Pushes a value to the front of the AVL tree (Deque operation).
- * @param self Pointer to the AVL tree.
- * @param value Data value to push.
- * @return true if the push was successful, false otherwise.
- */
-bool tree_pushFirst (tree_t* self, data_t value)
+static tree_node_t* find_nth (size_t prior, tree_node_t* node, size_t index)
 {
-    tree_node_t* node = tree_firstNode(self);
-
     if (NULL == node)
     {
-        return tree_put(self, 0, value);
+        return NULL; // Base case: If the node is null, return null.
+    }
+
+    // Get the size of the left subtree.
+    const size_t left_size = size_of(node->left);
+
+    if (prior + left_size == index)
+    {
+        // If prior + left_size matches the index, we've found the nth node.
+        return node;
+    }
+    else if (prior + left_size > index)
+    {
+        // If the index is less than the size of the left subtree,
+        // we need to search in the left subtree.
+        return find_nth(prior, node->left, index);
     }
     else
     {
-        return tree_put(self, node->key - 1, value);
+        // If the index is greater, we search in the right subtree.
+        // Update the prior value to include the current node and left subtree size.
+        return find_nth(prior + left_size + 1, node->right, index);
     }
 }
 
 /**
- * @brief Pushes a value to the end of the AVL tree (Deque operation).
+ * @brief Finds the nth node (0-based index) in the AVL tree.
  * @param self Pointer to the AVL tree.
- * @param value Data value to push.
- * @return true if the push was successful, false otherwise.
+ * @param index The index of the node to find.
+ * @return Pointer to the nth node or NULL if not found.
  */
-bool tree_pushLast (tree_t* self, data_t value)
+tree_node_t* tree_nthNode (tree_t* self, size_t index)
 {
-    tree_node_t* node = tree_lastNode(self);
-
-    if (NULL == node)
-    {
-        return tree_put(self, 0, value);
-    }
-    else
-    {
-        return tree_put(self, node->key + 1, value);
-    }
+    return find_nth(0, self->root, index);
 }
 
 /**
- * @brief Pushes a value to the AVL tree (equivalent to pushLast).
+ * @brief Finds the index (0-based) of a key in the AVL tree, which is the inverse of nthNode().
  * @param self Pointer to the AVL tree.
- * @param value Data value to push.
- * @return true if the push was successful, false otherwise.
+ * @param key Key to search for.
+ * @return Index of the key, or SIZE_MAX if the key is not found.
  */
-bool tree_push (tree_t* self, data_t value)
+size_t tree_rankOf (tree_t* self, key_t key)
 {
-    return tree_pushLast(self, value);
-}
+    tree_node_t* node = self->root;
+    size_t prior = 0;
+
+    while (NULL != node)
+    {
+        const int ordering = self->comparator(self, &key, &node->key);
 
+        if (ordering < 0)
+        {
+            node = node->left;
+        }
+        else if (ordering > 0)
+        {
+            // The left subtree and the node itself precede the key.
+            prior += size_of(node->left) + 1;
+            node = node->right;
+        }
+        else
+        {
+            return prior + size_of(node->left);
+        }
+    }
 
+    return SIZE_MAX;
+}
 
 /**
- * @brief Peeks at the last value in the AVL tree.
+ * @brief Finds the index (0-based) of the greatest key, which is less than or equal to a given key.
  * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the floor key, or SIZE_MAX if all of the keys are greater than the given key.
  */
-data_t tree_peek (tree_t* self)
+size_t tree_floorRank (tree_t* self, key_t key)
 {
-    return tree_peekLast(self);
+    tree_node_t* node = self->root;
+    size_t prior = 0;
+    size_t result = SIZE_MAX;
+
+    while (NULL != node)
+    {
+        const int ordering = self->comparator(self, &key, &node->key);
+
+        if (ordering < 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            // This node is the floor, unless a greater key in its right subtree is also not greater than the key.
+            result = prior + size_of(node->left);
+
+            if (0 == ordering)
+            {
+                break;
+            }
+
+            prior = result + 1;
+            node = node->right;
+        }
+    }
+
+    return result;
 }
 
 /**
- * @brief Peeks at the first value in the AVL tree.
+ * @brief Finds the index (0-based) of the least key, which is greater than or equal to a given key.
  * @param self Pointer to the AVL tree.
- * @return First data value in the tree or default value if empty.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the ceiling key, or SIZE_MAX if all of the keys are less than the given key.
  */
-data_t tree_peekFirst (tree_t* self)
+size_t tree_ceilingRank (tree_t* self, key_t key)
 {
-    tree_node_t* node = tree_firstNode(self);
+    tree_node_t* node = self->root;
+    size_t prior = 0;
+    size_t result = SIZE_MAX;
 
-    if (NULL == node)
-    {
-        return tree_defaultValue();
-    }
-    else
+    while (NULL != node)
     {
-        return node->value;
+        const int ordering = self->comparator(self, &key, &node->key);
+
+        if (ordering > 0)
+        {
+            prior += size_of(node->left) + 1;
+            node = node->right;
+        }
+        else
+        {
+            // This node is the ceiling, unless a lesser key in its left subtree is also not less than the key.
+            result = prior + size_of(node->left);
+
+            if (0 == ordering)
+            {
+                break;
+            }
+
+            node = node->left;
+        }
     }
+
+    return result;
 }
 
 /**
- * @brief Peeks at the last value in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
+ * Counts the nodes, whose keys are less than a given key (or less than or equal to it, if inclusive).
  */
-data_t tree_peekLast (tree_t* self)
+static size_t count_below (tree_t* self, key_t key, bool inclusive)
 {
-    tree_node_t* node = tree_lastNode(self);
-
-    if (NULL == node)
+    if (inclusive)
     {
-        return tree_defaultValue();
+        const size_t floor = tree_floorRank(self, key);
+        return SIZE_MAX == floor ? 0 : floor + 1;
     }
     else
     {
-        return node->value;
+        const size_t ceiling = tree_ceilingRank(self, key);
+        return SIZE_MAX == ceiling ? size_of(self->root) : ceiling;
     }
 }
 
 /**
- * @brief Pops the last value from the AVL tree.
+ * @brief Counts the nodes, whose keys are between two bounds, in logarithmic time.
  * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ * @return Number of nodes in the range, which is zero if the range is empty.
  */
-data_t tree_pop (tree_t* self)
+size_t tree_countRange (tree_t* self, key_t lo, bool lo_inclusive, key_t hi, bool hi_inclusive)
 {
-    return tree_popLast(self);
+    const size_t below_hi = count_below(self, hi, hi_inclusive);
+    const size_t below_lo = count_below(self, lo, false == lo_inclusive);
+    return below_hi > below_lo ? below_hi - below_lo : 0;
 }
 
 /**
- * @brief Pops the first value from the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return First data value in the tree or default value if empty.
+ * @brief Creates a random number generator from a seed.
+ * @param seed Seed of the generator; equal seeds produce equal sequences.
+ * @return The random number generator.
  */
-data_t tree_popFirst (tree_t* self)
+tree_random_t tree_random_seed (uint64_t seed)
 {
-    tree_node_t* node = tree_firstNode(self);
+    tree_random_t result;
+    result.state = seed;
+    return result;
+}
 
-    if (NULL == node)
-    {
-        return tree_defaultValue();
-    }
-    else
-    {
-        data_t value = node->value;
-        tree_removeFirst(self);
-        return value;
-    }
+/**
+ * @brief Draws the next random number from a generator.
+ * @param self Pointer to the random number generator.
+ * @return Uniformly distributed 64-bit random number.
+ */
+uint64_t tree_random_next (tree_random_t* self)
+{
+    // splitmix64
+    uint64_t x = (self->state += UINT64_C(0x9E3779B97F4A7C15));
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
 }
 
 /**
- * @brief Pops the last value from the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
+ * A rank to select, and the position in the output, where the node at the rank belongs.
  */
-data_t tree_popLast (tree_t* self)
+typedef struct
 {
-    tree_node_t* node = tree_lastNode(self);
+    size_t rank;
 
-    if (NULL == node)
-    {
-        return tree_defaultValue();
-    }
-    else
-    {
-        data_t value = node->value;
-        tree_removeLast(self);
-        return value;
-    }
+    size_t position;
+
+} tree_selection_t;
+
+static int compare_selections (const void* x, const void* y)
+{
+    const size_t rank_x = ((const tree_selection_t*) x)->rank;
+    const size_t rank_y = ((const tree_selection_t*) y)->rank;
+    return rank_x < rank_y ? -1 : (rank_x > rank_y ? +1 : 0);
 }
 
-bool tree_containsAll (tree_t* self, tree_t* other)
+/**
+ * Finds the nodes at a sorted array of ranks, which are all within a subtree, whose first node has the rank prior.
+ * The ranks are partitioned at each node, so that every node is visited at most once.
+ */
+static void select_nodes (tree_node_t* node, size_t prior, tree_selection_t* selections, size_t count, tree_node_t** out)
 {
-    if (tree_size(self) < tree_size(other))
+    while (count > 0)
     {
-        return false;
-    }
+        const size_t rank = prior + size_of(node->left);
 
-    tree_iterator_t iter = tree_iter(other);
-    {
-        while (tree_iter_hasNext(&iter))
-        {
-            tree_iter_next(&iter);
+        // Binary search for the first selection, whose rank is not below the rank of the node.
+        size_t below = 0;
+        size_t upper = count;
 
-            tree_node_t* node = tree_iter_node(&iter);
+        while (below < upper)
+        {
+            const size_t middle = below + (upper - below) / 2;
 
-            if (tree_containsKey(self, node->key) == false)
+            if (selections[middle].rank < rank)
             {
-                return false;
+                below = middle + 1;
+            }
+            else
+            {
+                upper = middle;
             }
         }
+
+        size_t equal = below;
+
+        while (equal < count && selections[equal].rank == rank)
+        {
+            out[selections[equal++].position] = node;
+        }
+
+        select_nodes(node->left, prior, selections, below, out);
+
+        selections += equal;
+        count -= equal;
+        prior = rank + 1;
+        node = node->right;
     }
-    tree_iter_free(&iter);
-    return true;
 }
 
 /**
- * @brief Copies keys from the tree into an array.
+ * @brief Draws uniformly random nodes (with replacement) from the AVL tree.
  * @param self Pointer to the AVL tree.
- * @param array Array to store keys.
- * @param array_size Size of the provided array.
- * @return Number of keys copied into the array.
+ * @param k Number of nodes to draw.
+ * @param rng Pointer to the random number generator.
+ * @param out Array that receives the k drawn nodes in ascending key order.
+ * @return Number of nodes drawn, which is zero if the tree is empty or memory could not be allocated.
  */
-size_t tree_keysToArray (tree_t* self, key_t* array, size_t array_size)
+size_t tree_sample (tree_t* self, size_t k, tree_random_t* rng, tree_node_t** out)
 {
-    size_t count = 0;
-    tree_iterator_t iter = tree_iter(self);
+    const size_t size = size_of(self->root);
+
+    if (0 == size || 0 == k)
     {
-        for (count = 0; tree_iter_hasNext(&iter) && (count < array_size); count++)
-        {
+        return 0;
+    }
+
+    tree_selection_t* selections = malloc(k * sizeof(tree_selection_t));
+
+    if (NULL == selections)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < k; i++)
+    {
+        // The modulo bias is negligible, since the size is far below 2^64.
+        selections[i].rank = (size_t) (tree_random_next(rng) % size);
+    }
+
+    qsort(selections, k, sizeof(tree_selection_t), &compare_selections);
+
+    for (size_t i = 0; i < k; i++)
+    {
+        selections[i].position = i;
+    }
+
+    select_nodes(self->root, 0, selections, k, out);
+    free(selections);
+    return k;
+}
+
+/**
+ * @brief Finds the nodes at several quantiles of the keys in a single walk over the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param q Quantiles, each of which is between 0 and 1 (values outside are clamped), in any order.
+ * @param m Number of quantiles.
+ * @param out Array that receives the node at each quantile, in the order of the quantiles.
+ * @return true if the nodes were found, false if the tree is empty or memory could not be allocated.
+ */
+bool tree_quantiles (tree_t* self, const double* q, size_t m, tree_node_t** out)
+{
+    const size_t size = size_of(self->root);
+
+    if (0 == size)
+    {
+        return false;
+    }
+    else if (0 == m)
+    {
+        return true;
+    }
+
+    tree_selection_t* selections = malloc(m * sizeof(tree_selection_t));
+
+    if (NULL == selections)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < m; i++)
+    {
+        // NaN is clamped to the first node, too.
+        const double fraction = q[i] > 0 ? (q[i] < 1 ? q[i] : 1) : 0;
+        selections[i].rank = (size_t) (fraction * (double) (size - 1) + 0.5);
+        selections[i].position = i;
+    }
+
+    qsort(selections, m, sizeof(tree_selection_t), &compare_selections);
+    select_nodes(self->root, 0, selections, m, out);
+    free(selections);
+    return true;
+}
+
+/**
+ * @brief Adds a value as the first element in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to add.
+ * @return true if the addition was successful, false otherwise.
+ */
+bool tree_addFirst (tree_t* self, data_t value)
+{
+    return tree_pushFirst(self, value);
+}
+
+/**
+ * @brief Adds a value as the last element in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to add.
+ * @return true if the addition was successful, false otherwise.
+ */
+bool tree_addLast (tree_t* self, data_t value)
+{
+    return tree_pushLast(self, value);
+}
+
+/**
+ * @brief Pushes a value to the front of the AVL tree (Deque operation).
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool tree_pushFirst (tree_t* self, data_t value)
+{
+    tree_node_t* node = tree_firstNode(self);
+
+    if (NULL == node)
+    {
+        return tree_put(self, 0, value);
+    }
+    else
+    {
+        return tree_put(self, node->key - 1, value);
+    }
+}
+
+/**
+ * @brief Pushes a value to the end of the AVL tree (Deque operation).
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool tree_pushLast (tree_t* self, data_t value)
+{
+    tree_node_t* node = tree_lastNode(self);
+
+    if (NULL == node)
+    {
+        return tree_put(self, 0, value);
+    }
+    else
+    {
+        return tree_put(self, node->key + 1, value);
+    }
+}
+
+/**
+ * @brief Pushes a value to the AVL tree (equivalent to pushLast).
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool tree_push (tree_t* self, data_t value)
+{
+    return tree_pushLast(self, value);
+}
+
+/**
+ * @brief Peeks at the last value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+data_t tree_peek (tree_t* self)
+{
+    return tree_peekLast(self);
+}
+
+/**
+ * @brief Peeks at the first value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return First data value in the tree or default value if empty.
+ */
+data_t tree_peekFirst (tree_t* self)
+{
+    tree_node_t* node = tree_firstNode(self);
+
+    if (NULL == node)
+    {
+        return tree_defaultValue();
+    }
+    else
+    {
+        return node->value;
+    }
+}
+
+/**
+ * @brief Peeks at the last value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+data_t tree_peekLast (tree_t* self)
+{
+    tree_node_t* node = tree_lastNode(self);
+
+    if (NULL == node)
+    {
+        return tree_defaultValue();
+    }
+    else
+    {
+        return node->value;
+    }
+}
+
+/**
+ * @brief Pops the last value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+data_t tree_pop (tree_t* self)
+{
+    return tree_popLast(self);
+}
+
+/**
+ * @brief Pops the first value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return First data value in the tree or default value if empty.
+ */
+data_t tree_popFirst (tree_t* self)
+{
+    tree_node_t* node = tree_firstNode(self);
+
+    if (NULL == node)
+    {
+        return tree_defaultValue();
+    }
+    else
+    {
+        data_t value = node->value;
+        tree_removeFirst(self);
+        return value;
+    }
+}
+
+/**
+ * @brief Pops the last value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+data_t tree_popLast (tree_t* self)
+{
+    tree_node_t* node = tree_lastNode(self);
+
+    if (NULL == node)
+    {
+        return tree_defaultValue();
+    }
+    else
+    {
+        data_t value = node->value;
+        tree_removeLast(self);
+        return value;
+    }
+}
+
+bool tree_containsAll (tree_t* self, tree_t* other)
+{
+    if (tree_size(self) < tree_size(other))
+    {
+        return false;
+    }
+
+    tree_iterator_t iter = tree_iter(other);
+    {
+        while (tree_iter_hasNext(&iter))
+        {
+            tree_iter_next(&iter);
+
+            tree_node_t* node = tree_iter_node(&iter);
+
+            if (tree_containsKey(self, node->key) == false)
+            {
+                return false;
+            }
+        }
+    }
+    tree_iter_free(&iter);
+    return true;
+}
+
+/**
+ * @brief Copies keys from the tree into an array.
+ * @param self Pointer to the AVL tree.
+ * @param array Array to store keys.
+ * @param array_size Size of the provided array.
+ * @return Number of keys copied into the array.
+ */
+size_t tree_keysToArray (tree_t* self, key_t* array, size_t array_size)
+{
+    size_t count = 0;
+    tree_iterator_t iter = tree_iter(self);
+    {
+        for (count = 0; tree_iter_hasNext(&iter) && (count < array_size); count++)
+        {
             tree_iter_next(&iter);
             tree_node_t* node = tree_iter_node(&iter);
             array[count] = node->key;
@@ -1405,547 +2171,7918 @@ int64_t tree_sumToInt64 (tree_t* self, int64_t (*functor)(tree_t*, tree_node_t*,
 }
 
 /**
- * @brief Puts all elements from another tree into this tree.
- * @param self Pointer to the current AVL tree.
- * @param other Pointer to the other AVL tree.
- * @return true if all elements were successfully added, false otherwise.
+ * @brief Puts all elements from another tree into this tree.
+ * @param self Pointer to the current AVL tree.
+ * @param other Pointer to the other AVL tree.
+ * @return true if all elements were successfully added, false otherwise.
+ */
+bool tree_putAll (tree_t* self, tree_t* other)
+{
+    tree_iterator_t iter = tree_iter(other);
+    {
+        while (tree_iter_hasNext(&iter))
+        {
+            tree_iter_next(&iter);
+
+            tree_node_t* node = tree_iter_node(&iter);
+
+            if (tree_put(self, node->key, node->value) == false)
+            {
+                return false;
+            }
+        }
+    }
+    tree_iter_free(&iter);
+    return true;
+}
+
+/**
+ * @brief Removes all elements that exist in another tree from this tree.
+ * @param self Pointer to the current AVL tree.
+ * @param other Pointer to the other AVL tree.
+ */
+void tree_removeAll (tree_t* self, tree_t* other)
+{
+    tree_iterator_t iter = tree_iter(other);
+    {
+        while (tree_iter_hasNext(&iter))
+        {
+            tree_iter_next(&iter);
+            tree_node_t* node = tree_iter_node(&iter);
+            tree_remove(self, node->key);
+        }
+    }
+    tree_iter_free(&iter);
+}
+
+/**
+ * @brief Retains only elements that exist in another tree.
+ * @param self Pointer to the current AVL tree.
+ * @param other Pointer to the other AVL tree.
+ */
+void tree_retainAll (tree_t* self, tree_t* other)
+{
+    // The next node is found by key, since removing a node may move the other nodes.
+    for (tree_node_t* node = tree_firstNode(self); NULL != node;)
+    {
+        key_t key = node->key;
+
+        if (tree_containsKey(other, key) == false)
+        {
+            tree_remove(self, key);
+        }
+
+        node = tree_higherNode(self, key);
+    }
+}
+
+/**
+ * Recomputes the hashes and the aggregates along the path from the root to a node, after the value of the node changed.
+ */
+static void update_path (tree_t* self, tree_node_t* node)
+{
+    tree_node_t* path[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+
+    for (tree_node_t* current = self->root; NULL != current;)
+    {
+        path[depth++] = current;
+
+        if (current == node)
+        {
+            break;
+        }
+        else if (self->comparator(self, &node->key, &current->key) < 0)
+        {
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+
+    while (depth > 0)
+    {
+        update_size(path[--depth]);
+    }
+}
+
+/**
+ * @brief Inserts a key-value pair into the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool tree_put (tree_t* self, key_t key, data_t value)
+{
+    tree_node_t* node = NULL;
+    tree_node_t* root = insert_node(self, self->root, &key, &value, &node);
+
+    if (NULL != root)
+    {
+        self->root = root;
+    }
+
+    return NULL != node;
+}
+
+/**
+ * @brief Sets the data value of a node of the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param node Pointer to a node of the tree.
+ * @param value Data value to set.
+ *
+ * Unlike node_set(), this keeps the hashes and aggregates of the node and its ancestors up to date.
+ */
+void tree_setNode (tree_t* self, tree_node_t* node, data_t value)
+{
+    node->value = value;
+    update_path(self, node);
+}
+
+/**
+ * Below this many nodes, the bulk operations do not bother to spawn threads.
+ */
+static const size_t BULK_PARALLEL_CUTOFF = 65536;
+
+/**
+ * Below this many nodes, the merge sort falls back to an insertion sort.
+ */
+static const size_t BULK_INSERTION_CUTOFF = 16;
+
+/**
+ * Upper bound on the number of threads used by a single bulk operation.
+ */
+static const size_t BULK_MAX_THREADS = 64;
+
+/**
+ * Invokes the worker once per task, using one thread per task when threads are available.
+ * The tasks are stored contiguously, each one being stride bytes long.
+ */
+static void run_tasks (void* (*worker)(void*), void* tasks, size_t stride, size_t count)
+{
+    pthread_t threads[count];
+    bool started[count];
+
+    for (size_t i = 1; i < count; i++)
+    {
+        started[i] = 0 == pthread_create(&threads[i], NULL, worker, ((char*) tasks) + i * stride);
+
+        if (started[i] == false)
+        {
+            // Thread creation failed, so do the work on this thread instead.
+            worker(((char*) tasks) + i * stride);
+        }
+    }
+
+    worker(tasks);
+
+    for (size_t i = 1; i < count; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+/**
+ * Decides how many threads are worth using to process the given number of nodes.
+ */
+static size_t bulk_threads (size_t threads, size_t count)
+{
+    const size_t useful = 1 + count / BULK_PARALLEL_CUTOFF;
+    threads = threads < useful ? threads : useful;
+    threads = threads < BULK_MAX_THREADS ? threads : BULK_MAX_THREADS;
+    return threads < 1 ? 1 : threads;
+}
+
+static void insertion_sort_nodes (tree_t* self, tree_node_t** nodes, size_t count)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        tree_node_t* item = nodes[i];
+        size_t j = i;
+
+        // Only move past strictly greater keys, so that equal keys keep their input order.
+        while (j > 0 && self->comparator(self, &nodes[j - 1]->key, &item->key) > 0)
+        {
+            nodes[j] = nodes[j - 1];
+            --j;
+        }
+
+        nodes[j] = item;
+    }
+}
+
+static void merge_nodes (tree_t* self, tree_node_t** left, size_t left_count, tree_node_t** right, size_t right_count, tree_node_t** output)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    while (i < left_count && j < right_count)
+    {
+        // Prefer the left side on ties, so that the merge is stable.
+        if (self->comparator(self, &right[j]->key, &left[i]->key) < 0)
+        {
+            output[k++] = right[j++];
+        }
+        else
+        {
+            output[k++] = left[i++];
+        }
+    }
+
+    memcpy(output + k, left + i, (left_count - i) * sizeof(tree_node_t*));
+    k += left_count - i;
+    memcpy(output + k, right + j, (right_count - j) * sizeof(tree_node_t*));
+}
+
+/**
+ * Stable merge sort by key.
+ * The scratch array must have room for at least count elements.
+ */
+static void merge_sort_nodes (tree_t* self, tree_node_t** nodes, tree_node_t** scratch, size_t count)
+{
+    if (count <= BULK_INSERTION_CUTOFF)
+    {
+        insertion_sort_nodes(self, nodes, count);
+        return;
+    }
+
+    const size_t half = count / 2;
+    merge_sort_nodes(self, nodes, scratch, half);
+    merge_sort_nodes(self, nodes + half, scratch + half, count - half);
+    merge_nodes(self, nodes, half, nodes + half, count - half, scratch);
+    memcpy(nodes, scratch, count * sizeof(tree_node_t*));
+}
+
+static void insertion_sort_ops (tree_t* self, tree_op_t** ops, size_t count)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        tree_op_t* item = ops[i];
+        size_t j = i;
+
+        // Only move past strictly greater keys, so that equal keys keep their input order.
+        while (j > 0 && self->comparator(self, &ops[j - 1]->key, &item->key) > 0)
+        {
+            ops[j] = ops[j - 1];
+            --j;
+        }
+
+        ops[j] = item;
+    }
+}
+
+static void merge_ops (tree_t* self, tree_op_t** left, size_t left_count, tree_op_t** right, size_t right_count, tree_op_t** output)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    while (i < left_count && j < right_count)
+    {
+        // Prefer the left side on ties, so that the merge is stable.
+        if (self->comparator(self, &right[j]->key, &left[i]->key) < 0)
+        {
+            output[k++] = right[j++];
+        }
+        else
+        {
+            output[k++] = left[i++];
+        }
+    }
+
+    memcpy(output + k, left + i, (left_count - i) * sizeof(tree_op_t*));
+    k += left_count - i;
+    memcpy(output + k, right + j, (right_count - j) * sizeof(tree_op_t*));
+}
+
+/**
+ * Stable merge sort by key.
+ * The scratch array must have room for at least count elements.
+ */
+static void merge_sort_ops (tree_t* self, tree_op_t** ops, tree_op_t** scratch, size_t count)
+{
+    if (count <= BULK_INSERTION_CUTOFF)
+    {
+        insertion_sort_ops(self, ops, count);
+        return;
+    }
+
+    const size_t half = count / 2;
+    merge_sort_ops(self, ops, scratch, half);
+    merge_sort_ops(self, ops + half, scratch + half, count - half);
+    merge_ops(self, ops, half, ops + half, count - half, scratch);
+    memcpy(ops, scratch, count * sizeof(tree_op_t*));
+}
+
+typedef struct
+{
+    tree_t* tree;
+
+    tree_node_t** source;
+
+    tree_node_t** target;
+
+    size_t lo;
+
+    size_t middle;
+
+    size_t hi;
+
+} tree_merge_task_t;
+
+static void* merge_sort_worker (void* argument)
+{
+    tree_merge_task_t* task = (tree_merge_task_t*) argument;
+    merge_sort_nodes(task->tree, task->source + task->lo, task->target + task->lo, task->hi - task->lo);
+    return NULL;
+}
+
+static void* merge_worker (void* argument)
+{
+    tree_merge_task_t* task = (tree_merge_task_t*) argument;
+    tree_node_t** left = task->source + task->lo;
+    tree_node_t** right = task->source + task->middle;
+    merge_nodes(task->tree, left, task->middle - task->lo, right, task->hi - task->middle, task->target + task->lo);
+    return NULL;
+}
+
+/**
+ * Stable merge sort, which sorts one run per thread and then merges pairs of runs in parallel.
+ */
+static void parallel_merge_sort_nodes (tree_t* self, tree_node_t** nodes, tree_node_t** scratch, size_t count, size_t threads)
+{
+    size_t bounds[BULK_MAX_THREADS + 1];
+    tree_merge_task_t tasks[BULK_MAX_THREADS];
+    size_t runs = threads;
+
+    for (size_t i = 0; i <= runs; i++)
+    {
+        bounds[i] = (count * i) / runs;
+    }
+
+    for (size_t i = 0; i < runs; i++)
+    {
+        tasks[i].tree = self;
+        tasks[i].source = nodes;
+        tasks[i].target = scratch;
+        tasks[i].lo = bounds[i];
+        tasks[i].middle = bounds[i + 1];
+        tasks[i].hi = bounds[i + 1];
+    }
+
+    run_tasks(&merge_sort_worker, tasks, sizeof(tree_merge_task_t), runs);
+
+    tree_node_t** source = nodes;
+    tree_node_t** target = scratch;
+
+    while (runs > 1)
+    {
+        const size_t merged = (runs + 1) / 2;
+
+        for (size_t i = 0; i < merged; i++)
+        {
+            // An odd run out is merged with an empty run, which simply copies it.
+            tasks[i].tree = self;
+            tasks[i].source = source;
+            tasks[i].target = target;
+            tasks[i].lo = bounds[2 * i];
+            tasks[i].middle = bounds[2 * i + 1];
+            tasks[i].hi = bounds[2 * i + 2 <= runs ? 2 * i + 2 : runs];
+        }
+
+        run_tasks(&merge_worker, tasks, sizeof(tree_merge_task_t), merged);
+
+        for (size_t i = 0; i < merged; i++)
+        {
+            bounds[i] = tasks[i].lo;
+        }
+
+        bounds[merged] = count;
+        runs = merged;
+
+        tree_node_t** swap = source;
+        source = target;
+        target = swap;
+    }
+
+    if (source != nodes)
+    {
+        memcpy(nodes, source, count * sizeof(tree_node_t*));
+    }
+}
+
+/**
+ * Maps a key onto an unsigned integer with the same ordering.
+ * Signed keys are biased, so that negative keys sort before the positive keys.
+ */
+static uint64_t radix_key_of (tree_node_t* node)
+{
+    const bool is_signed = ((key_t) -1) < ((key_t) 0);
+    const uint64_t bias = is_signed ? (UINT64_C(1) << (8 * sizeof(key_t) - 1)) : 0;
+    return ((uint64_t) node->key) + bias;
+}
+
+typedef struct
+{
+    tree_node_t** source;
+
+    tree_node_t** target;
+
+    size_t lo;
+
+    size_t hi;
+
+    uint32_t shift;
+
+    size_t counts[256];
+
+} tree_radix_task_t;
+
+static void* radix_count_worker (void* argument)
+{
+    tree_radix_task_t* task = (tree_radix_task_t*) argument;
+
+    memset(task->counts, 0, sizeof(task->counts));
+
+    for (size_t i = task->lo; i < task->hi; i++)
+    {
+        ++task->counts[(radix_key_of(task->source[i]) >> task->shift) & 0xFF];
+    }
+
+    return NULL;
+}
+
+static void* radix_scatter_worker (void* argument)
+{
+    tree_radix_task_t* task = (tree_radix_task_t*) argument;
+
+    // By now, the counts have been turned into the output offsets of this task.
+    for (size_t i = task->lo; i < task->hi; i++)
+    {
+        const size_t digit = (radix_key_of(task->source[i]) >> task->shift) & 0xFF;
+        task->target[task->counts[digit]++] = task->source[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Stable least-significant-digit radix sort of the nodes by key, one byte per pass.
+ * Each pass histograms and scatters a contiguous chunk of the nodes per thread.
+ * Returns false, if the per-thread histograms could not be allocated.
+ */
+static bool radix_sort_nodes (tree_node_t** nodes, tree_node_t** scratch, size_t count, size_t threads)
+{
+    tree_radix_task_t* tasks = (tree_radix_task_t*) calloc(threads, sizeof(tree_radix_task_t));
+
+    if (NULL == tasks)
+    {
+        return false;
+    }
+
+    tree_node_t** source = nodes;
+    tree_node_t** target = scratch;
+
+    for (uint32_t pass = 0; pass < sizeof(key_t); pass++)
+    {
+        for (size_t t = 0; t < threads; t++)
+        {
+            tasks[t].source = source;
+            tasks[t].target = target;
+            tasks[t].lo = (count * t) / threads;
+            tasks[t].hi = (count * (t + 1)) / threads;
+            tasks[t].shift = 8 * pass;
+        }
+
+        run_tasks(&radix_count_worker, tasks, sizeof(tree_radix_task_t), threads);
+
+        // Convert the histograms into output offsets, digit-major and then task-major.
+        size_t offset = 0;
+        bool trivial = false;
+
+        for (size_t digit = 0; digit < 256; digit++)
+        {
+            const size_t start = offset;
+
+            for (size_t t = 0; t < threads; t++)
+            {
+                const size_t n = tasks[t].counts[digit];
+                tasks[t].counts[digit] = offset;
+                offset += n;
+            }
+
+            trivial = trivial || (offset - start == count);
+        }
+
+        if (trivial)
+        {
+            continue; // Every key has the same digit, so this pass would not change anything.
+        }
+
+        run_tasks(&radix_scatter_worker, tasks, sizeof(tree_radix_task_t), threads);
+
+        tree_node_t** swap = source;
+        source = target;
+        target = swap;
+    }
+
+    if (source != nodes)
+    {
+        memcpy(nodes, source, count * sizeof(tree_node_t*));
+    }
+
+    free(tasks);
+    return true;
+}
+
+/**
+ * Stable sort of the nodes by key.
+ * The scratch array must have room for at least count nodes.
+ */
+static void sort_nodes (tree_t* self, tree_node_t** nodes, tree_node_t** scratch, size_t count, size_t threads)
+{
+    threads = bulk_threads(threads, count);
+
+    // The radix sort only agrees with the natural ordering.
+    if (self->comparator == &tree_naturalOrder && radix_sort_nodes(nodes, scratch, count, threads))
+    {
+        return;
+    }
+
+    if (threads > 1)
+    {
+        parallel_merge_sort_nodes(self, nodes, scratch, count, threads);
+    }
+    else
+    {
+        merge_sort_nodes(self, nodes, scratch, count);
+    }
+}
+
+/**
+ * Removes all but the last node of each run of equal keys in a sorted array of nodes.
+ * The removed nodes are released back to the allocator.
+ */
+static size_t unique_nodes (tree_t* self, tree_node_t** nodes, size_t count)
+{
+    size_t kept = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i + 1 < count && self->comparator(self, &nodes[i]->key, &nodes[i + 1]->key) == 0)
+        {
+            self->allocator->release(self->allocator, nodes[i]);
+        }
+        else
+        {
+            nodes[kept++] = nodes[i];
+        }
+    }
+
+    return kept;
+}
+
+/**
+ * Merges the existing nodes of a tree with a sorted array of new nodes.
+ * When a key is present on both sides, the existing node survives and takes the new value.
+ */
+static size_t union_nodes (tree_t* self, tree_node_t** existing, size_t existing_count, tree_node_t** fresh, size_t fresh_count, tree_node_t** output)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    while (i < existing_count && j < fresh_count)
+    {
+        const int ordering = self->comparator(self, &existing[i]->key, &fresh[j]->key);
+
+        if (ordering < 0)
+        {
+            output[k++] = existing[i++];
+        }
+        else if (ordering > 0)
+        {
+            output[k++] = fresh[j++];
+        }
+        else
+        {
+            existing[i]->value = fresh[j]->value;
+            self->allocator->release(self->allocator, fresh[j++]);
+            output[k++] = existing[i++];
+        }
+    }
+
+    memcpy(output + k, existing + i, (existing_count - i) * sizeof(tree_node_t*));
+    k += existing_count - i;
+    memcpy(output + k, fresh + j, (fresh_count - j) * sizeof(tree_node_t*));
+    k += fresh_count - j;
+
+    return k;
+}
+
+/**
+ * Stores the nodes of a subtree into an array in ascending order.
+ * Returns the index just past the last stored node.
+ */
+static size_t flatten_nodes (tree_node_t* node, tree_node_t** array, size_t index)
+{
+    if (NULL == node)
+    {
+        return index;
+    }
+
+    index = flatten_nodes(node->left, array, index);
+    array[index++] = node;
+    return flatten_nodes(node->right, array, index);
+}
+
+/**
+ * Links a sorted array of nodes into a perfectly balanced tree without any key comparisons.
+ */
+static tree_node_t* build_balanced (tree_node_t** nodes, size_t count)
+{
+    if (0 == count)
+    {
+        return NULL;
+    }
+
+    const size_t middle = count / 2;
+    tree_node_t* node = nodes[middle];
+    node->left = build_balanced(nodes, middle);
+    node->right = build_balanced(nodes + middle + 1, count - middle - 1);
+    update_height(node);
+    update_size(node);
+    return node;
+}
+
+typedef struct
+{
+    tree_node_t** nodes;
+
+    size_t count;
+
+    size_t threads;
+
+    tree_node_t* root;
+
+} tree_build_task_t;
+
+static tree_node_t* build_balanced_parallel (tree_node_t** nodes, size_t count, size_t threads);
+
+static void* build_balanced_worker (void* argument)
+{
+    tree_build_task_t* task = (tree_build_task_t*) argument;
+    task->root = build_balanced_parallel(task->nodes, task->count, task->threads);
+    return NULL;
+}
+
+/**
+ * Same as build_balanced(), except that the two subtrees of large enough trees are built concurrently.
+ */
+static tree_node_t* build_balanced_parallel (tree_node_t** nodes, size_t count, size_t threads)
+{
+    if (threads <= 1 || count < BULK_PARALLEL_CUTOFF)
+    {
+        return build_balanced(nodes, count);
+    }
+
+    const size_t middle = count / 2;
+
+    tree_build_task_t tasks[2];
+    tasks[0].nodes = nodes;
+    tasks[0].count = middle;
+    tasks[0].threads = threads / 2;
+    tasks[1].nodes = nodes + middle + 1;
+    tasks[1].count = count - middle - 1;
+    tasks[1].threads = threads - threads / 2;
+
+    run_tasks(&build_balanced_worker, tasks, sizeof(tree_build_task_t), 2);
+
+    tree_node_t* node = nodes[middle];
+    node->left = tasks[0].root;
+    node->right = tasks[1].root;
+    update_height(node);
+    update_size(node);
+    return node;
+}
+
+static bool put_arrays (tree_t* self, key_t* keys, data_t* values, size_t count, size_t threads)
+{
+    if (0 == count)
+    {
+        return true;
+    }
+
+    const size_t total = self->size + count;
+    tree_node_t** fresh = (tree_node_t**) malloc(total * sizeof(tree_node_t*));
+    tree_node_t** scratch = (tree_node_t**) malloc(total * sizeof(tree_node_t*));
+
+    if (NULL == fresh || NULL == scratch)
+    {
+        free(fresh);
+        free(scratch);
+        return false;
+    }
+
+    // Allocate all of the nodes up front, so that a failure leaves the tree untouched.
+    for (size_t i = 0; i < count; i++)
+    {
+        tree_node_t* node = self->allocator->allocate(self->allocator);
+
+        if (NULL == node)
+        {
+            while (i > 0)
+            {
+                self->allocator->release(self->allocator, fresh[--i]);
+            }
+
+            free(fresh);
+            free(scratch);
+            return false;
+        }
+
+        node->key = keys[i];
+        node->value = values[i];
+        node->height = 0;
+        node->size = 1;
+        node->left = NULL;
+        node->right = NULL;
+        fresh[i] = node;
+    }
+
+    sort_nodes(self, fresh, scratch, count, threads);
+    const size_t unique = unique_nodes(self, fresh, count);
+
+    // The existing nodes are stored just past the new nodes, which leaves the scratch array free for the merge.
+    tree_node_t** existing = fresh + count;
+    const size_t existing_count = flatten_nodes(self->root, existing, 0);
+    const size_t merged = union_nodes(self, existing, existing_count, fresh, unique, scratch);
+
+    self->root = build_balanced_parallel(scratch, merged, bulk_threads(threads, merged));
+    self->size = merged;
+
+    free(fresh);
+    free(scratch);
+    return true;
+}
+
+/**
+ * @brief Inserts many key-value pairs at once by sorting them and rebuilding the tree in linear time.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool tree_putArrays (tree_t* self, key_t* keys, data_t* values, size_t count)
+{
+    return put_arrays(self, keys, values, count, 1);
+}
+
+/**
+ * @brief Inserts many key-value pairs at once, sorting and building the tree using multiple threads.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @param threads Maximum number of threads to use.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool tree_putArraysParallel (tree_t* self, key_t* keys, data_t* values, size_t count, size_t threads)
+{
+    return put_arrays(self, keys, values, count, threads);
+}
+
+/**
+ * @brief Streams the key-value pairs of the AVL tree, in ascending order, into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs passed to the sink at once.
+ * @param sink Function receiving each chunk (keys and values, index for index), which returns false to stop the export.
+ * @param context Additional context passed to the sink.
+ * @return true if every pair was passed to the sink, false if the sink stopped the export or a buffer could not be allocated.
+ *
+ * The tree is traversed once, and only two buffers of chunk_size elements are allocated.
+ * The sink must not modify the tree.
+ */
+bool tree_export (tree_t* self, size_t chunk_size, bool (*sink)(tree_t*, key_t*, data_t*, size_t, void*), void* context)
+{
+    if (0 == self->size)
+    {
+        return true;
+    }
+
+    // No chunk needs to be larger than the tree.
+    chunk_size = chunk_size < 1 ? 1 : (chunk_size > self->size ? self->size : chunk_size);
+
+    key_t* keys = (key_t*) malloc(chunk_size * sizeof(key_t));
+    data_t* values = (data_t*) malloc(chunk_size * sizeof(data_t));
+    bool ok = NULL != keys && NULL != values;
+
+    // Iterative in-order traversal, which needs no parent pointers.
+    tree_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    size_t length = 0;
+    tree_node_t* node = self->root;
+
+    while (ok && (NULL != node || depth > 0))
+    {
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        keys[length] = node->key;
+        values[length] = node->value;
+        node = node->right;
+
+        if (++length == chunk_size)
+        {
+            ok = sink(self, keys, values, length, context);
+            length = 0;
+        }
+    }
+
+    if (ok && length > 0)
+    {
+        ok = sink(self, keys, values, length, context);
+    }
+
+    free(keys);
+    free(values);
+    return ok;
+}
+
+/**
+ * @brief Inserts the key-value pairs produced by a source, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs requested from the source at once.
+ * @param source Function filling at most chunk_size keys and values, which returns the number of pairs filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If the pairs arrive in strictly ascending order, as produced by tree_export(), then the tree is built
+ * in linear time without sorting. Otherwise, the pairs are sorted first, and the last occurrence of a key wins.
+ */
+bool tree_import (tree_t* self, size_t chunk_size, size_t (*source)(tree_t*, key_t*, data_t*, size_t, void*), void* context)
+{
+    chunk_size = chunk_size < 1 ? 1 : chunk_size;
+
+    key_t* keys = (key_t*) malloc(chunk_size * sizeof(key_t));
+    data_t* values = (data_t*) malloc(chunk_size * sizeof(data_t));
+    tree_node_t** fresh = NULL;
+    tree_node_t** scratch = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool ok = NULL != keys && NULL != values;
+    bool sorted = true;
+
+    // Allocate all of the nodes, before the tree is touched, so that a failure leaves the tree unchanged.
+    while (ok)
+    {
+        const size_t length = source(self, keys, values, chunk_size, context);
+
+        if (0 == length)
+        {
+            break;
+        }
+
+        if (count + length > capacity)
+        {
+            capacity = 2 * (count + length);
+            tree_node_t** grown = (tree_node_t**) realloc(fresh, capacity * sizeof(tree_node_t*));
+            ok = NULL != grown;
+            fresh = ok ? grown : fresh;
+        }
+
+        for (size_t i = 0; ok && i < length; i++)
+        {
+            tree_node_t* node = self->allocator->allocate(self->allocator);
+
+            if (NULL == node)
+            {
+                ok = false;
+                break;
+            }
+
+            node->key = keys[i];
+            node->value = values[i];
+            node->height = 0;
+            node->size = 1;
+            node->left = NULL;
+            node->right = NULL;
+            sorted = sorted && (0 == count || self->comparator(self, &fresh[count - 1]->key, &node->key) < 0);
+            fresh[count++] = node;
+        }
+    }
+
+    free(keys);
+    free(values);
+
+    // Room for the existing nodes, and a scratch array, are only needed to sort or to merge.
+    if (ok && (false == sorted || self->size > 0))
+    {
+        tree_node_t** grown = (tree_node_t**) realloc(fresh, (count + self->size + 1) * sizeof(tree_node_t*));
+        fresh = NULL != grown ? grown : fresh;
+        scratch = (tree_node_t**) malloc((count + self->size + 1) * sizeof(tree_node_t*));
+        ok = NULL != grown && NULL != scratch;
+    }
+
+    if (false == ok)
+    {
+        while (count > 0)
+        {
+            self->allocator->release(self->allocator, fresh[--count]);
+        }
+    }
+    else
+    {
+        if (false == sorted)
+        {
+            sort_nodes(self, fresh, scratch, count, 1);
+            count = unique_nodes(self, fresh, count);
+        }
+
+        if (0 == self->size)
+        {
+            self->root = build_balanced(fresh, count);
+            self->size = count;
+        }
+        else
+        {
+            // The existing nodes are stored just past the new nodes, which leaves the scratch array free for the merge.
+            tree_node_t** existing = fresh + count;
+            const size_t existing_count = flatten_nodes(self->root, existing, 0);
+            const size_t merged = union_nodes(self, existing, existing_count, fresh, count, scratch);
+
+            self->root = build_balanced(scratch, merged);
+            self->size = merged;
+        }
+    }
+
+    free(fresh);
+    free(scratch);
+    return ok;
+}
+
+typedef struct
+{
+    /**
+     * Room for the nodes of the largest subtree that a batch can create.
+     */
+    tree_node_t** nodes;
+
+    /**
+     * Nodes allocated up front, one for each put, of which the puts into empty subtrees take theirs.
+     */
+    tree_node_t** pool;
+
+    /**
+     * Number of nodes left in the pool.
+     */
+    size_t available;
+
+} tree_batch_t;
+
+/**
+ * Applies a sorted run of operations, which have distinct keys, to a subtree.
+ * Returns the new root of the subtree.
+ */
+static tree_node_t* apply_ops (tree_t* self, tree_node_t* node, tree_op_t** ops, size_t count, tree_batch_t* batch)
+{
+    if (0 == count)
+    {
+        return node;
+    }
+    else if (NULL == node)
+    {
+        // There is nothing here to remove, but the puts become a new balanced subtree.
+        size_t created = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (ops[i]->remove == false)
+            {
+                tree_node_t* fresh = init_node(self, batch->pool[--batch->available], &ops[i]->key);
+                fresh->value = ops[i]->value;
+                batch->nodes[created++] = fresh;
+            }
+        }
+
+        return build_balanced(batch->nodes, created);
+    }
+
+    // Find the first operation, whose key is not less than the key of this node.
+    size_t lo = 0;
+    size_t hi = count;
+
+    while (lo < hi)
+    {
+        const size_t middle = lo + (hi - lo) / 2;
+
+        if (self->comparator(self, &ops[middle]->key, &node->key) < 0)
+        {
+            lo = middle + 1;
+        }
+        else
+        {
+            hi = middle;
+        }
+    }
+
+    const bool match = lo < count && self->comparator(self, &ops[lo]->key, &node->key) == 0;
+    const size_t after = match ? lo + 1 : lo;
+
+    tree_node_t* left = apply_ops(self, node->left, ops, lo, batch);
+    tree_node_t* right = apply_ops(self, node->right, ops + after, count - after, batch);
+
+    if (match && ops[lo]->remove)
+    {
+        self->allocator->release(self->allocator, node);
+        --self->size;
+        return join_trees(left, right);
+    }
+    else if (match)
+    {
+        node->value = ops[lo]->value;
+    }
+
+    return join_nodes(left, node, right);
+}
+
+/**
+ * @brief Applies a batch of put and remove operations in one pass over the tree.
+ * @param self Pointer to the AVL tree.
+ * @param ops Operations to apply, preferably sorted by key.
+ * @param count Number of operations in the batch.
+ * @return true if all of the operations were applied, false otherwise (the tree is then left unchanged).
+ *
+ * When several operations have the same key, the last one wins.
+ * Unsorted batches are sorted internally, without modifying the given array.
+ * A node is allocated up front for each put, before the tree is touched, and the nodes of puts that overwrite an existing key are released afterwards.
+ */
+bool tree_applyBatch (tree_t* self, tree_op_t* ops, size_t count)
+{
+    if (0 == count)
+    {
+        return true;
+    }
+
+    tree_op_t** sorted = (tree_op_t**) malloc(count * sizeof(tree_op_t*));
+    tree_node_t** nodes = (tree_node_t**) malloc(count * sizeof(tree_node_t*));
+    tree_node_t** pool = (tree_node_t**) malloc(count * sizeof(tree_node_t*));
+
+    if (NULL == sorted || NULL == nodes || NULL == pool)
+    {
+        free(sorted);
+        free(nodes);
+        free(pool);
+        return false;
+    }
+
+    bool in_order = true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        sorted[i] = &ops[i];
+        in_order = in_order && (i == 0 || self->comparator(self, &ops[i - 1].key, &ops[i].key) < 0);
+    }
+
+    if (in_order == false)
+    {
+        // The node array is not needed yet, so it can double as the scratch space.
+        merge_sort_ops(self, sorted, (tree_op_t**) nodes, count);
+    }
+
+    // Keep only the last operation of each run of equal keys.
+    size_t unique = 0;
+    size_t puts = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i + 1 == count || self->comparator(self, &sorted[i]->key, &sorted[i + 1]->key) != 0)
+        {
+            puts += sorted[i]->remove == false;
+            sorted[unique++] = sorted[i];
+        }
+    }
+
+    // Allocate a node for every put up front, so that a failure leaves the tree untouched.
+    tree_batch_t batch;
+    batch.nodes = nodes;
+    batch.pool = pool;
+    batch.available = 0;
+
+    while (batch.available < puts)
+    {
+        tree_node_t* node = self->allocator->allocate(self->allocator);
+
+        if (NULL == node)
+        {
+            break;
+        }
+
+        pool[batch.available++] = node;
+    }
+
+    const bool ok = batch.available == puts;
+
+    if (ok)
+    {
+        self->root = apply_ops(self, self->root, sorted, unique, &batch);
+    }
+
+    // Release the nodes of the puts, which overwrote an existing key, or all of them, if the batch failed.
+    while (batch.available > 0)
+    {
+        self->allocator->release(self->allocator, pool[--batch.available]);
+    }
+
+    free(sorted);
+    free(nodes);
+    free(pool);
+    return ok;
+}
+
+/**
+ * Number of operations that a diff passes to its sink at once.
+ */
+#define DIFF_CHUNK 1024
+
+/**
+ * An entry on the stack of a diff, which is either a subtree that has not been expanded yet, or a node to visit.
+ */
+typedef struct
+{
+    tree_node_t* node;
+
+    bool subtree;
+
+} tree_diff_entry_t;
+
+/**
+ * Replaces the subtree on top of a stack with its right subtree, its root, and its left subtree.
+ */
+static void diff_expand (tree_diff_entry_t* stack, size_t* depth)
+{
+    tree_node_t* node = stack[--*depth].node;
+
+    if (NULL != node)
+    {
+        stack[*depth].node = node->right;
+        stack[(*depth)++].subtree = true;
+        stack[*depth].node = node;
+        stack[(*depth)++].subtree = false;
+        stack[*depth].node = node->left;
+        stack[(*depth)++].subtree = true;
+    }
+}
+
+/**
+ * @brief Computes the operations that turn one AVL tree into another, and streams them into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree, which is the starting point.
+ * @param other Pointer to the AVL tree, which is the goal, and which must use the same comparator.
+ * @param sink Function receiving each chunk of operations, which returns false to stop the diff.
+ * @param context Additional context passed to the sink.
+ * @return true if every operation was passed to the sink, false if the sink stopped the diff or a buffer could not be allocated.
+ *
+ * Both trees are walked in order, side by side, which takes linear time. Only keys that are missing from
+ * the goal are removed, and only keys that are new or whose values differ (byte for byte) are put.
+ * Since the operations are sorted by key and the keys are distinct, tree_applyBatch() applies them in a single pass.
+ */
+bool tree_diff (tree_t* self, tree_t* other, bool (*sink)(tree_t*, tree_op_t*, size_t, void*), void* context)
+{
+    tree_op_t* ops = (tree_op_t*) malloc(DIFF_CHUNK * sizeof(tree_op_t));
+    tree_diff_entry_t left[2 * TREE_MAX_HEIGHT + 1];
+    tree_diff_entry_t right[2 * TREE_MAX_HEIGHT + 1];
+    size_t left_depth = 1;
+    size_t right_depth = 1;
+    size_t count = 0;
+    bool ok = NULL != ops;
+
+    left[0].node = self->root;
+    left[0].subtree = true;
+    right[0].node = other->root;
+    right[0].subtree = true;
+
+    while (ok && (left_depth > 0 || right_depth > 0))
+    {
+        tree_diff_entry_t* a = left_depth > 0 ? &left[left_depth - 1] : NULL;
+        tree_diff_entry_t* b = right_depth > 0 ? &right[right_depth - 1] : NULL;
+
+        // Expand the subtrees on top of the stacks, until both sides are at a node.
+        if (NULL != a && a->subtree)
+        {
+            diff_expand(left, &left_depth);
+            continue;
+        }
+        else if (NULL != b && b->subtree)
+        {
+            diff_expand(right, &right_depth);
+            continue;
+        }
+
+        // Both sides are at a node (or exhausted), so their keys can be merged.
+        const int ordering = NULL == a ? +1 : (NULL == b ? -1 : self->comparator(self, &a->node->key, &b->node->key));
+
+        if (ordering < 0)
+        {
+            ops[count].remove = true;
+            ops[count].key = a->node->key;
+            ops[count].value = tree_defaultValue();
+            ++count;
+            --left_depth;
+        }
+        else if (ordering > 0)
+        {
+            ops[count].remove = false;
+            ops[count].key = b->node->key;
+            ops[count].value = b->node->value;
+            ++count;
+            --right_depth;
+        }
+        else
+        {
+            if (0 != memcmp(&a->node->value, &b->node->value, sizeof(data_t)))
+            {
+                ops[count].remove = false;
+                ops[count].key = b->node->key;
+                ops[count].value = b->node->value;
+                ++count;
+            }
+
+            --left_depth;
+            --right_depth;
+        }
+
+        if (DIFF_CHUNK == count)
+        {
+            ok = sink(self, ops, count, context);
+            count = 0;
+        }
+    }
+
+    if (ok && count > 0)
+    {
+        ok = sink(self, ops, count, context);
+    }
+
+    free(ops);
+    return ok;
+}
+
+/**
+ * @brief Applies the operations produced by a source, one chunk at a time, such as a diff received from another process.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of operations requested from the source at once.
+ * @param source Function filling at most chunk_size operations, which returns the number of operations filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if all of the operations were applied, false if a buffer or a node could not be allocated.
+ */
+bool tree_applyPatch (tree_t* self, size_t chunk_size, size_t (*source)(tree_t*, tree_op_t*, size_t, void*), void* context)
+{
+    chunk_size = chunk_size < 1 ? 1 : chunk_size;
+    tree_op_t* ops = (tree_op_t*) malloc(chunk_size * sizeof(tree_op_t));
+    bool ok = NULL != ops;
+
+    while (ok)
+    {
+        const size_t count = source(self, ops, chunk_size, context);
+
+        if (0 == count)
+        {
+            break;
+        }
+
+        ok = tree_applyBatch(self, ops, count);
+    }
+
+    free(ops);
+    return ok;
+}
+
+/**
+ * @brief Retrieves the value associated with a key in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+data_t tree_get (tree_t* self, key_t key)
+{
+    tree_node_t* node = tree_getNode(self, key);
+
+    if (NULL == node)
+    {
+        return tree_defaultValue();
+    }
+    else
+    {
+        return node->value;
+    }
+}
+
+/**
+ * Number of lookups, whose descents are interleaved, so that their cache misses overlap.
+ */
+#define GET_MANY_LANES 16
+
+static void prefetch_node (tree_node_t* node)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(node);
+#endif
+}
+
+/**
+ * Looks up unsorted probes by advancing several descents one level at a time in turn.
+ * Each step prefetches the next node of its descent, which is loaded, while the other descents take their steps.
+ */
+static size_t get_interleaved (tree_t* self, key_t* keys, data_t* values, bool* found, size_t count)
+{
+    tree_node_t* nodes[GET_MANY_LANES];
+    size_t probes[GET_MANY_LANES];
+    size_t lanes = 0;
+    size_t next = 0;
+    size_t hits = 0;
+
+    while (lanes < GET_MANY_LANES && next < count)
+    {
+        nodes[lanes] = self->root;
+        probes[lanes++] = next++;
+    }
+
+    while (lanes > 0)
+    {
+        for (size_t lane = 0; lane < lanes;)
+        {
+            tree_node_t* node = nodes[lane];
+            const size_t probe = probes[lane];
+            const int ordering = NULL == node ? 0 : self->comparator(self, &keys[probe], &node->key);
+
+            if (NULL != node && 0 != ordering)
+            {
+                nodes[lane] = ordering < 0 ? node->left : node->right;
+                prefetch_node(nodes[lane]);
+                ++lane;
+                continue;
+            }
+            else if (NULL != node)
+            {
+                values[probe] = node->value;
+                hits++;
+
+                if (NULL != found)
+                {
+                    found[probe] = true;
+                }
+            }
+
+            // The lane is finished; hence, it starts the next probe, or it is replaced by the last lane.
+            if (next < count)
+            {
+                nodes[lane] = self->root;
+                probes[lane] = next++;
+            }
+            else
+            {
+                --lanes;
+                nodes[lane] = nodes[lanes];
+                probes[lane] = probes[lanes];
+            }
+        }
+    }
+
+    return hits;
+}
+
+/**
+ * @brief Retrieves the values associated with many keys in the AVL tree, overlapping their lookups.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
+ */
+size_t tree_getMany (tree_t* self, key_t* keys, data_t* values, bool* found, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = tree_defaultValue();
+
+        if (NULL != found)
+        {
+            found[i] = false;
+        }
+    }
+
+    return get_interleaved(self, keys, values, found, count);
+}
+
+/**
+ * @brief Removes a key and its value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to remove.
+ */
+void tree_remove (tree_t* self, key_t key)
+{
+    tree_node_t* deleted = NULL;
+    self->root = delete_node(self, self->root, &key, &deleted);
+
+    if (NULL != deleted)
+    {
+        self->allocator->release(self->allocator, deleted);
+        --self->size;
+    }
+}
+
+/**
+ * @brief Removes the first value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ */
+void tree_removeFirst (tree_t* self)
+{
+    tree_node_t* node = tree_firstNode(self);
+
+    if (NULL != node)
+    {
+        tree_remove(self, node->key);
+    }
+}
+
+/**
+ * @brief Removes the last value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ */
+void tree_removeLast (tree_t* self)
+{
+    tree_node_t* node = tree_lastNode(self);
+
+    if (NULL != node)
+    {
+        tree_remove(self, node->key);
+    }
+}
+
+/**
+ * @brief Removes nodes from the tree based on a predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ */
+void tree_removeIf (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    // The next node is found by key, since removing a node may move the other nodes.
+    for (tree_node_t* node = tree_firstNode(self); NULL != node;)
+    {
+        key_t key = node->key;
+
+        if (predicate(self, node, context))
+        {
+            tree_remove(self, key);
+        }
+
+        node = tree_higherNode(self, key);
+    }
+}
+
+/**
+ * Releases the nodes of a detached subtree in ascending order, after passing each one to the callback.
+ */
+static void release_nodes (tree_t* self, tree_node_t* node, void (*callback)(tree_t*, tree_node_t*, void*), void* context)
+{
+    while (NULL != node)
+    {
+        release_nodes(self, node->left, callback, context);
+
+        if (NULL != callback)
+        {
+            callback(self, node, context);
+        }
+
+        // The right subtree is released iteratively, since it is read after the node is released.
+        tree_node_t* right = node->right;
+        self->allocator->release(self->allocator, node);
+        node = right;
+    }
+}
+
+/**
+ * @brief Removes the nodes, whose keys are in a half-open range, in O(log n + k) time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Inclusive lower bound of the keys.
+ * @param hi Exclusive upper bound of the keys.
+ * @param callback Function that receives each removed node, in ascending order, before it is released, or NULL.
+ * @param context Additional context passed to the callback.
+ * @return Number of removed nodes.
+ */
+size_t tree_removeRange (tree_t* self, key_t lo, key_t hi, void (*callback)(tree_t*, tree_node_t*, void*), void* context)
+{
+    if (self->comparator(self, &lo, &hi) >= 0)
+    {
+        return 0;
+    }
+
+    tree_node_t* lesser = NULL;
+    tree_node_t* rest = NULL;
+    tree_node_t* range = NULL;
+    tree_node_t* greater = NULL;
+
+    split_nodes(self, self->root, &lo, &lesser, &rest);
+    split_nodes(self, rest, &hi, &range, &greater);
+
+    const size_t removed = size_of(range);
+    self->root = join_trees(lesser, greater);
+    self->size -= removed;
+
+    release_nodes(self, range, callback, context);
+    return removed;
+}
+
+/**
+ * @brief Applies a function to each node in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param functor Function to apply to each node.
+ * @param context Additional context passed to the functor.
+ */
+void tree_forEach (tree_t* self, void (*functor)(tree_t*, tree_node_t*, void*), void* context)
+{
+    tree_iterator_t iter = tree_iter(self);
+    {
+        while (tree_iter_hasNext(&iter))
+        {
+            tree_iter_next(&iter);
+            tree_node_t* node = tree_iter_node(&iter);
+            functor(self, node, context);
+        }
+    }
+    tree_iter_free(&iter);
+}
+
+/**
+ * Finds the first node in key order, whose key is in a half-open range (where NULL means unbounded),
+ * and for which the predicate returns the wanted result. Subtrees outside of the range are skipped.
+ */
+static tree_node_t* find_match (tree_t* self, tree_node_t* node, key_t* lo, key_t* hi, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context, bool wanted)
+{
+    while (NULL != node)
+    {
+        if (NULL != lo && self->comparator(self, &node->key, lo) < 0)
+        {
+            node = node->right;
+        }
+        else if (NULL != hi && self->comparator(self, &node->key, hi) >= 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            // The node is in the range; hence, its left subtree is below the upper bound,
+            // and its right subtree is above the lower bound.
+            tree_node_t* found = find_match(self, node->left, lo, NULL, predicate, context, wanted);
+
+            if (NULL != found)
+            {
+                return found;
+            }
+            else if (predicate(self, node, context) == wanted)
+            {
+                return node;
+            }
+
+            node = node->right;
+            lo = NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static size_t count_matches (tree_t* self, tree_node_t* node, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    size_t count = 0;
+
+    while (NULL != node)
+    {
+        count += count_matches(self, node->left, predicate, context);
+        count += predicate(self, node, context) ? 1 : 0;
+        node = node->right;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Checks if any nodes match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if any match found, false otherwise.
+ */
+bool tree_anyMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    return NULL != find_match(self, self->root, NULL, NULL, predicate, context, true);
+}
+
+/**
+ * @brief Checks if all nodes match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if all nodes match, false otherwise.
+ */
+bool tree_allMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, NULL, NULL, predicate, context, false);
+}
+
+/**
+ * @brief Checks if none of the nodes match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if none match, false otherwise.
+ */
+bool tree_noneMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, NULL, NULL, predicate, context, true);
+}
+
+/**
+ * @brief Checks if any nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if any match found, false otherwise.
+ */
+bool tree_anyMatchRange (tree_t* self, key_t* lo, key_t* hi, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    return NULL != find_match(self, self->root, lo, hi, predicate, context, true);
+}
+
+/**
+ * @brief Checks if all nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if all nodes in the range match, false otherwise.
+ */
+bool tree_allMatchRange (tree_t* self, key_t* lo, key_t* hi, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, lo, hi, predicate, context, false);
+}
+
+/**
+ * @brief Checks if none of the nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if none match, false otherwise.
+ */
+bool tree_noneMatchRange (tree_t* self, key_t* lo, key_t* hi, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, lo, hi, predicate, context, true);
+}
+
+/**
+ * @brief Counts the number of nodes matching a given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return Count of nodes matching the predicate.
+ */
+size_t tree_count (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+{
+    // The nodes are visited in key order, like an iterator would, but without a search per node.
+    return count_matches(self, self->root, predicate, context);
+}
+
+/**
+ * @brief Checks if two trees are equal based on a comparison predicate.
+ * @param self Pointer to the first AVL tree.
+ * @param other Pointer to the second AVL tree.
+ * @param predicate Function pointer for node comparison.
+ * @param context Additional context passed to the predicate.
+ * @return true if the trees are equal, false otherwise.
+ */
+bool tree_isEqual (tree_t* self, tree_t* other, bool (*predicate)(tree_node_t*, tree_node_t*, void*), void* context)
+{
+    if (tree_size(self) != tree_size(other))
+    {
+        return false;
+    }
+
+    tree_iterator_t iterX = tree_iter(self);
+    {
+        tree_iterator_t iterY = tree_iter(other);
+        {
+            while (tree_iter_hasNext(&iterX))
+            {
+                tree_iter_next(&iterX);
+                tree_iter_next(&iterY);
+
+                tree_node_t* nodeX = tree_iter_node(&iterX);
+                tree_node_t* nodeY = tree_iter_node(&iterY);
+
+                if (predicate(nodeX, nodeY, context) == false)
+                {
+                    return false;
+                }
+            }
+        }
+        tree_iter_free(&iterY);
+    }
+    tree_iter_free(&iterX);
+    return true;
+}
+
+/**
+ * @brief Creates an iterator for the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Iterator structure for the tree.
+ */
+tree_iterator_t tree_iter (tree_t* self)
+{
+    return tree_iter_atNode(self, NULL);
+}
+
+/**
+ * @brief Creates an iterator starting at a specific key in the tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to start the iteration at.
+ * @return Iterator structure for the tree starting at the given key.
+ */
+tree_iterator_t tree_iter_at (tree_t* self, key_t key)
+{
+    tree_node_t* node = find_node(self, self->root, &key);
+    return tree_iter_atNode(self, node);
+}
+
+/**
+ * @brief Creates an iterator starting at a specific node in the tree.
+ * @param self Pointer to the AVL tree.
+ * @param node Node to start the iteration at.
+ * @return Iterator structure for the tree starting at the given node.
+ */
+tree_iterator_t tree_iter_atNode (tree_t* self, tree_node_t* node)
+{
+    tree_iterator_t result;
+    result.owner = self;
+    result.node = node;
+    return result;
+}
+
+/**
+ * @brief Frees the resources associated with a tree iterator.
+ * @param self Pointer to the tree iterator to free.
+ */
+void tree_iter_free (tree_iterator_t* self)
+{
+    if (NULL != self)
+    {
+        self->owner = NULL;
+        self->node = NULL;
+    }
+}
+
+/**
+ * @brief Checks if the iterator has a next element.
+ * @param self Pointer to the tree iterator.
+ * @return true if there is a next element, false otherwise.
+ */
+bool tree_iter_hasNext (tree_iterator_t* self)
+{
+    if (tree_isEmpty(self->owner))
+    {
+        return false;
+    }
+    else if (NULL == self->node)
+    {
+        return true;
+    }
+    else
+    {
+        key_t key = self->node->key;
+        return NULL != tree_higherNode(self->owner, key);
+    }
+}
+
+/**
+ * @brief Checks if the iterator has a previous element.
+ * @param self Pointer to the tree iterator.
+ * @return true if there is a previous element, false otherwise.
+ */
+bool tree_iter_hasPrev (tree_iterator_t* self)
+{
+    if (tree_isEmpty(self->owner))
+    {
+        return false;
+    }
+    else if (NULL == self->node)
+    {
+        return true;
+    }
+    else
+    {
+        key_t key = self->node->key;
+        return NULL != tree_lowerNode(self->owner, key);
+    }
+}
+
+/**
+ * @brief Advances the iterator to the next element.
+ * @param self Pointer to the tree iterator.
+ */
+void tree_iter_next (tree_iterator_t* self)
+{
+    if (tree_isEmpty(self->owner) == false)
+    {
+        if (NULL == self->node)
+        {
+            self->node = tree_firstNode(self->owner);
+        }
+        else
+        {
+            key_t key = self->node->key;
+            self->node = tree_higherNode(self->owner, key);
+
+            // Iterators can be circular.
+            if (NULL == self->node)
+            {
+                self->node = tree_firstNode(self->owner);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Moves the iterator to the previous element.
+ * @param self Pointer to the tree iterator.
+ */
+void tree_iter_prev (tree_iterator_t* self)
+{
+    if (tree_isEmpty(self->owner) == false)
+    {
+        if (NULL == self->node)
+        {
+            self->node = tree_lastNode(self->owner);
+        }
+        else
+        {
+            key_t key = self->node->key;
+            self->node = tree_lowerNode(self->owner, key);
+
+            // Iterators can be circular.
+            if (NULL == self->node)
+            {
+                self->node = tree_lastNode(self->owner);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Retrieves the current node from the iterator.
+ * @param self Pointer to the tree iterator.
+ * @return Pointer to the current node.
+ */
+tree_node_t* tree_iter_node (tree_iterator_t* self)
+{
+    return self->node;
+}
+
+/**
+ * @brief Retrieves the key of the current node from the iterator.
+ * @param self Pointer to the tree iterator.
+ * @return Key of the current node.
+ */
+key_t tree_iter_key (tree_iterator_t* self)
+{
+    if (NULL == self->node)
+    {
+        return tree_defaultKey();
+    }
+    else
+    {
+        return self->node->key;
+    }
+}
+
+/**
+ * @brief Sets the data value of the current node in the iterator.
+ * @param self Pointer to the tree iterator.
+ * @param value Data value to set.
+ */
+void tree_iter_set (tree_iterator_t* self, data_t value)
+{
+    self->node->value = value;
+    update_path(self->owner, self->node);
+}
+
+/**
+ * @brief Retrieves the data value of the current node from the iterator.
+ * @param self Pointer to the tree iterator.
+ * @return Data value of the current node.
+ */
+data_t tree_iter_get (tree_iterator_t* self)
+{
+    if (NULL == self->node)
+    {
+        return tree_defaultValue();
+    }
+    else
+    {
+        return self->node->value;
+    }
+}
+
+static bool range_below_hi (tree_range_t* self, tree_node_t* node)
+{
+    const int ordering = self->owner->comparator(self->owner, &node->key, &self->hi);
+    return ordering < 0 || (0 == ordering && self->hi_inclusive);
+}
+
+/**
+ * Pushes the nodes on the path to the least key of a subtree, which are not above the upper bound.
+ * A node above the bound is skipped, since the nodes after it in key order are above the bound too.
+ */
+static void range_push_left (tree_range_t* self, tree_node_t* node)
+{
+    for (; NULL != node; node = node->left)
+    {
+        if (range_below_hi(self, node))
+        {
+            self->stack[self->depth++] = node;
+        }
+    }
+}
+
+/**
+ * @brief Positions a range cursor before the first node, whose key is between two bounds, in a single descent.
+ * @param self Pointer to the range cursor.
+ * @param owner Pointer to the AVL tree.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ */
+void tree_range_seek (tree_range_t* self, tree_t* owner, key_t lo, bool lo_inclusive, key_t hi, bool hi_inclusive)
+{
+    self->owner = owner;
+    self->node = NULL;
+    self->hi = hi;
+    self->hi_inclusive = hi_inclusive;
+    self->depth = 0;
+
+    tree_node_t* node = owner->root;
+
+    while (NULL != node)
+    {
+        const int ordering = owner->comparator(owner, &node->key, &lo);
+
+        if (ordering < 0 || (0 == ordering && false == lo_inclusive))
+        {
+            // The node and its left subtree are below the lower bound.
+            node = node->right;
+        }
+        else
+        {
+            if (range_below_hi(self, node))
+            {
+                self->stack[self->depth++] = node;
+            }
+
+            node = node->left;
+        }
+    }
+}
+
+/**
+ * @brief Checks if the range cursor has a next node.
+ * @param self Pointer to the range cursor.
+ * @return true if there is a next node in the range, false otherwise.
+ */
+bool tree_range_hasNext (tree_range_t* self)
+{
+    return self->depth > 0;
+}
+
+/**
+ * @brief Advances the range cursor to the next node.
+ * @param self Pointer to the range cursor.
+ */
+void tree_range_next (tree_range_t* self)
+{
+    if (0 == self->depth)
+    {
+        self->node = NULL;
+        return;
+    }
+
+    // The right subtree of a node follows it, and is above the lower bound.
+    self->node = self->stack[--self->depth];
+    range_push_left(self, self->node->right);
+}
+
+/**
+ * @brief Retrieves the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Pointer to the current node, or NULL if the cursor is not at a node.
+ */
+tree_node_t* tree_range_node (tree_range_t* self)
+{
+    return self->node;
+}
+
+/**
+ * @brief Retrieves the key of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Key of the current node.
+ */
+key_t tree_range_key (tree_range_t* self)
+{
+    return NULL == self->node ? tree_defaultKey() : self->node->key;
+}
+
+/**
+ * @brief Retrieves the data value of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Data value of the current node.
+ */
+data_t tree_range_get (tree_range_t* self)
+{
+    return NULL == self->node ? tree_defaultValue() : self->node->value;
+}
+
+/**
+ * @brief Initializes a finger at the root of a tree.
+ * @param self Pointer to the finger.
+ * @param owner Pointer to the AVL tree.
+ */
+void tree_finger_init (tree_finger_t* self, tree_t* owner)
+{
+    self->owner = owner;
+    self->depth = 0;
+
+    if (NULL != owner->root)
+    {
+        self->path[0] = owner->root;
+        self->lower[0] = NULL;
+        self->upper[0] = NULL;
+        self->depth = 1;
+    }
+}
+
+/**
+ * @brief Moves a finger to the node with a given key, or to the last node on its search path.
+ *
+ * The search starts from the nearest node on the path of the finger, whose subtree spans the key,
+ * so that a scan in key order costs amortized constant time per key, and no search costs more than get().
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Pointer to the node with the key, or NULL if the key is not in the tree.
+ */
+tree_node_t* tree_finger_seek (tree_finger_t* self, key_t key)
+{
+    if (0 == self->depth)
+    {
+        return NULL;
+    }
+
+    tree_t* owner = self->owner;
+    size_t level = self->depth - 1;
+
+    // Climb to the nearest node on the path, whose subtree spans the key. The subtrees of the nodes on the path,
+    // which share a bound, all miss the key if one misses it; hence, each distinct bound is compared only once.
+    // The subtree of the root spans every key, so the climb stops there at the latest.
+    while (NULL != self->lower[level] && owner->comparator(owner, &key, &self->lower[level]->key) <= 0)
+    {
+        const tree_node_t* bound = self->lower[level];
+
+        while (bound == self->lower[level])
+        {
+            --level;
+        }
+    }
+
+    while (NULL != self->upper[level] && owner->comparator(owner, &self->upper[level]->key, &key) <= 0)
+    {
+        const tree_node_t* bound = self->upper[level];
+
+        while (bound == self->upper[level])
+        {
+            --level;
+        }
+    }
+
+    self->depth = level + 1;
+    tree_node_t* node = self->path[level];
+
+    while (true)
+    {
+        const int ordering = owner->comparator(owner, &key, &node->key);
+
+        if (0 == ordering)
+        {
+            return node;
+        }
+
+        tree_node_t* child = ordering < 0 ? node->left : node->right;
+
+        if (NULL == child)
+        {
+            return NULL;
+        }
+
+        // The node bounds the subtree of its child from the side, from which the child hangs.
+        self->path[level + 1] = child;
+        self->lower[level + 1] = ordering < 0 ? self->lower[level] : node;
+        self->upper[level + 1] = ordering < 0 ? node : self->upper[level];
+        self->depth = ++level + 1;
+        node = child;
+    }
+}
+
+/**
+ * @brief Retrieves the data value associated with a given key by a search from a finger.
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Data value associated with the key, or the default value if the key is not in the tree.
+ */
+data_t tree_finger_get (tree_finger_t* self, key_t key)
+{
+    tree_node_t* node = tree_finger_seek(self, key);
+    return NULL == node ? tree_defaultValue() : node->value;
+}
+
+/**
+ * @brief Retrieves the key of a given tree node.
+ * @param self Pointer to the tree node.
+ * @return Key of the node.
+ */
+key_t tree_node_key (tree_node_t* self)
+{
+    if (NULL == self)
+    {
+        return tree_defaultKey();
+    }
+    else
+    {
+        return self->key;
+    }
+}
+
+/**
+ * @brief Sets the data value of a given tree node.
+ * @param self Pointer to the tree node.
+ * @param value The data value to set.
+ *
+ * The node does not know its tree; therefore, the hashes and aggregates of the node and its ancestors are not updated.
+ * Use setNode() instead, unless rehash() or reaggregate() is called afterwards.
+ */
+void tree_node_set (tree_node_t* self, data_t value)
+{
+    self->value = value;
+}
+
+/**
+ * @brief Retrieves the data value of a given tree node.
+ * @param self Pointer to the tree node.
+ * @return Data value of the node.
+ */
+data_t tree_node_get (tree_node_t* self)
+{
+    if (NULL == self)
+    {
+        return tree_defaultValue();
+    }
+    else
+    {
+        return self->value;
+    }
+}
+
+/**
+ * One of the trees in a multiqueue, which is aligned to its own cache line,
+ * so that threads working on neighboring trees do not contend for the same line.
+ */
+typedef struct
+{
+    _Alignas(64) atomic_flag lock;
+
+    tree_t tree;
+
+} tree_multiqueue_slot_t;
+
+struct tree_multiqueue
+{
+    size_t queues;
+
+    atomic_size_t size;
+
+    atomic_uint_fast64_t sequence;
+
+    tree_multiqueue_slot_t* slots;
+
+};
+
+/**
+ * Each thread has its own random number generator, which is seeded upon first use.
+ */
+static _Thread_local uint64_t MULTIQUEUE_RANDOM_STATE = 0;
+
+static atomic_uint_fast64_t MULTIQUEUE_RANDOM_SEEDS = 0;
+
+static size_t multiqueue_random (tree_multiqueue_t* self)
+{
+    uint64_t x = MULTIQUEUE_RANDOM_STATE;
+
+    if (0 == x)
+    {
+        x = (atomic_fetch_add(&MULTIQUEUE_RANDOM_SEEDS, 1) + 1) * UINT64_C(0x9E3779B97F4A7C15);
+    }
+
+    // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    MULTIQUEUE_RANDOM_STATE = x;
+
+    return (size_t) (x % self->queues);
+}
+
+static bool multiqueue_try_lock (tree_multiqueue_slot_t* slot)
+{
+    return atomic_flag_test_and_set_explicit(&slot->lock, memory_order_acquire) == false;
+}
+
+static void multiqueue_unlock (tree_multiqueue_slot_t* slot)
+{
+    atomic_flag_clear_explicit(&slot->lock, memory_order_release);
+}
+
+/**
+ * Locks a randomly chosen tree, choosing again whenever the chosen tree is busy.
+ */
+static tree_multiqueue_slot_t* multiqueue_lock_any (tree_multiqueue_t* self)
+{
+    while (true)
+    {
+        tree_multiqueue_slot_t* slot = &self->slots[multiqueue_random(self)];
+
+        if (multiqueue_try_lock(slot))
+        {
+            return slot;
+        }
+    }
+}
+
+/**
+ * Removes the first element of a locked tree, if the tree is not empty.
+ */
+static bool multiqueue_take_first (tree_multiqueue_t* self, tree_multiqueue_slot_t* slot, key_t* key, data_t* value)
+{
+    tree_node_t* node = tree_firstNode(&slot->tree);
+
+    if (NULL == node)
+    {
+        return false;
+    }
+
+    if (NULL != key)
+    {
+        *key = node->key;
+    }
+
+    if (NULL != value)
+    {
+        *value = node->value;
+    }
+
+    tree_removeFirst(&slot->tree);
+    atomic_fetch_sub_explicit(&self->size, 1, memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Creates a new multiqueue using the natural ordering of keys.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ */
+tree_multiqueue_t* tree_multiqueue_new (size_t queues)
+{
+    return tree_multiqueue_make(queues, tree_comparator_naturalOrder());
+}
+
+/**
+ * @brief Creates a new multiqueue with a specified comparator.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ */
+tree_multiqueue_t* tree_multiqueue_make (size_t queues, tree_comparator_t comparator)
+{
+    tree_multiqueue_t* self = (tree_multiqueue_t*) calloc(1, sizeof(tree_multiqueue_t));
+
+    if (NULL == self)
+    {
+        return NULL;
+    }
+
+    self->queues = queues < 1 ? 1 : queues;
+    atomic_init(&self->size, 0);
+    atomic_init(&self->sequence, 0);
+    self->slots = (tree_multiqueue_slot_t*) aligned_alloc(_Alignof(tree_multiqueue_slot_t), self->queues * sizeof(tree_multiqueue_slot_t));
+
+    if (NULL == self->slots)
+    {
+        free(self);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < self->queues; i++)
+    {
+        atomic_flag_clear(&self->slots[i].lock);
+        self->slots[i].tree = tree_make_stackalloc(tree_allocator_dynamic(), comparator);
+    }
+
+    return self;
+}
+
+/**
+ * @brief Frees the resources of a multiqueue, which must no longer be in use by any thread.
+ * @param self Pointer to the multiqueue to free.
+ */
+void tree_multiqueue_free (tree_multiqueue_t* self)
+{
+    if (NULL != self)
+    {
+        for (size_t i = 0; i < self->queues; i++)
+        {
+            tree_free_stackalloc(&self->slots[i].tree);
+        }
+
+        free(self->slots);
+        free(self);
+    }
+}
+
+/**
+ * @brief Retrieves the number of elements in the multiqueue, which may be stale under concurrent use.
+ * @param self Pointer to the multiqueue.
+ * @return Number of elements in the multiqueue.
+ */
+size_t tree_multiqueue_size (tree_multiqueue_t* self)
+{
+    return atomic_load_explicit(&self->size, memory_order_relaxed);
+}
+
+/**
+ * @brief Inserts a key-value pair into the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Key, which is the priority of the element.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool tree_multiqueue_put (tree_multiqueue_t* self, key_t key, data_t value)
+{
+    tree_multiqueue_slot_t* slot = multiqueue_lock_any(self);
+    const size_t before = tree_size(&slot->tree);
+    const bool result = tree_put(&slot->tree, key, value);
+    const size_t after = tree_size(&slot->tree);
+
+    // Count the element before it can be popped, so that the size never drops below zero.
+    atomic_fetch_add_explicit(&self->size, after - before, memory_order_relaxed);
+    multiqueue_unlock(slot);
+
+    return result;
+}
+
+/**
+ * @brief Pushes a value with the next sequence number as its key (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool tree_multiqueue_push (tree_multiqueue_t* self, data_t value)
+{
+    const uint_fast64_t sequence = atomic_fetch_add_explicit(&self->sequence, 1, memory_order_relaxed);
+    return tree_multiqueue_put(self, (key_t) sequence, value);
+}
+
+/**
+ * @brief Removes an element with a small key from the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Output for the key of the removed element, or NULL.
+ * @param value Output for the data value of the removed element, or NULL.
+ * @return true if an element was removed, false if the multiqueue was observed to be empty.
+ */
+bool tree_multiqueue_popFirst (tree_multiqueue_t* self, key_t* key, data_t* value)
+{
+    while (atomic_load_explicit(&self->size, memory_order_relaxed) > 0)
+    {
+        tree_multiqueue_slot_t* x = multiqueue_lock_any(self);
+        tree_multiqueue_slot_t* y = &self->slots[multiqueue_random(self)];
+
+        // The second tree is optional, so that a busy tree never blocks the removal.
+        if (x == y || multiqueue_try_lock(y) == false)
+        {
+            y = NULL;
+        }
+
+        tree_node_t* first_x = tree_firstNode(&x->tree);
+        tree_node_t* first_y = NULL == y ? NULL : tree_firstNode(&y->tree);
+        tree_multiqueue_slot_t* winner = x;
+
+        if (NULL == first_x || (NULL != first_y && x->tree.comparator(&x->tree, &first_y->key, &first_x->key) < 0))
+        {
+            winner = y;
+        }
+
+        const bool removed = NULL != winner && multiqueue_take_first(self, winner, key, value);
+
+        multiqueue_unlock(x);
+
+        if (NULL != y)
+        {
+            multiqueue_unlock(y);
+        }
+
+        if (removed)
+        {
+            return true;
+        }
+    }
+
+    // Confirm that the multiqueue is really empty by visiting every tree.
+    for (size_t i = 0; i < self->queues; i++)
+    {
+        tree_multiqueue_slot_t* slot = &self->slots[i];
+
+        while (multiqueue_try_lock(slot) == false)
+        {
+            // Spin, because this tree must be inspected.
+        }
+
+        const bool removed = multiqueue_take_first(self, slot, key, value);
+        multiqueue_unlock(slot);
+
+        if (removed)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * A slot in the ring buffer of a write-behind queue.
+ * The sequence number tells whether the slot is free, or holds a published operation (Vyukov's bounded queue).
+ */
+typedef struct
+{
+    atomic_size_t sequence;
+
+    tree_op_t op;
+
+} tree_writebehind_cell_t;
+
+struct tree_writebehind
+{
+    tree_t* tree;
+
+    pthread_rwlock_t tree_lock;
+
+    size_t mask;
+
+    size_t batch_size;
+
+    uint64_t max_latency_ns;
+
+    tree_op_t* batch;
+
+    tree_writebehind_cell_t* cells;
+
+    _Alignas(64) atomic_size_t enqueue_position;
+
+    _Alignas(64) atomic_size_t dequeue_position;
+
+    atomic_uint_fast64_t stalls;
+
+    atomic_bool flush_requested;
+
+    atomic_bool stopping;
+
+    /**
+     * Enqueue position, at which the writer that reaches it wakes the waiting applier, or SIZE_MAX if the applier is not waiting.
+     */
+    atomic_size_t wake_position;
+
+    /**
+     * The following fields are guarded by the mutex.
+     */
+    pthread_mutex_t mutex;
+
+    pthread_cond_t wakeup;
+
+    pthread_cond_t applied_changed;
+
+    size_t applied;
+
+    size_t max_depth;
+
+    uint64_t batches;
+
+    uint64_t failures;
+
+    pthread_t applier;
+
+};
+
+static uint64_t writebehind_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+static void writebehind_enqueue (tree_writebehind_t* self, tree_op_t* op)
+{
+    size_t position = atomic_load_explicit(&self->enqueue_position, memory_order_relaxed);
+
+    while (true)
+    {
+        tree_writebehind_cell_t* cell = &self->cells[position & self->mask];
+        const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+        if (difference == 0)
+        {
+            // The slot is free, so try to claim it.
+            // Claiming is sequentially consistent, so that either the applier sees the claim, or this writer sees the wake position.
+            if (atomic_compare_exchange_weak_explicit(&self->enqueue_position, &position, position + 1, memory_order_seq_cst, memory_order_relaxed))
+            {
+                cell->op = *op;
+                atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+                // Only the one writer, which reaches the wake position, takes the mutex.
+                if (position + 1 == atomic_load(&self->wake_position))
+                {
+                    pthread_mutex_lock(&self->mutex);
+                    pthread_cond_signal(&self->wakeup);
+                    pthread_mutex_unlock(&self->mutex);
+                }
+
+                return;
+            }
+        }
+        else if (difference < 0)
+        {
+            // The ring buffer is full, so give the applier a chance to drain it.
+            atomic_fetch_add_explicit(&self->stalls, 1, memory_order_relaxed);
+            sched_yield();
+            position = atomic_load_explicit(&self->enqueue_position, memory_order_relaxed);
+        }
+        else
+        {
+            // Another writer claimed the slot first.
+            position = atomic_load_explicit(&self->enqueue_position, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Moves published operations from the ring buffer into the batch, until the batch is full.
+ * Only the applier thread dequeues; therefore, no compare-and-swap is needed here.
+ */
+static size_t writebehind_drain (tree_writebehind_t* self, size_t count)
+{
+    size_t position = atomic_load_explicit(&self->dequeue_position, memory_order_relaxed);
+
+    while (count < self->batch_size)
+    {
+        tree_writebehind_cell_t* cell = &self->cells[position & self->mask];
+
+        if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != position + 1)
+        {
+            break; // Empty, or the next slot is claimed, but not yet published.
+        }
+
+        self->batch[count++] = cell->op;
+        atomic_store_explicit(&cell->sequence, position + self->mask + 1, memory_order_release);
+        ++position;
+    }
+
+    atomic_store_explicit(&self->dequeue_position, position, memory_order_relaxed);
+    return count;
+}
+
+/**
+ * Waits on the wakeup condition of a queue, with the mutex held, until the enqueue position reaches a target,
+ * a flush or stop is requested, or the deadline (on the monotonic clock, or UINT64_MAX for none) passes.
+ */
+static void writebehind_wait (tree_writebehind_t* self, size_t target, uint64_t deadline_ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t) (deadline_ns / UINT64_C(1000000000));
+    ts.tv_nsec = (long) (deadline_ns % UINT64_C(1000000000));
+
+    // Publish the target before checking the enqueue position, so that the writer reaching it cannot miss it.
+    atomic_store(&self->wake_position, target);
+
+    while (atomic_load(&self->enqueue_position) < target
+           && atomic_load(&self->flush_requested) == false
+           && atomic_load(&self->stopping) == false)
+    {
+        if (UINT64_MAX == deadline_ns)
+        {
+            pthread_cond_wait(&self->wakeup, &self->mutex);
+        }
+        else if (pthread_cond_timedwait(&self->wakeup, &self->mutex, &ts) != 0 || writebehind_now() >= deadline_ns)
+        {
+            break;
+        }
+    }
+
+    atomic_store(&self->wake_position, SIZE_MAX);
+}
+
+static void* writebehind_main (void* argument)
+{
+    tree_writebehind_t* self = (tree_writebehind_t*) argument;
+
+    // Operations, which have been dequeued, but not yet applied; a batch that failed is kept here and retried.
+    size_t count = 0;
+
+    while (true)
+    {
+        const size_t depth = atomic_load(&self->enqueue_position) - atomic_load(&self->dequeue_position);
+        count = writebehind_drain(self, count);
+
+        if (count > 0)
+        {
+            // Sleep until the writers fill up the batch, but no longer than the latency bound allows.
+            if (count < self->batch_size)
+            {
+                const size_t target = atomic_load(&self->dequeue_position) + (self->batch_size - count);
+                pthread_mutex_lock(&self->mutex);
+                writebehind_wait(self, target, writebehind_now() + self->max_latency_ns);
+                pthread_mutex_unlock(&self->mutex);
+                count = writebehind_drain(self, count);
+            }
+
+            pthread_rwlock_wrlock(&self->tree_lock);
+            const bool ok = tree_applyBatch(self->tree, self->batch, count);
+            pthread_rwlock_unlock(&self->tree_lock);
+
+            pthread_mutex_lock(&self->mutex);
+            self->max_depth = depth > self->max_depth ? depth : self->max_depth;
+
+            if (ok)
+            {
+                self->applied += count;
+                self->batches += 1;
+                count = 0;
+                pthread_cond_broadcast(&self->applied_changed);
+            }
+            else
+            {
+                // The tree is unchanged, so back off for the latency bound, and then retry the same batch.
+                self->failures += 1;
+                writebehind_wait(self, SIZE_MAX, writebehind_now() + self->max_latency_ns);
+            }
+
+            pthread_mutex_unlock(&self->mutex);
+            continue;
+        }
+
+        pthread_mutex_lock(&self->mutex);
+
+        const bool idle = atomic_load(&self->enqueue_position) == atomic_load(&self->dequeue_position);
+
+        if (idle && atomic_load(&self->stopping))
+        {
+            pthread_mutex_unlock(&self->mutex);
+            break;
+        }
+        else if (idle)
+        {
+            // Sleep without polling, until the next writer arrives, or a flush or stop is requested.
+            writebehind_wait(self, atomic_load(&self->dequeue_position) + 1, UINT64_MAX);
+        }
+
+        atomic_store(&self->flush_requested, false);
+        pthread_mutex_unlock(&self->mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Creates a write-behind queue in front of a tree and starts its applier thread.
+ * @param tree Pointer to the tree, which must only be accessed through the queue from now on.
+ * @param capacity Capacity of the ring buffer, which is rounded up to a power of two.
+ * @param batch_size Maximum number of operations applied to the tree at once.
+ * @param max_latency_ns Longest time that the applier waits for a batch to fill up, in nanoseconds.
+ * @return Pointer to the newly created queue or NULL if creation failed.
+ */
+tree_writebehind_t* tree_writebehind_new (tree_t* tree, size_t capacity, size_t batch_size, uint64_t max_latency_ns)
+{
+    size_t size = 2;
+
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+
+    tree_writebehind_t* self = (tree_writebehind_t*) aligned_alloc(_Alignof(tree_writebehind_t), sizeof(tree_writebehind_t));
+
+    if (NULL == self)
+    {
+        return NULL;
+    }
+
+    memset(self, 0, sizeof(tree_writebehind_t));
+    self->tree = tree;
+    self->mask = size - 1;
+    self->batch_size = batch_size < 1 ? 1 : batch_size;
+    self->max_latency_ns = max_latency_ns;
+    self->batch = (tree_op_t*) calloc(self->batch_size, sizeof(tree_op_t));
+    self->cells = (tree_writebehind_cell_t*) calloc(size, sizeof(tree_writebehind_cell_t));
+
+    if (NULL == self->batch || NULL == self->cells)
+    {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        atomic_init(&self->cells[i].sequence, i);
+    }
+
+    atomic_init(&self->enqueue_position, 0);
+    atomic_init(&self->dequeue_position, 0);
+    atomic_init(&self->stalls, 0);
+    atomic_init(&self->flush_requested, false);
+    atomic_init(&self->stopping, false);
+    atomic_init(&self->wake_position, SIZE_MAX);
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&self->wakeup, &attributes);
+    pthread_cond_init(&self->applied_changed, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&self->mutex, NULL);
+    pthread_rwlock_init(&self->tree_lock, NULL);
+
+    if (0 != pthread_create(&self->applier, NULL, &writebehind_main, self))
+    {
+        pthread_rwlock_destroy(&self->tree_lock);
+        pthread_mutex_destroy(&self->mutex);
+        pthread_cond_destroy(&self->wakeup);
+        pthread_cond_destroy(&self->applied_changed);
+        goto cleanup;
+    }
+
+    return self;
+
+cleanup:
+    free(self->batch);
+    free(self->cells);
+    free(self);
+    return NULL;
+}
+
+/**
+ * @brief Applies all pending operations, stops the applier thread, and frees the queue (but not the tree).
+ * @param self Pointer to the write-behind queue.
+ */
+void tree_writebehind_free (tree_writebehind_t* self)
+{
+    if (NULL != self)
+    {
+        pthread_mutex_lock(&self->mutex);
+        atomic_store(&self->stopping, true);
+        pthread_cond_signal(&self->wakeup);
+        pthread_mutex_unlock(&self->mutex);
+
+        pthread_join(self->applier, NULL);
+
+        pthread_rwlock_destroy(&self->tree_lock);
+        pthread_mutex_destroy(&self->mutex);
+        pthread_cond_destroy(&self->wakeup);
+        pthread_cond_destroy(&self->applied_changed);
+        free(self->batch);
+        free(self->cells);
+        free(self);
+    }
+}
+
+/**
+ * @brief Enqueues a put operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ */
+void tree_writebehind_put (tree_writebehind_t* self, key_t key, data_t value)
+{
+    tree_op_t op;
+    op.remove = false;
+    op.key = key;
+    op.value = value;
+    writebehind_enqueue(self, &op);
+}
+
+/**
+ * @brief Enqueues a remove operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to remove.
+ */
+void tree_writebehind_remove (tree_writebehind_t* self, key_t key)
+{
+    tree_op_t op;
+    op.remove = true;
+    op.key = key;
+    op.value = tree_defaultValue();
+    writebehind_enqueue(self, &op);
+}
+
+/**
+ * @brief Waits until every operation enqueued before this call has been applied to the tree.
+ * @param self Pointer to the write-behind queue.
+ */
+void tree_writebehind_flush (tree_writebehind_t* self)
+{
+    // Every operation enqueued before now has a position below this ticket.
+    const size_t ticket = atomic_load(&self->enqueue_position);
+
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->applied < ticket)
+    {
+        atomic_store(&self->flush_requested, true);
+        pthread_cond_signal(&self->wakeup);
+        pthread_cond_wait(&self->applied_changed, &self->mutex);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+}
+
+/**
+ * @brief Retrieves the value associated with a key, as of the last applied batch (thread-safe).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to search for.
+ * @param value Output for the associated value, or NULL.
+ * @return true if the key was found, false otherwise.
+ */
+bool tree_writebehind_get (tree_writebehind_t* self, key_t key, data_t* value)
+{
+    pthread_rwlock_rdlock(&self->tree_lock);
+    tree_node_t* node = tree_getNode(self->tree, key);
+
+    if (NULL != node && NULL != value)
+    {
+        *value = node->value;
+    }
+
+    pthread_rwlock_unlock(&self->tree_lock);
+    return NULL != node;
+}
+
+/**
+ * @brief Locks the tree for reading, so that the applier cannot modify the tree until released.
+ * @param self Pointer to the write-behind queue.
+ * @return Pointer to the tree, which must not be modified.
+ */
+tree_t* tree_writebehind_acquire (tree_writebehind_t* self)
+{
+    pthread_rwlock_rdlock(&self->tree_lock);
+    return self->tree;
+}
+
+/**
+ * @brief Unlocks the tree, which was locked by tree_writebehind_acquire().
+ * @param self Pointer to the write-behind queue.
+ */
+void tree_writebehind_release (tree_writebehind_t* self)
+{
+    pthread_rwlock_unlock(&self->tree_lock);
+}
+
+/**
+ * @brief Retrieves the counters of a write-behind queue.
+ * @param self Pointer to the write-behind queue.
+ * @return Snapshot of the counters.
+ */
+tree_writebehind_stats_t tree_writebehind_stats (tree_writebehind_t* self)
+{
+    tree_writebehind_stats_t stats;
+
+    pthread_mutex_lock(&self->mutex);
+    const size_t enqueued = atomic_load(&self->enqueue_position);
+    const size_t dequeued = atomic_load(&self->dequeue_position);
+    stats.depth = enqueued - dequeued;
+    stats.max_depth = self->max_depth;
+    stats.enqueued = enqueued;
+    stats.applied = self->applied;
+    stats.batches = self->batches;
+    stats.stalls = atomic_load(&self->stalls);
+    stats.failures = self->failures;
+    pthread_mutex_unlock(&self->mutex);
+
+    return stats;
+}
+
+/**
+ * Bits of the version number of a concurrent node.
+ * A node is shrinking while a rotation moves some of its descendants out of its subtree,
+ * which invalidates every search that is currently passing through the node.
+ */
+#define CONCURRENT_UNLINKED 1
+#define CONCURRENT_SHRINKING 2
+#define CONCURRENT_VERSION_INCREMENT 4
+
+/**
+ * Outcomes of a single optimistic attempt to perform an operation.
+ */
+typedef enum
+{
+    CONCURRENT_RETRY,
+
+    CONCURRENT_ABSENT,
+
+    CONCURRENT_DONE,
+
+    CONCURRENT_FAILED,
+
+} tree_concurrent_result_t;
+
+/**
+ * Conditions of a node, which are used by rebalancing, in addition to a positive replacement height.
+ */
+#define CONCURRENT_NOTHING_REQUIRED 0
+#define CONCURRENT_UNLINK_REQUIRED -1
+#define CONCURRENT_REBALANCE_REQUIRED -2
+
+/**
+ * Maximum number of nodes that rebalancing remembers for later repair, before it resorts to recursion.
+ */
+#define CONCURRENT_MAX_PENDING 64
+
+typedef struct tree_concurrent_node
+{
+    key_t key;
+
+    /**
+     * The value is only read and written while holding the lock.
+     */
+    data_t value;
+
+    /**
+     * False, if this node is a routing node, whose key is not part of the map.
+     */
+    atomic_bool present;
+
+    atomic_int height;
+
+    atomic_uint_fast64_t version;
+
+    /**
+     * The left child is at index zero and the right child is at index one.
+     */
+    _Atomic(struct tree_concurrent_node*) children[2];
+
+    _Atomic(struct tree_concurrent_node*) parent;
+
+    struct tree_concurrent_node* retired;
+
+    atomic_flag lock;
+
+} tree_concurrent_node_t;
+
+struct tree_concurrent
+{
+    /**
+     * The root holder is a sentinel node without a key, whose right child is the root.
+     */
+    tree_concurrent_node_t holder;
+
+    tree_comparator_t comparator;
+
+    atomic_size_t size;
+
+    _Atomic(tree_concurrent_node_t*) retired;
+
+};
+
+static void concurrent_lock (tree_concurrent_node_t* node)
+{
+    for (unsigned spins = 0; atomic_flag_test_and_set_explicit(&node->lock, memory_order_acquire); spins++)
+    {
+        if (spins >= 64)
+        {
+            sched_yield();
+        }
+    }
+}
+
+static void concurrent_unlock (tree_concurrent_node_t* node)
+{
+    atomic_flag_clear_explicit(&node->lock, memory_order_release);
+}
+
+/**
+ * Waits for a rotation, which is shrinking the node, to complete.
+ * Rotations hold the lock of every node that they shrink.
+ */
+static void concurrent_wait (tree_concurrent_node_t* node)
+{
+    concurrent_lock(node);
+    concurrent_unlock(node);
+}
+
+static tree_concurrent_node_t* concurrent_child (tree_concurrent_node_t* node, int direction)
+{
+    return atomic_load(&node->children[direction > 0]);
+}
+
+static int concurrent_height (tree_concurrent_node_t* node)
+{
+    return NULL == node ? 0 : atomic_load(&node->height);
+}
+
+static bool concurrent_changed (tree_concurrent_node_t* node, uint64_t version)
+{
+    return atomic_load(&node->version) != version;
+}
+
+static tree_concurrent_node_t* concurrent_new_node (key_t key, data_t value, tree_concurrent_node_t* parent)
+{
+    tree_concurrent_node_t* node = (tree_concurrent_node_t*) malloc(sizeof(tree_concurrent_node_t));
+
+    if (NULL != node)
+    {
+        node->key = key;
+        node->value = value;
+        node->retired = NULL;
+        atomic_init(&node->present, true);
+        atomic_init(&node->height, 1);
+        atomic_init(&node->version, 0);
+        atomic_init(&node->children[0], NULL);
+        atomic_init(&node->children[1], NULL);
+        atomic_init(&node->parent, parent);
+        atomic_flag_clear(&node->lock);
+    }
+
+    return node;
+}
+
+static int concurrent_condition (tree_concurrent_node_t* node)
+{
+    tree_concurrent_node_t* left = atomic_load(&node->children[0]);
+    tree_concurrent_node_t* right = atomic_load(&node->children[1]);
+
+    if ((NULL == left || NULL == right) && false == atomic_load(&node->present))
+    {
+        return CONCURRENT_UNLINK_REQUIRED;
+    }
+
+    const int height = atomic_load(&node->height);
+    const int left_height = concurrent_height(left);
+    const int right_height = concurrent_height(right);
+    const int replacement = 1 + (left_height > right_height ? left_height : right_height);
+    const int balance = left_height - right_height;
+
+    if (balance < -1 || balance > 1)
+    {
+        return CONCURRENT_REBALANCE_REQUIRED;
+    }
+
+    return height != replacement ? replacement : CONCURRENT_NOTHING_REQUIRED;
+}
+
+/**
+ * Repairs the height of a locked node.
+ * Returns the next node that needs attention, or NULL if none does.
+ */
+static tree_concurrent_node_t* concurrent_fix_height (tree_concurrent_node_t* node)
+{
+    const int condition = concurrent_condition(node);
+
+    switch (condition)
+    {
+        case CONCURRENT_REBALANCE_REQUIRED:
+        case CONCURRENT_UNLINK_REQUIRED:
+            return node;
+        case CONCURRENT_NOTHING_REQUIRED:
+            return NULL;
+        default:
+            atomic_store(&node->height, condition);
+            return atomic_load(&node->parent);
+    }
+}
+
+/**
+ * Unlinks a locked node, which has at most one child, from its locked parent.
+ */
+static bool concurrent_unlink (tree_concurrent_t* self, tree_concurrent_node_t* parent, tree_concurrent_node_t* node)
+{
+    tree_concurrent_node_t* parent_left = atomic_load(&parent->children[0]);
+    tree_concurrent_node_t* parent_right = atomic_load(&parent->children[1]);
+    tree_concurrent_node_t* left = atomic_load(&node->children[0]);
+    tree_concurrent_node_t* right = atomic_load(&node->children[1]);
+
+    if ((parent_left != node && parent_right != node) || (NULL != left && NULL != right))
+    {
+        return false;
+    }
+
+    tree_concurrent_node_t* splice = NULL != left ? left : right;
+    atomic_store(&parent->children[parent_left == node ? 0 : 1], splice);
+
+    if (NULL != splice)
+    {
+        atomic_store(&splice->parent, parent);
+    }
+
+    atomic_store(&node->version, atomic_load(&node->version) | CONCURRENT_UNLINKED);
+    atomic_store(&node->present, false);
+
+    // Concurrent searches may still be passing through the node; therefore, retire it.
+    node->retired = atomic_load(&self->retired);
+
+    while (false == atomic_compare_exchange_weak(&self->retired, &node->retired, node))
+    {
+        // The expected value was refreshed by the failed exchange.
+    }
+
+    return true;
+}
+
+/**
+ * Rotates the child on the given side of a locked node up into the place of the node.
+ */
+static tree_concurrent_node_t* concurrent_rotate (tree_concurrent_node_t* parent,
+                                                      tree_concurrent_node_t* node,
+                                                      tree_concurrent_node_t* child,
+                                                      int side,
+                                                      int other_height,
+                                                      int outer_height,
+                                                      tree_concurrent_node_t* inner,
+                                                      int inner_height)
+{
+    const int other = 1 - side;
+    const uint64_t version = atomic_load(&node->version);
+    const bool left_of_parent = atomic_load(&parent->children[0]) == node;
+
+    atomic_store(&node->version, version | CONCURRENT_SHRINKING);
+
+    atomic_store(&node->children[side], inner);
+
+    if (NULL != inner)
+    {
+        atomic_store(&inner->parent, node);
+    }
+
+    atomic_store(&child->children[other], node);
+    atomic_store(&node->parent, child);
+    atomic_store(&parent->children[left_of_parent ? 0 : 1], child);
+    atomic_store(&child->parent, parent);
+
+    const int node_height = 1 + (inner_height > other_height ? inner_height : other_height);
+    atomic_store(&node->height, node_height);
+    atomic_store(&child->height, 1 + (outer_height > node_height ? outer_height : node_height));
+
+    atomic_store(&node->version, version + CONCURRENT_VERSION_INCREMENT);
+
+    const int node_balance = inner_height - other_height;
+    const int child_balance = outer_height - node_height;
+
+    if (node_balance < -1 || node_balance > 1)
+    {
+        return node;
+    }
+    else if ((NULL == inner || 0 == other_height) && false == atomic_load(&node->present))
+    {
+        return node;
+    }
+    else if (child_balance < -1 || child_balance > 1)
+    {
+        return child;
+    }
+    else if (0 == outer_height && false == atomic_load(&child->present))
+    {
+        return child;
+    }
+
+    return concurrent_fix_height(parent);
+}
+
+/**
+ * Rotates the inner grandchild on the given side of a locked node up into the place of the node.
+ */
+static tree_concurrent_node_t* concurrent_rotate_double (tree_concurrent_node_t* parent,
+                                                             tree_concurrent_node_t* node,
+                                                             tree_concurrent_node_t* child,
+                                                             int side,
+                                                             int other_height,
+                                                             int outer_height,
+                                                             tree_concurrent_node_t* inner,
+                                                             int inner_side_height)
+{
+    const int other = 1 - side;
+    const uint64_t node_version = atomic_load(&node->version);
+    const uint64_t child_version = atomic_load(&child->version);
+    const bool left_of_parent = atomic_load(&parent->children[0]) == node;
+
+    tree_concurrent_node_t* inner_side = atomic_load(&inner->children[side]);
+    tree_concurrent_node_t* inner_other = atomic_load(&inner->children[other]);
+    const int inner_other_height = concurrent_height(inner_other);
+
+    atomic_store(&node->version, node_version | CONCURRENT_SHRINKING);
+    atomic_store(&child->version, child_version | CONCURRENT_SHRINKING);
+
+    atomic_store(&node->children[side], inner_other);
+
+    if (NULL != inner_other)
+    {
+        atomic_store(&inner_other->parent, node);
+    }
+
+    atomic_store(&child->children[other], inner_side);
+
+    if (NULL != inner_side)
+    {
+        atomic_store(&inner_side->parent, child);
+    }
+
+    atomic_store(&inner->children[side], child);
+    atomic_store(&child->parent, inner);
+    atomic_store(&inner->children[other], node);
+    atomic_store(&node->parent, inner);
+    atomic_store(&parent->children[left_of_parent ? 0 : 1], inner);
+    atomic_store(&inner->parent, parent);
+
+    const int node_height = 1 + (inner_other_height > other_height ? inner_other_height : other_height);
+    const int child_height = 1 + (outer_height > inner_side_height ? outer_height : inner_side_height);
+    atomic_store(&node->height, node_height);
+    atomic_store(&child->height, child_height);
+    atomic_store(&inner->height, 1 + (child_height > node_height ? child_height : node_height));
+
+    atomic_store(&node->version, node_version + CONCURRENT_VERSION_INCREMENT);
+    atomic_store(&child->version, child_version + CONCURRENT_VERSION_INCREMENT);
+
+    const int node_balance = inner_other_height - other_height;
+    const int inner_balance = child_height - node_height;
+
+    if (node_balance < -1 || node_balance > 1)
+    {
+        return node;
+    }
+    else if ((NULL == inner_other || 0 == other_height) && false == atomic_load(&node->present))
+    {
+        return node;
+    }
+    else if ((NULL == inner_side || 0 == outer_height) && false == atomic_load(&child->present))
+    {
+        return child;
+    }
+    else if (inner_balance < -1 || inner_balance > 1)
+    {
+        return inner;
+    }
+
+    return concurrent_fix_height(parent);
+}
+
+/**
+ * Rebalances a locked node, whose child on the given side is too tall, while its parent is locked too.
+ */
+static tree_concurrent_node_t* concurrent_rebalance_toward (tree_concurrent_node_t* parent,
+                                                                tree_concurrent_node_t* node,
+                                                                tree_concurrent_node_t* child,
+                                                                int side,
+                                                                int other_height)
+{
+    const int other = 1 - side;
+    tree_concurrent_node_t* result = node;
+    bool handled = true;
+
+    concurrent_lock(child);
+
+    if (atomic_load(&child->height) - other_height > 1)
+    {
+        tree_concurrent_node_t* inner = atomic_load(&child->children[other]);
+        const int outer_height = concurrent_height(atomic_load(&child->children[side]));
+
+        // The inner grandchild moves in either rotation; therefore, its height must not change meanwhile.
+        if (NULL != inner)
+        {
+            concurrent_lock(inner);
+        }
+
+        const int inner_height = concurrent_height(inner);
+
+        if (outer_height >= inner_height)
+        {
+            result = concurrent_rotate(parent, node, child, side, other_height, outer_height, inner, inner_height);
+        }
+        else
+        {
+            const int inner_side_height = concurrent_height(atomic_load(&inner->children[side]));
+            const int balance = outer_height - inner_side_height;
+
+            if (balance >= -1 && balance <= 1)
+            {
+                result = concurrent_rotate_double(parent, node, child, side, other_height, outer_height, inner, inner_side_height);
+            }
+            else
+            {
+                handled = false;
+            }
+        }
+
+        if (NULL != inner)
+        {
+            concurrent_unlock(inner);
+        }
+
+        if (false == handled)
+        {
+            // The child must be rebalanced first, in the opposite direction.
+            result = concurrent_rebalance_toward(node, child, inner, other, outer_height);
+        }
+    }
+
+    concurrent_unlock(child);
+    return result;
+}
+
+/**
+ * Unlinks or rebalances a locked node, whose parent is locked too.
+ * Returns the next node that needs attention, or NULL if none does.
+ */
+static tree_concurrent_node_t* concurrent_rebalance (tree_concurrent_t* self, tree_concurrent_node_t* parent, tree_concurrent_node_t* node)
+{
+    tree_concurrent_node_t* left = atomic_load(&node->children[0]);
+    tree_concurrent_node_t* right = atomic_load(&node->children[1]);
+
+    if ((NULL == left || NULL == right) && false == atomic_load(&node->present))
+    {
+        return concurrent_unlink(self, parent, node) ? concurrent_fix_height(parent) : node;
+    }
+
+    const int height = atomic_load(&node->height);
+    const int left_height = concurrent_height(left);
+    const int right_height = concurrent_height(right);
+    const int replacement = 1 + (left_height > right_height ? left_height : right_height);
+    const int balance = left_height - right_height;
+
+    if (balance > 1)
+    {
+        return concurrent_rebalance_toward(parent, node, left, 0, right_height);
+    }
+    else if (balance < -1)
+    {
+        return concurrent_rebalance_toward(parent, node, right, 1, left_height);
+    }
+    else if (height != replacement)
+    {
+        atomic_store(&node->height, replacement);
+        return concurrent_fix_height(parent);
+    }
+
+    return NULL;
+}
+
+/**
+ * Walks up from a node, whose subtree was modified, repairing heights and rebalancing as needed.
+ */
+static void concurrent_fix_height_and_rebalance (tree_concurrent_t* self, tree_concurrent_node_t* node)
+{
+    // A rotation may hand back a node below the rotated subtree, while the parent above it still needs repair.
+    // Such parents are remembered here and repaired once the walk from the lower node ends.
+    tree_concurrent_node_t* pending[CONCURRENT_MAX_PENDING];
+    size_t pending_count = 0;
+
+    while (true)
+    {
+        if (NULL == node || NULL == atomic_load(&node->parent))
+        {
+            if (0 == pending_count)
+            {
+                return;
+            }
+
+            node = pending[--pending_count];
+            continue;
+        }
+
+        // The condition is checked under the lock, so that it cannot miss the heights set by a concurrent rotation.
+        concurrent_lock(node);
+
+        const int condition = concurrent_condition(node);
+
+        if ((atomic_load(&node->version) & CONCURRENT_UNLINKED) != 0)
+        {
+            concurrent_unlock(node);
+            node = NULL;
+        }
+        else if (CONCURRENT_UNLINK_REQUIRED != condition && CONCURRENT_REBALANCE_REQUIRED != condition)
+        {
+            tree_concurrent_node_t* next = concurrent_fix_height(node);
+            concurrent_unlock(node);
+            node = next;
+        }
+        else
+        {
+            concurrent_unlock(node);
+
+            tree_concurrent_node_t* parent = atomic_load(&node->parent);
+            tree_concurrent_node_t* next = node;
+
+            concurrent_lock(parent);
+
+            if ((atomic_load(&parent->version) & CONCURRENT_UNLINKED) == 0 && atomic_load(&node->parent) == parent)
+            {
+                concurrent_lock(node);
+                next = concurrent_rebalance(self, parent, node);
+                concurrent_unlock(node);
+            }
+
+            concurrent_unlock(parent);
+
+            if (NULL != next && next != node && next != parent)
+            {
+                if (pending_count < CONCURRENT_MAX_PENDING)
+                {
+                    pending[pending_count++] = parent;
+                }
+                else
+                {
+                    concurrent_fix_height_and_rebalance(self, parent);
+                }
+            }
+
+            node = next;
+        }
+    }
+}
+
+/**
+ * Searches for a key below the child of a node, whose version was observed before reading the child.
+ * Each level of recursion validates that the key is still within the range of the node that it descended from.
+ */
+static tree_concurrent_result_t concurrent_attempt_get (tree_concurrent_t* self,
+                                                           key_t key,
+                                                           tree_concurrent_node_t* node,
+                                                           int direction,
+                                                           uint64_t version,
+                                                           data_t* value)
+{
+    while (true)
+    {
+        tree_concurrent_node_t* child = concurrent_child(node, direction);
+
+        if (NULL == child)
+        {
+            return concurrent_changed(node, version) ? CONCURRENT_RETRY : CONCURRENT_ABSENT;
+        }
+
+        const int cmp = self->comparator(NULL, &key, &child->key);
+
+        if (0 == cmp)
+        {
+            concurrent_lock(child);
+            const bool unlinked = (atomic_load(&child->version) & CONCURRENT_UNLINKED) != 0;
+            const bool present = atomic_load(&child->present);
+
+            if (present && false == unlinked)
+            {
+                *value = child->value;
+            }
+
+            concurrent_unlock(child);
+
+            if (false == unlinked)
+            {
+                return present ? CONCURRENT_DONE : CONCURRENT_ABSENT;
+            }
+            else if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            continue;
+        }
+
+        const uint64_t child_version = atomic_load(&child->version);
+
+        if ((child_version & CONCURRENT_SHRINKING) != 0)
+        {
+            concurrent_wait(child);
+        }
+        else if ((child_version & CONCURRENT_UNLINKED) == 0 && child == concurrent_child(node, direction))
+        {
+            if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            const tree_concurrent_result_t result = concurrent_attempt_get(self, key, child, cmp, child_version, value);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+        }
+
+        if (concurrent_changed(node, version))
+        {
+            return CONCURRENT_RETRY;
+        }
+    }
+}
+
+static tree_concurrent_result_t concurrent_attempt_put (tree_concurrent_t* self,
+                                                           key_t key,
+                                                           data_t value,
+                                                           tree_concurrent_node_t* node,
+                                                           int direction,
+                                                           uint64_t version)
+{
+    while (true)
+    {
+        tree_concurrent_node_t* child = concurrent_child(node, direction);
+
+        if (NULL == child)
+        {
+            // Allocate before locking, so that the lock is held as briefly as possible.
+            tree_concurrent_node_t* created = concurrent_new_node(key, value, node);
+
+            if (NULL == created)
+            {
+                return CONCURRENT_FAILED;
+            }
+
+            concurrent_lock(node);
+
+            if (concurrent_changed(node, version))
+            {
+                concurrent_unlock(node);
+                free(created);
+                return CONCURRENT_RETRY;
+            }
+            else if (NULL != concurrent_child(node, direction))
+            {
+                concurrent_unlock(node);
+                free(created);
+                continue;
+            }
+
+            atomic_store(&node->children[direction > 0], created);
+            tree_concurrent_node_t* damaged = concurrent_fix_height(node);
+            concurrent_unlock(node);
+
+            atomic_fetch_add(&self->size, 1);
+            concurrent_fix_height_and_rebalance(self, damaged);
+            return CONCURRENT_DONE;
+        }
+
+        const int cmp = self->comparator(NULL, &key, &child->key);
+
+        if (0 == cmp)
+        {
+            concurrent_lock(child);
+            const bool unlinked = (atomic_load(&child->version) & CONCURRENT_UNLINKED) != 0;
+
+            if (false == unlinked)
+            {
+                if (false == atomic_load(&child->present))
+                {
+                    // Revive a routing node.
+                    atomic_store(&child->present, true);
+                    atomic_fetch_add(&self->size, 1);
+                }
+
+                child->value = value;
+            }
+
+            concurrent_unlock(child);
+
+            if (false == unlinked)
+            {
+                return CONCURRENT_DONE;
+            }
+            else if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            continue;
+        }
+
+        const uint64_t child_version = atomic_load(&child->version);
+
+        if ((child_version & CONCURRENT_SHRINKING) != 0)
+        {
+            concurrent_wait(child);
+        }
+        else if ((child_version & CONCURRENT_UNLINKED) == 0 && child == concurrent_child(node, direction))
+        {
+            if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            const tree_concurrent_result_t result = concurrent_attempt_put(self, key, value, child, cmp, child_version);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+        }
+
+        if (concurrent_changed(node, version))
+        {
+            return CONCURRENT_RETRY;
+        }
+    }
+}
+
+/**
+ * Removes the key of a node, which was reached from the given parent.
+ */
+static tree_concurrent_result_t concurrent_remove_node (tree_concurrent_t* self, tree_concurrent_node_t* parent, tree_concurrent_node_t* node)
+{
+    if (false == atomic_load(&node->present))
+    {
+        return CONCURRENT_ABSENT;
+    }
+
+    if (NULL == atomic_load(&node->children[0]) || NULL == atomic_load(&node->children[1]))
+    {
+        // The node has at most one child; therefore, it can be unlinked.
+        concurrent_lock(parent);
+
+        if ((atomic_load(&parent->version) & CONCURRENT_UNLINKED) != 0 || atomic_load(&node->parent) != parent)
+        {
+            concurrent_unlock(parent);
+            return CONCURRENT_RETRY;
+        }
+
+        concurrent_lock(node);
+
+        if (false == atomic_load(&node->present))
+        {
+            concurrent_unlock(node);
+            concurrent_unlock(parent);
+            return CONCURRENT_ABSENT;
+        }
+        else if (false == concurrent_unlink(self, parent, node))
+        {
+            concurrent_unlock(node);
+            concurrent_unlock(parent);
+            return CONCURRENT_RETRY;
+        }
+
+        concurrent_unlock(node);
+        tree_concurrent_node_t* damaged = concurrent_fix_height(parent);
+        concurrent_unlock(parent);
+
+        atomic_fetch_sub(&self->size, 1);
+        concurrent_fix_height_and_rebalance(self, damaged);
+        return CONCURRENT_DONE;
+    }
+    else
+    {
+        // The node has two children; therefore, it becomes a routing node.
+        concurrent_lock(node);
+
+        if ((atomic_load(&node->version) & CONCURRENT_UNLINKED) != 0
+            || NULL == atomic_load(&node->children[0])
+            || NULL == atomic_load(&node->children[1]))
+        {
+            concurrent_unlock(node);
+            return CONCURRENT_RETRY;
+        }
+
+        const bool present = atomic_load(&node->present);
+        atomic_store(&node->present, false);
+        concurrent_unlock(node);
+
+        if (present)
+        {
+            atomic_fetch_sub(&self->size, 1);
+        }
+
+        return present ? CONCURRENT_DONE : CONCURRENT_ABSENT;
+    }
+}
+
+static tree_concurrent_result_t concurrent_attempt_remove (tree_concurrent_t* self,
+                                                              key_t key,
+                                                              tree_concurrent_node_t* node,
+                                                              int direction,
+                                                              uint64_t version)
+{
+    while (true)
+    {
+        tree_concurrent_node_t* child = concurrent_child(node, direction);
+
+        if (NULL == child)
+        {
+            return concurrent_changed(node, version) ? CONCURRENT_RETRY : CONCURRENT_ABSENT;
+        }
+
+        const int cmp = self->comparator(NULL, &key, &child->key);
+
+        if (0 == cmp)
+        {
+            const tree_concurrent_result_t result = concurrent_remove_node(self, node, child);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+            else if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            continue;
+        }
+
+        const uint64_t child_version = atomic_load(&child->version);
+
+        if ((child_version & CONCURRENT_SHRINKING) != 0)
+        {
+            concurrent_wait(child);
+        }
+        else if ((child_version & CONCURRENT_UNLINKED) == 0 && child == concurrent_child(node, direction))
+        {
+            if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            const tree_concurrent_result_t result = concurrent_attempt_remove(self, key, child, cmp, child_version);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+        }
+
+        if (concurrent_changed(node, version))
+        {
+            return CONCURRENT_RETRY;
+        }
+    }
+}
+
+static void concurrent_free_nodes (tree_concurrent_node_t* node)
+{
+    if (NULL != node)
+    {
+        concurrent_free_nodes(atomic_load(&node->children[0]));
+        concurrent_free_nodes(atomic_load(&node->children[1]));
+        free(node);
+    }
+}
+
+/**
+ * @brief Creates a new concurrent tree using the natural ordering of keys.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+tree_concurrent_t* tree_concurrent_new ()
+{
+    return tree_concurrent_make(&tree_naturalOrder);
+}
+
+/**
+ * @brief Creates a new concurrent tree with a specified comparator.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+tree_concurrent_t* tree_concurrent_make (tree_comparator_t comparator)
+{
+    tree_concurrent_t* self = (tree_concurrent_t*) malloc(sizeof(tree_concurrent_t));
+
+    if (NULL != self)
+    {
+        self->holder.key = tree_defaultKey();
+        self->holder.value = tree_defaultValue();
+        self->holder.retired = NULL;
+        atomic_init(&self->holder.present, false);
+        atomic_init(&self->holder.height, 0);
+        atomic_init(&self->holder.version, 0);
+        atomic_init(&self->holder.children[0], NULL);
+        atomic_init(&self->holder.children[1], NULL);
+        atomic_init(&self->holder.parent, NULL);
+        atomic_flag_clear(&self->holder.lock);
+        self->comparator = comparator;
+        atomic_init(&self->size, 0);
+        atomic_init(&self->retired, NULL);
+    }
+
+    return self;
+}
+
+/**
+ * @brief Frees the resources of a concurrent tree, which must no longer be in use by any thread.
+ * @param self Pointer to the concurrent tree to free.
+ */
+void tree_concurrent_free (tree_concurrent_t* self)
+{
+    if (NULL != self)
+    {
+        tree_concurrent_collect(self);
+        concurrent_free_nodes(atomic_load(&self->holder.children[1]));
+        free(self);
+    }
+}
+
+/**
+ * @brief Frees the nodes that were unlinked by removals, while no other thread is using the concurrent tree.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of nodes freed.
+ */
+size_t tree_concurrent_collect (tree_concurrent_t* self)
+{
+    tree_concurrent_node_t* node = atomic_exchange(&self->retired, NULL);
+    size_t count = 0;
+
+    while (NULL != node)
+    {
+        tree_concurrent_node_t* next = node->retired;
+        free(node);
+        node = next;
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Retrieves the number of entries in the concurrent tree, which may be stale under concurrent use.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of entries in the concurrent tree.
+ */
+size_t tree_concurrent_size (tree_concurrent_t* self)
+{
+    return atomic_load(&self->size);
+}
+
+/**
+ * @brief Inserts a key-value pair into the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool tree_concurrent_put (tree_concurrent_t* self, key_t key, data_t value)
+{
+    tree_concurrent_node_t* holder = &self->holder;
+
+    while (true)
+    {
+        const uint64_t version = atomic_load(&holder->version);
+        const tree_concurrent_result_t result = concurrent_attempt_put(self, key, value, holder, +1, version);
+
+        if (CONCURRENT_RETRY != result)
+        {
+            return CONCURRENT_DONE == result;
+        }
+    }
+}
+
+/**
+ * @brief Retrieves the value associated with a key in the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+data_t tree_concurrent_get (tree_concurrent_t* self, key_t key)
+{
+    tree_concurrent_node_t* holder = &self->holder;
+    data_t value = tree_defaultValue();
+
+    while (CONCURRENT_RETRY == concurrent_attempt_get(self, key, holder, +1, atomic_load(&holder->version), &value))
+    {
+        // Retry from the root.
+    }
+
+    return value;
+}
+
+/**
+ * @brief Checks if the concurrent tree contains a specific key (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to check for.
+ * @return true if the key is found, false otherwise.
+ */
+bool tree_concurrent_containsKey (tree_concurrent_t* self, key_t key)
+{
+    tree_concurrent_node_t* holder = &self->holder;
+    data_t value;
+
+    while (true)
+    {
+        const tree_concurrent_result_t result = concurrent_attempt_get(self, key, holder, +1, atomic_load(&holder->version), &value);
+
+        if (CONCURRENT_RETRY != result)
+        {
+            return CONCURRENT_DONE == result;
+        }
+    }
+}
+
+/**
+ * @brief Removes a key and its value from the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to remove.
+ */
+void tree_concurrent_remove (tree_concurrent_t* self, key_t key)
+{
+    tree_concurrent_node_t* holder = &self->holder;
+
+    while (CONCURRENT_RETRY == concurrent_attempt_remove(self, key, holder, +1, atomic_load(&holder->version)))
+    {
+        // Retry from the root.
+    }
+}
+
+#define SNAPSHOT_MAGIC "TREESNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER UINT32_C(0x01020304)
+
+/**
+ * Size of the I/O buffer, which must be a multiple of eight, so that the checksum sees the same words,
+ * no matter how the data was split into reads and writes.
+ */
+#define SNAPSHOT_BUFFER_SIZE (1 << 20)
+
+/**
+ * Number of loaded nodes, for which a loader makes room at first. The room then doubles as the entries arrive,
+ * so that a corrupt count in a header cannot allocate more memory than the data actually holds.
+ */
+#define SNAPSHOT_INITIAL_NODES 1024
+
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint64_t count;
+
+} tree_snapshot_header_t;
+
+/**
+ * Buffered sequential access to a file descriptor, which checksums all of the data that passes through.
+ */
+typedef struct
+{
+    int fd;
+
+    uint64_t checksum;
+
+    unsigned char* buffer;
+
+    /**
+     * Number of bytes in the buffer that have been written, or consumed when reading.
+     */
+    size_t position;
+
+    /**
+     * Number of bytes in the buffer, when reading.
+     */
+    size_t length;
+
+    /**
+     * Number of bytes that may still be read from the file descriptor, when reading.
+     */
+    uint64_t remaining;
+
+} tree_snapshot_stream_t;
+
+static bool snapshot_write_fully (int fd, const void* data, size_t length)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    while (length > 0)
+    {
+        const ssize_t written = write(fd, bytes, length);
+
+        if (written < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        else if (written <= 0)
+        {
+            return false;
+        }
+
+        bytes += written;
+        length -= (size_t) written;
+    }
+
+    return true;
+}
+
+static bool snapshot_read_fully (int fd, void* data, size_t length)
+{
+    unsigned char* bytes = (unsigned char*) data;
+
+    while (length > 0)
+    {
+        const ssize_t count = read(fd, bytes, length);
+
+        if (count < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        else if (count <= 0)
+        {
+            return false; // Error or premature end of file.
+        }
+
+        bytes += count;
+        length -= (size_t) count;
+    }
+
+    return true;
+}
+
+/**
+ * Folds data into a running checksum, one 64-bit word at a time.
+ * Only the last piece of data in a stream may have a length that is not a multiple of eight.
+ */
+static uint64_t snapshot_hash (uint64_t hash, const unsigned char* data, size_t length)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * UINT64_C(0x9E3779B97F4A7C15);
+        hash ^= hash >> 29;
+    }
+
+    for (; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * UINT64_C(0x100000001B3);
+    }
+
+    return hash;
+}
+
+static bool snapshot_flush (tree_snapshot_stream_t* stream)
+{
+    stream->checksum = snapshot_hash(stream->checksum, stream->buffer, stream->position);
+    const bool ok = snapshot_write_fully(stream->fd, stream->buffer, stream->position);
+    stream->position = 0;
+    return ok;
+}
+
+static bool snapshot_put (tree_snapshot_stream_t* stream, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    while (size > 0)
+    {
+        const size_t room = SNAPSHOT_BUFFER_SIZE - stream->position;
+        const size_t count = size < room ? size : room;
+        memcpy(stream->buffer + stream->position, bytes, count);
+        stream->position += count;
+        bytes += count;
+        size -= count;
+
+        if (SNAPSHOT_BUFFER_SIZE == stream->position && false == snapshot_flush(stream))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool snapshot_get (tree_snapshot_stream_t* stream, void* data, size_t size)
+{
+    unsigned char* bytes = (unsigned char*) data;
+
+    while (size > 0)
+    {
+        if (stream->position == stream->length)
+        {
+            // Never read past the end of the data, so that the trailing checksum is left in the file.
+            const size_t length = stream->remaining < SNAPSHOT_BUFFER_SIZE ? (size_t) stream->remaining : SNAPSHOT_BUFFER_SIZE;
+
+            if (0 == length || false == snapshot_read_fully(stream->fd, stream->buffer, length))
+            {
+                return false;
+            }
+
+            stream->checksum = snapshot_hash(stream->checksum, stream->buffer, length);
+            stream->remaining -= length;
+            stream->position = 0;
+            stream->length = length;
+        }
+
+        const size_t available = stream->length - stream->position;
+        const size_t count = size < available ? size : available;
+        memcpy(bytes, stream->buffer + stream->position, count);
+        stream->position += count;
+        bytes += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+static void snapshot_header (tree_snapshot_header_t* header, uint64_t count)
+{
+    memset(header, 0, sizeof(tree_snapshot_header_t));
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof(key_t);
+    header->value_size = (uint32_t) sizeof(data_t);
+    header->count = count;
+}
+
+/**
+ * Makes room for one more loaded node, unless the array of loaded nodes is full, by doubling it (up to the count).
+ */
+static bool snapshot_reserve (tree_node_t*** fresh, size_t* capacity, size_t loaded, size_t count)
+{
+    if (loaded < *capacity)
+    {
+        return true;
+    }
+
+    size_t grown = *capacity < SNAPSHOT_INITIAL_NODES ? SNAPSHOT_INITIAL_NODES : 2 * *capacity;
+    grown = grown < count ? grown : count;
+
+    tree_node_t** nodes = (tree_node_t**) realloc(*fresh, grown * sizeof(tree_node_t*));
+
+    if (NULL == nodes)
+    {
+        return false;
+    }
+
+    *fresh = nodes;
+    *capacity = grown;
+    return true;
+}
+
+/**
+ * Adds loaded nodes, which are sorted and free of duplicate keys, to the tree.
+ * Unless the tree is empty, the array of loaded nodes is grown first, to hold the existing nodes past its end.
+ * @return false if memory could not be allocated (the tree is then left unchanged).
+ */
+static bool snapshot_attach (tree_t* self, tree_node_t*** fresh, size_t count)
+{
+    if (0 == self->size)
+    {
+        // Since the entries are already sorted, the tree is built in linear time without any key comparisons.
+        self->root = build_balanced(*fresh, count);
+        self->size = count;
+        return true;
+    }
+
+    const size_t total = self->size + count;
+    tree_node_t** nodes = (tree_node_t**) realloc(*fresh, total * sizeof(tree_node_t*));
+    tree_node_t** scratch = NULL == nodes ? NULL : (tree_node_t**) malloc(total * sizeof(tree_node_t*));
+
+    *fresh = NULL == nodes ? *fresh : nodes;
+
+    if (NULL == scratch)
+    {
+        return false;
+    }
+
+    // The existing nodes are stored just past the loaded nodes, which leaves the scratch array free for the merge.
+    tree_node_t** existing = nodes + count;
+    const size_t existing_count = flatten_nodes(self->root, existing, 0);
+    const size_t merged = union_nodes(self, existing, existing_count, nodes, count, scratch);
+
+    self->root = build_balanced(scratch, merged);
+    self->size = merged;
+    free(scratch);
+    return true;
+}
+
+/**
+ * @brief Writes a binary snapshot of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * A snapshot consists of a header (magic, format version, byte order, key size, value size, and entry count),
+ * the key-value pairs in ascending order, and a trailing 64-bit checksum of everything before it.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool tree_save (tree_t* self, int fd)
+{
+    tree_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    if (NULL == stream.buffer)
+    {
+        return false;
+    }
+
+    tree_snapshot_header_t header;
+    snapshot_header(&header, self->size);
+    bool ok = snapshot_put(&stream, &header, sizeof(header));
+
+    // Iterative in-order traversal, which needs no parent pointers.
+    tree_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    tree_node_t* node = self->root;
+
+    while (ok && (NULL != node || depth > 0))
+    {
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        ok = snapshot_put(&stream, &node->key, sizeof(key_t)) && snapshot_put(&stream, &node->value, sizeof(data_t));
+        node = node->right;
+    }
+
+    ok = ok && snapshot_flush(&stream);
+    ok = ok && snapshot_write_fully(fd, &stream.checksum, sizeof(stream.checksum));
+
+    free(stream.buffer);
+    return ok;
+}
+
+/**
+ * @brief Reads a binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Loading fails, if the header does not match this tree's key and value types,
+ * if the data is truncated or fails the checksum, or if a node cannot be allocated.
+ * Since the entries are already sorted, an empty tree is built in linear time without any key comparisons.
+ * Otherwise, the entries are merged into the tree, replacing the values of keys that are already present.
+ */
+bool tree_load (tree_t* self, int fd)
+{
+    tree_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.remaining = sizeof(tree_snapshot_header_t);
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    tree_snapshot_header_t header;
+    tree_snapshot_header_t expected;
+
+    if (NULL == stream.buffer || false == snapshot_get(&stream, &header, sizeof(header)))
+    {
+        free(stream.buffer);
+        return false;
+    }
+
+    snapshot_header(&expected, header.count);
+    const size_t entry_size = sizeof(key_t) + sizeof(data_t);
+
+    if (0 != memcmp(&header, &expected, sizeof(header)) || header.count > (SIZE_MAX / 2 - self->size) / entry_size)
+    {
+        free(stream.buffer);
+        return false;
+    }
+
+    const size_t count = (size_t) header.count;
+    stream.remaining = (uint64_t) count * entry_size;
+
+    // The count is not trusted until the checksum matches; therefore, the array only grows as the entries arrive.
+    tree_node_t** fresh = NULL;
+    size_t capacity = 0;
+    size_t loaded = 0;
+    bool ok = true;
+
+    while (ok && loaded < count)
+    {
+        tree_node_t* node = snapshot_reserve(&fresh, &capacity, loaded, count) ? self->allocator->allocate(self->allocator) : NULL;
+
+        if (NULL == node)
+        {
+            ok = false;
+            break;
+        }
+
+        node->height = 0;
+        node->size = 1;
+        node->left = NULL;
+        node->right = NULL;
+        fresh[loaded++] = node;
+        ok = snapshot_get(&stream, &node->key, sizeof(key_t)) && snapshot_get(&stream, &node->value, sizeof(data_t));
+    }
+
+    // The checksum must match, before the tree is modified.
+    uint64_t checksum = 0;
+    ok = ok && snapshot_read_fully(fd, &checksum, sizeof(checksum)) && checksum == stream.checksum;
+    ok = ok && snapshot_attach(self, &fresh, count);
+
+    if (false == ok)
+    {
+        while (loaded > 0)
+        {
+            self->allocator->release(self->allocator, fresh[--loaded]);
+        }
+    }
+
+    free(stream.buffer);
+    free(fresh);
+    return ok;
+}
+
+#define IMAGE_MAGIC "TREEIMG1"
+#define IMAGE_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint32_t node_size;
+
+    uint32_t reserved;
+
+    uint64_t count;
+
+    /**
+     * Index of the root plus one, or zero if the image is empty.
+     */
+    uint64_t root;
+
+    /**
+     * Pads the header to a multiple of the alignment of the nodes.
+     */
+    uint64_t padding[2];
+
+} tree_image_header_t;
+
+struct tree_image
+{
+    void* base;
+
+    size_t length;
+
+    tree_image_node_t* nodes;
+
+    size_t count;
+
+    uint64_t root;
+
+    tree_comparator_t comparator;
+
+};
+
+static void image_header (tree_image_header_t* header, uint64_t count, uint64_t root)
+{
+    memset(header, 0, sizeof(tree_image_header_t));
+    memcpy(header->magic, IMAGE_MAGIC, sizeof(header->magic));
+    header->version = IMAGE_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof(key_t);
+    header->value_size = (uint32_t) sizeof(data_t);
+    header->node_size = (uint32_t) sizeof(tree_image_node_t);
+    header->count = count;
+    header->root = root;
+}
+
+static size_t image_size_of (tree_node_t* node)
+{
+    return NULL == node ? 0 : node->size;
+}
+
+/**
+ * Follows a link to a node, which lies strictly between the given links in a well-formed image.
+ * A missing child, and a corrupt link outside of these bounds, both yield NULL; since the bounds narrow
+ * with every step down, a search through a corrupt image still ends within count steps and never leaves the mapping.
+ */
+static tree_image_node_t* image_node (tree_image_t* self, uint64_t link, uint64_t lower, uint64_t upper)
+{
+    return lower < link && link < upper ? self->nodes + (link - 1) : NULL;
+}
+
+/**
+ * @brief Writes an image of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially.
+ * @return true if the image was written completely, false if an I/O error occurred.
+ *
+ * An image consists of a header, the nodes in ascending order, and a trailing 64-bit checksum.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool tree_saveImage (tree_t* self, int fd)
+{
+    tree_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    if (NULL == stream.buffer)
+    {
+        return false;
+    }
+
+    tree_image_header_t header;
+    image_header(&header, self->size, NULL == self->root ? 0 : image_size_of(self->root->left) + 1);
+    bool ok = snapshot_put(&stream, &header, sizeof(header));
+
+    // Iterative in-order traversal, where the index of each child follows from the sizes of the subtrees.
+    tree_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    size_t index = 0;
+    tree_node_t* node = self->root;
+
+    tree_image_node_t image;
+    memset(&image, 0, sizeof(image)); // Zero the padding, so that images are reproducible.
+
+    while (ok && (NULL != node || depth > 0))
+    {
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        image.left = NULL == node->left ? 0 : index - image_size_of(node->left->right);
+        image.right = NULL == node->right ? 0 : index + 2 + image_size_of(node->right->left);
+        image.key = node->key;
+        image.value = node->value;
+        ok = snapshot_put(&stream, &image, sizeof(image));
+        node = node->right;
+        ++index;
+    }
+
+    ok = ok && snapshot_flush(&stream);
+    ok = ok && snapshot_write_fully(fd, &stream.checksum, sizeof(stream.checksum));
+
+    free(stream.buffer);
+    return ok;
+}
+
+/**
+ * @brief Maps an image using the natural ordering of keys.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+tree_image_t* tree_image_open (int fd, bool copy_on_write)
+{
+    return tree_image_make(fd, copy_on_write, &tree_naturalOrder);
+}
+
+/**
+ * @brief Maps an image with a specified comparator, which must be the comparator of the saved tree.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+tree_image_t* tree_image_make (int fd, bool copy_on_write, tree_comparator_t comparator)
+{
+    struct stat status;
+
+    if (0 != fstat(fd, &status) || (uint64_t) status.st_size < sizeof(tree_image_header_t) + sizeof(uint64_t))
+    {
+        return NULL;
+    }
+
+    const size_t length = (size_t) status.st_size;
+    const int protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* base = mmap(NULL, length, protection, copy_on_write ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+
+    if (MAP_FAILED == base)
+    {
+        return NULL;
+    }
+
+    const tree_image_header_t* header = (const tree_image_header_t*) base;
+    tree_image_header_t expected;
+    image_header(&expected, header->count, header->root);
+
+    const uint64_t capacity = (length - sizeof(tree_image_header_t) - sizeof(uint64_t)) / sizeof(tree_image_node_t);
+    tree_image_t* self = NULL;
+
+    if (0 == memcmp(header, &expected, sizeof(expected)) && header->count <= capacity && header->root <= header->count)
+    {
+        self = (tree_image_t*) malloc(sizeof(tree_image_t));
+    }
+
+    if (NULL == self)
+    {
+        munmap(base, length);
+        return NULL;
+    }
+
+    self->base = base;
+    self->length = length;
+    self->nodes = (tree_image_node_t*) ((unsigned char*) base + sizeof(tree_image_header_t));
+    self->count = (size_t) header->count;
+    self->root = header->root;
+    self->comparator = comparator;
+    return self;
+}
+
+/**
+ * @brief Unmaps an image and frees its resources.
+ * @param self Pointer to the image.
+ */
+void tree_image_close (tree_image_t* self)
+{
+    if (NULL != self)
+    {
+        munmap(self->base, self->length);
+        free(self);
+    }
+}
+
+/**
+ * @brief Checks the checksum of an image, which reads the entire image.
+ * @param self Pointer to the image.
+ * @return true if the image is intact, false otherwise.
+ */
+bool tree_image_verify (tree_image_t* self)
+{
+    const size_t length = sizeof(tree_image_header_t) + self->count * sizeof(tree_image_node_t);
+    const unsigned char* bytes = (const unsigned char*) self->base;
+    uint64_t checksum;
+    memcpy(&checksum, bytes + length, sizeof(checksum));
+
+    // Hash in the same pieces as the writer, so that only the very last piece can end within a word.
+    uint64_t hash = 0;
+
+    for (size_t offset = 0; offset < length; offset += SNAPSHOT_BUFFER_SIZE)
+    {
+        const size_t piece = length - offset < SNAPSHOT_BUFFER_SIZE ? length - offset : SNAPSHOT_BUFFER_SIZE;
+        hash = snapshot_hash(hash, bytes + offset, piece);
+    }
+
+    return hash == checksum;
+}
+
+/**
+ * @brief Retrieves the number of nodes in an image.
+ * @param self Pointer to the image.
+ * @return Number of nodes in the image.
+ */
+size_t tree_image_size (tree_image_t* self)
+{
+    return self->count;
+}
+
+/**
+ * @brief Retrieves the node associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return Pointer to the node or NULL if not found.
+ */
+tree_image_node_t* tree_image_getNode (tree_image_t* self, key_t key)
+{
+    uint64_t lower = 0;
+    uint64_t upper = self->count + 1;
+    tree_image_node_t* node = image_node(self, self->root, lower, upper);
+
+    while (NULL != node)
+    {
+        const int cmp = self->comparator(NULL, &key, &node->key);
+        const uint64_t link = (uint64_t) (node - self->nodes) + 1;
+
+        if (0 == cmp)
+        {
+            return node;
+        }
+        else if (cmp < 0)
+        {
+            upper = link;
+            node = image_node(self, node->left, lower, upper);
+        }
+        else
+        {
+            lower = link;
+            node = image_node(self, node->right, lower, upper);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Retrieves the value associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+data_t tree_image_get (tree_image_t* self, key_t key)
+{
+    tree_image_node_t* node = tree_image_getNode(self, key);
+    return NULL == node ? tree_defaultValue() : node->value;
+}
+
+/**
+ * @brief Finds the successor node (next higher key) of a given key in an image.
+ * @param self Pointer to the image.
+ * @param key Key for which to find the higher node.
+ * @return Pointer to the higher node or NULL if not found.
+ */
+tree_image_node_t* tree_image_higherNode (tree_image_t* self, key_t key)
+{
+    uint64_t lower = 0;
+    uint64_t upper = self->count + 1;
+    tree_image_node_t* node = image_node(self, self->root, lower, upper);
+    tree_image_node_t* result = NULL;
+
+    while (NULL != node)
+    {
+        const uint64_t link = (uint64_t) (node - self->nodes) + 1;
+
+        if (self->comparator(NULL, &key, &node->key) < 0)
+        {
+            result = node;
+            upper = link;
+            node = image_node(self, node->left, lower, upper);
+        }
+        else
+        {
+            lower = link;
+            node = image_node(self, node->right, lower, upper);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Finds the nth node (0-based index) in an image, in constant time.
+ * @param self Pointer to the image.
+ * @param index The index of the node to find.
+ * @return Pointer to the nth node or NULL if not found.
+ */
+tree_image_node_t* tree_image_nthNode (tree_image_t* self, size_t index)
+{
+    return index < self->count ? self->nodes + index : NULL;
+}
+
+/**
+ * @brief Retrieves the first node (minimum key) of an image.
+ * @param self Pointer to the image.
+ * @return Pointer to the first node or NULL if the image is empty.
+ */
+tree_image_node_t* tree_image_firstNode (tree_image_t* self)
+{
+    return tree_image_nthNode(self, 0);
+}
+
+/**
+ * @brief Retrieves the node after a given node (next higher key) of an image, in constant time.
+ * @param self Pointer to the image.
+ * @param node Pointer to a node of the image.
+ * @return Pointer to the next node or NULL if the given node is the last one.
+ */
+tree_image_node_t* tree_image_nextNode (tree_image_t* self, tree_image_node_t* node)
+{
+    return tree_image_nthNode(self, (size_t) (node - self->nodes) + 1);
+}
+
+#define WAL_MAGIC "TREEWAL1"
+#define WAL_VERSION 1
+#define WAL_PUT 1
+#define WAL_REMOVE 2
+
+/**
+ * Number of records that recovery replays at once, using tree_applyBatch().
+ */
+#define WAL_REPLAY_BATCH 65536
+
+/**
+ * Number of entries that a checkpoint copies, while it holds off writers.
+ */
+#define WAL_CHECKPOINT_CHUNK 4096
+
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    /**
+     * Sequence number of the last record that was compacted into the snapshot, when the log was created.
+     */
+    uint64_t base;
+
+} tree_wal_header_t;
+
+/**
+ * Layout of a record, which is followed by a checksum of its bytes.
+ */
+typedef struct
+{
+    uint64_t sequence;
+
+    uint64_t kind;
+
+    key_t key;
+
+    data_t value;
+
+} tree_wal_record_t;
+
+#define WAL_RECORD_SIZE (sizeof(tree_wal_record_t) + sizeof(uint64_t))
+
+struct tree_wal
+{
+    tree_t* tree;
+
+    char* snapshot_path;
+
+    char* log_path;
+
+    int fd;
+
+    size_t group_size;
+
+    uint64_t max_latency_ns;
+
+    pthread_mutex_t mutex;
+
+    /**
+     * Signals the committer thread, when records arrive, or when a flush is requested.
+     */
+    pthread_cond_t wakeup;
+
+    /**
+     * Signals waiting threads, when records become durable, or when a compaction ends.
+     */
+    pthread_cond_t changed;
+
+    /**
+     * Records of the group that is currently being filled.
+     */
+    unsigned char* active;
+
+    size_t active_count;
+
+    size_t active_capacity;
+
+    /**
+     * Buffer of the group that is being written, while the next group fills up.
+     */
+    unsigned char* spare;
+
+    size_t spare_capacity;
+
+    uint64_t first_pending_ns;
+
+    uint64_t sequence;
+
+    uint64_t durable;
+
+    /**
+     * Sequence number of the last record before the first record in the log file.
+     */
+    uint64_t base;
+
+    bool flush_requested;
+
+    bool flushing;
+
+    bool compacting;
+
+    /**
+     * Whether a checkpoint is dropping the records, which its snapshot covers, from the log, while writers wait.
+     */
+    bool truncating;
+
+    bool stopping;
+
+    bool failed;
+
+    pthread_t committer;
+
+    bool checkpointing;
+
+    bool checkpoint_joinable;
+
+    bool checkpoint_ok;
+
+    /**
+     * Sequence number of the last record before the running checkpoint started.
+     */
+    uint64_t checkpoint_sequence;
+
+    pthread_t checkpointer;
+
+    tree_wal_checkpoint_stats_t checkpoint_stats;
+
+};
+
+static uint64_t wal_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+static void wal_header (tree_wal_header_t* header, uint64_t base)
+{
+    memset(header, 0, sizeof(tree_wal_header_t));
+    memcpy(header->magic, WAL_MAGIC, sizeof(header->magic));
+    header->version = WAL_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof(key_t);
+    header->value_size = (uint32_t) sizeof(data_t);
+    header->base = base;
+}
+
+/**
+ * Empties the log file, leaving only a header, and makes the change durable.
+ */
+static bool wal_reset (int fd, uint64_t base)
+{
+    tree_wal_header_t header;
+    wal_header(&header, base);
+
+    return 0 == ftruncate(fd, 0)
+           && 0 == lseek(fd, 0, SEEK_SET)
+           && snapshot_write_fully(fd, &header, sizeof(header))
+           && 0 == fsync(fd);
+}
+
+/**
+ * Makes a rename within the directory of a path durable.
+ */
+static bool wal_sync_directory (const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    char* directory = NULL == slash ? strdup(".") : strndup(path, slash == path ? 1 : (size_t) (slash - path));
+
+    if (NULL == directory)
+    {
+        return false;
+    }
+
+    const int fd = open(directory, O_RDONLY);
+    const bool ok = fd >= 0 && 0 == fsync(fd);
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    free(directory);
+    return ok;
+}
+
+/**
+ * Creates the path of the temporary file, which replaces the file at a path once it is complete.
+ */
+static char* wal_temporary_path (const char* path)
+{
+    const size_t length = strlen(path);
+    char* temporary = (char*) malloc(length + 5);
+
+    if (NULL != temporary)
+    {
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", 5);
+    }
+
+    return temporary;
+}
+
+/**
+ * Applies the records of the log to the tree, truncating the log after the last intact record.
+ */
+static bool wal_replay (tree_wal_t* self)
+{
+    tree_wal_header_t header;
+    tree_wal_header_t expected;
+    const off_t length = lseek(self->fd, 0, SEEK_END);
+
+    if (length < (off_t) sizeof(header))
+    {
+        self->base = 0;
+        return wal_reset(self->fd, 0); // New log, or a crash before the header was written.
+    }
+
+    if (0 != lseek(self->fd, 0, SEEK_SET) || false == snapshot_read_fully(self->fd, &header, sizeof(header)))
+    {
+        return false;
+    }
+
+    wal_header(&expected, header.base);
+
+    if (0 != memcmp(&header, &expected, sizeof(header)))
+    {
+        return false;
+    }
+
+    tree_op_t* ops = (tree_op_t*) malloc(WAL_REPLAY_BATCH * sizeof(tree_op_t));
+    unsigned char* records = (unsigned char*) malloc(WAL_REPLAY_BATCH * WAL_RECORD_SIZE);
+    bool ok = NULL != ops && NULL != records;
+    off_t end = sizeof(header);
+
+    self->base = header.base;
+    self->sequence = header.base;
+
+    while (ok)
+    {
+        // Read as many whole records as possible, stopping short at the end of the file.
+        size_t length = 0;
+
+        while (length < WAL_REPLAY_BATCH * WAL_RECORD_SIZE)
+        {
+            const ssize_t count = read(self->fd, records + length, WAL_REPLAY_BATCH * WAL_RECORD_SIZE - length);
+
+            if (count < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            else if (count < 0)
+            {
+                ok = false;
+            }
+
+            if (count <= 0)
+            {
+                break;
+            }
+
+            length += (size_t) count;
+        }
+
+        size_t count = 0;
+        bool intact = ok;
+
+        for (size_t offset = 0; intact && offset + WAL_RECORD_SIZE <= length; offset += WAL_RECORD_SIZE)
+        {
+            tree_wal_record_t record;
+            uint64_t checksum;
+            memcpy(&record, records + offset, sizeof(record));
+            memcpy(&checksum, records + offset + sizeof(record), sizeof(checksum));
+
+            intact = checksum == snapshot_hash(0, records + offset, sizeof(record))
+                     && record.sequence == self->sequence + 1
+                     && (WAL_PUT == record.kind || WAL_REMOVE == record.kind);
+
+            if (intact)
+            {
+                ops[count].remove = WAL_REMOVE == record.kind;
+                ops[count].key = record.key;
+                ops[count].value = record.value;
+                ++count;
+                ++self->sequence;
+            }
+        }
+
+        ok = ok && tree_applyBatch(self->tree, ops, count);
+        end += (off_t) (count * WAL_RECORD_SIZE);
+
+        if (false == intact || length < WAL_REPLAY_BATCH * WAL_RECORD_SIZE)
+        {
+            break;
+        }
+    }
+
+    // Discard a torn or corrupted tail, so that new records follow the last intact one.
+    ok = ok && (end == lseek(self->fd, 0, SEEK_END) || (0 == ftruncate(self->fd, end) && 0 == fsync(self->fd)));
+    ok = ok && end == lseek(self->fd, 0, SEEK_END);
+
+    free(ops);
+    free(records);
+    return ok;
+}
+
+static void* wal_main (void* argument)
+{
+    tree_wal_t* self = (tree_wal_t*) argument;
+
+    pthread_mutex_lock(&self->mutex);
+
+    while (true)
+    {
+        while (0 == self->active_count && false == self->stopping)
+        {
+            pthread_cond_wait(&self->wakeup, &self->mutex);
+        }
+
+        if (0 == self->active_count)
+        {
+            break; // Stopping, and everything is committed.
+        }
+
+        // Wait for the group to fill up, but no longer than the latency bound allows.
+        const uint64_t deadline = self->first_pending_ns + self->max_latency_ns;
+
+        while (self->active_count < self->group_size && false == self->flush_requested && false == self->stopping)
+        {
+            const uint64_t now = wal_now();
+
+            if (now >= deadline)
+            {
+                break;
+            }
+
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            const uint64_t until = (uint64_t) ts.tv_nsec + (deadline - now);
+            ts.tv_sec += until / UINT64_C(1000000000);
+            ts.tv_nsec = until % UINT64_C(1000000000);
+            pthread_cond_timedwait(&self->wakeup, &self->mutex, &ts);
+        }
+
+        // Swap the buffers, so that writers can fill the next group, while this one is written.
+        unsigned char* group = self->active;
+        const size_t group_capacity = self->active_capacity;
+        const size_t length = self->active_count * WAL_RECORD_SIZE;
+        const uint64_t sequence = self->sequence;
+
+        self->active = self->spare;
+        self->active_capacity = self->spare_capacity;
+        self->active_count = 0;
+        self->spare = group;
+        self->spare_capacity = group_capacity;
+        self->flush_requested = false;
+        self->flushing = true;
+
+        pthread_mutex_unlock(&self->mutex);
+        const bool ok = snapshot_write_fully(self->fd, group, length) && 0 == fdatasync(self->fd);
+        pthread_mutex_lock(&self->mutex);
+
+        self->flushing = false;
+        self->failed = self->failed || false == ok;
+        self->durable = ok ? sequence : self->durable;
+        pthread_cond_broadcast(&self->changed);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+    return NULL;
+}
+
+/**
+ * Appends a record to the current group, while the mutex is held.
+ */
+static uint64_t wal_append (tree_wal_t* self, uint64_t kind, key_t key, data_t value)
+{
+    if ((self->active_count + 1) * WAL_RECORD_SIZE > self->active_capacity)
+    {
+        const size_t capacity = 2 * (self->active_count + 1) * WAL_RECORD_SIZE;
+        unsigned char* active = (unsigned char*) realloc(self->active, capacity);
+
+        if (NULL == active)
+        {
+            return 0;
+        }
+
+        self->active = active;
+        self->active_capacity = capacity;
+    }
+
+    tree_wal_record_t record;
+    memset(&record, 0, sizeof(record)); // Zero the padding, which is part of the checksum.
+    record.sequence = self->sequence + 1;
+    record.kind = kind;
+    record.key = key;
+    record.value = value;
+
+    const uint64_t checksum = snapshot_hash(0, (const unsigned char*) &record, sizeof(record));
+    unsigned char* target = self->active + self->active_count * WAL_RECORD_SIZE;
+    memcpy(target, &record, sizeof(record));
+    memcpy(target + sizeof(record), &checksum, sizeof(checksum));
+
+    if (0 == self->active_count++)
+    {
+        self->first_pending_ns = wal_now();
+        pthread_cond_signal(&self->wakeup);
+    }
+    else if (self->active_count == self->group_size)
+    {
+        pthread_cond_signal(&self->wakeup);
+    }
+
+    return ++self->sequence;
+}
+
+/**
+ * Locks the log for a mutation, waiting for a compaction or the truncation of a checkpoint to end, if one is in progress.
+ */
+static bool wal_lock (tree_wal_t* self)
+{
+    pthread_mutex_lock(&self->mutex);
+
+    while ((self->compacting || self->truncating) && false == self->failed)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+
+    if (self->failed)
+    {
+        pthread_mutex_unlock(&self->mutex);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Commits the pending mutations, while the mutex is held, so that the log file is quiet.
+ * The caller blocks new mutations first, by setting the compacting or truncating flag.
+ */
+static void wal_quiesce (tree_wal_t* self)
+{
+    self->flush_requested = true;
+    pthread_cond_signal(&self->wakeup);
+
+    while ((self->active_count > 0 || self->flushing) && false == self->failed)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+}
+
+/**
+ * @brief Recovers a tree from a snapshot and a log, and then opens the log for appending.
+ * @param tree Pointer to the tree, which is usually empty, and which must only be mutated through the log from now on.
+ * @param snapshot_path Path of the snapshot file, which need not exist yet.
+ * @param log_path Path of the log file, which is created if it does not exist yet.
+ * @param group_size Maximum number of records committed by a single fsync.
+ * @param max_latency_ns Longest time that a record waits for its group to fill up, in nanoseconds.
+ * @return Pointer to the opened log or NULL if recovery failed.
+ */
+tree_wal_t* tree_wal_open (tree_t* tree, const char* snapshot_path, const char* log_path, size_t group_size, uint64_t max_latency_ns)
+{
+    tree_wal_t* self = (tree_wal_t*) calloc(1, sizeof(tree_wal_t));
+
+    if (NULL == self)
+    {
+        return NULL;
+    }
+
+    self->tree = tree;
+    self->group_size = group_size < 1 ? 1 : group_size;
+    self->max_latency_ns = max_latency_ns;
+    self->snapshot_path = strdup(snapshot_path);
+    self->log_path = strdup(log_path);
+    self->fd = -1;
+
+    if (NULL == self->snapshot_path || NULL == self->log_path)
+    {
+        free(self->snapshot_path);
+        free(self->log_path);
+        free(self);
+        return NULL;
+    }
+
+    // Load the last snapshot, if there is one.
+    const int snapshot = open(snapshot_path, O_RDONLY);
+    bool ok = snapshot >= 0 || ENOENT == errno;
+
+    if (snapshot >= 0)
+    {
+        ok = tree_load(tree, snapshot);
+        close(snapshot);
+    }
+
+    // Replay the log on top of the snapshot.
+    self->fd = ok ? open(log_path, O_RDWR | O_CREAT, 0644) : -1;
+    ok = ok && self->fd >= 0 && wal_replay(self);
+    self->durable = self->sequence;
+
+    if (ok)
+    {
+        pthread_condattr_t attributes;
+        pthread_condattr_init(&attributes);
+        pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+        pthread_cond_init(&self->wakeup, &attributes);
+        pthread_cond_init(&self->changed, &attributes);
+        pthread_condattr_destroy(&attributes);
+        pthread_mutex_init(&self->mutex, NULL);
+
+        if (0 != pthread_create(&self->committer, NULL, &wal_main, self))
+        {
+            pthread_mutex_destroy(&self->mutex);
+            pthread_cond_destroy(&self->wakeup);
+            pthread_cond_destroy(&self->changed);
+            ok = false;
+        }
+    }
+
+    if (false == ok)
+    {
+        if (self->fd >= 0)
+        {
+            close(self->fd);
+        }
+
+        free(self->snapshot_path);
+        free(self->log_path);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+/**
+ * @brief Commits all pending records, closes the log, and frees its resources (but not the tree).
+ * @param self Pointer to the log.
+ * @return true if all records were committed, false if an I/O error occurred at any point.
+ */
+bool tree_wal_close (tree_wal_t* self)
+{
+    if (NULL == self)
+    {
+        return true;
+    }
+
+    tree_wal_waitCheckpoint(self);
+
+    pthread_mutex_lock(&self->mutex);
+    self->stopping = true;
+    pthread_cond_signal(&self->wakeup);
+    pthread_mutex_unlock(&self->mutex);
+
+    pthread_join(self->committer, NULL);
+
+    const bool ok = false == self->failed && 0 == close(self->fd);
+
+    pthread_mutex_destroy(&self->mutex);
+    pthread_cond_destroy(&self->wakeup);
+    pthread_cond_destroy(&self->changed);
+    free(self->active);
+    free(self->spare);
+    free(self->snapshot_path);
+    free(self->log_path);
+    free(self);
+    return ok;
+}
+
+/**
+ * @brief Inserts a key-value pair into the tree and appends it to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return Sequence number of the record, or zero if the insertion failed or the log has failed.
+ */
+uint64_t tree_wal_put (tree_wal_t* self, key_t key, data_t value)
+{
+    if (false == wal_lock(self))
+    {
+        return 0;
+    }
+
+    const uint64_t sequence = tree_put(self->tree, key, value) ? wal_append(self, WAL_PUT, key, value) : 0;
+    pthread_mutex_unlock(&self->mutex);
+    return sequence;
+}
+
+/**
+ * @brief Removes a key from the tree and appends the removal to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to remove.
+ * @return Sequence number of the record, or zero if the log has failed.
+ */
+uint64_t tree_wal_remove (tree_wal_t* self, key_t key)
+{
+    if (false == wal_lock(self))
+    {
+        return 0;
+    }
+
+    tree_remove(self->tree, key);
+    const uint64_t sequence = wal_append(self, WAL_REMOVE, key, tree_defaultValue());
+    pthread_mutex_unlock(&self->mutex);
+    return sequence;
+}
+
+/**
+ * @brief Waits until the record with a given sequence number, and all records before it, are durable.
+ * @param self Pointer to the log.
+ * @param sequence Sequence number returned by a put or remove.
+ * @return true if the records are durable, false if an I/O error occurred.
+ */
+bool tree_wal_sync (tree_wal_t* self, uint64_t sequence)
+{
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->durable < sequence && false == self->failed)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+
+    const bool ok = self->durable >= sequence;
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
+}
+
+/**
+ * @brief Writes a new snapshot of the tree and truncates the log, while mutations wait.
+ * @param self Pointer to the log.
+ * @return true if the compaction succeeded, false otherwise (a failed snapshot leaves the log intact).
+ */
+bool tree_wal_compact (tree_wal_t* self)
+{
+    pthread_mutex_lock(&self->mutex);
+
+    // Compactions and checkpoints exclude each other, since both replace the snapshot and the log.
+    while ((self->compacting || self->checkpointing) && false == self->failed)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+
+    if (self->failed)
+    {
+        pthread_mutex_unlock(&self->mutex);
+        return false;
+    }
+
+    self->compacting = true;
+    wal_quiesce(self);
+
+    // Write the snapshot under a temporary name, and then atomically replace the old snapshot.
+    char* temporary = wal_temporary_path(self->snapshot_path);
+    bool ok = false == self->failed && NULL != temporary;
+
+    if (ok)
+    {
+        const int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ok = fd >= 0 && tree_save(self->tree, fd) && 0 == fsync(fd);
+        ok = fd >= 0 && 0 == close(fd) && ok;
+        ok = ok && 0 == rename(temporary, self->snapshot_path) && wal_sync_directory(self->snapshot_path);
+
+        if (false == ok)
+        {
+            unlink(temporary);
+        }
+    }
+
+    // The snapshot now contains every record; therefore, the log can be emptied.
+    if (ok && false == wal_reset(self->fd, self->sequence))
+    {
+        self->failed = true;
+        ok = false;
+    }
+
+    self->base = ok ? self->sequence : self->base;
+
+    free(temporary);
+    self->compacting = false;
+    pthread_cond_broadcast(&self->changed);
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
+}
+
+/**
+ * Writes a fuzzy snapshot of the tree, copying one chunk of entries at a time, while holding the mutex.
+ * The snapshot is only valid together with the records of the log after the start of the checkpoint.
+ * Since the number of entries is unknown until the end, the header is rewritten, and the checksum is computed, afterwards.
+ */
+static bool wal_checkpoint_dump (tree_wal_t* self, int fd, uint64_t* pause_ns, uint64_t* bytes)
+{
+    tree_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    key_t* keys = (key_t*) malloc(WAL_CHECKPOINT_CHUNK * sizeof(key_t));
+    data_t* values = (data_t*) malloc(WAL_CHECKPOINT_CHUNK * sizeof(data_t));
+    tree_node_t* stack[TREE_MAX_HEIGHT];
+    key_t last;
+    uint64_t count = 0;
+    bool done = false;
+
+    tree_snapshot_header_t header;
+    snapshot_header(&header, 0);
+    bool ok = NULL != stream.buffer && NULL != keys && NULL != values && snapshot_put(&stream, &header, sizeof(header));
+
+    while (ok && false == done)
+    {
+        pthread_mutex_lock(&self->mutex);
+        const uint64_t start = wal_now();
+
+        // Descend to the first entry after the last copied key, and then continue in order from there.
+        size_t depth = 0;
+        size_t length = 0;
+        tree_node_t* node = self->tree->root;
+
+        while (NULL != node)
+        {
+            if (0 == count || self->tree->comparator(self->tree, &last, &node->key) < 0)
+            {
+                stack[depth++] = node;
+                node = node->left;
+            }
+            else
+            {
+                node = node->right;
+            }
+        }
+
+        while (depth > 0 && length < WAL_CHECKPOINT_CHUNK)
+        {
+            node = stack[--depth];
+            keys[length] = node->key;
+            values[length] = node->value;
+            ++length;
+
+            for (node = node->right; NULL != node; node = node->left)
+            {
+                stack[depth++] = node;
+            }
+        }
+
+        done = 0 == depth;
+        self->checkpoint_stats.entries_written += length;
+        const uint64_t pause = wal_now() - start;
+        *pause_ns = pause > *pause_ns ? pause : *pause_ns;
+        pthread_mutex_unlock(&self->mutex);
+
+        // The chunk is written, while writers continue.
+        for (size_t i = 0; ok && i < length; i++)
+        {
+            ok = snapshot_put(&stream, &keys[i], sizeof(key_t)) && snapshot_put(&stream, &values[i], sizeof(data_t));
+        }
+
+        last = length > 0 ? keys[length - 1] : last;
+        count += length;
+    }
+
+    ok = ok && snapshot_flush(&stream);
+
+    // Rewrite the header with the final count, and then checksum the file from the start.
+    snapshot_header(&header, count);
+    ok = ok && (ssize_t) sizeof(header) == pwrite(fd, &header, sizeof(header), 0) && 0 == lseek(fd, 0, SEEK_SET);
+
+    uint64_t remaining = sizeof(header) + count * (sizeof(key_t) + sizeof(data_t));
+    uint64_t checksum = 0;
+    *bytes = remaining + sizeof(checksum);
+
+    while (ok && remaining > 0)
+    {
+        const size_t length = remaining < SNAPSHOT_BUFFER_SIZE ? (size_t) remaining : SNAPSHOT_BUFFER_SIZE;
+        ok = snapshot_read_fully(fd, stream.buffer, length);
+        checksum = snapshot_hash(checksum, stream.buffer, length);
+        remaining -= length;
+    }
+
+    ok = ok && snapshot_write_fully(fd, &checksum, sizeof(checksum));
+
+    free(stream.buffer);
+    free(keys);
+    free(values);
+    return ok;
+}
+
+/**
+ * Replaces the log file with a new one, which contains the records from an offset onwards, while the log is quiet.
+ */
+static bool wal_checkpoint_truncate (tree_wal_t* self, off_t offset, uint64_t base)
+{
+    char* temporary = wal_temporary_path(self->log_path);
+    const int fd = NULL == temporary ? -1 : open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    unsigned char* buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+    const off_t end = lseek(self->fd, 0, SEEK_END);
+
+    tree_wal_header_t header;
+    wal_header(&header, base);
+    bool ok = fd >= 0 && NULL != buffer && end >= offset && snapshot_write_fully(fd, &header, sizeof(header));
+
+    for (off_t position = offset; ok && position < end; )
+    {
+        const size_t length = end - position < SNAPSHOT_BUFFER_SIZE ? (size_t) (end - position) : SNAPSHOT_BUFFER_SIZE;
+        ok = (ssize_t) length == pread(self->fd, buffer, length, position) && snapshot_write_fully(fd, buffer, length);
+        position += (off_t) length;
+    }
+
+    ok = ok && 0 == fsync(fd) && 0 == rename(temporary, self->log_path);
+
+    if (ok)
+    {
+        close(self->fd);
+        self->fd = fd;
+        self->base = base;
+        ok = wal_sync_directory(self->log_path);
+    }
+    else
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+
+        if (NULL != temporary)
+        {
+            unlink(temporary);
+        }
+    }
+
+    free(buffer);
+    free(temporary);
+    return ok;
+}
+
+static void* wal_checkpoint_main (void* argument)
+{
+    tree_wal_t* self = (tree_wal_t*) argument;
+    const uint64_t started = wal_now();
+    uint64_t pause = 0;
+    uint64_t bytes = 0;
+
+    // Every record after the start of the checkpoint stays in the log, so that recovery can complete the fuzzy snapshot.
+    // Since only the checkpoint truncates the log, the base and the offset of that record stay the same until then.
+    pthread_mutex_lock(&self->mutex);
+    const uint64_t sequence = self->checkpoint_sequence;
+    const off_t offset = (off_t) (sizeof(tree_wal_header_t) + (sequence - self->base) * WAL_RECORD_SIZE);
+    pthread_mutex_unlock(&self->mutex);
+
+    // Write the snapshot under a temporary name, and then atomically replace the old snapshot.
+    char* temporary = wal_temporary_path(self->snapshot_path);
+    const int fd = NULL == temporary ? -1 : open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && wal_checkpoint_dump(self, fd, &pause, &bytes) && 0 == fsync(fd);
+    ok = fd >= 0 && 0 == close(fd) && ok;
+    ok = ok && 0 == rename(temporary, self->snapshot_path) && wal_sync_directory(self->snapshot_path);
+
+    if (false == ok && NULL != temporary)
+    {
+        unlink(temporary);
+    }
+
+    free(temporary);
+
+    // Drop the records that the snapshot covers, while writers wait.
+    pthread_mutex_lock(&self->mutex);
+    self->truncating = true;
+    wal_quiesce(self);
+
+    const uint64_t start = wal_now();
+    ok = ok && false == self->failed && wal_checkpoint_truncate(self, offset, sequence);
+    const uint64_t end = wal_now();
+
+    if (ok)
+    {
+        self->checkpoint_stats.checkpoints++;
+        self->checkpoint_stats.bytes_written = bytes;
+        self->checkpoint_stats.sequence = sequence;
+        self->checkpoint_stats.last_duration_ns = end - started;
+        self->checkpoint_stats.last_pause_ns = end - start > pause ? end - start : pause;
+        self->checkpoint_stats.total_duration_ns += end - started;
+    }
+    else
+    {
+        self->checkpoint_stats.failures++;
+    }
+
+    self->checkpoint_stats.running = false;
+    self->checkpoint_ok = ok;
+    self->checkpointing = false;
+    self->truncating = false;
+    pthread_cond_broadcast(&self->changed);
+    pthread_mutex_unlock(&self->mutex);
+    return NULL;
+}
+
+/**
+ * @brief Starts a checkpoint on a background thread, which writes a new snapshot while writers continue.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint was started, false if one is already running or the thread cannot be created.
+ *
+ * A checkpoint copies the tree in small chunks, locking out writers only while a chunk is copied.
+ * The resulting snapshot is fuzzy; it reflects each key at some point after the checkpoint started.
+ * Recovery still reaches the exact state, because the log keeps every record after that point.
+ * When the snapshot is durable, the log is replaced by just those records,
+ * which is the only other time when writers wait (for as long as the copy of these records takes).
+ *
+ * Notes:
+ * - The snapshot file is not valid on its own, but only together with the log. It may mix states from different
+ *   points in time, so it must not be loaded with tree_load() alone, or be used as a backup or for a standby.
+ *   Use tree_wal_compact(), or tree_save() on a quiescent tree, for a consistent snapshot.
+ * - Every checkpoint rewrites the whole tree, so its cost grows with the size of the tree, not with the number of changes.
+ */
+bool tree_wal_startCheckpoint (tree_wal_t* self)
+{
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->compacting && false == self->failed && false == self->checkpointing)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+
+    if (self->checkpointing || self->failed)
+    {
+        pthread_mutex_unlock(&self->mutex);
+        return false;
+    }
+
+    // The previous checkpoint has released the mutex for the last time; therefore, joining it here does not block.
+    if (self->checkpoint_joinable)
+    {
+        pthread_join(self->checkpointer, NULL);
+        self->checkpoint_joinable = false;
+    }
+
+    // The start of the checkpoint is fixed before its thread runs, so that the writes until then are not counted into it.
+    self->checkpoint_sequence = self->sequence;
+    self->checkpoint_stats.entries_written = 0;
+    self->checkpoint_stats.entries_expected = self->tree->size;
+
+    const bool ok = 0 == pthread_create(&self->checkpointer, NULL, &wal_checkpoint_main, self);
+
+    self->checkpoint_joinable = ok;
+    self->checkpointing = ok;
+    self->checkpoint_stats.running = ok;
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
+}
+
+/**
+ * @brief Waits until the checkpoint that was started last completes.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint succeeded, false if it failed or no checkpoint was ever started.
+ */
+bool tree_wal_waitCheckpoint (tree_wal_t* self)
+{
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->checkpointing)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+
+    // The checkpoint has released the mutex for the last time; therefore, joining it here does not block.
+    if (self->checkpoint_joinable)
+    {
+        pthread_join(self->checkpointer, NULL);
+        self->checkpoint_joinable = false;
+    }
+
+    const bool ok = self->checkpoint_ok;
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
+}
+
+/**
+ * @brief Retrieves the progress and timing counters of the checkpoints of a log.
+ * @param self Pointer to the log.
+ * @return Copy of the counters.
+ */
+tree_wal_checkpoint_stats_t tree_wal_checkpointStats (tree_wal_t* self)
+{
+    pthread_mutex_lock(&self->mutex);
+    const tree_wal_checkpoint_stats_t stats = self->checkpoint_stats;
+    pthread_mutex_unlock(&self->mutex);
+    return stats;
+}
+
+#define PACKED_MAGIC "TREEPACK"
+#define PACKED_VERSION 1
+
+/**
+ * Number of entries in a block, which share a bit width for the keys and one for the values.
+ */
+#define PACKED_BLOCK 128
+
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint64_t count;
+
+    /**
+     * Number of bytes in the blocks, which follow the header.
+     */
+    uint64_t length;
+
+} tree_packed_header_t;
+
+typedef struct
+{
+    /**
+     * Key of the first entry, sign-extended to 64 bits; the remaining keys are stored as differences.
+     */
+    uint64_t first_key;
+
+    /**
+     * Smallest value in the block, sign-extended to 64 bits; the values are stored as differences to it.
+     */
+    uint64_t value_base;
+
+    uint16_t count;
+
+    uint8_t key_width;
+
+    uint8_t value_width;
+
+    uint32_t reserved;
+
+} tree_packed_block_t;
+
+/**
+ * A block in its unpacked form.
+ */
+typedef struct
+{
+    size_t count;
+
+    uint64_t keys[PACKED_BLOCK];
+
+    uint64_t values[PACKED_BLOCK];
+
+    uint64_t words[PACKED_BLOCK];
+
+} tree_packed_buffer_t;
+
+static unsigned packed_width (uint64_t x)
+{
+    unsigned width = 0;
+
+    while (x > 0)
+    {
+        ++width;
+        x >>= 1;
+    }
+
+    return width;
+}
+
+static size_t packed_words (size_t count, unsigned width)
+{
+    return (count * width + 63) / 64;
+}
+
+static void packed_encode (const uint64_t* input, size_t count, unsigned width, uint64_t* output)
+{
+    memset(output, 0, packed_words(count, width) * sizeof(uint64_t));
+
+    for (size_t i = 0; width > 0 && i < count; i++)
+    {
+        const size_t bit = i * width;
+        const unsigned shift = bit % 64;
+        output[bit / 64] |= input[i] << shift;
+
+        if (shift + width > 64)
+        {
+            output[bit / 64 + 1] |= input[i] >> (64 - shift);
+        }
+    }
+}
+
+static void packed_decode (const uint64_t* input, size_t count, unsigned width, uint64_t* output)
+{
+    const uint64_t mask = 64 == width ? UINT64_MAX : (UINT64_C(1) << width) - 1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t bit = i * width;
+        const unsigned shift = bit % 64;
+        const uint64_t low = 0 == width ? 0 : input[bit / 64] >> shift;
+        const uint64_t high = shift + width > 64 ? input[bit / 64 + 1] << (64 - shift) : 0;
+        output[i] = (low | high) & mask;
+    }
+}
+
+/**
+ * Encodes and writes the block in a buffer, or only measures it, if the stream is NULL.
+ */
+static bool packed_flush (tree_snapshot_stream_t* stream, tree_packed_buffer_t* buffer, uint64_t* length)
+{
+    tree_packed_block_t block;
+    memset(&block, 0, sizeof(block));
+    block.count = (uint16_t) buffer->count;
+    block.first_key = buffer->keys[0];
+    block.value_base = buffer->values[0];
+
+    // Modular differences also round trip, when the comparator does not order the keys numerically.
+    uint64_t key_bits = 0;
+    uint64_t value_bits = 0;
+
+    for (size_t i = 1; i < buffer->count; i++)
+    {
+        block.value_base = (int64_t) buffer->values[i] < (int64_t) block.value_base ? buffer->values[i] : block.value_base;
+    }
+
+    for (size_t i = buffer->count - 1; i > 0; i--)
+    {
+        buffer->keys[i] -= buffer->keys[i - 1];
+        key_bits |= buffer->keys[i];
+    }
+
+    for (size_t i = 0; i < buffer->count; i++)
+    {
+        buffer->values[i] -= block.value_base;
+        value_bits |= buffer->values[i];
+    }
+
+    block.key_width = (uint8_t) packed_width(key_bits);
+    block.value_width = (uint8_t) packed_width(value_bits);
+
+    const size_t key_words = packed_words(buffer->count - 1, block.key_width);
+    const size_t value_words = packed_words(buffer->count, block.value_width);
+    *length += sizeof(block) + (key_words + value_words) * sizeof(uint64_t);
+
+    if (NULL == stream)
+    {
+        buffer->count = 0;
+        return true;
+    }
+
+    bool ok = snapshot_put(stream, &block, sizeof(block));
+    packed_encode(buffer->keys + 1, buffer->count - 1, block.key_width, buffer->words);
+    ok = ok && snapshot_put(stream, buffer->words, key_words * sizeof(uint64_t));
+    packed_encode(buffer->values, buffer->count, block.value_width, buffer->words);
+    ok = ok && snapshot_put(stream, buffer->words, value_words * sizeof(uint64_t));
+
+    buffer->count = 0;
+    return ok;
+}
+
+/**
+ * Encodes the entries of the tree in order, either writing them, or only measuring their length, if the stream is NULL.
+ */
+static bool packed_blocks (tree_t* self, tree_snapshot_stream_t* stream, tree_packed_buffer_t* buffer, uint64_t* length)
+{
+    tree_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    tree_node_t* node = self->root;
+    bool ok = true;
+
+    buffer->count = 0;
+    *length = 0;
+
+    while (ok && (NULL != node || depth > 0))
+    {
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        buffer->keys[buffer->count] = (uint64_t) (int64_t) node->key;
+        buffer->values[buffer->count] = (uint64_t) (int64_t) node->value;
+        node = node->right;
+
+        if (++buffer->count == PACKED_BLOCK)
+        {
+            ok = packed_flush(stream, buffer, length);
+        }
+    }
+
+    return ok && (0 == buffer->count || packed_flush(stream, buffer, length));
+}
+
+static void packed_header (tree_packed_header_t* header, uint64_t count, uint64_t length)
+{
+    memset(header, 0, sizeof(tree_packed_header_t));
+    memcpy(header->magic, PACKED_MAGIC, sizeof(header->magic));
+    header->version = PACKED_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof(key_t);
+    header->value_size = (uint32_t) sizeof(data_t);
+    header->count = count;
+    header->length = length;
+}
+
+/**
+ * @brief Writes a packed binary snapshot of the AVL tree, whose keys and values are integers, to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * The entries are stored in blocks of 128. Within a block, the differences between consecutive keys,
+ * and the differences between the values and the smallest value, are bit-packed using the fewest bits
+ * that fit the largest difference (frame-of-reference encoding). Dense ascending keys take about one bit each.
+ * Like a plain snapshot, a packed snapshot has a header and a trailing checksum.
+ */
+bool tree_savePacked (tree_t* self, int fd)
+{
+    tree_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    tree_packed_buffer_t* buffer = (tree_packed_buffer_t*) malloc(sizeof(tree_packed_buffer_t));
+    bool ok = NULL != stream.buffer && NULL != buffer;
+
+    // The header records the length of the blocks, so that a reader never consumes the checksum early.
+    // Measuring first takes an extra pass over the tree, but no seeking; therefore, pipes remain usable.
+    uint64_t length = 0;
+    ok = ok && packed_blocks(self, NULL, buffer, &length);
+
+    tree_packed_header_t header;
+    packed_header(&header, self->size, length);
+    ok = ok && snapshot_put(&stream, &header, sizeof(header));
+    ok = ok && packed_blocks(self, &stream, buffer, &length);
+    ok = ok && snapshot_flush(&stream);
+    ok = ok && snapshot_write_fully(fd, &stream.checksum, sizeof(stream.checksum));
+
+    free(stream.buffer);
+    free(buffer);
+    return ok;
+}
+
+/**
+ * @brief Reads a packed binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Decoding a block takes fixed-width shifts and masks, followed by a prefix sum of the key differences,
+ * without any data-dependent branches.
+ */
+bool tree_loadPacked (tree_t* self, int fd)
+{
+    tree_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.remaining = sizeof(tree_packed_header_t);
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    tree_packed_buffer_t* buffer = (tree_packed_buffer_t*) malloc(sizeof(tree_packed_buffer_t));
+    tree_packed_header_t header;
+    tree_packed_header_t expected;
+
+    if (NULL == stream.buffer || NULL == buffer || false == snapshot_get(&stream, &header, sizeof(header)))
+    {
+        free(stream.buffer);
+        free(buffer);
+        return false;
+    }
+
+    packed_header(&expected, header.count, header.length);
+
+    if (0 != memcmp(&header, &expected, sizeof(header)) || header.count > (SIZE_MAX / 2 - self->size) / sizeof(tree_node_t*))
+    {
+        free(stream.buffer);
+        free(buffer);
+        return false;
+    }
+
+    const size_t count = (size_t) header.count;
+    stream.remaining = header.length;
+
+    // Neither the count nor the length is trusted until the checksum matches; therefore, the array only grows as the entries arrive.
+    tree_node_t** fresh = NULL;
+    size_t capacity = 0;
+    size_t loaded = 0;
+    bool ok = true;
+
+    while (ok && loaded < count)
+    {
+        tree_packed_block_t block;
+        ok = snapshot_get(&stream, &block, sizeof(block))
+             && block.count > 0 && block.count <= PACKED_BLOCK && block.count <= count - loaded
+             && block.key_width <= 64 && block.value_width <= 64;
+
+        if (false == ok)
+        {
+            break;
+        }
+
+        // Unpack the key differences, and then sum them up, starting from the first key.
+        const size_t key_words = packed_words(block.count - 1, block.key_width);
+        const size_t value_words = packed_words(block.count, block.value_width);
+        ok = snapshot_get(&stream, buffer->words, key_words * sizeof(uint64_t));
+        packed_decode(buffer->words, block.count - 1, block.key_width, buffer->keys + 1);
+        ok = ok && snapshot_get(&stream, buffer->words, value_words * sizeof(uint64_t));
+        packed_decode(buffer->words, block.count, block.value_width, buffer->values);
+
+        buffer->keys[0] = block.first_key;
+
+        for (size_t i = 1; i < block.count; i++)
+        {
+            buffer->keys[i] += buffer->keys[i - 1];
+        }
+
+        for (size_t i = 0; ok && i < block.count; i++)
+        {
+            tree_node_t* node = snapshot_reserve(&fresh, &capacity, loaded, count) ? self->allocator->allocate(self->allocator) : NULL;
+
+            if (NULL == node)
+            {
+                ok = false;
+                break;
+            }
+
+            node->key = (key_t) (int64_t) buffer->keys[i];
+            node->value = (data_t) (int64_t) (buffer->values[i] + block.value_base);
+            node->height = 0;
+            node->size = 1;
+            node->left = NULL;
+            node->right = NULL;
+            fresh[loaded++] = node;
+        }
+    }
+
+    // The checksum must match, before the tree is modified.
+    uint64_t checksum = 0;
+    ok = ok && 0 == stream.remaining && stream.position == stream.length;
+    ok = ok && snapshot_read_fully(fd, &checksum, sizeof(checksum)) && checksum == stream.checksum;
+    ok = ok && snapshot_attach(self, &fresh, count);
+
+    if (false == ok)
+    {
+        while (loaded > 0)
+        {
+            self->allocator->release(self->allocator, fresh[--loaded]);
+        }
+    }
+
+    free(stream.buffer);
+    free(buffer);
+    free(fresh);
+    return ok;
+}
+
+/**
+ * Counts and hashes the entries, whose keys are less than a bound (or all of the entries, if the bound is NULL).
+ */
+static void hash_below (tree_t* self, key_t* bound, size_t* count, uint64_t* hash)
+{
+    if (NULL == bound)
+    {
+        *count = size_of(self->root);
+        *hash = hash_of(self->root);
+        return;
+    }
+
+    *count = 0;
+    *hash = 0;
+
+    for (tree_node_t* node = self->root; NULL != node;)
+    {
+        if (self->comparator(self, &node->key, bound) < 0)
+        {
+            // The node and its left subtree are below the bound.
+            *count += size_of(node->left) + 1;
+            *hash += hash_of(node) - hash_of(node->right);
+            node = node->right;
+        }
+        else
+        {
+            node = node->left;
+        }
+    }
+}
+
+/**
+ * Counts and hashes the entries, whose keys are in a half-open range, where NULL means unbounded.
+ */
+static void hash_between (tree_t* self, key_t* lo, key_t* hi, size_t* count, uint64_t* hash)
+{
+    if (NULL != lo && NULL != hi && self->comparator(self, lo, hi) >= 0)
+    {
+        *count = 0;
+        *hash = 0;
+        return;
+    }
+
+    hash_below(self, hi, count, hash);
+
+    if (NULL != lo)
+    {
+        size_t lower_count;
+        uint64_t lower_hash;
+        hash_below(self, lo, &lower_count, &lower_hash);
+        *count -= lower_count;
+        *hash -= lower_hash;
+    }
+}
+
+typedef struct
+{
+    tree_t* self;
+
+    tree_t* other;
+
+    size_t leaf_size;
+
+    bool (*callback)(tree_t*, key_t*, key_t*, void*);
+
+    void* context;
+
+} tree_mismatch_t;
+
+/**
+ * Reports the mismatched parts of a range, after splitting it at the median key of the tree,
+ * which has more entries in the range, until the parts are small enough.
+ */
+static bool mismatch_range (tree_mismatch_t* search, key_t* lo, key_t* hi)
+{
+    size_t count;
+    uint64_t hash;
+    hash_between(search->self, lo, hi, &count, &hash);
+
+    size_t other_count;
+    uint64_t other_hash;
+    hash_between(search->other, lo, hi, &other_count, &other_hash);
+
+    if (count == other_count && hash == other_hash)
+    {
+        return true;
+    }
+    else if (count + other_count <= search->leaf_size || (count < 2 && other_count < 2))
+    {
+        return search->callback(search->self, lo, hi, search->context);
+    }
+
+    // The larger side has at least two entries in the range, so that both parts become smaller.
+    tree_t* larger = count >= other_count ? search->self : search->other;
+    const size_t larger_count = count >= other_count ? count : other_count;
+
+    size_t first = 0;
+    uint64_t ignored;
+
+    if (NULL != lo)
+    {
+        hash_below(larger, lo, &first, &ignored);
+    }
+
+    key_t middle = tree_nthNode(larger, first + larger_count / 2)->key;
+
+    return mismatch_range(search, lo, &middle) && mismatch_range(search, &middle, hi);
+}
+
+static void rehash_nodes (tree_node_t* node)
+{
+    if (NULL != node)
+    {
+        rehash_nodes(node->left);
+        rehash_nodes(node->right);
+        update_size(node);
+    }
+}
+
+/**
+ * @brief Computes the hash of a single entry, which is the unit of the subtree hashes.
+ * @param key Key of the entry.
+ * @param value Data value of the entry.
+ * @return Hash of the bytes of the key and the value (pointers are hashed by address).
+ */
+uint64_t tree_hashEntry (key_t key, data_t value)
+{
+    return hash_entry(&key, &value);
+}
+
+/**
+ * @brief Retrieves the hash of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Hash of the tree, which is zero, if the tree is empty.
+ */
+uint64_t tree_hash (tree_t* self)
+{
+    return hash_of(self->root);
+}
+
+/**
+ * @brief Computes the hash of the entries, whose keys are in a half-open range, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Hash of the entries in the range.
+ */
+uint64_t tree_hashRange (tree_t* self, key_t* lo, key_t* hi)
+{
+    size_t count;
+    uint64_t hash;
+    hash_between(self, lo, hi, &count, &hash);
+    return hash;
+}
+
+/**
+ * @brief Finds the key ranges, where two AVL trees differ, by descending only into mismatched ranges.
+ * @param self Pointer to the AVL tree.
+ * @param other Pointer to the other AVL tree, which must use the same comparator.
+ * @param leaf_size Largest number of entries (in both trees together) of a reported range.
+ * @param callback Function that receives each range as an inclusive lower bound and an exclusive upper bound,
+ *                 where NULL means unbounded, and returns false to stop the search.
+ * @param context User-defined context for the callback.
+ * @return true if the search completed, false if the callback stopped it.
+ */
+bool tree_mismatches (tree_t* self, tree_t* other, size_t leaf_size, bool (*callback)(tree_t*, key_t*, key_t*, void*), void* context)
+{
+    tree_mismatch_t search;
+    search.self = self;
+    search.other = other;
+    search.leaf_size = leaf_size;
+    search.callback = callback;
+    search.context = context;
+    return mismatch_range(&search, NULL, NULL);
+}
+
+/**
+ * @brief Recomputes the hashes of all of the subtrees in linear time.
+ * @param self Pointer to the AVL tree.
+ */
+void tree_rehash (tree_t* self)
+{
+    rehash_nodes(self->root);
+}
+
+#define DISK_MAGIC "TREEDSK1"
+#define DISK_VERSION 1
+#define DISK_PAGE_SIZE 4096
+#define DISK_LEAF 1
+#define DISK_INNER 2
+
+/**
+ * Smallest number of pages in the cache. An insertion pins at most three pages at once.
+ */
+#define DISK_MIN_CACHE_PAGES 8
+
+/**
+ * Largest number of keys that getMany() looks up together. A batch pins at most a quarter of the cache.
+ */
+#define DISK_BATCH 1024
+
+/**
+ * Number of threads that read pages, when io_uring is not used.
+ */
+#define DISK_READERS 8
+
+/**
+ * Number of entries of the submission queue, which bounds the number of reads in flight.
+ */
+#define DISK_RING_ENTRIES 256
+
+/**
+ * Layout of the header, which is stored at the start of page zero.
+ */
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint32_t page_size;
+
+    /**
+     * Number of levels of the tree, which is zero if the tree has no pages yet.
+     */
+    uint32_t height;
+
+    uint64_t root;
+
+    uint64_t first_leaf;
+
+    uint64_t count;
+
+    uint64_t page_count;
+
+} tree_disk_header_t;
+
+/**
+ * Layout of the start of a page. A leaf page continues with an array of keys and an array of values.
+ * An inner page continues with an array of keys and an array of child page numbers, which has one more element.
+ * In an inner page, key i is the smallest key in the subtree of child i + 1.
+ */
+typedef struct
+{
+    uint32_t kind;
+
+    uint32_t count;
+
+    /**
+     * Number of the next leaf page in key order, or zero for the last leaf page (and for inner pages).
+     */
+    uint64_t next;
+
+} tree_disk_page_t;
+
+/**
+ * State of a slot in the page cache.
+ */
+typedef struct
+{
+    /**
+     * Number of the cached page, or zero if the slot is free (the header page is never cached).
+     */
+    uint64_t page;
+
+    uint32_t pins;
+
+    bool dirty;
+
+    /**
+     * Set on every access, and cleared when the clock hand passes the slot.
+     */
+    bool referenced;
+
+    /**
+     * Number of the last batch, which pinned this slot.
+     */
+    uint64_t batch;
+
+} tree_disk_frame_t;
+
+/**
+ * A page read, which is part of a batch.
+ */
+typedef struct
+{
+    uint64_t page;
+
+    size_t frame;
+
+    bool done;
+
+    bool ok;
+
+} tree_disk_read_t;
+
+/**
+ * An io_uring instance, which is set up using the raw system calls, since liburing is not required.
+ */
+typedef struct
+{
+    int fd;
+
+    unsigned entries;
+
+    void* sq_ring;
+
+    size_t sq_length;
+
+    void* cq_ring;
+
+    size_t cq_length;
+
+    struct io_uring_sqe* sqes;
+
+    size_t sqes_length;
+
+    unsigned* sq_head;
+
+    unsigned* sq_tail;
+
+    unsigned* sq_mask;
+
+    unsigned* sq_array;
+
+    unsigned* cq_head;
+
+    unsigned* cq_tail;
+
+    unsigned* cq_mask;
+
+    struct io_uring_cqe* cqes;
+
+} tree_disk_ring_t;
+
+struct tree_disk
+{
+    int fd;
+
+    tree_comparator_t comparator;
+
+    tree_disk_header_t header;
+
+    size_t leaf_capacity;
+
+    size_t inner_capacity;
+
+    /**
+     * Offset of the values in a leaf page, and of the children in an inner page, which are suitably aligned.
+     */
+    size_t values_offset;
+
+    size_t children_offset;
+
+    size_t frame_count;
+
+    tree_disk_frame_t* frames;
+
+    unsigned char* data;
+
+    /**
+     * Open addressing hash table with linear probing, which maps page numbers to frames (plus one, so zero is empty).
+     */
+    uint32_t* table;
+
+    size_t table_mask;
+
+    unsigned table_shift;
+
+    size_t hand;
+
+    bool failed;
+
+    tree_disk_stats_t stats;
+
+    pthread_mutex_t read_mutex;
+
+    /**
+     * Signals the reader threads, when a batch of reads is available.
+     */
+    pthread_cond_t read_start;
+
+    /**
+     * Signals the thread, which waits for a batch of reads, when all of them are done.
+     */
+    pthread_cond_t read_done;
+
+    pthread_t readers[DISK_READERS];
+
+    size_t reader_count;
+
+    tree_disk_read_t* read_jobs;
+
+    size_t read_count;
+
+    size_t read_next;
+
+    size_t read_pending;
+
+    bool read_stopping;
+
+    /**
+     * Number of the last batch of getMany().
+     */
+    uint64_t batch;
+
+    tree_disk_ring_t ring;
+
+    bool use_ring;
+
+};
+
+static size_t disk_align (size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static key_t* disk_keys (tree_disk_page_t* page)
+{
+    return (key_t*) ((unsigned char*) page + sizeof(tree_disk_page_t));
+}
+
+static data_t* disk_values (tree_disk_t* self, tree_disk_page_t* page)
+{
+    return (data_t*) ((unsigned char*) page + self->values_offset);
+}
+
+static uint64_t* disk_children (tree_disk_t* self, tree_disk_page_t* page)
+{
+    return (uint64_t*) ((unsigned char*) page + self->children_offset);
+}
+
+static size_t disk_frame_of (tree_disk_t* self, tree_disk_page_t* page)
+{
+    return (size_t) ((unsigned char*) page - self->data) / DISK_PAGE_SIZE;
+}
+
+static uint64_t disk_number_of (tree_disk_t* self, tree_disk_page_t* page)
+{
+    return self->frames[disk_frame_of(self, page)].page;
+}
+
+static size_t disk_home (tree_disk_t* self, uint64_t page)
+{
+    return (size_t) ((page * UINT64_C(0x9E3779B97F4A7C15)) >> self->table_shift);
+}
+
+/**
+ * Finds the slot of the hash table, which holds a page, or the empty slot, where the page would be inserted.
+ */
+static size_t disk_slot (tree_disk_t* self, uint64_t page)
+{
+    size_t slot = disk_home(self, page);
+
+    while (0 != self->table[slot] && self->frames[self->table[slot] - 1].page != page)
+    {
+        slot = (slot + 1) & self->table_mask;
+    }
+
+    return slot;
+}
+
+/**
+ * Removes a page from the hash table, and then shifts the following entries back into the gap,
+ * so that no probe sequence is broken (which avoids tombstones).
+ */
+static void disk_unmap (tree_disk_t* self, uint64_t page)
+{
+    size_t gap = disk_slot(self, page);
+    self->table[gap] = 0;
+
+    for (size_t slot = (gap + 1) & self->table_mask; 0 != self->table[slot]; slot = (slot + 1) & self->table_mask)
+    {
+        const size_t home = disk_home(self, self->frames[self->table[slot] - 1].page);
+
+        // The entry may move into the gap, unless its home lies cyclically in (gap, slot].
+        const bool stays = gap <= slot ? (gap < home && home <= slot) : (gap < home || home <= slot);
+
+        if (false == stays)
+        {
+            self->table[gap] = self->table[slot];
+            self->table[slot] = 0;
+            gap = slot;
+        }
+    }
+}
+
+static bool disk_write_page (tree_disk_t* self, size_t frame)
+{
+    const ssize_t written = pwrite(self->fd, self->data + frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (self->frames[frame].page * DISK_PAGE_SIZE));
+
+    if (DISK_PAGE_SIZE != written)
+    {
+        self->failed = true;
+        return false;
+    }
+
+    self->frames[frame].dirty = false;
+    ++self->stats.writes;
+    return true;
+}
+
+/**
+ * Advances the clock hand to an unpinned slot, whose page has not been accessed since the hand passed it last.
+ * A dirty page is written back, before its slot is returned.
+ */
+static bool disk_victim (tree_disk_t* self, size_t* victim)
+{
+    for (size_t step = 0; step < 2 * self->frame_count; step++)
+    {
+        const size_t frame = self->hand;
+        self->hand = (self->hand + 1) % self->frame_count;
+
+        if (self->frames[frame].pins > 0)
+        {
+            continue;
+        }
+        else if (0 == self->frames[frame].page)
+        {
+            *victim = frame;
+            return true;
+        }
+        else if (self->frames[frame].referenced)
+        {
+            self->frames[frame].referenced = false;
+            continue;
+        }
+        else if (self->frames[frame].dirty && false == disk_write_page(self, frame))
+        {
+            return false;
+        }
+
+        disk_unmap(self, self->frames[frame].page);
+        self->frames[frame].page = 0;
+        ++self->stats.evictions;
+        *victim = frame;
+        return true;
+    }
+
+    // Every slot is pinned.
+    return false;
+}
+
+/**
+ * Pins a page in the cache, after reading it (unless it is a fresh page, which is zeroed instead).
+ */
+static tree_disk_page_t* disk_fetch (tree_disk_t* self, uint64_t page, bool fresh)
+{
+    const size_t slot = disk_slot(self, page);
+
+    if (0 != self->table[slot])
+    {
+        const size_t frame = self->table[slot] - 1;
+        ++self->frames[frame].pins;
+        self->frames[frame].referenced = true;
+        ++self->stats.hits;
+        return (tree_disk_page_t*) (self->data + frame * DISK_PAGE_SIZE);
+    }
+
+    ++self->stats.misses;
+
+    size_t frame;
+
+    if (false == disk_victim(self, &frame))
+    {
+        return NULL;
+    }
+
+    unsigned char* data = self->data + frame * DISK_PAGE_SIZE;
+
+    if (fresh)
+    {
+        memset(data, 0, DISK_PAGE_SIZE);
+    }
+    else if (DISK_PAGE_SIZE != pread(self->fd, data, DISK_PAGE_SIZE, (off_t) (page * DISK_PAGE_SIZE)))
+    {
+        self->failed = true;
+        return NULL;
+    }
+    else
+    {
+        ++self->stats.reads;
+    }
+
+    // The eviction may have moved entries of the hash table; therefore, the slot is looked up again.
+    self->table[disk_slot(self, page)] = (uint32_t) frame + 1;
+    self->frames[frame].page = page;
+    self->frames[frame].pins = 1;
+    self->frames[frame].dirty = fresh;
+    self->frames[frame].referenced = true;
+    return (tree_disk_page_t*) data;
+}
+
+static void disk_release (tree_disk_t* self, tree_disk_page_t* page, bool dirty)
+{
+    tree_disk_frame_t* frame = self->frames + disk_frame_of(self, page);
+    frame->dirty = frame->dirty || dirty;
+    --frame->pins;
+}
+
+/**
+ * Appends a new, empty page to the file, which is pinned in the cache.
+ */
+static tree_disk_page_t* disk_allocate (tree_disk_t* self, uint32_t kind)
+{
+    tree_disk_page_t* page = disk_fetch(self, self->header.page_count, true);
+
+    if (NULL != page)
+    {
+        ++self->header.page_count;
+        page->kind = kind;
+    }
+
+    return page;
+}
+
+/**
+ * Finds the index of the first key in a page, which is not less than a given key (if upper is false),
+ * or which is greater than the given key (if upper is true).
+ */
+static size_t disk_search (tree_disk_t* self, tree_disk_page_t* page, key_t* key, bool upper)
+{
+    key_t* keys = disk_keys(page);
+    size_t lo = 0;
+    size_t hi = page->count;
+
+    while (lo < hi)
+    {
+        const size_t middle = lo + (hi - lo) / 2;
+        const int cmp = self->comparator(NULL, &keys[middle], key);
+
+        if (cmp < 0 || (upper && 0 == cmp))
+        {
+            lo = middle + 1;
+        }
+        else
+        {
+            hi = middle;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * Descends from the root to the leaf page, which would hold a key, without modifying any pages.
+ * Returns NULL if the tree has no pages yet, or if a page could not be read.
+ */
+static tree_disk_page_t* disk_find_leaf (tree_disk_t* self, key_t* key)
+{
+    if (0 == self->header.root)
+    {
+        return NULL;
+    }
+
+    tree_disk_page_t* page = disk_fetch(self, self->header.root, false);
+
+    while (NULL != page && DISK_INNER == page->kind)
+    {
+        const uint64_t child = disk_children(self, page)[disk_search(self, page, key, true)];
+        disk_release(self, page, false);
+        page = disk_fetch(self, child, false);
+    }
+
+    return page;
+}
+
+static bool disk_full (tree_disk_t* self, tree_disk_page_t* page)
+{
+    return page->count == (DISK_LEAF == page->kind ? self->leaf_capacity : self->inner_capacity);
+}
+
+/**
+ * Splits a full child of a page, which is not full, by moving the upper half of the child into a new page.
+ * Returns the new page, which is pinned, or NULL if it could not be allocated.
+ */
+static tree_disk_page_t* disk_split (tree_disk_t* self, tree_disk_page_t* parent, size_t index, tree_disk_page_t* child)
+{
+    tree_disk_page_t* sibling = disk_allocate(self, child->kind);
+
+    if (NULL == sibling)
+    {
+        return NULL;
+    }
+
+    const size_t middle = child->count / 2;
+    key_t separator;
+
+    if (DISK_LEAF == child->kind)
+    {
+        sibling->count = child->count - middle;
+        memcpy(disk_keys(sibling), disk_keys(child) + middle, sibling->count * sizeof(key_t));
+        memcpy(disk_values(self, sibling), disk_values(self, child) + middle, sibling->count * sizeof(data_t));
+        sibling->next = child->next;
+        child->next = disk_number_of(self, sibling);
+        separator = disk_keys(sibling)[0];
+    }
+    else
+    {
+        // The middle key moves up into the parent.
+        sibling->count = child->count - middle - 1;
+        memcpy(disk_keys(sibling), disk_keys(child) + middle + 1, sibling->count * sizeof(key_t));
+        memcpy(disk_children(self, sibling), disk_children(self, child) + middle + 1, (sibling->count + 1) * sizeof(uint64_t));
+        separator = disk_keys(child)[middle];
+    }
+
+    child->count = (uint32_t) middle;
+
+    key_t* keys = disk_keys(parent);
+    uint64_t* children = disk_children(self, parent);
+    memmove(keys + index + 1, keys + index, (parent->count - index) * sizeof(key_t));
+    memmove(children + index + 2, children + index + 1, (parent->count - index) * sizeof(uint64_t));
+    keys[index] = separator;
+    children[index + 1] = disk_number_of(self, sibling);
+    ++parent->count;
+
+    self->frames[disk_frame_of(self, parent)].dirty = true;
+    self->frames[disk_frame_of(self, child)].dirty = true;
+    self->frames[disk_frame_of(self, sibling)].dirty = true;
+    return sibling;
+}
+
+/**
+ * Descends from the root to the leaf page, which should hold a key, while splitting every full page on the way,
+ * so that there is always room for a separator in the parent. The returned leaf page is pinned and not full.
+ */
+static tree_disk_page_t* disk_prepare_leaf (tree_disk_t* self, key_t* key)
+{
+    if (0 == self->header.root)
+    {
+        tree_disk_page_t* leaf = disk_allocate(self, DISK_LEAF);
+
+        if (NULL != leaf)
+        {
+            self->header.root = disk_number_of(self, leaf);
+            self->header.first_leaf = self->header.root;
+            self->header.height = 1;
+        }
+
+        return leaf;
+    }
+
+    tree_disk_page_t* page = disk_fetch(self, self->header.root, false);
+
+    if (NULL != page && disk_full(self, page))
+    {
+        // The tree grows at the root.
+        tree_disk_page_t* root = disk_allocate(self, DISK_INNER);
+
+        if (NULL == root)
+        {
+            disk_release(self, page, false);
+            return NULL;
+        }
+
+        disk_children(self, root)[0] = self->header.root;
+        tree_disk_page_t* sibling = disk_split(self, root, 0, page);
+        disk_release(self, page, false);
+
+        if (NULL == sibling)
+        {
+            // The new root is unreachable, which wastes a page, but leaves the tree intact.
+            disk_release(self, root, false);
+            return NULL;
+        }
+
+        disk_release(self, sibling, false);
+        self->header.root = disk_number_of(self, root);
+        ++self->header.height;
+        page = root;
+    }
+
+    while (NULL != page && DISK_INNER == page->kind)
+    {
+        const size_t index = disk_search(self, page, key, true);
+        tree_disk_page_t* child = disk_fetch(self, disk_children(self, page)[index], false);
+
+        if (NULL != child && disk_full(self, child))
+        {
+            tree_disk_page_t* sibling = disk_split(self, page, index, child);
+
+            if (NULL == sibling)
+            {
+                disk_release(self, child, false);
+                child = NULL;
+            }
+            else if (self->comparator(NULL, key, &disk_keys(page)[index]) >= 0)
+            {
+                // The key belongs to the upper half, which moved into the new page.
+                disk_release(self, child, false);
+                child = sibling;
+            }
+            else
+            {
+                disk_release(self, sibling, false);
+            }
+        }
+
+        disk_release(self, page, false);
+        page = child;
+    }
+
+    return page;
+}
+
+static bool disk_lookup (tree_disk_t* self, key_t* key, data_t* value)
+{
+    tree_disk_page_t* leaf = disk_find_leaf(self, key);
+
+    if (NULL == leaf)
+    {
+        return false;
+    }
+
+    const size_t index = disk_search(self, leaf, key, false);
+    const bool found = index < leaf->count && 0 == self->comparator(NULL, &disk_keys(leaf)[index], key);
+
+    if (found && NULL != value)
+    {
+        *value = disk_values(self, leaf)[index];
+    }
+
+    disk_release(self, leaf, false);
+    return found;
+}
+
+/**
+ * Moves an iterator past the leaf pages, which have no more entries.
+ */
+static void disk_iter_settle (tree_disk_iterator_t* self)
+{
+    while (0 != self->page)
+    {
+        tree_disk_page_t* leaf = disk_fetch(self->owner, self->page, false);
+
+        if (NULL == leaf)
+        {
+            self->page = 0;
+            return;
+        }
+
+        const bool done = self->index >= leaf->count;
+        const uint64_t next = leaf->next;
+        disk_release(self->owner, leaf, false);
+
+        if (false == done)
+        {
+            return;
+        }
+
+        self->page = next;
+        self->index = 0;
+    }
+}
+
+static bool disk_ring_setup (tree_disk_ring_t* ring)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(tree_disk_ring_t));
+    ring->fd = (int) syscall(__NR_io_uring_setup, DISK_RING_ENTRIES, &params);
+
+    if (ring->fd < 0)
+    {
+        ring->fd = -1;
+        return false;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->sq_length = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_length = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_length = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        // Both rings share a single mapping, which must be large enough for either of them.
+        ring->sq_length = ring->sq_length > ring->cq_length ? ring->sq_length : ring->cq_length;
+        ring->cq_length = 0;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = 0 == ring->cq_length ? ring->sq_ring : mmap(NULL, ring->cq_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqes_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if (MAP_FAILED == ring->sq_ring || MAP_FAILED == ring->cq_ring || MAP_FAILED == (void*) ring->sqes)
+    {
+        if (MAP_FAILED != ring->sq_ring)
+        {
+            munmap(ring->sq_ring, ring->sq_length);
+        }
+
+        if (0 != ring->cq_length && MAP_FAILED != ring->cq_ring)
+        {
+            munmap(ring->cq_ring, ring->cq_length);
+        }
+
+        if (MAP_FAILED != (void*) ring->sqes)
+        {
+            munmap(ring->sqes, ring->sqes_length);
+        }
+
+        close(ring->fd);
+        ring->fd = -1;
+        return false;
+    }
+
+    unsigned char* sq = (unsigned char*) ring->sq_ring;
+    unsigned char* cq = (unsigned char*) ring->cq_ring;
+    ring->sq_head = (unsigned*) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return true;
+}
+
+static void disk_ring_teardown (tree_disk_ring_t* ring)
+{
+    if (ring->fd >= 0)
+    {
+        munmap(ring->sqes, ring->sqes_length);
+
+        if (0 != ring->cq_length)
+        {
+            munmap(ring->cq_ring, ring->cq_length);
+        }
+
+        munmap(ring->sq_ring, ring->sq_length);
+        close(ring->fd);
+        ring->fd = -1;
+    }
+}
+
+/**
+ * Reads a batch of pages using io_uring, while keeping at most a ring full of reads in flight.
+ * Returns false if the ring failed, in which case the reads, which are not done, must be retried otherwise.
+ */
+static bool disk_ring_read (tree_disk_t* self, tree_disk_read_t* jobs, size_t count)
+{
+    tree_disk_ring_t* ring = &self->ring;
+    size_t submitted = 0;
+    size_t completed = 0;
+
+    while (completed < count)
+    {
+        unsigned tail = *ring->sq_tail;
+
+        while (submitted < count && submitted - completed < ring->entries)
+        {
+            const unsigned index = tail & *ring->sq_mask;
+            struct io_uring_sqe* sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(struct io_uring_sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = self->fd;
+            sqe->addr = (uint64_t) (uintptr_t) (self->data + jobs[submitted].frame * DISK_PAGE_SIZE);
+            sqe->len = DISK_PAGE_SIZE;
+            sqe->off = jobs[submitted].page * DISK_PAGE_SIZE;
+            sqe->user_data = submitted;
+            ring->sq_array[index] = index;
+            ++tail;
+            ++submitted;
+        }
+
+        // The kernel sees the entries, once it sees the new tail.
+        atomic_store_explicit((_Atomic unsigned*) ring->sq_tail, tail, memory_order_release);
+
+        // Entries, which an interrupted call did not consume, are submitted again.
+        const unsigned unconsumed = tail - atomic_load_explicit((_Atomic unsigned*) ring->sq_head, memory_order_acquire);
+        const long rc = syscall(__NR_io_uring_enter, ring->fd, unconsumed, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        if (rc < 0 && EINTR != errno && EAGAIN != errno && EBUSY != errno)
+        {
+            return false;
+        }
+
+        unsigned head = *ring->cq_head;
+
+        while (head != atomic_load_explicit((_Atomic unsigned*) ring->cq_tail, memory_order_acquire))
+        {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            jobs[cqe->user_data].ok = DISK_PAGE_SIZE == cqe->res;
+            jobs[cqe->user_data].done = true;
+            ++completed;
+            ++head;
+        }
+
+        atomic_store_explicit((_Atomic unsigned*) ring->cq_head, head, memory_order_release);
+    }
+
+    return true;
+}
+
+static void* disk_reader_main (void* argument)
+{
+    tree_disk_t* self = (tree_disk_t*) argument;
+
+    pthread_mutex_lock(&self->read_mutex);
+
+    while (true)
+    {
+        while (false == self->read_stopping && self->read_next >= self->read_count)
+        {
+            pthread_cond_wait(&self->read_start, &self->read_mutex);
+        }
+
+        if (self->read_stopping)
+        {
+            break;
+        }
+
+        tree_disk_read_t* job = &self->read_jobs[self->read_next++];
+        pthread_mutex_unlock(&self->read_mutex);
+
+        job->ok = DISK_PAGE_SIZE == pread(self->fd, self->data + job->frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (job->page * DISK_PAGE_SIZE));
+        job->done = true;
+
+        pthread_mutex_lock(&self->read_mutex);
+
+        if (0 == --self->read_pending)
+        {
+            pthread_cond_signal(&self->read_done);
+        }
+    }
+
+    pthread_mutex_unlock(&self->read_mutex);
+    return NULL;
+}
+
+/**
+ * Reads a batch of pages using the pool of reader threads, which is started on first use.
  */
-bool tree_putAll (tree_t* self, tree_t* other)
+static void disk_pool_read (tree_disk_t* self, tree_disk_read_t* jobs, size_t count)
 {
-    tree_iterator_t iter = tree_iter(other);
+    pthread_mutex_lock(&self->read_mutex);
+
+    while (self->reader_count < DISK_READERS && 0 == pthread_create(&self->readers[self->reader_count], NULL, &disk_reader_main, self))
     {
-        while (tree_iter_hasNext(&iter))
-        {
-            tree_iter_next(&iter);
+        ++self->reader_count;
+    }
 
-            tree_node_t* node = tree_iter_node(&iter);
+    if (0 == self->reader_count)
+    {
+        // Without any threads, the reads are simply done one after another.
+        pthread_mutex_unlock(&self->read_mutex);
 
-            if (tree_put(self, node->key, node->value) == false)
-            {
-                return false;
-            }
+        for (size_t i = 0; i < count; i++)
+        {
+            jobs[i].ok = DISK_PAGE_SIZE == pread(self->fd, self->data + jobs[i].frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (jobs[i].page * DISK_PAGE_SIZE));
+            jobs[i].done = true;
         }
+
+        return;
     }
-    tree_iter_free(&iter);
-    return true;
+
+    self->read_jobs = jobs;
+    self->read_count = count;
+    self->read_next = 0;
+    self->read_pending = count;
+    pthread_cond_broadcast(&self->read_start);
+
+    while (self->read_pending > 0)
+    {
+        pthread_cond_wait(&self->read_done, &self->read_mutex);
+    }
+
+    self->read_jobs = NULL;
+    self->read_count = 0;
+    self->read_next = 0;
+    pthread_mutex_unlock(&self->read_mutex);
 }
 
-/**
- * @brief Removes all elements that exist in another tree from this tree.
- * @param self Pointer to the current AVL tree.
- * @param other Pointer to the other AVL tree.
- */
-void tree_removeAll (tree_t* self, tree_t* other)
+static void disk_read_batch (tree_disk_t* self, tree_disk_read_t* jobs, size_t count)
 {
-    tree_iterator_t iter = tree_iter(other);
+    ++self->stats.batches;
+
+    if (self->use_ring)
     {
-        while (tree_iter_hasNext(&iter))
+        if (false == disk_ring_read(self, jobs, count))
         {
-            tree_iter_next(&iter);
-            tree_node_t* node = tree_iter_node(&iter);
-            tree_remove(self, node->key);
+            // The ring is not used again, and the reads, which are not done, are repeated synchronously.
+            self->use_ring = false;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (false == jobs[i].done)
+                {
+                    jobs[i].ok = DISK_PAGE_SIZE == pread(self->fd, self->data + jobs[i].frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (jobs[i].page * DISK_PAGE_SIZE));
+                    jobs[i].done = true;
+                }
+            }
         }
+
+        return;
     }
-    tree_iter_free(&iter);
+
+    disk_pool_read(self, jobs, count);
 }
 
 /**
- * @brief Retains only elements that exist in another tree.
- * @param self Pointer to the current AVL tree.
- * @param other Pointer to the other AVL tree.
+ * Pins the distinct pages of a batch in the cache, after reading the missing ones together.
+ * The pinned slots are recorded, so that they can be released after the batch. A page,
+ * which could not be cached or read, is simply left out.
  */
-void tree_retainAll (tree_t* self, tree_t* other)
+static size_t disk_prefetch (tree_disk_t* self, uint64_t* pages, size_t count, tree_disk_read_t* jobs, size_t* pinned)
 {
-    tree_iterator_t iter = tree_iter(self);
+    const uint64_t batch = ++self->batch;
+    size_t pinned_count = 0;
+    size_t job_count = 0;
+
+    for (size_t i = 0; i < count; i++)
     {
-        while (tree_iter_hasNext(&iter))
+        if (0 == pages[i])
         {
-            tree_iter_next(&iter);
+            continue;
+        }
 
-            tree_node_t* node = tree_iter_node(&iter);
+        const size_t slot = disk_slot(self, pages[i]);
+        size_t frame;
 
-            if (tree_containsKey(other, node->key) == false)
+        if (0 != self->table[slot])
+        {
+            frame = self->table[slot] - 1;
+
+            if (batch == self->frames[frame].batch)
             {
-                tree_iter_next(&iter);
-                tree_remove(self, node->key);
+                continue;
             }
+
+            ++self->frames[frame].pins;
+            self->frames[frame].referenced = true;
+            ++self->stats.hits;
         }
-    }
-    tree_iter_free(&iter);
-}
+        else
+        {
+            ++self->stats.misses;
 
-/**
- * @brief Inserts a key-value pair into the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to insert.
- * @param value Data value to associate with the key.
- * @return true if insertion was successful, false otherwise.
- */
-bool tree_put (tree_t* self, key_t key, data_t value)
-{
-    tree_node_t* node = tree_putNode(self, key);
+            if (false == disk_victim(self, &frame))
+            {
+                continue;
+            }
 
-    if (NULL == node)
+            self->table[disk_slot(self, pages[i])] = (uint32_t) frame + 1;
+            self->frames[frame].page = pages[i];
+            self->frames[frame].pins = 1;
+            self->frames[frame].dirty = false;
+            self->frames[frame].referenced = true;
+
+            jobs[job_count].page = pages[i];
+            jobs[job_count].frame = frame;
+            jobs[job_count].done = false;
+            jobs[job_count].ok = false;
+            ++job_count;
+        }
+
+        self->frames[frame].batch = batch;
+        pinned[pinned_count++] = frame;
+    }
+
+    if (job_count > 0)
     {
-        return false;
+        disk_read_batch(self, jobs, job_count);
     }
-    else
+
+    for (size_t i = 0; i < job_count; i++)
     {
-        node->value = value;
-        return true;
+        if (jobs[i].ok)
+        {
+            ++self->stats.reads;
+        }
+        else
+        {
+            // The slot becomes free again, which the release after the batch skips.
+            self->failed = true;
+            disk_unmap(self, jobs[i].page);
+            self->frames[jobs[i].frame].page = 0;
+            self->frames[jobs[i].frame].pins = 0;
+        }
     }
+
+    return pinned_count;
 }
 
 /**
- * @brief Retrieves the value associated with a key in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to search for.
- * @return The associated value or default value if key not found.
+ * @brief Opens a disk tree using the natural ordering of keys, and creates the file if it does not exist yet.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
  */
-data_t tree_get (tree_t* self, key_t key)
+tree_disk_t* tree_disk_open (const char* path, size_t cache_pages)
 {
-    tree_node_t* node = tree_getNode(self, key);
-
-    if (NULL == node)
-    {
-        return tree_defaultValue();
-    }
-    else
-    {
-        return node->value;
-    }
+    return tree_disk_make(path, cache_pages, &tree_naturalOrder);
 }
 
 /**
- * @brief Removes a key and its value from the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to remove.
+ * @brief Opens a disk tree with a specified comparator, which must be the same every time the file is opened.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
  */
-void tree_remove (tree_t* self, key_t key)
+tree_disk_t* tree_disk_make (const char* path, size_t cache_pages, tree_comparator_t comparator)
 {
-    tree_node_t* deleted = NULL;
-    self->root = delete_node(self, self->root, &key, &deleted);
+    const size_t leaf_entry = sizeof(key_t) + sizeof(data_t);
+    const size_t inner_entry = sizeof(key_t) + sizeof(uint64_t);
+    const size_t usable = DISK_PAGE_SIZE - sizeof(tree_disk_page_t) - 2 * sizeof(uint64_t);
 
-    if (NULL != deleted)
+    // Both kinds of pages must hold at least four entries, and the cache must fit in the hash table.
+    if (usable / leaf_entry < 4 || usable / inner_entry < 4 || cache_pages >= UINT32_MAX / 2)
     {
-        self->allocator->release(self->allocator, deleted);
-        --self->size;
+        return NULL;
     }
-}
 
-/**
- * @brief Removes the first value in the AVL tree.
- * @param self Pointer to the AVL tree.
- */
-void tree_removeFirst (tree_t* self)
-{
-    tree_node_t* node = tree_firstNode(self);
+    tree_disk_t* self = (tree_disk_t*) calloc(1, sizeof(tree_disk_t));
 
-    if (NULL != node)
+    if (NULL == self)
     {
-        tree_remove(self, node->key);
+        return NULL;
     }
-}
 
-/**
- * @brief Removes the last value in the AVL tree.
- * @param self Pointer to the AVL tree.
- */
-void tree_removeLast (tree_t* self)
-{
-    tree_node_t* node = tree_lastNode(self);
+    self->comparator = comparator;
+    pthread_mutex_init(&self->read_mutex, NULL);
+    pthread_cond_init(&self->read_start, NULL);
+    pthread_cond_init(&self->read_done, NULL);
+    self->leaf_capacity = usable / leaf_entry;
+    self->inner_capacity = usable / inner_entry - 1;
+    self->values_offset = disk_align(sizeof(tree_disk_page_t) + self->leaf_capacity * sizeof(key_t), sizeof(uint64_t));
+    self->children_offset = disk_align(sizeof(tree_disk_page_t) + self->inner_capacity * sizeof(key_t), sizeof(uint64_t));
+    self->frame_count = cache_pages < DISK_MIN_CACHE_PAGES ? DISK_MIN_CACHE_PAGES : cache_pages;
 
-    if (NULL != node)
+    size_t table_size = 2;
+    self->table_shift = 63;
+
+    while (table_size < 2 * self->frame_count)
     {
-        tree_remove(self, node->key);
+        table_size *= 2;
+        --self->table_shift;
+    }
+
+    self->table_mask = table_size - 1;
+    self->frames = (tree_disk_frame_t*) calloc(self->frame_count, sizeof(tree_disk_frame_t));
+    self->table = (uint32_t*) calloc(table_size, sizeof(uint32_t));
+    self->data = (unsigned char*) aligned_alloc(DISK_PAGE_SIZE, self->frame_count * DISK_PAGE_SIZE);
+    self->fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    struct stat info;
+    bool ok = NULL != self->frames && NULL != self->table && NULL != self->data && self->fd >= 0 && 0 == fstat(self->fd, &info);
+
+    if (ok && 0 == info.st_size)
+    {
+        // A new file starts with just the header page.
+        memcpy(self->header.magic, DISK_MAGIC, sizeof(self->header.magic));
+        self->header.version = DISK_VERSION;
+        self->header.byte_order = SNAPSHOT_BYTE_ORDER;
+        self->header.key_size = (uint32_t) sizeof(key_t);
+        self->header.value_size = (uint32_t) sizeof(data_t);
+        self->header.page_size = DISK_PAGE_SIZE;
+        self->header.page_count = 1;
+
+        ok = 0 == ftruncate(self->fd, DISK_PAGE_SIZE) && tree_disk_flush(self);
     }
+    else if (ok)
+    {
+        ok = sizeof(tree_disk_header_t) == pread(self->fd, &self->header, sizeof(tree_disk_header_t), 0);
+        ok = ok && 0 == memcmp(self->header.magic, DISK_MAGIC, sizeof(self->header.magic));
+        ok = ok && DISK_VERSION == self->header.version;
+        ok = ok && SNAPSHOT_BYTE_ORDER == self->header.byte_order;
+        ok = ok && sizeof(key_t) == self->header.key_size;
+        ok = ok && sizeof(data_t) == self->header.value_size;
+        ok = ok && DISK_PAGE_SIZE == self->header.page_size;
+        ok = ok && (uint64_t) info.st_size >= self->header.page_count * DISK_PAGE_SIZE;
+    }
+
+    if (false == ok)
+    {
+        if (self->fd >= 0)
+        {
+            close(self->fd);
+        }
+
+        pthread_mutex_destroy(&self->read_mutex);
+        pthread_cond_destroy(&self->read_start);
+        pthread_cond_destroy(&self->read_done);
+        free(self->frames);
+        free(self->table);
+        free(self->data);
+        free(self);
+        return NULL;
+    }
+
+    self->use_ring = disk_ring_setup(&self->ring);
+
+    return self;
 }
 
 /**
- * @brief Removes nodes from the tree based on a predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
+ * @brief Writes all dirty pages and the header to the file, and then syncs the file.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
  */
-void tree_removeIf (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+bool tree_disk_flush (tree_disk_t* self)
 {
-    tree_iterator_t iter = tree_iter(self);
+    for (size_t frame = 0; frame < self->frame_count; frame++)
     {
-        while (tree_iter_hasNext(&iter))
+        if (0 != self->frames[frame].page && self->frames[frame].dirty)
         {
-            tree_iter_next(&iter);
-            tree_node_t* node = tree_iter_node(&iter);
-            if (predicate(self, node, context))
-            {
-                tree_iter_next(&iter);
-                tree_remove(self, node->key);
-            }
+            disk_write_page(self, frame);
         }
     }
-    tree_iter_free(&iter);
+
+    const ssize_t written = pwrite(self->fd, &self->header, sizeof(tree_disk_header_t), 0);
+    self->failed = self->failed || sizeof(tree_disk_header_t) != written || 0 != fsync(self->fd);
+    return false == self->failed;
 }
 
 /**
- * @brief Applies a function to each node in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param functor Function to apply to each node.
- * @param context Additional context passed to the functor.
+ * @brief Flushes a disk tree, closes its file, and frees its resources.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
  */
-void tree_forEach (tree_t* self, void (*functor)(tree_t*, tree_node_t*, void*), void* context)
+bool tree_disk_close (tree_disk_t* self)
 {
-    tree_iterator_t iter = tree_iter(self);
+    if (NULL == self)
     {
-        while (tree_iter_hasNext(&iter))
-        {
-            tree_iter_next(&iter);
-            tree_node_t* node = tree_iter_node(&iter);
-            functor(self, node, context);
-        }
+        return true;
     }
-    tree_iter_free(&iter);
+
+    const bool ok = tree_disk_flush(self);
+
+    pthread_mutex_lock(&self->read_mutex);
+    self->read_stopping = true;
+    pthread_cond_broadcast(&self->read_start);
+    pthread_mutex_unlock(&self->read_mutex);
+
+    for (size_t i = 0; i < self->reader_count; i++)
+    {
+        pthread_join(self->readers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&self->read_mutex);
+    pthread_cond_destroy(&self->read_start);
+    pthread_cond_destroy(&self->read_done);
+    disk_ring_teardown(&self->ring);
+    close(self->fd);
+    free(self->frames);
+    free(self->table);
+    free(self->data);
+    free(self);
+    return ok;
 }
 
 /**
- * @brief Checks if any nodes match the given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return true if any match found, false otherwise.
+ * @brief Retrieves the number of entries in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Number of entries in the disk tree.
  */
-bool tree_anyMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+size_t tree_disk_size (tree_disk_t* self)
 {
-    return tree_count(self, predicate, context) > 0;
+    return (size_t) self->header.count;
 }
 
 /**
- * @brief Checks if all nodes match the given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return true if all nodes match, false otherwise.
+ * @brief Retrieves the value associated with a key in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found (or if the page could not be read).
  */
-bool tree_allMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+data_t tree_disk_get (tree_disk_t* self, key_t key)
 {
-    size_t size = tree_size(self);
-    return tree_count(self, predicate, context) == size;
+    data_t value;
+    return disk_lookup(self, &key, &value) ? value : tree_defaultValue();
 }
 
 /**
- * @brief Checks if none of the nodes match the given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return true if none match, false otherwise.
+ * @brief Checks if a key exists in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return true if the key exists, false otherwise.
  */
-bool tree_noneMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+bool tree_disk_containsKey (tree_disk_t* self, key_t key)
 {
-    return tree_count(self, predicate, context) == 0;
+    return disk_lookup(self, &key, NULL);
 }
 
 /**
- * @brief Counts the number of nodes matching a given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return Count of nodes matching the predicate.
+ * @brief Retrieves the values associated with many keys in a disk tree, reading the missing pages in batches.
+ * @param self Pointer to the disk tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
  */
-size_t tree_count (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context)
+size_t tree_disk_getMany (tree_disk_t* self, key_t* keys, data_t* values, bool* found, size_t count)
 {
-    size_t count = 0;
-    tree_iterator_t iter = tree_iter(self);
+    size_t window = self->frame_count / 4;
+    window = window < DISK_BATCH ? window : DISK_BATCH;
+
+    uint64_t* pages = (uint64_t*) malloc(window * sizeof(uint64_t));
+    size_t* pinned = (size_t*) malloc(window * sizeof(size_t));
+    tree_disk_read_t* jobs = (tree_disk_read_t*) malloc(window * sizeof(tree_disk_read_t));
+    size_t result = 0;
+
+    if (NULL == pages || NULL == pinned || NULL == jobs)
     {
-        while (tree_iter_hasNext(&iter))
+        // Without memory for the batches, the keys are looked up one by one.
+        for (size_t i = 0; i < count; i++)
         {
-            tree_iter_next(&iter);
-            tree_node_t* node = tree_iter_node(&iter);
-            if (predicate(self, node, context))
+            const bool hit = disk_lookup(self, &keys[i], &values[i]);
+            values[i] = hit ? values[i] : tree_defaultValue();
+            result += hit;
+
+            if (NULL != found)
+            {
+                found[i] = hit;
+            }
+        }
+
+        free(pages);
+        free(pinned);
+        free(jobs);
+        return result;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = tree_defaultValue();
+
+        if (NULL != found)
+        {
+            found[i] = false;
+        }
+    }
+
+    for (size_t base = 0; base < count && 0 != self->header.root; base += window)
+    {
+        const size_t n = count - base < window ? count - base : window;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            pages[i] = self->header.root;
+        }
+
+        // Every level of the tree is a batch, since all of the leaves are equally deep.
+        for (uint32_t level = 0; level < self->header.height; level++)
+        {
+            const size_t pinned_count = disk_prefetch(self, pages, n, jobs, pinned);
+
+            for (size_t i = 0; i < n; i++)
+            {
+                const size_t slot = 0 == pages[i] ? 0 : disk_slot(self, pages[i]);
+
+                if (0 == pages[i] || 0 == self->table[slot])
+                {
+                    // The page could not be read.
+                    pages[i] = 0;
+                    continue;
+                }
+
+                tree_disk_page_t* page = (tree_disk_page_t*) (self->data + (self->table[slot] - 1) * DISK_PAGE_SIZE);
+
+                if (DISK_INNER == page->kind)
+                {
+                    pages[i] = disk_children(self, page)[disk_search(self, page, &keys[base + i], true)];
+                    continue;
+                }
+
+                const size_t index = disk_search(self, page, &keys[base + i], false);
+
+                if (index < page->count && 0 == self->comparator(NULL, &disk_keys(page)[index], &keys[base + i]))
+                {
+                    values[base + i] = disk_values(self, page)[index];
+                    ++result;
+
+                    if (NULL != found)
+                    {
+                        found[base + i] = true;
+                    }
+                }
+
+                pages[i] = 0;
+            }
+
+            for (size_t i = 0; i < pinned_count; i++)
             {
-                ++count;
+                if (0 != self->frames[pinned[i]].page)
+                {
+                    --self->frames[pinned[i]].pins;
+                }
             }
         }
     }
-    tree_iter_free(&iter);
-    return count;
+
+    free(pages);
+    free(pinned);
+    free(jobs);
+    return result;
 }
 
 /**
- * @brief Checks if two trees are equal based on a comparison predicate.
- * @param self Pointer to the first AVL tree.
- * @param other Pointer to the second AVL tree.
- * @param predicate Function pointer for node comparison.
- * @param context Additional context passed to the predicate.
- * @return true if the trees are equal, false otherwise.
+ * @brief Inserts a key-value pair into a disk tree, or replaces the value of an existing key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false if a page could not be read, written, or cached.
  */
-bool tree_isEqual (tree_t* self, tree_t* other, bool (*predicate)(tree_node_t*, tree_node_t*, void*), void* context)
+bool tree_disk_put (tree_disk_t* self, key_t key, data_t value)
 {
-    if (tree_size(self) != tree_size(other))
+    tree_disk_page_t* leaf = disk_prepare_leaf(self, &key);
+
+    if (NULL == leaf)
     {
         return false;
     }
 
-    tree_iterator_t iterX = tree_iter(self);
-    {
-        tree_iterator_t iterY = tree_iter(other);
-        {
-            while (tree_iter_hasNext(&iterX))
-            {
-                tree_iter_next(&iterX);
-                tree_iter_next(&iterY);
-
-                tree_node_t* nodeX = tree_iter_node(&iterX);
-                tree_node_t* nodeY = tree_iter_node(&iterY);
+    key_t* keys = disk_keys(leaf);
+    data_t* values = disk_values(self, leaf);
+    const size_t index = disk_search(self, leaf, &key, false);
 
-                if (predicate(nodeX, nodeY, context) == false)
-                {
-                    return false;
-                }
-            }
-        }
-        tree_iter_free(&iterY);
+    if (index == leaf->count || 0 != self->comparator(NULL, &keys[index], &key))
+    {
+        memmove(keys + index + 1, keys + index, (leaf->count - index) * sizeof(key_t));
+        memmove(values + index + 1, values + index, (leaf->count - index) * sizeof(data_t));
+        keys[index] = key;
+        ++leaf->count;
+        ++self->header.count;
     }
-    tree_iter_free(&iterX);
+
+    values[index] = value;
+    disk_release(self, leaf, true);
     return true;
 }
 
 /**
- * @brief Creates an iterator for the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Iterator structure for the tree.
+ * @brief Removes a key from a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to remove.
+ * @return true if the key was removed, false if it was not found (or if a page could not be read).
  */
-tree_iterator_t tree_iter (tree_t* self)
+bool tree_disk_remove (tree_disk_t* self, key_t key)
 {
-    return tree_iter_atNode(self, NULL);
+    tree_disk_page_t* leaf = disk_find_leaf(self, &key);
+
+    if (NULL == leaf)
+    {
+        return false;
+    }
+
+    key_t* keys = disk_keys(leaf);
+    data_t* values = disk_values(self, leaf);
+    const size_t index = disk_search(self, leaf, &key, false);
+    const bool found = index < leaf->count && 0 == self->comparator(NULL, &keys[index], &key);
+
+    if (found)
+    {
+        memmove(keys + index, keys + index + 1, (leaf->count - index - 1) * sizeof(key_t));
+        memmove(values + index, values + index + 1, (leaf->count - index - 1) * sizeof(data_t));
+        --leaf->count;
+        --self->header.count;
+    }
+
+    disk_release(self, leaf, found);
+    return found;
 }
 
 /**
- * @brief Creates an iterator starting at a specific key in the tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to start the iteration at.
- * @return Iterator structure for the tree starting at the given key.
+ * @brief Creates an iterator, which starts before the first entry of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Iterator over the entries in ascending order of keys.
  */
-tree_iterator_t tree_iter_at (tree_t* self, key_t key)
+tree_disk_iterator_t tree_disk_iter (tree_disk_t* self)
 {
-    tree_node_t* node = find_node(self, self->root, &key);
-    return tree_iter_atNode(self, node);
+    tree_disk_iterator_t iter;
+    memset(&iter, 0, sizeof(iter));
+    iter.owner = self;
+    iter.page = self->header.first_leaf;
+    disk_iter_settle(&iter);
+    return iter;
 }
 
 /**
- * @brief Creates an iterator starting at a specific node in the tree.
- * @param self Pointer to the AVL tree.
- * @param node Node to start the iteration at.
- * @return Iterator structure for the tree starting at the given node.
+ * @brief Creates an iterator, which starts before the first entry, whose key is not less than a given key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to start at.
+ * @return Iterator over the remaining entries in ascending order of keys.
  */
-tree_iterator_t tree_iter_atNode (tree_t* self, tree_node_t* node)
+tree_disk_iterator_t tree_disk_iter_at (tree_disk_t* self, key_t key)
 {
-    tree_iterator_t result;
-    result.owner = self;
-    result.node = node;
-    return result;
+    tree_disk_iterator_t iter;
+    memset(&iter, 0, sizeof(iter));
+    iter.owner = self;
+
+    tree_disk_page_t* leaf = disk_find_leaf(self, &key);
+
+    if (NULL != leaf)
+    {
+        iter.page = disk_number_of(self, leaf);
+        iter.index = disk_search(self, leaf, &key, false);
+        disk_release(self, leaf, false);
+        disk_iter_settle(&iter);
+    }
+
+    return iter;
 }
 
 /**
- * @brief Frees the resources associated with a tree iterator.
- * @param self Pointer to the tree iterator to free.
+ * @brief Checks if there are more entries to iterate over.
+ * @param self Pointer to the iterator.
+ * @return true if there is a next entry, false otherwise.
  */
-void tree_iter_free (tree_iterator_t* self)
+bool tree_disk_iter_hasNext (tree_disk_iterator_t* self)
 {
-    if (NULL != self)
-    {
-        self->owner = NULL;
-        self->node = NULL;
-    }
+    return 0 != self->page;
 }
 
 /**
- * @brief Checks if the iterator has a next element.
- * @param self Pointer to the tree iterator.
- * @return true if there is a next element, false otherwise.
+ * @brief Moves the iterator to the next entry, and copies that entry into the iterator.
+ * @param self Pointer to the iterator.
  */
-bool tree_iter_hasNext (tree_iterator_t* self)
+void tree_disk_iter_next (tree_disk_iterator_t* self)
 {
-    if (tree_isEmpty(self->owner))
+    if (0 == self->page)
     {
-        return false;
-    }
-    else if (NULL == self->node)
-    {
-        return true;
+        return;
     }
-    else
+
+    tree_disk_page_t* leaf = disk_fetch(self->owner, self->page, false);
+
+    if (NULL == leaf)
     {
-        key_t key = self->node->key;
-        return NULL != tree_higherNode(self->owner, key);
+        self->page = 0;
+        return;
     }
+
+    self->key = disk_keys(leaf)[self->index];
+    self->value = disk_values(self->owner, leaf)[self->index];
+    ++self->index;
+    disk_release(self->owner, leaf, false);
+    disk_iter_settle(self);
 }
 
 /**
- * @brief Checks if the iterator has a previous element.
- * @param self Pointer to the tree iterator.
- * @return true if there is a previous element, false otherwise.
+ * @brief Retrieves the key of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Key of the current entry.
  */
-bool tree_iter_hasPrev (tree_iterator_t* self)
+key_t tree_disk_iter_key (tree_disk_iterator_t* self)
 {
-    if (tree_isEmpty(self->owner))
-    {
-        return false;
-    }
-    else if (NULL == self->node)
-    {
-        return true;
-    }
-    else
-    {
-        key_t key = self->node->key;
-        return NULL != tree_lowerNode(self->owner, key);
-    }
+    return self->key;
 }
 
 /**
- * @brief Advances the iterator to the next element.
- * @param self Pointer to the tree iterator.
+ * @brief Retrieves the data value of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Data value of the current entry.
  */
-void tree_iter_next (tree_iterator_t* self)
+data_t tree_disk_iter_get (tree_disk_iterator_t* self)
 {
-    if (tree_isEmpty(self->owner) == false)
+    return self->value;
+}
+
+/**
+ * @brief Retrieves the counters of the page cache of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Copy of the counters.
+ */
+tree_disk_stats_t tree_disk_stats (tree_disk_t* self)
+{
+    tree_disk_stats_t stats = self->stats;
+    stats.pages = self->header.page_count;
+    stats.cache_pages = self->frame_count;
+    stats.io_uring = self->use_ring;
+    return stats;
+}
+
+/**
+ * @brief Chooses whether the batches of page reads use io_uring or the pool of threads.
+ * @param self Pointer to the disk tree.
+ * @param enabled Whether io_uring should be used, which is the default.
+ * @return true if io_uring is used from now on, false if the pool of threads is used (io_uring may be unavailable).
+ */
+bool tree_disk_setIoUring (tree_disk_t* self, bool enabled)
+{
+    self->use_ring = enabled && self->ring.fd >= 0;
+    return self->use_ring;
+}
+
+/**
+ * Aggregates the entries of a subtree, whose keys are not less than a bound, in logarithmic time.
+ */
+static int64_t aggregate_above (tree_t* self, tree_node_t* node, key_t* bound)
+{
+    int64_t result = aggregate_of(NULL);
+
+    while (NULL != node)
     {
-        if (NULL == self->node)
+        if (NULL != bound && self->comparator(self, &node->key, bound) < 0)
         {
-            self->node = tree_firstNode(self->owner);
+            node = node->right;
+        }
+        else if (NULL == bound)
+        {
+            // The whole subtree precedes the entries, which were already aggregated.
+            int64_t subtree = aggregate_of(node);
+            return aggregate_combine(&subtree, &result);
         }
         else
         {
-            key_t key = self->node->key;
-            self->node = tree_higherNode(self->owner, key);
-
-            // Iterators can be circular.
-            if (NULL == self->node)
-            {
-                self->node = tree_firstNode(self->owner);
-            }
+            // The node and its right subtree are above the bound, and precede the entries found so far.
+            int64_t entry = aggregate_entry(&node->key, &node->value);
+            int64_t right = aggregate_of(node->right);
+            int64_t part = aggregate_combine(&entry, &right);
+            result = aggregate_combine(&part, &result);
+            node = node->left;
         }
     }
+
+    return result;
 }
 
 /**
- * @brief Moves the iterator to the previous element.
- * @param self Pointer to the tree iterator.
+ * Aggregates the entries of a subtree, whose keys are less than a bound, in logarithmic time.
  */
-void tree_iter_prev (tree_iterator_t* self)
+static int64_t aggregate_below (tree_t* self, tree_node_t* node, key_t* bound)
 {
-    if (tree_isEmpty(self->owner) == false)
+    int64_t result = aggregate_of(NULL);
+
+    while (NULL != node)
     {
-        if (NULL == self->node)
+        if (NULL == bound)
         {
-            self->node = tree_lastNode(self->owner);
+            // The whole subtree follows the entries, which were already aggregated.
+            int64_t subtree = aggregate_of(node);
+            return aggregate_combine(&result, &subtree);
+        }
+        else if (self->comparator(self, &node->key, bound) < 0)
+        {
+            // The left subtree and the node are below the bound, and follow the entries found so far.
+            int64_t left = aggregate_of(node->left);
+            int64_t entry = aggregate_entry(&node->key, &node->value);
+            int64_t part = aggregate_combine(&left, &entry);
+            result = aggregate_combine(&result, &part);
+            node = node->right;
         }
         else
         {
-            key_t key = self->node->key;
-            self->node = tree_lowerNode(self->owner, key);
-
-            // Iterators can be circular.
-            if (NULL == self->node)
-            {
-                self->node = tree_lastNode(self->owner);
-            }
+            node = node->left;
         }
     }
-}
 
-/**
- * @brief Retrieves the current node from the iterator.
- * @param self Pointer to the tree iterator.
- * @return Pointer to the current node.
- */
-tree_node_t* tree_iter_node (tree_iterator_t* self)
-{
-    return self->node;
+    return result;
 }
 
-/**
- * @brief Retrieves the key of the current node from the iterator.
- * @param self Pointer to the tree iterator.
- * @return Key of the current node.
- */
-key_t tree_iter_key (tree_iterator_t* self)
+static void reaggregate_nodes (tree_node_t* node)
 {
-    if (NULL == self->node)
-    {
-        return tree_defaultKey();
-    }
-    else
+    if (NULL != node)
     {
-        return self->node->key;
+        reaggregate_nodes(node->left);
+        reaggregate_nodes(node->right);
+        node->aggregate = aggregate_node(node);
     }
 }
 
 /**
- * @brief Sets the data value of the current node in the iterator.
- * @param self Pointer to the tree iterator.
- * @param value Data value to set.
+ * @brief Retrieves the identity of the aggregate, which is the aggregate of an empty range.
+ * @return Identity of the combine operation.
  */
-void tree_iter_set (tree_iterator_t* self, data_t value)
+int64_t tree_aggregateIdentity ()
 {
-    self->node->value = value;
+    return aggregate_of(NULL);
 }
 
 /**
- * @brief Retrieves the data value of the current node from the iterator.
- * @param self Pointer to the tree iterator.
- * @return Data value of the current node.
+ * @brief Retrieves the aggregate of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Aggregate of the tree, which is the identity, if the tree is empty.
  */
-data_t tree_iter_get (tree_iterator_t* self)
+int64_t tree_aggregate (tree_t* self)
 {
-    if (NULL == self->node)
-    {
-        return tree_defaultValue();
-    }
-    else
-    {
-        return self->node->value;
-    }
+    return aggregate_of(self->root);
 }
 
 /**
- * @brief Retrieves the key of a given tree node.
- * @param self Pointer to the tree node.
- * @return Key of the node.
+ * @brief Computes the aggregate of the entries, whose keys are in a half-open range, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Aggregate of the entries in the range, combined in key order.
  */
-key_t tree_node_key (tree_node_t* self)
+int64_t tree_aggregateRange (tree_t* self, key_t* lo, key_t* hi)
 {
-    if (NULL == self)
-    {
-        return tree_defaultKey();
-    }
-    else
+    // Find the highest node in the range, where the paths to the two bounds part.
+    for (tree_node_t* node = self->root; NULL != node;)
     {
-        return self->key;
+        if (NULL != lo && self->comparator(self, &node->key, lo) < 0)
+        {
+            node = node->right;
+        }
+        else if (NULL != hi && self->comparator(self, &node->key, hi) >= 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            int64_t left = aggregate_above(self, node->left, lo);
+            int64_t entry = aggregate_entry(&node->key, &node->value);
+            int64_t right = aggregate_below(self, node->right, hi);
+            int64_t result = aggregate_combine(&left, &entry);
+            return aggregate_combine(&result, &right);
+        }
     }
-}
 
-/**
- * @brief Sets the data value of a given tree node.
- * @param self Pointer to the tree node.
- * @param value The data value to set.
- */
-void tree_node_set (tree_node_t* self, data_t value)
-{
-    self->value = value;
+    return aggregate_of(NULL);
 }
 
 /**
- * @brief Retrieves the data value of a given tree node.
- * @param self Pointer to the tree node.
- * @return Data value of the node.
+ * @brief Recomputes the aggregates of all of the subtrees in linear time.
+ * @param self Pointer to the AVL tree.
  */
-data_t tree_node_get (tree_node_t* self)
+void tree_reaggregate (tree_t* self)
 {
-    if (NULL == self)
-    {
-        return tree_defaultValue();
-    }
-    else
-    {
-        return self->value;
-    }
+    reaggregate_nodes(self->root);
 }
\ No newline at end of file
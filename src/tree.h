@@ -6,9 +6,15 @@
 #include <stdlib.h>
 #include <string.h>
 
-
 #include "common.h"
 
+#ifndef TREE_MAX_HEIGHT
+/**
+ * Upper bound of the height of any tree, which sizes the stacks that hold a path from the root.
+ * Since the height of an AVL tree with n nodes is less than 1.45 log2(n + 2), it is less than 93 for 2^64 nodes.
+ */
+#define TREE_MAX_HEIGHT 128
+#endif
 
 /**
  * Forward declaration of the tree_node_t structure.
@@ -31,6 +37,16 @@ typedef struct tree_node
      */
     size_t size;
 
+    /**
+     * Sum of the entry hashes in the subtree rooted at this node, which does not depend on its shape.
+     */
+    uint64_t hash;
+
+    /**
+     * Aggregate of the entries in the subtree rooted at this node, combined in key order.
+     */
+    int64_t aggregate;
+
     /**
      * Pointer to the left child node.
      */
@@ -143,6 +159,145 @@ typedef struct
 
 } tree_iterator_t;
 
+/**
+ * @struct tree_range
+ * @brief Cursor over the nodes, whose keys are between two bounds, in ascending order.
+ *
+ * The cursor keeps the path to the next node on a stack; therefore, moving to the next node
+ * takes amortized constant time, and no node outside of the bounds is ever returned.
+ * The cursor must not be used after the tree is modified.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the owning tree.
+     */
+    tree_t* owner;
+
+    /**
+     * Pointer to the current node, or NULL before the first call to next().
+     */
+    tree_node_t* node;
+
+    /**
+     * Upper bound of the keys.
+     */
+    key_t hi;
+
+    /**
+     * Whether the upper bound itself is in the range.
+     */
+    bool hi_inclusive;
+
+    /**
+     * Number of nodes on the stack.
+     */
+    size_t depth;
+
+    /**
+     * Nodes in the range, whose left subtrees are being visited, with the next node on top.
+     */
+    tree_node_t* stack[TREE_MAX_HEIGHT];
+
+} tree_range_t;
+
+/**
+ * @struct tree_finger
+ * @brief Cursor, which remembers the path to the last node it reached, to search near it.
+ *
+ * A search from the finger climbs only to the nearest node on the path, whose subtree spans the key,
+ * and descends from there; therefore, a scan in key order takes amortized constant time per key,
+ * and a search for a key near the last one does not start at the root.
+ * The finger must be initialized again after the tree is modified.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the owning tree.
+     */
+    tree_t* owner;
+
+    /**
+     * Number of nodes on the path.
+     */
+    size_t depth;
+
+    /**
+     * Nodes on the path from the root to the last node reached.
+     */
+    tree_node_t* path[TREE_MAX_HEIGHT];
+
+    /**
+     * Nearest ancestors, whose keys bound the subtree of each node on the path from below, or NULL for no bound.
+     */
+    tree_node_t* lower[TREE_MAX_HEIGHT];
+
+    /**
+     * Nearest ancestors, whose keys bound the subtree of each node on the path from above, or NULL for no bound.
+     */
+    tree_node_t* upper[TREE_MAX_HEIGHT];
+
+} tree_finger_t;
+
+/**
+ * @struct tree_neighbors
+ * @brief Nodes around a key, which are found together in a single descent.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the node with the greatest key less than the key, or NULL if there is none.
+     */
+    tree_node_t* lower;
+
+    /**
+     * Pointer to the node with the key, or NULL if there is none.
+     */
+    tree_node_t* exact;
+
+    /**
+     * Pointer to the node with the least key greater than the key, or NULL if there is none.
+     */
+    tree_node_t* higher;
+
+} tree_neighbors_t;
+
+/**
+ * @struct tree_random
+ * @brief Seedable random number generator (splitmix64), which is small enough to live on the stack.
+ */
+typedef struct
+{
+    /**
+     * State of the generator, which advances by a constant upon each draw.
+     */
+    uint64_t state;
+
+} tree_random_t;
+
+/**
+ * @struct tree_op
+ * @brief A single put or remove operation, which is part of a batch of operations.
+ */
+typedef struct
+{
+    /**
+     * True, if the key is to be removed, rather than put.
+     */
+    bool remove;
+
+    /**
+     * The key to put or remove.
+     */
+    key_t key;
+
+    /**
+     * The data value to associate with the key, if this is a put.
+     */
+    data_t value;
+
+} tree_op_t;
+
 /**
  * @brief Creates a new dynamic tree allocator.
  * @return Pointer to the newly created tree allocator.
@@ -205,6 +360,9 @@ key_t tree_node_key (tree_node_t* self);
  * @brief Sets the data value of a given tree node.
  * @param self Pointer to the tree node.
  * @param value The data value to set.
+ *
+ * The node does not know its tree; therefore, the hashes and aggregates of the node and its ancestors are not updated.
+ * Use setNode() instead, unless rehash() or reaggregate() is called afterwards.
  */
 void tree_node_set (tree_node_t* self, data_t value);
 
@@ -256,6 +414,29 @@ void tree_free_stackalloc (tree_t* self);
  */
 tree_t* tree_copy (tree_t* self);
 
+/**
+ * @brief Splits an AVL tree at a key into two new trees in logarithmic time.
+ * @param self Pointer to the AVL tree, which is empty afterwards.
+ * @param key Key at which to split the tree.
+ * @param left Receives the new tree with the keys less than the key.
+ * @param right Receives the new tree with the keys greater than or equal to the key.
+ * @return true if the tree was split, false if a new tree could not be allocated (the tree is unchanged).
+ *
+ * The nodes are moved rather than copied; hence, the new trees use the allocator and the comparator of the tree.
+ */
+bool tree_split (tree_t* self, key_t key, tree_t** left, tree_t** right);
+
+/**
+ * @brief Moves all of the nodes of one AVL tree to the end of another in logarithmic time.
+ * @param left Pointer to the AVL tree, which receives the nodes.
+ * @param right Pointer to the AVL tree, whose keys must all be greater than the keys of the left tree.
+ * @return true if the trees were joined (the right tree is empty afterwards), false otherwise (both are unchanged).
+ *
+ * The trees must use the same allocator and the same comparator.
+ * The least node of the right tree becomes the pivot, where the two trees are joined.
+ */
+bool tree_join (tree_t* left, tree_t* right);
+
 /**
  * @brief Retrieves the number of nodes in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -281,9 +462,21 @@ void tree_clear (tree_t* self);
  * @param self Pointer to the AVL tree.
  * @param key Key for the node to insert.
  * @return Pointer to the created node.
+ *
+ * The value of a new node is zeroed; set it through setNode(), which keeps the hashes and aggregates up to date.
  */
 tree_node_t* tree_putNode (tree_t* self, key_t key);
 
+/**
+ * @brief Sets the data value of a node of the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param node Pointer to a node of the tree.
+ * @param value Data value to set.
+ *
+ * Unlike node_set(), this keeps the hashes and aggregates of the node and its ancestors up to date.
+ */
+void tree_setNode (tree_t* self, tree_node_t* node, data_t value);
+
 /**
  * @brief Retrieves a node by its key.
  * @param self Pointer to the AVL tree.
@@ -329,6 +522,30 @@ tree_node_t* tree_higherNode (tree_t* self, key_t key);
  */
 tree_node_t* tree_lowerNode (tree_t* self, key_t key);
 
+/**
+ * @brief Finds the node with the greatest key less than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the floor node.
+ * @return Pointer to the floor node or NULL if not found.
+ */
+tree_node_t* tree_floorNode (tree_t* self, key_t key);
+
+/**
+ * @brief Finds the node with the least key greater than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the ceiling node.
+ * @return Pointer to the ceiling node or NULL if not found.
+ */
+tree_node_t* tree_ceilingNode (tree_t* self, key_t key);
+
+/**
+ * @brief Finds the lower node, the exact node and the higher node of a given key in a single descent.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the neighbors.
+ * @return The lower, exact and higher nodes, each of which is NULL if not found.
+ */
+tree_neighbors_t tree_neighbors (tree_t* self, key_t key);
+
 /**
  * @brief Finds the nth node (0-based index) in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -337,7 +554,82 @@ tree_node_t* tree_lowerNode (tree_t* self, key_t key);
  */
 tree_node_t* tree_nthNode (tree_t* self, size_t index);
 
+/**
+ * @brief Finds the index (0-based) of a key in the AVL tree, which is the inverse of nthNode().
+ * @param self Pointer to the AVL tree.
+ * @param key Key to search for.
+ * @return Index of the key, or SIZE_MAX if the key is not found.
+ */
+size_t tree_rankOf (tree_t* self, key_t key);
+
+/**
+ * @brief Finds the index (0-based) of the greatest key, which is less than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the floor key, or SIZE_MAX if all of the keys are greater than the given key.
+ */
+size_t tree_floorRank (tree_t* self, key_t key);
+
+/**
+ * @brief Finds the index (0-based) of the least key, which is greater than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the ceiling key, or SIZE_MAX if all of the keys are less than the given key.
+ */
+size_t tree_ceilingRank (tree_t* self, key_t key);
+
+/**
+ * @brief Counts the nodes, whose keys are between two bounds, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ * @return Number of nodes in the range, which is zero if the range is empty.
+ *
+ * For example, countRange(self, lo, true, hi, false) counts the keys in [lo, hi).
+ */
+size_t tree_countRange (tree_t* self, key_t lo, bool lo_inclusive, key_t hi, bool hi_inclusive);
+
+/**
+ * @brief Creates a random number generator from a seed.
+ * @param seed Seed of the generator; equal seeds produce equal sequences.
+ * @return The random number generator.
+ */
+tree_random_t tree_random_seed (uint64_t seed);
+
+/**
+ * @brief Draws the next random number from a generator.
+ * @param self Pointer to the random number generator.
+ * @return Uniformly distributed 64-bit random number.
+ */
+uint64_t tree_random_next (tree_random_t* self);
+
+/**
+ * @brief Draws uniformly random nodes (with replacement) from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param k Number of nodes to draw.
+ * @param rng Pointer to the random number generator.
+ * @param out Array that receives the k drawn nodes in ascending key order.
+ * @return Number of nodes drawn, which is zero if the tree is empty or memory could not be allocated.
+ *
+ * The random ranks are sorted, and then all of the nodes are found in a single walk over the tree,
+ * which shares the common prefixes of the paths, instead of k independent descents.
+ */
+size_t tree_sample (tree_t* self, size_t k, tree_random_t* rng, tree_node_t** out);
 
+/**
+ * @brief Finds the nodes at several quantiles of the keys in a single walk over the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param q Quantiles, each of which is between 0 and 1 (values outside are clamped), in any order.
+ * @param m Number of quantiles.
+ * @param out Array that receives the node at each quantile, in the order of the quantiles.
+ * @return true if the nodes were found, false if the tree is empty or memory could not be allocated.
+ *
+ * The node at quantile q is the node at the rank round(q * (size - 1));
+ * hence, 0 is the first node, 0.5 is the median and 1 is the last node.
+ */
+bool tree_quantiles (tree_t* self, const double* q, size_t m, tree_node_t** out);
 
 /**
  * @brief Adds a value as the first element in the AVL tree.
@@ -379,8 +671,6 @@ bool tree_pushLast (tree_t* self, data_t value);
  */
 bool tree_push (tree_t* self, data_t value);
 
-
-
 /**
  * @brief Peeks at the last value in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -549,6 +839,94 @@ void tree_retainAll (tree_t* self, tree_t* other);
  */
 bool tree_put (tree_t* self, key_t key, data_t value);
 
+/**
+ * @brief Inserts many key-value pairs at once by sorting them and rebuilding the tree in linear time.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool tree_putArrays (tree_t* self, key_t* keys, data_t* values, size_t count);
+
+/**
+ * @brief Inserts many key-value pairs at once, sorting and building the tree using multiple threads.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @param threads Maximum number of threads to use.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool tree_putArraysParallel (tree_t* self, key_t* keys, data_t* values, size_t count, size_t threads);
+
+/**
+ * @brief Streams the key-value pairs of the AVL tree, in ascending order, into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs passed to the sink at once.
+ * @param sink Function receiving each chunk (keys and values, index for index), which returns false to stop the export.
+ * @param context Additional context passed to the sink.
+ * @return true if every pair was passed to the sink, false if the sink stopped the export or a buffer could not be allocated.
+ *
+ * The tree is traversed once, and only two buffers of chunk_size elements are allocated.
+ * The sink must not modify the tree.
+ */
+bool tree_export (tree_t* self, size_t chunk_size, bool (*sink)(tree_t*, key_t*, data_t*, size_t, void*), void* context);
+
+/**
+ * @brief Inserts the key-value pairs produced by a source, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs requested from the source at once.
+ * @param source Function filling at most chunk_size keys and values, which returns the number of pairs filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If the pairs arrive in strictly ascending order, as produced by tree_export(), then the tree is built
+ * in linear time without sorting. Otherwise, the pairs are sorted first, and the last occurrence of a key wins.
+ */
+bool tree_import (tree_t* self, size_t chunk_size, size_t (*source)(tree_t*, key_t*, data_t*, size_t, void*), void* context);
+
+/**
+ * @brief Applies a batch of put and remove operations in one pass over the tree.
+ * @param self Pointer to the AVL tree.
+ * @param ops Operations to apply, preferably sorted by key.
+ * @param count Number of operations in the batch.
+ * @return true if all of the operations were applied, false otherwise (the tree is then left unchanged).
+ *
+ * When several operations have the same key, the last one wins.
+ * Unsorted batches are sorted internally, without modifying the given array.
+ * A node is allocated up front for each put, before the tree is touched, and the nodes of puts that overwrite an existing key are released afterwards.
+ */
+bool tree_applyBatch (tree_t* self, tree_op_t* ops, size_t count);
+
+/**
+ * @brief Computes the operations that turn one AVL tree into another, and streams them into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree, which is the starting point.
+ * @param other Pointer to the AVL tree, which is the goal, and which must use the same comparator.
+ * @param sink Function receiving each chunk of operations, which returns false to stop the diff.
+ * @param context Additional context passed to the sink.
+ * @return true if every operation was passed to the sink, false if the sink stopped the diff or a buffer could not be allocated.
+ *
+ * Both trees are walked in order, side by side, which takes linear time. Only keys that are missing from
+ * the goal are removed, and only keys that are new or whose values differ (byte for byte) are put.
+ * Since the operations are sorted by key and the keys are distinct, tree_applyBatch() applies them in a single pass.
+ */
+bool tree_diff (tree_t* self, tree_t* other, bool (*sink)(tree_t*, tree_op_t*, size_t, void*), void* context);
+
+/**
+ * @brief Applies the operations produced by a source, one chunk at a time, such as a diff received from another process.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of operations requested from the source at once.
+ * @param source Function filling at most chunk_size operations, which returns the number of operations filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if all of the operations were applied, false if a buffer or a node could not be allocated.
+ */
+bool tree_applyPatch (tree_t* self, size_t chunk_size, size_t (*source)(tree_t*, tree_op_t*, size_t, void*), void* context);
+
 /**
  * @brief Retrieves the value associated with a key in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -557,6 +935,22 @@ bool tree_put (tree_t* self, key_t key, data_t value);
  */
 data_t tree_get (tree_t* self, key_t key);
 
+/**
+ * @brief Retrieves the values associated with many keys in the AVL tree, overlapping their lookups.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
+ *
+ * Several descents advance in turn, one level at a time, and each step prefetches the next node of its descent;
+ * hence, the cache misses of the descents overlap, instead of adding up as they do in a loop of get().
+ * Sorted keys benefit further, since consecutive descents share the cached prefixes of their paths.
+ * The results are stored in the order of the keys.
+ */
+size_t tree_getMany (tree_t* self, key_t* keys, data_t* values, bool* found, size_t count);
+
 /**
  * @brief Removes a key and its value from the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -584,6 +978,20 @@ void tree_removeLast (tree_t* self);
  */
 void tree_removeIf (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context);
 
+/**
+ * @brief Removes the nodes, whose keys are in a half-open range, in O(log n + k) time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Inclusive lower bound of the keys.
+ * @param hi Exclusive upper bound of the keys.
+ * @param callback Function that receives each removed node, in ascending order, before it is released, or NULL.
+ * @param context Additional context passed to the callback.
+ * @return Number of removed nodes.
+ *
+ * The range is detached from the tree in O(log n) time, by splitting and joining the tree,
+ * and then its k nodes are released without any rebalancing.
+ */
+size_t tree_removeRange (tree_t* self, key_t lo, key_t hi, void (*callback)(tree_t*, tree_node_t*, void*), void* context);
+
 /**
  * @brief Applies a function to each node in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -619,6 +1027,43 @@ bool tree_allMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*
  */
 bool tree_noneMatch (tree_t* self, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context);
 
+/**
+ * @brief Checks if any nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if any match found, false otherwise.
+ *
+ * Only the subtrees, which overlap the range, are visited, and the search stops at the first match.
+ */
+bool tree_anyMatchRange (tree_t* self, key_t* lo, key_t* hi, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context);
+
+/**
+ * @brief Checks if all nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if all nodes in the range match, false otherwise.
+ *
+ * Only the subtrees, which overlap the range, are visited, and the search stops at the first mismatch.
+ */
+bool tree_allMatchRange (tree_t* self, key_t* lo, key_t* hi, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context);
+
+/**
+ * @brief Checks if none of the nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if none match, false otherwise.
+ */
+bool tree_noneMatchRange (tree_t* self, key_t* lo, key_t* hi, bool (*predicate)(tree_t*, tree_node_t*, void*), void* context);
+
 /**
  * @brief Counts the number of nodes matching a given predicate.
  * @param self Pointer to the AVL tree.
@@ -721,4 +1166,1035 @@ void tree_iter_set (tree_iterator_t* self, data_t value);
  */
 data_t tree_iter_get (tree_iterator_t* self);
 
+/**
+ * @brief Positions a range cursor before the first node, whose key is between two bounds, in a single descent.
+ * @param self Pointer to the range cursor.
+ * @param owner Pointer to the AVL tree.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ */
+void tree_range_seek (tree_range_t* self, tree_t* owner, key_t lo, bool lo_inclusive, key_t hi, bool hi_inclusive);
+
+/**
+ * @brief Checks if the range cursor has a next node.
+ * @param self Pointer to the range cursor.
+ * @return true if there is a next node in the range, false otherwise.
+ */
+bool tree_range_hasNext (tree_range_t* self);
+
+/**
+ * @brief Advances the range cursor to the next node.
+ * @param self Pointer to the range cursor.
+ */
+void tree_range_next (tree_range_t* self);
+
+/**
+ * @brief Retrieves the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Pointer to the current node, or NULL if the cursor is not at a node.
+ */
+tree_node_t* tree_range_node (tree_range_t* self);
+
+/**
+ * @brief Retrieves the key of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Key of the current node.
+ */
+key_t tree_range_key (tree_range_t* self);
+
+/**
+ * @brief Retrieves the data value of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Data value of the current node.
+ */
+data_t tree_range_get (tree_range_t* self);
+
+/**
+ * @brief Initializes a finger at the root of a tree.
+ * @param self Pointer to the finger.
+ * @param owner Pointer to the AVL tree.
+ */
+void tree_finger_init (tree_finger_t* self, tree_t* owner);
+
+/**
+ * @brief Moves a finger to the node with a given key, or to the last node on its search path.
+ *
+ * The search starts from the nearest node on the path of the finger, whose subtree spans the key,
+ * so that a scan in key order costs amortized constant time per key, and no search costs more than get().
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Pointer to the node with the key, or NULL if the key is not in the tree.
+ */
+tree_node_t* tree_finger_seek (tree_finger_t* self, key_t key);
+
+/**
+ * @brief Retrieves the data value associated with a given key by a search from a finger.
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Data value associated with the key, or the default value if the key is not in the tree.
+ */
+data_t tree_finger_get (tree_finger_t* self, key_t key);
+
+/**
+ * Forward declaration of the tree_multiqueue_t structure.
+ *
+ * A multiqueue is a relaxed concurrent priority queue, which consists of several trees,
+ * each one guarded by its own lock. An insertion goes into a randomly chosen tree.
+ * A removal locks two randomly chosen trees and removes the smaller of their two first elements.
+ * Threads never wait on a lock; rather, they simply pick different trees, when a lock is busy.
+ *
+ * Relaxation Guarantees:
+ * - popFirst() does not necessarily return the global minimum; rather, it returns the minimum of two random trees.
+ *   With q trees, the expected rank of the returned element is O(q) and the rank is O(q log q) with high probability.
+ * - Elements that were put into the same tree are removed in key order, since each tree is an exact priority queue.
+ * - popFirst() only reports that the multiqueue is empty after it has observed every tree to be empty.
+ * - With a single tree, the multiqueue is an exact, but fully serialized, priority queue.
+ *
+ * The single-threaded tree_popFirst() and tree_peekFirst() functions are unaffected by this type.
+ */
+typedef struct tree_multiqueue tree_multiqueue_t;
+
+/**
+ * @brief Creates a new multiqueue using the natural ordering of keys.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ */
+tree_multiqueue_t* tree_multiqueue_new (size_t queues);
+
+/**
+ * @brief Creates a new multiqueue with a specified comparator.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ *
+ * The internal trees always use the dynamic allocator, because the other allocators are not thread-safe.
+ */
+tree_multiqueue_t* tree_multiqueue_make (size_t queues, tree_comparator_t comparator);
+
+/**
+ * @brief Frees the resources of a multiqueue, which must no longer be in use by any thread.
+ * @param self Pointer to the multiqueue to free.
+ */
+void tree_multiqueue_free (tree_multiqueue_t* self);
+
+/**
+ * @brief Retrieves the number of elements in the multiqueue, which may be stale under concurrent use.
+ * @param self Pointer to the multiqueue.
+ * @return Number of elements in the multiqueue.
+ */
+size_t tree_multiqueue_size (tree_multiqueue_t* self);
+
+/**
+ * @brief Inserts a key-value pair into the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Key, which is the priority of the element.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ *
+ * If the chosen tree already contains the key, then its value is replaced.
+ */
+bool tree_multiqueue_put (tree_multiqueue_t* self, key_t key, data_t value);
+
+/**
+ * @brief Pushes a value with the next sequence number as its key (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ *
+ * Popping from a multiqueue that is only filled this way yields a relaxed FIFO queue.
+ */
+bool tree_multiqueue_push (tree_multiqueue_t* self, data_t value);
+
+/**
+ * @brief Removes an element with a small key from the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Output for the key of the removed element, or NULL.
+ * @param value Output for the data value of the removed element, or NULL.
+ * @return true if an element was removed, false if the multiqueue was observed to be empty.
+ */
+bool tree_multiqueue_popFirst (tree_multiqueue_t* self, key_t* key, data_t* value);
+
+/**
+ * Forward declaration of the tree_writebehind_t structure.
+ *
+ * A write-behind queue decouples writers from a tree. Any number of threads enqueue puts and removes
+ * into a lock-free ring buffer, without touching the tree. A dedicated applier thread drains the ring buffer
+ * in batches, sorts and coalesces each batch, and then applies the batch to the tree using tree_applyBatch().
+ * The applier sleeps while it waits; only the writer that completes a batch, or that arrives at an idle queue, wakes it.
+ */
+typedef struct tree_writebehind tree_writebehind_t;
+
+/**
+ * @struct tree_writebehind_stats
+ * @brief Counters describing the activity of a write-behind queue.
+ */
+typedef struct
+{
+    /**
+     * Number of operations currently waiting in the ring buffer.
+     */
+    size_t depth;
+
+    /**
+     * Highest number of operations that the applier has seen waiting in the ring buffer.
+     */
+    size_t max_depth;
+
+    /**
+     * Number of operations that have been enqueued.
+     */
+    uint64_t enqueued;
+
+    /**
+     * Number of operations that have been applied to the tree.
+     */
+    uint64_t applied;
+
+    /**
+     * Number of batches that have been applied to the tree.
+     */
+    uint64_t batches;
+
+    /**
+     * Number of times that a writer found the ring buffer to be full and had to wait.
+     */
+    uint64_t stalls;
+
+    /**
+     * Number of times that a batch could not be applied, because a node could not be allocated.
+     * The tree is then left unchanged, and the applier retries the same batch after waiting for the latency bound.
+     */
+    uint64_t failures;
+
+} tree_writebehind_stats_t;
+
+/**
+ * @brief Creates a write-behind queue in front of a tree and starts its applier thread.
+ * @param tree Pointer to the tree, which must only be accessed through the queue from now on.
+ * @param capacity Capacity of the ring buffer, which is rounded up to a power of two.
+ * @param batch_size Maximum number of operations applied to the tree at once.
+ * @param max_latency_ns Longest time that the applier waits for a batch to fill up, in nanoseconds.
+ * @return Pointer to the newly created queue or NULL if creation failed.
+ */
+tree_writebehind_t* tree_writebehind_new (tree_t* tree, size_t capacity, size_t batch_size, uint64_t max_latency_ns);
+
+/**
+ * @brief Applies all pending operations, stops the applier thread, and frees the queue (but not the tree).
+ * @param self Pointer to the write-behind queue.
+ */
+void tree_writebehind_free (tree_writebehind_t* self);
+
+/**
+ * @brief Enqueues a put operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ */
+void tree_writebehind_put (tree_writebehind_t* self, key_t key, data_t value);
+
+/**
+ * @brief Enqueues a remove operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to remove.
+ */
+void tree_writebehind_remove (tree_writebehind_t* self, key_t key);
+
+/**
+ * @brief Waits until every operation enqueued before this call has been applied to the tree.
+ * @param self Pointer to the write-behind queue.
+ *
+ * This is the barrier needed for read-your-writes.
+ */
+void tree_writebehind_flush (tree_writebehind_t* self);
+
+/**
+ * @brief Retrieves the value associated with a key, as of the last applied batch (thread-safe).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to search for.
+ * @param value Output for the associated value, or NULL.
+ * @return true if the key was found, false otherwise.
+ */
+bool tree_writebehind_get (tree_writebehind_t* self, key_t key, data_t* value);
+
+/**
+ * @brief Locks the tree for reading, so that the applier cannot modify the tree until released.
+ * @param self Pointer to the write-behind queue.
+ * @return Pointer to the tree, which must not be modified.
+ */
+tree_t* tree_writebehind_acquire (tree_writebehind_t* self);
+
+/**
+ * @brief Unlocks the tree, which was locked by tree_writebehind_acquire().
+ * @param self Pointer to the write-behind queue.
+ */
+void tree_writebehind_release (tree_writebehind_t* self);
+
+/**
+ * @brief Retrieves the counters of a write-behind queue.
+ * @param self Pointer to the write-behind queue.
+ * @return Snapshot of the counters.
+ */
+tree_writebehind_stats_t tree_writebehind_stats (tree_writebehind_t* self);
+
+/**
+ * Forward declaration of the tree_concurrent_t structure.
+ *
+ * A concurrent tree is a relaxed-balance AVL tree, which follows the optimistic concurrent AVL tree
+ * of Bronson, Casper, Chafi, and Olukotun (PPoPP 2010). Each node has its own spin lock and version number.
+ * Searches take no locks until they reach the node that holds the key; rather, they validate the version numbers
+ * of the nodes that they pass through, and retry whenever a rotation moved a subtree out from under them.
+ * Updates lock only the nodes that they modify; therefore, operations on disjoint keys proceed in parallel.
+ *
+ * Notes:
+ * - Removing a key whose node has two children only marks the node as a routing node.
+ *   Routing nodes are unlinked later, once rebalancing leaves them with fewer than two children.
+ * - Balance is restored after each update, but may be temporarily violated while concurrent updates are in progress.
+ * - Unlinked nodes may still be visited by concurrent searches; therefore, they are retired rather than freed,
+ *   until tree_concurrent_collect() or tree_concurrent_free() is called.
+ * - The comparator is invoked with NULL as its tree argument.
+ */
+typedef struct tree_concurrent tree_concurrent_t;
+
+/**
+ * @brief Creates a new concurrent tree using the natural ordering of keys.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+tree_concurrent_t* tree_concurrent_new ();
+
+/**
+ * @brief Creates a new concurrent tree with a specified comparator.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+tree_concurrent_t* tree_concurrent_make (tree_comparator_t comparator);
+
+/**
+ * @brief Frees the resources of a concurrent tree, which must no longer be in use by any thread.
+ * @param self Pointer to the concurrent tree to free.
+ */
+void tree_concurrent_free (tree_concurrent_t* self);
+
+/**
+ * @brief Frees the nodes that were unlinked by removals, while no other thread is using the concurrent tree.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of nodes freed.
+ */
+size_t tree_concurrent_collect (tree_concurrent_t* self);
+
+/**
+ * @brief Retrieves the number of entries in the concurrent tree, which may be stale under concurrent use.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of entries in the concurrent tree.
+ */
+size_t tree_concurrent_size (tree_concurrent_t* self);
+
+/**
+ * @brief Inserts a key-value pair into the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool tree_concurrent_put (tree_concurrent_t* self, key_t key, data_t value);
+
+/**
+ * @brief Retrieves the value associated with a key in the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+data_t tree_concurrent_get (tree_concurrent_t* self, key_t key);
+
+/**
+ * @brief Checks if the concurrent tree contains a specific key (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to check for.
+ * @return true if the key is found, false otherwise.
+ */
+bool tree_concurrent_containsKey (tree_concurrent_t* self, key_t key);
+
+/**
+ * @brief Removes a key and its value from the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to remove.
+ */
+void tree_concurrent_remove (tree_concurrent_t* self, key_t key);
+
+/**
+ * @brief Writes a binary snapshot of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * A snapshot consists of a header (magic, format version, byte order, key size, value size, and entry count),
+ * the key-value pairs in ascending order, and a trailing 64-bit checksum of everything before it.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool tree_save (tree_t* self, int fd);
+
+/**
+ * @brief Reads a binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Loading fails, if the header does not match this tree's key and value types,
+ * if the data is truncated or fails the checksum, or if a node cannot be allocated.
+ * Since the entries are already sorted, an empty tree is built in linear time without any key comparisons.
+ * Otherwise, the entries are merged into the tree, replacing the values of keys that are already present.
+ */
+bool tree_load (tree_t* self, int fd);
+
+/**
+ * @struct tree_image_node
+ * @brief Node of a tree image, which links to its children by index rather than by address.
+ *
+ * The nodes of an image are stored in ascending order of their keys; therefore, the index of a node is also its rank.
+ */
+typedef struct tree_image_node
+{
+    /**
+     * Index of the left child plus one, or zero if there is no left child.
+     */
+    uint64_t left;
+
+    /**
+     * Index of the right child plus one, or zero if there is no right child.
+     */
+    uint64_t right;
+
+    /**
+     * The key that identifies this node in the tree.
+     */
+    key_t key;
+
+    /**
+     * The data stored in this node.
+     */
+    data_t value;
+
+} tree_image_node_t;
+
+/**
+ * Forward declaration of the tree_image_t structure.
+ *
+ * An image is a relocatable, read-only copy of a tree, which is memory-mapped from a file.
+ * Opening an image only validates its header; therefore, the time to open does not depend on the size of the tree.
+ * Lookups check each child link against the bounds implied by the path to it, so that a corrupt image cannot lead them
+ * outside of the mapping or into a cycle; it can still yield wrong results, which tree_image_verify() detects.
+ * Lookups and iteration work directly on the mapped nodes, which the operating system pages in on demand.
+ */
+typedef struct tree_image tree_image_t;
+
+/**
+ * @brief Writes an image of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially.
+ * @return true if the image was written completely, false if an I/O error occurred.
+ *
+ * An image consists of a header, the nodes in ascending order, and a trailing 64-bit checksum.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool tree_saveImage (tree_t* self, int fd);
+
+/**
+ * @brief Maps an image using the natural ordering of keys.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+tree_image_t* tree_image_open (int fd, bool copy_on_write);
+
+/**
+ * @brief Maps an image with a specified comparator, which must be the comparator of the saved tree.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+tree_image_t* tree_image_make (int fd, bool copy_on_write, tree_comparator_t comparator);
+
+/**
+ * @brief Unmaps an image and frees its resources.
+ * @param self Pointer to the image.
+ */
+void tree_image_close (tree_image_t* self);
+
+/**
+ * @brief Checks the checksum of an image, which reads the entire image.
+ * @param self Pointer to the image.
+ * @return true if the image is intact, false otherwise.
+ */
+bool tree_image_verify (tree_image_t* self);
+
+/**
+ * @brief Retrieves the number of nodes in an image.
+ * @param self Pointer to the image.
+ * @return Number of nodes in the image.
+ */
+size_t tree_image_size (tree_image_t* self);
+
+/**
+ * @brief Retrieves the node associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return Pointer to the node or NULL if not found.
+ */
+tree_image_node_t* tree_image_getNode (tree_image_t* self, key_t key);
+
+/**
+ * @brief Retrieves the value associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+data_t tree_image_get (tree_image_t* self, key_t key);
+
+/**
+ * @brief Finds the successor node (next higher key) of a given key in an image.
+ * @param self Pointer to the image.
+ * @param key Key for which to find the higher node.
+ * @return Pointer to the higher node or NULL if not found.
+ */
+tree_image_node_t* tree_image_higherNode (tree_image_t* self, key_t key);
+
+/**
+ * @brief Finds the nth node (0-based index) in an image, in constant time.
+ * @param self Pointer to the image.
+ * @param index The index of the node to find.
+ * @return Pointer to the nth node or NULL if not found.
+ */
+tree_image_node_t* tree_image_nthNode (tree_image_t* self, size_t index);
+
+/**
+ * @brief Retrieves the first node (minimum key) of an image.
+ * @param self Pointer to the image.
+ * @return Pointer to the first node or NULL if the image is empty.
+ */
+tree_image_node_t* tree_image_firstNode (tree_image_t* self);
+
+/**
+ * @brief Retrieves the node after a given node (next higher key) of an image, in constant time.
+ * @param self Pointer to the image.
+ * @param node Pointer to a node of the image.
+ * @return Pointer to the next node or NULL if the given node is the last one.
+ */
+tree_image_node_t* tree_image_nextNode (tree_image_t* self, tree_image_node_t* node);
+
+/**
+ * Forward declaration of the tree_wal_t structure.
+ *
+ * A write-ahead log makes the mutations of a tree durable. Each put and remove is applied to the tree,
+ * and appended to a log file as a checksummed record. A background thread commits the records in groups,
+ * so that many records share a single fsync. Opening a log recovers the tree, by loading the last snapshot,
+ * and then replaying the log on top of it. Compaction writes a new snapshot and truncates the log.
+ *
+ * Notes:
+ * - A group is committed, when it holds group_size records, or when its first record is max_latency_ns old.
+ *   Larger groups and latencies trade commit latency for fewer fsyncs.
+ * - Replaying a log on top of a snapshot that already contains some of its records is harmless,
+ *   since the last record of each key determines its final state.
+ * - A torn record at the end of the log, which a crash may leave behind, is discarded during recovery.
+ * - The log serializes the mutations of the tree, but not concurrent reads of the tree.
+ */
+typedef struct tree_wal tree_wal_t;
+
+/**
+ * @brief Recovers a tree from a snapshot and a log, and then opens the log for appending.
+ * @param tree Pointer to the tree, which is usually empty, and which must only be mutated through the log from now on.
+ * @param snapshot_path Path of the snapshot file, which need not exist yet.
+ * @param log_path Path of the log file, which is created if it does not exist yet.
+ * @param group_size Maximum number of records committed by a single fsync.
+ * @param max_latency_ns Longest time that a record waits for its group to fill up, in nanoseconds.
+ * @return Pointer to the opened log or NULL if recovery failed.
+ */
+tree_wal_t* tree_wal_open (tree_t* tree, const char* snapshot_path, const char* log_path, size_t group_size, uint64_t max_latency_ns);
+
+/**
+ * @brief Commits all pending records, closes the log, and frees its resources (but not the tree).
+ * @param self Pointer to the log.
+ * @return true if all records were committed, false if an I/O error occurred at any point.
+ */
+bool tree_wal_close (tree_wal_t* self);
+
+/**
+ * @brief Inserts a key-value pair into the tree and appends it to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return Sequence number of the record, or zero if the insertion failed or the log has failed.
+ */
+uint64_t tree_wal_put (tree_wal_t* self, key_t key, data_t value);
+
+/**
+ * @brief Removes a key from the tree and appends the removal to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to remove.
+ * @return Sequence number of the record, or zero if the log has failed.
+ */
+uint64_t tree_wal_remove (tree_wal_t* self, key_t key);
+
+/**
+ * @brief Waits until the record with a given sequence number, and all records before it, are durable.
+ * @param self Pointer to the log.
+ * @param sequence Sequence number returned by a put or remove.
+ * @return true if the records are durable, false if an I/O error occurred.
+ */
+bool tree_wal_sync (tree_wal_t* self, uint64_t sequence);
+
+/**
+ * @brief Writes a new snapshot of the tree and truncates the log, while mutations wait.
+ * @param self Pointer to the log.
+ * @return true if the compaction succeeded, false otherwise (a failed snapshot leaves the log intact).
+ */
+bool tree_wal_compact (tree_wal_t* self);
+
+/**
+ * @brief Counters describing the checkpoints of a write-ahead log.
+ */
+typedef struct
+{
+    /**
+     * Whether a checkpoint is currently running.
+     */
+    bool running;
+
+    /**
+     * Number of checkpoints that completed successfully.
+     */
+    uint64_t checkpoints;
+
+    /**
+     * Number of checkpoints that failed.
+     */
+    uint64_t failures;
+
+    /**
+     * Number of entries written by the current (or last) checkpoint so far.
+     */
+    uint64_t entries_written;
+
+    /**
+     * Size of the tree when the current (or last) checkpoint started, which estimates its total number of entries.
+     */
+    uint64_t entries_expected;
+
+    /**
+     * Number of bytes in the snapshot of the last completed checkpoint.
+     */
+    uint64_t bytes_written;
+
+    /**
+     * Sequence number of the last record covered by the snapshot of the last completed checkpoint.
+     */
+    uint64_t sequence;
+
+    /**
+     * Wall-clock duration of the last completed checkpoint, in nanoseconds.
+     */
+    uint64_t last_duration_ns;
+
+    /**
+     * Longest time that the last completed checkpoint held off writers at once, in nanoseconds.
+     */
+    uint64_t last_pause_ns;
+
+    /**
+     * Total duration of all completed checkpoints, in nanoseconds.
+     */
+    uint64_t total_duration_ns;
+
+} tree_wal_checkpoint_stats_t;
+
+/**
+ * @brief Starts a checkpoint on a background thread, which writes a new snapshot while writers continue.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint was started, false if one is already running or the thread cannot be created.
+ *
+ * A checkpoint copies the tree in small chunks, locking out writers only while a chunk is copied.
+ * The resulting snapshot is fuzzy; it reflects each key at some point after the checkpoint started.
+ * Recovery still reaches the exact state, because the log keeps every record after that point.
+ * When the snapshot is durable, the log is replaced by just those records,
+ * which is the only other time when writers wait (for as long as the copy of these records takes).
+ *
+ * Notes:
+ * - The snapshot file is not valid on its own, but only together with the log. It may mix states from different
+ *   points in time, so it must not be loaded with tree_load() alone, or be used as a backup or for a standby.
+ *   Use tree_wal_compact(), or tree_save() on a quiescent tree, for a consistent snapshot.
+ * - Every checkpoint rewrites the whole tree, so its cost grows with the size of the tree, not with the number of changes.
+ */
+bool tree_wal_startCheckpoint (tree_wal_t* self);
+
+/**
+ * @brief Waits until the checkpoint that was started last completes.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint succeeded, false if it failed or no checkpoint was ever started.
+ */
+bool tree_wal_waitCheckpoint (tree_wal_t* self);
+
+/**
+ * @brief Retrieves the progress and timing counters of the checkpoints of a log.
+ * @param self Pointer to the log.
+ * @return Copy of the counters.
+ */
+tree_wal_checkpoint_stats_t tree_wal_checkpointStats (tree_wal_t* self);
+
+/**
+ * @brief Writes a packed binary snapshot of the AVL tree, whose keys and values are integers, to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * The entries are stored in blocks of 128. Within a block, the differences between consecutive keys,
+ * and the differences between the values and the smallest value, are bit-packed using the fewest bits
+ * that fit the largest difference (frame-of-reference encoding). Dense ascending keys take about one bit each.
+ * Like a plain snapshot, a packed snapshot has a header and a trailing checksum.
+ */
+bool tree_savePacked (tree_t* self, int fd);
+
+/**
+ * @brief Reads a packed binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Decoding a block takes fixed-width shifts and masks, followed by a prefix sum of the key differences,
+ * without any data-dependent branches.
+ */
+bool tree_loadPacked (tree_t* self, int fd);
+
+/**
+ * @brief Computes the hash of a single entry, which is the unit of the subtree hashes.
+ * @param key Key of the entry.
+ * @param value Data value of the entry.
+ * @return Hash of the bytes of the key and the value (pointers are hashed by address).
+ *
+ * The hash of a subtree is the sum, modulo 2^64, of the hashes of its entries.
+ * Hence, trees with the same entries have the same hash, regardless of their shapes.
+ * Values must only be changed using put(), setNode() or iter_set(), which keep the hashes up to date;
+ * after writing values through a node directly, call rehash().
+ */
+uint64_t tree_hashEntry (key_t key, data_t value);
+
+/**
+ * @brief Retrieves the hash of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Hash of the tree, which is zero, if the tree is empty.
+ */
+uint64_t tree_hash (tree_t* self);
+
+/**
+ * @brief Computes the hash of the entries, whose keys are in a half-open range, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Hash of the entries in the range.
+ */
+uint64_t tree_hashRange (tree_t* self, key_t* lo, key_t* hi);
+
+/**
+ * @brief Finds the key ranges, where two AVL trees differ, by descending only into mismatched ranges.
+ * @param self Pointer to the AVL tree.
+ * @param other Pointer to the other AVL tree, which must use the same comparator.
+ * @param leaf_size Largest number of entries (in both trees together) of a reported range.
+ * @param callback Function that receives each range as an inclusive lower bound and an exclusive upper bound,
+ *                 where NULL means unbounded, and returns false to stop the search.
+ * @param context User-defined context for the callback.
+ * @return true if the search completed, false if the callback stopped it.
+ *
+ * The ranges are reported in ascending order. Equal trees are recognized in constant time,
+ * and k differences cost about O(k log^2 n) time, independent of the shapes of the trees.
+ * A reported range, which holds more than one entry, may also contain some equal entries.
+ */
+bool tree_mismatches (tree_t* self, tree_t* other, size_t leaf_size, bool (*callback)(tree_t*, key_t*, key_t*, void*), void* context);
+
+/**
+ * @brief Recomputes the hashes of all of the subtrees in linear time.
+ * @param self Pointer to the AVL tree.
+ */
+void tree_rehash (tree_t* self);
+
+/**
+ * Forward declaration of the tree_disk_t structure.
+ *
+ * A disk tree is a B+ tree, whose nodes are fixed-size pages in a file, for maps that do not fit in memory.
+ * Only a bounded number of pages are cached in memory at once. When the cache is full, a page is evicted
+ * using the CLOCK algorithm (an approximation of LRU), which writes the page back first, if it is dirty.
+ * Pages are read and written using pread() and pwrite(). Its functions mirror the functions of the AVL tree.
+ *
+ * Notes:
+ * - Keys and values are copied byte for byte; therefore, they must be plain old data.
+ * - Removals do not merge pages. An emptied page stays in the tree, and is reused by later puts into its key range.
+ * - Changes are written to the file, when pages are evicted, and by flush() and close(). A crash in between may
+ *   leave the file inconsistent; therefore, use snapshots or a write-ahead log, where durability matters.
+ * - A disk tree is not thread-safe.
+ */
+typedef struct tree_disk tree_disk_t;
+
+/**
+ * @brief Counters describing the page cache of a disk tree.
+ */
+typedef struct
+{
+    /**
+     * Number of page accesses that found the page in the cache.
+     */
+    uint64_t hits;
+
+    /**
+     * Number of page accesses that did not find the page in the cache.
+     */
+    uint64_t misses;
+
+    /**
+     * Number of pages that were evicted from the cache, to make room for other pages.
+     */
+    uint64_t evictions;
+
+    /**
+     * Number of pages read from the file.
+     */
+    uint64_t reads;
+
+    /**
+     * Number of pages written to the file.
+     */
+    uint64_t writes;
+
+    /**
+     * Number of pages in the file, including the header page.
+     */
+    uint64_t pages;
+
+    /**
+     * Number of pages that the cache holds.
+     */
+    size_t cache_pages;
+
+    /**
+     * Number of batches of page reads, which getMany() issued at once.
+     */
+    uint64_t batches;
+
+    /**
+     * Whether the batches are read using io_uring, rather than a pool of threads calling pread().
+     */
+    bool io_uring;
+
+} tree_disk_stats_t;
+
+/**
+ * @brief Iterator over the entries of a disk tree, which holds a copy of the current entry.
+ *
+ * Unlike the iterator of the AVL tree, it does not refer to any page; however, a put into the tree may move
+ * the entries that have not been visited yet; therefore, the iterator must not be used after a put.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the disk tree.
+     */
+    tree_disk_t* owner;
+
+    /**
+     * Number of the leaf page holding the next entry, or zero if there are no more entries.
+     */
+    uint64_t page;
+
+    /**
+     * Index of the next entry within its leaf page.
+     */
+    size_t index;
+
+    /**
+     * The key of the current entry.
+     */
+    key_t key;
+
+    /**
+     * The data value of the current entry.
+     */
+    data_t value;
+
+} tree_disk_iterator_t;
+
+/**
+ * @brief Opens a disk tree using the natural ordering of keys, and creates the file if it does not exist yet.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
+ */
+tree_disk_t* tree_disk_open (const char* path, size_t cache_pages);
+
+/**
+ * @brief Opens a disk tree with a specified comparator, which must be the same every time the file is opened.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
+ */
+tree_disk_t* tree_disk_make (const char* path, size_t cache_pages, tree_comparator_t comparator);
+
+/**
+ * @brief Writes all dirty pages and the header to the file, and then syncs the file.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
+ */
+bool tree_disk_flush (tree_disk_t* self);
+
+/**
+ * @brief Flushes a disk tree, closes its file, and frees its resources.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
+ */
+bool tree_disk_close (tree_disk_t* self);
+
+/**
+ * @brief Retrieves the number of entries in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Number of entries in the disk tree.
+ */
+size_t tree_disk_size (tree_disk_t* self);
+
+/**
+ * @brief Retrieves the value associated with a key in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found (or if the page could not be read).
+ */
+data_t tree_disk_get (tree_disk_t* self, key_t key);
+
+/**
+ * @brief Checks if a key exists in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return true if the key exists, false otherwise.
+ */
+bool tree_disk_containsKey (tree_disk_t* self, key_t key);
+
+/**
+ * @brief Retrieves the values associated with many keys in a disk tree, reading the missing pages in batches.
+ * @param self Pointer to the disk tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
+ *
+ * The lookups descend the tree together, one level at a time. On each level, the pages that are not cached
+ * are read concurrently, using io_uring if available, or else a small pool of threads calling pread().
+ * Hence, the latencies of the reads overlap, instead of adding up as they do in a loop of get().
+ */
+size_t tree_disk_getMany (tree_disk_t* self, key_t* keys, data_t* values, bool* found, size_t count);
+
+/**
+ * @brief Inserts a key-value pair into a disk tree, or replaces the value of an existing key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false if a page could not be read, written, or cached.
+ */
+bool tree_disk_put (tree_disk_t* self, key_t key, data_t value);
+
+/**
+ * @brief Removes a key from a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to remove.
+ * @return true if the key was removed, false if it was not found (or if a page could not be read).
+ */
+bool tree_disk_remove (tree_disk_t* self, key_t key);
+
+/**
+ * @brief Creates an iterator, which starts before the first entry of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Iterator over the entries in ascending order of keys.
+ */
+tree_disk_iterator_t tree_disk_iter (tree_disk_t* self);
+
+/**
+ * @brief Creates an iterator, which starts before the first entry, whose key is not less than a given key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to start at.
+ * @return Iterator over the remaining entries in ascending order of keys.
+ */
+tree_disk_iterator_t tree_disk_iter_at (tree_disk_t* self, key_t key);
+
+/**
+ * @brief Checks if there are more entries to iterate over.
+ * @param self Pointer to the iterator.
+ * @return true if there is a next entry, false otherwise.
+ */
+bool tree_disk_iter_hasNext (tree_disk_iterator_t* self);
+
+/**
+ * @brief Moves the iterator to the next entry, and copies that entry into the iterator.
+ * @param self Pointer to the iterator.
+ */
+void tree_disk_iter_next (tree_disk_iterator_t* self);
+
+/**
+ * @brief Retrieves the key of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Key of the current entry.
+ */
+key_t tree_disk_iter_key (tree_disk_iterator_t* self);
+
+/**
+ * @brief Retrieves the data value of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Data value of the current entry.
+ */
+data_t tree_disk_iter_get (tree_disk_iterator_t* self);
+
+/**
+ * @brief Retrieves the counters of the page cache of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Copy of the counters.
+ */
+tree_disk_stats_t tree_disk_stats (tree_disk_t* self);
+
+/**
+ * @brief Chooses whether the batches of page reads use io_uring or the pool of threads.
+ * @param self Pointer to the disk tree.
+ * @param enabled Whether io_uring should be used, which is the default.
+ * @return true if io_uring is used from now on, false if the pool of threads is used (io_uring may be unavailable).
+ */
+bool tree_disk_setIoUring (tree_disk_t* self, bool enabled);
+
+/**
+ * @brief Retrieves the identity of the aggregate, which is the aggregate of an empty range.
+ * @return Identity of the combine operation.
+ *
+ * Each node stores the aggregate of its subtree, which is maintained by the insertions, removals and rotations.
+ * The aggregate of an entry, the combine operation and its identity are given to the generator, and must form
+ * a monoid: the combine operation must be associative, but it need not be commutative.
+ * Values must only be changed using put(), setNode() or iter_set(), which keep the aggregates up to date;
+ * after writing values through a node directly, call reaggregate().
+ */
+int64_t tree_aggregateIdentity ();
+
+/**
+ * @brief Retrieves the aggregate of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Aggregate of the tree, which is the identity, if the tree is empty.
+ */
+int64_t tree_aggregate (tree_t* self);
+
+/**
+ * @brief Computes the aggregate of the entries, whose keys are in a half-open range, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Aggregate of the entries in the range, combined in key order.
+ */
+int64_t tree_aggregateRange (tree_t* self, key_t* lo, key_t* hi);
+
+/**
+ * @brief Recomputes the aggregates of all of the subtrees in linear time.
+ * @param self Pointer to the AVL tree.
+ */
+void tree_reaggregate (tree_t* self);
+
 #endif // tree_H
\ No newline at end of file
@@ -1,4 +1,7 @@
 #ifdef RUN_UNIT_TESTS
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include "../src/tree.h"
 #include "../src/unit_test.h"
 
@@ -58,6 +61,14 @@ static void check_tree_node (tree_t* self, tree_node_t* node)
 
     assertImplies(NULL != node->left, node->key > node->left->key);
     assertImplies(NULL != node->right, node->key < node->right->key);
+
+    const uint64_t left_hash = NULL == node->left ? 0 : node->left->hash;
+    const uint64_t right_hash = NULL == node->right ? 0 : node->right->hash;
+    assertTrue(node->hash == tree_hashEntry(node->key, node->value) + left_hash + right_hash, "key = %d", node->key);
+
+    const int64_t left_sum = NULL == node->left ? 0 : node->left->aggregate;
+    const int64_t right_sum = NULL == node->right ? 0 : node->right->aggregate;
+    assertTrue(node->aggregate == left_sum + node->value + right_sum, "key = %d", node->key);
 }
 
 static void check_tree (tree_t* self, size_t expected_size)
@@ -77,6 +88,18 @@ static void check_tree (tree_t* self, size_t expected_size)
     check_tree_node(self, self->root);
 }
 
+/**
+ * Puts the keys first, first + step, ..., first + (count - 1) * step, each one with the value key / step.
+ */
+static void put_sequence (tree_t* self, key_t first, key_t step, int count)
+{
+    for (int i = count - 1; i >= 0; i--)
+    {
+        const key_t key = first + i * step;
+        assertTrue(tree_put(self, key, key / step));
+    }
+}
+
 static void test_1 ()
 {
     tree_iterator_t iter;
@@ -390,6 +413,172 @@ static void test_anyMatch ()
     tree_free(p);
 }
 
+typedef struct
+{
+    int divisor;
+
+    size_t calls;
+
+} test_matchRange_context_t;
+
+static bool test_matchRange_predicate (tree_t* tree, tree_node_t* node, void* context)
+{
+    test_matchRange_context_t* state = (test_matchRange_context_t*) context;
+    ++state->calls;
+    return node->value % state->divisor == 0;
+}
+
+static void test_anyMatchRange ()
+{
+    tree_t* p = tree_new();
+    {
+        test_matchRange_context_t context = { 7, 0 };
+        int lo = 0;
+        int hi = 100;
+
+        // Case: Empty Tree
+        assertFalse(tree_anyMatchRange(p, &lo, &hi, &test_matchRange_predicate, &context));
+        assertTrue(tree_allMatchRange(p, &lo, &hi, &test_matchRange_predicate, &context));
+        assertTrue(tree_noneMatchRange(p, NULL, NULL, &test_matchRange_predicate, &context));
+        assertEqual(0, context.calls);
+
+        for (int i = 0; i < 1000; i++)
+        {
+            assertTrue(tree_put(p, i, i));
+        }
+
+        // The first node decides the answers.
+        assertTrue(tree_anyMatch(p, &test_matchRange_predicate, &context));
+        assertEqual(1, context.calls);
+        assertFalse(tree_noneMatch(p, &test_matchRange_predicate, &context));
+        assertEqual(2, context.calls);
+        assertFalse(tree_allMatch(p, &test_matchRange_predicate, &context));
+        assertEqual(4, context.calls);
+
+        for (lo = -5; lo <= 1005; lo += 3)
+        {
+            for (hi = lo - 10; hi <= lo + 20; hi++)
+            {
+                bool any = false;
+                bool all = true;
+
+                for (int key = lo < 0 ? 0 : lo; key < hi && key < 1000; key++)
+                {
+                    any = any || key % 7 == 0;
+                    all = all && key % 7 == 0;
+                }
+
+                // Only the nodes in the range are tested.
+                context.calls = 0;
+                assertEqual(any, tree_anyMatchRange(p, &lo, &hi, &test_matchRange_predicate, &context));
+                assertEqual(all, tree_allMatchRange(p, &lo, &hi, &test_matchRange_predicate, &context));
+                assertEqual(any == false, tree_noneMatchRange(p, &lo, &hi, &test_matchRange_predicate, &context));
+                assertTrue(context.calls <= 3 * (size_t) (hi > lo ? hi - lo : 0));
+            }
+        }
+
+        // Case: Unbounded sides
+        lo = 995;
+        hi = 2;
+        assertFalse(tree_anyMatchRange(p, &lo, NULL, &test_matchRange_predicate, &context));
+        assertTrue(tree_anyMatchRange(p, NULL, &hi, &test_matchRange_predicate, &context));
+        context.divisor = 1;
+        assertTrue(tree_allMatchRange(p, NULL, NULL, &test_matchRange_predicate, &context));
+        assertEqual(1000, tree_count(p, &test_matchRange_predicate, &context));
+    }
+    tree_free(p);
+}
+
+static void test_aggregate ()
+{
+    tree_t* p = tree_new();
+    {
+        // Case: Empty Tree
+        assertEqual(0, tree_aggregateIdentity());
+        assertEqual(0, tree_aggregate(p));
+        assertEqual(0, tree_aggregateRange(p, NULL, NULL));
+
+        // The value of each key is its square, and the aggregate is the sum of the values.
+        for (int i = 1; i <= 500; i++)
+        {
+            assertTrue(tree_put(p, (i * 7919) % 1000, ((i * 7919) % 1000) * ((i * 7919) % 1000)));
+        }
+
+        check_tree(p, 500);
+
+        int64_t total = 0;
+
+        for (int key = 0; key < 1000; key++)
+        {
+            total += tree_containsKey(p, key) ? key * key : 0;
+        }
+
+        assertEqual(total, tree_aggregate(p));
+        assertEqual(total, tree_aggregateRange(p, NULL, NULL));
+
+        for (int lo = -5; lo <= 1005; lo += 17)
+        {
+            for (int hi = -5; hi <= 1005; hi += 13)
+            {
+                int64_t expected = 0;
+
+                for (int key = lo; key < hi; key++)
+                {
+                    expected += tree_containsKey(p, key) ? key * key : 0;
+                }
+
+                assertEqual(expected, tree_aggregateRange(p, &lo, &hi));
+            }
+
+            int64_t above = 0;
+
+            for (int key = lo < 0 ? 0 : lo; key < 1000; key++)
+            {
+                above += tree_containsKey(p, key) ? key * key : 0;
+            }
+
+            assertEqual(above, tree_aggregateRange(p, &lo, NULL));
+            assertEqual(total - above, tree_aggregateRange(p, NULL, &lo));
+        }
+
+        // Case: Updates, removals and direct writes
+        tree_iterator_t iter = tree_iter(p);
+        {
+            while (tree_iter_hasNext(&iter))
+            {
+                tree_iter_next(&iter);
+                tree_iter_set(&iter, 1);
+            }
+        }
+        tree_iter_free(&iter);
+
+        assertEqual(500, tree_aggregate(p));
+        check_tree(p, 500);
+
+        for (int key = 0; key < 1000; key += 2)
+        {
+            tree_remove(p, key);
+        }
+
+        assertEqual((int64_t) tree_size(p), tree_aggregate(p));
+        check_tree(p, tree_size(p));
+
+        tree_firstNode(p)->value = 100;
+        tree_reaggregate(p);
+        tree_rehash(p);
+        assertEqual((int64_t) tree_size(p) + 99, tree_aggregate(p));
+        check_tree(p, tree_size(p));
+
+        // Case: A new node, whose value is set through the tree
+        const int64_t before = tree_aggregate(p);
+        tree_setNode(p, tree_putNode(p, 2000), 7);
+        tree_setNode(p, tree_lastNode(p), 8);
+        assertEqual(before + 8, tree_aggregate(p));
+        check_tree(p, tree_size(p));
+    }
+    tree_free(p);
+}
+
 static void test_allMatch ()
 {
     tree_t* p = tree_new();
@@ -479,6 +668,65 @@ static void test_copy ()
     }
 }
 
+static void test_split_join ()
+{
+    for (int size = 0; size < 100; size += 7)
+    {
+        for (int pivot = -1; pivot <= 2 * size + 1; pivot++)
+        {
+            tree_t* p = tree_new();
+            tree_t* left = NULL;
+            tree_t* right = NULL;
+            put_sequence(p, 0, 2, size);
+
+            assertTrue(tree_split(p, pivot, &left, &right));
+            {
+                assertEqual(0, tree_size(p));
+                assertNull(tree_rootNode(p));
+
+                const size_t below = pivot <= 0 ? 0 : (size_t) (pivot + 1) / 2 < (size_t) size ? (size_t) (pivot + 1) / 2 : (size_t) size;
+                check_tree(left, below);
+                check_tree(right, size - below);
+                assertImplies(below > 0, tree_lastNode(left)->key < pivot);
+                assertImplies(below < (size_t) size, tree_firstNode(right)->key >= pivot);
+
+                // Joining in the wrong order fails, unless either tree is empty.
+                if (below > 0 && below < (size_t) size)
+                {
+                    assertFalse(tree_join(right, left));
+                    check_tree(left, below);
+                    check_tree(right, size - below);
+                }
+
+                assertTrue(tree_join(left, right));
+                check_tree(left, size);
+                check_tree(right, 0);
+
+                for (int i = 0; i < size; i++)
+                {
+                    assertEqual(i, tree_get(left, 2 * i));
+                }
+            }
+            tree_free(left);
+            tree_free(right);
+            tree_free(p);
+        }
+    }
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_make(tree_allocator_dynamic(), tree_comparator_reverseOrder());
+    {
+        // Case: Different comparators
+        assertTrue(tree_put(p, 1, 1));
+        assertTrue(tree_put(q, 2, 2));
+        assertFalse(tree_join(p, q));
+        assertFalse(tree_join(p, p));
+        check_tree(p, 1);
+    }
+    tree_free(p);
+    tree_free(q);
+}
+
 static void test_copy_allocation_failure_special_case ()
 {
     const size_t capacity = 5;
@@ -536,6 +784,55 @@ static void test_count ()
     tree_free(p);
 }
 
+static void test_finger ()
+{
+    tree_t* p = tree_new();
+    {
+        tree_finger_t finger;
+
+        // Case: Empty Tree
+        tree_finger_init(&finger, p);
+        assertNull(tree_finger_seek(&finger, 1));
+        assertEqual(tree_defaultValue(), tree_finger_get(&finger, 1));
+
+        put_sequence(p, 1, 2, 1000);
+
+        tree_finger_init(&finger, p);
+
+        // Ascending and descending scans over present and missing keys
+        for (int key = -5; key < 2005; key++)
+        {
+            assertTrue(tree_getNode(p, key) == tree_finger_seek(&finger, key), "key = %d", key);
+        }
+
+        for (int key = 2005; key > -5; key--)
+        {
+            assertEqual(tree_get(p, key), tree_finger_get(&finger, key), "key = %d", key);
+        }
+
+        // Local steps with occasional jumps, and repeated keys
+        uint64_t state = 7;
+        int key = 1000;
+
+        for (int i = 0; i < 5000; i++)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            key = 0 == i % 100 ? (int) (state >> 33) % 2100 - 50 : key + (int) (state >> 60) - 7;
+            assertTrue(tree_getNode(p, key) == tree_finger_seek(&finger, key), "key = %d", key);
+            assertTrue(tree_getNode(p, key) == tree_finger_seek(&finger, key), "key = %d", key);
+        }
+
+        // Case: Modified Tree, with the finger initialized again
+        tree_remove(p, 1001);
+        assertTrue(tree_put(p, 1002, 7));
+        tree_finger_init(&finger, p);
+        assertNull(tree_finger_seek(&finger, 1001));
+        assertEqual(7, tree_finger_get(&finger, 1002));
+        assertEqual(tree_get(p, 999), tree_finger_get(&finger, 999));
+    }
+    tree_free(p);
+}
+
 static void test_firstNode ()
 {
     tree_t* p = tree_new();
@@ -675,6 +972,49 @@ static void test_get ()
     tree_free(p);
 }
 
+static void test_getMany ()
+{
+    tree_t* p = tree_new();
+    {
+        key_t keys[600];
+        data_t values[600];
+        bool found[600];
+
+        // Case: Empty Tree
+        keys[0] = 1;
+        keys[1] = 2;
+        assertEqual(0, tree_getMany(p, keys, values, found, 2));
+        assertFalse(found[0] || found[1]);
+        assertEqual(0, tree_getMany(p, keys, values, found, 0));
+
+        put_sequence(p, 1, 2, 500);
+
+        for (int round = 0; round < 3; round++)
+        {
+            size_t expected = 0;
+
+            for (int i = 0; i < 600; i++)
+            {
+                // Sorted (with duplicates), descending, and scrambled probes
+                keys[i] = 0 == round ? i * 5 / 3 : (1 == round ? 1200 - 2 * i : (i * 7919) % 1100);
+                expected += tree_containsKey(p, keys[i]);
+            }
+
+            assertEqual(expected, tree_getMany(p, keys, values, found, 600));
+
+            for (int i = 0; i < 600; i++)
+            {
+                assertEqual(tree_containsKey(p, keys[i]), found[i], "key = %d", keys[i]);
+                assertEqual(tree_get(p, keys[i]), values[i], "key = %d", keys[i]);
+            }
+
+            // Case: No found array
+            assertEqual(expected, tree_getMany(p, keys, values, NULL, 600));
+        }
+    }
+    tree_free(p);
+}
+
 static void test_getNode ()
 {
     tree_t* p = tree_new();
@@ -1286,6 +1626,150 @@ static void test_removeIf ()
         assertEqual(22, tree_get(p, 404));
         assertEqual(29, tree_get(p, 606));
         assertEqual(36, tree_get(p, 808));
+
+        // Case: Consecutive matches, including the first and the last nodes
+        tree_clear(p);
+
+        for (int i = 0; i < 100; i++)
+        {
+            tree_put(p, i, i < 10 || (i >= 40 && i < 60) || i >= 90 ? 7 * i : 7 * i + 1);
+        }
+
+        tree_removeIf(p, &match_predicate, &context);
+        check_tree(p, 60);
+
+        for (int i = 0; i < 100; i++)
+        {
+            assertEqual(i < 10 || (i >= 40 && i < 60) || i >= 90, tree_containsKey(p, i) == false, "key = %d", i);
+        }
+    }
+    tree_free(p);
+}
+
+static void test_removeRange_callback (tree_t* self, tree_node_t* node, void* context)
+{
+    int* keys = (int*) context;
+    assertTrue(keys[0] < node->key);
+    keys[0] = node->key;
+    keys[1]++;
+}
+
+static void test_removeRange ()
+{
+    for (int lo = -10; lo <= 210; lo += 15)
+    {
+        for (int hi = -10; hi <= 210; hi += 15)
+        {
+            tree_t* p = tree_new();
+            {
+                put_sequence(p, 0, 2, 100);
+
+                const size_t expected = tree_countRange(p, lo, true, hi, false);
+                int seen[2] = { INT32_MIN, 0 };
+
+                assertEqual(expected, tree_removeRange(p, lo, hi, &test_removeRange_callback, seen));
+                assertEqual(expected, (size_t) seen[1]);
+                check_tree(p, 100 - expected);
+
+                for (int i = 0; i < 100; i++)
+                {
+                    const bool removed = 2 * i >= lo && 2 * i < hi;
+                    assertEqual(removed, tree_containsKey(p, 2 * i) == false, "key = %d", 2 * i);
+                }
+
+                // Case: No callback
+                assertEqual(0, tree_removeRange(p, lo, hi, NULL, NULL));
+                assertEqual(tree_size(p), tree_removeRange(p, -1, 200, NULL, NULL));
+                check_tree(p, 0);
+            }
+            tree_free(p);
+        }
+    }
+}
+
+static void test_sample ()
+{
+    tree_t* p = tree_new();
+    {
+        tree_node_t* nodes[1000];
+        tree_random_t rng = tree_random_seed(42);
+
+        // Case: Empty Tree
+        assertEqual(0, tree_sample(p, 10, &rng, nodes));
+
+        for (int i = 0; i < 100; i++)
+        {
+            assertTrue(tree_put(p, i, i));
+        }
+
+        // Equal seeds produce equal samples.
+        tree_random_t first = tree_random_seed(7);
+        tree_random_t second = tree_random_seed(7);
+        assertEqual(tree_random_next(&first), tree_random_next(&second));
+
+        size_t histogram[100] = { 0 };
+
+        for (int round = 0; round < 100; round++)
+        {
+            assertEqual(1000, tree_sample(p, 1000, &rng, nodes));
+
+            for (size_t i = 0; i < 1000; i++)
+            {
+                assertNotNull(nodes[i]);
+                assertTrue(nodes[i] == tree_getNode(p, nodes[i]->key));
+                assertImplies(i > 0, nodes[i - 1]->key <= nodes[i]->key);
+                ++histogram[nodes[i]->key];
+            }
+        }
+
+        // Each node is expected 1000 times; a uniform sample is very unlikely to stray by more than 20%.
+        for (int i = 0; i < 100; i++)
+        {
+            assertTrue(histogram[i] > 800 && histogram[i] < 1200, "key = %d, count = %zu", i, histogram[i]);
+        }
+    }
+    tree_free(p);
+}
+
+static void test_quantiles ()
+{
+    tree_t* p = tree_new();
+    {
+        const double q[] = { 0.5, 0, 1, 0.25, -1, 2, 0.99, 0.5 };
+        tree_node_t* nodes[8];
+
+        // Case: Empty Tree
+        assertFalse(tree_quantiles(p, q, 8, nodes));
+
+        put_sequence(p, 0, 10, 101);
+
+        assertTrue(tree_quantiles(p, q, 8, nodes));
+        assertEqual(500, nodes[0]->key);
+        assertEqual(0, nodes[1]->key);
+        assertEqual(1000, nodes[2]->key);
+        assertEqual(250, nodes[3]->key);
+        assertEqual(0, nodes[4]->key);
+        assertEqual(1000, nodes[5]->key);
+        assertEqual(990, nodes[6]->key);
+        assertEqual(500, nodes[7]->key);
+
+        for (size_t m = 1; m <= 101; m++)
+        {
+            double fractions[101];
+            tree_node_t* found[101];
+
+            for (size_t i = 0; i < m; i++)
+            {
+                fractions[i] = (double) ((i * 37) % 101) / 100.0;
+            }
+
+            assertTrue(tree_quantiles(p, fractions, m, found));
+
+            for (size_t i = 0; i < m; i++)
+            {
+                assertTrue(found[i] == tree_nthNode(p, (i * 37) % 101));
+            }
+        }
     }
     tree_free(p);
 }
@@ -1378,6 +1862,70 @@ static void test_lowerNode ()
     tree_free(p);
 }
 
+static void test_ceilingNode ()
+{
+    tree_t* p = tree_new();
+    {
+        assertNull(tree_ceilingNode(p, 101)); // Empty tree
+
+        assertTrue(tree_put(p, 101, 100));
+        assertTrue(tree_put(p, 202, 210));
+        assertTrue(tree_put(p, 303, 320));
+
+        // The node with the lowest key that is greater than or equal to the given key
+        assertEqual(101, tree_ceilingNode(p, 0)->key);
+        assertEqual(101, tree_ceilingNode(p, 101)->key);
+        assertEqual(202, tree_ceilingNode(p, 102)->key);
+        assertEqual(202, tree_ceilingNode(p, 202)->key);
+        assertEqual(303, tree_ceilingNode(p, 303)->key);
+        assertNull(tree_ceilingNode(p, 304)); // No ceiling node should return NULL
+    }
+    tree_free(p);
+}
+
+static void test_floorNode ()
+{
+    tree_t* p = tree_new();
+    {
+        assertNull(tree_floorNode(p, 101)); // Empty tree
+
+        assertTrue(tree_put(p, 101, 100));
+        assertTrue(tree_put(p, 202, 210));
+        assertTrue(tree_put(p, 303, 320));
+
+        // The node with the greatest key that is less than or equal to the given key
+        assertEqual(303, tree_floorNode(p, 400)->key);
+        assertEqual(303, tree_floorNode(p, 303)->key);
+        assertEqual(202, tree_floorNode(p, 302)->key);
+        assertEqual(202, tree_floorNode(p, 202)->key);
+        assertEqual(101, tree_floorNode(p, 101)->key);
+        assertNull(tree_floorNode(p, 100)); // No floor node should return NULL
+    }
+    tree_free(p);
+}
+
+static void test_neighbors ()
+{
+    tree_t* p = tree_new();
+    {
+        tree_neighbors_t neighbors = tree_neighbors(p, 5);
+        assertNull(neighbors.lower);
+        assertNull(neighbors.exact);
+        assertNull(neighbors.higher);
+
+        put_sequence(p, 10, 10, 100);
+
+        for (int key = 0; key <= 1010; key++)
+        {
+            neighbors = tree_neighbors(p, key);
+            assertTrue(neighbors.lower == tree_lowerNode(p, key), "key = %d", key);
+            assertTrue(neighbors.exact == tree_getNode(p, key), "key = %d", key);
+            assertTrue(neighbors.higher == tree_higherNode(p, key), "key = %d", key);
+        }
+    }
+    tree_free(p);
+}
+
 static void test_make ()
 {
     tree_allocator_t* allocator = tree_allocator_dynamic();
@@ -1574,6 +2122,131 @@ static void test_nthNode ()
     tree_free(p);
 }
 
+
+static void test_rankOf ()
+{
+    tree_t* p = tree_new();
+    {
+        // Case: Empty Tree
+        assertEqual(SIZE_MAX, tree_rankOf(p, 5));
+        assertEqual(SIZE_MAX, tree_floorRank(p, 5));
+        assertEqual(SIZE_MAX, tree_ceilingRank(p, 5));
+
+        put_sequence(p, 10, 10, 1000);
+
+        check_tree(p, 1000);
+
+        for (int i = 1; i <= 1000; i++)
+        {
+            const size_t index = (size_t) i - 1;
+            assertEqual(index, tree_rankOf(p, 10 * i));
+            assertEqual(10 * i, tree_nthNode(p, tree_rankOf(p, 10 * i))->key);
+            assertEqual(SIZE_MAX, tree_rankOf(p, 10 * i + 5));
+
+            assertEqual(index, tree_floorRank(p, 10 * i));
+            assertEqual(index, tree_floorRank(p, 10 * i + 5));
+            assertEqual(index, tree_ceilingRank(p, 10 * i));
+            assertEqual(index, tree_ceilingRank(p, 10 * i - 5));
+        }
+
+        // Case: Keys outside of the range of the tree
+        assertEqual(SIZE_MAX, tree_floorRank(p, 5));
+        assertEqual(0, tree_ceilingRank(p, 5));
+        assertEqual(999, tree_floorRank(p, 10005));
+        assertEqual(SIZE_MAX, tree_ceilingRank(p, 10005));
+    }
+    tree_free(p);
+}
+static void test_countRange ()
+{
+    tree_t* p = tree_new();
+    {
+        // Case: Empty Tree
+        assertEqual(0, tree_countRange(p, 0, true, 100, true));
+
+        put_sequence(p, 10, 10, 100);
+
+        check_tree(p, 100);
+
+        for (int lo = 0; lo <= 1010; lo += 5)
+        {
+            for (int hi = 0; hi <= 1010; hi += 5)
+            {
+                for (int mode = 0; mode < 4; mode++)
+                {
+                    const bool lo_inclusive = 0 != (mode & 1);
+                    const bool hi_inclusive = 0 != (mode & 2);
+                    size_t expected = 0;
+
+                    for (int i = 1; i <= 100; i++)
+                    {
+                        const int key = 10 * i;
+                        const bool above_lo = key > lo || (key == lo && lo_inclusive);
+                        const bool below_hi = key < hi || (key == hi && hi_inclusive);
+                        expected += above_lo && below_hi;
+                    }
+
+                    assertEqual(expected, tree_countRange(p, lo, lo_inclusive, hi, hi_inclusive));
+                }
+            }
+        }
+
+        // Case: Bounds in reverse order
+        assertEqual(0, tree_countRange(p, 500, true, 100, true));
+    }
+    tree_free(p);
+}
+static void test_range ()
+{
+    tree_t* p = tree_new();
+    {
+        tree_range_t range;
+
+        // Case: Empty Tree
+        tree_range_seek(&range, p, 0, true, 100, true);
+        assertFalse(tree_range_hasNext(&range));
+        assertNull(tree_range_node(&range));
+        assertEqual(tree_defaultKey(), tree_range_key(&range));
+        assertEqual(tree_defaultValue(), tree_range_get(&range));
+
+        put_sequence(p, 10, 10, 100);
+
+        check_tree(p, 100);
+
+        for (int lo = 0; lo <= 1010; lo += 5)
+        {
+            for (int hi = lo - 20; hi <= 1010; hi += 15)
+            {
+                for (int mode = 0; mode < 4; mode++)
+                {
+                    const bool lo_inclusive = 0 != (mode & 1);
+                    const bool hi_inclusive = 0 != (mode & 2);
+                    int expected = 10 * (lo / 10) + (lo % 10 == 0 && lo_inclusive ? 0 : 10);
+
+                    if (expected < 10)
+                    {
+                        expected = 10;
+                    }
+
+                    tree_range_seek(&range, p, lo, lo_inclusive, hi, hi_inclusive);
+
+                    while (tree_range_hasNext(&range))
+                    {
+                        tree_range_next(&range);
+                        assertEqual(expected, tree_range_key(&range));
+                        assertEqual(expected / 10, tree_range_get(&range));
+                        assertEqual(expected, tree_range_node(&range)->key);
+                        expected += 10;
+                    }
+
+                    // The cursor stops at the first key outside of the range.
+                    assertTrue(expected > 1000 || expected > hi || (expected == hi && false == hi_inclusive));
+                }
+            }
+        }
+    }
+    tree_free(p);
+}
 static void test_push ()
 {
     tree_t* p = tree_new();
@@ -1824,6 +2497,48 @@ static void test_remove ()
 
         tree_remove(p, 303);
         check_tree(p, 0);
+
+        // Case: The successor of the removed node is its right child
+        assertTrue(tree_put(p, 200, 1));
+        assertTrue(tree_put(p, 100, 2));
+        assertTrue(tree_put(p, 300, 3));
+        assertTrue(tree_put(p, 400, 4));
+
+        tree_remove(p, 200);
+        check_tree(p, 3);
+        assertEqual(300, tree_rootNode(p)->key);
+        assertEqual(4, tree_get(p, 400));
+
+        // Case: The successor of the removed node is deeper in its right subtree, and has a right child
+        assertTrue(tree_put(p, 50, 5));
+        assertTrue(tree_put(p, 350, 6));
+        assertTrue(tree_put(p, 500, 7));
+        assertTrue(tree_put(p, 375, 8));
+
+        tree_remove(p, 300);
+        check_tree(p, 6);
+        assertFalse(tree_containsKey(p, 300));
+        assertEqual(8, tree_get(p, 375));
+
+        // Case: Interleaved puts and removes, which rebalance the tree at every level
+        uint64_t state = 11;
+
+        for (int i = 0; i < 20000; i++)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            const key_t key = (key_t) (state >> 33) % 2000;
+
+            if (0 == (state >> 62))
+            {
+                tree_remove(p, key);
+            }
+            else
+            {
+                tree_put(p, key, key);
+            }
+        }
+
+        check_tree(p, tree_size(p));
     }
     tree_free(p);
 
@@ -1842,6 +2557,25 @@ static void test_rootNode ()
     tree_free(p);
 }
 
+static void test_setNode ()
+{
+    tree_t* p = tree_new();
+    {
+        put_sequence(p, 10, 10, 100);
+        const int64_t before = tree_aggregate(p);
+
+        tree_node_t* node = tree_putNode(p, 505);
+        tree_setNode(p, node, 1000);
+        assertEqual(1000, tree_get(p, 505));
+        assertEqual(before + 1000, tree_aggregate(p));
+
+        tree_setNode(p, tree_getNode(p, 500), 0);
+        assertEqual(before + 1000 - 50, tree_aggregate(p));
+        check_tree(p, 101);
+    }
+    tree_free(p);
+}
+
 static void test_size ()
 {
     tree_t* p = tree_new();
@@ -2662,6 +3396,19 @@ static void test_retainAll ()
 
         assertEqual(2, tree_size(p1)); // Only 101 and 202 should remain
         assertFalse(tree_containsKey(p1, 303)); // 303 should be removed
+
+        // Case: Consecutive removals
+        for (int i = 0; i < 100; i++)
+        {
+            tree_put(p1, i, i);
+        }
+
+        tree_put(p2, 50, 0);
+        tree_put(p2, 51, 0);
+        tree_retainAll(p1, p2);
+        check_tree(p1, 4);
+        assertTrue(tree_containsKey(p1, 50) && tree_containsKey(p1, 51));
+        assertTrue(tree_containsKey(p1, 101) && tree_containsKey(p1, 202));
     }
     tree_free(p1);
     tree_free(p2);
@@ -2685,36 +3432,1851 @@ static void test_noneMatch ()
     tree_free(p);
 }
 
+static void test_putArrays ()
+{
+    tree_t* p = tree_new();
+    {
+        // Case: nothing to insert
+        assertTrue(tree_putArrays(p, NULL, NULL, 0));
+        check_tree(p, 0);
+
+        // Case: empty tree, unsorted keys, duplicate keys (last one wins)
+        key_t keys1[] = { 505, 101, 909, 303, 101, 707, 202, 505 };
+        data_t values1[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        assertTrue(tree_putArrays(p, keys1, values1, 8));
+        check_tree(p, 6);
+        assertEqual(5, tree_get(p, 101));
+        assertEqual(7, tree_get(p, 202));
+        assertEqual(4, tree_get(p, 303));
+        assertEqual(8, tree_get(p, 505));
+        assertEqual(6, tree_get(p, 707));
+        assertEqual(3, tree_get(p, 909));
+
+        // Case: non-empty tree, where some of the keys are already present
+        tree_node_t* node = tree_getNode(p, 303);
+        key_t keys2[] = { 404, 303, -606 };
+        data_t values2[] = { 10, 20, 30 };
+        assertTrue(tree_putArrays(p, keys2, values2, 3));
+        check_tree(p, 8);
+        assertTrue(node == tree_getNode(p, 303));
+        assertEqual(20, tree_get(p, 303));
+        assertEqual(10, tree_get(p, 404));
+        assertEqual(30, tree_get(p, -606));
+        assertEqual(-606, tree_firstNode(p)->key);
+        assertEqual(909, tree_lastNode(p)->key);
+    }
+    tree_free(p);
+
+    // Case: reverse ordering, which cannot use the radix sort
+    p = tree_make(tree_allocator_dynamic(), tree_comparator_reverseOrder());
+    {
+        key_t keys[] = { 2, 3, 1, 3 };
+        data_t values[] = { 20, 30, 10, 31 };
+        assertTrue(tree_putArrays(p, keys, values, 4));
+        assertEqual(3, tree_size(p));
+        assertEqual(3, tree_firstNode(p)->key);
+        assertEqual(31, tree_firstNode(p)->value);
+        assertEqual(1, tree_lastNode(p)->key);
+    }
+    tree_free(p);
+
+    // Case: allocation failure leaves the tree unchanged
+    tree_allocator_t* allocator = tree_allocator_slab(4);
+    p = tree_make(allocator, tree_comparator_naturalOrder());
+    {
+        assertTrue(tree_put(p, 1, 10));
+        key_t keys[] = { 2, 3, 4, 5 };
+        data_t values[] = { 20, 30, 40, 50 };
+        assertFalse(tree_putArrays(p, keys, values, 4));
+        check_tree(p, 1);
+        assertEqual(10, tree_get(p, 1));
+        assertTrue(tree_putArrays(p, keys, values, 3));
+        check_tree(p, 4);
+    }
+    tree_free(p);
+    tree_allocator_free(allocator);
+}
+
+static void test_putArraysParallel ()
+{
+    const size_t count = 200000;
+    key_t* keys = calloc(count, sizeof(key_t));
+    data_t* values = calloc(count, sizeof(data_t));
+
+    // Scatter the keys, including negative keys and a duplicate of every key.
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = (key_t) ((i * 7919) % (count / 2)) - (key_t) (count / 4);
+        values[i] = (data_t) i;
+    }
+
+    tree_t* p = tree_new();
+    {
+        assertTrue(tree_putArraysParallel(p, keys, values, count, 4));
+        check_tree(p, count / 2);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            // The second half of the input repeats the keys of the first half.
+            assertEqual(i < count / 2 ? (data_t) (i + count / 2) : (data_t) i, tree_get(p, keys[i]));
+        }
+
+        key_t previous = tree_firstNode(p)->key;
+        for (size_t i = 1; i < count / 2; i++)
+        {
+            assertLess(previous, tree_nthNode(p, i)->key);
+            previous = tree_nthNode(p, i)->key;
+        }
+    }
+    tree_free(p);
+
+    p = tree_make(tree_allocator_dynamic(), tree_comparator_reverseOrder());
+    {
+        assertTrue(tree_putArraysParallel(p, keys, values, count, 3));
+        assertEqual(count / 2, tree_size(p));
+        assertEqual((key_t) (count / 4) - 1, tree_firstNode(p)->key);
+        assertEqual(-(key_t) (count / 4), tree_lastNode(p)->key);
+    }
+    tree_free(p);
+
+    free(keys);
+    free(values);
+}
+
+static bool same_entry_predicate (tree_node_t* nodeX, tree_node_t* nodeY, void* context)
+{
+    return (nodeX->key == nodeY->key) && (nodeX->value == nodeY->value);
+}
+
+static void test_applyBatch ()
+{
+    tree_t* p = tree_new();
+    {
+        // Case: empty batch
+        assertTrue(tree_applyBatch(p, NULL, 0));
+        check_tree(p, 0);
+
+        // Case: sorted batch into an empty tree, including a remove of a missing key
+        tree_op_t ops1[] = {
+            { false, 101, 100 },
+            { false, 202, 200 },
+            { true,  250, 0   },
+            { false, 303, 300 },
+            { false, 404, 400 },
+        };
+        assertTrue(tree_applyBatch(p, ops1, 5));
+        check_tree(p, 4);
+        assertEqual(100, tree_get(p, 101));
+        assertEqual(400, tree_get(p, 404));
+        assertFalse(tree_containsKey(p, 250));
+
+        // Case: unsorted batch with duplicate keys, where the last operation wins
+        tree_op_t ops2[] = {
+            { false, 505, 500 },
+            { true,  101, 0   },
+            { false, 202, 210 },
+            { false, 101, 110 },
+            { true,  505, 0   },
+            { true,  404, 0   },
+            { false, 606, 600 },
+        };
+        assertTrue(tree_applyBatch(p, ops2, 7));
+        check_tree(p, 4);
+        assertEqual(110, tree_get(p, 101));
+        assertEqual(210, tree_get(p, 202));
+        assertEqual(300, tree_get(p, 303));
+        assertEqual(600, tree_get(p, 606));
+        assertFalse(tree_containsKey(p, 404));
+        assertFalse(tree_containsKey(p, 505));
+
+        // The given operations were not reordered.
+        assertEqual(505, ops2[0].key);
+        assertEqual(606, ops2[6].key);
+
+        // Case: remove everything
+        tree_op_t ops3[] = {
+            { true, 101, 0 },
+            { true, 202, 0 },
+            { true, 303, 0 },
+            { true, 606, 0 },
+        };
+        assertTrue(tree_applyBatch(p, ops3, 4));
+        check_tree(p, 0);
+    }
+    tree_free(p);
+}
+
+static void test_applyBatch_allocation_failure ()
+{
+    tree_allocator_t* allocator = tree_allocator_slab(5);
+    {
+        tree_t* p = tree_make(allocator, tree_comparator_naturalOrder());
+        {
+            tree_put(p, 101, 100);
+            tree_put(p, 202, 200);
+            tree_put(p, 303, 300);
+
+            // The batch puts four keys, which needs four nodes up front, but the allocator has only two left.
+            tree_op_t ops1[] = {
+                { true,  101, 0   },
+                { false, 202, 210 },
+                { false, 404, 400 },
+                { false, 505, 500 },
+                { false, 606, 600 },
+            };
+            assertFalse(tree_applyBatch(p, ops1, 5));
+            check_tree(p, 3);
+            assertEqual(100, tree_get(p, 101));
+            assertEqual(200, tree_get(p, 202));
+            assertFalse(tree_containsKey(p, 404));
+
+            // The node of the overwrite is released again, which leaves room for the next batch.
+            tree_op_t ops2[] = {
+                { false, 202, 210 },
+                { false, 404, 400 },
+            };
+            assertTrue(tree_applyBatch(p, ops2, 2));
+            check_tree(p, 4);
+            assertEqual(210, tree_get(p, 202));
+            assertEqual(400, tree_get(p, 404));
+            assertTrue(tree_put(p, 505, 500));
+        }
+        tree_free(p);
+    }
+    tree_allocator_free(allocator);
+}
+
+static void test_applyBatch_random ()
+{
+    const size_t batch_size = 300;
+    tree_op_t ops[batch_size];
+    uint32_t seed = 12345;
+
+    tree_t* p = tree_new();
+    tree_t* expected = tree_new();
+    {
+        for (int round = 0; round < 200; round++)
+        {
+            for (size_t i = 0; i < batch_size; i++)
+            {
+                seed = seed * 1103515245 + 12345;
+                ops[i].remove = ((seed >> 16) % 3) == 0;
+                ops[i].key = (key_t) ((seed >> 4) % 2000);
+                ops[i].value = round;
+            }
+
+            // Sort half of the batches up front.
+            for (size_t i = 1; round % 2 == 0 && i < batch_size; i++)
+            {
+                for (size_t j = i; j > 0 && ops[j - 1].key > ops[j].key; j--)
+                {
+                    tree_op_t swap = ops[j];
+                    ops[j] = ops[j - 1];
+                    ops[j - 1] = swap;
+                }
+            }
+
+            for (size_t i = 0; i < batch_size; i++)
+            {
+                if (ops[i].remove)
+                {
+                    tree_remove(expected, ops[i].key);
+                }
+                else
+                {
+                    tree_put(expected, ops[i].key, ops[i].value);
+                }
+            }
+
+            assertTrue(tree_applyBatch(p, ops, batch_size));
+            check_tree(p, tree_size(expected));
+            assertTrue(tree_isEqual(p, expected, &same_entry_predicate, NULL));
+        }
+    }
+    tree_free(p);
+    tree_free(expected);
+}
+
+static void test_multiqueue ()
+{
+    key_t key = 0;
+    data_t value = 0;
+
+    // Case: a single queue is an exact priority queue
+    tree_multiqueue_t* q = tree_multiqueue_new(1);
+    {
+        assertFalse(tree_multiqueue_popFirst(q, &key, &value));
+        assertEqual(0, tree_multiqueue_size(q));
+
+        assertTrue(tree_multiqueue_put(q, 303, 30));
+        assertTrue(tree_multiqueue_put(q, 101, 10));
+        assertTrue(tree_multiqueue_put(q, 202, 20));
+        assertTrue(tree_multiqueue_put(q, 202, 21));
+        assertEqual(3, tree_multiqueue_size(q));
+
+        assertTrue(tree_multiqueue_popFirst(q, &key, &value));
+        assertEqual(101, key);
+        assertEqual(10, value);
+        assertTrue(tree_multiqueue_popFirst(q, &key, &value));
+        assertEqual(202, key);
+        assertEqual(21, value);
+        assertTrue(tree_multiqueue_popFirst(q, NULL, &value));
+        assertEqual(30, value);
+        assertFalse(tree_multiqueue_popFirst(q, &key, &value));
+        assertEqual(0, tree_multiqueue_size(q));
+    }
+    tree_multiqueue_free(q);
+
+    // Case: several queues return every element exactly once
+    q = tree_multiqueue_new(8);
+    {
+        bool seen[1000] = { false };
+
+        for (int i = 0; i < 1000; i++)
+        {
+            assertTrue(tree_multiqueue_push(q, i * 10));
+        }
+
+        assertEqual(1000, tree_multiqueue_size(q));
+
+        for (int i = 0; i < 1000; i++)
+        {
+            assertTrue(tree_multiqueue_popFirst(q, &key, &value));
+            assertEqual(key * 10, value);
+            assertFalse(seen[key]);
+            seen[key] = true;
+        }
+
+        assertFalse(tree_multiqueue_popFirst(q, &key, &value));
+    }
+    tree_multiqueue_free(q);
+}
+
+typedef struct
+{
+    tree_multiqueue_t* queue;
+
+    int count;
+
+    atomic_int* seen;
+
+} multiqueue_consumer_t;
+
+static void* multiqueue_consumer (void* argument)
+{
+    multiqueue_consumer_t* consumer = (multiqueue_consumer_t*) argument;
+    key_t key = 0;
+    data_t value = 0;
+
+    for (int i = 0; i < consumer->count; i++)
+    {
+        while (tree_multiqueue_popFirst(consumer->queue, &key, &value) == false)
+        {
+            // Spin, until the producer catches up.
+        }
+
+        atomic_fetch_add(&consumer->seen[key], 1);
+    }
+
+    return NULL;
+}
+
+static void test_multiqueue_concurrent ()
+{
+    enum { CONSUMERS = 4, PER_CONSUMER = 5000, TOTAL = CONSUMERS * PER_CONSUMER };
+    static atomic_int seen[TOTAL];
+    pthread_t threads[CONSUMERS];
+    multiqueue_consumer_t consumers[CONSUMERS];
+
+    tree_multiqueue_t* q = tree_multiqueue_new(2 * CONSUMERS);
+    {
+        for (int i = 0; i < TOTAL; i++)
+        {
+            atomic_init(&seen[i], 0);
+        }
+
+        for (int i = 0; i < CONSUMERS; i++)
+        {
+            consumers[i].queue = q;
+            consumers[i].count = PER_CONSUMER;
+            consumers[i].seen = seen;
+            assertEqual(0, pthread_create(&threads[i], NULL, &multiqueue_consumer, &consumers[i]));
+        }
+
+        // Single producer, multiple consumers.
+        for (int i = 0; i < TOTAL; i++)
+        {
+            assertTrue(tree_multiqueue_put(q, i, i));
+        }
+
+        for (int i = 0; i < CONSUMERS; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        for (int i = 0; i < TOTAL; i++)
+        {
+            assertEqual(1, atomic_load(&seen[i]));
+        }
+
+        assertEqual(0, tree_multiqueue_size(q));
+    }
+    tree_multiqueue_free(q);
+}
+
+static void test_writebehind ()
+{
+    data_t value = 0;
+
+    tree_t* p = tree_new();
+    tree_writebehind_t* w = tree_writebehind_new(p, 5, 4, 1000000);
+    {
+        assertTrue(w != NULL);
+
+        for (int i = 0; i < 100; i++)
+        {
+            tree_writebehind_put(w, i, i * 10);
+        }
+
+        tree_writebehind_remove(w, 50);
+        tree_writebehind_put(w, 7, 700);
+        tree_writebehind_flush(w);
+
+        // Read-your-writes, after the flush.
+        assertEqual(99, tree_size(p));
+        assertTrue(tree_writebehind_get(w, 7, &value));
+        assertEqual(700, value);
+        assertTrue(tree_writebehind_get(w, 99, &value));
+        assertEqual(990, value);
+        assertFalse(tree_writebehind_get(w, 50, &value));
+
+        tree_t* q = tree_writebehind_acquire(w);
+        assertTrue(q == p);
+        check_tree(q, 99);
+        tree_writebehind_release(w);
+
+        const tree_writebehind_stats_t stats = tree_writebehind_stats(w);
+        assertEqual(102, stats.enqueued);
+        assertEqual(102, stats.applied);
+        assertEqual(0, stats.depth);
+        assertEqual(0, stats.failures);
+        assertTrue(stats.batches >= 102 / 4);
+        assertTrue(stats.max_depth <= 8);
+
+        // Pending operations are applied when the queue is freed.
+        tree_writebehind_put(w, 1000, 1);
+        tree_writebehind_remove(w, 0);
+    }
+    tree_writebehind_free(w);
+
+    assertEqual(99, tree_size(p));
+    assertTrue(tree_containsKey(p, 1000));
+    assertFalse(tree_containsKey(p, 0));
+    tree_free(p);
+}
+
+typedef struct
+{
+    tree_writebehind_t* queue;
+
+    int first;
+
+    int count;
+
+} writebehind_producer_t;
+
+static void* writebehind_producer (void* argument)
+{
+    writebehind_producer_t* producer = (writebehind_producer_t*) argument;
+
+    for (int i = producer->first; i < producer->first + producer->count; i++)
+    {
+        tree_writebehind_put(producer->queue, i, i);
+
+        if (i % 3 == 0)
+        {
+            tree_writebehind_remove(producer->queue, i);
+        }
+    }
+
+    tree_writebehind_flush(producer->queue);
+    return NULL;
+}
+
+static void test_writebehind_concurrent ()
+{
+    enum { PRODUCERS = 4, PER_PRODUCER = 5000, TOTAL = PRODUCERS * PER_PRODUCER };
+    pthread_t threads[PRODUCERS];
+    writebehind_producer_t producers[PRODUCERS];
+
+    tree_t* p = tree_new();
+    tree_writebehind_t* w = tree_writebehind_new(p, 64, 256, 100000);
+    {
+        for (int i = 0; i < PRODUCERS; i++)
+        {
+            producers[i].queue = w;
+            producers[i].first = i * PER_PRODUCER;
+            producers[i].count = PER_PRODUCER;
+            assertEqual(0, pthread_create(&threads[i], NULL, &writebehind_producer, &producers[i]));
+        }
+
+        for (int i = 0; i < PRODUCERS; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        tree_t* q = tree_writebehind_acquire(w);
+        check_tree(q, TOTAL - (TOTAL + 2) / 3);
+
+        for (int i = 0; i < TOTAL; i++)
+        {
+            assertEqual(i % 3 != 0, tree_containsKey(q, i));
+        }
+
+        tree_writebehind_release(w);
+
+        const tree_writebehind_stats_t stats = tree_writebehind_stats(w);
+        assertEqual(stats.enqueued, stats.applied);
+        assertTrue(stats.max_depth <= 64);
+    }
+    tree_writebehind_free(w);
+    tree_free(p);
+}
+
+static void test_concurrent ()
+{
+    tree_t* p = tree_new();
+    tree_concurrent_t* c = tree_concurrent_new();
+    {
+        assertEqual(0, tree_concurrent_size(c));
+        assertFalse(tree_concurrent_containsKey(c, 1));
+        assertEqual(tree_defaultValue(), tree_concurrent_get(c, 1));
+
+        // Compare against the sequential tree, using random puts and removes.
+        uint64_t state = 7;
+
+        for (int i = 0; i < 20000; i++)
+        {
+            state = state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+            const key_t key = (key_t) ((state >> 33) % 1000);
+
+            if ((state >> 20) % 3 == 0)
+            {
+                tree_remove(p, key);
+                tree_concurrent_remove(c, key);
+            }
+            else
+            {
+                assertTrue(tree_put(p, key, i));
+                assertTrue(tree_concurrent_put(c, key, i));
+            }
+        }
+
+        assertEqual(tree_size(p), tree_concurrent_size(c));
+
+        for (key_t key = 0; key < 1000; key++)
+        {
+            assertEqual(tree_containsKey(p, key), tree_concurrent_containsKey(c, key));
+            assertEqual(tree_get(p, key), tree_concurrent_get(c, key));
+        }
+
+        assertTrue(tree_concurrent_collect(c) > 0);
+        assertEqual(0, tree_concurrent_collect(c));
+
+        // Ascending insertions must be rebalanced.
+        for (int i = 1000; i < 100000; i++)
+        {
+            assertTrue(tree_concurrent_put(c, i, i));
+        }
+
+        assertEqual(tree_size(p) + 99000, tree_concurrent_size(c));
+        assertEqual(99999, tree_concurrent_get(c, 99999));
+    }
+    tree_concurrent_free(c);
+    tree_free(p);
+}
+
+typedef struct
+{
+    tree_concurrent_t* tree;
+
+    int first;
+
+    int count;
+
+} concurrent_worker_t;
+
+static void* concurrent_worker (void* argument)
+{
+    concurrent_worker_t* worker = (concurrent_worker_t*) argument;
+
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = worker->first; i < worker->first + worker->count; i++)
+        {
+            tree_concurrent_put(worker->tree, i, i);
+        }
+
+        for (int i = worker->first; i < worker->first + worker->count; i++)
+        {
+            if (i % 3 == 0 || round < 2)
+            {
+                tree_concurrent_remove(worker->tree, i);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void test_concurrent_threads ()
+{
+    enum { WORKERS = 4, PER_WORKER = 5000, TOTAL = WORKERS * PER_WORKER };
+    pthread_t threads[WORKERS];
+    concurrent_worker_t workers[WORKERS];
+
+    tree_concurrent_t* c = tree_concurrent_new();
+    {
+        // Interleave the key ranges, so that the workers contend for the same subtrees.
+        for (int i = 0; i < WORKERS; i++)
+        {
+            workers[i].tree = c;
+            workers[i].first = i * (PER_WORKER / 2);
+            workers[i].count = PER_WORKER;
+            assertEqual(0, pthread_create(&threads[i], NULL, &concurrent_worker, &workers[i]));
+        }
+
+        for (int i = 0; i < WORKERS; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        // Overlapping ranges may be removed by one worker, after another put them back in its final round.
+        const int last = (WORKERS - 1) * (PER_WORKER / 2) + PER_WORKER;
+        size_t count = 0;
+
+        for (int i = 0; i < last; i++)
+        {
+            if (i % 3 == 0)
+            {
+                assertFalse(tree_concurrent_containsKey(c, i));
+            }
+            else if (i < PER_WORKER / 2 || i >= last - PER_WORKER / 2)
+            {
+                // Only one worker ever touched these keys.
+                assertTrue(tree_concurrent_containsKey(c, i));
+            }
+
+            if (tree_concurrent_containsKey(c, i))
+            {
+                assertEqual(i, tree_concurrent_get(c, i));
+                ++count;
+            }
+        }
+
+        assertEqual(count, tree_concurrent_size(c));
+    }
+    tree_concurrent_free(c);
+}
+
+static void test_save_load ()
+{
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    tree_t* r = tree_new();
+    {
+        for (int i = 0; i < 100000; i++)
+        {
+            tree_put(p, i * 7 % 100003, i);
+        }
+
+        FILE* file = tmpfile();
+        const int fd = fileno(file);
+        assertTrue(tree_save(p, fd));
+
+        // Load into an empty tree.
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_load(q, fd));
+        check_tree(q, 100000);
+
+        for (int i = 0; i < 100000; i++)
+        {
+            assertEqual(i, tree_get(q, i * 7 % 100003));
+        }
+
+        // Load into a non-empty tree, which merges the snapshot into the tree.
+        tree_put(r, -1, 1);
+        tree_put(r, 7, 1);
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_load(r, fd));
+        check_tree(r, 100001);
+        assertEqual(1, tree_get(r, -1));
+        assertEqual(tree_get(p, 7), tree_get(r, 7));
+
+        // A corrupted snapshot is rejected and leaves the tree unchanged.
+        const char junk = 'x';
+        assertEqual(1, pwrite(fd, &junk, 1, 1000));
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertFalse(tree_load(r, fd));
+        check_tree(r, 100001);
+
+        // A truncated snapshot is rejected as well.
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_save(p, fd));
+        assertEqual(0, ftruncate(fd, 5000));
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertFalse(tree_load(r, fd));
+        check_tree(r, 100001);
+
+        // A count far beyond the data (at offset 24 of the header) fails on the data, not on allocating for the count.
+        const uint64_t count = UINT64_C(1) << 40;
+        assertEqual(sizeof(count), pwrite(fd, &count, sizeof(count), 24));
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertFalse(tree_load(r, fd));
+        check_tree(r, 100001);
+
+        fclose(file);
+    }
+    tree_free(p);
+    tree_free(q);
+    tree_free(r);
+}
+
+static void test_save_load_empty ()
+{
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        FILE* file = tmpfile();
+        const int fd = fileno(file);
+        assertTrue(tree_save(p, fd));
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_load(q, fd));
+        check_tree(q, 0);
+
+        // End of file, where the header should be.
+        assertFalse(tree_load(q, fd));
+        fclose(file);
+    }
+    tree_free(p);
+    tree_free(q);
+}
+
+static void test_image ()
+{
+    tree_t* p = tree_new();
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            tree_put(p, i * 2, i);
+        }
+
+        FILE* file = tmpfile();
+        const int fd = fileno(file);
+        assertTrue(tree_saveImage(p, fd));
+
+        tree_image_t* image = tree_image_open(fd, false);
+        assertTrue(image != NULL);
+        assertTrue(tree_image_verify(image));
+        assertEqual(10000, tree_image_size(image));
+
+        for (int i = 0; i < 10000; i++)
+        {
+            assertEqual(i, tree_image_get(image, i * 2));
+            assertTrue(tree_image_getNode(image, i * 2 + 1) == NULL);
+            assertEqual(tree_higherNode(p, i * 2 - 1)->key, tree_image_higherNode(image, i * 2 - 1)->key);
+            assertEqual(tree_nthNode(p, i)->key, tree_image_nthNode(image, i)->key);
+        }
+
+        assertTrue(tree_image_higherNode(image, 19998) == NULL);
+        assertTrue(tree_image_nthNode(image, 10000) == NULL);
+
+        // Iteration visits the nodes in ascending order.
+        int count = 0;
+
+        for (tree_image_node_t* node = tree_image_firstNode(image); node != NULL; node = tree_image_nextNode(image, node))
+        {
+            assertEqual(count * 2, node->key);
+            ++count;
+        }
+
+        assertEqual(10000, count);
+        tree_image_close(image);
+
+        // Changes to a copy-on-write mapping are private.
+        image = tree_image_open(fd, true);
+        assertTrue(image != NULL);
+        tree_image_getNode(image, 42)->value = -1;
+        assertEqual(-1, tree_image_get(image, 42));
+        tree_image_close(image);
+
+        image = tree_image_open(fd, false);
+        assertEqual(21, tree_image_get(image, 42));
+        tree_image_close(image);
+
+        // Corruption is detected by verification, but not by opening.
+        const int junk = 12345;
+        assertEqual(sizeof(junk), pwrite(fd, &junk, sizeof(junk), 1000));
+        image = tree_image_open(fd, false);
+        assertTrue(image != NULL);
+        assertFalse(tree_image_verify(image));
+        tree_image_close(image);
+
+        // A snapshot is not an image.
+        assertEqual(0, ftruncate(fd, 0));
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_save(p, fd));
+        assertTrue(tree_image_open(fd, false) == NULL);
+
+        fclose(file);
+    }
+    tree_free(p);
+}
+
+static void test_image_corrupt_links ()
+{
+    tree_t* p = tree_new();
+    {
+        // Inserted in this order, the middle node becomes the root.
+        tree_put(p, 2, 12);
+        tree_put(p, 0, 10);
+        tree_put(p, 4, 14);
+
+        FILE* file = tmpfile();
+        const int fd = fileno(file);
+        assertTrue(tree_saveImage(p, fd));
+
+        // The left link of the root points past the nodes, and its right link points back to itself.
+        tree_image_t* image = tree_image_open(fd, true);
+        assertTrue(image != NULL);
+        tree_image_nthNode(image, 1)->left = 1000000;
+        tree_image_nthNode(image, 1)->right = 2;
+
+        assertEqual(12, tree_image_get(image, 2));
+        assertTrue(tree_image_getNode(image, 0) == NULL);
+        assertTrue(tree_image_getNode(image, 4) == NULL);
+        assertEqual(2, tree_image_higherNode(image, 1)->key);
+        assertTrue(tree_image_higherNode(image, 3) == NULL);
+        tree_image_close(image);
+        fclose(file);
+    }
+    tree_free(p);
+}
+
+static void test_image_empty ()
+{
+    tree_t* p = tree_new();
+    {
+        FILE* file = tmpfile();
+        const int fd = fileno(file);
+        assertTrue(tree_image_open(fd, false) == NULL);
+        assertTrue(tree_saveImage(p, fd));
+
+        tree_image_t* image = tree_image_open(fd, false);
+        assertTrue(image != NULL);
+        assertTrue(tree_image_verify(image));
+        assertEqual(0, tree_image_size(image));
+        assertTrue(tree_image_firstNode(image) == NULL);
+        assertTrue(tree_image_getNode(image, 1) == NULL);
+        assertTrue(tree_image_higherNode(image, 1) == NULL);
+        tree_image_close(image);
+        fclose(file);
+    }
+    tree_free(p);
+}
+
+/**
+ * Checks that two trees contain the same entries.
+ */
+static void check_same_entries (tree_t* p, tree_t* q)
+{
+    assertEqual(tree_size(p), tree_size(q));
+
+    for (tree_node_t* node = tree_firstNode(p); node != NULL; node = tree_higherNode(p, node->key))
+    {
+        assertTrue(tree_containsKey(q, node->key));
+        assertEqual(node->value, tree_get(q, node->key));
+    }
+}
+
+/**
+ * Obtains the length of a file in bytes.
+ */
+static long wal_file_length (const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fclose(file);
+    return length;
+}
+
+static void test_wal ()
+{
+    char directory[] = "/tmp/test_wal_XXXXXX";
+    char snapshot[64];
+    char log[64];
+    assertTrue(mkdtemp(directory) != NULL);
+    snprintf(snapshot, sizeof(snapshot), "%s/tree.snapshot", directory);
+    snprintf(log, sizeof(log), "%s/tree.log", directory);
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    tree_t* r = tree_new();
+    {
+        // A new log recovers nothing.
+        tree_wal_t* wal = tree_wal_open(p, snapshot, log, 16, 100000);
+        assertTrue(wal != NULL);
+        assertEqual(0, tree_size(p));
+
+        uint64_t sequence = 0;
+
+        for (int i = 0; i < 1000; i++)
+        {
+            sequence = tree_wal_put(wal, i, i * 10);
+            assertEqual((uint64_t) i + 1, sequence);
+        }
+
+        for (int i = 0; i < 1000; i += 3)
+        {
+            sequence = tree_wal_remove(wal, i);
+        }
+
+        tree_wal_put(wal, 1, -1);
+        assertTrue(tree_wal_sync(wal, sequence));
+        assertTrue(tree_wal_close(wal));
+        check_tree(p, 666);
+
+        // Recovery replays the log.
+        wal = tree_wal_open(q, snapshot, log, 16, 100000);
+        assertTrue(wal != NULL);
+        check_tree(q, 666);
+        check_same_entries(p, q);
+
+        // Compaction moves the records into the snapshot.
+        const long length = wal_file_length(log);
+        assertTrue(tree_wal_compact(wal));
+        assertTrue(wal_file_length(log) < length);
+
+        // Sequence numbers continue after compaction.
+        assertEqual(sequence + 2, tree_wal_put(wal, 5000, 5000));
+        assertTrue(tree_wal_remove(wal, 2) > 0);
+        assertTrue(tree_wal_close(wal));
+
+        // Recovery loads the snapshot, and then replays the rest of the log.
+        wal = tree_wal_open(r, snapshot, log, 16, 100000);
+        assertTrue(wal != NULL);
+        check_same_entries(q, r);
+        assertEqual(sequence + 4, tree_wal_put(wal, 6000, 6000));
+        assertTrue(tree_wal_close(wal));
+
+        // A torn record at the end of the log is discarded.
+        FILE* file = fopen(log, "ab");
+        fwrite("torn", 1, 4, file);
+        fclose(file);
+
+        tree_clear(r);
+        wal = tree_wal_open(r, snapshot, log, 16, 100000);
+        assertTrue(wal != NULL);
+        assertEqual(6000, tree_get(r, 6000));
+        assertEqual(tree_size(q) + 1, tree_size(r));
+        assertTrue(tree_wal_close(wal));
+        assertEqual(0, (wal_file_length(log) - 32) % 32);
+
+        // A log of a different format is rejected.
+        file = fopen(log, "r+b");
+        fwrite("NOTAWAL!", 1, 8, file);
+        fclose(file);
+        assertTrue(tree_wal_open(r, snapshot, log, 16, 100000) == NULL);
+    }
+    tree_free(p);
+    tree_free(q);
+    tree_free(r);
+
+    unlink(snapshot);
+    unlink(log);
+    rmdir(directory);
+}
+
+static void* test_wal_checkpoint_writer (void* argument)
+{
+    tree_wal_t* wal = (tree_wal_t*) argument;
+
+    for (int i = 0; i < 5000; i++)
+    {
+        tree_wal_put(wal, 100000 + i, i);
+        tree_wal_remove(wal, i * 2);
+    }
+
+    return NULL;
+}
+
+static void* test_wal_checkpoint_starter (void* argument)
+{
+    tree_wal_t* wal = (tree_wal_t*) argument;
+
+    for (int i = 0; i < 20; i++)
+    {
+        tree_wal_startCheckpoint(wal);
+        tree_wal_waitCheckpoint(wal);
+    }
+
+    return NULL;
+}
+
+static void test_wal_checkpoint ()
+{
+    char directory[] = "/tmp/test_wal_XXXXXX";
+    char snapshot[64];
+    char log[64];
+    assertTrue(mkdtemp(directory) != NULL);
+    snprintf(snapshot, sizeof(snapshot), "%s/tree.snapshot", directory);
+    snprintf(log, sizeof(log), "%s/tree.log", directory);
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        tree_wal_t* wal = tree_wal_open(p, snapshot, log, 64, 100000);
+        assertFalse(tree_wal_waitCheckpoint(wal));
+
+        for (int i = 0; i < 20000; i++)
+        {
+            tree_wal_put(wal, i, i);
+        }
+
+        // Writers continue while the checkpoint runs.
+        pthread_t writer;
+        assertTrue(tree_wal_startCheckpoint(wal));
+        pthread_create(&writer, NULL, &test_wal_checkpoint_writer, wal);
+        pthread_join(writer, NULL);
+        assertTrue(tree_wal_waitCheckpoint(wal));
+
+        tree_wal_checkpoint_stats_t stats = tree_wal_checkpointStats(wal);
+        assertFalse(stats.running);
+        assertEqual(1, stats.checkpoints);
+        assertEqual(0, stats.failures);
+        assertEqual(20000, stats.entries_expected);
+        assertTrue(stats.entries_written >= 15000);
+        assertTrue(stats.sequence >= 20000);
+        assertTrue(stats.bytes_written > 0);
+        assertTrue(stats.last_duration_ns >= stats.last_pause_ns);
+        assertEqual(stats.last_duration_ns, stats.total_duration_ns);
+
+        // The log only keeps the records that follow the start of the checkpoint.
+        assertTrue(wal_file_length(log) <= 32 + 10000 * 32);
+
+        // A second checkpoint can start, once the first one is complete.
+        assertTrue(tree_wal_startCheckpoint(wal));
+        assertTrue(tree_wal_waitCheckpoint(wal));
+        stats = tree_wal_checkpointStats(wal);
+        assertEqual(2, stats.checkpoints);
+        assertEqual(tree_size(p), stats.entries_written);
+        assertEqual(32, wal_file_length(log));
+
+        // Concurrent callers start and wait for checkpoints, and every checkpoint thread is joined exactly once.
+        pthread_t starters[4];
+
+        for (int i = 0; i < 4; i++)
+        {
+            pthread_create(&starters[i], NULL, &test_wal_checkpoint_starter, wal);
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            pthread_join(starters[i], NULL);
+        }
+
+        stats = tree_wal_checkpointStats(wal);
+        assertFalse(stats.running);
+        assertTrue(stats.checkpoints > 2);
+        assertEqual(0, stats.failures);
+
+        tree_wal_put(wal, -1, -1);
+        assertTrue(tree_wal_close(wal));
+        check_tree(p, 20001);
+
+        // Recovery combines the fuzzy snapshot and the remaining records.
+        wal = tree_wal_open(q, snapshot, log, 64, 100000);
+        assertTrue(wal != NULL);
+        check_same_entries(p, q);
+        assertTrue(tree_wal_close(wal));
+    }
+    tree_free(p);
+    tree_free(q);
+
+    unlink(snapshot);
+    unlink(log);
+    rmdir(directory);
+}
+
+typedef struct
+{
+    tree_wal_t* wal;
+
+    int base;
+
+    bool ok;
+
+} test_wal_worker_t;
+
+static void* test_wal_worker (void* argument)
+{
+    test_wal_worker_t* worker = (test_wal_worker_t*) argument;
+    worker->ok = true;
+
+    for (int i = 0; i < 200; i++)
+    {
+        const uint64_t sequence = tree_wal_put(worker->wal, worker->base + i, i);
+        worker->ok = worker->ok && sequence > 0 && tree_wal_sync(worker->wal, sequence);
+    }
+
+    return NULL;
+}
+
+static void test_wal_concurrent ()
+{
+    char directory[] = "/tmp/test_wal_XXXXXX";
+    char snapshot[64];
+    char log[64];
+    assertTrue(mkdtemp(directory) != NULL);
+    snprintf(snapshot, sizeof(snapshot), "%s/tree.snapshot", directory);
+    snprintf(log, sizeof(log), "%s/tree.log", directory);
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        // Writers that each wait for durability share the fsyncs of their groups.
+        tree_wal_t* wal = tree_wal_open(p, snapshot, log, 4, 1000000);
+        pthread_t ids[4];
+        test_wal_worker_t workers[4];
+
+        for (int i = 0; i < 4; i++)
+        {
+            workers[i].wal = wal;
+            workers[i].base = i * 1000;
+            pthread_create(&ids[i], NULL, &test_wal_worker, &workers[i]);
+        }
+
+        // Compaction may run while the writers are active.
+        assertTrue(tree_wal_compact(wal));
+
+        for (int i = 0; i < 4; i++)
+        {
+            pthread_join(ids[i], NULL);
+            assertTrue(workers[i].ok);
+        }
+
+        assertTrue(tree_wal_close(wal));
+        check_tree(p, 800);
+
+        wal = tree_wal_open(q, snapshot, log, 4, 1000000);
+        assertTrue(wal != NULL);
+        check_same_entries(p, q);
+        assertTrue(tree_wal_close(wal));
+    }
+    tree_free(p);
+    tree_free(q);
+
+    unlink(snapshot);
+    unlink(log);
+    rmdir(directory);
+}
+
+typedef struct
+{
+    key_t* keys;
+
+    data_t* values;
+
+    size_t count;
+
+    size_t capacity;
+
+    size_t chunks;
+
+    size_t chunk_size;
+
+} test_stream_t;
+
+static bool test_stream_sink (tree_t* tree, key_t* keys, data_t* values, size_t count, void* context)
+{
+    test_stream_t* stream = (test_stream_t*) context;
+
+    if (count > stream->chunk_size || stream->count + count > stream->capacity)
+    {
+        return false;
+    }
+
+    memcpy(stream->keys + stream->count, keys, count * sizeof(key_t));
+    memcpy(stream->values + stream->count, values, count * sizeof(data_t));
+    stream->count += count;
+    stream->chunks++;
+    return true;
+}
+
+static size_t test_stream_source (tree_t* tree, key_t* keys, data_t* values, size_t capacity, void* context)
+{
+    test_stream_t* stream = (test_stream_t*) context;
+    const size_t count = stream->capacity - stream->count < capacity ? stream->capacity - stream->count : capacity;
+
+    memcpy(keys, stream->keys + stream->count, count * sizeof(key_t));
+    memcpy(values, stream->values + stream->count, count * sizeof(data_t));
+    stream->count += count;
+    stream->chunks++;
+    return count;
+}
+
+static void test_export_import ()
+{
+    key_t keys[10000];
+    data_t values[10000];
+    test_stream_t stream = { keys, values, 0, 10000, 0, 333 };
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        // An empty tree exports nothing.
+        assertTrue(tree_export(p, 333, &test_stream_sink, &stream));
+        assertEqual(0, stream.chunks);
+
+        for (int i = 0; i < 10000; i++)
+        {
+            tree_put(p, (i * 7919) % 10000, i);
+        }
+
+        // The pairs arrive in ascending order, in chunks of the requested size.
+        assertTrue(tree_export(p, 333, &test_stream_sink, &stream));
+        assertEqual(10000, stream.count);
+        assertEqual(31, stream.chunks);
+
+        for (int i = 0; i < 10000; i++)
+        {
+            assertEqual(i, keys[i]);
+            assertEqual(tree_get(p, i), values[i]);
+        }
+
+        // A sorted stream builds an empty tree directly.
+        stream.count = 0;
+        stream.chunks = 0;
+        assertTrue(tree_import(q, 1000, &test_stream_source, &stream));
+        assertEqual(11, stream.chunks);
+        check_tree(q, 10000);
+        check_same_entries(p, q);
+
+        // The sink can stop the export.
+        stream.count = 0;
+        stream.chunk_size = 100;
+        assertFalse(tree_export(p, 333, &test_stream_sink, &stream));
+        assertEqual(0, stream.count);
+    }
+    tree_free(p);
+    tree_free(q);
+}
+
+static void test_import_unsorted ()
+{
+    key_t keys[] = { 5, 3, 9, 3, 1, 7, 5 };
+    data_t values[] = { 50, 30, 90, 31, 10, 70, 51 };
+    test_stream_t stream = { keys, values, 0, 7, 0, 7 };
+
+    tree_t* p = tree_new();
+    {
+        tree_put(p, 2, 20);
+        tree_put(p, 9, 0);
+
+        // Unsorted pairs are sorted, the last occurrence of a key wins, and the existing pairs are kept.
+        assertTrue(tree_import(p, 2, &test_stream_source, &stream));
+        check_tree(p, 6);
+        assertEqual(10, tree_get(p, 1));
+        assertEqual(20, tree_get(p, 2));
+        assertEqual(31, tree_get(p, 3));
+        assertEqual(51, tree_get(p, 5));
+        assertEqual(70, tree_get(p, 7));
+        assertEqual(90, tree_get(p, 9));
+
+        // A sorted stream is merged into a non-empty tree.
+        key_t more_keys[] = { 0, 4, 9 };
+        data_t more_values[] = { 0, 40, 91 };
+        test_stream_t more = { more_keys, more_values, 0, 3, 0, 3 };
+        assertTrue(tree_import(p, 3, &test_stream_source, &more));
+        check_tree(p, 8);
+        assertEqual(40, tree_get(p, 4));
+        assertEqual(91, tree_get(p, 9));
+    }
+    tree_free(p);
+}
+
+static void test_save_load_packed ()
+{
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    tree_t* r = tree_make(tree_allocator_dynamic(), tree_comparator_reverseOrder());
+    tree_t* s = tree_make(tree_allocator_dynamic(), tree_comparator_reverseOrder());
+    {
+        // Dense keys with a few gaps, small values of both signs, and the extremes of the type.
+        for (int i = 0; i < 100000; i++)
+        {
+            tree_put(p, i % 1000 == 999 ? i + 5000000 : i, i / 16 - 1000);
+        }
+
+        tree_put(p, INT32_MIN, INT32_MAX);
+        tree_put(p, INT32_MAX, INT32_MIN);
+
+        FILE* plain = tmpfile();
+        FILE* packed = tmpfile();
+        assertTrue(tree_save(p, fileno(plain)));
+        assertTrue(tree_savePacked(p, fileno(packed)));
+        assertTrue(lseek(fileno(packed), 0, SEEK_END) * 4 < lseek(fileno(plain), 0, SEEK_END));
+
+        assertEqual(0, lseek(fileno(packed), 0, SEEK_SET));
+        assertTrue(tree_loadPacked(q, fileno(packed)));
+        check_tree(q, 100002);
+        check_same_entries(p, q);
+
+        // Loading into a non-empty tree merges the entries, and the loaded values win.
+        tree_clear(q);
+        tree_put(q, -5, 5);
+        tree_put(q, 7, 0);
+        assertEqual(0, lseek(fileno(packed), 0, SEEK_SET));
+        assertTrue(tree_loadPacked(q, fileno(packed)));
+        check_tree(q, 100003);
+        assertEqual(5, tree_get(q, -5));
+        assertEqual(tree_get(p, 7), tree_get(q, 7));
+
+        // A plain snapshot is not a packed snapshot, and corruption is detected.
+        assertEqual(0, lseek(fileno(plain), 0, SEEK_SET));
+        assertFalse(tree_loadPacked(q, fileno(plain)));
+
+        const int junk = 12345;
+        assertEqual(sizeof(junk), pwrite(fileno(packed), &junk, sizeof(junk), 100));
+        assertEqual(0, lseek(fileno(packed), 0, SEEK_SET));
+        assertFalse(tree_loadPacked(q, fileno(packed)));
+        check_tree(q, 100003);
+
+        // A count far beyond the data (at offset 24 of the header) fails on the data, not on allocating for the count.
+        const uint64_t count = UINT64_C(1) << 40;
+        assertEqual(sizeof(count), pwrite(fileno(packed), &count, sizeof(count), 24));
+        assertEqual(0, lseek(fileno(packed), 0, SEEK_SET));
+        assertFalse(tree_loadPacked(q, fileno(packed)));
+        check_tree(q, 100003);
+
+        // Keys that descend in numeric order still round trip.
+        for (int i = 0; i < 1000; i++)
+        {
+            tree_put(r, i * 1000003, i);
+        }
+
+        assertEqual(0, ftruncate(fileno(packed), 0));
+        assertEqual(0, lseek(fileno(packed), 0, SEEK_SET));
+        assertTrue(tree_savePacked(r, fileno(packed)));
+        assertEqual(0, lseek(fileno(packed), 0, SEEK_SET));
+        assertTrue(tree_loadPacked(s, fileno(packed)));
+        assertEqual(1000, tree_size(s));
+        check_same_entries(r, s);
+
+        fclose(plain);
+        fclose(packed);
+    }
+    tree_free(p);
+    tree_free(q);
+    tree_free(r);
+    tree_free(s);
+}
+
+static void test_save_load_packed_empty ()
+{
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        FILE* file = tmpfile();
+        const int fd = fileno(file);
+        assertTrue(tree_savePacked(p, fd));
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_loadPacked(q, fd));
+        check_tree(q, 0);
+
+        // A single entry forms a block without any key differences.
+        tree_put(p, 42, -42);
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_savePacked(p, fd));
+        assertEqual(0, lseek(fd, 0, SEEK_SET));
+        assertTrue(tree_loadPacked(q, fd));
+        check_tree(q, 1);
+        assertEqual(-42, tree_get(q, 42));
+        fclose(file);
+    }
+    tree_free(p);
+    tree_free(q);
+}
+
+typedef struct
+{
+    tree_op_t ops[20000];
+
+    size_t count;
+
+    size_t position;
+
+} test_patch_t;
+
+static bool test_patch_sink (tree_t* tree, tree_op_t* ops, size_t count, void* context)
+{
+    test_patch_t* patch = (test_patch_t*) context;
+
+    if (patch->count + count > 20000)
+    {
+        return false;
+    }
+
+    memcpy(patch->ops + patch->count, ops, count * sizeof(tree_op_t));
+    patch->count += count;
+    return true;
+}
+
+static size_t test_patch_source (tree_t* tree, tree_op_t* ops, size_t capacity, void* context)
+{
+    test_patch_t* patch = (test_patch_t*) context;
+    const size_t count = patch->count - patch->position < capacity ? patch->count - patch->position : capacity;
+
+    memcpy(ops, patch->ops + patch->position, count * sizeof(tree_op_t));
+    patch->position += count;
+    return count;
+}
+
+static void test_diff ()
+{
+    test_patch_t* patch = calloc(1, sizeof(test_patch_t));
+
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    tree_t* empty = tree_new();
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            tree_put(p, i * 2, i);
+            tree_put(q, i * 2, i);
+        }
+
+        // A tree does not differ from itself or from an equal tree.
+        assertTrue(tree_diff(p, p, &test_patch_sink, patch));
+        assertTrue(tree_diff(p, q, &test_patch_sink, patch));
+        assertEqual(0, patch->count);
+
+        // Removes, additions, and changed values.
+        tree_remove(q, 0);
+        tree_remove(q, 5000);
+        tree_remove(q, 19998);
+        tree_put(q, -1, -1);
+        tree_put(q, 5001, 5001);
+        tree_put(q, 30000, 30000);
+        tree_put(q, 100, -100);
+        tree_put(q, 102, 51);
+
+        assertTrue(tree_diff(p, q, &test_patch_sink, patch));
+        assertEqual(7, patch->count);
+        assertEqual(-1, patch->ops[0].key);
+        assertFalse(patch->ops[0].remove);
+        assertEqual(0, patch->ops[1].key);
+        assertTrue(patch->ops[1].remove);
+        assertEqual(100, patch->ops[2].key);
+        assertEqual(-100, patch->ops[2].value);
+        assertEqual(5000, patch->ops[3].key);
+        assertTrue(patch->ops[3].remove);
+        assertEqual(5001, patch->ops[4].key);
+        assertEqual(19998, patch->ops[5].key);
+        assertTrue(patch->ops[5].remove);
+        assertEqual(30000, patch->ops[6].key);
+
+        // The receiving side applies the patch in chunks.
+        assertTrue(tree_applyPatch(p, 3, &test_patch_source, patch));
+        check_tree(p, 10000);
+        check_same_entries(q, p);
+
+        // Diffs from and to an empty tree.
+        patch->count = 0;
+        patch->position = 0;
+        assertTrue(tree_diff(empty, q, &test_patch_sink, patch));
+        assertEqual(10000, patch->count);
+        assertTrue(tree_applyPatch(empty, 1000, &test_patch_source, patch));
+        check_same_entries(q, empty);
+
+        patch->count = 0;
+        patch->position = 0;
+        tree_clear(empty);
+        assertTrue(tree_diff(q, empty, &test_patch_sink, patch));
+        assertEqual(10000, patch->count);
+        assertTrue(tree_applyPatch(q, 1000, &test_patch_source, patch));
+        check_tree(q, 0);
+    }
+    tree_free(p);
+    tree_free(q);
+    tree_free(empty);
+    free(patch);
+}
+
+typedef struct
+{
+    size_t count;
+
+    key_t lo [16];
+
+    key_t hi [16];
+
+    size_t limit;
+
+} test_mismatch_ranges_t;
+
+static bool test_mismatch_callback (tree_t* self, key_t* lo, key_t* hi, void* context)
+{
+    test_mismatch_ranges_t* ranges = (test_mismatch_ranges_t*) context;
+    assertTrue(ranges->count < 16);
+    ranges->lo[ranges->count] = NULL == lo ? INT32_MIN : *lo;
+    ranges->hi[ranges->count] = NULL == hi ? INT32_MAX : *hi;
+    return ++ranges->count < ranges->limit;
+}
+
+static size_t test_mismatch_covering (test_mismatch_ranges_t* ranges, key_t key)
+{
+    size_t covering = 0;
+
+    for (size_t i = 0; i < ranges->count; i++)
+    {
+        covering += ranges->lo[i] <= key && key < ranges->hi[i];
+    }
+
+    return covering;
+}
+
+static void test_subtree_hash ()
+{
+    tree_t* p = tree_new();
+    tree_t* q = tree_new();
+    {
+        assertEqual(0, tree_hash(p));
+
+        // Sequential puts and a bulk load build trees of different shapes.
+        key_t keys [10000];
+        data_t values [10000];
+
+        for (int i = 0; i < 10000; i++)
+        {
+            assertTrue(tree_put(p, i, 2 * i));
+            keys[i] = 9999 - i;
+            values[i] = 2 * (9999 - i);
+        }
+
+        assertTrue(tree_putArrays(q, keys, values, 10000));
+        check_tree(p, 10000);
+        check_tree(q, 10000);
+        assertTrue(tree_hash(p) != 0);
+        assertEqual(tree_hash(p), tree_hash(q));
+
+        test_mismatch_ranges_t ranges = { .count = 0, .limit = 16 };
+        assertTrue(tree_mismatches(p, q, 1, &test_mismatch_callback, &ranges));
+        assertEqual(0, ranges.count);
+
+        // The hash of a range is the sum of the hashes of its entries.
+        key_t lo = 100;
+        key_t hi = 200;
+        uint64_t expected = 0;
+
+        for (int i = lo; i < hi; i++)
+        {
+            expected += tree_hashEntry(i, 2 * i);
+        }
+
+        assertEqual(expected, tree_hashRange(p, &lo, &hi));
+        assertEqual(expected + tree_hashEntry(200, 400), tree_hashRange(q, &lo, &keys[9798]));
+        assertEqual(tree_hash(p), tree_hashRange(p, NULL, NULL));
+        assertEqual(0, tree_hashRange(p, &hi, &lo));
+
+        // Change a value, remove an entry, and add an entry.
+        tree_iterator_t iter = tree_iter_at(q, 1234);
+        {
+            tree_iter_set(&iter, -1);
+        }
+        tree_iter_free(&iter);
+        tree_remove(q, 7777);
+        assertTrue(tree_put(q, 12000, 0));
+        check_tree(q, 10000);
+        assertTrue(tree_hash(p) != tree_hash(q));
+
+        assertTrue(tree_mismatches(p, q, 1, &test_mismatch_callback, &ranges));
+        assertEqual(3, ranges.count);
+        assertEqual(1, test_mismatch_covering(&ranges, 1234));
+        assertEqual(1, test_mismatch_covering(&ranges, 7777));
+        assertEqual(1, test_mismatch_covering(&ranges, 12000));
+
+        // A larger leaf size reports fewer, larger ranges, and the callback may stop the search.
+        ranges.count = 0;
+        assertTrue(tree_mismatches(p, q, 20000, &test_mismatch_callback, &ranges));
+        assertEqual(1, ranges.count);
+
+        ranges.count = 0;
+        ranges.limit = 2;
+        assertFalse(tree_mismatches(p, q, 1, &test_mismatch_callback, &ranges));
+        assertEqual(2, ranges.count);
+
+        // Restoring the entries restores the hash.
+        assertTrue(tree_put(q, 1234, 2468));
+        assertTrue(tree_put(q, 7777, 15554));
+        tree_remove(q, 12000);
+        assertEqual(tree_hash(p), tree_hash(q));
+
+        // Values set through the tree keep the hashes up to date.
+        const data_t value = tree_get(q, 42);
+        tree_setNode(q, tree_getNode(q, 42), 0);
+        check_tree(q, 10000);
+        assertTrue(tree_hash(p) != tree_hash(q));
+
+        tree_setNode(q, tree_getNode(q, 42), value);
+        assertEqual(tree_hash(p), tree_hash(q));
+
+        // Values written through nodes require a rehash.
+        tree_node_set(tree_getNode(q, 42), 0);
+        tree_rehash(q);
+        check_tree(q, 10000);
+        assertTrue(tree_hash(p) != tree_hash(q));
+    }
+    tree_free(p);
+    tree_free(q);
+}
+
+static void check_disk_entries (tree_disk_t* disk, tree_t* expected)
+{
+    assertEqual(tree_size(expected), tree_disk_size(disk));
+
+    tree_disk_iterator_t iter = tree_disk_iter(disk);
+    tree_node_t* node = tree_firstNode(expected);
+
+    while (tree_disk_iter_hasNext(&iter))
+    {
+        tree_disk_iter_next(&iter);
+        assertNotNull(node);
+        assertEqual(node->key, tree_disk_iter_key(&iter));
+        assertEqual(node->value, tree_disk_iter_get(&iter));
+        node = tree_higherNode(expected, node->key);
+    }
+
+    assertNull(node);
+}
+
+static void test_disk ()
+{
+    char directory[] = "/tmp/test_disk_XXXXXX";
+    char path[64];
+    assertTrue(mkdtemp(directory) != NULL);
+    snprintf(path, sizeof(path), "%s/tree.disk", directory);
+
+    tree_t* p = tree_new();
+    {
+        // The cache is much smaller than the tree, which forces evictions.
+        tree_disk_t* disk = tree_disk_open(path, 16);
+        assertTrue(disk != NULL);
+
+        for (int i = 0; i < 100000; i++)
+        {
+            const key_t key = (key_t) (((int64_t) i * 7919) % 100003);
+            assertTrue(tree_disk_put(disk, key, -key));
+            assertTrue(tree_put(p, key, -key));
+        }
+
+        assertTrue(tree_disk_put(disk, 42, 42));
+        assertTrue(tree_put(p, 42, 42));
+        check_disk_entries(disk, p);
+
+        for (int i = 0; i < 100003; i++)
+        {
+            assertEqual(tree_containsKey(p, i), tree_disk_containsKey(disk, i));
+            assertEqual(tree_get(p, i), tree_disk_get(disk, i));
+        }
+
+        for (int i = 0; i < 100003; i += 3)
+        {
+            assertEqual(tree_containsKey(p, i), tree_disk_remove(disk, i));
+            tree_remove(p, i);
+        }
+
+        assertFalse(tree_disk_remove(disk, 3));
+        check_disk_entries(disk, p);
+
+        tree_disk_stats_t stats = tree_disk_stats(disk);
+        assertEqual(16, stats.cache_pages);
+        assertTrue(stats.hits > 0);
+        assertTrue(stats.misses > 0);
+        assertTrue(stats.evictions > 0);
+        assertTrue(stats.reads > 0);
+        assertTrue(stats.writes > 0);
+        assertTrue(stats.pages > 100);
+        assertTrue(tree_disk_close(disk));
+
+        // Reopening finds the same entries, even with the smallest cache.
+        disk = tree_disk_open(path, 1);
+        assertTrue(disk != NULL);
+        assertEqual(8, tree_disk_stats(disk).cache_pages);
+        check_disk_entries(disk, p);
+
+        tree_disk_iterator_t iter = tree_disk_iter_at(disk, 50001);
+        assertTrue(tree_disk_iter_hasNext(&iter));
+        tree_disk_iter_next(&iter);
+        assertEqual(50002, tree_disk_iter_key(&iter));
+        assertEqual(-50002, tree_disk_iter_get(&iter));
+
+        iter = tree_disk_iter_at(disk, 100003);
+        assertFalse(tree_disk_iter_hasNext(&iter));
+        assertTrue(tree_disk_close(disk));
+    }
+    tree_free(p);
+
+    // A file, which is not a disk tree, is rejected.
+    FILE* file = fopen(path, "wb");
+    assertNotNull(file);
+    assertEqual(5, fwrite("hello", 1, 5, file));
+    fclose(file);
+    assertNull(tree_disk_open(path, 16));
+
+    unlink(path);
+    rmdir(directory);
+}
+
+static void test_disk_empty ()
+{
+    char directory[] = "/tmp/test_disk_XXXXXX";
+    char path[64];
+    assertTrue(mkdtemp(directory) != NULL);
+    snprintf(path, sizeof(path), "%s/tree.disk", directory);
+
+    tree_disk_t* disk = tree_disk_open(path, 16);
+    assertTrue(disk != NULL);
+    assertEqual(0, tree_disk_size(disk));
+    assertFalse(tree_disk_containsKey(disk, 1));
+    assertFalse(tree_disk_remove(disk, 1));
+
+    tree_disk_iterator_t iter = tree_disk_iter(disk);
+    assertFalse(tree_disk_iter_hasNext(&iter));
+
+    // A single entry, which is removed again, leaves an empty leaf page behind.
+    assertTrue(tree_disk_put(disk, 1, 10));
+    assertEqual(10, tree_disk_get(disk, 1));
+    assertTrue(tree_disk_remove(disk, 1));
+    assertEqual(0, tree_disk_size(disk));
+    iter = tree_disk_iter(disk);
+    assertFalse(tree_disk_iter_hasNext(&iter));
+    assertTrue(tree_disk_close(disk));
+
+    unlink(path);
+    rmdir(directory);
+}
+
+static void test_disk_getMany ()
+{
+    char directory[] = "/tmp/test_disk_XXXXXX";
+    char path[64];
+    assertTrue(mkdtemp(directory) != NULL);
+    snprintf(path, sizeof(path), "%s/tree.disk", directory);
+
+    key_t* keys = calloc(20000, sizeof(key_t));
+    data_t* values = calloc(20000, sizeof(data_t));
+    bool* found = calloc(20000, sizeof(bool));
+
+    tree_disk_t* disk = tree_disk_open(path, 64);
+    assertTrue(disk != NULL);
+    {
+        assertEqual(0, tree_disk_getMany(disk, keys, values, found, 100));
+        assertFalse(found[0]);
+
+        for (int i = 0; i < 200000; i += 2)
+        {
+            assertTrue(tree_disk_put(disk, i, i + 1));
+        }
+
+        // Half of the keys are missing, and some of them are repeated.
+        for (int i = 0; i < 20000; i++)
+        {
+            keys[i] = (key_t) (((int64_t) i * 7919) % 200000);
+        }
+
+        keys[1] = keys[0];
+
+        // Both ways of reading the pages give the same results.
+        for (int round = 0; round < 2; round++)
+        {
+            const uint64_t batches = tree_disk_stats(disk).batches;
+            assertEqual(10001, tree_disk_getMany(disk, keys, values, found, 20000));
+            assertTrue(tree_disk_stats(disk).batches > batches);
+
+            for (int i = 0; i < 20000; i++)
+            {
+                assertEqual(keys[i] % 2 == 0, found[i]);
+                assertEqual(tree_disk_get(disk, keys[i]), values[i]);
+            }
+
+            assertFalse(tree_disk_setIoUring(disk, false));
+            assertFalse(tree_disk_stats(disk).io_uring);
+        }
+
+        assertEqual(10001, tree_disk_getMany(disk, keys, values, NULL, 20000));
+    }
+    assertTrue(tree_disk_close(disk));
+
+    free(keys);
+    free(values);
+    free(found);
+    unlink(path);
+    rmdir(directory);
+}
+
 void declare_tree_tests ()
 {
     UNIT_TEST_CASE(TreeMap, test_1);
     UNIT_TEST_CASE(TreeMap, test_2);
     UNIT_TEST_CASE(TreeMap, test_addFirst);
     UNIT_TEST_CASE(TreeMap, test_addLast);
+    UNIT_TEST_CASE(TreeMap, test_aggregate);
     UNIT_TEST_CASE(TreeMap, test_allMatch);
+    UNIT_TEST_CASE(TreeMap, test_applyBatch);
+    UNIT_TEST_CASE(TreeMap, test_applyBatch_allocation_failure);
+    UNIT_TEST_CASE(TreeMap, test_applyBatch_random);
     UNIT_TEST_CASE(TreeMap, test_allocator_dynamic);
     UNIT_TEST_CASE(TreeMap, test_allocator_free);
     UNIT_TEST_CASE(TreeMap, test_allocator_pooled);
     UNIT_TEST_CASE(TreeMap, test_allocator_slab);
     UNIT_TEST_CASE(TreeMap, test_anyMatch);
+    UNIT_TEST_CASE(TreeMap, test_anyMatchRange);
+    UNIT_TEST_CASE(TreeMap, test_ceilingNode);
     UNIT_TEST_CASE(TreeMap, test_comparator_naturalOrder);
     UNIT_TEST_CASE(TreeMap, test_comparator_reverseOrder);
+    UNIT_TEST_CASE(TreeMap, test_concurrent);
+    UNIT_TEST_CASE(TreeMap, test_concurrent_threads);
     UNIT_TEST_CASE(TreeMap, test_containsAll);
     UNIT_TEST_CASE(TreeMap, test_containsKey);
     UNIT_TEST_CASE(TreeMap, test_containsValue);
     UNIT_TEST_CASE(TreeMap, test_copy);
     UNIT_TEST_CASE(TreeMap, test_copy_allocation_failure_special_case);
     UNIT_TEST_CASE(TreeMap, test_count);
+    UNIT_TEST_CASE(TreeMap, test_countRange);
     UNIT_TEST_CASE(TreeMap, test_defaultKey);
     UNIT_TEST_CASE(TreeMap, test_defaultValue);
+    UNIT_TEST_CASE(TreeMap, test_diff);
+    UNIT_TEST_CASE(TreeMap, test_disk);
+    UNIT_TEST_CASE(TreeMap, test_disk_empty);
+    UNIT_TEST_CASE(TreeMap, test_disk_getMany);
+    UNIT_TEST_CASE(TreeMap, test_export_import);
+    UNIT_TEST_CASE(TreeMap, test_finger);
     UNIT_TEST_CASE(TreeMap, test_firstNode);
+    UNIT_TEST_CASE(TreeMap, test_floorNode);
     UNIT_TEST_CASE(TreeMap, test_forEach);
     UNIT_TEST_CASE(TreeMap, test_free);
     UNIT_TEST_CASE(TreeMap, test_free_stackalloc);
     UNIT_TEST_CASE(TreeMap, test_get);
+    UNIT_TEST_CASE(TreeMap, test_getMany);
     UNIT_TEST_CASE(TreeMap, test_getNode);
     UNIT_TEST_CASE(TreeMap, test_has);
     UNIT_TEST_CASE(TreeMap, test_higherNode);
+    UNIT_TEST_CASE(TreeMap, test_image);
+    UNIT_TEST_CASE(TreeMap, test_image_corrupt_links);
+    UNIT_TEST_CASE(TreeMap, test_image_empty);
+    UNIT_TEST_CASE(TreeMap, test_import_unsorted);
     UNIT_TEST_CASE(TreeMap, test_isEmpty);
     UNIT_TEST_CASE(TreeMap, test_isEqual);
     UNIT_TEST_CASE(TreeMap, test_iter);
@@ -2736,6 +5298,9 @@ void declare_tree_tests ()
     UNIT_TEST_CASE(TreeMap, test_make);
     UNIT_TEST_CASE(TreeMap, test_make_comparators);
     UNIT_TEST_CASE(TreeMap, test_make_stackalloc);
+    UNIT_TEST_CASE(TreeMap, test_multiqueue);
+    UNIT_TEST_CASE(TreeMap, test_multiqueue_concurrent);
+    UNIT_TEST_CASE(TreeMap, test_neighbors);
     UNIT_TEST_CASE(TreeMap, test_new);
     UNIT_TEST_CASE(TreeMap, test_node_get);
     UNIT_TEST_CASE(TreeMap, test_node_key);
@@ -2753,21 +5318,40 @@ void declare_tree_tests ()
     UNIT_TEST_CASE(TreeMap, test_pushLast);
     UNIT_TEST_CASE(TreeMap, test_put);
     UNIT_TEST_CASE(TreeMap, test_putAll);
+    UNIT_TEST_CASE(TreeMap, test_putArrays);
+    UNIT_TEST_CASE(TreeMap, test_putArraysParallel);
     UNIT_TEST_CASE(TreeMap, test_putNode);
+    UNIT_TEST_CASE(TreeMap, test_quantiles);
+    UNIT_TEST_CASE(TreeMap, test_range);
+    UNIT_TEST_CASE(TreeMap, test_rankOf);
     UNIT_TEST_CASE(TreeMap, test_reduceToDouble);
     UNIT_TEST_CASE(TreeMap, test_reduceToInt64);
     UNIT_TEST_CASE(TreeMap, test_remove);
     UNIT_TEST_CASE(TreeMap, test_removeAll);
     UNIT_TEST_CASE(TreeMap, test_removeFirst);
     UNIT_TEST_CASE(TreeMap, test_removeIf);
+    UNIT_TEST_CASE(TreeMap, test_removeRange);
     UNIT_TEST_CASE(TreeMap, test_removeLast);
     UNIT_TEST_CASE(TreeMap, test_retainAll);
     UNIT_TEST_CASE(TreeMap, test_rootNode);
+    UNIT_TEST_CASE(TreeMap, test_sample);
+    UNIT_TEST_CASE(TreeMap, test_save_load);
+    UNIT_TEST_CASE(TreeMap, test_save_load_empty);
+    UNIT_TEST_CASE(TreeMap, test_save_load_packed);
+    UNIT_TEST_CASE(TreeMap, test_save_load_packed_empty);
+    UNIT_TEST_CASE(TreeMap, test_setNode);
     UNIT_TEST_CASE(TreeMap, test_size);
+    UNIT_TEST_CASE(TreeMap, test_split_join);
+    UNIT_TEST_CASE(TreeMap, test_subtree_hash);
     UNIT_TEST_CASE(TreeMap, test_sumToDouble);
     UNIT_TEST_CASE(TreeMap, test_sumToInt64);
     UNIT_TEST_CASE(TreeMap, test_valuesToArray);
     UNIT_TEST_CASE(TreeMap, test_valuesToNewArray);
+    UNIT_TEST_CASE(TreeMap, test_wal);
+    UNIT_TEST_CASE(TreeMap, test_wal_checkpoint);
+    UNIT_TEST_CASE(TreeMap, test_wal_concurrent);
+    UNIT_TEST_CASE(TreeMap, test_writebehind);
+    UNIT_TEST_CASE(TreeMap, test_writebehind_concurrent);
 }
 #endif
 
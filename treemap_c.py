@@ -30,6 +30,7 @@
 
 import argparse
 import os
+import re
 import sys
 import pathlib
 import tornado.template
@@ -52,6 +53,14 @@ TREE_TEMPLATE_H = '''
 #include "{{path[0]}}"
 {% end %}
 
+#ifndef TREE_MAX_HEIGHT
+/**
+ * Upper bound of the height of any tree, which sizes the stacks that hold a path from the root.
+ * Since the height of an AVL tree with n nodes is less than 1.45 log2(n + 2), it is less than 93 for 2^64 nodes.
+ */
+#define TREE_MAX_HEIGHT 128
+#endif
+
 /**
  * Forward declaration of the tree_node_t structure.
  */
@@ -72,6 +81,20 @@ typedef struct {{NAME}}_node
      * Size (number of nodes) in the subtree rooted at this node.
      */
     size_t size;
+{% if SUBTREE_HASH %}
+
+    /**
+     * Sum of the entry hashes in the subtree rooted at this node, which does not depend on its shape.
+     */
+    uint64_t hash;
+{% end %}
+{% if AGGREGATE %}
+
+    /**
+     * Aggregate of the entries in the subtree rooted at this node, combined in key order.
+     */
+    {{AGGREGATE_TYPE}} aggregate;
+{% end %}
 
     /**
      * Pointer to the left child node.
@@ -185,6 +208,145 @@ typedef struct
 
 } {{NAME}}_iterator_t;
 
+/**
+ * @struct tree_range
+ * @brief Cursor over the nodes, whose keys are between two bounds, in ascending order.
+ *
+ * The cursor keeps the path to the next node on a stack; therefore, moving to the next node
+ * takes amortized constant time, and no node outside of the bounds is ever returned.
+ * The cursor must not be used after the tree is modified.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the owning tree.
+     */
+    {{NAME}}_t* owner;
+
+    /**
+     * Pointer to the current node, or NULL before the first call to next().
+     */
+    {{NAME}}_node_t* node;
+
+    /**
+     * Upper bound of the keys.
+     */
+    {{KEY_TYPE}} hi;
+
+    /**
+     * Whether the upper bound itself is in the range.
+     */
+    bool hi_inclusive;
+
+    /**
+     * Number of nodes on the stack.
+     */
+    size_t depth;
+
+    /**
+     * Nodes in the range, whose left subtrees are being visited, with the next node on top.
+     */
+    {{NAME}}_node_t* stack[TREE_MAX_HEIGHT];
+
+} {{NAME}}_range_t;
+
+/**
+ * @struct tree_finger
+ * @brief Cursor, which remembers the path to the last node it reached, to search near it.
+ *
+ * A search from the finger climbs only to the nearest node on the path, whose subtree spans the key,
+ * and descends from there; therefore, a scan in key order takes amortized constant time per key,
+ * and a search for a key near the last one does not start at the root.
+ * The finger must be initialized again after the tree is modified.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the owning tree.
+     */
+    {{NAME}}_t* owner;
+
+    /**
+     * Number of nodes on the path.
+     */
+    size_t depth;
+
+    /**
+     * Nodes on the path from the root to the last node reached.
+     */
+    {{NAME}}_node_t* path[TREE_MAX_HEIGHT];
+
+    /**
+     * Nearest ancestors, whose keys bound the subtree of each node on the path from below, or NULL for no bound.
+     */
+    {{NAME}}_node_t* lower[TREE_MAX_HEIGHT];
+
+    /**
+     * Nearest ancestors, whose keys bound the subtree of each node on the path from above, or NULL for no bound.
+     */
+    {{NAME}}_node_t* upper[TREE_MAX_HEIGHT];
+
+} {{NAME}}_finger_t;
+
+/**
+ * @struct tree_neighbors
+ * @brief Nodes around a key, which are found together in a single descent.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the node with the greatest key less than the key, or NULL if there is none.
+     */
+    {{NAME}}_node_t* lower;
+
+    /**
+     * Pointer to the node with the key, or NULL if there is none.
+     */
+    {{NAME}}_node_t* exact;
+
+    /**
+     * Pointer to the node with the least key greater than the key, or NULL if there is none.
+     */
+    {{NAME}}_node_t* higher;
+
+} {{NAME}}_neighbors_t;
+
+/**
+ * @struct tree_random
+ * @brief Seedable random number generator (splitmix64), which is small enough to live on the stack.
+ */
+typedef struct
+{
+    /**
+     * State of the generator, which advances by a constant upon each draw.
+     */
+    uint64_t state;
+
+} {{NAME}}_random_t;
+
+/**
+ * @struct tree_op
+ * @brief A single put or remove operation, which is part of a batch of operations.
+ */
+typedef struct
+{
+    /**
+     * True, if the key is to be removed, rather than put.
+     */
+    bool remove;
+
+    /**
+     * The key to put or remove.
+     */
+    {{KEY_TYPE}} key;
+
+    /**
+     * The data value to associate with the key, if this is a put.
+     */
+    {{VALUE_TYPE}} value;
+
+} {{NAME}}_op_t;
+
 /**
  * @brief Creates a new dynamic tree allocator.
  * @return Pointer to the newly created tree allocator.
@@ -247,6 +409,11 @@ void {{NAME}}_allocator_free ({{NAME}}_allocator_t* self);
  * @brief Sets the data value of a given tree node.
  * @param self Pointer to the tree node.
  * @param value The data value to set.
+{% if SUBTREE_HASH or AGGREGATE %}
+ *
+ * The node does not know its tree; therefore, the hashes and aggregates of the node and its ancestors are not updated.
+ * Use setNode() instead, unless rehash() or reaggregate() is called afterwards.
+{% end %}
  */
 void {{NAME}}_node_set ({{NAME}}_node_t* self, {{VALUE_TYPE}} value);
 
@@ -298,6 +465,29 @@ void {{NAME}}_free_stackalloc ({{NAME}}_t* self);
  */
 {{NAME}}_t* {{NAME}}_copy ({{NAME}}_t* self);
 
+/**
+ * @brief Splits an AVL tree at a key into two new trees in logarithmic time.
+ * @param self Pointer to the AVL tree, which is empty afterwards.
+ * @param key Key at which to split the tree.
+ * @param left Receives the new tree with the keys less than the key.
+ * @param right Receives the new tree with the keys greater than or equal to the key.
+ * @return true if the tree was split, false if a new tree could not be allocated (the tree is unchanged).
+ *
+ * The nodes are moved rather than copied; hence, the new trees use the allocator and the comparator of the tree.
+ */
+bool {{NAME}}_split ({{NAME}}_t* self, {{KEY_TYPE}} key, {{NAME}}_t** left, {{NAME}}_t** right);
+
+/**
+ * @brief Moves all of the nodes of one AVL tree to the end of another in logarithmic time.
+ * @param left Pointer to the AVL tree, which receives the nodes.
+ * @param right Pointer to the AVL tree, whose keys must all be greater than the keys of the left tree.
+ * @return true if the trees were joined (the right tree is empty afterwards), false otherwise (both are unchanged).
+ *
+ * The trees must use the same allocator and the same comparator.
+ * The least node of the right tree becomes the pivot, where the two trees are joined.
+ */
+bool {{NAME}}_join ({{NAME}}_t* left, {{NAME}}_t* right);
+
 /**
  * @brief Retrieves the number of nodes in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -323,9 +513,23 @@ void {{NAME}}_clear ({{NAME}}_t* self);
  * @param self Pointer to the AVL tree.
  * @param key Key for the node to insert.
  * @return Pointer to the created node.
+{% if SUBTREE_HASH or AGGREGATE %}
+ *
+ * The value of a new node is zeroed; set it through setNode(), which keeps the hashes and aggregates up to date.
+{% end %}
  */
 {{NAME}}_node_t* {{NAME}}_putNode ({{NAME}}_t* self, {{KEY_TYPE}} key);
 
+/**
+ * @brief Sets the data value of a node of the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param node Pointer to a node of the tree.
+ * @param value Data value to set.
+ *
+ * Unlike node_set(), this keeps the hashes and aggregates of the node and its ancestors up to date.
+ */
+void {{NAME}}_setNode ({{NAME}}_t* self, {{NAME}}_node_t* node, {{VALUE_TYPE}} value);
+
 /**
  * @brief Retrieves a node by its key.
  * @param self Pointer to the AVL tree.
@@ -371,6 +575,30 @@ void {{NAME}}_clear ({{NAME}}_t* self);
  */
 {{NAME}}_node_t* {{NAME}}_lowerNode ({{NAME}}_t* self, {{KEY_TYPE}} key);
 
+/**
+ * @brief Finds the node with the greatest key less than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the floor node.
+ * @return Pointer to the floor node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_floorNode ({{NAME}}_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Finds the node with the least key greater than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the ceiling node.
+ * @return Pointer to the ceiling node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_ceilingNode ({{NAME}}_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Finds the lower node, the exact node and the higher node of a given key in a single descent.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the neighbors.
+ * @return The lower, exact and higher nodes, each of which is NULL if not found.
+ */
+{{NAME}}_neighbors_t {{NAME}}_neighbors ({{NAME}}_t* self, {{KEY_TYPE}} key);
+
 /**
  * @brief Finds the nth node (0-based index) in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -379,8 +607,84 @@ void {{NAME}}_clear ({{NAME}}_t* self);
  */
 {{NAME}}_node_t* {{NAME}}_nthNode ({{NAME}}_t* self, size_t index);
 
-{% if DEQUE %}
+/**
+ * @brief Finds the index (0-based) of a key in the AVL tree, which is the inverse of nthNode().
+ * @param self Pointer to the AVL tree.
+ * @param key Key to search for.
+ * @return Index of the key, or SIZE_MAX if the key is not found.
+ */
+size_t {{NAME}}_rankOf ({{NAME}}_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Finds the index (0-based) of the greatest key, which is less than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the floor key, or SIZE_MAX if all of the keys are greater than the given key.
+ */
+size_t {{NAME}}_floorRank ({{NAME}}_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Finds the index (0-based) of the least key, which is greater than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the ceiling key, or SIZE_MAX if all of the keys are less than the given key.
+ */
+size_t {{NAME}}_ceilingRank ({{NAME}}_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Counts the nodes, whose keys are between two bounds, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ * @return Number of nodes in the range, which is zero if the range is empty.
+ *
+ * For example, countRange(self, lo, true, hi, false) counts the keys in [lo, hi).
+ */
+size_t {{NAME}}_countRange ({{NAME}}_t* self, {{KEY_TYPE}} lo, bool lo_inclusive, {{KEY_TYPE}} hi, bool hi_inclusive);
+
+/**
+ * @brief Creates a random number generator from a seed.
+ * @param seed Seed of the generator; equal seeds produce equal sequences.
+ * @return The random number generator.
+ */
+{{NAME}}_random_t {{NAME}}_random_seed (uint64_t seed);
+
+/**
+ * @brief Draws the next random number from a generator.
+ * @param self Pointer to the random number generator.
+ * @return Uniformly distributed 64-bit random number.
+ */
+uint64_t {{NAME}}_random_next ({{NAME}}_random_t* self);
+
+/**
+ * @brief Draws uniformly random nodes (with replacement) from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param k Number of nodes to draw.
+ * @param rng Pointer to the random number generator.
+ * @param out Array that receives the k drawn nodes in ascending key order.
+ * @return Number of nodes drawn, which is zero if the tree is empty or memory could not be allocated.
+ *
+ * The random ranks are sorted, and then all of the nodes are found in a single walk over the tree,
+ * which shares the common prefixes of the paths, instead of k independent descents.
+ */
+size_t {{NAME}}_sample ({{NAME}}_t* self, size_t k, {{NAME}}_random_t* rng, {{NAME}}_node_t** out);
+
+/**
+ * @brief Finds the nodes at several quantiles of the keys in a single walk over the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param q Quantiles, each of which is between 0 and 1 (values outside are clamped), in any order.
+ * @param m Number of quantiles.
+ * @param out Array that receives the node at each quantile, in the order of the quantiles.
+ * @return true if the nodes were found, false if the tree is empty or memory could not be allocated.
+ *
+ * The node at quantile q is the node at the rank round(q * (size - 1));
+ * hence, 0 is the first node, 0.5 is the median and 1 is the last node.
+ */
+bool {{NAME}}_quantiles ({{NAME}}_t* self, const double* q, size_t m, {{NAME}}_node_t** out);
 
+{% if DEQUE %}
 /**
  * @brief Adds a value as the first element in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -422,7 +726,6 @@ bool {{NAME}}_pushLast ({{NAME}}_t* self, {{VALUE_TYPE}} value);
 bool {{NAME}}_push ({{NAME}}_t* self, {{VALUE_TYPE}} value);
 
 {% end %}
-
 /**
  * @brief Peeks at the last value in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -591,6 +894,96 @@ void {{NAME}}_retainAll ({{NAME}}_t* self, {{NAME}}_t* other);
  */
 bool {{NAME}}_put ({{NAME}}_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value);
 
+/**
+ * @brief Inserts many key-value pairs at once by sorting them and rebuilding the tree in linear time.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool {{NAME}}_putArrays ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, size_t count);
+
+{% if PARALLEL %}
+/**
+ * @brief Inserts many key-value pairs at once, sorting and building the tree using multiple threads.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @param threads Maximum number of threads to use.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool {{NAME}}_putArraysParallel ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, size_t count, size_t threads);
+{% end %}
+
+/**
+ * @brief Streams the key-value pairs of the AVL tree, in ascending order, into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs passed to the sink at once.
+ * @param sink Function receiving each chunk (keys and values, index for index), which returns false to stop the export.
+ * @param context Additional context passed to the sink.
+ * @return true if every pair was passed to the sink, false if the sink stopped the export or a buffer could not be allocated.
+ *
+ * The tree is traversed once, and only two buffers of chunk_size elements are allocated.
+ * The sink must not modify the tree.
+ */
+bool {{NAME}}_export ({{NAME}}_t* self, size_t chunk_size, bool (*sink)({{NAME}}_t*, {{KEY_TYPE}}*, {{VALUE_TYPE}}*, size_t, void*), void* context);
+
+/**
+ * @brief Inserts the key-value pairs produced by a source, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs requested from the source at once.
+ * @param source Function filling at most chunk_size keys and values, which returns the number of pairs filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If the pairs arrive in strictly ascending order, as produced by {{NAME}}_export(), then the tree is built
+ * in linear time without sorting. Otherwise, the pairs are sorted first, and the last occurrence of a key wins.
+ */
+bool {{NAME}}_import ({{NAME}}_t* self, size_t chunk_size, size_t (*source)({{NAME}}_t*, {{KEY_TYPE}}*, {{VALUE_TYPE}}*, size_t, void*), void* context);
+
+/**
+ * @brief Applies a batch of put and remove operations in one pass over the tree.
+ * @param self Pointer to the AVL tree.
+ * @param ops Operations to apply, preferably sorted by key.
+ * @param count Number of operations in the batch.
+ * @return true if all of the operations were applied, false otherwise (the tree is then left unchanged).
+ *
+ * When several operations have the same key, the last one wins.
+ * Unsorted batches are sorted internally, without modifying the given array.
+ * A node is allocated up front for each put, before the tree is touched, and the nodes of puts that overwrite an existing key are released afterwards.
+ */
+bool {{NAME}}_applyBatch ({{NAME}}_t* self, {{NAME}}_op_t* ops, size_t count);
+
+/**
+ * @brief Computes the operations that turn one AVL tree into another, and streams them into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree, which is the starting point.
+ * @param other Pointer to the AVL tree, which is the goal, and which must use the same comparator.
+ * @param sink Function receiving each chunk of operations, which returns false to stop the diff.
+ * @param context Additional context passed to the sink.
+ * @return true if every operation was passed to the sink, false if the sink stopped the diff or a buffer could not be allocated.
+ *
+ * Both trees are walked in order, side by side, which takes linear time. Only keys that are missing from
+ * the goal are removed, and only keys that are new or whose values differ (byte for byte) are put.
+ * Since the operations are sorted by key and the keys are distinct, {{NAME}}_applyBatch() applies them in a single pass.
+ */
+bool {{NAME}}_diff ({{NAME}}_t* self, {{NAME}}_t* other, bool (*sink)({{NAME}}_t*, {{NAME}}_op_t*, size_t, void*), void* context);
+
+/**
+ * @brief Applies the operations produced by a source, one chunk at a time, such as a diff received from another process.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of operations requested from the source at once.
+ * @param source Function filling at most chunk_size operations, which returns the number of operations filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if all of the operations were applied, false if a buffer or a node could not be allocated.
+ */
+bool {{NAME}}_applyPatch ({{NAME}}_t* self, size_t chunk_size, size_t (*source)({{NAME}}_t*, {{NAME}}_op_t*, size_t, void*), void* context);
+
 /**
  * @brief Retrieves the value associated with a key in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -599,6 +992,22 @@ bool {{NAME}}_put ({{NAME}}_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value);
  */
 {{VALUE_TYPE}} {{NAME}}_get ({{NAME}}_t* self, {{KEY_TYPE}} key);
 
+/**
+ * @brief Retrieves the values associated with many keys in the AVL tree, overlapping their lookups.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
+ *
+ * Several descents advance in turn, one level at a time, and each step prefetches the next node of its descent;
+ * hence, the cache misses of the descents overlap, instead of adding up as they do in a loop of get().
+ * Sorted keys benefit further, since consecutive descents share the cached prefixes of their paths.
+ * The results are stored in the order of the keys.
+ */
+size_t {{NAME}}_getMany ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, bool* found, size_t count);
+
 /**
  * @brief Removes a key and its value from the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -626,6 +1035,20 @@ void {{NAME}}_removeLast ({{NAME}}_t* self);
  */
 void {{NAME}}_removeIf ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context);
 
+/**
+ * @brief Removes the nodes, whose keys are in a half-open range, in O(log n + k) time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Inclusive lower bound of the keys.
+ * @param hi Exclusive upper bound of the keys.
+ * @param callback Function that receives each removed node, in ascending order, before it is released, or NULL.
+ * @param context Additional context passed to the callback.
+ * @return Number of removed nodes.
+ *
+ * The range is detached from the tree in O(log n) time, by splitting and joining the tree,
+ * and then its k nodes are released without any rebalancing.
+ */
+size_t {{NAME}}_removeRange ({{NAME}}_t* self, {{KEY_TYPE}} lo, {{KEY_TYPE}} hi, void (*callback)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context);
+
 /**
  * @brief Applies a function to each node in the AVL tree.
  * @param self Pointer to the AVL tree.
@@ -661,6 +1084,43 @@ bool {{NAME}}_allMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}
  */
 bool {{NAME}}_noneMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context);
 
+/**
+ * @brief Checks if any nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if any match found, false otherwise.
+ *
+ * Only the subtrees, which overlap the range, are visited, and the search stops at the first match.
+ */
+bool {{NAME}}_anyMatchRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context);
+
+/**
+ * @brief Checks if all nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if all nodes in the range match, false otherwise.
+ *
+ * Only the subtrees, which overlap the range, are visited, and the search stops at the first mismatch.
+ */
+bool {{NAME}}_allMatchRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context);
+
+/**
+ * @brief Checks if none of the nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if none match, false otherwise.
+ */
+bool {{NAME}}_noneMatchRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context);
+
 /**
  * @brief Counts the number of nodes matching a given predicate.
  * @param self Pointer to the AVL tree.
@@ -763,1979 +1223,11221 @@ void {{NAME}}_iter_set ({{NAME}}_iterator_t* self, {{VALUE_TYPE}} value);
  */
 {{VALUE_TYPE}} {{NAME}}_iter_get ({{NAME}}_iterator_t* self);
 
-#endif // {{NAME}}_H
-
-{{COPYRIGHT_FOOTER}}
-'''
+/**
+ * @brief Positions a range cursor before the first node, whose key is between two bounds, in a single descent.
+ * @param self Pointer to the range cursor.
+ * @param owner Pointer to the AVL tree.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ */
+void {{NAME}}_range_seek ({{NAME}}_range_t* self, {{NAME}}_t* owner, {{KEY_TYPE}} lo, bool lo_inclusive, {{KEY_TYPE}} hi, bool hi_inclusive);
 
-TREE_TEMPLATE_C = '''
-{% autoescape None %}
+/**
+ * @brief Checks if the range cursor has a next node.
+ * @param self Pointer to the range cursor.
+ * @return true if there is a next node in the range, false otherwise.
+ */
+bool {{NAME}}_range_hasNext ({{NAME}}_range_t* self);
 
-{{COPYRIGHT_HEADER}}
+/**
+ * @brief Advances the range cursor to the next node.
+ * @param self Pointer to the range cursor.
+ */
+void {{NAME}}_range_next ({{NAME}}_range_t* self);
 
-#include "{{HEADER}}"
+/**
+ * @brief Retrieves the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Pointer to the current node, or NULL if the cursor is not at a node.
+ */
+{{NAME}}_node_t* {{NAME}}_range_node ({{NAME}}_range_t* self);
 
-typedef struct
-{
-    size_t allocated;
+/**
+ * @brief Retrieves the key of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Key of the current node.
+ */
+{{KEY_TYPE}} {{NAME}}_range_key ({{NAME}}_range_t* self);
 
-    size_t capacity;
+/**
+ * @brief Retrieves the data value of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Data value of the current node.
+ */
+{{VALUE_TYPE}} {{NAME}}_range_get ({{NAME}}_range_t* self);
 
-    {{NAME}}_node_t* free;
+/**
+ * @brief Initializes a finger at the root of a tree.
+ * @param self Pointer to the finger.
+ * @param owner Pointer to the AVL tree.
+ */
+void {{NAME}}_finger_init ({{NAME}}_finger_t* self, {{NAME}}_t* owner);
 
-} {{NAME}}_allocator_pooled_t;
+/**
+ * @brief Moves a finger to the node with a given key, or to the last node on its search path.
+ *
+ * The search starts from the nearest node on the path of the finger, whose subtree spans the key,
+ * so that a scan in key order costs amortized constant time per key, and no search costs more than get().
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Pointer to the node with the key, or NULL if the key is not in the tree.
+ */
+{{NAME}}_node_t* {{NAME}}_finger_seek ({{NAME}}_finger_t* self, {{KEY_TYPE}} key);
 
-typedef struct
-{
-    size_t capacity;
+/**
+ * @brief Retrieves the data value associated with a given key by a search from a finger.
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Data value associated with the key, or the default value if the key is not in the tree.
+ */
+{{VALUE_TYPE}} {{NAME}}_finger_get ({{NAME}}_finger_t* self, {{KEY_TYPE}} key);
 
-    {{NAME}}_node_t* free;
+{% if MULTIQUEUE %}
+/**
+ * Forward declaration of the tree_multiqueue_t structure.
+ *
+ * A multiqueue is a relaxed concurrent priority queue, which consists of several trees,
+ * each one guarded by its own lock. An insertion goes into a randomly chosen tree.
+ * A removal locks two randomly chosen trees and removes the smaller of their two first elements.
+ * Threads never wait on a lock; rather, they simply pick different trees, when a lock is busy.
+ *
+ * Relaxation Guarantees:
+ * - popFirst() does not necessarily return the global minimum; rather, it returns the minimum of two random trees.
+ *   With q trees, the expected rank of the returned element is O(q) and the rank is O(q log q) with high probability.
+ * - Elements that were put into the same tree are removed in key order, since each tree is an exact priority queue.
+ * - popFirst() only reports that the multiqueue is empty after it has observed every tree to be empty.
+ * - With a single tree, the multiqueue is an exact, but fully serialized, priority queue.
+ *
+ * The single-threaded tree_popFirst() and tree_peekFirst() functions are unaffected by this type.
+ */
+typedef struct {{NAME}}_multiqueue {{NAME}}_multiqueue_t;
 
-    {{NAME}}_node_t nodes[];
+/**
+ * @brief Creates a new multiqueue using the natural ordering of keys.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ */
+{{NAME}}_multiqueue_t* {{NAME}}_multiqueue_new (size_t queues);
 
-} {{NAME}}_allocator_slab_t;
+/**
+ * @brief Creates a new multiqueue with a specified comparator.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ *
+ * The internal trees always use the dynamic allocator, because the other allocators are not thread-safe.
+ */
+{{NAME}}_multiqueue_t* {{NAME}}_multiqueue_make (size_t queues, {{NAME}}_comparator_t comparator);
+
+/**
+ * @brief Frees the resources of a multiqueue, which must no longer be in use by any thread.
+ * @param self Pointer to the multiqueue to free.
+ */
+void {{NAME}}_multiqueue_free ({{NAME}}_multiqueue_t* self);
+
+/**
+ * @brief Retrieves the number of elements in the multiqueue, which may be stale under concurrent use.
+ * @param self Pointer to the multiqueue.
+ * @return Number of elements in the multiqueue.
+ */
+size_t {{NAME}}_multiqueue_size ({{NAME}}_multiqueue_t* self);
+
+/**
+ * @brief Inserts a key-value pair into the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Key, which is the priority of the element.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ *
+ * If the chosen tree already contains the key, then its value is replaced.
+ */
+bool {{NAME}}_multiqueue_put ({{NAME}}_multiqueue_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value);
+
+{% if DEQUE %}
+/**
+ * @brief Pushes a value with the next sequence number as its key (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ *
+ * Popping from a multiqueue that is only filled this way yields a relaxed FIFO queue.
+ */
+bool {{NAME}}_multiqueue_push ({{NAME}}_multiqueue_t* self, {{VALUE_TYPE}} value);
+{% end %}
+
+/**
+ * @brief Removes an element with a small key from the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Output for the key of the removed element, or NULL.
+ * @param value Output for the data value of the removed element, or NULL.
+ * @return true if an element was removed, false if the multiqueue was observed to be empty.
+ */
+bool {{NAME}}_multiqueue_popFirst ({{NAME}}_multiqueue_t* self, {{KEY_TYPE}}* key, {{VALUE_TYPE}}* value);
+{% end %}
+
+{% if WRITE_BEHIND %}
+/**
+ * Forward declaration of the tree_writebehind_t structure.
+ *
+ * A write-behind queue decouples writers from a tree. Any number of threads enqueue puts and removes
+ * into a lock-free ring buffer, without touching the tree. A dedicated applier thread drains the ring buffer
+ * in batches, sorts and coalesces each batch, and then applies the batch to the tree using tree_applyBatch().
+ * The applier sleeps while it waits; only the writer that completes a batch, or that arrives at an idle queue, wakes it.
+ */
+typedef struct {{NAME}}_writebehind {{NAME}}_writebehind_t;
+
+/**
+ * @struct tree_writebehind_stats
+ * @brief Counters describing the activity of a write-behind queue.
+ */
+typedef struct
+{
+    /**
+     * Number of operations currently waiting in the ring buffer.
+     */
+    size_t depth;
+
+    /**
+     * Highest number of operations that the applier has seen waiting in the ring buffer.
+     */
+    size_t max_depth;
+
+    /**
+     * Number of operations that have been enqueued.
+     */
+    uint64_t enqueued;
+
+    /**
+     * Number of operations that have been applied to the tree.
+     */
+    uint64_t applied;
+
+    /**
+     * Number of batches that have been applied to the tree.
+     */
+    uint64_t batches;
+
+    /**
+     * Number of times that a writer found the ring buffer to be full and had to wait.
+     */
+    uint64_t stalls;
+
+    /**
+     * Number of times that a batch could not be applied, because a node could not be allocated.
+     * The tree is then left unchanged, and the applier retries the same batch after waiting for the latency bound.
+     */
+    uint64_t failures;
+
+} {{NAME}}_writebehind_stats_t;
+
+/**
+ * @brief Creates a write-behind queue in front of a tree and starts its applier thread.
+ * @param tree Pointer to the tree, which must only be accessed through the queue from now on.
+ * @param capacity Capacity of the ring buffer, which is rounded up to a power of two.
+ * @param batch_size Maximum number of operations applied to the tree at once.
+ * @param max_latency_ns Longest time that the applier waits for a batch to fill up, in nanoseconds.
+ * @return Pointer to the newly created queue or NULL if creation failed.
+ */
+{{NAME}}_writebehind_t* {{NAME}}_writebehind_new ({{NAME}}_t* tree, size_t capacity, size_t batch_size, uint64_t max_latency_ns);
+
+/**
+ * @brief Applies all pending operations, stops the applier thread, and frees the queue (but not the tree).
+ * @param self Pointer to the write-behind queue.
+ */
+void {{NAME}}_writebehind_free ({{NAME}}_writebehind_t* self);
+
+/**
+ * @brief Enqueues a put operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ */
+void {{NAME}}_writebehind_put ({{NAME}}_writebehind_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value);
+
+/**
+ * @brief Enqueues a remove operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to remove.
+ */
+void {{NAME}}_writebehind_remove ({{NAME}}_writebehind_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Waits until every operation enqueued before this call has been applied to the tree.
+ * @param self Pointer to the write-behind queue.
+ *
+ * This is the barrier needed for read-your-writes.
+ */
+void {{NAME}}_writebehind_flush ({{NAME}}_writebehind_t* self);
+
+/**
+ * @brief Retrieves the value associated with a key, as of the last applied batch (thread-safe).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to search for.
+ * @param value Output for the associated value, or NULL.
+ * @return true if the key was found, false otherwise.
+ */
+bool {{NAME}}_writebehind_get ({{NAME}}_writebehind_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}}* value);
+
+/**
+ * @brief Locks the tree for reading, so that the applier cannot modify the tree until released.
+ * @param self Pointer to the write-behind queue.
+ * @return Pointer to the tree, which must not be modified.
+ */
+{{NAME}}_t* {{NAME}}_writebehind_acquire ({{NAME}}_writebehind_t* self);
+
+/**
+ * @brief Unlocks the tree, which was locked by tree_writebehind_acquire().
+ * @param self Pointer to the write-behind queue.
+ */
+void {{NAME}}_writebehind_release ({{NAME}}_writebehind_t* self);
+
+/**
+ * @brief Retrieves the counters of a write-behind queue.
+ * @param self Pointer to the write-behind queue.
+ * @return Snapshot of the counters.
+ */
+{{NAME}}_writebehind_stats_t {{NAME}}_writebehind_stats ({{NAME}}_writebehind_t* self);
+{% end %}
+
+{% if CONCURRENT %}
+/**
+ * Forward declaration of the {{NAME}}_concurrent_t structure.
+ *
+ * A concurrent tree is a relaxed-balance AVL tree, which follows the optimistic concurrent AVL tree
+ * of Bronson, Casper, Chafi, and Olukotun (PPoPP 2010). Each node has its own spin lock and version number.
+ * Searches take no locks until they reach the node that holds the key; rather, they validate the version numbers
+ * of the nodes that they pass through, and retry whenever a rotation moved a subtree out from under them.
+ * Updates lock only the nodes that they modify; therefore, operations on disjoint keys proceed in parallel.
+ *
+ * Notes:
+ * - Removing a key whose node has two children only marks the node as a routing node.
+ *   Routing nodes are unlinked later, once rebalancing leaves them with fewer than two children.
+ * - Balance is restored after each update, but may be temporarily violated while concurrent updates are in progress.
+ * - Unlinked nodes may still be visited by concurrent searches; therefore, they are retired rather than freed,
+ *   until {{NAME}}_concurrent_collect() or {{NAME}}_concurrent_free() is called.
+ * - The comparator is invoked with NULL as its tree argument.
+ */
+typedef struct {{NAME}}_concurrent {{NAME}}_concurrent_t;
+
+/**
+ * @brief Creates a new concurrent tree using the natural ordering of keys.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+{{NAME}}_concurrent_t* {{NAME}}_concurrent_new ();
+
+/**
+ * @brief Creates a new concurrent tree with a specified comparator.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+{{NAME}}_concurrent_t* {{NAME}}_concurrent_make ({{NAME}}_comparator_t comparator);
+
+/**
+ * @brief Frees the resources of a concurrent tree, which must no longer be in use by any thread.
+ * @param self Pointer to the concurrent tree to free.
+ */
+void {{NAME}}_concurrent_free ({{NAME}}_concurrent_t* self);
+
+/**
+ * @brief Frees the nodes that were unlinked by removals, while no other thread is using the concurrent tree.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of nodes freed.
+ */
+size_t {{NAME}}_concurrent_collect ({{NAME}}_concurrent_t* self);
+
+/**
+ * @brief Retrieves the number of entries in the concurrent tree, which may be stale under concurrent use.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of entries in the concurrent tree.
+ */
+size_t {{NAME}}_concurrent_size ({{NAME}}_concurrent_t* self);
+
+/**
+ * @brief Inserts a key-value pair into the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool {{NAME}}_concurrent_put ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value);
+
+/**
+ * @brief Retrieves the value associated with a key in the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+{{VALUE_TYPE}} {{NAME}}_concurrent_get ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Checks if the concurrent tree contains a specific key (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to check for.
+ * @return true if the key is found, false otherwise.
+ */
+bool {{NAME}}_concurrent_containsKey ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Removes a key and its value from the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to remove.
+ */
+void {{NAME}}_concurrent_remove ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key);
+{% end %}
+
+{% if SERIALIZE %}
+/**
+ * @brief Writes a binary snapshot of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * A snapshot consists of a header (magic, format version, byte order, key size, value size, and entry count),
+ * the key-value pairs in ascending order, and a trailing 64-bit checksum of everything before it.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool {{NAME}}_save ({{NAME}}_t* self, int fd);
+
+/**
+ * @brief Reads a binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Loading fails, if the header does not match this tree's key and value types,
+ * if the data is truncated or fails the checksum, or if a node cannot be allocated.
+ * Since the entries are already sorted, an empty tree is built in linear time without any key comparisons.
+ * Otherwise, the entries are merged into the tree, replacing the values of keys that are already present.
+ */
+bool {{NAME}}_load ({{NAME}}_t* self, int fd);
+{% end %}
+
+{% if SERIALIZE %}
+/**
+ * @struct {{NAME}}_image_node
+ * @brief Node of a tree image, which links to its children by index rather than by address.
+ *
+ * The nodes of an image are stored in ascending order of their keys; therefore, the index of a node is also its rank.
+ */
+typedef struct {{NAME}}_image_node
+{
+    /**
+     * Index of the left child plus one, or zero if there is no left child.
+     */
+    uint64_t left;
+
+    /**
+     * Index of the right child plus one, or zero if there is no right child.
+     */
+    uint64_t right;
+
+    /**
+     * The key that identifies this node in the tree.
+     */
+    {{KEY_TYPE}} key;
+
+    /**
+     * The data stored in this node.
+     */
+    {{VALUE_TYPE}} value;
+
+} {{NAME}}_image_node_t;
+
+/**
+ * Forward declaration of the {{NAME}}_image_t structure.
+ *
+ * An image is a relocatable, read-only copy of a tree, which is memory-mapped from a file.
+ * Opening an image only validates its header; therefore, the time to open does not depend on the size of the tree.
+ * Lookups check each child link against the bounds implied by the path to it, so that a corrupt image cannot lead them
+ * outside of the mapping or into a cycle; it can still yield wrong results, which {{NAME}}_image_verify() detects.
+ * Lookups and iteration work directly on the mapped nodes, which the operating system pages in on demand.
+ */
+typedef struct {{NAME}}_image {{NAME}}_image_t;
+
+/**
+ * @brief Writes an image of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially.
+ * @return true if the image was written completely, false if an I/O error occurred.
+ *
+ * An image consists of a header, the nodes in ascending order, and a trailing 64-bit checksum.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool {{NAME}}_saveImage ({{NAME}}_t* self, int fd);
+
+/**
+ * @brief Maps an image using the natural ordering of keys.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+{{NAME}}_image_t* {{NAME}}_image_open (int fd, bool copy_on_write);
+
+/**
+ * @brief Maps an image with a specified comparator, which must be the comparator of the saved tree.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+{{NAME}}_image_t* {{NAME}}_image_make (int fd, bool copy_on_write, {{NAME}}_comparator_t comparator);
+
+/**
+ * @brief Unmaps an image and frees its resources.
+ * @param self Pointer to the image.
+ */
+void {{NAME}}_image_close ({{NAME}}_image_t* self);
+
+/**
+ * @brief Checks the checksum of an image, which reads the entire image.
+ * @param self Pointer to the image.
+ * @return true if the image is intact, false otherwise.
+ */
+bool {{NAME}}_image_verify ({{NAME}}_image_t* self);
+
+/**
+ * @brief Retrieves the number of nodes in an image.
+ * @param self Pointer to the image.
+ * @return Number of nodes in the image.
+ */
+size_t {{NAME}}_image_size ({{NAME}}_image_t* self);
+
+/**
+ * @brief Retrieves the node associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return Pointer to the node or NULL if not found.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_getNode ({{NAME}}_image_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Retrieves the value associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+{{VALUE_TYPE}} {{NAME}}_image_get ({{NAME}}_image_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Finds the successor node (next higher key) of a given key in an image.
+ * @param self Pointer to the image.
+ * @param key Key for which to find the higher node.
+ * @return Pointer to the higher node or NULL if not found.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_higherNode ({{NAME}}_image_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Finds the nth node (0-based index) in an image, in constant time.
+ * @param self Pointer to the image.
+ * @param index The index of the node to find.
+ * @return Pointer to the nth node or NULL if not found.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_nthNode ({{NAME}}_image_t* self, size_t index);
+
+/**
+ * @brief Retrieves the first node (minimum key) of an image.
+ * @param self Pointer to the image.
+ * @return Pointer to the first node or NULL if the image is empty.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_firstNode ({{NAME}}_image_t* self);
+
+/**
+ * @brief Retrieves the node after a given node (next higher key) of an image, in constant time.
+ * @param self Pointer to the image.
+ * @param node Pointer to a node of the image.
+ * @return Pointer to the next node or NULL if the given node is the last one.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_nextNode ({{NAME}}_image_t* self, {{NAME}}_image_node_t* node);
+{% end %}
+
+{% if WAL %}
+/**
+ * Forward declaration of the {{NAME}}_wal_t structure.
+ *
+ * A write-ahead log makes the mutations of a tree durable. Each put and remove is applied to the tree,
+ * and appended to a log file as a checksummed record. A background thread commits the records in groups,
+ * so that many records share a single fsync. Opening a log recovers the tree, by loading the last snapshot,
+ * and then replaying the log on top of it. Compaction writes a new snapshot and truncates the log.
+ *
+ * Notes:
+ * - A group is committed, when it holds group_size records, or when its first record is max_latency_ns old.
+ *   Larger groups and latencies trade commit latency for fewer fsyncs.
+ * - Replaying a log on top of a snapshot that already contains some of its records is harmless,
+ *   since the last record of each key determines its final state.
+ * - A torn record at the end of the log, which a crash may leave behind, is discarded during recovery.
+ * - The log serializes the mutations of the tree, but not concurrent reads of the tree.
+ */
+typedef struct {{NAME}}_wal {{NAME}}_wal_t;
+
+/**
+ * @brief Recovers a tree from a snapshot and a log, and then opens the log for appending.
+ * @param tree Pointer to the tree, which is usually empty, and which must only be mutated through the log from now on.
+ * @param snapshot_path Path of the snapshot file, which need not exist yet.
+ * @param log_path Path of the log file, which is created if it does not exist yet.
+ * @param group_size Maximum number of records committed by a single fsync.
+ * @param max_latency_ns Longest time that a record waits for its group to fill up, in nanoseconds.
+ * @return Pointer to the opened log or NULL if recovery failed.
+ */
+{{NAME}}_wal_t* {{NAME}}_wal_open ({{NAME}}_t* tree, const char* snapshot_path, const char* log_path, size_t group_size, uint64_t max_latency_ns);
+
+/**
+ * @brief Commits all pending records, closes the log, and frees its resources (but not the tree).
+ * @param self Pointer to the log.
+ * @return true if all records were committed, false if an I/O error occurred at any point.
+ */
+bool {{NAME}}_wal_close ({{NAME}}_wal_t* self);
+
+/**
+ * @brief Inserts a key-value pair into the tree and appends it to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return Sequence number of the record, or zero if the insertion failed or the log has failed.
+ */
+uint64_t {{NAME}}_wal_put ({{NAME}}_wal_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value);
+
+/**
+ * @brief Removes a key from the tree and appends the removal to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to remove.
+ * @return Sequence number of the record, or zero if the log has failed.
+ */
+uint64_t {{NAME}}_wal_remove ({{NAME}}_wal_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Waits until the record with a given sequence number, and all records before it, are durable.
+ * @param self Pointer to the log.
+ * @param sequence Sequence number returned by a put or remove.
+ * @return true if the records are durable, false if an I/O error occurred.
+ */
+bool {{NAME}}_wal_sync ({{NAME}}_wal_t* self, uint64_t sequence);
+
+/**
+ * @brief Writes a new snapshot of the tree and truncates the log, while mutations wait.
+ * @param self Pointer to the log.
+ * @return true if the compaction succeeded, false otherwise (a failed snapshot leaves the log intact).
+ */
+bool {{NAME}}_wal_compact ({{NAME}}_wal_t* self);
+
+/**
+ * @brief Counters describing the checkpoints of a write-ahead log.
+ */
+typedef struct
+{
+    /**
+     * Whether a checkpoint is currently running.
+     */
+    bool running;
+
+    /**
+     * Number of checkpoints that completed successfully.
+     */
+    uint64_t checkpoints;
+
+    /**
+     * Number of checkpoints that failed.
+     */
+    uint64_t failures;
+
+    /**
+     * Number of entries written by the current (or last) checkpoint so far.
+     */
+    uint64_t entries_written;
+
+    /**
+     * Size of the tree when the current (or last) checkpoint started, which estimates its total number of entries.
+     */
+    uint64_t entries_expected;
+
+    /**
+     * Number of bytes in the snapshot of the last completed checkpoint.
+     */
+    uint64_t bytes_written;
+
+    /**
+     * Sequence number of the last record covered by the snapshot of the last completed checkpoint.
+     */
+    uint64_t sequence;
+
+    /**
+     * Wall-clock duration of the last completed checkpoint, in nanoseconds.
+     */
+    uint64_t last_duration_ns;
+
+    /**
+     * Longest time that the last completed checkpoint held off writers at once, in nanoseconds.
+     */
+    uint64_t last_pause_ns;
+
+    /**
+     * Total duration of all completed checkpoints, in nanoseconds.
+     */
+    uint64_t total_duration_ns;
+
+} {{NAME}}_wal_checkpoint_stats_t;
+
+/**
+ * @brief Starts a checkpoint on a background thread, which writes a new snapshot while writers continue.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint was started, false if one is already running or the thread cannot be created.
+ *
+ * A checkpoint copies the tree in small chunks, locking out writers only while a chunk is copied.
+ * The resulting snapshot is fuzzy; it reflects each key at some point after the checkpoint started.
+ * Recovery still reaches the exact state, because the log keeps every record after that point.
+ * When the snapshot is durable, the log is replaced by just those records,
+ * which is the only other time when writers wait (for as long as the copy of these records takes).
+ *
+ * Notes:
+ * - The snapshot file is not valid on its own, but only together with the log. It may mix states from different
+ *   points in time, so it must not be loaded with {{NAME}}_load() alone, or be used as a backup or for a standby.
+ *   Use {{NAME}}_wal_compact(), or {{NAME}}_save() on a quiescent tree, for a consistent snapshot.
+ * - Every checkpoint rewrites the whole tree, so its cost grows with the size of the tree, not with the number of changes.
+ */
+bool {{NAME}}_wal_startCheckpoint ({{NAME}}_wal_t* self);
+
+/**
+ * @brief Waits until the checkpoint that was started last completes.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint succeeded, false if it failed or no checkpoint was ever started.
+ */
+bool {{NAME}}_wal_waitCheckpoint ({{NAME}}_wal_t* self);
+
+/**
+ * @brief Retrieves the progress and timing counters of the checkpoints of a log.
+ * @param self Pointer to the log.
+ * @return Copy of the counters.
+ */
+{{NAME}}_wal_checkpoint_stats_t {{NAME}}_wal_checkpointStats ({{NAME}}_wal_t* self);
+{% end %}
+
+{% if PACK_INTEGERS %}
+/**
+ * @brief Writes a packed binary snapshot of the AVL tree, whose keys and values are integers, to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * The entries are stored in blocks of 128. Within a block, the differences between consecutive keys,
+ * and the differences between the values and the smallest value, are bit-packed using the fewest bits
+ * that fit the largest difference (frame-of-reference encoding). Dense ascending keys take about one bit each.
+ * Like a plain snapshot, a packed snapshot has a header and a trailing checksum.
+ */
+bool {{NAME}}_savePacked ({{NAME}}_t* self, int fd);
+
+/**
+ * @brief Reads a packed binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Decoding a block takes fixed-width shifts and masks, followed by a prefix sum of the key differences,
+ * without any data-dependent branches.
+ */
+bool {{NAME}}_loadPacked ({{NAME}}_t* self, int fd);
+{% end %}
+
+{% if SUBTREE_HASH %}
+/**
+ * @brief Computes the hash of a single entry, which is the unit of the subtree hashes.
+ * @param key Key of the entry.
+ * @param value Data value of the entry.
+ * @return Hash of the bytes of the key and the value (pointers are hashed by address).
+ *
+ * The hash of a subtree is the sum, modulo 2^64, of the hashes of its entries.
+ * Hence, trees with the same entries have the same hash, regardless of their shapes.
+ * Values must only be changed using put(), setNode() or iter_set(), which keep the hashes up to date;
+ * after writing values through a node directly, call rehash().
+ */
+uint64_t {{NAME}}_hashEntry ({{KEY_TYPE}} key, {{VALUE_TYPE}} value);
+
+/**
+ * @brief Retrieves the hash of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Hash of the tree, which is zero, if the tree is empty.
+ */
+uint64_t {{NAME}}_hash ({{NAME}}_t* self);
+
+/**
+ * @brief Computes the hash of the entries, whose keys are in a half-open range, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Hash of the entries in the range.
+ */
+uint64_t {{NAME}}_hashRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi);
+
+/**
+ * @brief Finds the key ranges, where two AVL trees differ, by descending only into mismatched ranges.
+ * @param self Pointer to the AVL tree.
+ * @param other Pointer to the other AVL tree, which must use the same comparator.
+ * @param leaf_size Largest number of entries (in both trees together) of a reported range.
+ * @param callback Function that receives each range as an inclusive lower bound and an exclusive upper bound,
+ *                 where NULL means unbounded, and returns false to stop the search.
+ * @param context User-defined context for the callback.
+ * @return true if the search completed, false if the callback stopped it.
+ *
+ * The ranges are reported in ascending order. Equal trees are recognized in constant time,
+ * and k differences cost about O(k log^2 n) time, independent of the shapes of the trees.
+ * A reported range, which holds more than one entry, may also contain some equal entries.
+ */
+bool {{NAME}}_mismatches ({{NAME}}_t* self, {{NAME}}_t* other, size_t leaf_size, bool (*callback)({{NAME}}_t*, {{KEY_TYPE}}*, {{KEY_TYPE}}*, void*), void* context);
+
+/**
+ * @brief Recomputes the hashes of all of the subtrees in linear time.
+ * @param self Pointer to the AVL tree.
+ */
+void {{NAME}}_rehash ({{NAME}}_t* self);
+{% end %}
+
+{% if DISK %}
+/**
+ * Forward declaration of the {{NAME}}_disk_t structure.
+ *
+ * A disk tree is a B+ tree, whose nodes are fixed-size pages in a file, for maps that do not fit in memory.
+ * Only a bounded number of pages are cached in memory at once. When the cache is full, a page is evicted
+ * using the CLOCK algorithm (an approximation of LRU), which writes the page back first, if it is dirty.
+ * Pages are read and written using pread() and pwrite(). Its functions mirror the functions of the AVL tree.
+ *
+ * Notes:
+ * - Keys and values are copied byte for byte; therefore, they must be plain old data.
+ * - Removals do not merge pages. An emptied page stays in the tree, and is reused by later puts into its key range.
+ * - Changes are written to the file, when pages are evicted, and by flush() and close(). A crash in between may
+ *   leave the file inconsistent; therefore, use snapshots or a write-ahead log, where durability matters.
+ * - A disk tree is not thread-safe.
+ */
+typedef struct {{NAME}}_disk {{NAME}}_disk_t;
+
+/**
+ * @brief Counters describing the page cache of a disk tree.
+ */
+typedef struct
+{
+    /**
+     * Number of page accesses that found the page in the cache.
+     */
+    uint64_t hits;
+
+    /**
+     * Number of page accesses that did not find the page in the cache.
+     */
+    uint64_t misses;
+
+    /**
+     * Number of pages that were evicted from the cache, to make room for other pages.
+     */
+    uint64_t evictions;
+
+    /**
+     * Number of pages read from the file.
+     */
+    uint64_t reads;
+
+    /**
+     * Number of pages written to the file.
+     */
+    uint64_t writes;
+
+    /**
+     * Number of pages in the file, including the header page.
+     */
+    uint64_t pages;
+
+    /**
+     * Number of pages that the cache holds.
+     */
+    size_t cache_pages;
+
+    /**
+     * Number of batches of page reads, which getMany() issued at once.
+     */
+    uint64_t batches;
+{% if IO_URING %}
+
+    /**
+     * Whether the batches are read using io_uring, rather than a pool of threads calling pread().
+     */
+    bool io_uring;
+{% end %}
+
+} {{NAME}}_disk_stats_t;
+
+/**
+ * @brief Iterator over the entries of a disk tree, which holds a copy of the current entry.
+ *
+ * Unlike the iterator of the AVL tree, it does not refer to any page; however, a put into the tree may move
+ * the entries that have not been visited yet; therefore, the iterator must not be used after a put.
+ */
+typedef struct
+{
+    /**
+     * Pointer to the disk tree.
+     */
+    {{NAME}}_disk_t* owner;
+
+    /**
+     * Number of the leaf page holding the next entry, or zero if there are no more entries.
+     */
+    uint64_t page;
+
+    /**
+     * Index of the next entry within its leaf page.
+     */
+    size_t index;
+
+    /**
+     * The key of the current entry.
+     */
+    {{KEY_TYPE}} key;
+
+    /**
+     * The data value of the current entry.
+     */
+    {{VALUE_TYPE}} value;
+
+} {{NAME}}_disk_iterator_t;
+
+/**
+ * @brief Opens a disk tree using the natural ordering of keys, and creates the file if it does not exist yet.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
+ */
+{{NAME}}_disk_t* {{NAME}}_disk_open (const char* path, size_t cache_pages);
+
+/**
+ * @brief Opens a disk tree with a specified comparator, which must be the same every time the file is opened.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
+ */
+{{NAME}}_disk_t* {{NAME}}_disk_make (const char* path, size_t cache_pages, {{NAME}}_comparator_t comparator);
+
+/**
+ * @brief Writes all dirty pages and the header to the file, and then syncs the file.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
+ */
+bool {{NAME}}_disk_flush ({{NAME}}_disk_t* self);
+
+/**
+ * @brief Flushes a disk tree, closes its file, and frees its resources.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
+ */
+bool {{NAME}}_disk_close ({{NAME}}_disk_t* self);
+
+/**
+ * @brief Retrieves the number of entries in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Number of entries in the disk tree.
+ */
+size_t {{NAME}}_disk_size ({{NAME}}_disk_t* self);
+
+/**
+ * @brief Retrieves the value associated with a key in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found (or if the page could not be read).
+ */
+{{VALUE_TYPE}} {{NAME}}_disk_get ({{NAME}}_disk_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Checks if a key exists in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return true if the key exists, false otherwise.
+ */
+bool {{NAME}}_disk_containsKey ({{NAME}}_disk_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Retrieves the values associated with many keys in a disk tree, reading the missing pages in batches.
+ * @param self Pointer to the disk tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
+ *
+ * The lookups descend the tree together, one level at a time. On each level, the pages that are not cached
+ * are read concurrently, using io_uring if available, or else a small pool of threads calling pread().
+ * Hence, the latencies of the reads overlap, instead of adding up as they do in a loop of get().
+ */
+size_t {{NAME}}_disk_getMany ({{NAME}}_disk_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, bool* found, size_t count);
+
+/**
+ * @brief Inserts a key-value pair into a disk tree, or replaces the value of an existing key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false if a page could not be read, written, or cached.
+ */
+bool {{NAME}}_disk_put ({{NAME}}_disk_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value);
+
+/**
+ * @brief Removes a key from a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to remove.
+ * @return true if the key was removed, false if it was not found (or if a page could not be read).
+ */
+bool {{NAME}}_disk_remove ({{NAME}}_disk_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Creates an iterator, which starts before the first entry of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Iterator over the entries in ascending order of keys.
+ */
+{{NAME}}_disk_iterator_t {{NAME}}_disk_iter ({{NAME}}_disk_t* self);
+
+/**
+ * @brief Creates an iterator, which starts before the first entry, whose key is not less than a given key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to start at.
+ * @return Iterator over the remaining entries in ascending order of keys.
+ */
+{{NAME}}_disk_iterator_t {{NAME}}_disk_iter_at ({{NAME}}_disk_t* self, {{KEY_TYPE}} key);
+
+/**
+ * @brief Checks if there are more entries to iterate over.
+ * @param self Pointer to the iterator.
+ * @return true if there is a next entry, false otherwise.
+ */
+bool {{NAME}}_disk_iter_hasNext ({{NAME}}_disk_iterator_t* self);
+
+/**
+ * @brief Moves the iterator to the next entry, and copies that entry into the iterator.
+ * @param self Pointer to the iterator.
+ */
+void {{NAME}}_disk_iter_next ({{NAME}}_disk_iterator_t* self);
+
+/**
+ * @brief Retrieves the key of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Key of the current entry.
+ */
+{{KEY_TYPE}} {{NAME}}_disk_iter_key ({{NAME}}_disk_iterator_t* self);
+
+/**
+ * @brief Retrieves the data value of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Data value of the current entry.
+ */
+{{VALUE_TYPE}} {{NAME}}_disk_iter_get ({{NAME}}_disk_iterator_t* self);
+
+/**
+ * @brief Retrieves the counters of the page cache of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Copy of the counters.
+ */
+{{NAME}}_disk_stats_t {{NAME}}_disk_stats ({{NAME}}_disk_t* self);
+{% if IO_URING %}
+
+/**
+ * @brief Chooses whether the batches of page reads use io_uring or the pool of threads.
+ * @param self Pointer to the disk tree.
+ * @param enabled Whether io_uring should be used, which is the default.
+ * @return true if io_uring is used from now on, false if the pool of threads is used (io_uring may be unavailable).
+ */
+bool {{NAME}}_disk_setIoUring ({{NAME}}_disk_t* self, bool enabled);
+{% end %}
+{% end %}
+
+{% if AGGREGATE %}
+/**
+ * @brief Retrieves the identity of the aggregate, which is the aggregate of an empty range.
+ * @return Identity of the combine operation.
+ *
+ * Each node stores the aggregate of its subtree, which is maintained by the insertions, removals and rotations.
+ * The aggregate of an entry, the combine operation and its identity are given to the generator, and must form
+ * a monoid: the combine operation must be associative, but it need not be commutative.
+ * Values must only be changed using put(), setNode() or iter_set(), which keep the aggregates up to date;
+ * after writing values through a node directly, call reaggregate().
+ */
+{{AGGREGATE_TYPE}} {{NAME}}_aggregateIdentity ();
+
+/**
+ * @brief Retrieves the aggregate of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Aggregate of the tree, which is the identity, if the tree is empty.
+ */
+{{AGGREGATE_TYPE}} {{NAME}}_aggregate ({{NAME}}_t* self);
+
+/**
+ * @brief Computes the aggregate of the entries, whose keys are in a half-open range, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Aggregate of the entries in the range, combined in key order.
+ */
+{{AGGREGATE_TYPE}} {{NAME}}_aggregateRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi);
+
+/**
+ * @brief Recomputes the aggregates of all of the subtrees in linear time.
+ * @param self Pointer to the AVL tree.
+ */
+void {{NAME}}_reaggregate ({{NAME}}_t* self);
+{% end %}
+
+#endif // {{NAME}}_H
+
+{{COPYRIGHT_FOOTER}}
+'''
+
+TREE_TEMPLATE_C = '''
+{% autoescape None %}
+
+{{COPYRIGHT_HEADER}}
+
+#include "{{HEADER}}"
+
+{% if PARALLEL or WRITE_BEHIND or WAL or DISK %}
+#include <pthread.h>
+{% end %}
+{% if MULTIQUEUE or WRITE_BEHIND or CONCURRENT or IO_URING %}
+#include <stdatomic.h>
+{% end %}
+{% if WRITE_BEHIND or CONCURRENT %}
+#include <sched.h>
+{% end %}
+{% if WAL %}
+#include <stdio.h>
+{% end %}
+{% if WRITE_BEHIND or WAL %}
+#include <time.h>
+{% end %}
+{% if SERIALIZE %}
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+{% end %}
+{% if IO_URING %}
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+{% end %}
+
+typedef struct
+{
+    size_t allocated;
+
+    size_t capacity;
+
+    {{NAME}}_node_t* free;
+
+} {{NAME}}_allocator_pooled_t;
+
+typedef struct
+{
+    size_t capacity;
+
+    {{NAME}}_node_t* free;
+
+    {{NAME}}_node_t nodes[];
+
+} {{NAME}}_allocator_slab_t;
+
+static int32_t height_of ({{NAME}}_node_t* node)
+{
+    return NULL == node ? 0 : node->height;
+}
+
+static size_t size_of ({{NAME}}_node_t* node)
+{
+    return NULL == node ? 0 : node->size;
+}
+{% if SUBTREE_HASH %}
+
+static uint64_t hash_of ({{NAME}}_node_t* node)
+{
+    return NULL == node ? 0 : node->hash;
+}
+
+/**
+ * Finalizer of the splitmix64 generator, which spreads every input bit over the whole word.
+ */
+static uint64_t hash_mix (uint64_t x)
+{
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+static uint64_t hash_entry ({{KEY_TYPE}}* key, {{VALUE_TYPE}}* value)
+{
+    unsigned char bytes[sizeof({{KEY_TYPE}}) + sizeof({{VALUE_TYPE}})];
+    memcpy(bytes, key, sizeof({{KEY_TYPE}}));
+    memcpy(bytes + sizeof({{KEY_TYPE}}), value, sizeof({{VALUE_TYPE}}));
+
+    uint64_t hash = UINT64_C(0x9E3779B97F4A7C15);
+    size_t i = 0;
+
+    for (; i + 8 <= sizeof(bytes); i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = hash_mix(hash ^ word);
+    }
+
+    if (i < sizeof(bytes))
+    {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, sizeof(bytes) - i);
+        hash = hash_mix(hash ^ word);
+    }
+
+    return hash_mix(hash ^ sizeof(bytes));
+}
+{% end %}
+{% if AGGREGATE %}
+
+static {{AGGREGATE_TYPE}} aggregate_entry ({{KEY_TYPE}}* K, {{VALUE_TYPE}}* V)
+{
+    return {{AGGREGATE_ENTRY}};
+}
+
+static {{AGGREGATE_TYPE}} aggregate_combine ({{AGGREGATE_TYPE}}* X, {{AGGREGATE_TYPE}}* Y)
+{
+    return {{AGGREGATE_COMBINE}};
+}
+
+static {{AGGREGATE_TYPE}} aggregate_of ({{NAME}}_node_t* node)
+{
+    if (NULL == node)
+    {
+        {{AGGREGATE_TYPE}} identity = {{AGGREGATE_IDENTITY}};
+        return identity;
+    }
+    else
+    {
+        return node->aggregate;
+    }
+}
+
+/**
+ * Combines the aggregates of the left subtree, the node itself and the right subtree, in this order.
+ */
+static {{AGGREGATE_TYPE}} aggregate_node ({{NAME}}_node_t* node)
+{
+    {{AGGREGATE_TYPE}} left = aggregate_of(node->left);
+    {{AGGREGATE_TYPE}} entry = aggregate_entry(&node->key, &node->value);
+    {{AGGREGATE_TYPE}} right = aggregate_of(node->right);
+    {{AGGREGATE_TYPE}} result = aggregate_combine(&left, &entry);
+    return aggregate_combine(&result, &right);
+}
+{% end %}
+
+static int8_t balance_of ({{NAME}}_node_t* node)
+{
+    if (NULL == node)
+    {
+        return 0;
+    }
+    else
+    {
+        return height_of(node->left) - height_of(node->right);
+    }
+}
+
+/**
+ * Turns a freshly allocated node into a leaf with the given key, and counts it in the size of the tree.
+ */
+static {{NAME}}_node_t* init_node ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key)
+{
+    ++self->size;
+    node->key = *key;
+{% if SUBTREE_HASH or AGGREGATE %}
+    // The hash and the aggregate of the node cover its value, which must therefore be defined, until the caller sets it.
+    memset(&node->value, 0, sizeof({{VALUE_TYPE}}));
+{% end %}
+{% if SUBTREE_HASH %}
+    node->hash = hash_entry(&node->key, &node->value);
+{% end %}
+{% if AGGREGATE %}
+    node->aggregate = aggregate_entry(&node->key, &node->value);
+{% end %}
+    node->height = 0;
+    node->size = 1;
+    node->left = NULL;
+    node->right = NULL;
+    return node;
+}
+
+static {{NAME}}_node_t* create_node ({{NAME}}_t* self, {{KEY_TYPE}}* key)
+{
+    {{NAME}}_node_t* node = self->allocator->allocate(self->allocator);
+
+    if (NULL == node)
+    {
+        return NULL;
+    }
+    else
+    {
+        return init_node(self, node, key);
+    }
+}
+
+static int8_t max (int8_t x, int8_t y)
+{
+    return x > y ? x : y;
+}
+
+static void update_size ({{NAME}}_node_t* node)
+{
+    if (NULL != node)
+    {
+        node->size = 1 + size_of(node->left) + size_of(node->right);
+{% if SUBTREE_HASH %}
+        node->hash = hash_entry(&node->key, &node->value) + hash_of(node->left) + hash_of(node->right);
+{% end %}
+{% if AGGREGATE %}
+        node->aggregate = aggregate_node(node);
+{% end %}
+    }
+}
+
+static void update_height ({{NAME}}_node_t* node)
+{
+    if (NULL != node)
+    {
+        if ((NULL == node->left) && (NULL == node->right))
+        {
+            node->height = 0;
+        }
+        else if (NULL == node->left)
+        {
+            node->height = 1 + node->right->height;
+        }
+        else if (NULL == node->right)
+        {
+            node->height = 1 + node->left->height;
+        }
+        else
+        {
+            node->height = 1 + max(node->left->height, node->right->height);
+        }
+    }
+}
+
+static {{NAME}}_node_t* rotate_right ({{NAME}}_node_t* y)
+{
+    if (NULL == y || NULL == y->left)
+    {
+        return y;
+    }
+
+    {{NAME}}_node_t* x = y->left;
+    {{NAME}}_node_t* z = x->right;
+
+    x->right = y;
+    y->left = z;
+
+    update_height(z);
+    update_height(y);
+    update_height(x);
+
+    update_size(z);
+    update_size(y);
+    update_size(x);
+
+    return x;
+}
+
+static {{NAME}}_node_t* rotate_left ({{NAME}}_node_t* x)
+{
+    if (NULL == x || NULL == x->right)
+    {
+        return x;
+    }
+
+    {{NAME}}_node_t* y = x->right;
+    {{NAME}}_node_t* z = y->left;
+
+    y->left = x;
+    x->right = z;
+
+    update_height(z);
+    update_height(x);
+    update_height(y);
+
+    update_size(z);
+    update_size(x);
+    update_size(y);
+
+    return y;
+}
+
+static {{NAME}}_node_t* rebalance ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key)
+{
+    if (NULL == node)
+    {
+        return NULL;
+    }
+
+    update_height(node);
+    update_size(node);
+
+    const int8_t balance = balance_of(node);
+
+    if (balance > 1)
+    {
+        const int32_t ordering = self->comparator(self, key, &node->left->key);
+
+        if (ordering < 0)
+        {
+            node = rotate_right(node);
+        }
+        else if (ordering > 0)
+        {
+            node->left = rotate_left(node->left);
+            node = rotate_right(node);
+        }
+    }
+    else if (balance < -1)
+    {
+        const int32_t ordering = self->comparator(self, key, &node->right->key);
+
+        if (ordering > 0)
+        {
+            node = rotate_left(node);
+        }
+        else if (ordering < 0)
+        {
+            node->right = rotate_right(node->right);
+            node = rotate_left(node);
+        }
+    }
+
+    return node;
+}
+
+/**
+ * Restores the balance of a node, whose subtrees differ in height by at most two,
+ * without consulting any keys (unlike rebalance(), which is specific to a single insertion).
+ */
+static {{NAME}}_node_t* balance_node ({{NAME}}_node_t* node)
+{
+    if (NULL == node)
+    {
+        return NULL;
+    }
+
+    update_height(node);
+    update_size(node);
+
+    const int8_t balance = balance_of(node);
+
+    if (balance > 1)
+    {
+        if (balance_of(node->left) < 0)
+        {
+            node->left = rotate_left(node->left);
+        }
+
+        node = rotate_right(node);
+    }
+    else if (balance < -1)
+    {
+        if (balance_of(node->right) > 0)
+        {
+            node->right = rotate_right(node->right);
+        }
+
+        node = rotate_left(node);
+    }
+
+    return node;
+}
+
+static {{NAME}}_node_t* join_right ({{NAME}}_node_t* left, {{NAME}}_node_t* pivot, {{NAME}}_node_t* right)
+{
+    // Descend the right spine of the taller left tree, until the heights are close enough.
+    if (height_of(left->right) <= height_of(right) + 1)
+    {
+        pivot->left = left->right;
+        pivot->right = right;
+        update_height(pivot);
+        update_size(pivot);
+        left->right = pivot;
+    }
+    else
+    {
+        left->right = join_right(left->right, pivot, right);
+    }
+
+    return balance_node(left);
+}
+
+static {{NAME}}_node_t* join_left ({{NAME}}_node_t* left, {{NAME}}_node_t* pivot, {{NAME}}_node_t* right)
+{
+    // Descend the left spine of the taller right tree, until the heights are close enough.
+    if (height_of(right->left) <= height_of(left) + 1)
+    {
+        pivot->left = left;
+        pivot->right = right->left;
+        update_height(pivot);
+        update_size(pivot);
+        right->left = pivot;
+    }
+    else
+    {
+        right->left = join_left(left, pivot, right->left);
+    }
+
+    return balance_node(right);
+}
+
+/**
+ * Joins two trees and a pivot node into one balanced tree in O(|height(left) - height(right)|),
+ * provided that every key in the left tree is less than the pivot key,
+ * which is in turn less than every key in the right tree.
+ */
+static {{NAME}}_node_t* join_nodes ({{NAME}}_node_t* left, {{NAME}}_node_t* pivot, {{NAME}}_node_t* right)
+{
+    if (height_of(left) > height_of(right) + 1)
+    {
+        return join_right(left, pivot, right);
+    }
+    else if (height_of(right) > height_of(left) + 1)
+    {
+        return join_left(left, pivot, right);
+    }
+    else
+    {
+        pivot->left = left;
+        pivot->right = right;
+        update_height(pivot);
+        update_size(pivot);
+        return pivot;
+    }
+}
+
+/**
+ * Detaches the minimum node of a (non-empty) subtree and returns the rebalanced remainder.
+ */
+static {{NAME}}_node_t* detach_first ({{NAME}}_node_t* node, {{NAME}}_node_t** first)
+{
+    if (NULL == node->left)
+    {
+        *first = node;
+        return node->right;
+    }
+    else
+    {
+        node->left = detach_first(node->left, first);
+        return balance_node(node);
+    }
+}
+
+/**
+ * Joins two trees without a pivot node, where every key in the left tree is less than every key in the right tree.
+ */
+static {{NAME}}_node_t* join_trees ({{NAME}}_node_t* left, {{NAME}}_node_t* right)
+{
+    if (NULL == left)
+    {
+        return right;
+    }
+    else if (NULL == right)
+    {
+        return left;
+    }
+    else
+    {
+        {{NAME}}_node_t* pivot = NULL;
+        right = detach_first(right, &pivot);
+        return join_nodes(left, pivot, right);
+    }
+}
+
+/**
+ * Inserts a node with a key, unless the key is already in the subtree, and sets its value, unless the value is NULL.
+ * The inserted or found node is stored in the output, or NULL if the allocation failed.
+ * Since the path is rebalanced as the recursion unwinds, the sizes, hashes, and aggregates on it are also updated.
+ */
+static {{NAME}}_node_t* insert_node ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key, {{VALUE_TYPE}}* value, {{NAME}}_node_t** inserted)
+{
+    if (node == NULL)
+    {
+        node = create_node(self, key);
+        *inserted = node;
+
+        if (NULL != node && NULL != value)
+        {
+            node->value = *value;
+            update_size(node);
+        }
+
+        return node;
+    }
+
+    const int ordering = self->comparator(self, key, &node->key);
+
+    if (ordering < 0)
+    {
+        node->left = insert_node(self, node->left, key, value, inserted);
+        return rebalance(self, node, key);
+    }
+    else if (ordering > 0)
+    {
+        node->right = insert_node(self, node->right, key, value, inserted);
+        return rebalance(self, node, key);
+    }
+    else
+    {
+        *inserted = node;
+
+        if (NULL != value)
+        {
+            node->value = *value;
+            update_size(node);
+        }
+
+        return node;
+    }
+}
+
+static {{NAME}}_node_t* delete_node ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key, {{NAME}}_node_t** deleted)
+{
+    if (node == NULL)
+    {
+        return NULL; // Key Not Found
+    }
+
+    // Case: The node to delete is in the left subtree.
+    if (self->comparator(self, key, &node->key) < 0)
+    {
+        node->left = delete_node(self, node->left, key, deleted);
+    }
+    // Case: The node to delete is in the right subtree.
+    else if (self->comparator(self, key, &node->key) > 0)
+    {
+        node->right = delete_node(self, node->right, key, deleted);
+    }
+    // Case: The node to delete does not have any children.
+    else if (node->size == 1)
+    {
+        *deleted = node;
+        return NULL;
+    }
+    // Case: The node to delete only has a right subtree.
+    else if (node->left == NULL)
+    {
+        *deleted = node;
+        node = node->right;
+    }
+    // Case: The node to delete only has a left subtree.
+    else if (node->right == NULL)
+    {
+        *deleted = node;
+        node = node->left;
+    }
+    // Case: The node to delete has both a left subtree and a right subtree.
+    else
+    {
+        *deleted = node;
+
+        // Detach the inorder successor, which has no left subtree by-definition,
+        // and then put the successor in place of the deleted node.
+        {{NAME}}_node_t* successor = NULL;
+        {{NAME}}_node_t* right = detach_first(node->right, &successor);
+        successor->left = node->left;
+        successor->right = right;
+        node = successor;
+    }
+
+    // The rotations needed after a deletion cannot be chosen by comparing keys, unlike after an insertion.
+    return balance_node(node);
+}
+
+static {{NAME}}_node_t* find_node ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key)
+{
+    if (NULL == node)
+    {
+        return NULL;
+    }
+    else if (self->comparator(self, key, &node->key) < 0)
+    {
+        return find_node(self, node->left, key);
+    }
+    else if (self->comparator(self, key, &node->key) > 0)
+    {
+        return find_node(self, node->right, key);
+    }
+    else
+    {
+        return node;
+    }
+}
+
+/**
+ * The dynamic allocator does not need any resources;
+ * therefore, statically allocate the dynamic allocator.
+ */
+static {{NAME}}_allocator_t TREE_DYNAMIC_ALLOCATOR;
+
+static {{NAME}}_node_t* dynamic_allocate ({{NAME}}_allocator_t* self)
+{
+    return calloc(1, sizeof({{NAME}}_node_t));
+}
+
+static void wipe ({{NAME}}_node_t* self)
+{
+{% if WIPE %}
+    if (NULL != self)
+    {
+        memset(self, 0, sizeof({{NAME}}_node_t));
+    }
+{% end %}
+}
+
+static void dynamic_release ({{NAME}}_allocator_t* self, {{NAME}}_node_t* node)
+{
+    if (NULL != node)
+    {
+        wipe(node);
+        free(node);
+    }
+}
+
+static void dynamic_destroy ({{NAME}}_allocator_t* self)
+{
+    // Pass, because the dynamic allocator is statically allocated.
+}
+
+static {{NAME}}_node_t* pool_allocate ({{NAME}}_allocator_t* self)
+{
+    {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) self->context;
+
+    if (NULL == context->free)
+    {
+        if (context->allocated < context->capacity)
+        {
+            {{NAME}}_node_t* node = ({{NAME}}_node_t*) calloc(1, sizeof({{NAME}}_node_t));
+
+            if (NULL == node)
+            {
+                return NULL;
+            }
+            else
+            {
+                ++context->allocated;
+                return node;
+            }
+        }
+        else
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        {{NAME}}_node_t* node = context->free;
+        context->free = context->free->right;
+        return node;
+    }
+}
+
+static void pool_release ({{NAME}}_allocator_t* self, {{NAME}}_node_t* node)
+{
+    wipe(node);
+    {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) self->context;
+    node->right = context->free;
+    context->free = node;
+}
+
+static void pool_destroy ({{NAME}}_allocator_t* self)
+{
+    if (NULL != self)
+    {
+        {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) self->context;
+
+        if (NULL != context)
+        {
+            {{NAME}}_node_t* p = context->free;
+            {{NAME}}_node_t* q = NULL;
+            while (NULL != p)
+            {
+                q = p->right;
+                free(p);
+                p = q;
+            }
+
+            context->free = NULL;
+
+            free(context);
+            self->context = NULL;
+        }
+
+        free(self);
+    }
+}
+
+static {{NAME}}_node_t* slab_allocate ({{NAME}}_allocator_t* self)
+{
+    {{NAME}}_allocator_slab_t* context = ({{NAME}}_allocator_slab_t*) self->context;
+
+    if (NULL == context->free)
+    {
+        return NULL;
+    }
+    else
+    {
+        {{NAME}}_node_t* node = context->free;
+        context->free = context->free->right;
+        return node;
+    }
+}
+
+static void slab_release ({{NAME}}_allocator_t* self, {{NAME}}_node_t* node)
+{
+    wipe(node);
+    {{NAME}}_allocator_slab_t* context = ({{NAME}}_allocator_slab_t*) self->context;
+    node->right = context->free;
+    context->free = node;
+}
+
+static void slab_destroy ({{NAME}}_allocator_t* self)
+{
+    if (NULL != self)
+    {
+        if (NULL != self->context)
+        {
+            free(self->context);
+            self->context = NULL;
+        }
+
+        free(self);
+    }
+}
+
+/**
+ * @brief Creates a new dynamic tree allocator.
+ * @return Pointer to the newly created tree allocator.
+ */
+{{NAME}}_allocator_t* {{NAME}}_allocator_dynamic ()
+{
+    TREE_DYNAMIC_ALLOCATOR.allocate = &dynamic_allocate;
+    TREE_DYNAMIC_ALLOCATOR.release = &dynamic_release;
+    TREE_DYNAMIC_ALLOCATOR.destroy = &dynamic_destroy;
+    return &TREE_DYNAMIC_ALLOCATOR;
+}
+
+/**
+ * @brief Creates a new pooled tree allocator with preallocated nodes.
+ * @param preallocated Number of nodes to preallocate.
+ * @param capacity Maximum capacity of the pooled allocator.
+ * @return Pointer to the newly created pooled tree allocator.
+ */
+{{NAME}}_allocator_t* {{NAME}}_allocator_pooled (size_t preallocated, size_t capacity)
+{
+    {{NAME}}_allocator_t* self = ({{NAME}}_allocator_t*) calloc(1, sizeof({{NAME}}_allocator_t));
+
+    if (NULL == self)
+    {
+        goto cleanup;
+    }
+    else
+    {
+        self->allocate = pool_allocate;
+        self->release = pool_release;
+        self->destroy = pool_destroy;
+    }
+
+    {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) calloc(1, sizeof({{NAME}}_allocator_pooled_t));
+
+    if (NULL == self)
+    {
+        goto cleanup;
+    }
+    else
+    {
+        self->context = (void*) context;
+        context->capacity = capacity;
+        context->allocated = preallocated;
+    }
+
+    for (size_t i = 0; i < preallocated; i++)
+    {
+        {{NAME}}_node_t* node = calloc(1, sizeof({{NAME}}_node_t));
+
+        if (NULL == node)
+        {
+            goto cleanup;
+        }
+        else
+        {
+            node->right = context->free;
+            context->free = node;
+        }
+    }
+
+    return self;
+
+cleanup:
+    pool_destroy(self);
+    return NULL;
+}
+
+/**
+ * @brief Creates a new slab tree allocator with a specified capacity.
+ * @param capacity Maximum capacity of the slab allocator.
+ * @return Pointer to the newly created slab tree allocator.
+ */
+{{NAME}}_allocator_t* {{NAME}}_allocator_slab (size_t capacity)
+{
+    {{NAME}}_allocator_t* self = ({{NAME}}_allocator_t*) calloc(1, sizeof({{NAME}}_allocator_t) + capacity * sizeof({{NAME}}_node_t));
+
+    if (NULL == self)
+    {
+        goto cleanup;
+    }
+    else
+    {
+        self->allocate = slab_allocate;
+        self->release = slab_release;
+        self->destroy = slab_destroy;
+    }
+
+    {{NAME}}_allocator_slab_t* context = ({{NAME}}_allocator_slab_t*) calloc(1, sizeof({{NAME}}_allocator_slab_t) + capacity * sizeof({{NAME}}_node_t));
+
+    if (NULL == self)
+    {
+        goto cleanup;
+    }
+    else
+    {
+        self->context = (void*) context;
+        context->capacity = capacity;
+    }
+
+    for (size_t i = 0; i < capacity; i++)
+    {
+        {{NAME}}_node_t* node = &context->nodes[i];
+
+        if (NULL == node)
+        {
+            goto cleanup;
+        }
+        else
+        {
+            node->right = context->free;
+            context->free = node;
+        }
+    }
+
+    return self;
+
+cleanup:
+    slab_destroy(self);
+    return NULL;
+}
+
+/**
+ * @brief Frees the resources associated with a tree allocator.
+ * @param self Pointer to the tree allocator to free.
+ */
+void {{NAME}}_allocator_free ({{NAME}}_allocator_t* self)
+{
+    if (NULL != self)
+    {
+        self->destroy(self);
+    }
+}
+
+static int {{NAME}}_naturalOrder ({{NAME}}_t* self, {{KEY_TYPE}}* X, {{KEY_TYPE}}* Y)
+{
+{% if COMPARATOR != "" %}
+    return {{COMPARATOR}};
+{% elif STRNCMP != "" %}
+    return strncmp(X, Y, {{STRNCMP}});
+{% else %}
+    return *X < *Y ? -1 : (*X > *Y ? +1 : 0);
+{% end %}
+}
+
+static int {{NAME}}_reverseOrder ({{NAME}}_t* self, {{KEY_TYPE}}* X, {{KEY_TYPE}}* Y)
+{
+    return {{NAME}}_naturalOrder(self, Y, X);
+}
+
+/**
+ * @brief Returns the natural order comparator function for keys.
+ * @return Function pointer to the natural order comparator.
+ */
+{{NAME}}_comparator_t {{NAME}}_comparator_naturalOrder ()
+{
+    return &{{NAME}}_naturalOrder;
+}
+
+/**
+ * @brief Returns the reverse order comparator function for keys.
+ * @return Function pointer to the reverse order comparator.
+ */
+{{NAME}}_comparator_t {{NAME}}_comparator_reverseOrder ()
+{
+    return &{{NAME}}_reverseOrder;
+}
+
+/**
+ * @brief Returns the default key value.
+ * @return Default key.
+ */
+{{KEY_TYPE}} {{NAME}}_defaultKey ()
+{
+{% if DEFAULT_KEY == "" %}
+    return 0;
+{% else %}
+    return {{DEFAULT_KEY}};
+{% end %}
+}
+
+/**
+ * @brief Returns the default data value.
+ * @return Default data value.
+ */
+{{VALUE_TYPE}} {{NAME}}_defaultValue ()
+{
+{% if DEFAULT_VALUE == "" %}
+    return 0;
+{% else %}
+    return {{DEFAULT_VALUE}};
+{% end %}
+}
+
+/**
+ * @brief Creates a new instance of the AVL tree.
+ * @return Pointer to the newly created AVL tree.
+ */
+{{NAME}}_t* {{NAME}}_new ()
+{
+    {{NAME}}_allocator_t* allocator = {{NAME}}_allocator_dynamic();
+    {{NAME}}_comparator_t comparator = {{NAME}}_comparator_naturalOrder();
+    return {{NAME}}_make(allocator, comparator);
+}
+
+/**
+ * @brief Creates a new AVL tree with a specified allocator and comparator.
+ * @param allocator Pointer to the tree allocator.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created AVL tree.
+ */
+{{NAME}}_t* {{NAME}}_make ({{NAME}}_allocator_t* allocator, {{NAME}}_comparator_t comparator)
+{
+    {{NAME}}_t* result = calloc(1, sizeof({{NAME}}_t));
+
+    if (NULL == result)
+    {
+        return NULL;
+    }
+
+    result->allocator = allocator;
+    result->size = 0;
+    result->root = NULL;
+    result->comparator = comparator;
+
+    return result;
+}
+
+/**
+ * @brief Frees the resources of an AVL tree.
+ * @param self Pointer to the AVL tree to free.
+ */
+void {{NAME}}_free ({{NAME}}_t* self)
+{
+    if (NULL != self)
+    {
+        {{NAME}}_clear(self);
+        self->allocator = NULL;
+        free(self);
+    }
+}
+
+/**
+ * @brief Creates an AVL tree with stack-allocated properties.
+ * @param allocator Pointer to the tree allocator.
+ * @param comparator Function pointer for key comparison.
+ * @return Stack-allocated AVL tree structure.
+ */
+{{NAME}}_t {{NAME}}_make_stackalloc ({{NAME}}_allocator_t* allocator, {{NAME}}_comparator_t comparator)
+{
+    {{NAME}}_t result;
+    result.size = 0;
+    result.root = NULL;
+    result.allocator = allocator;
+    result.comparator = comparator;
+    return result;
+}
+
+/**
+ * @brief Frees the resources of a stack-allocated AVL tree.
+ * @param self Pointer to the stack-allocated AVL tree.
+ */
+void {{NAME}}_free_stackalloc ({{NAME}}_t* self)
+{
+    if (NULL != self)
+    {
+        {{NAME}}_clear(self);
+        self->allocator = NULL;
+        self->comparator = NULL;
+    }
+}
+
+/**
+ * @brief Creates a copy of an existing AVL tree.
+ * @param self Pointer to the tree to be copied.
+ * @return Pointer to the newly created copy of the tree.
+ */
+{{NAME}}_t* {{NAME}}_copy ({{NAME}}_t* self)
+{
+    {{NAME}}_t* copy = {{NAME}}_make(self->allocator, self->comparator);
+
+    if (NULL == copy)
+    {
+        return NULL;
+    }
+    else if ({{NAME}}_putAll(copy, self))
+    {
+        return copy;
+    }
+    else
+    {
+        {{NAME}}_free(copy);
+        return NULL;
+    }
+}
+
+/**
+ * Splits a subtree into the nodes less than a key and the rest, by joining the subtrees along the path to the key.
+ * The cost of the joins telescopes to O(log n) in total.
+ */
+static void split_nodes ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key, {{NAME}}_node_t** left, {{NAME}}_node_t** right)
+{
+    if (NULL == node)
+    {
+        *left = NULL;
+        *right = NULL;
+    }
+    else if (self->comparator(self, key, &node->key) <= 0)
+    {
+        {{NAME}}_node_t* greater = node->right;
+        {{NAME}}_node_t* middle = NULL;
+        split_nodes(self, node->left, key, left, &middle);
+        *right = join_nodes(middle, node, greater);
+    }
+    else
+    {
+        {{NAME}}_node_t* lesser = node->left;
+        {{NAME}}_node_t* middle = NULL;
+        split_nodes(self, node->right, key, &middle, right);
+        *left = join_nodes(lesser, node, middle);
+    }
+}
+
+/**
+ * @brief Splits an AVL tree at a key into two new trees in logarithmic time.
+ * @param self Pointer to the AVL tree, which is empty afterwards.
+ * @param key Key at which to split the tree.
+ * @param left Receives the new tree with the keys less than the key.
+ * @param right Receives the new tree with the keys greater than or equal to the key.
+ * @return true if the tree was split, false if a new tree could not be allocated (the tree is unchanged).
+ */
+bool {{NAME}}_split ({{NAME}}_t* self, {{KEY_TYPE}} key, {{NAME}}_t** left, {{NAME}}_t** right)
+{
+    {{NAME}}_t* lesser = {{NAME}}_make(self->allocator, self->comparator);
+    {{NAME}}_t* greater = {{NAME}}_make(self->allocator, self->comparator);
+
+    if (NULL == lesser || NULL == greater)
+    {
+        {{NAME}}_free(lesser);
+        {{NAME}}_free(greater);
+        return false;
+    }
+
+    split_nodes(self, self->root, &key, &lesser->root, &greater->root);
+    lesser->size = size_of(lesser->root);
+    greater->size = size_of(greater->root);
+
+    self->root = NULL;
+    self->size = 0;
+
+    *left = lesser;
+    *right = greater;
+    return true;
+}
+
+/**
+ * @brief Moves all of the nodes of one AVL tree to the end of another in logarithmic time.
+ * @param left Pointer to the AVL tree, which receives the nodes.
+ * @param right Pointer to the AVL tree, whose keys must all be greater than the keys of the left tree.
+ * @return true if the trees were joined (the right tree is empty afterwards), false otherwise (both are unchanged).
+ */
+bool {{NAME}}_join ({{NAME}}_t* left, {{NAME}}_t* right)
+{
+    if (left == right || left->allocator != right->allocator || left->comparator != right->comparator)
+    {
+        return false;
+    }
+    else if (NULL != left->root && NULL != right->root)
+    {
+        {{NAME}}_node_t* last = {{NAME}}_lastNode(left);
+        {{NAME}}_node_t* first = {{NAME}}_firstNode(right);
+
+        if (left->comparator(left, &last->key, &first->key) >= 0)
+        {
+            return false;
+        }
+    }
+
+    left->root = join_trees(left->root, right->root);
+    left->size += right->size;
+
+    right->root = NULL;
+    right->size = 0;
+    return true;
+}
+
+/**
+ * @brief Retrieves the number of nodes in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Number of nodes in the tree.
+ */
+size_t {{NAME}}_size ({{NAME}}_t* self)
+{
+    return self->size;
+}
+
+/**
+ * @brief Checks if the AVL tree is empty.
+ * @param self Pointer to the AVL tree.
+ * @return true if the tree is empty, false otherwise.
+ */
+bool {{NAME}}_isEmpty ({{NAME}}_t* self)
+{
+    // This is implemented as a pointer comparison,
+    // because isEmpty() is called by other functions,
+    // wheren nodes are being added and/or removed.
+    // In those cases, size() may be momentarily inaccurate.
+    return (NULL == self) || (NULL == self->root);
+}
+
+/**
+ * @brief Clears all nodes from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ */
+void {{NAME}}_clear ({{NAME}}_t* self)
+{
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        while ({{NAME}}_isEmpty(self) == false)
+        {
+            {{NAME}}_removeFirst(self);
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+}
+
+/**
+ * @brief Checks if a specific key exists in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to check for existence.
+ * @return true if the key exists, false otherwise.
+ */
+bool {{NAME}}_containsKey ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    return NULL != find_node(self, self->root, &key);
+}
+
+/**
+ * @brief Checks if the current tree contains all elements of another tree.
+ * @param self Pointer to the AVL tree.
+ * @param other Pointer to the other AVL tree.
+ * @return true if all keys in other are present in self, false otherwise.
+ */
+bool {{NAME}}_containsValue ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+
+            if (predicate(self, node, context))
+            {
+                return true;
+            }
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return false;
+}
+
+/**
+ * @brief Inserts a node with a specified key and returns the inserted node.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for the node to insert.
+ * @return Pointer to the created node.
+{% if SUBTREE_HASH or AGGREGATE %}
+ *
+ * The value of a new node is zeroed; set it through setNode(), which keeps the hashes and aggregates up to date.
+{% end %}
+ */
+{{NAME}}_node_t* {{NAME}}_putNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* node = NULL;
+    {{NAME}}_node_t* root = insert_node(self, self->root, &key, NULL, &node);
+
+    if (NULL != root)
+    {
+        self->root = root;
+    }
+
+    return node;
+}
+
+/**
+ * @brief Retrieves a node by its key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key of the node to find.
+ * @return Pointer to the found node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_getNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    return find_node(self, self->root, &key);
+}
+
+/**
+ * @brief Retrieves the root node of the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Pointer to the root node.
+ */
+{{NAME}}_node_t* {{NAME}}_rootNode ({{NAME}}_t* self)
+{
+    return self->root;
+}
+
+/**
+ * @brief Retrieves the first node (minimum key) of the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Pointer to the first node or NULL if the tree is empty.
+ */
+{{NAME}}_node_t* {{NAME}}_firstNode ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* p = self->root;
+
+    if (NULL == p)
+    {
+        return NULL;
+    }
+    else
+    {
+        while (true)
+        {
+            if (NULL == p->left)
+            {
+                return p;
+            }
+            else
+            {
+                p = p->left;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Retrieves the last node (maximum key) of the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Pointer to the last node or NULL if the tree is empty.
+ */
+{{NAME}}_node_t* {{NAME}}_lastNode ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* p = self->root;
+
+    if (NULL == p)
+    {
+        return NULL;
+    }
+    else
+    {
+        while (true)
+        {
+            if (NULL == p->right)
+            {
+                return p;
+            }
+            else
+            {
+                p = p->right;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Finds the successor node (next higher key) of a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the higher node.
+ * @return Pointer to the higher node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_higherNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* current = self->root;
+    {{NAME}}_node_t* successor = NULL;
+
+    while (current != NULL)
+    {
+        if (self->comparator(self, &key, &current->key) < 0)
+        {
+            // Update successor and go left
+            successor = current;
+            current = current->left;
+        }
+        else
+        {
+            // Go right
+            current = current->right;
+        }
+    }
+
+    return successor;
+
+}
+
+/**
+ * @brief Finds the predecessor node (next lower key) of a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the lower node.
+ * @return Pointer to the lower node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_lowerNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* current = self->root;
+    {{NAME}}_node_t* predecessor = NULL;
+
+    // Traverse the tree to find the lower node
+    while (current != NULL)
+    {
+        if (self->comparator(self, &key, &current->key) <= 0)
+        {
+            // Move left; we need to find a smaller key
+            current = current->left;
+        }
+        else
+        {
+            // Current key is smaller than the searched key
+            // This could be a candidate for lower node
+            predecessor = current;
+            // Move right to find larger keys
+            current = current->right;
+        }
+    }
+
+    return predecessor;
+}
+
+/**
+ * @brief Finds the node with the greatest key less than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the floor node.
+ * @return Pointer to the floor node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_floorNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* current = self->root;
+    {{NAME}}_node_t* floor = NULL;
+
+    while (current != NULL)
+    {
+        const int ordering = self->comparator(self, &key, &current->key);
+
+        if (ordering == 0)
+        {
+            return current;
+        }
+        else if (ordering < 0)
+        {
+            current = current->left;
+        }
+        else
+        {
+            floor = current;
+            current = current->right;
+        }
+    }
+
+    return floor;
+}
+
+/**
+ * @brief Finds the node with the least key greater than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the ceiling node.
+ * @return Pointer to the ceiling node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_ceilingNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* current = self->root;
+    {{NAME}}_node_t* ceiling = NULL;
+
+    while (current != NULL)
+    {
+        const int ordering = self->comparator(self, &key, &current->key);
+
+        if (ordering == 0)
+        {
+            return current;
+        }
+        else if (ordering < 0)
+        {
+            ceiling = current;
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+
+    return ceiling;
+}
+
+/**
+ * @brief Finds the lower node, the exact node and the higher node of a given key in a single descent.
+ * @param self Pointer to the AVL tree.
+ * @param key Key for which to find the neighbors.
+ * @return The lower, exact and higher nodes, each of which is NULL if not found.
+ */
+{{NAME}}_neighbors_t {{NAME}}_neighbors ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_neighbors_t result = { NULL, NULL, NULL };
+    {{NAME}}_node_t* current = self->root;
+
+    while (current != NULL)
+    {
+        const int ordering = self->comparator(self, &key, &current->key);
+
+        if (ordering < 0)
+        {
+            result.higher = current;
+            current = current->left;
+        }
+        else if (ordering > 0)
+        {
+            result.lower = current;
+            current = current->right;
+        }
+        else
+        {
+            // The descent continues to the last node of the left subtree, and to the first node of the right subtree.
+            result.exact = current;
+
+            for ({{NAME}}_node_t* p = current->left; NULL != p; p = p->right)
+            {
+                result.lower = p;
+            }
+
+            for ({{NAME}}_node_t* p = current->right; NULL != p; p = p->left)
+            {
+                result.higher = p;
+            }
+
+            break;
+        }
+    }
+
+    return result;
+}
+
+static {{NAME}}_node_t* find_nth (size_t prior, {{NAME}}_node_t* node, size_t index)
+{
+    if (NULL == node)
+    {
+        return NULL; // Base case: If the node is null, return null.
+    }
+
+    // Get the size of the left subtree.
+    const size_t left_size = size_of(node->left);
+
+    if (prior + left_size == index)
+    {
+        // If prior + left_size matches the index, we've found the nth node.
+        return node;
+    }
+    else if (prior + left_size > index)
+    {
+        // If the index is less than the size of the left subtree,
+        // we need to search in the left subtree.
+        return find_nth(prior, node->left, index);
+    }
+    else
+    {
+        // If the index is greater, we search in the right subtree.
+        // Update the prior value to include the current node and left subtree size.
+        return find_nth(prior + left_size + 1, node->right, index);
+    }
+}
+
+/**
+ * @brief Finds the nth node (0-based index) in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param index The index of the node to find.
+ * @return Pointer to the nth node or NULL if not found.
+ */
+{{NAME}}_node_t* {{NAME}}_nthNode ({{NAME}}_t* self, size_t index)
+{
+    return find_nth(0, self->root, index);
+}
+
+/**
+ * @brief Finds the index (0-based) of a key in the AVL tree, which is the inverse of nthNode().
+ * @param self Pointer to the AVL tree.
+ * @param key Key to search for.
+ * @return Index of the key, or SIZE_MAX if the key is not found.
+ */
+size_t {{NAME}}_rankOf ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* node = self->root;
+    size_t prior = 0;
+
+    while (NULL != node)
+    {
+        const int ordering = self->comparator(self, &key, &node->key);
+
+        if (ordering < 0)
+        {
+            node = node->left;
+        }
+        else if (ordering > 0)
+        {
+            // The left subtree and the node itself precede the key.
+            prior += size_of(node->left) + 1;
+            node = node->right;
+        }
+        else
+        {
+            return prior + size_of(node->left);
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+/**
+ * @brief Finds the index (0-based) of the greatest key, which is less than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the floor key, or SIZE_MAX if all of the keys are greater than the given key.
+ */
+size_t {{NAME}}_floorRank ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* node = self->root;
+    size_t prior = 0;
+    size_t result = SIZE_MAX;
+
+    while (NULL != node)
+    {
+        const int ordering = self->comparator(self, &key, &node->key);
+
+        if (ordering < 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            // This node is the floor, unless a greater key in its right subtree is also not greater than the key.
+            result = prior + size_of(node->left);
+
+            if (0 == ordering)
+            {
+                break;
+            }
+
+            prior = result + 1;
+            node = node->right;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Finds the index (0-based) of the least key, which is greater than or equal to a given key.
+ * @param self Pointer to the AVL tree.
+ * @param key Key, which need not be in the tree.
+ * @return Index of the ceiling key, or SIZE_MAX if all of the keys are less than the given key.
+ */
+size_t {{NAME}}_ceilingRank ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* node = self->root;
+    size_t prior = 0;
+    size_t result = SIZE_MAX;
+
+    while (NULL != node)
+    {
+        const int ordering = self->comparator(self, &key, &node->key);
+
+        if (ordering > 0)
+        {
+            prior += size_of(node->left) + 1;
+            node = node->right;
+        }
+        else
+        {
+            // This node is the ceiling, unless a lesser key in its left subtree is also not less than the key.
+            result = prior + size_of(node->left);
+
+            if (0 == ordering)
+            {
+                break;
+            }
+
+            node = node->left;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Counts the nodes, whose keys are less than a given key (or less than or equal to it, if inclusive).
+ */
+static size_t count_below ({{NAME}}_t* self, {{KEY_TYPE}} key, bool inclusive)
+{
+    if (inclusive)
+    {
+        const size_t floor = {{NAME}}_floorRank(self, key);
+        return SIZE_MAX == floor ? 0 : floor + 1;
+    }
+    else
+    {
+        const size_t ceiling = {{NAME}}_ceilingRank(self, key);
+        return SIZE_MAX == ceiling ? size_of(self->root) : ceiling;
+    }
+}
+
+/**
+ * @brief Counts the nodes, whose keys are between two bounds, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ * @return Number of nodes in the range, which is zero if the range is empty.
+ */
+size_t {{NAME}}_countRange ({{NAME}}_t* self, {{KEY_TYPE}} lo, bool lo_inclusive, {{KEY_TYPE}} hi, bool hi_inclusive)
+{
+    const size_t below_hi = count_below(self, hi, hi_inclusive);
+    const size_t below_lo = count_below(self, lo, false == lo_inclusive);
+    return below_hi > below_lo ? below_hi - below_lo : 0;
+}
+
+/**
+ * @brief Creates a random number generator from a seed.
+ * @param seed Seed of the generator; equal seeds produce equal sequences.
+ * @return The random number generator.
+ */
+{{NAME}}_random_t {{NAME}}_random_seed (uint64_t seed)
+{
+    {{NAME}}_random_t result;
+    result.state = seed;
+    return result;
+}
+
+/**
+ * @brief Draws the next random number from a generator.
+ * @param self Pointer to the random number generator.
+ * @return Uniformly distributed 64-bit random number.
+ */
+uint64_t {{NAME}}_random_next ({{NAME}}_random_t* self)
+{
+    // splitmix64
+    uint64_t x = (self->state += UINT64_C(0x9E3779B97F4A7C15));
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+/**
+ * A rank to select, and the position in the output, where the node at the rank belongs.
+ */
+typedef struct
+{
+    size_t rank;
+
+    size_t position;
+
+} {{NAME}}_selection_t;
+
+static int compare_selections (const void* x, const void* y)
+{
+    const size_t rank_x = ((const {{NAME}}_selection_t*) x)->rank;
+    const size_t rank_y = ((const {{NAME}}_selection_t*) y)->rank;
+    return rank_x < rank_y ? -1 : (rank_x > rank_y ? +1 : 0);
+}
+
+/**
+ * Finds the nodes at a sorted array of ranks, which are all within a subtree, whose first node has the rank prior.
+ * The ranks are partitioned at each node, so that every node is visited at most once.
+ */
+static void select_nodes ({{NAME}}_node_t* node, size_t prior, {{NAME}}_selection_t* selections, size_t count, {{NAME}}_node_t** out)
+{
+    while (count > 0)
+    {
+        const size_t rank = prior + size_of(node->left);
+
+        // Binary search for the first selection, whose rank is not below the rank of the node.
+        size_t below = 0;
+        size_t upper = count;
+
+        while (below < upper)
+        {
+            const size_t middle = below + (upper - below) / 2;
+
+            if (selections[middle].rank < rank)
+            {
+                below = middle + 1;
+            }
+            else
+            {
+                upper = middle;
+            }
+        }
+
+        size_t equal = below;
+
+        while (equal < count && selections[equal].rank == rank)
+        {
+            out[selections[equal++].position] = node;
+        }
+
+        select_nodes(node->left, prior, selections, below, out);
+
+        selections += equal;
+        count -= equal;
+        prior = rank + 1;
+        node = node->right;
+    }
+}
+
+/**
+ * @brief Draws uniformly random nodes (with replacement) from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param k Number of nodes to draw.
+ * @param rng Pointer to the random number generator.
+ * @param out Array that receives the k drawn nodes in ascending key order.
+ * @return Number of nodes drawn, which is zero if the tree is empty or memory could not be allocated.
+ */
+size_t {{NAME}}_sample ({{NAME}}_t* self, size_t k, {{NAME}}_random_t* rng, {{NAME}}_node_t** out)
+{
+    const size_t size = size_of(self->root);
+
+    if (0 == size || 0 == k)
+    {
+        return 0;
+    }
+
+    {{NAME}}_selection_t* selections = malloc(k * sizeof({{NAME}}_selection_t));
+
+    if (NULL == selections)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < k; i++)
+    {
+        // The modulo bias is negligible, since the size is far below 2^64.
+        selections[i].rank = (size_t) ({{NAME}}_random_next(rng) % size);
+    }
+
+    qsort(selections, k, sizeof({{NAME}}_selection_t), &compare_selections);
+
+    for (size_t i = 0; i < k; i++)
+    {
+        selections[i].position = i;
+    }
+
+    select_nodes(self->root, 0, selections, k, out);
+    free(selections);
+    return k;
+}
+
+/**
+ * @brief Finds the nodes at several quantiles of the keys in a single walk over the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param q Quantiles, each of which is between 0 and 1 (values outside are clamped), in any order.
+ * @param m Number of quantiles.
+ * @param out Array that receives the node at each quantile, in the order of the quantiles.
+ * @return true if the nodes were found, false if the tree is empty or memory could not be allocated.
+ */
+bool {{NAME}}_quantiles ({{NAME}}_t* self, const double* q, size_t m, {{NAME}}_node_t** out)
+{
+    const size_t size = size_of(self->root);
+
+    if (0 == size)
+    {
+        return false;
+    }
+    else if (0 == m)
+    {
+        return true;
+    }
+
+    {{NAME}}_selection_t* selections = malloc(m * sizeof({{NAME}}_selection_t));
+
+    if (NULL == selections)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < m; i++)
+    {
+        // NaN is clamped to the first node, too.
+        const double fraction = q[i] > 0 ? (q[i] < 1 ? q[i] : 1) : 0;
+        selections[i].rank = (size_t) (fraction * (double) (size - 1) + 0.5);
+        selections[i].position = i;
+    }
+
+    qsort(selections, m, sizeof({{NAME}}_selection_t), &compare_selections);
+    select_nodes(self->root, 0, selections, m, out);
+    free(selections);
+    return true;
+}
+
+{% if DEQUE %}
+/**
+ * @brief Adds a value as the first element in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to add.
+ * @return true if the addition was successful, false otherwise.
+ */
+bool {{NAME}}_addFirst ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+{
+    return {{NAME}}_pushFirst(self, value);
+}
+
+/**
+ * @brief Adds a value as the last element in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to add.
+ * @return true if the addition was successful, false otherwise.
+ */
+bool {{NAME}}_addLast ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+{
+    return {{NAME}}_pushLast(self, value);
+}
+
+/**
+ * @brief Pushes a value to the front of the AVL tree (Deque operation).
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool {{NAME}}_pushFirst ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+{
+    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+
+    if (NULL == node)
+    {
+        return {{NAME}}_put(self, 0, value);
+    }
+    else
+    {
+        return {{NAME}}_put(self, node->key - 1, value);
+    }
+}
+
+/**
+ * @brief Pushes a value to the end of the AVL tree (Deque operation).
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool {{NAME}}_pushLast ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+{
+    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+
+    if (NULL == node)
+    {
+        return {{NAME}}_put(self, 0, value);
+    }
+    else
+    {
+        return {{NAME}}_put(self, node->key + 1, value);
+    }
+}
+
+/**
+ * @brief Pushes a value to the AVL tree (equivalent to pushLast).
+ * @param self Pointer to the AVL tree.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool {{NAME}}_push ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+{
+    return {{NAME}}_pushLast(self, value);
+}
+
+{% end %}
+/**
+ * @brief Peeks at the last value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+{{VALUE_TYPE}} {{NAME}}_peek ({{NAME}}_t* self)
+{
+    return {{NAME}}_peekLast(self);
+}
+
+/**
+ * @brief Peeks at the first value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return First data value in the tree or default value if empty.
+ */
+{{VALUE_TYPE}} {{NAME}}_peekFirst ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+
+    if (NULL == node)
+    {
+        return {{NAME}}_defaultValue();
+    }
+    else
+    {
+        return node->value;
+    }
+}
+
+/**
+ * @brief Peeks at the last value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+{{VALUE_TYPE}} {{NAME}}_peekLast ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+
+    if (NULL == node)
+    {
+        return {{NAME}}_defaultValue();
+    }
+    else
+    {
+        return node->value;
+    }
+}
+
+/**
+ * @brief Pops the last value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+{{VALUE_TYPE}} {{NAME}}_pop ({{NAME}}_t* self)
+{
+    return {{NAME}}_popLast(self);
+}
+
+/**
+ * @brief Pops the first value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return First data value in the tree or default value if empty.
+ */
+{{VALUE_TYPE}} {{NAME}}_popFirst ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+
+    if (NULL == node)
+    {
+        return {{NAME}}_defaultValue();
+    }
+    else
+    {
+        {{VALUE_TYPE}} value = node->value;
+        {{NAME}}_removeFirst(self);
+        return value;
+    }
+}
+
+/**
+ * @brief Pops the last value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Last data value in the tree or default value if empty.
+ */
+{{VALUE_TYPE}} {{NAME}}_popLast ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+
+    if (NULL == node)
+    {
+        return {{NAME}}_defaultValue();
+    }
+    else
+    {
+        {{VALUE_TYPE}} value = node->value;
+        {{NAME}}_removeLast(self);
+        return value;
+    }
+}
+
+bool {{NAME}}_containsAll ({{NAME}}_t* self, {{NAME}}_t* other)
+{
+    if ({{NAME}}_size(self) < {{NAME}}_size(other))
+    {
+        return false;
+    }
+
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(other);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+
+            if ({{NAME}}_containsKey(self, node->key) == false)
+            {
+                return false;
+            }
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return true;
+}
+
+/**
+ * @brief Copies keys from the tree into an array.
+ * @param self Pointer to the AVL tree.
+ * @param array Array to store keys.
+ * @param array_size Size of the provided array.
+ * @return Number of keys copied into the array.
+ */
+size_t {{NAME}}_keysToArray ({{NAME}}_t* self, {{KEY_TYPE}}* array, size_t array_size)
+{
+    size_t count = 0;
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        for (count = 0; {{NAME}}_iter_hasNext(&iter) && (count < array_size); count++)
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            array[count] = node->key;
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return count;
+}
+
+/**
+ * @brief Copies values from the tree into an array.
+ * @param self Pointer to the AVL tree.
+ * @param array Array to store values.
+ * @param array_size Size of the provided array.
+ * @return Number of values copied into the array.
+ */
+size_t {{NAME}}_valuesToArray ({{NAME}}_t* self, {{VALUE_TYPE}}* array, size_t array_size)
+{
+    size_t count = 0;
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        for (count = 0; {{NAME}}_iter_hasNext(&iter) && (count < array_size); count++)
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            array[count] = node->value;
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return count;
+}
+
+/**
+ * @brief Allocates a new array and copies the keys from the tree into it.
+ * @param self Pointer to the AVL tree.
+ * @return Pointer to the newly allocated array of keys or NULL if empty.
+ */
+{{KEY_TYPE}}* {{NAME}}_keysToNewArray ({{NAME}}_t* self)
+{
+    if (NULL == self)
+    {
+        return NULL;
+    }
+    else if ({{NAME}}_isEmpty(self))
+    {
+        return NULL;
+    }
+
+    size_t size = {{NAME}}_size(self);
+
+    {{KEY_TYPE}}* array = ({{KEY_TYPE}}*) calloc(size, sizeof({{KEY_TYPE}}));
+
+    if (NULL == array)
+    {
+        return NULL;
+    }
+    else
+    {
+        {{NAME}}_keysToArray(self, array, size);
+        return array;
+    }
+}
+
+/**
+ * @brief Allocates a new array and copies the values from the tree into it.
+ * @param self Pointer to the AVL tree.
+ * @return Pointer to the newly allocated array of values or NULL if empty.
+ */
+{{VALUE_TYPE}}* {{NAME}}_valuesToNewArray ({{NAME}}_t* self)
+{
+    if (NULL == self)
+    {
+        return NULL;
+    }
+    else if ({{NAME}}_isEmpty(self))
+    {
+        return NULL;
+    }
+
+    size_t size = {{NAME}}_size(self);
+
+    {{VALUE_TYPE}}* array = ({{VALUE_TYPE}}*) calloc(size, sizeof({{VALUE_TYPE}}));
+
+    if (NULL == array)
+    {
+        return NULL;
+    }
+    else
+    {
+        {{NAME}}_valuesToArray(self, array, size);
+        return array;
+    }
+}
+
+/**
+ * @brief Reduces tree elements to a double value using a provided function.
+ * @param self Pointer to the AVL tree.
+ * @param functor Function for reduction.
+ * @param initial Initial value for reduction.
+ * @param context Additional context passed to the functor.
+ * @return Reduced double value.
+ */
+double {{NAME}}_reduceToDouble ({{NAME}}_t* self, double (*functor)({{NAME}}_t*, {{NAME}}_node_t*, double, void*), double initial, void* context)
+{
+    double result = initial;
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            result = functor(self, node, result, context);
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return result;
+}
+
+/**
+ * @brief Reduces tree elements to an int64 value using a provided function.
+ * @param self Pointer to the AVL tree.
+ * @param functor Function for reduction.
+ * @param initial Initial value for reduction.
+ * @param context Additional context passed to the functor.
+ * @return Reduced int64 value.
+ */
+int64_t {{NAME}}_reduceToInt64 ({{NAME}}_t* self, int64_t (*functor)({{NAME}}_t*, {{NAME}}_node_t*, int64_t, void*), int64_t initial, void* context)
+{
+    int64_t result = initial;
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            result = functor(self, node, result, context);
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return result;
+}
+
+/**
+ * @brief Sums tree elements to a double value using a provided function.
+ * @param self Pointer to the AVL tree.
+ * @param functor Function for summation.
+ * @param context Additional context passed to the functor.
+ * @return Sum as a double value.
+ */
+double {{NAME}}_sumToDouble ({{NAME}}_t* self, double (*functor)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    double result = 0;
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            result += functor(self, node, context);
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return result;
+}
+
+/**
+ * @brief Sums tree elements to an int64 value using a provided function.
+ * @param self Pointer to the AVL tree.
+ * @param functor Function for summation.
+ * @param context Additional context passed to the functor.
+ * @return Sum as an int64 value.
+ */
+int64_t {{NAME}}_sumToInt64 ({{NAME}}_t* self, int64_t (*functor)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    int64_t result = 0;
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            result += functor(self, node, context);
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return result;
+}
+
+/**
+ * @brief Puts all elements from another tree into this tree.
+ * @param self Pointer to the current AVL tree.
+ * @param other Pointer to the other AVL tree.
+ * @return true if all elements were successfully added, false otherwise.
+ */
+bool {{NAME}}_putAll ({{NAME}}_t* self, {{NAME}}_t* other)
+{
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(other);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+
+            if ({{NAME}}_put(self, node->key, node->value) == false)
+            {
+                return false;
+            }
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+    return true;
+}
+
+/**
+ * @brief Removes all elements that exist in another tree from this tree.
+ * @param self Pointer to the current AVL tree.
+ * @param other Pointer to the other AVL tree.
+ */
+void {{NAME}}_removeAll ({{NAME}}_t* self, {{NAME}}_t* other)
+{
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(other);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            {{NAME}}_remove(self, node->key);
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+}
+
+/**
+ * @brief Retains only elements that exist in another tree.
+ * @param self Pointer to the current AVL tree.
+ * @param other Pointer to the other AVL tree.
+ */
+void {{NAME}}_retainAll ({{NAME}}_t* self, {{NAME}}_t* other)
+{
+    // The next node is found by key, since removing a node may move the other nodes.
+    for ({{NAME}}_node_t* node = {{NAME}}_firstNode(self); NULL != node;)
+    {
+        {{KEY_TYPE}} key = node->key;
+
+        if ({{NAME}}_containsKey(other, key) == false)
+        {
+            {{NAME}}_remove(self, key);
+        }
+
+        node = {{NAME}}_higherNode(self, key);
+    }
+}
+
+{% if SUBTREE_HASH or AGGREGATE %}
+/**
+ * Recomputes the hashes and the aggregates along the path from the root to a node, after the value of the node changed.
+ */
+static void update_path ({{NAME}}_t* self, {{NAME}}_node_t* node)
+{
+    {{NAME}}_node_t* path[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+
+    for ({{NAME}}_node_t* current = self->root; NULL != current;)
+    {
+        path[depth++] = current;
+
+        if (current == node)
+        {
+            break;
+        }
+        else if (self->comparator(self, &node->key, &current->key) < 0)
+        {
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+
+    while (depth > 0)
+    {
+        update_size(path[--depth]);
+    }
+}
+
+{% end %}
+/**
+ * @brief Inserts a key-value pair into the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool {{NAME}}_put ({{NAME}}_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
+{
+    {{NAME}}_node_t* node = NULL;
+    {{NAME}}_node_t* root = insert_node(self, self->root, &key, &value, &node);
+
+    if (NULL != root)
+    {
+        self->root = root;
+    }
+
+    return NULL != node;
+}
+
+/**
+ * @brief Sets the data value of a node of the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param node Pointer to a node of the tree.
+ * @param value Data value to set.
+ *
+ * Unlike node_set(), this keeps the hashes and aggregates of the node and its ancestors up to date.
+ */
+void {{NAME}}_setNode ({{NAME}}_t* self, {{NAME}}_node_t* node, {{VALUE_TYPE}} value)
+{
+    node->value = value;
+{% if SUBTREE_HASH or AGGREGATE %}
+    update_path(self, node);
+{% end %}
+}
+
+/**
+ * Below this many nodes, the bulk operations do not bother to spawn threads.
+ */
+static const size_t BULK_PARALLEL_CUTOFF = 65536;
+
+/**
+ * Below this many nodes, the merge sort falls back to an insertion sort.
+ */
+static const size_t BULK_INSERTION_CUTOFF = 16;
+
+/**
+ * Upper bound on the number of threads used by a single bulk operation.
+ */
+static const size_t BULK_MAX_THREADS = 64;
+
+/**
+ * Invokes the worker once per task, using one thread per task when threads are available.
+ * The tasks are stored contiguously, each one being stride bytes long.
+ */
+static void run_tasks (void* (*worker)(void*), void* tasks, size_t stride, size_t count)
+{
+{% if PARALLEL %}
+    pthread_t threads[count];
+    bool started[count];
+
+    for (size_t i = 1; i < count; i++)
+    {
+        started[i] = 0 == pthread_create(&threads[i], NULL, worker, ((char*) tasks) + i * stride);
+
+        if (started[i] == false)
+        {
+            // Thread creation failed, so do the work on this thread instead.
+            worker(((char*) tasks) + i * stride);
+        }
+    }
+
+    worker(tasks);
+
+    for (size_t i = 1; i < count; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+{% else %}
+    for (size_t i = 0; i < count; i++)
+    {
+        worker(((char*) tasks) + i * stride);
+    }
+{% end %}
+}
+
+/**
+ * Decides how many threads are worth using to process the given number of nodes.
+ */
+static size_t bulk_threads (size_t threads, size_t count)
+{
+    const size_t useful = 1 + count / BULK_PARALLEL_CUTOFF;
+    threads = threads < useful ? threads : useful;
+    threads = threads < BULK_MAX_THREADS ? threads : BULK_MAX_THREADS;
+    return threads < 1 ? 1 : threads;
+}
+
+{% for ITEM, ITEMS in [("node", "nodes"), ("op", "ops")] %}
+static void insertion_sort_{{ITEMS}} ({{NAME}}_t* self, {{NAME}}_{{ITEM}}_t** {{ITEMS}}, size_t count)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        {{NAME}}_{{ITEM}}_t* item = {{ITEMS}}[i];
+        size_t j = i;
+
+        // Only move past strictly greater keys, so that equal keys keep their input order.
+        while (j > 0 && self->comparator(self, &{{ITEMS}}[j - 1]->key, &item->key) > 0)
+        {
+            {{ITEMS}}[j] = {{ITEMS}}[j - 1];
+            --j;
+        }
+
+        {{ITEMS}}[j] = item;
+    }
+}
+
+static void merge_{{ITEMS}} ({{NAME}}_t* self, {{NAME}}_{{ITEM}}_t** left, size_t left_count, {{NAME}}_{{ITEM}}_t** right, size_t right_count, {{NAME}}_{{ITEM}}_t** output)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    while (i < left_count && j < right_count)
+    {
+        // Prefer the left side on ties, so that the merge is stable.
+        if (self->comparator(self, &right[j]->key, &left[i]->key) < 0)
+        {
+            output[k++] = right[j++];
+        }
+        else
+        {
+            output[k++] = left[i++];
+        }
+    }
+
+    memcpy(output + k, left + i, (left_count - i) * sizeof({{NAME}}_{{ITEM}}_t*));
+    k += left_count - i;
+    memcpy(output + k, right + j, (right_count - j) * sizeof({{NAME}}_{{ITEM}}_t*));
+}
+
+/**
+ * Stable merge sort by key.
+ * The scratch array must have room for at least count elements.
+ */
+static void merge_sort_{{ITEMS}} ({{NAME}}_t* self, {{NAME}}_{{ITEM}}_t** {{ITEMS}}, {{NAME}}_{{ITEM}}_t** scratch, size_t count)
+{
+    if (count <= BULK_INSERTION_CUTOFF)
+    {
+        insertion_sort_{{ITEMS}}(self, {{ITEMS}}, count);
+        return;
+    }
+
+    const size_t half = count / 2;
+    merge_sort_{{ITEMS}}(self, {{ITEMS}}, scratch, half);
+    merge_sort_{{ITEMS}}(self, {{ITEMS}} + half, scratch + half, count - half);
+    merge_{{ITEMS}}(self, {{ITEMS}}, half, {{ITEMS}} + half, count - half, scratch);
+    memcpy({{ITEMS}}, scratch, count * sizeof({{NAME}}_{{ITEM}}_t*));
+}
+
+{% end %}
+typedef struct
+{
+    {{NAME}}_t* tree;
+
+    {{NAME}}_node_t** source;
+
+    {{NAME}}_node_t** target;
+
+    size_t lo;
+
+    size_t middle;
+
+    size_t hi;
+
+} {{NAME}}_merge_task_t;
+
+static void* merge_sort_worker (void* argument)
+{
+    {{NAME}}_merge_task_t* task = ({{NAME}}_merge_task_t*) argument;
+    merge_sort_nodes(task->tree, task->source + task->lo, task->target + task->lo, task->hi - task->lo);
+    return NULL;
+}
+
+static void* merge_worker (void* argument)
+{
+    {{NAME}}_merge_task_t* task = ({{NAME}}_merge_task_t*) argument;
+    {{NAME}}_node_t** left = task->source + task->lo;
+    {{NAME}}_node_t** right = task->source + task->middle;
+    merge_nodes(task->tree, left, task->middle - task->lo, right, task->hi - task->middle, task->target + task->lo);
+    return NULL;
+}
+
+/**
+ * Stable merge sort, which sorts one run per thread and then merges pairs of runs in parallel.
+ */
+static void parallel_merge_sort_nodes ({{NAME}}_t* self, {{NAME}}_node_t** nodes, {{NAME}}_node_t** scratch, size_t count, size_t threads)
+{
+    size_t bounds[BULK_MAX_THREADS + 1];
+    {{NAME}}_merge_task_t tasks[BULK_MAX_THREADS];
+    size_t runs = threads;
+
+    for (size_t i = 0; i <= runs; i++)
+    {
+        bounds[i] = (count * i) / runs;
+    }
+
+    for (size_t i = 0; i < runs; i++)
+    {
+        tasks[i].tree = self;
+        tasks[i].source = nodes;
+        tasks[i].target = scratch;
+        tasks[i].lo = bounds[i];
+        tasks[i].middle = bounds[i + 1];
+        tasks[i].hi = bounds[i + 1];
+    }
+
+    run_tasks(&merge_sort_worker, tasks, sizeof({{NAME}}_merge_task_t), runs);
+
+    {{NAME}}_node_t** source = nodes;
+    {{NAME}}_node_t** target = scratch;
+
+    while (runs > 1)
+    {
+        const size_t merged = (runs + 1) / 2;
+
+        for (size_t i = 0; i < merged; i++)
+        {
+            // An odd run out is merged with an empty run, which simply copies it.
+            tasks[i].tree = self;
+            tasks[i].source = source;
+            tasks[i].target = target;
+            tasks[i].lo = bounds[2 * i];
+            tasks[i].middle = bounds[2 * i + 1];
+            tasks[i].hi = bounds[2 * i + 2 <= runs ? 2 * i + 2 : runs];
+        }
+
+        run_tasks(&merge_worker, tasks, sizeof({{NAME}}_merge_task_t), merged);
+
+        for (size_t i = 0; i < merged; i++)
+        {
+            bounds[i] = tasks[i].lo;
+        }
+
+        bounds[merged] = count;
+        runs = merged;
+
+        {{NAME}}_node_t** swap = source;
+        source = target;
+        target = swap;
+    }
+
+    if (source != nodes)
+    {
+        memcpy(nodes, source, count * sizeof({{NAME}}_node_t*));
+    }
+}
+
+{% if RADIX %}
+/**
+ * Maps a key onto an unsigned integer with the same ordering.
+ * Signed keys are biased, so that negative keys sort before the positive keys.
+ */
+static uint64_t radix_key_of ({{NAME}}_node_t* node)
+{
+    const bool is_signed = (({{KEY_TYPE}}) -1) < (({{KEY_TYPE}}) 0);
+    const uint64_t bias = is_signed ? (UINT64_C(1) << (8 * sizeof({{KEY_TYPE}}) - 1)) : 0;
+    return ((uint64_t) node->key) + bias;
+}
+
+typedef struct
+{
+    {{NAME}}_node_t** source;
+
+    {{NAME}}_node_t** target;
+
+    size_t lo;
+
+    size_t hi;
+
+    uint32_t shift;
+
+    size_t counts[256];
+
+} {{NAME}}_radix_task_t;
+
+static void* radix_count_worker (void* argument)
+{
+    {{NAME}}_radix_task_t* task = ({{NAME}}_radix_task_t*) argument;
+
+    memset(task->counts, 0, sizeof(task->counts));
+
+    for (size_t i = task->lo; i < task->hi; i++)
+    {
+        ++task->counts[(radix_key_of(task->source[i]) >> task->shift) & 0xFF];
+    }
+
+    return NULL;
+}
+
+static void* radix_scatter_worker (void* argument)
+{
+    {{NAME}}_radix_task_t* task = ({{NAME}}_radix_task_t*) argument;
+
+    // By now, the counts have been turned into the output offsets of this task.
+    for (size_t i = task->lo; i < task->hi; i++)
+    {
+        const size_t digit = (radix_key_of(task->source[i]) >> task->shift) & 0xFF;
+        task->target[task->counts[digit]++] = task->source[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Stable least-significant-digit radix sort of the nodes by key, one byte per pass.
+ * Each pass histograms and scatters a contiguous chunk of the nodes per thread.
+ * Returns false, if the per-thread histograms could not be allocated.
+ */
+static bool radix_sort_nodes ({{NAME}}_node_t** nodes, {{NAME}}_node_t** scratch, size_t count, size_t threads)
+{
+    {{NAME}}_radix_task_t* tasks = ({{NAME}}_radix_task_t*) calloc(threads, sizeof({{NAME}}_radix_task_t));
+
+    if (NULL == tasks)
+    {
+        return false;
+    }
+
+    {{NAME}}_node_t** source = nodes;
+    {{NAME}}_node_t** target = scratch;
+
+    for (uint32_t pass = 0; pass < sizeof({{KEY_TYPE}}); pass++)
+    {
+        for (size_t t = 0; t < threads; t++)
+        {
+            tasks[t].source = source;
+            tasks[t].target = target;
+            tasks[t].lo = (count * t) / threads;
+            tasks[t].hi = (count * (t + 1)) / threads;
+            tasks[t].shift = 8 * pass;
+        }
+
+        run_tasks(&radix_count_worker, tasks, sizeof({{NAME}}_radix_task_t), threads);
+
+        // Convert the histograms into output offsets, digit-major and then task-major.
+        size_t offset = 0;
+        bool trivial = false;
+
+        for (size_t digit = 0; digit < 256; digit++)
+        {
+            const size_t start = offset;
+
+            for (size_t t = 0; t < threads; t++)
+            {
+                const size_t n = tasks[t].counts[digit];
+                tasks[t].counts[digit] = offset;
+                offset += n;
+            }
+
+            trivial = trivial || (offset - start == count);
+        }
+
+        if (trivial)
+        {
+            continue; // Every key has the same digit, so this pass would not change anything.
+        }
+
+        run_tasks(&radix_scatter_worker, tasks, sizeof({{NAME}}_radix_task_t), threads);
+
+        {{NAME}}_node_t** swap = source;
+        source = target;
+        target = swap;
+    }
+
+    if (source != nodes)
+    {
+        memcpy(nodes, source, count * sizeof({{NAME}}_node_t*));
+    }
+
+    free(tasks);
+    return true;
+}
+{% end %}
+
+/**
+ * Stable sort of the nodes by key.
+ * The scratch array must have room for at least count nodes.
+ */
+static void sort_nodes ({{NAME}}_t* self, {{NAME}}_node_t** nodes, {{NAME}}_node_t** scratch, size_t count, size_t threads)
+{
+    threads = bulk_threads(threads, count);
+
+{% if RADIX %}
+    // The radix sort only agrees with the natural ordering.
+    if (self->comparator == &{{NAME}}_naturalOrder && radix_sort_nodes(nodes, scratch, count, threads))
+    {
+        return;
+    }
+{% end %}
+
+    if (threads > 1)
+    {
+        parallel_merge_sort_nodes(self, nodes, scratch, count, threads);
+    }
+    else
+    {
+        merge_sort_nodes(self, nodes, scratch, count);
+    }
+}
+
+/**
+ * Removes all but the last node of each run of equal keys in a sorted array of nodes.
+ * The removed nodes are released back to the allocator.
+ */
+static size_t unique_nodes ({{NAME}}_t* self, {{NAME}}_node_t** nodes, size_t count)
+{
+    size_t kept = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i + 1 < count && self->comparator(self, &nodes[i]->key, &nodes[i + 1]->key) == 0)
+        {
+            self->allocator->release(self->allocator, nodes[i]);
+        }
+        else
+        {
+            nodes[kept++] = nodes[i];
+        }
+    }
+
+    return kept;
+}
+
+/**
+ * Merges the existing nodes of a tree with a sorted array of new nodes.
+ * When a key is present on both sides, the existing node survives and takes the new value.
+ */
+static size_t union_nodes ({{NAME}}_t* self, {{NAME}}_node_t** existing, size_t existing_count, {{NAME}}_node_t** fresh, size_t fresh_count, {{NAME}}_node_t** output)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    while (i < existing_count && j < fresh_count)
+    {
+        const int ordering = self->comparator(self, &existing[i]->key, &fresh[j]->key);
+
+        if (ordering < 0)
+        {
+            output[k++] = existing[i++];
+        }
+        else if (ordering > 0)
+        {
+            output[k++] = fresh[j++];
+        }
+        else
+        {
+            existing[i]->value = fresh[j]->value;
+            self->allocator->release(self->allocator, fresh[j++]);
+            output[k++] = existing[i++];
+        }
+    }
+
+    memcpy(output + k, existing + i, (existing_count - i) * sizeof({{NAME}}_node_t*));
+    k += existing_count - i;
+    memcpy(output + k, fresh + j, (fresh_count - j) * sizeof({{NAME}}_node_t*));
+    k += fresh_count - j;
+
+    return k;
+}
+
+/**
+ * Stores the nodes of a subtree into an array in ascending order.
+ * Returns the index just past the last stored node.
+ */
+static size_t flatten_nodes ({{NAME}}_node_t* node, {{NAME}}_node_t** array, size_t index)
+{
+    if (NULL == node)
+    {
+        return index;
+    }
+
+    index = flatten_nodes(node->left, array, index);
+    array[index++] = node;
+    return flatten_nodes(node->right, array, index);
+}
+
+/**
+ * Links a sorted array of nodes into a perfectly balanced tree without any key comparisons.
+ */
+static {{NAME}}_node_t* build_balanced ({{NAME}}_node_t** nodes, size_t count)
+{
+    if (0 == count)
+    {
+        return NULL;
+    }
+
+    const size_t middle = count / 2;
+    {{NAME}}_node_t* node = nodes[middle];
+    node->left = build_balanced(nodes, middle);
+    node->right = build_balanced(nodes + middle + 1, count - middle - 1);
+    update_height(node);
+    update_size(node);
+    return node;
+}
+
+typedef struct
+{
+    {{NAME}}_node_t** nodes;
+
+    size_t count;
+
+    size_t threads;
+
+    {{NAME}}_node_t* root;
+
+} {{NAME}}_build_task_t;
+
+static {{NAME}}_node_t* build_balanced_parallel ({{NAME}}_node_t** nodes, size_t count, size_t threads);
+
+static void* build_balanced_worker (void* argument)
+{
+    {{NAME}}_build_task_t* task = ({{NAME}}_build_task_t*) argument;
+    task->root = build_balanced_parallel(task->nodes, task->count, task->threads);
+    return NULL;
+}
+
+/**
+ * Same as build_balanced(), except that the two subtrees of large enough trees are built concurrently.
+ */
+static {{NAME}}_node_t* build_balanced_parallel ({{NAME}}_node_t** nodes, size_t count, size_t threads)
+{
+    if (threads <= 1 || count < BULK_PARALLEL_CUTOFF)
+    {
+        return build_balanced(nodes, count);
+    }
+
+    const size_t middle = count / 2;
+
+    {{NAME}}_build_task_t tasks[2];
+    tasks[0].nodes = nodes;
+    tasks[0].count = middle;
+    tasks[0].threads = threads / 2;
+    tasks[1].nodes = nodes + middle + 1;
+    tasks[1].count = count - middle - 1;
+    tasks[1].threads = threads - threads / 2;
+
+    run_tasks(&build_balanced_worker, tasks, sizeof({{NAME}}_build_task_t), 2);
+
+    {{NAME}}_node_t* node = nodes[middle];
+    node->left = tasks[0].root;
+    node->right = tasks[1].root;
+    update_height(node);
+    update_size(node);
+    return node;
+}
+
+static bool put_arrays ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, size_t count, size_t threads)
+{
+    if (0 == count)
+    {
+        return true;
+    }
+
+    const size_t total = self->size + count;
+    {{NAME}}_node_t** fresh = ({{NAME}}_node_t**) malloc(total * sizeof({{NAME}}_node_t*));
+    {{NAME}}_node_t** scratch = ({{NAME}}_node_t**) malloc(total * sizeof({{NAME}}_node_t*));
+
+    if (NULL == fresh || NULL == scratch)
+    {
+        free(fresh);
+        free(scratch);
+        return false;
+    }
+
+    // Allocate all of the nodes up front, so that a failure leaves the tree untouched.
+    for (size_t i = 0; i < count; i++)
+    {
+        {{NAME}}_node_t* node = self->allocator->allocate(self->allocator);
+
+        if (NULL == node)
+        {
+            while (i > 0)
+            {
+                self->allocator->release(self->allocator, fresh[--i]);
+            }
+
+            free(fresh);
+            free(scratch);
+            return false;
+        }
+
+        node->key = keys[i];
+        node->value = values[i];
+        node->height = 0;
+        node->size = 1;
+        node->left = NULL;
+        node->right = NULL;
+        fresh[i] = node;
+    }
+
+    sort_nodes(self, fresh, scratch, count, threads);
+    const size_t unique = unique_nodes(self, fresh, count);
+
+    // The existing nodes are stored just past the new nodes, which leaves the scratch array free for the merge.
+    {{NAME}}_node_t** existing = fresh + count;
+    const size_t existing_count = flatten_nodes(self->root, existing, 0);
+    const size_t merged = union_nodes(self, existing, existing_count, fresh, unique, scratch);
+
+    self->root = build_balanced_parallel(scratch, merged, bulk_threads(threads, merged));
+    self->size = merged;
+
+    free(fresh);
+    free(scratch);
+    return true;
+}
+
+/**
+ * @brief Inserts many key-value pairs at once by sorting them and rebuilding the tree in linear time.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool {{NAME}}_putArrays ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, size_t count)
+{
+    return put_arrays(self, keys, values, count, 1);
+}
+
+{% if PARALLEL %}
+/**
+ * @brief Inserts many key-value pairs at once, sorting and building the tree using multiple threads.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to insert, in any order.
+ * @param values Data values associated with the keys, index for index.
+ * @param count Number of key-value pairs to insert.
+ * @param threads Maximum number of threads to use.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If a key occurs more than once, then the last occurrence wins.
+ */
+bool {{NAME}}_putArraysParallel ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, size_t count, size_t threads)
+{
+    return put_arrays(self, keys, values, count, threads);
+}
+{% end %}
+
+/**
+ * @brief Streams the key-value pairs of the AVL tree, in ascending order, into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs passed to the sink at once.
+ * @param sink Function receiving each chunk (keys and values, index for index), which returns false to stop the export.
+ * @param context Additional context passed to the sink.
+ * @return true if every pair was passed to the sink, false if the sink stopped the export or a buffer could not be allocated.
+ *
+ * The tree is traversed once, and only two buffers of chunk_size elements are allocated.
+ * The sink must not modify the tree.
+ */
+bool {{NAME}}_export ({{NAME}}_t* self, size_t chunk_size, bool (*sink)({{NAME}}_t*, {{KEY_TYPE}}*, {{VALUE_TYPE}}*, size_t, void*), void* context)
+{
+    if (0 == self->size)
+    {
+        return true;
+    }
+
+    // No chunk needs to be larger than the tree.
+    chunk_size = chunk_size < 1 ? 1 : (chunk_size > self->size ? self->size : chunk_size);
+
+    {{KEY_TYPE}}* keys = ({{KEY_TYPE}}*) malloc(chunk_size * sizeof({{KEY_TYPE}}));
+    {{VALUE_TYPE}}* values = ({{VALUE_TYPE}}*) malloc(chunk_size * sizeof({{VALUE_TYPE}}));
+    bool ok = NULL != keys && NULL != values;
+
+    // Iterative in-order traversal, which needs no parent pointers.
+    {{NAME}}_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    size_t length = 0;
+    {{NAME}}_node_t* node = self->root;
+
+    while (ok && (NULL != node || depth > 0))
+    {
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        keys[length] = node->key;
+        values[length] = node->value;
+        node = node->right;
+
+        if (++length == chunk_size)
+        {
+            ok = sink(self, keys, values, length, context);
+            length = 0;
+        }
+    }
+
+    if (ok && length > 0)
+    {
+        ok = sink(self, keys, values, length, context);
+    }
+
+    free(keys);
+    free(values);
+    return ok;
+}
+
+/**
+ * @brief Inserts the key-value pairs produced by a source, one chunk at a time.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of pairs requested from the source at once.
+ * @param source Function filling at most chunk_size keys and values, which returns the number of pairs filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if insertion was successful, false otherwise (the tree is then left unchanged).
+ *
+ * If the pairs arrive in strictly ascending order, as produced by {{NAME}}_export(), then the tree is built
+ * in linear time without sorting. Otherwise, the pairs are sorted first, and the last occurrence of a key wins.
+ */
+bool {{NAME}}_import ({{NAME}}_t* self, size_t chunk_size, size_t (*source)({{NAME}}_t*, {{KEY_TYPE}}*, {{VALUE_TYPE}}*, size_t, void*), void* context)
+{
+    chunk_size = chunk_size < 1 ? 1 : chunk_size;
+
+    {{KEY_TYPE}}* keys = ({{KEY_TYPE}}*) malloc(chunk_size * sizeof({{KEY_TYPE}}));
+    {{VALUE_TYPE}}* values = ({{VALUE_TYPE}}*) malloc(chunk_size * sizeof({{VALUE_TYPE}}));
+    {{NAME}}_node_t** fresh = NULL;
+    {{NAME}}_node_t** scratch = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool ok = NULL != keys && NULL != values;
+    bool sorted = true;
+
+    // Allocate all of the nodes, before the tree is touched, so that a failure leaves the tree unchanged.
+    while (ok)
+    {
+        const size_t length = source(self, keys, values, chunk_size, context);
+
+        if (0 == length)
+        {
+            break;
+        }
+
+        if (count + length > capacity)
+        {
+            capacity = 2 * (count + length);
+            {{NAME}}_node_t** grown = ({{NAME}}_node_t**) realloc(fresh, capacity * sizeof({{NAME}}_node_t*));
+            ok = NULL != grown;
+            fresh = ok ? grown : fresh;
+        }
+
+        for (size_t i = 0; ok && i < length; i++)
+        {
+            {{NAME}}_node_t* node = self->allocator->allocate(self->allocator);
+
+            if (NULL == node)
+            {
+                ok = false;
+                break;
+            }
+
+            node->key = keys[i];
+            node->value = values[i];
+            node->height = 0;
+            node->size = 1;
+            node->left = NULL;
+            node->right = NULL;
+            sorted = sorted && (0 == count || self->comparator(self, &fresh[count - 1]->key, &node->key) < 0);
+            fresh[count++] = node;
+        }
+    }
+
+    free(keys);
+    free(values);
+
+    // Room for the existing nodes, and a scratch array, are only needed to sort or to merge.
+    if (ok && (false == sorted || self->size > 0))
+    {
+        {{NAME}}_node_t** grown = ({{NAME}}_node_t**) realloc(fresh, (count + self->size + 1) * sizeof({{NAME}}_node_t*));
+        fresh = NULL != grown ? grown : fresh;
+        scratch = ({{NAME}}_node_t**) malloc((count + self->size + 1) * sizeof({{NAME}}_node_t*));
+        ok = NULL != grown && NULL != scratch;
+    }
+
+    if (false == ok)
+    {
+        while (count > 0)
+        {
+            self->allocator->release(self->allocator, fresh[--count]);
+        }
+    }
+    else
+    {
+        if (false == sorted)
+        {
+            sort_nodes(self, fresh, scratch, count, 1);
+            count = unique_nodes(self, fresh, count);
+        }
+
+        if (0 == self->size)
+        {
+            self->root = build_balanced(fresh, count);
+            self->size = count;
+        }
+        else
+        {
+            // The existing nodes are stored just past the new nodes, which leaves the scratch array free for the merge.
+            {{NAME}}_node_t** existing = fresh + count;
+            const size_t existing_count = flatten_nodes(self->root, existing, 0);
+            const size_t merged = union_nodes(self, existing, existing_count, fresh, count, scratch);
+
+            self->root = build_balanced(scratch, merged);
+            self->size = merged;
+        }
+    }
+
+    free(fresh);
+    free(scratch);
+    return ok;
+}
+
+typedef struct
+{
+    /**
+     * Room for the nodes of the largest subtree that a batch can create.
+     */
+    {{NAME}}_node_t** nodes;
+
+    /**
+     * Nodes allocated up front, one for each put, of which the puts into empty subtrees take theirs.
+     */
+    {{NAME}}_node_t** pool;
+
+    /**
+     * Number of nodes left in the pool.
+     */
+    size_t available;
+
+} {{NAME}}_batch_t;
+
+/**
+ * Applies a sorted run of operations, which have distinct keys, to a subtree.
+ * Returns the new root of the subtree.
+ */
+static {{NAME}}_node_t* apply_ops ({{NAME}}_t* self, {{NAME}}_node_t* node, {{NAME}}_op_t** ops, size_t count, {{NAME}}_batch_t* batch)
+{
+    if (0 == count)
+    {
+        return node;
+    }
+    else if (NULL == node)
+    {
+        // There is nothing here to remove, but the puts become a new balanced subtree.
+        size_t created = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (ops[i]->remove == false)
+            {
+                {{NAME}}_node_t* fresh = init_node(self, batch->pool[--batch->available], &ops[i]->key);
+                fresh->value = ops[i]->value;
+                batch->nodes[created++] = fresh;
+            }
+        }
+
+        return build_balanced(batch->nodes, created);
+    }
+
+    // Find the first operation, whose key is not less than the key of this node.
+    size_t lo = 0;
+    size_t hi = count;
+
+    while (lo < hi)
+    {
+        const size_t middle = lo + (hi - lo) / 2;
+
+        if (self->comparator(self, &ops[middle]->key, &node->key) < 0)
+        {
+            lo = middle + 1;
+        }
+        else
+        {
+            hi = middle;
+        }
+    }
+
+    const bool match = lo < count && self->comparator(self, &ops[lo]->key, &node->key) == 0;
+    const size_t after = match ? lo + 1 : lo;
+
+    {{NAME}}_node_t* left = apply_ops(self, node->left, ops, lo, batch);
+    {{NAME}}_node_t* right = apply_ops(self, node->right, ops + after, count - after, batch);
+
+    if (match && ops[lo]->remove)
+    {
+        self->allocator->release(self->allocator, node);
+        --self->size;
+        return join_trees(left, right);
+    }
+    else if (match)
+    {
+        node->value = ops[lo]->value;
+    }
+
+    return join_nodes(left, node, right);
+}
+
+/**
+ * @brief Applies a batch of put and remove operations in one pass over the tree.
+ * @param self Pointer to the AVL tree.
+ * @param ops Operations to apply, preferably sorted by key.
+ * @param count Number of operations in the batch.
+ * @return true if all of the operations were applied, false otherwise (the tree is then left unchanged).
+ *
+ * When several operations have the same key, the last one wins.
+ * Unsorted batches are sorted internally, without modifying the given array.
+ * A node is allocated up front for each put, before the tree is touched, and the nodes of puts that overwrite an existing key are released afterwards.
+ */
+bool {{NAME}}_applyBatch ({{NAME}}_t* self, {{NAME}}_op_t* ops, size_t count)
+{
+    if (0 == count)
+    {
+        return true;
+    }
+
+    {{NAME}}_op_t** sorted = ({{NAME}}_op_t**) malloc(count * sizeof({{NAME}}_op_t*));
+    {{NAME}}_node_t** nodes = ({{NAME}}_node_t**) malloc(count * sizeof({{NAME}}_node_t*));
+    {{NAME}}_node_t** pool = ({{NAME}}_node_t**) malloc(count * sizeof({{NAME}}_node_t*));
+
+    if (NULL == sorted || NULL == nodes || NULL == pool)
+    {
+        free(sorted);
+        free(nodes);
+        free(pool);
+        return false;
+    }
+
+    bool in_order = true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        sorted[i] = &ops[i];
+        in_order = in_order && (i == 0 || self->comparator(self, &ops[i - 1].key, &ops[i].key) < 0);
+    }
+
+    if (in_order == false)
+    {
+        // The node array is not needed yet, so it can double as the scratch space.
+        merge_sort_ops(self, sorted, ({{NAME}}_op_t**) nodes, count);
+    }
+
+    // Keep only the last operation of each run of equal keys.
+    size_t unique = 0;
+    size_t puts = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i + 1 == count || self->comparator(self, &sorted[i]->key, &sorted[i + 1]->key) != 0)
+        {
+            puts += sorted[i]->remove == false;
+            sorted[unique++] = sorted[i];
+        }
+    }
+
+    // Allocate a node for every put up front, so that a failure leaves the tree untouched.
+    {{NAME}}_batch_t batch;
+    batch.nodes = nodes;
+    batch.pool = pool;
+    batch.available = 0;
+
+    while (batch.available < puts)
+    {
+        {{NAME}}_node_t* node = self->allocator->allocate(self->allocator);
+
+        if (NULL == node)
+        {
+            break;
+        }
+
+        pool[batch.available++] = node;
+    }
+
+    const bool ok = batch.available == puts;
+
+    if (ok)
+    {
+        self->root = apply_ops(self, self->root, sorted, unique, &batch);
+    }
+
+    // Release the nodes of the puts, which overwrote an existing key, or all of them, if the batch failed.
+    while (batch.available > 0)
+    {
+        self->allocator->release(self->allocator, pool[--batch.available]);
+    }
+
+    free(sorted);
+    free(nodes);
+    free(pool);
+    return ok;
+}
+
+/**
+ * Number of operations that a diff passes to its sink at once.
+ */
+#define DIFF_CHUNK 1024
+
+/**
+ * An entry on the stack of a diff, which is either a subtree that has not been expanded yet, or a node to visit.
+ */
+typedef struct
+{
+    {{NAME}}_node_t* node;
+
+    bool subtree;
+
+} {{NAME}}_diff_entry_t;
+
+/**
+ * Replaces the subtree on top of a stack with its right subtree, its root, and its left subtree.
+ */
+static void diff_expand ({{NAME}}_diff_entry_t* stack, size_t* depth)
+{
+    {{NAME}}_node_t* node = stack[--*depth].node;
+
+    if (NULL != node)
+    {
+        stack[*depth].node = node->right;
+        stack[(*depth)++].subtree = true;
+        stack[*depth].node = node;
+        stack[(*depth)++].subtree = false;
+        stack[*depth].node = node->left;
+        stack[(*depth)++].subtree = true;
+    }
+}
+
+/**
+ * @brief Computes the operations that turn one AVL tree into another, and streams them into a sink, one chunk at a time.
+ * @param self Pointer to the AVL tree, which is the starting point.
+ * @param other Pointer to the AVL tree, which is the goal, and which must use the same comparator.
+ * @param sink Function receiving each chunk of operations, which returns false to stop the diff.
+ * @param context Additional context passed to the sink.
+ * @return true if every operation was passed to the sink, false if the sink stopped the diff or a buffer could not be allocated.
+ *
+ * Both trees are walked in order, side by side, which takes linear time. Only keys that are missing from
+ * the goal are removed, and only keys that are new or whose values differ (byte for byte) are put.
+ * Since the operations are sorted by key and the keys are distinct, {{NAME}}_applyBatch() applies them in a single pass.
+ */
+bool {{NAME}}_diff ({{NAME}}_t* self, {{NAME}}_t* other, bool (*sink)({{NAME}}_t*, {{NAME}}_op_t*, size_t, void*), void* context)
+{
+    {{NAME}}_op_t* ops = ({{NAME}}_op_t*) malloc(DIFF_CHUNK * sizeof({{NAME}}_op_t));
+    {{NAME}}_diff_entry_t left[2 * TREE_MAX_HEIGHT + 1];
+    {{NAME}}_diff_entry_t right[2 * TREE_MAX_HEIGHT + 1];
+    size_t left_depth = 1;
+    size_t right_depth = 1;
+    size_t count = 0;
+    bool ok = NULL != ops;
+
+    left[0].node = self->root;
+    left[0].subtree = true;
+    right[0].node = other->root;
+    right[0].subtree = true;
+
+    while (ok && (left_depth > 0 || right_depth > 0))
+    {
+        {{NAME}}_diff_entry_t* a = left_depth > 0 ? &left[left_depth - 1] : NULL;
+        {{NAME}}_diff_entry_t* b = right_depth > 0 ? &right[right_depth - 1] : NULL;
+
+        // Expand the subtrees on top of the stacks, until both sides are at a node.
+        if (NULL != a && a->subtree)
+        {
+            diff_expand(left, &left_depth);
+            continue;
+        }
+        else if (NULL != b && b->subtree)
+        {
+            diff_expand(right, &right_depth);
+            continue;
+        }
+
+        // Both sides are at a node (or exhausted), so their keys can be merged.
+        const int ordering = NULL == a ? +1 : (NULL == b ? -1 : self->comparator(self, &a->node->key, &b->node->key));
+
+        if (ordering < 0)
+        {
+            ops[count].remove = true;
+            ops[count].key = a->node->key;
+            ops[count].value = {{NAME}}_defaultValue();
+            ++count;
+            --left_depth;
+        }
+        else if (ordering > 0)
+        {
+            ops[count].remove = false;
+            ops[count].key = b->node->key;
+            ops[count].value = b->node->value;
+            ++count;
+            --right_depth;
+        }
+        else
+        {
+            if (0 != memcmp(&a->node->value, &b->node->value, sizeof({{VALUE_TYPE}})))
+            {
+                ops[count].remove = false;
+                ops[count].key = b->node->key;
+                ops[count].value = b->node->value;
+                ++count;
+            }
+
+            --left_depth;
+            --right_depth;
+        }
+
+        if (DIFF_CHUNK == count)
+        {
+            ok = sink(self, ops, count, context);
+            count = 0;
+        }
+    }
+
+    if (ok && count > 0)
+    {
+        ok = sink(self, ops, count, context);
+    }
+
+    free(ops);
+    return ok;
+}
+
+/**
+ * @brief Applies the operations produced by a source, one chunk at a time, such as a diff received from another process.
+ * @param self Pointer to the AVL tree.
+ * @param chunk_size Maximum number of operations requested from the source at once.
+ * @param source Function filling at most chunk_size operations, which returns the number of operations filled (zero at the end).
+ * @param context Additional context passed to the source.
+ * @return true if all of the operations were applied, false if a buffer or a node could not be allocated.
+ */
+bool {{NAME}}_applyPatch ({{NAME}}_t* self, size_t chunk_size, size_t (*source)({{NAME}}_t*, {{NAME}}_op_t*, size_t, void*), void* context)
+{
+    chunk_size = chunk_size < 1 ? 1 : chunk_size;
+    {{NAME}}_op_t* ops = ({{NAME}}_op_t*) malloc(chunk_size * sizeof({{NAME}}_op_t));
+    bool ok = NULL != ops;
+
+    while (ok)
+    {
+        const size_t count = source(self, ops, chunk_size, context);
+
+        if (0 == count)
+        {
+            break;
+        }
+
+        ok = {{NAME}}_applyBatch(self, ops, count);
+    }
+
+    free(ops);
+    return ok;
+}
+
+/**
+ * @brief Retrieves the value associated with a key in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+{{VALUE_TYPE}} {{NAME}}_get ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* node = {{NAME}}_getNode(self, key);
+
+    if (NULL == node)
+    {
+        return {{NAME}}_defaultValue();
+    }
+    else
+    {
+        return node->value;
+    }
+}
+
+/**
+ * Number of lookups, whose descents are interleaved, so that their cache misses overlap.
+ */
+#define GET_MANY_LANES 16
+
+static void prefetch_node ({{NAME}}_node_t* node)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(node);
+#endif
+}
+
+/**
+ * Looks up unsorted probes by advancing several descents one level at a time in turn.
+ * Each step prefetches the next node of its descent, which is loaded, while the other descents take their steps.
+ */
+static size_t get_interleaved ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, bool* found, size_t count)
+{
+    {{NAME}}_node_t* nodes[GET_MANY_LANES];
+    size_t probes[GET_MANY_LANES];
+    size_t lanes = 0;
+    size_t next = 0;
+    size_t hits = 0;
+
+    while (lanes < GET_MANY_LANES && next < count)
+    {
+        nodes[lanes] = self->root;
+        probes[lanes++] = next++;
+    }
+
+    while (lanes > 0)
+    {
+        for (size_t lane = 0; lane < lanes;)
+        {
+            {{NAME}}_node_t* node = nodes[lane];
+            const size_t probe = probes[lane];
+            const int ordering = NULL == node ? 0 : self->comparator(self, &keys[probe], &node->key);
+
+            if (NULL != node && 0 != ordering)
+            {
+                nodes[lane] = ordering < 0 ? node->left : node->right;
+                prefetch_node(nodes[lane]);
+                ++lane;
+                continue;
+            }
+            else if (NULL != node)
+            {
+                values[probe] = node->value;
+                hits++;
+
+                if (NULL != found)
+                {
+                    found[probe] = true;
+                }
+            }
+
+            // The lane is finished; hence, it starts the next probe, or it is replaced by the last lane.
+            if (next < count)
+            {
+                nodes[lane] = self->root;
+                probes[lane] = next++;
+            }
+            else
+            {
+                --lanes;
+                nodes[lane] = nodes[lanes];
+                probes[lane] = probes[lanes];
+            }
+        }
+    }
+
+    return hits;
+}
+
+/**
+ * @brief Retrieves the values associated with many keys in the AVL tree, overlapping their lookups.
+ * @param self Pointer to the AVL tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
+ */
+size_t {{NAME}}_getMany ({{NAME}}_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, bool* found, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = {{NAME}}_defaultValue();
+
+        if (NULL != found)
+        {
+            found[i] = false;
+        }
+    }
+
+    return get_interleaved(self, keys, values, found, count);
+}
+
+/**
+ * @brief Removes a key and its value from the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to remove.
+ */
+void {{NAME}}_remove ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* deleted = NULL;
+    self->root = delete_node(self, self->root, &key, &deleted);
+
+    if (NULL != deleted)
+    {
+        self->allocator->release(self->allocator, deleted);
+        --self->size;
+    }
+}
+
+/**
+ * @brief Removes the first value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ */
+void {{NAME}}_removeFirst ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+
+    if (NULL != node)
+    {
+        {{NAME}}_remove(self, node->key);
+    }
+}
+
+/**
+ * @brief Removes the last value in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ */
+void {{NAME}}_removeLast ({{NAME}}_t* self)
+{
+    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+
+    if (NULL != node)
+    {
+        {{NAME}}_remove(self, node->key);
+    }
+}
+
+/**
+ * @brief Removes nodes from the tree based on a predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ */
+void {{NAME}}_removeIf ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    // The next node is found by key, since removing a node may move the other nodes.
+    for ({{NAME}}_node_t* node = {{NAME}}_firstNode(self); NULL != node;)
+    {
+        {{KEY_TYPE}} key = node->key;
+
+        if (predicate(self, node, context))
+        {
+            {{NAME}}_remove(self, key);
+        }
+
+        node = {{NAME}}_higherNode(self, key);
+    }
+}
+
+/**
+ * Releases the nodes of a detached subtree in ascending order, after passing each one to the callback.
+ */
+static void release_nodes ({{NAME}}_t* self, {{NAME}}_node_t* node, void (*callback)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    while (NULL != node)
+    {
+        release_nodes(self, node->left, callback, context);
+
+        if (NULL != callback)
+        {
+            callback(self, node, context);
+        }
+
+        // The right subtree is released iteratively, since it is read after the node is released.
+        {{NAME}}_node_t* right = node->right;
+        self->allocator->release(self->allocator, node);
+        node = right;
+    }
+}
+
+/**
+ * @brief Removes the nodes, whose keys are in a half-open range, in O(log n + k) time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Inclusive lower bound of the keys.
+ * @param hi Exclusive upper bound of the keys.
+ * @param callback Function that receives each removed node, in ascending order, before it is released, or NULL.
+ * @param context Additional context passed to the callback.
+ * @return Number of removed nodes.
+ */
+size_t {{NAME}}_removeRange ({{NAME}}_t* self, {{KEY_TYPE}} lo, {{KEY_TYPE}} hi, void (*callback)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    if (self->comparator(self, &lo, &hi) >= 0)
+    {
+        return 0;
+    }
+
+    {{NAME}}_node_t* lesser = NULL;
+    {{NAME}}_node_t* rest = NULL;
+    {{NAME}}_node_t* range = NULL;
+    {{NAME}}_node_t* greater = NULL;
+
+    split_nodes(self, self->root, &lo, &lesser, &rest);
+    split_nodes(self, rest, &hi, &range, &greater);
+
+    const size_t removed = size_of(range);
+    self->root = join_trees(lesser, greater);
+    self->size -= removed;
+
+    release_nodes(self, range, callback, context);
+    return removed;
+}
+
+/**
+ * @brief Applies a function to each node in the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @param functor Function to apply to each node.
+ * @param context Additional context passed to the functor.
+ */
+void {{NAME}}_forEach ({{NAME}}_t* self, void (*functor)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {
+        while ({{NAME}}_iter_hasNext(&iter))
+        {
+            {{NAME}}_iter_next(&iter);
+            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            functor(self, node, context);
+        }
+    }
+    {{NAME}}_iter_free(&iter);
+}
+
+/**
+ * Finds the first node in key order, whose key is in a half-open range (where NULL means unbounded),
+ * and for which the predicate returns the wanted result. Subtrees outside of the range are skipped.
+ */
+static {{NAME}}_node_t* find_match ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context, bool wanted)
+{
+    while (NULL != node)
+    {
+        if (NULL != lo && self->comparator(self, &node->key, lo) < 0)
+        {
+            node = node->right;
+        }
+        else if (NULL != hi && self->comparator(self, &node->key, hi) >= 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            // The node is in the range; hence, its left subtree is below the upper bound,
+            // and its right subtree is above the lower bound.
+            {{NAME}}_node_t* found = find_match(self, node->left, lo, NULL, predicate, context, wanted);
+
+            if (NULL != found)
+            {
+                return found;
+            }
+            else if (predicate(self, node, context) == wanted)
+            {
+                return node;
+            }
+
+            node = node->right;
+            lo = NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static size_t count_matches ({{NAME}}_t* self, {{NAME}}_node_t* node, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    size_t count = 0;
+
+    while (NULL != node)
+    {
+        count += count_matches(self, node->left, predicate, context);
+        count += predicate(self, node, context) ? 1 : 0;
+        node = node->right;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Checks if any nodes match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if any match found, false otherwise.
+ */
+bool {{NAME}}_anyMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    return NULL != find_match(self, self->root, NULL, NULL, predicate, context, true);
+}
+
+/**
+ * @brief Checks if all nodes match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if all nodes match, false otherwise.
+ */
+bool {{NAME}}_allMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, NULL, NULL, predicate, context, false);
+}
+
+/**
+ * @brief Checks if none of the nodes match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if none match, false otherwise.
+ */
+bool {{NAME}}_noneMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, NULL, NULL, predicate, context, true);
+}
+
+/**
+ * @brief Checks if any nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if any match found, false otherwise.
+ */
+bool {{NAME}}_anyMatchRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    return NULL != find_match(self, self->root, lo, hi, predicate, context, true);
+}
+
+/**
+ * @brief Checks if all nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if all nodes in the range match, false otherwise.
+ */
+bool {{NAME}}_allMatchRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, lo, hi, predicate, context, false);
+}
+
+/**
+ * @brief Checks if none of the nodes, whose keys are in a half-open range, match the given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return true if none match, false otherwise.
+ */
+bool {{NAME}}_noneMatchRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    return NULL == find_match(self, self->root, lo, hi, predicate, context, true);
+}
+
+/**
+ * @brief Counts the number of nodes matching a given predicate.
+ * @param self Pointer to the AVL tree.
+ * @param predicate Function pointer to the predicate to evaluate.
+ * @param context Additional context passed to the predicate.
+ * @return Count of nodes matching the predicate.
+ */
+size_t {{NAME}}_count ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    // The nodes are visited in key order, like an iterator would, but without a search per node.
+    return count_matches(self, self->root, predicate, context);
+}
+
+/**
+ * @brief Checks if two trees are equal based on a comparison predicate.
+ * @param self Pointer to the first AVL tree.
+ * @param other Pointer to the second AVL tree.
+ * @param predicate Function pointer for node comparison.
+ * @param context Additional context passed to the predicate.
+ * @return true if the trees are equal, false otherwise.
+ */
+bool {{NAME}}_isEqual ({{NAME}}_t* self, {{NAME}}_t* other, bool (*predicate)({{NAME}}_node_t*, {{NAME}}_node_t*, void*), void* context)
+{
+    if ({{NAME}}_size(self) != {{NAME}}_size(other))
+    {
+        return false;
+    }
+
+    {{NAME}}_iterator_t iterX = {{NAME}}_iter(self);
+    {
+        {{NAME}}_iterator_t iterY = {{NAME}}_iter(other);
+        {
+            while ({{NAME}}_iter_hasNext(&iterX))
+            {
+                {{NAME}}_iter_next(&iterX);
+                {{NAME}}_iter_next(&iterY);
+
+                {{NAME}}_node_t* nodeX = {{NAME}}_iter_node(&iterX);
+                {{NAME}}_node_t* nodeY = {{NAME}}_iter_node(&iterY);
+
+                if (predicate(nodeX, nodeY, context) == false)
+                {
+                    return false;
+                }
+            }
+        }
+        {{NAME}}_iter_free(&iterY);
+    }
+    {{NAME}}_iter_free(&iterX);
+    return true;
+}
+
+/**
+ * @brief Creates an iterator for the AVL tree.
+ * @param self Pointer to the AVL tree.
+ * @return Iterator structure for the tree.
+ */
+{{NAME}}_iterator_t {{NAME}}_iter ({{NAME}}_t* self)
+{
+    return {{NAME}}_iter_atNode(self, NULL);
+}
+
+/**
+ * @brief Creates an iterator starting at a specific key in the tree.
+ * @param self Pointer to the AVL tree.
+ * @param key Key to start the iteration at.
+ * @return Iterator structure for the tree starting at the given key.
+ */
+{{NAME}}_iterator_t {{NAME}}_iter_at ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* node = find_node(self, self->root, &key);
+    return {{NAME}}_iter_atNode(self, node);
+}
+
+/**
+ * @brief Creates an iterator starting at a specific node in the tree.
+ * @param self Pointer to the AVL tree.
+ * @param node Node to start the iteration at.
+ * @return Iterator structure for the tree starting at the given node.
+ */
+{{NAME}}_iterator_t {{NAME}}_iter_atNode ({{NAME}}_t* self, {{NAME}}_node_t* node)
+{
+    {{NAME}}_iterator_t result;
+    result.owner = self;
+    result.node = node;
+    return result;
+}
+
+/**
+ * @brief Frees the resources associated with a tree iterator.
+ * @param self Pointer to the tree iterator to free.
+ */
+void {{NAME}}_iter_free ({{NAME}}_iterator_t* self)
+{
+    if (NULL != self)
+    {
+        self->owner = NULL;
+        self->node = NULL;
+    }
+}
+
+/**
+ * @brief Checks if the iterator has a next element.
+ * @param self Pointer to the tree iterator.
+ * @return true if there is a next element, false otherwise.
+ */
+bool {{NAME}}_iter_hasNext ({{NAME}}_iterator_t* self)
+{
+    if ({{NAME}}_isEmpty(self->owner))
+    {
+        return false;
+    }
+    else if (NULL == self->node)
+    {
+        return true;
+    }
+    else
+    {
+        {{KEY_TYPE}} key = self->node->key;
+        return NULL != {{NAME}}_higherNode(self->owner, key);
+    }
+}
+
+/**
+ * @brief Checks if the iterator has a previous element.
+ * @param self Pointer to the tree iterator.
+ * @return true if there is a previous element, false otherwise.
+ */
+bool {{NAME}}_iter_hasPrev ({{NAME}}_iterator_t* self)
+{
+    if ({{NAME}}_isEmpty(self->owner))
+    {
+        return false;
+    }
+    else if (NULL == self->node)
+    {
+        return true;
+    }
+    else
+    {
+        {{KEY_TYPE}} key = self->node->key;
+        return NULL != {{NAME}}_lowerNode(self->owner, key);
+    }
+}
+
+/**
+ * @brief Advances the iterator to the next element.
+ * @param self Pointer to the tree iterator.
+ */
+void {{NAME}}_iter_next ({{NAME}}_iterator_t* self)
+{
+    if ({{NAME}}_isEmpty(self->owner) == false)
+    {
+        if (NULL == self->node)
+        {
+            self->node = {{NAME}}_firstNode(self->owner);
+        }
+        else
+        {
+            {{KEY_TYPE}} key = self->node->key;
+            self->node = {{NAME}}_higherNode(self->owner, key);
+
+            // Iterators can be circular.
+            if (NULL == self->node)
+            {
+                self->node = {{NAME}}_firstNode(self->owner);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Moves the iterator to the previous element.
+ * @param self Pointer to the tree iterator.
+ */
+void {{NAME}}_iter_prev ({{NAME}}_iterator_t* self)
+{
+    if ({{NAME}}_isEmpty(self->owner) == false)
+    {
+        if (NULL == self->node)
+        {
+            self->node = {{NAME}}_lastNode(self->owner);
+        }
+        else
+        {
+            {{KEY_TYPE}} key = self->node->key;
+            self->node = {{NAME}}_lowerNode(self->owner, key);
+
+            // Iterators can be circular.
+            if (NULL == self->node)
+            {
+                self->node = {{NAME}}_lastNode(self->owner);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Retrieves the current node from the iterator.
+ * @param self Pointer to the tree iterator.
+ * @return Pointer to the current node.
+ */
+{{NAME}}_node_t* {{NAME}}_iter_node ({{NAME}}_iterator_t* self)
+{
+    return self->node;
+}
+
+/**
+ * @brief Retrieves the key of the current node from the iterator.
+ * @param self Pointer to the tree iterator.
+ * @return Key of the current node.
+ */
+{{KEY_TYPE}} {{NAME}}_iter_key ({{NAME}}_iterator_t* self)
+{
+    if (NULL == self->node)
+    {
+        return {{NAME}}_defaultKey();
+    }
+    else
+    {
+        return self->node->key;
+    }
+}
+
+/**
+ * @brief Sets the data value of the current node in the iterator.
+ * @param self Pointer to the tree iterator.
+ * @param value Data value to set.
+ */
+void {{NAME}}_iter_set ({{NAME}}_iterator_t* self, {{VALUE_TYPE}} value)
+{
+    self->node->value = value;
+{% if SUBTREE_HASH or AGGREGATE %}
+    update_path(self->owner, self->node);
+{% end %}
+}
+
+/**
+ * @brief Retrieves the data value of the current node from the iterator.
+ * @param self Pointer to the tree iterator.
+ * @return Data value of the current node.
+ */
+{{VALUE_TYPE}} {{NAME}}_iter_get ({{NAME}}_iterator_t* self)
+{
+    if (NULL == self->node)
+    {
+        return {{NAME}}_defaultValue();
+    }
+    else
+    {
+        return self->node->value;
+    }
+}
+
+static bool range_below_hi ({{NAME}}_range_t* self, {{NAME}}_node_t* node)
+{
+    const int ordering = self->owner->comparator(self->owner, &node->key, &self->hi);
+    return ordering < 0 || (0 == ordering && self->hi_inclusive);
+}
+
+/**
+ * Pushes the nodes on the path to the least key of a subtree, which are not above the upper bound.
+ * A node above the bound is skipped, since the nodes after it in key order are above the bound too.
+ */
+static void range_push_left ({{NAME}}_range_t* self, {{NAME}}_node_t* node)
+{
+    for (; NULL != node; node = node->left)
+    {
+        if (range_below_hi(self, node))
+        {
+            self->stack[self->depth++] = node;
+        }
+    }
+}
+
+/**
+ * @brief Positions a range cursor before the first node, whose key is between two bounds, in a single descent.
+ * @param self Pointer to the range cursor.
+ * @param owner Pointer to the AVL tree.
+ * @param lo Lower bound of the keys.
+ * @param lo_inclusive Whether the lower bound itself is in the range.
+ * @param hi Upper bound of the keys.
+ * @param hi_inclusive Whether the upper bound itself is in the range.
+ */
+void {{NAME}}_range_seek ({{NAME}}_range_t* self, {{NAME}}_t* owner, {{KEY_TYPE}} lo, bool lo_inclusive, {{KEY_TYPE}} hi, bool hi_inclusive)
+{
+    self->owner = owner;
+    self->node = NULL;
+    self->hi = hi;
+    self->hi_inclusive = hi_inclusive;
+    self->depth = 0;
+
+    {{NAME}}_node_t* node = owner->root;
+
+    while (NULL != node)
+    {
+        const int ordering = owner->comparator(owner, &node->key, &lo);
+
+        if (ordering < 0 || (0 == ordering && false == lo_inclusive))
+        {
+            // The node and its left subtree are below the lower bound.
+            node = node->right;
+        }
+        else
+        {
+            if (range_below_hi(self, node))
+            {
+                self->stack[self->depth++] = node;
+            }
+
+            node = node->left;
+        }
+    }
+}
+
+/**
+ * @brief Checks if the range cursor has a next node.
+ * @param self Pointer to the range cursor.
+ * @return true if there is a next node in the range, false otherwise.
+ */
+bool {{NAME}}_range_hasNext ({{NAME}}_range_t* self)
+{
+    return self->depth > 0;
+}
+
+/**
+ * @brief Advances the range cursor to the next node.
+ * @param self Pointer to the range cursor.
+ */
+void {{NAME}}_range_next ({{NAME}}_range_t* self)
+{
+    if (0 == self->depth)
+    {
+        self->node = NULL;
+        return;
+    }
+
+    // The right subtree of a node follows it, and is above the lower bound.
+    self->node = self->stack[--self->depth];
+    range_push_left(self, self->node->right);
+}
+
+/**
+ * @brief Retrieves the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Pointer to the current node, or NULL if the cursor is not at a node.
+ */
+{{NAME}}_node_t* {{NAME}}_range_node ({{NAME}}_range_t* self)
+{
+    return self->node;
+}
+
+/**
+ * @brief Retrieves the key of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Key of the current node.
+ */
+{{KEY_TYPE}} {{NAME}}_range_key ({{NAME}}_range_t* self)
+{
+    return NULL == self->node ? {{NAME}}_defaultKey() : self->node->key;
+}
+
+/**
+ * @brief Retrieves the data value of the current node of the range cursor.
+ * @param self Pointer to the range cursor.
+ * @return Data value of the current node.
+ */
+{{VALUE_TYPE}} {{NAME}}_range_get ({{NAME}}_range_t* self)
+{
+    return NULL == self->node ? {{NAME}}_defaultValue() : self->node->value;
+}
+
+/**
+ * @brief Initializes a finger at the root of a tree.
+ * @param self Pointer to the finger.
+ * @param owner Pointer to the AVL tree.
+ */
+void {{NAME}}_finger_init ({{NAME}}_finger_t* self, {{NAME}}_t* owner)
+{
+    self->owner = owner;
+    self->depth = 0;
+
+    if (NULL != owner->root)
+    {
+        self->path[0] = owner->root;
+        self->lower[0] = NULL;
+        self->upper[0] = NULL;
+        self->depth = 1;
+    }
+}
+
+/**
+ * @brief Moves a finger to the node with a given key, or to the last node on its search path.
+ *
+ * The search starts from the nearest node on the path of the finger, whose subtree spans the key,
+ * so that a scan in key order costs amortized constant time per key, and no search costs more than get().
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Pointer to the node with the key, or NULL if the key is not in the tree.
+ */
+{{NAME}}_node_t* {{NAME}}_finger_seek ({{NAME}}_finger_t* self, {{KEY_TYPE}} key)
+{
+    if (0 == self->depth)
+    {
+        return NULL;
+    }
+
+    {{NAME}}_t* owner = self->owner;
+    size_t level = self->depth - 1;
+
+    // Climb to the nearest node on the path, whose subtree spans the key. The subtrees of the nodes on the path,
+    // which share a bound, all miss the key if one misses it; hence, each distinct bound is compared only once.
+    // The subtree of the root spans every key, so the climb stops there at the latest.
+    while (NULL != self->lower[level] && owner->comparator(owner, &key, &self->lower[level]->key) <= 0)
+    {
+        const {{NAME}}_node_t* bound = self->lower[level];
+
+        while (bound == self->lower[level])
+        {
+            --level;
+        }
+    }
+
+    while (NULL != self->upper[level] && owner->comparator(owner, &self->upper[level]->key, &key) <= 0)
+    {
+        const {{NAME}}_node_t* bound = self->upper[level];
+
+        while (bound == self->upper[level])
+        {
+            --level;
+        }
+    }
+
+    self->depth = level + 1;
+    {{NAME}}_node_t* node = self->path[level];
+
+    while (true)
+    {
+        const int ordering = owner->comparator(owner, &key, &node->key);
+
+        if (0 == ordering)
+        {
+            return node;
+        }
+
+        {{NAME}}_node_t* child = ordering < 0 ? node->left : node->right;
+
+        if (NULL == child)
+        {
+            return NULL;
+        }
+
+        // The node bounds the subtree of its child from the side, from which the child hangs.
+        self->path[level + 1] = child;
+        self->lower[level + 1] = ordering < 0 ? self->lower[level] : node;
+        self->upper[level + 1] = ordering < 0 ? node : self->upper[level];
+        self->depth = ++level + 1;
+        node = child;
+    }
+}
+
+/**
+ * @brief Retrieves the data value associated with a given key by a search from a finger.
+ * @param self Pointer to the finger.
+ * @param key Key to search for.
+ * @return Data value associated with the key, or the default value if the key is not in the tree.
+ */
+{{VALUE_TYPE}} {{NAME}}_finger_get ({{NAME}}_finger_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_node_t* node = {{NAME}}_finger_seek(self, key);
+    return NULL == node ? {{NAME}}_defaultValue() : node->value;
+}
+
+/**
+ * @brief Retrieves the key of a given tree node.
+ * @param self Pointer to the tree node.
+ * @return Key of the node.
+ */
+{{KEY_TYPE}} {{NAME}}_node_key ({{NAME}}_node_t* self)
+{
+    if (NULL == self)
+    {
+        return {{NAME}}_defaultKey();
+    }
+    else
+    {
+        return self->key;
+    }
+}
+
+/**
+ * @brief Sets the data value of a given tree node.
+ * @param self Pointer to the tree node.
+ * @param value The data value to set.
+{% if SUBTREE_HASH or AGGREGATE %}
+ *
+ * The node does not know its tree; therefore, the hashes and aggregates of the node and its ancestors are not updated.
+ * Use setNode() instead, unless rehash() or reaggregate() is called afterwards.
+{% end %}
+ */
+void {{NAME}}_node_set ({{NAME}}_node_t* self, {{VALUE_TYPE}} value)
+{
+    self->value = value;
+}
+
+/**
+ * @brief Retrieves the data value of a given tree node.
+ * @param self Pointer to the tree node.
+ * @return Data value of the node.
+ */
+{{VALUE_TYPE}} {{NAME}}_node_get ({{NAME}}_node_t* self)
+{
+    if (NULL == self)
+    {
+        return {{NAME}}_defaultValue();
+    }
+    else
+    {
+        return self->value;
+    }
+}
+
+{% if MULTIQUEUE %}
+/**
+ * One of the trees in a multiqueue, which is aligned to its own cache line,
+ * so that threads working on neighboring trees do not contend for the same line.
+ */
+typedef struct
+{
+    _Alignas(64) atomic_flag lock;
+
+    {{NAME}}_t tree;
+
+} {{NAME}}_multiqueue_slot_t;
+
+struct {{NAME}}_multiqueue
+{
+    size_t queues;
+
+    atomic_size_t size;
+
+    atomic_uint_fast64_t sequence;
+
+    {{NAME}}_multiqueue_slot_t* slots;
+
+};
+
+/**
+ * Each thread has its own random number generator, which is seeded upon first use.
+ */
+static _Thread_local uint64_t MULTIQUEUE_RANDOM_STATE = 0;
+
+static atomic_uint_fast64_t MULTIQUEUE_RANDOM_SEEDS = 0;
+
+static size_t multiqueue_random ({{NAME}}_multiqueue_t* self)
+{
+    uint64_t x = MULTIQUEUE_RANDOM_STATE;
+
+    if (0 == x)
+    {
+        x = (atomic_fetch_add(&MULTIQUEUE_RANDOM_SEEDS, 1) + 1) * UINT64_C(0x9E3779B97F4A7C15);
+    }
+
+    // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    MULTIQUEUE_RANDOM_STATE = x;
+
+    return (size_t) (x % self->queues);
+}
+
+static bool multiqueue_try_lock ({{NAME}}_multiqueue_slot_t* slot)
+{
+    return atomic_flag_test_and_set_explicit(&slot->lock, memory_order_acquire) == false;
+}
+
+static void multiqueue_unlock ({{NAME}}_multiqueue_slot_t* slot)
+{
+    atomic_flag_clear_explicit(&slot->lock, memory_order_release);
+}
+
+/**
+ * Locks a randomly chosen tree, choosing again whenever the chosen tree is busy.
+ */
+static {{NAME}}_multiqueue_slot_t* multiqueue_lock_any ({{NAME}}_multiqueue_t* self)
+{
+    while (true)
+    {
+        {{NAME}}_multiqueue_slot_t* slot = &self->slots[multiqueue_random(self)];
+
+        if (multiqueue_try_lock(slot))
+        {
+            return slot;
+        }
+    }
+}
+
+/**
+ * Removes the first element of a locked tree, if the tree is not empty.
+ */
+static bool multiqueue_take_first ({{NAME}}_multiqueue_t* self, {{NAME}}_multiqueue_slot_t* slot, {{KEY_TYPE}}* key, {{VALUE_TYPE}}* value)
+{
+    {{NAME}}_node_t* node = {{NAME}}_firstNode(&slot->tree);
+
+    if (NULL == node)
+    {
+        return false;
+    }
+
+    if (NULL != key)
+    {
+        *key = node->key;
+    }
+
+    if (NULL != value)
+    {
+        *value = node->value;
+    }
+
+    {{NAME}}_removeFirst(&slot->tree);
+    atomic_fetch_sub_explicit(&self->size, 1, memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Creates a new multiqueue using the natural ordering of keys.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ */
+{{NAME}}_multiqueue_t* {{NAME}}_multiqueue_new (size_t queues)
+{
+    return {{NAME}}_multiqueue_make(queues, {{NAME}}_comparator_naturalOrder());
+}
+
+/**
+ * @brief Creates a new multiqueue with a specified comparator.
+ * @param queues Number of internal trees, which is usually a small multiple of the number of threads.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created multiqueue or NULL if allocation failed.
+ */
+{{NAME}}_multiqueue_t* {{NAME}}_multiqueue_make (size_t queues, {{NAME}}_comparator_t comparator)
+{
+    {{NAME}}_multiqueue_t* self = ({{NAME}}_multiqueue_t*) calloc(1, sizeof({{NAME}}_multiqueue_t));
+
+    if (NULL == self)
+    {
+        return NULL;
+    }
+
+    self->queues = queues < 1 ? 1 : queues;
+    atomic_init(&self->size, 0);
+    atomic_init(&self->sequence, 0);
+    self->slots = ({{NAME}}_multiqueue_slot_t*) aligned_alloc(_Alignof({{NAME}}_multiqueue_slot_t), self->queues * sizeof({{NAME}}_multiqueue_slot_t));
+
+    if (NULL == self->slots)
+    {
+        free(self);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < self->queues; i++)
+    {
+        atomic_flag_clear(&self->slots[i].lock);
+        self->slots[i].tree = {{NAME}}_make_stackalloc({{NAME}}_allocator_dynamic(), comparator);
+    }
+
+    return self;
+}
+
+/**
+ * @brief Frees the resources of a multiqueue, which must no longer be in use by any thread.
+ * @param self Pointer to the multiqueue to free.
+ */
+void {{NAME}}_multiqueue_free ({{NAME}}_multiqueue_t* self)
+{
+    if (NULL != self)
+    {
+        for (size_t i = 0; i < self->queues; i++)
+        {
+            {{NAME}}_free_stackalloc(&self->slots[i].tree);
+        }
+
+        free(self->slots);
+        free(self);
+    }
+}
+
+/**
+ * @brief Retrieves the number of elements in the multiqueue, which may be stale under concurrent use.
+ * @param self Pointer to the multiqueue.
+ * @return Number of elements in the multiqueue.
+ */
+size_t {{NAME}}_multiqueue_size ({{NAME}}_multiqueue_t* self)
+{
+    return atomic_load_explicit(&self->size, memory_order_relaxed);
+}
+
+/**
+ * @brief Inserts a key-value pair into the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Key, which is the priority of the element.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool {{NAME}}_multiqueue_put ({{NAME}}_multiqueue_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
+{
+    {{NAME}}_multiqueue_slot_t* slot = multiqueue_lock_any(self);
+    const size_t before = {{NAME}}_size(&slot->tree);
+    const bool result = {{NAME}}_put(&slot->tree, key, value);
+    const size_t after = {{NAME}}_size(&slot->tree);
+
+    // Count the element before it can be popped, so that the size never drops below zero.
+    atomic_fetch_add_explicit(&self->size, after - before, memory_order_relaxed);
+    multiqueue_unlock(slot);
+
+    return result;
+}
+
+{% if DEQUE %}
+/**
+ * @brief Pushes a value with the next sequence number as its key (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param value Data value to push.
+ * @return true if the push was successful, false otherwise.
+ */
+bool {{NAME}}_multiqueue_push ({{NAME}}_multiqueue_t* self, {{VALUE_TYPE}} value)
+{
+    const uint_fast64_t sequence = atomic_fetch_add_explicit(&self->sequence, 1, memory_order_relaxed);
+    return {{NAME}}_multiqueue_put(self, ({{KEY_TYPE}}) sequence, value);
+}
+{% end %}
+
+/**
+ * @brief Removes an element with a small key from the multiqueue (thread-safe).
+ * @param self Pointer to the multiqueue.
+ * @param key Output for the key of the removed element, or NULL.
+ * @param value Output for the data value of the removed element, or NULL.
+ * @return true if an element was removed, false if the multiqueue was observed to be empty.
+ */
+bool {{NAME}}_multiqueue_popFirst ({{NAME}}_multiqueue_t* self, {{KEY_TYPE}}* key, {{VALUE_TYPE}}* value)
+{
+    while (atomic_load_explicit(&self->size, memory_order_relaxed) > 0)
+    {
+        {{NAME}}_multiqueue_slot_t* x = multiqueue_lock_any(self);
+        {{NAME}}_multiqueue_slot_t* y = &self->slots[multiqueue_random(self)];
+
+        // The second tree is optional, so that a busy tree never blocks the removal.
+        if (x == y || multiqueue_try_lock(y) == false)
+        {
+            y = NULL;
+        }
+
+        {{NAME}}_node_t* first_x = {{NAME}}_firstNode(&x->tree);
+        {{NAME}}_node_t* first_y = NULL == y ? NULL : {{NAME}}_firstNode(&y->tree);
+        {{NAME}}_multiqueue_slot_t* winner = x;
+
+        if (NULL == first_x || (NULL != first_y && x->tree.comparator(&x->tree, &first_y->key, &first_x->key) < 0))
+        {
+            winner = y;
+        }
+
+        const bool removed = NULL != winner && multiqueue_take_first(self, winner, key, value);
+
+        multiqueue_unlock(x);
+
+        if (NULL != y)
+        {
+            multiqueue_unlock(y);
+        }
+
+        if (removed)
+        {
+            return true;
+        }
+    }
+
+    // Confirm that the multiqueue is really empty by visiting every tree.
+    for (size_t i = 0; i < self->queues; i++)
+    {
+        {{NAME}}_multiqueue_slot_t* slot = &self->slots[i];
+
+        while (multiqueue_try_lock(slot) == false)
+        {
+            // Spin, because this tree must be inspected.
+        }
+
+        const bool removed = multiqueue_take_first(self, slot, key, value);
+        multiqueue_unlock(slot);
+
+        if (removed)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+{% end %}
+
+{% if WRITE_BEHIND %}
+/**
+ * A slot in the ring buffer of a write-behind queue.
+ * The sequence number tells whether the slot is free, or holds a published operation (Vyukov's bounded queue).
+ */
+typedef struct
+{
+    atomic_size_t sequence;
+
+    {{NAME}}_op_t op;
+
+} {{NAME}}_writebehind_cell_t;
+
+struct {{NAME}}_writebehind
+{
+    {{NAME}}_t* tree;
+
+    pthread_rwlock_t tree_lock;
+
+    size_t mask;
+
+    size_t batch_size;
+
+    uint64_t max_latency_ns;
+
+    {{NAME}}_op_t* batch;
+
+    {{NAME}}_writebehind_cell_t* cells;
+
+    _Alignas(64) atomic_size_t enqueue_position;
+
+    _Alignas(64) atomic_size_t dequeue_position;
+
+    atomic_uint_fast64_t stalls;
+
+    atomic_bool flush_requested;
+
+    atomic_bool stopping;
+
+    /**
+     * Enqueue position, at which the writer that reaches it wakes the waiting applier, or SIZE_MAX if the applier is not waiting.
+     */
+    atomic_size_t wake_position;
+
+    /**
+     * The following fields are guarded by the mutex.
+     */
+    pthread_mutex_t mutex;
+
+    pthread_cond_t wakeup;
+
+    pthread_cond_t applied_changed;
+
+    size_t applied;
+
+    size_t max_depth;
+
+    uint64_t batches;
+
+    uint64_t failures;
+
+    pthread_t applier;
+
+};
+
+static uint64_t writebehind_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+static void writebehind_enqueue ({{NAME}}_writebehind_t* self, {{NAME}}_op_t* op)
+{
+    size_t position = atomic_load_explicit(&self->enqueue_position, memory_order_relaxed);
+
+    while (true)
+    {
+        {{NAME}}_writebehind_cell_t* cell = &self->cells[position & self->mask];
+        const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+        if (difference == 0)
+        {
+            // The slot is free, so try to claim it.
+            // Claiming is sequentially consistent, so that either the applier sees the claim, or this writer sees the wake position.
+            if (atomic_compare_exchange_weak_explicit(&self->enqueue_position, &position, position + 1, memory_order_seq_cst, memory_order_relaxed))
+            {
+                cell->op = *op;
+                atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+                // Only the one writer, which reaches the wake position, takes the mutex.
+                if (position + 1 == atomic_load(&self->wake_position))
+                {
+                    pthread_mutex_lock(&self->mutex);
+                    pthread_cond_signal(&self->wakeup);
+                    pthread_mutex_unlock(&self->mutex);
+                }
+
+                return;
+            }
+        }
+        else if (difference < 0)
+        {
+            // The ring buffer is full, so give the applier a chance to drain it.
+            atomic_fetch_add_explicit(&self->stalls, 1, memory_order_relaxed);
+            sched_yield();
+            position = atomic_load_explicit(&self->enqueue_position, memory_order_relaxed);
+        }
+        else
+        {
+            // Another writer claimed the slot first.
+            position = atomic_load_explicit(&self->enqueue_position, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Moves published operations from the ring buffer into the batch, until the batch is full.
+ * Only the applier thread dequeues; therefore, no compare-and-swap is needed here.
+ */
+static size_t writebehind_drain ({{NAME}}_writebehind_t* self, size_t count)
+{
+    size_t position = atomic_load_explicit(&self->dequeue_position, memory_order_relaxed);
+
+    while (count < self->batch_size)
+    {
+        {{NAME}}_writebehind_cell_t* cell = &self->cells[position & self->mask];
+
+        if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != position + 1)
+        {
+            break; // Empty, or the next slot is claimed, but not yet published.
+        }
+
+        self->batch[count++] = cell->op;
+        atomic_store_explicit(&cell->sequence, position + self->mask + 1, memory_order_release);
+        ++position;
+    }
+
+    atomic_store_explicit(&self->dequeue_position, position, memory_order_relaxed);
+    return count;
+}
+
+/**
+ * Waits on the wakeup condition of a queue, with the mutex held, until the enqueue position reaches a target,
+ * a flush or stop is requested, or the deadline (on the monotonic clock, or UINT64_MAX for none) passes.
+ */
+static void writebehind_wait ({{NAME}}_writebehind_t* self, size_t target, uint64_t deadline_ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t) (deadline_ns / UINT64_C(1000000000));
+    ts.tv_nsec = (long) (deadline_ns % UINT64_C(1000000000));
+
+    // Publish the target before checking the enqueue position, so that the writer reaching it cannot miss it.
+    atomic_store(&self->wake_position, target);
+
+    while (atomic_load(&self->enqueue_position) < target
+           && atomic_load(&self->flush_requested) == false
+           && atomic_load(&self->stopping) == false)
+    {
+        if (UINT64_MAX == deadline_ns)
+        {
+            pthread_cond_wait(&self->wakeup, &self->mutex);
+        }
+        else if (pthread_cond_timedwait(&self->wakeup, &self->mutex, &ts) != 0 || writebehind_now() >= deadline_ns)
+        {
+            break;
+        }
+    }
+
+    atomic_store(&self->wake_position, SIZE_MAX);
+}
+
+static void* writebehind_main (void* argument)
+{
+    {{NAME}}_writebehind_t* self = ({{NAME}}_writebehind_t*) argument;
+
+    // Operations, which have been dequeued, but not yet applied; a batch that failed is kept here and retried.
+    size_t count = 0;
+
+    while (true)
+    {
+        const size_t depth = atomic_load(&self->enqueue_position) - atomic_load(&self->dequeue_position);
+        count = writebehind_drain(self, count);
+
+        if (count > 0)
+        {
+            // Sleep until the writers fill up the batch, but no longer than the latency bound allows.
+            if (count < self->batch_size)
+            {
+                const size_t target = atomic_load(&self->dequeue_position) + (self->batch_size - count);
+                pthread_mutex_lock(&self->mutex);
+                writebehind_wait(self, target, writebehind_now() + self->max_latency_ns);
+                pthread_mutex_unlock(&self->mutex);
+                count = writebehind_drain(self, count);
+            }
+
+            pthread_rwlock_wrlock(&self->tree_lock);
+            const bool ok = {{NAME}}_applyBatch(self->tree, self->batch, count);
+            pthread_rwlock_unlock(&self->tree_lock);
+
+            pthread_mutex_lock(&self->mutex);
+            self->max_depth = depth > self->max_depth ? depth : self->max_depth;
+
+            if (ok)
+            {
+                self->applied += count;
+                self->batches += 1;
+                count = 0;
+                pthread_cond_broadcast(&self->applied_changed);
+            }
+            else
+            {
+                // The tree is unchanged, so back off for the latency bound, and then retry the same batch.
+                self->failures += 1;
+                writebehind_wait(self, SIZE_MAX, writebehind_now() + self->max_latency_ns);
+            }
+
+            pthread_mutex_unlock(&self->mutex);
+            continue;
+        }
+
+        pthread_mutex_lock(&self->mutex);
+
+        const bool idle = atomic_load(&self->enqueue_position) == atomic_load(&self->dequeue_position);
+
+        if (idle && atomic_load(&self->stopping))
+        {
+            pthread_mutex_unlock(&self->mutex);
+            break;
+        }
+        else if (idle)
+        {
+            // Sleep without polling, until the next writer arrives, or a flush or stop is requested.
+            writebehind_wait(self, atomic_load(&self->dequeue_position) + 1, UINT64_MAX);
+        }
+
+        atomic_store(&self->flush_requested, false);
+        pthread_mutex_unlock(&self->mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Creates a write-behind queue in front of a tree and starts its applier thread.
+ * @param tree Pointer to the tree, which must only be accessed through the queue from now on.
+ * @param capacity Capacity of the ring buffer, which is rounded up to a power of two.
+ * @param batch_size Maximum number of operations applied to the tree at once.
+ * @param max_latency_ns Longest time that the applier waits for a batch to fill up, in nanoseconds.
+ * @return Pointer to the newly created queue or NULL if creation failed.
+ */
+{{NAME}}_writebehind_t* {{NAME}}_writebehind_new ({{NAME}}_t* tree, size_t capacity, size_t batch_size, uint64_t max_latency_ns)
+{
+    size_t size = 2;
+
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+
+    {{NAME}}_writebehind_t* self = ({{NAME}}_writebehind_t*) aligned_alloc(_Alignof({{NAME}}_writebehind_t), sizeof({{NAME}}_writebehind_t));
+
+    if (NULL == self)
+    {
+        return NULL;
+    }
+
+    memset(self, 0, sizeof({{NAME}}_writebehind_t));
+    self->tree = tree;
+    self->mask = size - 1;
+    self->batch_size = batch_size < 1 ? 1 : batch_size;
+    self->max_latency_ns = max_latency_ns;
+    self->batch = ({{NAME}}_op_t*) calloc(self->batch_size, sizeof({{NAME}}_op_t));
+    self->cells = ({{NAME}}_writebehind_cell_t*) calloc(size, sizeof({{NAME}}_writebehind_cell_t));
+
+    if (NULL == self->batch || NULL == self->cells)
+    {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        atomic_init(&self->cells[i].sequence, i);
+    }
+
+    atomic_init(&self->enqueue_position, 0);
+    atomic_init(&self->dequeue_position, 0);
+    atomic_init(&self->stalls, 0);
+    atomic_init(&self->flush_requested, false);
+    atomic_init(&self->stopping, false);
+    atomic_init(&self->wake_position, SIZE_MAX);
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&self->wakeup, &attributes);
+    pthread_cond_init(&self->applied_changed, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&self->mutex, NULL);
+    pthread_rwlock_init(&self->tree_lock, NULL);
+
+    if (0 != pthread_create(&self->applier, NULL, &writebehind_main, self))
+    {
+        pthread_rwlock_destroy(&self->tree_lock);
+        pthread_mutex_destroy(&self->mutex);
+        pthread_cond_destroy(&self->wakeup);
+        pthread_cond_destroy(&self->applied_changed);
+        goto cleanup;
+    }
+
+    return self;
+
+cleanup:
+    free(self->batch);
+    free(self->cells);
+    free(self);
+    return NULL;
+}
+
+/**
+ * @brief Applies all pending operations, stops the applier thread, and frees the queue (but not the tree).
+ * @param self Pointer to the write-behind queue.
+ */
+void {{NAME}}_writebehind_free ({{NAME}}_writebehind_t* self)
+{
+    if (NULL != self)
+    {
+        pthread_mutex_lock(&self->mutex);
+        atomic_store(&self->stopping, true);
+        pthread_cond_signal(&self->wakeup);
+        pthread_mutex_unlock(&self->mutex);
+
+        pthread_join(self->applier, NULL);
+
+        pthread_rwlock_destroy(&self->tree_lock);
+        pthread_mutex_destroy(&self->mutex);
+        pthread_cond_destroy(&self->wakeup);
+        pthread_cond_destroy(&self->applied_changed);
+        free(self->batch);
+        free(self->cells);
+        free(self);
+    }
+}
+
+/**
+ * @brief Enqueues a put operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ */
+void {{NAME}}_writebehind_put ({{NAME}}_writebehind_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
+{
+    {{NAME}}_op_t op;
+    op.remove = false;
+    op.key = key;
+    op.value = value;
+    writebehind_enqueue(self, &op);
+}
+
+/**
+ * @brief Enqueues a remove operation (thread-safe, lock-free unless the ring buffer is full).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to remove.
+ */
+void {{NAME}}_writebehind_remove ({{NAME}}_writebehind_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_op_t op;
+    op.remove = true;
+    op.key = key;
+    op.value = {{NAME}}_defaultValue();
+    writebehind_enqueue(self, &op);
+}
+
+/**
+ * @brief Waits until every operation enqueued before this call has been applied to the tree.
+ * @param self Pointer to the write-behind queue.
+ */
+void {{NAME}}_writebehind_flush ({{NAME}}_writebehind_t* self)
+{
+    // Every operation enqueued before now has a position below this ticket.
+    const size_t ticket = atomic_load(&self->enqueue_position);
+
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->applied < ticket)
+    {
+        atomic_store(&self->flush_requested, true);
+        pthread_cond_signal(&self->wakeup);
+        pthread_cond_wait(&self->applied_changed, &self->mutex);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+}
+
+/**
+ * @brief Retrieves the value associated with a key, as of the last applied batch (thread-safe).
+ * @param self Pointer to the write-behind queue.
+ * @param key Key to search for.
+ * @param value Output for the associated value, or NULL.
+ * @return true if the key was found, false otherwise.
+ */
+bool {{NAME}}_writebehind_get ({{NAME}}_writebehind_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}}* value)
+{
+    pthread_rwlock_rdlock(&self->tree_lock);
+    {{NAME}}_node_t* node = {{NAME}}_getNode(self->tree, key);
+
+    if (NULL != node && NULL != value)
+    {
+        *value = node->value;
+    }
+
+    pthread_rwlock_unlock(&self->tree_lock);
+    return NULL != node;
+}
+
+/**
+ * @brief Locks the tree for reading, so that the applier cannot modify the tree until released.
+ * @param self Pointer to the write-behind queue.
+ * @return Pointer to the tree, which must not be modified.
+ */
+{{NAME}}_t* {{NAME}}_writebehind_acquire ({{NAME}}_writebehind_t* self)
+{
+    pthread_rwlock_rdlock(&self->tree_lock);
+    return self->tree;
+}
+
+/**
+ * @brief Unlocks the tree, which was locked by tree_writebehind_acquire().
+ * @param self Pointer to the write-behind queue.
+ */
+void {{NAME}}_writebehind_release ({{NAME}}_writebehind_t* self)
+{
+    pthread_rwlock_unlock(&self->tree_lock);
+}
+
+/**
+ * @brief Retrieves the counters of a write-behind queue.
+ * @param self Pointer to the write-behind queue.
+ * @return Snapshot of the counters.
+ */
+{{NAME}}_writebehind_stats_t {{NAME}}_writebehind_stats ({{NAME}}_writebehind_t* self)
+{
+    {{NAME}}_writebehind_stats_t stats;
+
+    pthread_mutex_lock(&self->mutex);
+    const size_t enqueued = atomic_load(&self->enqueue_position);
+    const size_t dequeued = atomic_load(&self->dequeue_position);
+    stats.depth = enqueued - dequeued;
+    stats.max_depth = self->max_depth;
+    stats.enqueued = enqueued;
+    stats.applied = self->applied;
+    stats.batches = self->batches;
+    stats.stalls = atomic_load(&self->stalls);
+    stats.failures = self->failures;
+    pthread_mutex_unlock(&self->mutex);
+
+    return stats;
+}
+{% end %}
+
+{% if CONCURRENT %}
+/**
+ * Bits of the version number of a concurrent node.
+ * A node is shrinking while a rotation moves some of its descendants out of its subtree,
+ * which invalidates every search that is currently passing through the node.
+ */
+#define CONCURRENT_UNLINKED 1
+#define CONCURRENT_SHRINKING 2
+#define CONCURRENT_VERSION_INCREMENT 4
+
+/**
+ * Outcomes of a single optimistic attempt to perform an operation.
+ */
+typedef enum
+{
+    CONCURRENT_RETRY,
+
+    CONCURRENT_ABSENT,
+
+    CONCURRENT_DONE,
+
+    CONCURRENT_FAILED,
+
+} {{NAME}}_concurrent_result_t;
+
+/**
+ * Conditions of a node, which are used by rebalancing, in addition to a positive replacement height.
+ */
+#define CONCURRENT_NOTHING_REQUIRED 0
+#define CONCURRENT_UNLINK_REQUIRED -1
+#define CONCURRENT_REBALANCE_REQUIRED -2
+
+/**
+ * Maximum number of nodes that rebalancing remembers for later repair, before it resorts to recursion.
+ */
+#define CONCURRENT_MAX_PENDING 64
+
+typedef struct {{NAME}}_concurrent_node
+{
+    {{KEY_TYPE}} key;
+
+    /**
+     * The value is only read and written while holding the lock.
+     */
+    {{VALUE_TYPE}} value;
+
+    /**
+     * False, if this node is a routing node, whose key is not part of the map.
+     */
+    atomic_bool present;
+
+    atomic_int height;
+
+    atomic_uint_fast64_t version;
+
+    /**
+     * The left child is at index zero and the right child is at index one.
+     */
+    _Atomic(struct {{NAME}}_concurrent_node*) children[2];
+
+    _Atomic(struct {{NAME}}_concurrent_node*) parent;
+
+    struct {{NAME}}_concurrent_node* retired;
+
+    atomic_flag lock;
+
+} {{NAME}}_concurrent_node_t;
+
+struct {{NAME}}_concurrent
+{
+    /**
+     * The root holder is a sentinel node without a key, whose right child is the root.
+     */
+    {{NAME}}_concurrent_node_t holder;
+
+    {{NAME}}_comparator_t comparator;
+
+    atomic_size_t size;
+
+    _Atomic({{NAME}}_concurrent_node_t*) retired;
+
+};
+
+static void concurrent_lock ({{NAME}}_concurrent_node_t* node)
+{
+    for (unsigned spins = 0; atomic_flag_test_and_set_explicit(&node->lock, memory_order_acquire); spins++)
+    {
+        if (spins >= 64)
+        {
+            sched_yield();
+        }
+    }
+}
+
+static void concurrent_unlock ({{NAME}}_concurrent_node_t* node)
+{
+    atomic_flag_clear_explicit(&node->lock, memory_order_release);
+}
+
+/**
+ * Waits for a rotation, which is shrinking the node, to complete.
+ * Rotations hold the lock of every node that they shrink.
+ */
+static void concurrent_wait ({{NAME}}_concurrent_node_t* node)
+{
+    concurrent_lock(node);
+    concurrent_unlock(node);
+}
+
+static {{NAME}}_concurrent_node_t* concurrent_child ({{NAME}}_concurrent_node_t* node, int direction)
+{
+    return atomic_load(&node->children[direction > 0]);
+}
+
+static int concurrent_height ({{NAME}}_concurrent_node_t* node)
+{
+    return NULL == node ? 0 : atomic_load(&node->height);
+}
+
+static bool concurrent_changed ({{NAME}}_concurrent_node_t* node, uint64_t version)
+{
+    return atomic_load(&node->version) != version;
+}
+
+static {{NAME}}_concurrent_node_t* concurrent_new_node ({{KEY_TYPE}} key, {{VALUE_TYPE}} value, {{NAME}}_concurrent_node_t* parent)
+{
+    {{NAME}}_concurrent_node_t* node = ({{NAME}}_concurrent_node_t*) malloc(sizeof({{NAME}}_concurrent_node_t));
+
+    if (NULL != node)
+    {
+        node->key = key;
+        node->value = value;
+        node->retired = NULL;
+        atomic_init(&node->present, true);
+        atomic_init(&node->height, 1);
+        atomic_init(&node->version, 0);
+        atomic_init(&node->children[0], NULL);
+        atomic_init(&node->children[1], NULL);
+        atomic_init(&node->parent, parent);
+        atomic_flag_clear(&node->lock);
+    }
+
+    return node;
+}
+
+static int concurrent_condition ({{NAME}}_concurrent_node_t* node)
+{
+    {{NAME}}_concurrent_node_t* left = atomic_load(&node->children[0]);
+    {{NAME}}_concurrent_node_t* right = atomic_load(&node->children[1]);
+
+    if ((NULL == left || NULL == right) && false == atomic_load(&node->present))
+    {
+        return CONCURRENT_UNLINK_REQUIRED;
+    }
+
+    const int height = atomic_load(&node->height);
+    const int left_height = concurrent_height(left);
+    const int right_height = concurrent_height(right);
+    const int replacement = 1 + (left_height > right_height ? left_height : right_height);
+    const int balance = left_height - right_height;
+
+    if (balance < -1 || balance > 1)
+    {
+        return CONCURRENT_REBALANCE_REQUIRED;
+    }
+
+    return height != replacement ? replacement : CONCURRENT_NOTHING_REQUIRED;
+}
+
+/**
+ * Repairs the height of a locked node.
+ * Returns the next node that needs attention, or NULL if none does.
+ */
+static {{NAME}}_concurrent_node_t* concurrent_fix_height ({{NAME}}_concurrent_node_t* node)
+{
+    const int condition = concurrent_condition(node);
+
+    switch (condition)
+    {
+        case CONCURRENT_REBALANCE_REQUIRED:
+        case CONCURRENT_UNLINK_REQUIRED:
+            return node;
+        case CONCURRENT_NOTHING_REQUIRED:
+            return NULL;
+        default:
+            atomic_store(&node->height, condition);
+            return atomic_load(&node->parent);
+    }
+}
+
+/**
+ * Unlinks a locked node, which has at most one child, from its locked parent.
+ */
+static bool concurrent_unlink ({{NAME}}_concurrent_t* self, {{NAME}}_concurrent_node_t* parent, {{NAME}}_concurrent_node_t* node)
+{
+    {{NAME}}_concurrent_node_t* parent_left = atomic_load(&parent->children[0]);
+    {{NAME}}_concurrent_node_t* parent_right = atomic_load(&parent->children[1]);
+    {{NAME}}_concurrent_node_t* left = atomic_load(&node->children[0]);
+    {{NAME}}_concurrent_node_t* right = atomic_load(&node->children[1]);
+
+    if ((parent_left != node && parent_right != node) || (NULL != left && NULL != right))
+    {
+        return false;
+    }
+
+    {{NAME}}_concurrent_node_t* splice = NULL != left ? left : right;
+    atomic_store(&parent->children[parent_left == node ? 0 : 1], splice);
+
+    if (NULL != splice)
+    {
+        atomic_store(&splice->parent, parent);
+    }
+
+    atomic_store(&node->version, atomic_load(&node->version) | CONCURRENT_UNLINKED);
+    atomic_store(&node->present, false);
+
+    // Concurrent searches may still be passing through the node; therefore, retire it.
+    node->retired = atomic_load(&self->retired);
+
+    while (false == atomic_compare_exchange_weak(&self->retired, &node->retired, node))
+    {
+        // The expected value was refreshed by the failed exchange.
+    }
+
+    return true;
+}
+
+/**
+ * Rotates the child on the given side of a locked node up into the place of the node.
+ */
+static {{NAME}}_concurrent_node_t* concurrent_rotate ({{NAME}}_concurrent_node_t* parent,
+                                                      {{NAME}}_concurrent_node_t* node,
+                                                      {{NAME}}_concurrent_node_t* child,
+                                                      int side,
+                                                      int other_height,
+                                                      int outer_height,
+                                                      {{NAME}}_concurrent_node_t* inner,
+                                                      int inner_height)
+{
+    const int other = 1 - side;
+    const uint64_t version = atomic_load(&node->version);
+    const bool left_of_parent = atomic_load(&parent->children[0]) == node;
+
+    atomic_store(&node->version, version | CONCURRENT_SHRINKING);
+
+    atomic_store(&node->children[side], inner);
+
+    if (NULL != inner)
+    {
+        atomic_store(&inner->parent, node);
+    }
+
+    atomic_store(&child->children[other], node);
+    atomic_store(&node->parent, child);
+    atomic_store(&parent->children[left_of_parent ? 0 : 1], child);
+    atomic_store(&child->parent, parent);
+
+    const int node_height = 1 + (inner_height > other_height ? inner_height : other_height);
+    atomic_store(&node->height, node_height);
+    atomic_store(&child->height, 1 + (outer_height > node_height ? outer_height : node_height));
+
+    atomic_store(&node->version, version + CONCURRENT_VERSION_INCREMENT);
+
+    const int node_balance = inner_height - other_height;
+    const int child_balance = outer_height - node_height;
+
+    if (node_balance < -1 || node_balance > 1)
+    {
+        return node;
+    }
+    else if ((NULL == inner || 0 == other_height) && false == atomic_load(&node->present))
+    {
+        return node;
+    }
+    else if (child_balance < -1 || child_balance > 1)
+    {
+        return child;
+    }
+    else if (0 == outer_height && false == atomic_load(&child->present))
+    {
+        return child;
+    }
+
+    return concurrent_fix_height(parent);
+}
+
+/**
+ * Rotates the inner grandchild on the given side of a locked node up into the place of the node.
+ */
+static {{NAME}}_concurrent_node_t* concurrent_rotate_double ({{NAME}}_concurrent_node_t* parent,
+                                                             {{NAME}}_concurrent_node_t* node,
+                                                             {{NAME}}_concurrent_node_t* child,
+                                                             int side,
+                                                             int other_height,
+                                                             int outer_height,
+                                                             {{NAME}}_concurrent_node_t* inner,
+                                                             int inner_side_height)
+{
+    const int other = 1 - side;
+    const uint64_t node_version = atomic_load(&node->version);
+    const uint64_t child_version = atomic_load(&child->version);
+    const bool left_of_parent = atomic_load(&parent->children[0]) == node;
+
+    {{NAME}}_concurrent_node_t* inner_side = atomic_load(&inner->children[side]);
+    {{NAME}}_concurrent_node_t* inner_other = atomic_load(&inner->children[other]);
+    const int inner_other_height = concurrent_height(inner_other);
+
+    atomic_store(&node->version, node_version | CONCURRENT_SHRINKING);
+    atomic_store(&child->version, child_version | CONCURRENT_SHRINKING);
+
+    atomic_store(&node->children[side], inner_other);
+
+    if (NULL != inner_other)
+    {
+        atomic_store(&inner_other->parent, node);
+    }
+
+    atomic_store(&child->children[other], inner_side);
+
+    if (NULL != inner_side)
+    {
+        atomic_store(&inner_side->parent, child);
+    }
+
+    atomic_store(&inner->children[side], child);
+    atomic_store(&child->parent, inner);
+    atomic_store(&inner->children[other], node);
+    atomic_store(&node->parent, inner);
+    atomic_store(&parent->children[left_of_parent ? 0 : 1], inner);
+    atomic_store(&inner->parent, parent);
+
+    const int node_height = 1 + (inner_other_height > other_height ? inner_other_height : other_height);
+    const int child_height = 1 + (outer_height > inner_side_height ? outer_height : inner_side_height);
+    atomic_store(&node->height, node_height);
+    atomic_store(&child->height, child_height);
+    atomic_store(&inner->height, 1 + (child_height > node_height ? child_height : node_height));
+
+    atomic_store(&node->version, node_version + CONCURRENT_VERSION_INCREMENT);
+    atomic_store(&child->version, child_version + CONCURRENT_VERSION_INCREMENT);
+
+    const int node_balance = inner_other_height - other_height;
+    const int inner_balance = child_height - node_height;
+
+    if (node_balance < -1 || node_balance > 1)
+    {
+        return node;
+    }
+    else if ((NULL == inner_other || 0 == other_height) && false == atomic_load(&node->present))
+    {
+        return node;
+    }
+    else if ((NULL == inner_side || 0 == outer_height) && false == atomic_load(&child->present))
+    {
+        return child;
+    }
+    else if (inner_balance < -1 || inner_balance > 1)
+    {
+        return inner;
+    }
+
+    return concurrent_fix_height(parent);
+}
+
+/**
+ * Rebalances a locked node, whose child on the given side is too tall, while its parent is locked too.
+ */
+static {{NAME}}_concurrent_node_t* concurrent_rebalance_toward ({{NAME}}_concurrent_node_t* parent,
+                                                                {{NAME}}_concurrent_node_t* node,
+                                                                {{NAME}}_concurrent_node_t* child,
+                                                                int side,
+                                                                int other_height)
+{
+    const int other = 1 - side;
+    {{NAME}}_concurrent_node_t* result = node;
+    bool handled = true;
+
+    concurrent_lock(child);
+
+    if (atomic_load(&child->height) - other_height > 1)
+    {
+        {{NAME}}_concurrent_node_t* inner = atomic_load(&child->children[other]);
+        const int outer_height = concurrent_height(atomic_load(&child->children[side]));
+
+        // The inner grandchild moves in either rotation; therefore, its height must not change meanwhile.
+        if (NULL != inner)
+        {
+            concurrent_lock(inner);
+        }
+
+        const int inner_height = concurrent_height(inner);
+
+        if (outer_height >= inner_height)
+        {
+            result = concurrent_rotate(parent, node, child, side, other_height, outer_height, inner, inner_height);
+        }
+        else
+        {
+            const int inner_side_height = concurrent_height(atomic_load(&inner->children[side]));
+            const int balance = outer_height - inner_side_height;
+
+            if (balance >= -1 && balance <= 1)
+            {
+                result = concurrent_rotate_double(parent, node, child, side, other_height, outer_height, inner, inner_side_height);
+            }
+            else
+            {
+                handled = false;
+            }
+        }
+
+        if (NULL != inner)
+        {
+            concurrent_unlock(inner);
+        }
+
+        if (false == handled)
+        {
+            // The child must be rebalanced first, in the opposite direction.
+            result = concurrent_rebalance_toward(node, child, inner, other, outer_height);
+        }
+    }
+
+    concurrent_unlock(child);
+    return result;
+}
+
+/**
+ * Unlinks or rebalances a locked node, whose parent is locked too.
+ * Returns the next node that needs attention, or NULL if none does.
+ */
+static {{NAME}}_concurrent_node_t* concurrent_rebalance ({{NAME}}_concurrent_t* self, {{NAME}}_concurrent_node_t* parent, {{NAME}}_concurrent_node_t* node)
+{
+    {{NAME}}_concurrent_node_t* left = atomic_load(&node->children[0]);
+    {{NAME}}_concurrent_node_t* right = atomic_load(&node->children[1]);
+
+    if ((NULL == left || NULL == right) && false == atomic_load(&node->present))
+    {
+        return concurrent_unlink(self, parent, node) ? concurrent_fix_height(parent) : node;
+    }
+
+    const int height = atomic_load(&node->height);
+    const int left_height = concurrent_height(left);
+    const int right_height = concurrent_height(right);
+    const int replacement = 1 + (left_height > right_height ? left_height : right_height);
+    const int balance = left_height - right_height;
+
+    if (balance > 1)
+    {
+        return concurrent_rebalance_toward(parent, node, left, 0, right_height);
+    }
+    else if (balance < -1)
+    {
+        return concurrent_rebalance_toward(parent, node, right, 1, left_height);
+    }
+    else if (height != replacement)
+    {
+        atomic_store(&node->height, replacement);
+        return concurrent_fix_height(parent);
+    }
+
+    return NULL;
+}
+
+/**
+ * Walks up from a node, whose subtree was modified, repairing heights and rebalancing as needed.
+ */
+static void concurrent_fix_height_and_rebalance ({{NAME}}_concurrent_t* self, {{NAME}}_concurrent_node_t* node)
+{
+    // A rotation may hand back a node below the rotated subtree, while the parent above it still needs repair.
+    // Such parents are remembered here and repaired once the walk from the lower node ends.
+    {{NAME}}_concurrent_node_t* pending[CONCURRENT_MAX_PENDING];
+    size_t pending_count = 0;
+
+    while (true)
+    {
+        if (NULL == node || NULL == atomic_load(&node->parent))
+        {
+            if (0 == pending_count)
+            {
+                return;
+            }
+
+            node = pending[--pending_count];
+            continue;
+        }
+
+        // The condition is checked under the lock, so that it cannot miss the heights set by a concurrent rotation.
+        concurrent_lock(node);
+
+        const int condition = concurrent_condition(node);
+
+        if ((atomic_load(&node->version) & CONCURRENT_UNLINKED) != 0)
+        {
+            concurrent_unlock(node);
+            node = NULL;
+        }
+        else if (CONCURRENT_UNLINK_REQUIRED != condition && CONCURRENT_REBALANCE_REQUIRED != condition)
+        {
+            {{NAME}}_concurrent_node_t* next = concurrent_fix_height(node);
+            concurrent_unlock(node);
+            node = next;
+        }
+        else
+        {
+            concurrent_unlock(node);
+
+            {{NAME}}_concurrent_node_t* parent = atomic_load(&node->parent);
+            {{NAME}}_concurrent_node_t* next = node;
+
+            concurrent_lock(parent);
+
+            if ((atomic_load(&parent->version) & CONCURRENT_UNLINKED) == 0 && atomic_load(&node->parent) == parent)
+            {
+                concurrent_lock(node);
+                next = concurrent_rebalance(self, parent, node);
+                concurrent_unlock(node);
+            }
+
+            concurrent_unlock(parent);
+
+            if (NULL != next && next != node && next != parent)
+            {
+                if (pending_count < CONCURRENT_MAX_PENDING)
+                {
+                    pending[pending_count++] = parent;
+                }
+                else
+                {
+                    concurrent_fix_height_and_rebalance(self, parent);
+                }
+            }
+
+            node = next;
+        }
+    }
+}
+
+/**
+ * Searches for a key below the child of a node, whose version was observed before reading the child.
+ * Each level of recursion validates that the key is still within the range of the node that it descended from.
+ */
+static {{NAME}}_concurrent_result_t concurrent_attempt_get ({{NAME}}_concurrent_t* self,
+                                                           {{KEY_TYPE}} key,
+                                                           {{NAME}}_concurrent_node_t* node,
+                                                           int direction,
+                                                           uint64_t version,
+                                                           {{VALUE_TYPE}}* value)
+{
+    while (true)
+    {
+        {{NAME}}_concurrent_node_t* child = concurrent_child(node, direction);
+
+        if (NULL == child)
+        {
+            return concurrent_changed(node, version) ? CONCURRENT_RETRY : CONCURRENT_ABSENT;
+        }
+
+        const int cmp = self->comparator(NULL, &key, &child->key);
+
+        if (0 == cmp)
+        {
+            concurrent_lock(child);
+            const bool unlinked = (atomic_load(&child->version) & CONCURRENT_UNLINKED) != 0;
+            const bool present = atomic_load(&child->present);
+
+            if (present && false == unlinked)
+            {
+                *value = child->value;
+            }
+
+            concurrent_unlock(child);
+
+            if (false == unlinked)
+            {
+                return present ? CONCURRENT_DONE : CONCURRENT_ABSENT;
+            }
+            else if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            continue;
+        }
+
+        const uint64_t child_version = atomic_load(&child->version);
+
+        if ((child_version & CONCURRENT_SHRINKING) != 0)
+        {
+            concurrent_wait(child);
+        }
+        else if ((child_version & CONCURRENT_UNLINKED) == 0 && child == concurrent_child(node, direction))
+        {
+            if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            const {{NAME}}_concurrent_result_t result = concurrent_attempt_get(self, key, child, cmp, child_version, value);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+        }
+
+        if (concurrent_changed(node, version))
+        {
+            return CONCURRENT_RETRY;
+        }
+    }
+}
+
+static {{NAME}}_concurrent_result_t concurrent_attempt_put ({{NAME}}_concurrent_t* self,
+                                                           {{KEY_TYPE}} key,
+                                                           {{VALUE_TYPE}} value,
+                                                           {{NAME}}_concurrent_node_t* node,
+                                                           int direction,
+                                                           uint64_t version)
+{
+    while (true)
+    {
+        {{NAME}}_concurrent_node_t* child = concurrent_child(node, direction);
+
+        if (NULL == child)
+        {
+            // Allocate before locking, so that the lock is held as briefly as possible.
+            {{NAME}}_concurrent_node_t* created = concurrent_new_node(key, value, node);
+
+            if (NULL == created)
+            {
+                return CONCURRENT_FAILED;
+            }
+
+            concurrent_lock(node);
+
+            if (concurrent_changed(node, version))
+            {
+                concurrent_unlock(node);
+                free(created);
+                return CONCURRENT_RETRY;
+            }
+            else if (NULL != concurrent_child(node, direction))
+            {
+                concurrent_unlock(node);
+                free(created);
+                continue;
+            }
+
+            atomic_store(&node->children[direction > 0], created);
+            {{NAME}}_concurrent_node_t* damaged = concurrent_fix_height(node);
+            concurrent_unlock(node);
+
+            atomic_fetch_add(&self->size, 1);
+            concurrent_fix_height_and_rebalance(self, damaged);
+            return CONCURRENT_DONE;
+        }
+
+        const int cmp = self->comparator(NULL, &key, &child->key);
+
+        if (0 == cmp)
+        {
+            concurrent_lock(child);
+            const bool unlinked = (atomic_load(&child->version) & CONCURRENT_UNLINKED) != 0;
+
+            if (false == unlinked)
+            {
+                if (false == atomic_load(&child->present))
+                {
+                    // Revive a routing node.
+                    atomic_store(&child->present, true);
+                    atomic_fetch_add(&self->size, 1);
+                }
+
+                child->value = value;
+            }
+
+            concurrent_unlock(child);
+
+            if (false == unlinked)
+            {
+                return CONCURRENT_DONE;
+            }
+            else if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            continue;
+        }
+
+        const uint64_t child_version = atomic_load(&child->version);
+
+        if ((child_version & CONCURRENT_SHRINKING) != 0)
+        {
+            concurrent_wait(child);
+        }
+        else if ((child_version & CONCURRENT_UNLINKED) == 0 && child == concurrent_child(node, direction))
+        {
+            if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            const {{NAME}}_concurrent_result_t result = concurrent_attempt_put(self, key, value, child, cmp, child_version);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+        }
+
+        if (concurrent_changed(node, version))
+        {
+            return CONCURRENT_RETRY;
+        }
+    }
+}
+
+/**
+ * Removes the key of a node, which was reached from the given parent.
+ */
+static {{NAME}}_concurrent_result_t concurrent_remove_node ({{NAME}}_concurrent_t* self, {{NAME}}_concurrent_node_t* parent, {{NAME}}_concurrent_node_t* node)
+{
+    if (false == atomic_load(&node->present))
+    {
+        return CONCURRENT_ABSENT;
+    }
+
+    if (NULL == atomic_load(&node->children[0]) || NULL == atomic_load(&node->children[1]))
+    {
+        // The node has at most one child; therefore, it can be unlinked.
+        concurrent_lock(parent);
+
+        if ((atomic_load(&parent->version) & CONCURRENT_UNLINKED) != 0 || atomic_load(&node->parent) != parent)
+        {
+            concurrent_unlock(parent);
+            return CONCURRENT_RETRY;
+        }
+
+        concurrent_lock(node);
+
+        if (false == atomic_load(&node->present))
+        {
+            concurrent_unlock(node);
+            concurrent_unlock(parent);
+            return CONCURRENT_ABSENT;
+        }
+        else if (false == concurrent_unlink(self, parent, node))
+        {
+            concurrent_unlock(node);
+            concurrent_unlock(parent);
+            return CONCURRENT_RETRY;
+        }
+
+        concurrent_unlock(node);
+        {{NAME}}_concurrent_node_t* damaged = concurrent_fix_height(parent);
+        concurrent_unlock(parent);
+
+        atomic_fetch_sub(&self->size, 1);
+        concurrent_fix_height_and_rebalance(self, damaged);
+        return CONCURRENT_DONE;
+    }
+    else
+    {
+        // The node has two children; therefore, it becomes a routing node.
+        concurrent_lock(node);
+
+        if ((atomic_load(&node->version) & CONCURRENT_UNLINKED) != 0
+            || NULL == atomic_load(&node->children[0])
+            || NULL == atomic_load(&node->children[1]))
+        {
+            concurrent_unlock(node);
+            return CONCURRENT_RETRY;
+        }
+
+        const bool present = atomic_load(&node->present);
+        atomic_store(&node->present, false);
+        concurrent_unlock(node);
+
+        if (present)
+        {
+            atomic_fetch_sub(&self->size, 1);
+        }
+
+        return present ? CONCURRENT_DONE : CONCURRENT_ABSENT;
+    }
+}
+
+static {{NAME}}_concurrent_result_t concurrent_attempt_remove ({{NAME}}_concurrent_t* self,
+                                                              {{KEY_TYPE}} key,
+                                                              {{NAME}}_concurrent_node_t* node,
+                                                              int direction,
+                                                              uint64_t version)
+{
+    while (true)
+    {
+        {{NAME}}_concurrent_node_t* child = concurrent_child(node, direction);
+
+        if (NULL == child)
+        {
+            return concurrent_changed(node, version) ? CONCURRENT_RETRY : CONCURRENT_ABSENT;
+        }
+
+        const int cmp = self->comparator(NULL, &key, &child->key);
+
+        if (0 == cmp)
+        {
+            const {{NAME}}_concurrent_result_t result = concurrent_remove_node(self, node, child);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+            else if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            continue;
+        }
+
+        const uint64_t child_version = atomic_load(&child->version);
+
+        if ((child_version & CONCURRENT_SHRINKING) != 0)
+        {
+            concurrent_wait(child);
+        }
+        else if ((child_version & CONCURRENT_UNLINKED) == 0 && child == concurrent_child(node, direction))
+        {
+            if (concurrent_changed(node, version))
+            {
+                return CONCURRENT_RETRY;
+            }
+
+            const {{NAME}}_concurrent_result_t result = concurrent_attempt_remove(self, key, child, cmp, child_version);
+
+            if (CONCURRENT_RETRY != result)
+            {
+                return result;
+            }
+        }
+
+        if (concurrent_changed(node, version))
+        {
+            return CONCURRENT_RETRY;
+        }
+    }
+}
+
+static void concurrent_free_nodes ({{NAME}}_concurrent_node_t* node)
+{
+    if (NULL != node)
+    {
+        concurrent_free_nodes(atomic_load(&node->children[0]));
+        concurrent_free_nodes(atomic_load(&node->children[1]));
+        free(node);
+    }
+}
+
+/**
+ * @brief Creates a new concurrent tree using the natural ordering of keys.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+{{NAME}}_concurrent_t* {{NAME}}_concurrent_new ()
+{
+    return {{NAME}}_concurrent_make(&{{NAME}}_naturalOrder);
+}
+
+/**
+ * @brief Creates a new concurrent tree with a specified comparator.
+ * @param comparator Function pointer for key comparison.
+ * @return Pointer to the newly created concurrent tree or NULL if allocation failed.
+ */
+{{NAME}}_concurrent_t* {{NAME}}_concurrent_make ({{NAME}}_comparator_t comparator)
+{
+    {{NAME}}_concurrent_t* self = ({{NAME}}_concurrent_t*) malloc(sizeof({{NAME}}_concurrent_t));
+
+    if (NULL != self)
+    {
+        self->holder.key = {{NAME}}_defaultKey();
+        self->holder.value = {{NAME}}_defaultValue();
+        self->holder.retired = NULL;
+        atomic_init(&self->holder.present, false);
+        atomic_init(&self->holder.height, 0);
+        atomic_init(&self->holder.version, 0);
+        atomic_init(&self->holder.children[0], NULL);
+        atomic_init(&self->holder.children[1], NULL);
+        atomic_init(&self->holder.parent, NULL);
+        atomic_flag_clear(&self->holder.lock);
+        self->comparator = comparator;
+        atomic_init(&self->size, 0);
+        atomic_init(&self->retired, NULL);
+    }
+
+    return self;
+}
+
+/**
+ * @brief Frees the resources of a concurrent tree, which must no longer be in use by any thread.
+ * @param self Pointer to the concurrent tree to free.
+ */
+void {{NAME}}_concurrent_free ({{NAME}}_concurrent_t* self)
+{
+    if (NULL != self)
+    {
+        {{NAME}}_concurrent_collect(self);
+        concurrent_free_nodes(atomic_load(&self->holder.children[1]));
+        free(self);
+    }
+}
+
+/**
+ * @brief Frees the nodes that were unlinked by removals, while no other thread is using the concurrent tree.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of nodes freed.
+ */
+size_t {{NAME}}_concurrent_collect ({{NAME}}_concurrent_t* self)
+{
+    {{NAME}}_concurrent_node_t* node = atomic_exchange(&self->retired, NULL);
+    size_t count = 0;
+
+    while (NULL != node)
+    {
+        {{NAME}}_concurrent_node_t* next = node->retired;
+        free(node);
+        node = next;
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Retrieves the number of entries in the concurrent tree, which may be stale under concurrent use.
+ * @param self Pointer to the concurrent tree.
+ * @return Number of entries in the concurrent tree.
+ */
+size_t {{NAME}}_concurrent_size ({{NAME}}_concurrent_t* self)
+{
+    return atomic_load(&self->size);
+}
+
+/**
+ * @brief Inserts a key-value pair into the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false otherwise.
+ */
+bool {{NAME}}_concurrent_put ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
+{
+    {{NAME}}_concurrent_node_t* holder = &self->holder;
+
+    while (true)
+    {
+        const uint64_t version = atomic_load(&holder->version);
+        const {{NAME}}_concurrent_result_t result = concurrent_attempt_put(self, key, value, holder, +1, version);
+
+        if (CONCURRENT_RETRY != result)
+        {
+            return CONCURRENT_DONE == result;
+        }
+    }
+}
+
+/**
+ * @brief Retrieves the value associated with a key in the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+{{VALUE_TYPE}} {{NAME}}_concurrent_get ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_concurrent_node_t* holder = &self->holder;
+    {{VALUE_TYPE}} value = {{NAME}}_defaultValue();
+
+    while (CONCURRENT_RETRY == concurrent_attempt_get(self, key, holder, +1, atomic_load(&holder->version), &value))
+    {
+        // Retry from the root.
+    }
+
+    return value;
+}
+
+/**
+ * @brief Checks if the concurrent tree contains a specific key (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to check for.
+ * @return true if the key is found, false otherwise.
+ */
+bool {{NAME}}_concurrent_containsKey ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_concurrent_node_t* holder = &self->holder;
+    {{VALUE_TYPE}} value;
+
+    while (true)
+    {
+        const {{NAME}}_concurrent_result_t result = concurrent_attempt_get(self, key, holder, +1, atomic_load(&holder->version), &value);
+
+        if (CONCURRENT_RETRY != result)
+        {
+            return CONCURRENT_DONE == result;
+        }
+    }
+}
+
+/**
+ * @brief Removes a key and its value from the concurrent tree (thread-safe).
+ * @param self Pointer to the concurrent tree.
+ * @param key Key to remove.
+ */
+void {{NAME}}_concurrent_remove ({{NAME}}_concurrent_t* self, {{KEY_TYPE}} key)
+{
+    {{NAME}}_concurrent_node_t* holder = &self->holder;
+
+    while (CONCURRENT_RETRY == concurrent_attempt_remove(self, key, holder, +1, atomic_load(&holder->version)))
+    {
+        // Retry from the root.
+    }
+}
+{% end %}
+
+{% if SERIALIZE %}
+#define SNAPSHOT_MAGIC "TREESNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER UINT32_C(0x01020304)
+
+/**
+ * Size of the I/O buffer, which must be a multiple of eight, so that the checksum sees the same words,
+ * no matter how the data was split into reads and writes.
+ */
+#define SNAPSHOT_BUFFER_SIZE (1 << 20)
+
+/**
+ * Number of loaded nodes, for which a loader makes room at first. The room then doubles as the entries arrive,
+ * so that a corrupt count in a header cannot allocate more memory than the data actually holds.
+ */
+#define SNAPSHOT_INITIAL_NODES 1024
+
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint64_t count;
+
+} {{NAME}}_snapshot_header_t;
+
+/**
+ * Buffered sequential access to a file descriptor, which checksums all of the data that passes through.
+ */
+typedef struct
+{
+    int fd;
+
+    uint64_t checksum;
+
+    unsigned char* buffer;
+
+    /**
+     * Number of bytes in the buffer that have been written, or consumed when reading.
+     */
+    size_t position;
+
+    /**
+     * Number of bytes in the buffer, when reading.
+     */
+    size_t length;
+
+    /**
+     * Number of bytes that may still be read from the file descriptor, when reading.
+     */
+    uint64_t remaining;
+
+} {{NAME}}_snapshot_stream_t;
+
+static bool snapshot_write_fully (int fd, const void* data, size_t length)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    while (length > 0)
+    {
+        const ssize_t written = write(fd, bytes, length);
+
+        if (written < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        else if (written <= 0)
+        {
+            return false;
+        }
+
+        bytes += written;
+        length -= (size_t) written;
+    }
+
+    return true;
+}
+
+static bool snapshot_read_fully (int fd, void* data, size_t length)
+{
+    unsigned char* bytes = (unsigned char*) data;
+
+    while (length > 0)
+    {
+        const ssize_t count = read(fd, bytes, length);
+
+        if (count < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        else if (count <= 0)
+        {
+            return false; // Error or premature end of file.
+        }
+
+        bytes += count;
+        length -= (size_t) count;
+    }
+
+    return true;
+}
+
+/**
+ * Folds data into a running checksum, one 64-bit word at a time.
+ * Only the last piece of data in a stream may have a length that is not a multiple of eight.
+ */
+static uint64_t snapshot_hash (uint64_t hash, const unsigned char* data, size_t length)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * UINT64_C(0x9E3779B97F4A7C15);
+        hash ^= hash >> 29;
+    }
+
+    for (; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * UINT64_C(0x100000001B3);
+    }
+
+    return hash;
+}
+
+static bool snapshot_flush ({{NAME}}_snapshot_stream_t* stream)
+{
+    stream->checksum = snapshot_hash(stream->checksum, stream->buffer, stream->position);
+    const bool ok = snapshot_write_fully(stream->fd, stream->buffer, stream->position);
+    stream->position = 0;
+    return ok;
+}
+
+static bool snapshot_put ({{NAME}}_snapshot_stream_t* stream, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    while (size > 0)
+    {
+        const size_t room = SNAPSHOT_BUFFER_SIZE - stream->position;
+        const size_t count = size < room ? size : room;
+        memcpy(stream->buffer + stream->position, bytes, count);
+        stream->position += count;
+        bytes += count;
+        size -= count;
+
+        if (SNAPSHOT_BUFFER_SIZE == stream->position && false == snapshot_flush(stream))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool snapshot_get ({{NAME}}_snapshot_stream_t* stream, void* data, size_t size)
+{
+    unsigned char* bytes = (unsigned char*) data;
+
+    while (size > 0)
+    {
+        if (stream->position == stream->length)
+        {
+            // Never read past the end of the data, so that the trailing checksum is left in the file.
+            const size_t length = stream->remaining < SNAPSHOT_BUFFER_SIZE ? (size_t) stream->remaining : SNAPSHOT_BUFFER_SIZE;
+
+            if (0 == length || false == snapshot_read_fully(stream->fd, stream->buffer, length))
+            {
+                return false;
+            }
+
+            stream->checksum = snapshot_hash(stream->checksum, stream->buffer, length);
+            stream->remaining -= length;
+            stream->position = 0;
+            stream->length = length;
+        }
+
+        const size_t available = stream->length - stream->position;
+        const size_t count = size < available ? size : available;
+        memcpy(bytes, stream->buffer + stream->position, count);
+        stream->position += count;
+        bytes += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+static void snapshot_header ({{NAME}}_snapshot_header_t* header, uint64_t count)
+{
+    memset(header, 0, sizeof({{NAME}}_snapshot_header_t));
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof({{KEY_TYPE}});
+    header->value_size = (uint32_t) sizeof({{VALUE_TYPE}});
+    header->count = count;
+}
+
+/**
+ * Makes room for one more loaded node, unless the array of loaded nodes is full, by doubling it (up to the count).
+ */
+static bool snapshot_reserve ({{NAME}}_node_t*** fresh, size_t* capacity, size_t loaded, size_t count)
+{
+    if (loaded < *capacity)
+    {
+        return true;
+    }
+
+    size_t grown = *capacity < SNAPSHOT_INITIAL_NODES ? SNAPSHOT_INITIAL_NODES : 2 * *capacity;
+    grown = grown < count ? grown : count;
+
+    {{NAME}}_node_t** nodes = ({{NAME}}_node_t**) realloc(*fresh, grown * sizeof({{NAME}}_node_t*));
+
+    if (NULL == nodes)
+    {
+        return false;
+    }
+
+    *fresh = nodes;
+    *capacity = grown;
+    return true;
+}
+
+/**
+ * Adds loaded nodes, which are sorted and free of duplicate keys, to the tree.
+ * Unless the tree is empty, the array of loaded nodes is grown first, to hold the existing nodes past its end.
+ * @return false if memory could not be allocated (the tree is then left unchanged).
+ */
+static bool snapshot_attach ({{NAME}}_t* self, {{NAME}}_node_t*** fresh, size_t count)
+{
+    if (0 == self->size)
+    {
+        // Since the entries are already sorted, the tree is built in linear time without any key comparisons.
+        self->root = build_balanced(*fresh, count);
+        self->size = count;
+        return true;
+    }
+
+    const size_t total = self->size + count;
+    {{NAME}}_node_t** nodes = ({{NAME}}_node_t**) realloc(*fresh, total * sizeof({{NAME}}_node_t*));
+    {{NAME}}_node_t** scratch = NULL == nodes ? NULL : ({{NAME}}_node_t**) malloc(total * sizeof({{NAME}}_node_t*));
+
+    *fresh = NULL == nodes ? *fresh : nodes;
+
+    if (NULL == scratch)
+    {
+        return false;
+    }
+
+    // The existing nodes are stored just past the loaded nodes, which leaves the scratch array free for the merge.
+    {{NAME}}_node_t** existing = nodes + count;
+    const size_t existing_count = flatten_nodes(self->root, existing, 0);
+    const size_t merged = union_nodes(self, existing, existing_count, nodes, count, scratch);
+
+    self->root = build_balanced(scratch, merged);
+    self->size = merged;
+    free(scratch);
+    return true;
+}
+
+/**
+ * @brief Writes a binary snapshot of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * A snapshot consists of a header (magic, format version, byte order, key size, value size, and entry count),
+ * the key-value pairs in ascending order, and a trailing 64-bit checksum of everything before it.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool {{NAME}}_save ({{NAME}}_t* self, int fd)
+{
+    {{NAME}}_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    if (NULL == stream.buffer)
+    {
+        return false;
+    }
+
+    {{NAME}}_snapshot_header_t header;
+    snapshot_header(&header, self->size);
+    bool ok = snapshot_put(&stream, &header, sizeof(header));
+
+    // Iterative in-order traversal, which needs no parent pointers.
+    {{NAME}}_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    {{NAME}}_node_t* node = self->root;
+
+    while (ok && (NULL != node || depth > 0))
+    {
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        ok = snapshot_put(&stream, &node->key, sizeof({{KEY_TYPE}})) && snapshot_put(&stream, &node->value, sizeof({{VALUE_TYPE}}));
+        node = node->right;
+    }
+
+    ok = ok && snapshot_flush(&stream);
+    ok = ok && snapshot_write_fully(fd, &stream.checksum, sizeof(stream.checksum));
+
+    free(stream.buffer);
+    return ok;
+}
+
+/**
+ * @brief Reads a binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Loading fails, if the header does not match this tree's key and value types,
+ * if the data is truncated or fails the checksum, or if a node cannot be allocated.
+ * Since the entries are already sorted, an empty tree is built in linear time without any key comparisons.
+ * Otherwise, the entries are merged into the tree, replacing the values of keys that are already present.
+ */
+bool {{NAME}}_load ({{NAME}}_t* self, int fd)
+{
+    {{NAME}}_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.remaining = sizeof({{NAME}}_snapshot_header_t);
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    {{NAME}}_snapshot_header_t header;
+    {{NAME}}_snapshot_header_t expected;
+
+    if (NULL == stream.buffer || false == snapshot_get(&stream, &header, sizeof(header)))
+    {
+        free(stream.buffer);
+        return false;
+    }
+
+    snapshot_header(&expected, header.count);
+    const size_t entry_size = sizeof({{KEY_TYPE}}) + sizeof({{VALUE_TYPE}});
+
+    if (0 != memcmp(&header, &expected, sizeof(header)) || header.count > (SIZE_MAX / 2 - self->size) / entry_size)
+    {
+        free(stream.buffer);
+        return false;
+    }
+
+    const size_t count = (size_t) header.count;
+    stream.remaining = (uint64_t) count * entry_size;
+
+    // The count is not trusted until the checksum matches; therefore, the array only grows as the entries arrive.
+    {{NAME}}_node_t** fresh = NULL;
+    size_t capacity = 0;
+    size_t loaded = 0;
+    bool ok = true;
+
+    while (ok && loaded < count)
+    {
+        {{NAME}}_node_t* node = snapshot_reserve(&fresh, &capacity, loaded, count) ? self->allocator->allocate(self->allocator) : NULL;
+
+        if (NULL == node)
+        {
+            ok = false;
+            break;
+        }
+
+        node->height = 0;
+        node->size = 1;
+        node->left = NULL;
+        node->right = NULL;
+        fresh[loaded++] = node;
+        ok = snapshot_get(&stream, &node->key, sizeof({{KEY_TYPE}})) && snapshot_get(&stream, &node->value, sizeof({{VALUE_TYPE}}));
+    }
+
+    // The checksum must match, before the tree is modified.
+    uint64_t checksum = 0;
+    ok = ok && snapshot_read_fully(fd, &checksum, sizeof(checksum)) && checksum == stream.checksum;
+    ok = ok && snapshot_attach(self, &fresh, count);
+
+    if (false == ok)
+    {
+        while (loaded > 0)
+        {
+            self->allocator->release(self->allocator, fresh[--loaded]);
+        }
+    }
+
+    free(stream.buffer);
+    free(fresh);
+    return ok;
+}
+{% end %}
+
+{% if SERIALIZE %}
+#define IMAGE_MAGIC "TREEIMG1"
+#define IMAGE_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint32_t node_size;
+
+    uint32_t reserved;
 
-static int32_t height_of ({{NAME}}_node_t* node)
+    uint64_t count;
+
+    /**
+     * Index of the root plus one, or zero if the image is empty.
+     */
+    uint64_t root;
+
+    /**
+     * Pads the header to a multiple of the alignment of the nodes.
+     */
+    uint64_t padding[2];
+
+} {{NAME}}_image_header_t;
+
+struct {{NAME}}_image
 {
-    return NULL == node ? 0 : node->height;
+    void* base;
+
+    size_t length;
+
+    {{NAME}}_image_node_t* nodes;
+
+    size_t count;
+
+    uint64_t root;
+
+    {{NAME}}_comparator_t comparator;
+
+};
+
+static void image_header ({{NAME}}_image_header_t* header, uint64_t count, uint64_t root)
+{
+    memset(header, 0, sizeof({{NAME}}_image_header_t));
+    memcpy(header->magic, IMAGE_MAGIC, sizeof(header->magic));
+    header->version = IMAGE_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof({{KEY_TYPE}});
+    header->value_size = (uint32_t) sizeof({{VALUE_TYPE}});
+    header->node_size = (uint32_t) sizeof({{NAME}}_image_node_t);
+    header->count = count;
+    header->root = root;
 }
 
-static size_t size_of ({{NAME}}_node_t* node)
+static size_t image_size_of ({{NAME}}_node_t* node)
 {
     return NULL == node ? 0 : node->size;
 }
 
-static int8_t balance_of ({{NAME}}_node_t* node)
+/**
+ * Follows a link to a node, which lies strictly between the given links in a well-formed image.
+ * A missing child, and a corrupt link outside of these bounds, both yield NULL; since the bounds narrow
+ * with every step down, a search through a corrupt image still ends within count steps and never leaves the mapping.
+ */
+static {{NAME}}_image_node_t* image_node ({{NAME}}_image_t* self, uint64_t link, uint64_t lower, uint64_t upper)
 {
-    if (NULL == node)
+    return lower < link && link < upper ? self->nodes + (link - 1) : NULL;
+}
+
+/**
+ * @brief Writes an image of the AVL tree to a file descriptor.
+ * @param self Pointer to the AVL tree.
+ * @param fd File descriptor, which is written sequentially.
+ * @return true if the image was written completely, false if an I/O error occurred.
+ *
+ * An image consists of a header, the nodes in ascending order, and a trailing 64-bit checksum.
+ * Keys and values are copied byte for byte; therefore, they must be plain old data.
+ */
+bool {{NAME}}_saveImage ({{NAME}}_t* self, int fd)
+{
+    {{NAME}}_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    if (NULL == stream.buffer)
     {
-        return 0;
+        return false;
     }
-    else
+
+    {{NAME}}_image_header_t header;
+    image_header(&header, self->size, NULL == self->root ? 0 : image_size_of(self->root->left) + 1);
+    bool ok = snapshot_put(&stream, &header, sizeof(header));
+
+    // Iterative in-order traversal, where the index of each child follows from the sizes of the subtrees.
+    {{NAME}}_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    size_t index = 0;
+    {{NAME}}_node_t* node = self->root;
+
+    {{NAME}}_image_node_t image;
+    memset(&image, 0, sizeof(image)); // Zero the padding, so that images are reproducible.
+
+    while (ok && (NULL != node || depth > 0))
     {
-        return height_of(node->left) - height_of(node->right);
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        image.left = NULL == node->left ? 0 : index - image_size_of(node->left->right);
+        image.right = NULL == node->right ? 0 : index + 2 + image_size_of(node->right->left);
+        image.key = node->key;
+        image.value = node->value;
+        ok = snapshot_put(&stream, &image, sizeof(image));
+        node = node->right;
+        ++index;
     }
+
+    ok = ok && snapshot_flush(&stream);
+    ok = ok && snapshot_write_fully(fd, &stream.checksum, sizeof(stream.checksum));
+
+    free(stream.buffer);
+    return ok;
 }
 
-static {{NAME}}_node_t* create_node ({{NAME}}_t* self, {{KEY_TYPE}}* key)
+/**
+ * @brief Maps an image using the natural ordering of keys.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+{{NAME}}_image_t* {{NAME}}_image_open (int fd, bool copy_on_write)
 {
-    {{NAME}}_node_t* node = self->allocator->allocate(self->allocator);
+    return {{NAME}}_image_make(fd, copy_on_write, &{{NAME}}_naturalOrder);
+}
 
-    if (NULL == node)
+/**
+ * @brief Maps an image with a specified comparator, which must be the comparator of the saved tree.
+ * @param fd File descriptor of the image file, which may be closed once the image is open.
+ * @param copy_on_write If true, the nodes are writable, but changes are private to this process.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened image or NULL if the file is not a compatible image.
+ */
+{{NAME}}_image_t* {{NAME}}_image_make (int fd, bool copy_on_write, {{NAME}}_comparator_t comparator)
+{
+    struct stat status;
+
+    if (0 != fstat(fd, &status) || (uint64_t) status.st_size < sizeof({{NAME}}_image_header_t) + sizeof(uint64_t))
     {
         return NULL;
     }
-    else
+
+    const size_t length = (size_t) status.st_size;
+    const int protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* base = mmap(NULL, length, protection, copy_on_write ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+
+    if (MAP_FAILED == base)
     {
-        ++self->size;
-        node->key = *key;
-        node->height = 0;
-        node->size = 1;
-        node->left = NULL;
-        node->right = NULL;
-        return node;
+        return NULL;
     }
+
+    const {{NAME}}_image_header_t* header = (const {{NAME}}_image_header_t*) base;
+    {{NAME}}_image_header_t expected;
+    image_header(&expected, header->count, header->root);
+
+    const uint64_t capacity = (length - sizeof({{NAME}}_image_header_t) - sizeof(uint64_t)) / sizeof({{NAME}}_image_node_t);
+    {{NAME}}_image_t* self = NULL;
+
+    if (0 == memcmp(header, &expected, sizeof(expected)) && header->count <= capacity && header->root <= header->count)
+    {
+        self = ({{NAME}}_image_t*) malloc(sizeof({{NAME}}_image_t));
+    }
+
+    if (NULL == self)
+    {
+        munmap(base, length);
+        return NULL;
+    }
+
+    self->base = base;
+    self->length = length;
+    self->nodes = ({{NAME}}_image_node_t*) ((unsigned char*) base + sizeof({{NAME}}_image_header_t));
+    self->count = (size_t) header->count;
+    self->root = header->root;
+    self->comparator = comparator;
+    return self;
 }
 
-static int8_t max (int8_t x, int8_t y)
+/**
+ * @brief Unmaps an image and frees its resources.
+ * @param self Pointer to the image.
+ */
+void {{NAME}}_image_close ({{NAME}}_image_t* self)
 {
-    return x > y ? x : y;
+    if (NULL != self)
+    {
+        munmap(self->base, self->length);
+        free(self);
+    }
 }
 
-static void update_size ({{NAME}}_node_t* node)
+/**
+ * @brief Checks the checksum of an image, which reads the entire image.
+ * @param self Pointer to the image.
+ * @return true if the image is intact, false otherwise.
+ */
+bool {{NAME}}_image_verify ({{NAME}}_image_t* self)
 {
-    if (NULL != node)
+    const size_t length = sizeof({{NAME}}_image_header_t) + self->count * sizeof({{NAME}}_image_node_t);
+    const unsigned char* bytes = (const unsigned char*) self->base;
+    uint64_t checksum;
+    memcpy(&checksum, bytes + length, sizeof(checksum));
+
+    // Hash in the same pieces as the writer, so that only the very last piece can end within a word.
+    uint64_t hash = 0;
+
+    for (size_t offset = 0; offset < length; offset += SNAPSHOT_BUFFER_SIZE)
     {
-        node->size = 1 + size_of(node->left) + size_of(node->right);
+        const size_t piece = length - offset < SNAPSHOT_BUFFER_SIZE ? length - offset : SNAPSHOT_BUFFER_SIZE;
+        hash = snapshot_hash(hash, bytes + offset, piece);
     }
+
+    return hash == checksum;
 }
 
-static void update_height ({{NAME}}_node_t* node)
+/**
+ * @brief Retrieves the number of nodes in an image.
+ * @param self Pointer to the image.
+ * @return Number of nodes in the image.
+ */
+size_t {{NAME}}_image_size ({{NAME}}_image_t* self)
 {
-    if (NULL != node)
+    return self->count;
+}
+
+/**
+ * @brief Retrieves the node associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return Pointer to the node or NULL if not found.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_getNode ({{NAME}}_image_t* self, {{KEY_TYPE}} key)
+{
+    uint64_t lower = 0;
+    uint64_t upper = self->count + 1;
+    {{NAME}}_image_node_t* node = image_node(self, self->root, lower, upper);
+
+    while (NULL != node)
     {
-        if ((NULL == node->left) && (NULL == node->right))
-        {
-            node->height = 0;
-        }
-        else if (NULL == node->left)
+        const int cmp = self->comparator(NULL, &key, &node->key);
+        const uint64_t link = (uint64_t) (node - self->nodes) + 1;
+
+        if (0 == cmp)
         {
-            node->height = 1 + node->right->height;
+            return node;
         }
-        else if (NULL == node->right)
+        else if (cmp < 0)
         {
-            node->height = 1 + node->left->height;
+            upper = link;
+            node = image_node(self, node->left, lower, upper);
         }
         else
         {
-            node->height = 1 + max(node->left->height, node->right->height);
+            lower = link;
+            node = image_node(self, node->right, lower, upper);
         }
     }
+
+    return NULL;
 }
 
-static {{NAME}}_node_t* rotate_right ({{NAME}}_node_t* y)
+/**
+ * @brief Retrieves the value associated with a key in an image.
+ * @param self Pointer to the image.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found.
+ */
+{{VALUE_TYPE}} {{NAME}}_image_get ({{NAME}}_image_t* self, {{KEY_TYPE}} key)
 {
-    if (NULL == y || NULL == y->left)
+    {{NAME}}_image_node_t* node = {{NAME}}_image_getNode(self, key);
+    return NULL == node ? {{NAME}}_defaultValue() : node->value;
+}
+
+/**
+ * @brief Finds the successor node (next higher key) of a given key in an image.
+ * @param self Pointer to the image.
+ * @param key Key for which to find the higher node.
+ * @return Pointer to the higher node or NULL if not found.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_higherNode ({{NAME}}_image_t* self, {{KEY_TYPE}} key)
+{
+    uint64_t lower = 0;
+    uint64_t upper = self->count + 1;
+    {{NAME}}_image_node_t* node = image_node(self, self->root, lower, upper);
+    {{NAME}}_image_node_t* result = NULL;
+
+    while (NULL != node)
     {
-        return y;
+        const uint64_t link = (uint64_t) (node - self->nodes) + 1;
+
+        if (self->comparator(NULL, &key, &node->key) < 0)
+        {
+            result = node;
+            upper = link;
+            node = image_node(self, node->left, lower, upper);
+        }
+        else
+        {
+            lower = link;
+            node = image_node(self, node->right, lower, upper);
+        }
     }
 
-    {{NAME}}_node_t* x = y->left;
-    {{NAME}}_node_t* z = x->right;
+    return result;
+}
 
-    x->right = y;
-    y->left = z;
+/**
+ * @brief Finds the nth node (0-based index) in an image, in constant time.
+ * @param self Pointer to the image.
+ * @param index The index of the node to find.
+ * @return Pointer to the nth node or NULL if not found.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_nthNode ({{NAME}}_image_t* self, size_t index)
+{
+    return index < self->count ? self->nodes + index : NULL;
+}
+
+/**
+ * @brief Retrieves the first node (minimum key) of an image.
+ * @param self Pointer to the image.
+ * @return Pointer to the first node or NULL if the image is empty.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_firstNode ({{NAME}}_image_t* self)
+{
+    return {{NAME}}_image_nthNode(self, 0);
+}
+
+/**
+ * @brief Retrieves the node after a given node (next higher key) of an image, in constant time.
+ * @param self Pointer to the image.
+ * @param node Pointer to a node of the image.
+ * @return Pointer to the next node or NULL if the given node is the last one.
+ */
+{{NAME}}_image_node_t* {{NAME}}_image_nextNode ({{NAME}}_image_t* self, {{NAME}}_image_node_t* node)
+{
+    return {{NAME}}_image_nthNode(self, (size_t) (node - self->nodes) + 1);
+}
+{% end %}
+
+{% if WAL %}
+#define WAL_MAGIC "TREEWAL1"
+#define WAL_VERSION 1
+#define WAL_PUT 1
+#define WAL_REMOVE 2
+
+/**
+ * Number of records that recovery replays at once, using {{NAME}}_applyBatch().
+ */
+#define WAL_REPLAY_BATCH 65536
+
+/**
+ * Number of entries that a checkpoint copies, while it holds off writers.
+ */
+#define WAL_CHECKPOINT_CHUNK 4096
+
+typedef struct
+{
+    char magic[8];
+
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    /**
+     * Sequence number of the last record that was compacted into the snapshot, when the log was created.
+     */
+    uint64_t base;
+
+} {{NAME}}_wal_header_t;
+
+/**
+ * Layout of a record, which is followed by a checksum of its bytes.
+ */
+typedef struct
+{
+    uint64_t sequence;
+
+    uint64_t kind;
+
+    {{KEY_TYPE}} key;
+
+    {{VALUE_TYPE}} value;
+
+} {{NAME}}_wal_record_t;
+
+#define WAL_RECORD_SIZE (sizeof({{NAME}}_wal_record_t) + sizeof(uint64_t))
+
+struct {{NAME}}_wal
+{
+    {{NAME}}_t* tree;
+
+    char* snapshot_path;
+
+    char* log_path;
+
+    int fd;
+
+    size_t group_size;
+
+    uint64_t max_latency_ns;
+
+    pthread_mutex_t mutex;
+
+    /**
+     * Signals the committer thread, when records arrive, or when a flush is requested.
+     */
+    pthread_cond_t wakeup;
+
+    /**
+     * Signals waiting threads, when records become durable, or when a compaction ends.
+     */
+    pthread_cond_t changed;
+
+    /**
+     * Records of the group that is currently being filled.
+     */
+    unsigned char* active;
+
+    size_t active_count;
+
+    size_t active_capacity;
+
+    /**
+     * Buffer of the group that is being written, while the next group fills up.
+     */
+    unsigned char* spare;
+
+    size_t spare_capacity;
+
+    uint64_t first_pending_ns;
+
+    uint64_t sequence;
+
+    uint64_t durable;
+
+    /**
+     * Sequence number of the last record before the first record in the log file.
+     */
+    uint64_t base;
+
+    bool flush_requested;
+
+    bool flushing;
+
+    bool compacting;
+
+    /**
+     * Whether a checkpoint is dropping the records, which its snapshot covers, from the log, while writers wait.
+     */
+    bool truncating;
+
+    bool stopping;
+
+    bool failed;
+
+    pthread_t committer;
+
+    bool checkpointing;
+
+    bool checkpoint_joinable;
+
+    bool checkpoint_ok;
+
+    /**
+     * Sequence number of the last record before the running checkpoint started.
+     */
+    uint64_t checkpoint_sequence;
+
+    pthread_t checkpointer;
+
+    {{NAME}}_wal_checkpoint_stats_t checkpoint_stats;
+
+};
+
+static uint64_t wal_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+static void wal_header ({{NAME}}_wal_header_t* header, uint64_t base)
+{
+    memset(header, 0, sizeof({{NAME}}_wal_header_t));
+    memcpy(header->magic, WAL_MAGIC, sizeof(header->magic));
+    header->version = WAL_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof({{KEY_TYPE}});
+    header->value_size = (uint32_t) sizeof({{VALUE_TYPE}});
+    header->base = base;
+}
+
+/**
+ * Empties the log file, leaving only a header, and makes the change durable.
+ */
+static bool wal_reset (int fd, uint64_t base)
+{
+    {{NAME}}_wal_header_t header;
+    wal_header(&header, base);
+
+    return 0 == ftruncate(fd, 0)
+           && 0 == lseek(fd, 0, SEEK_SET)
+           && snapshot_write_fully(fd, &header, sizeof(header))
+           && 0 == fsync(fd);
+}
+
+/**
+ * Makes a rename within the directory of a path durable.
+ */
+static bool wal_sync_directory (const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    char* directory = NULL == slash ? strdup(".") : strndup(path, slash == path ? 1 : (size_t) (slash - path));
+
+    if (NULL == directory)
+    {
+        return false;
+    }
 
-    update_height(z);
-    update_height(y);
-    update_height(x);
+    const int fd = open(directory, O_RDONLY);
+    const bool ok = fd >= 0 && 0 == fsync(fd);
 
-    update_size(z);
-    update_size(y);
-    update_size(x);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
 
-    return x;
+    free(directory);
+    return ok;
 }
 
-static {{NAME}}_node_t* rotate_left ({{NAME}}_node_t* x)
+/**
+ * Creates the path of the temporary file, which replaces the file at a path once it is complete.
+ */
+static char* wal_temporary_path (const char* path)
 {
-    if (NULL == x || NULL == x->right)
+    const size_t length = strlen(path);
+    char* temporary = (char*) malloc(length + 5);
+
+    if (NULL != temporary)
     {
-        return x;
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", 5);
     }
 
-    {{NAME}}_node_t* y = x->right;
-    {{NAME}}_node_t* z = y->left;
+    return temporary;
+}
 
-    y->left = x;
-    x->right = z;
+/**
+ * Applies the records of the log to the tree, truncating the log after the last intact record.
+ */
+static bool wal_replay ({{NAME}}_wal_t* self)
+{
+    {{NAME}}_wal_header_t header;
+    {{NAME}}_wal_header_t expected;
+    const off_t length = lseek(self->fd, 0, SEEK_END);
 
-    update_height(z);
-    update_height(x);
-    update_height(y);
+    if (length < (off_t) sizeof(header))
+    {
+        self->base = 0;
+        return wal_reset(self->fd, 0); // New log, or a crash before the header was written.
+    }
 
-    update_size(z);
-    update_size(x);
-    update_size(y);
+    if (0 != lseek(self->fd, 0, SEEK_SET) || false == snapshot_read_fully(self->fd, &header, sizeof(header)))
+    {
+        return false;
+    }
 
-    return y;
-}
+    wal_header(&expected, header.base);
 
-static {{NAME}}_node_t* rebalance ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key)
-{
-    if (NULL == node)
+    if (0 != memcmp(&header, &expected, sizeof(header)))
     {
-        return NULL;
+        return false;
     }
 
-    update_height(node);
-    update_size(node);
+    {{NAME}}_op_t* ops = ({{NAME}}_op_t*) malloc(WAL_REPLAY_BATCH * sizeof({{NAME}}_op_t));
+    unsigned char* records = (unsigned char*) malloc(WAL_REPLAY_BATCH * WAL_RECORD_SIZE);
+    bool ok = NULL != ops && NULL != records;
+    off_t end = sizeof(header);
 
-    const int8_t balance = balance_of(node);
+    self->base = header.base;
+    self->sequence = header.base;
 
-    if (balance > 1)
+    while (ok)
     {
-        const int32_t ordering = self->comparator(self, key, &node->left->key);
+        // Read as many whole records as possible, stopping short at the end of the file.
+        size_t length = 0;
 
-        if (ordering < 0)
-        {
-            node = rotate_right(node);
-        }
-        else if (ordering > 0)
+        while (length < WAL_REPLAY_BATCH * WAL_RECORD_SIZE)
         {
-            node->left = rotate_left(node->left);
-            node = rotate_right(node);
+            const ssize_t count = read(self->fd, records + length, WAL_REPLAY_BATCH * WAL_RECORD_SIZE - length);
+
+            if (count < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            else if (count < 0)
+            {
+                ok = false;
+            }
+
+            if (count <= 0)
+            {
+                break;
+            }
+
+            length += (size_t) count;
         }
-    }
-    else if (balance < -1)
-    {
-        const int32_t ordering = self->comparator(self, key, &node->right->key);
 
-        if (ordering > 0)
+        size_t count = 0;
+        bool intact = ok;
+
+        for (size_t offset = 0; intact && offset + WAL_RECORD_SIZE <= length; offset += WAL_RECORD_SIZE)
         {
-            node = rotate_left(node);
+            {{NAME}}_wal_record_t record;
+            uint64_t checksum;
+            memcpy(&record, records + offset, sizeof(record));
+            memcpy(&checksum, records + offset + sizeof(record), sizeof(checksum));
+
+            intact = checksum == snapshot_hash(0, records + offset, sizeof(record))
+                     && record.sequence == self->sequence + 1
+                     && (WAL_PUT == record.kind || WAL_REMOVE == record.kind);
+
+            if (intact)
+            {
+                ops[count].remove = WAL_REMOVE == record.kind;
+                ops[count].key = record.key;
+                ops[count].value = record.value;
+                ++count;
+                ++self->sequence;
+            }
         }
-        else if (ordering < 0)
+
+        ok = ok && {{NAME}}_applyBatch(self->tree, ops, count);
+        end += (off_t) (count * WAL_RECORD_SIZE);
+
+        if (false == intact || length < WAL_REPLAY_BATCH * WAL_RECORD_SIZE)
         {
-            node->right = rotate_right(node->right);
-            node = rotate_left(node);
+            break;
         }
     }
 
-    return node;
-}
+    // Discard a torn or corrupted tail, so that new records follow the last intact one.
+    ok = ok && (end == lseek(self->fd, 0, SEEK_END) || (0 == ftruncate(self->fd, end) && 0 == fsync(self->fd)));
+    ok = ok && end == lseek(self->fd, 0, SEEK_END);
 
-static {{NAME}}_node_t* insert_node ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key)
-{
-    if (node == NULL)
-    {
-        return create_node(self, key);
-    }
-    else if (self->comparator(self, key, &node->key) < 0)
-    {
-        node->left = insert_node(self, node->left, key);
-        return rebalance(self, node, key);
-    }
-    else if (self->comparator(self, key, &node->key) > 0)
-    {
-        node->right = insert_node(self, node->right, key);
-        return rebalance(self, node, key);
-    }
-    else
-    {
-        return node;
-    }
+    free(ops);
+    free(records);
+    return ok;
 }
 
-static {{NAME}}_node_t* find_min_value_node ({{NAME}}_node_t* node)
+static void* wal_main (void* argument)
 {
-    {{NAME}}_node_t* current = node;
-    while (current->left != NULL)
-    {
-        current = current->left;
-    }
-    return current;
-}
+    {{NAME}}_wal_t* self = ({{NAME}}_wal_t*) argument;
 
-static {{NAME}}_node_t* delete_node ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key, {{NAME}}_node_t** deleted)
-{
-    if (node == NULL)
-    {
-        return NULL; // Key Not Found
-    }
+    pthread_mutex_lock(&self->mutex);
 
-    // Case: The node to delete is in the left subtree.
-    if (self->comparator(self, key, &node->key) < 0)
-    {
-        node->left = delete_node(self, node->left, key, deleted);
-    }
-    // Case: The node to delete is in the right subtree.
-    else if (self->comparator(self, key, &node->key) > 0)
-    {
-        node->right = delete_node(self, node->right, key, deleted);
-    }
-    // Case: The node to delete does not have any children.
-    else if (node->size == 1)
-    {
-        *deleted = node;
-        return NULL;
-    }
-    // Case: The node to delete only has a right subtree.
-    else if (node->left == NULL)
-    {
-        *deleted = node;
-        node = node->right;
-    }
-    // Case: The node to delete only has a left subtree.
-    else if (node->right == NULL)
-    {
-        *deleted = node;
-        node = node->left;
-    }
-    // Case: The node to delete has both a left subtree and a right subtree.
-    else
+    while (true)
     {
-        *deleted = node;
+        while (0 == self->active_count && false == self->stopping)
+        {
+            pthread_cond_wait(&self->wakeup, &self->mutex);
+        }
+
+        if (0 == self->active_count)
+        {
+            break; // Stopping, and everything is committed.
+        }
 
-        // Find the inorder successor, which has no left subtree by-definition.
-        {{NAME}}_node_t* successor = find_min_value_node(node->right);
+        // Wait for the group to fill up, but no longer than the latency bound allows.
+        const uint64_t deadline = self->first_pending_ns + self->max_latency_ns;
 
-        // Delete the inorder successor
-        {{NAME}}_node_t* deleted_successor = NULL;
-        successor->left = node->left;
-        successor->right = delete_node(self, node->right, &successor->key, &deleted_successor);
-        node = successor;
+        while (self->active_count < self->group_size && false == self->flush_requested && false == self->stopping)
+        {
+            const uint64_t now = wal_now();
+
+            if (now >= deadline)
+            {
+                break;
+            }
+
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            const uint64_t until = (uint64_t) ts.tv_nsec + (deadline - now);
+            ts.tv_sec += until / UINT64_C(1000000000);
+            ts.tv_nsec = until % UINT64_C(1000000000);
+            pthread_cond_timedwait(&self->wakeup, &self->mutex, &ts);
+        }
+
+        // Swap the buffers, so that writers can fill the next group, while this one is written.
+        unsigned char* group = self->active;
+        const size_t group_capacity = self->active_capacity;
+        const size_t length = self->active_count * WAL_RECORD_SIZE;
+        const uint64_t sequence = self->sequence;
+
+        self->active = self->spare;
+        self->active_capacity = self->spare_capacity;
+        self->active_count = 0;
+        self->spare = group;
+        self->spare_capacity = group_capacity;
+        self->flush_requested = false;
+        self->flushing = true;
+
+        pthread_mutex_unlock(&self->mutex);
+        const bool ok = snapshot_write_fully(self->fd, group, length) && 0 == fdatasync(self->fd);
+        pthread_mutex_lock(&self->mutex);
+
+        self->flushing = false;
+        self->failed = self->failed || false == ok;
+        self->durable = ok ? sequence : self->durable;
+        pthread_cond_broadcast(&self->changed);
     }
 
-    return rebalance(self, node, key);
+    pthread_mutex_unlock(&self->mutex);
+    return NULL;
 }
 
-static {{NAME}}_node_t* find_node ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* key)
+/**
+ * Appends a record to the current group, while the mutex is held.
+ */
+static uint64_t wal_append ({{NAME}}_wal_t* self, uint64_t kind, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
 {
-    if (NULL == node)
-    {
-        return NULL;
-    }
-    else if (self->comparator(self, key, &node->key) < 0)
+    if ((self->active_count + 1) * WAL_RECORD_SIZE > self->active_capacity)
     {
-        return find_node(self, node->left, key);
+        const size_t capacity = 2 * (self->active_count + 1) * WAL_RECORD_SIZE;
+        unsigned char* active = (unsigned char*) realloc(self->active, capacity);
+
+        if (NULL == active)
+        {
+            return 0;
+        }
+
+        self->active = active;
+        self->active_capacity = capacity;
     }
-    else if (self->comparator(self, key, &node->key) > 0)
+
+    {{NAME}}_wal_record_t record;
+    memset(&record, 0, sizeof(record)); // Zero the padding, which is part of the checksum.
+    record.sequence = self->sequence + 1;
+    record.kind = kind;
+    record.key = key;
+    record.value = value;
+
+    const uint64_t checksum = snapshot_hash(0, (const unsigned char*) &record, sizeof(record));
+    unsigned char* target = self->active + self->active_count * WAL_RECORD_SIZE;
+    memcpy(target, &record, sizeof(record));
+    memcpy(target + sizeof(record), &checksum, sizeof(checksum));
+
+    if (0 == self->active_count++)
     {
-        return find_node(self, node->right, key);
+        self->first_pending_ns = wal_now();
+        pthread_cond_signal(&self->wakeup);
     }
-    else
+    else if (self->active_count == self->group_size)
     {
-        return node;
+        pthread_cond_signal(&self->wakeup);
     }
+
+    return ++self->sequence;
 }
 
 /**
- * The dynamic allocator does not need any resources;
- * therefore, statically allocate the dynamic allocator.
+ * Locks the log for a mutation, waiting for a compaction or the truncation of a checkpoint to end, if one is in progress.
  */
-static {{NAME}}_allocator_t TREE_DYNAMIC_ALLOCATOR;
-
-static {{NAME}}_node_t* dynamic_allocate ({{NAME}}_allocator_t* self)
+static bool wal_lock ({{NAME}}_wal_t* self)
 {
-    return calloc(1, sizeof({{NAME}}_node_t));
-}
+    pthread_mutex_lock(&self->mutex);
 
-static void wipe ({{NAME}}_node_t* self)
-{
-{% if WIPE %}
-    if (NULL != self)
+    while ((self->compacting || self->truncating) && false == self->failed)
     {
-        memset(self, 0, sizeof({{NAME}}_node_t));
+        pthread_cond_wait(&self->changed, &self->mutex);
     }
-{% end %}
-}
 
-static void dynamic_release ({{NAME}}_allocator_t* self, {{NAME}}_node_t* node)
-{
-    if (NULL != node)
+    if (self->failed)
     {
-        wipe(node);
-        free(node);
+        pthread_mutex_unlock(&self->mutex);
+        return false;
     }
-}
 
-static void dynamic_destroy ({{NAME}}_allocator_t* self)
-{
-    // Pass, because the dynamic allocator is statically allocated.
+    return true;
 }
 
-static {{NAME}}_node_t* pool_allocate ({{NAME}}_allocator_t* self)
+/**
+ * Commits the pending mutations, while the mutex is held, so that the log file is quiet.
+ * The caller blocks new mutations first, by setting the compacting or truncating flag.
+ */
+static void wal_quiesce ({{NAME}}_wal_t* self)
 {
-    {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) self->context;
-
-    if (NULL == context->free)
-    {
-        if (context->allocated < context->capacity)
-        {
-            {{NAME}}_node_t* node = ({{NAME}}_node_t*) calloc(1, sizeof({{NAME}}_node_t));
+    self->flush_requested = true;
+    pthread_cond_signal(&self->wakeup);
 
-            if (NULL == node)
-            {
-                return NULL;
-            }
-            else
-            {
-                ++context->allocated;
-                return node;
-            }
-        }
-        else
-        {
-            return NULL;
-        }
-    }
-    else
+    while ((self->active_count > 0 || self->flushing) && false == self->failed)
     {
-        {{NAME}}_node_t* node = context->free;
-        context->free = context->free->right;
-        return node;
+        pthread_cond_wait(&self->changed, &self->mutex);
     }
 }
 
-static void pool_release ({{NAME}}_allocator_t* self, {{NAME}}_node_t* node)
+/**
+ * @brief Recovers a tree from a snapshot and a log, and then opens the log for appending.
+ * @param tree Pointer to the tree, which is usually empty, and which must only be mutated through the log from now on.
+ * @param snapshot_path Path of the snapshot file, which need not exist yet.
+ * @param log_path Path of the log file, which is created if it does not exist yet.
+ * @param group_size Maximum number of records committed by a single fsync.
+ * @param max_latency_ns Longest time that a record waits for its group to fill up, in nanoseconds.
+ * @return Pointer to the opened log or NULL if recovery failed.
+ */
+{{NAME}}_wal_t* {{NAME}}_wal_open ({{NAME}}_t* tree, const char* snapshot_path, const char* log_path, size_t group_size, uint64_t max_latency_ns)
 {
-    wipe(node);
-    {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) self->context;
-    node->right = context->free;
-    context->free = node;
-}
+    {{NAME}}_wal_t* self = ({{NAME}}_wal_t*) calloc(1, sizeof({{NAME}}_wal_t));
 
-static void pool_destroy ({{NAME}}_allocator_t* self)
-{
-    if (NULL != self)
+    if (NULL == self)
     {
-        {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) self->context;
+        return NULL;
+    }
 
-        if (NULL != context)
-        {
-            {{NAME}}_node_t* p = context->free;
-            {{NAME}}_node_t* q = NULL;
-            while (NULL != p)
-            {
-                q = p->right;
-                free(p);
-                p = q;
-            }
+    self->tree = tree;
+    self->group_size = group_size < 1 ? 1 : group_size;
+    self->max_latency_ns = max_latency_ns;
+    self->snapshot_path = strdup(snapshot_path);
+    self->log_path = strdup(log_path);
+    self->fd = -1;
+
+    if (NULL == self->snapshot_path || NULL == self->log_path)
+    {
+        free(self->snapshot_path);
+        free(self->log_path);
+        free(self);
+        return NULL;
+    }
 
-            context->free = NULL;
+    // Load the last snapshot, if there is one.
+    const int snapshot = open(snapshot_path, O_RDONLY);
+    bool ok = snapshot >= 0 || ENOENT == errno;
 
-            free(context);
-            self->context = NULL;
+    if (snapshot >= 0)
+    {
+        ok = {{NAME}}_load(tree, snapshot);
+        close(snapshot);
+    }
+
+    // Replay the log on top of the snapshot.
+    self->fd = ok ? open(log_path, O_RDWR | O_CREAT, 0644) : -1;
+    ok = ok && self->fd >= 0 && wal_replay(self);
+    self->durable = self->sequence;
+
+    if (ok)
+    {
+        pthread_condattr_t attributes;
+        pthread_condattr_init(&attributes);
+        pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+        pthread_cond_init(&self->wakeup, &attributes);
+        pthread_cond_init(&self->changed, &attributes);
+        pthread_condattr_destroy(&attributes);
+        pthread_mutex_init(&self->mutex, NULL);
+
+        if (0 != pthread_create(&self->committer, NULL, &wal_main, self))
+        {
+            pthread_mutex_destroy(&self->mutex);
+            pthread_cond_destroy(&self->wakeup);
+            pthread_cond_destroy(&self->changed);
+            ok = false;
+        }
+    }
+
+    if (false == ok)
+    {
+        if (self->fd >= 0)
+        {
+            close(self->fd);
         }
 
+        free(self->snapshot_path);
+        free(self->log_path);
         free(self);
+        return NULL;
     }
+
+    return self;
 }
 
-static {{NAME}}_node_t* slab_allocate ({{NAME}}_allocator_t* self)
+/**
+ * @brief Commits all pending records, closes the log, and frees its resources (but not the tree).
+ * @param self Pointer to the log.
+ * @return true if all records were committed, false if an I/O error occurred at any point.
+ */
+bool {{NAME}}_wal_close ({{NAME}}_wal_t* self)
 {
-    {{NAME}}_allocator_slab_t* context = ({{NAME}}_allocator_slab_t*) self->context;
-
-    if (NULL == context->free)
-    {
-        return NULL;
-    }
-    else
+    if (NULL == self)
     {
-        {{NAME}}_node_t* node = context->free;
-        context->free = context->free->right;
-        return node;
+        return true;
     }
+
+    {{NAME}}_wal_waitCheckpoint(self);
+
+    pthread_mutex_lock(&self->mutex);
+    self->stopping = true;
+    pthread_cond_signal(&self->wakeup);
+    pthread_mutex_unlock(&self->mutex);
+
+    pthread_join(self->committer, NULL);
+
+    const bool ok = false == self->failed && 0 == close(self->fd);
+
+    pthread_mutex_destroy(&self->mutex);
+    pthread_cond_destroy(&self->wakeup);
+    pthread_cond_destroy(&self->changed);
+    free(self->active);
+    free(self->spare);
+    free(self->snapshot_path);
+    free(self->log_path);
+    free(self);
+    return ok;
 }
 
-static void slab_release ({{NAME}}_allocator_t* self, {{NAME}}_node_t* node)
+/**
+ * @brief Inserts a key-value pair into the tree and appends it to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return Sequence number of the record, or zero if the insertion failed or the log has failed.
+ */
+uint64_t {{NAME}}_wal_put ({{NAME}}_wal_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
 {
-    wipe(node);
-    {{NAME}}_allocator_slab_t* context = ({{NAME}}_allocator_slab_t*) self->context;
-    node->right = context->free;
-    context->free = node;
+    if (false == wal_lock(self))
+    {
+        return 0;
+    }
+
+    const uint64_t sequence = {{NAME}}_put(self->tree, key, value) ? wal_append(self, WAL_PUT, key, value) : 0;
+    pthread_mutex_unlock(&self->mutex);
+    return sequence;
 }
 
-static void slab_destroy ({{NAME}}_allocator_t* self)
+/**
+ * @brief Removes a key from the tree and appends the removal to the log (thread-safe).
+ * @param self Pointer to the log.
+ * @param key Key to remove.
+ * @return Sequence number of the record, or zero if the log has failed.
+ */
+uint64_t {{NAME}}_wal_remove ({{NAME}}_wal_t* self, {{KEY_TYPE}} key)
 {
-    if (NULL != self)
+    if (false == wal_lock(self))
     {
-        if (NULL != self->context)
-        {
-            free(self->context);
-            self->context = NULL;
-        }
-
-        free(self);
+        return 0;
     }
+
+    {{NAME}}_remove(self->tree, key);
+    const uint64_t sequence = wal_append(self, WAL_REMOVE, key, {{NAME}}_defaultValue());
+    pthread_mutex_unlock(&self->mutex);
+    return sequence;
 }
 
 /**
- * @brief Creates a new dynamic tree allocator.
- * @return Pointer to the newly created tree allocator.
+ * @brief Waits until the record with a given sequence number, and all records before it, are durable.
+ * @param self Pointer to the log.
+ * @param sequence Sequence number returned by a put or remove.
+ * @return true if the records are durable, false if an I/O error occurred.
  */
-{{NAME}}_allocator_t* {{NAME}}_allocator_dynamic ()
+bool {{NAME}}_wal_sync ({{NAME}}_wal_t* self, uint64_t sequence)
 {
-    TREE_DYNAMIC_ALLOCATOR.allocate = &dynamic_allocate;
-    TREE_DYNAMIC_ALLOCATOR.release = &dynamic_release;
-    TREE_DYNAMIC_ALLOCATOR.destroy = &dynamic_destroy;
-    return &TREE_DYNAMIC_ALLOCATOR;
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->durable < sequence && false == self->failed)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+
+    const bool ok = self->durable >= sequence;
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
 }
 
 /**
- * @brief Creates a new pooled tree allocator with preallocated nodes.
- * @param preallocated Number of nodes to preallocate.
- * @param capacity Maximum capacity of the pooled allocator.
- * @return Pointer to the newly created pooled tree allocator.
+ * @brief Writes a new snapshot of the tree and truncates the log, while mutations wait.
+ * @param self Pointer to the log.
+ * @return true if the compaction succeeded, false otherwise (a failed snapshot leaves the log intact).
  */
-{{NAME}}_allocator_t* {{NAME}}_allocator_pooled (size_t preallocated, size_t capacity)
+bool {{NAME}}_wal_compact ({{NAME}}_wal_t* self)
 {
-    {{NAME}}_allocator_t* self = ({{NAME}}_allocator_t*) calloc(1, sizeof({{NAME}}_allocator_t));
+    pthread_mutex_lock(&self->mutex);
 
-    if (NULL == self)
+    // Compactions and checkpoints exclude each other, since both replace the snapshot and the log.
+    while ((self->compacting || self->checkpointing) && false == self->failed)
     {
-        goto cleanup;
+        pthread_cond_wait(&self->changed, &self->mutex);
     }
-    else
+
+    if (self->failed)
     {
-        self->allocate = pool_allocate;
-        self->release = pool_release;
-        self->destroy = pool_destroy;
+        pthread_mutex_unlock(&self->mutex);
+        return false;
     }
 
-    {{NAME}}_allocator_pooled_t* context = ({{NAME}}_allocator_pooled_t*) calloc(1, sizeof({{NAME}}_allocator_pooled_t));
+    self->compacting = true;
+    wal_quiesce(self);
 
-    if (NULL == self)
+    // Write the snapshot under a temporary name, and then atomically replace the old snapshot.
+    char* temporary = wal_temporary_path(self->snapshot_path);
+    bool ok = false == self->failed && NULL != temporary;
+
+    if (ok)
     {
-        goto cleanup;
+        const int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ok = fd >= 0 && {{NAME}}_save(self->tree, fd) && 0 == fsync(fd);
+        ok = fd >= 0 && 0 == close(fd) && ok;
+        ok = ok && 0 == rename(temporary, self->snapshot_path) && wal_sync_directory(self->snapshot_path);
+
+        if (false == ok)
+        {
+            unlink(temporary);
+        }
     }
-    else
+
+    // The snapshot now contains every record; therefore, the log can be emptied.
+    if (ok && false == wal_reset(self->fd, self->sequence))
     {
-        self->context = (void*) context;
-        context->capacity = capacity;
-        context->allocated = preallocated;
+        self->failed = true;
+        ok = false;
     }
 
-    for (size_t i = 0; i < preallocated; i++)
+    self->base = ok ? self->sequence : self->base;
+
+    free(temporary);
+    self->compacting = false;
+    pthread_cond_broadcast(&self->changed);
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
+}
+
+/**
+ * Writes a fuzzy snapshot of the tree, copying one chunk of entries at a time, while holding the mutex.
+ * The snapshot is only valid together with the records of the log after the start of the checkpoint.
+ * Since the number of entries is unknown until the end, the header is rewritten, and the checksum is computed, afterwards.
+ */
+static bool wal_checkpoint_dump ({{NAME}}_wal_t* self, int fd, uint64_t* pause_ns, uint64_t* bytes)
+{
+    {{NAME}}_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    {{KEY_TYPE}}* keys = ({{KEY_TYPE}}*) malloc(WAL_CHECKPOINT_CHUNK * sizeof({{KEY_TYPE}}));
+    {{VALUE_TYPE}}* values = ({{VALUE_TYPE}}*) malloc(WAL_CHECKPOINT_CHUNK * sizeof({{VALUE_TYPE}}));
+    {{NAME}}_node_t* stack[TREE_MAX_HEIGHT];
+    {{KEY_TYPE}} last;
+    uint64_t count = 0;
+    bool done = false;
+
+    {{NAME}}_snapshot_header_t header;
+    snapshot_header(&header, 0);
+    bool ok = NULL != stream.buffer && NULL != keys && NULL != values && snapshot_put(&stream, &header, sizeof(header));
+
+    while (ok && false == done)
     {
-        {{NAME}}_node_t* node = calloc(1, sizeof({{NAME}}_node_t));
+        pthread_mutex_lock(&self->mutex);
+        const uint64_t start = wal_now();
 
-        if (NULL == node)
+        // Descend to the first entry after the last copied key, and then continue in order from there.
+        size_t depth = 0;
+        size_t length = 0;
+        {{NAME}}_node_t* node = self->tree->root;
+
+        while (NULL != node)
         {
-            goto cleanup;
+            if (0 == count || self->tree->comparator(self->tree, &last, &node->key) < 0)
+            {
+                stack[depth++] = node;
+                node = node->left;
+            }
+            else
+            {
+                node = node->right;
+            }
         }
-        else
+
+        while (depth > 0 && length < WAL_CHECKPOINT_CHUNK)
         {
-            node->right = context->free;
-            context->free = node;
+            node = stack[--depth];
+            keys[length] = node->key;
+            values[length] = node->value;
+            ++length;
+
+            for (node = node->right; NULL != node; node = node->left)
+            {
+                stack[depth++] = node;
+            }
+        }
+
+        done = 0 == depth;
+        self->checkpoint_stats.entries_written += length;
+        const uint64_t pause = wal_now() - start;
+        *pause_ns = pause > *pause_ns ? pause : *pause_ns;
+        pthread_mutex_unlock(&self->mutex);
+
+        // The chunk is written, while writers continue.
+        for (size_t i = 0; ok && i < length; i++)
+        {
+            ok = snapshot_put(&stream, &keys[i], sizeof({{KEY_TYPE}})) && snapshot_put(&stream, &values[i], sizeof({{VALUE_TYPE}}));
         }
+
+        last = length > 0 ? keys[length - 1] : last;
+        count += length;
     }
 
-    return self;
+    ok = ok && snapshot_flush(&stream);
 
-cleanup:
-    pool_destroy(self);
-    return NULL;
+    // Rewrite the header with the final count, and then checksum the file from the start.
+    snapshot_header(&header, count);
+    ok = ok && (ssize_t) sizeof(header) == pwrite(fd, &header, sizeof(header), 0) && 0 == lseek(fd, 0, SEEK_SET);
+
+    uint64_t remaining = sizeof(header) + count * (sizeof({{KEY_TYPE}}) + sizeof({{VALUE_TYPE}}));
+    uint64_t checksum = 0;
+    *bytes = remaining + sizeof(checksum);
+
+    while (ok && remaining > 0)
+    {
+        const size_t length = remaining < SNAPSHOT_BUFFER_SIZE ? (size_t) remaining : SNAPSHOT_BUFFER_SIZE;
+        ok = snapshot_read_fully(fd, stream.buffer, length);
+        checksum = snapshot_hash(checksum, stream.buffer, length);
+        remaining -= length;
+    }
+
+    ok = ok && snapshot_write_fully(fd, &checksum, sizeof(checksum));
+
+    free(stream.buffer);
+    free(keys);
+    free(values);
+    return ok;
 }
 
 /**
- * @brief Creates a new slab tree allocator with a specified capacity.
- * @param capacity Maximum capacity of the slab allocator.
- * @return Pointer to the newly created slab tree allocator.
+ * Replaces the log file with a new one, which contains the records from an offset onwards, while the log is quiet.
  */
-{{NAME}}_allocator_t* {{NAME}}_allocator_slab (size_t capacity)
+static bool wal_checkpoint_truncate ({{NAME}}_wal_t* self, off_t offset, uint64_t base)
 {
-    {{NAME}}_allocator_t* self = ({{NAME}}_allocator_t*) calloc(1, sizeof({{NAME}}_allocator_t) + capacity * sizeof({{NAME}}_node_t));
+    char* temporary = wal_temporary_path(self->log_path);
+    const int fd = NULL == temporary ? -1 : open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    unsigned char* buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+    const off_t end = lseek(self->fd, 0, SEEK_END);
 
-    if (NULL == self)
-    {
-        goto cleanup;
-    }
-    else
+    {{NAME}}_wal_header_t header;
+    wal_header(&header, base);
+    bool ok = fd >= 0 && NULL != buffer && end >= offset && snapshot_write_fully(fd, &header, sizeof(header));
+
+    for (off_t position = offset; ok && position < end; )
     {
-        self->allocate = slab_allocate;
-        self->release = slab_release;
-        self->destroy = slab_destroy;
+        const size_t length = end - position < SNAPSHOT_BUFFER_SIZE ? (size_t) (end - position) : SNAPSHOT_BUFFER_SIZE;
+        ok = (ssize_t) length == pread(self->fd, buffer, length, position) && snapshot_write_fully(fd, buffer, length);
+        position += (off_t) length;
     }
 
-    {{NAME}}_allocator_slab_t* context = ({{NAME}}_allocator_slab_t*) calloc(1, sizeof({{NAME}}_allocator_slab_t) + capacity * sizeof({{NAME}}_node_t));
+    ok = ok && 0 == fsync(fd) && 0 == rename(temporary, self->log_path);
 
-    if (NULL == self)
+    if (ok)
     {
-        goto cleanup;
+        close(self->fd);
+        self->fd = fd;
+        self->base = base;
+        ok = wal_sync_directory(self->log_path);
     }
     else
     {
-        self->context = (void*) context;
-        context->capacity = capacity;
-    }
-
-    for (size_t i = 0; i < capacity; i++)
-    {
-        {{NAME}}_node_t* node = &context->nodes[i];
-
-        if (NULL == node)
+        if (fd >= 0)
         {
-            goto cleanup;
+            close(fd);
         }
-        else
+
+        if (NULL != temporary)
         {
-            node->right = context->free;
-            context->free = node;
+            unlink(temporary);
         }
     }
 
-    return self;
+    free(buffer);
+    free(temporary);
+    return ok;
+}
 
-cleanup:
-    slab_destroy(self);
+static void* wal_checkpoint_main (void* argument)
+{
+    {{NAME}}_wal_t* self = ({{NAME}}_wal_t*) argument;
+    const uint64_t started = wal_now();
+    uint64_t pause = 0;
+    uint64_t bytes = 0;
+
+    // Every record after the start of the checkpoint stays in the log, so that recovery can complete the fuzzy snapshot.
+    // Since only the checkpoint truncates the log, the base and the offset of that record stay the same until then.
+    pthread_mutex_lock(&self->mutex);
+    const uint64_t sequence = self->checkpoint_sequence;
+    const off_t offset = (off_t) (sizeof({{NAME}}_wal_header_t) + (sequence - self->base) * WAL_RECORD_SIZE);
+    pthread_mutex_unlock(&self->mutex);
+
+    // Write the snapshot under a temporary name, and then atomically replace the old snapshot.
+    char* temporary = wal_temporary_path(self->snapshot_path);
+    const int fd = NULL == temporary ? -1 : open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && wal_checkpoint_dump(self, fd, &pause, &bytes) && 0 == fsync(fd);
+    ok = fd >= 0 && 0 == close(fd) && ok;
+    ok = ok && 0 == rename(temporary, self->snapshot_path) && wal_sync_directory(self->snapshot_path);
+
+    if (false == ok && NULL != temporary)
+    {
+        unlink(temporary);
+    }
+
+    free(temporary);
+
+    // Drop the records that the snapshot covers, while writers wait.
+    pthread_mutex_lock(&self->mutex);
+    self->truncating = true;
+    wal_quiesce(self);
+
+    const uint64_t start = wal_now();
+    ok = ok && false == self->failed && wal_checkpoint_truncate(self, offset, sequence);
+    const uint64_t end = wal_now();
+
+    if (ok)
+    {
+        self->checkpoint_stats.checkpoints++;
+        self->checkpoint_stats.bytes_written = bytes;
+        self->checkpoint_stats.sequence = sequence;
+        self->checkpoint_stats.last_duration_ns = end - started;
+        self->checkpoint_stats.last_pause_ns = end - start > pause ? end - start : pause;
+        self->checkpoint_stats.total_duration_ns += end - started;
+    }
+    else
+    {
+        self->checkpoint_stats.failures++;
+    }
+
+    self->checkpoint_stats.running = false;
+    self->checkpoint_ok = ok;
+    self->checkpointing = false;
+    self->truncating = false;
+    pthread_cond_broadcast(&self->changed);
+    pthread_mutex_unlock(&self->mutex);
     return NULL;
 }
 
 /**
- * @brief Frees the resources associated with a tree allocator.
- * @param self Pointer to the tree allocator to free.
- */
-void {{NAME}}_allocator_free ({{NAME}}_allocator_t* self)
+ * @brief Starts a checkpoint on a background thread, which writes a new snapshot while writers continue.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint was started, false if one is already running or the thread cannot be created.
+ *
+ * A checkpoint copies the tree in small chunks, locking out writers only while a chunk is copied.
+ * The resulting snapshot is fuzzy; it reflects each key at some point after the checkpoint started.
+ * Recovery still reaches the exact state, because the log keeps every record after that point.
+ * When the snapshot is durable, the log is replaced by just those records,
+ * which is the only other time when writers wait (for as long as the copy of these records takes).
+ *
+ * Notes:
+ * - The snapshot file is not valid on its own, but only together with the log. It may mix states from different
+ *   points in time, so it must not be loaded with {{NAME}}_load() alone, or be used as a backup or for a standby.
+ *   Use {{NAME}}_wal_compact(), or {{NAME}}_save() on a quiescent tree, for a consistent snapshot.
+ * - Every checkpoint rewrites the whole tree, so its cost grows with the size of the tree, not with the number of changes.
+ */
+bool {{NAME}}_wal_startCheckpoint ({{NAME}}_wal_t* self)
 {
-    if (NULL != self)
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->compacting && false == self->failed && false == self->checkpointing)
     {
-        self->destroy(self);
+        pthread_cond_wait(&self->changed, &self->mutex);
     }
-}
 
-static int {{NAME}}_naturalOrder ({{NAME}}_t* self, {{KEY_TYPE}}* X, {{KEY_TYPE}}* Y)
-{
-{% if COMPARATOR != "" %}
-    return {{COMPARATOR}};
-{% elif STRNCMP != "" %}
-    return strncmp(X, Y, {{STRNCMP}});
-{% else %}
-    return *X < *Y ? -1 : (*X > *Y ? +1 : 0);
-{% end %}
-}
+    if (self->checkpointing || self->failed)
+    {
+        pthread_mutex_unlock(&self->mutex);
+        return false;
+    }
 
-static int {{NAME}}_reverseOrder ({{NAME}}_t* self, {{KEY_TYPE}}* X, {{KEY_TYPE}}* Y)
-{
-    return {{NAME}}_naturalOrder(self, Y, X);
+    // The previous checkpoint has released the mutex for the last time; therefore, joining it here does not block.
+    if (self->checkpoint_joinable)
+    {
+        pthread_join(self->checkpointer, NULL);
+        self->checkpoint_joinable = false;
+    }
+
+    // The start of the checkpoint is fixed before its thread runs, so that the writes until then are not counted into it.
+    self->checkpoint_sequence = self->sequence;
+    self->checkpoint_stats.entries_written = 0;
+    self->checkpoint_stats.entries_expected = self->tree->size;
+
+    const bool ok = 0 == pthread_create(&self->checkpointer, NULL, &wal_checkpoint_main, self);
+
+    self->checkpoint_joinable = ok;
+    self->checkpointing = ok;
+    self->checkpoint_stats.running = ok;
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
 }
 
 /**
- * @brief Returns the natural order comparator function for keys.
- * @return Function pointer to the natural order comparator.
+ * @brief Waits until the checkpoint that was started last completes.
+ * @param self Pointer to the log.
+ * @return true if the checkpoint succeeded, false if it failed or no checkpoint was ever started.
  */
-{{NAME}}_comparator_t {{NAME}}_comparator_naturalOrder ()
+bool {{NAME}}_wal_waitCheckpoint ({{NAME}}_wal_t* self)
 {
-    return &{{NAME}}_naturalOrder;
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->checkpointing)
+    {
+        pthread_cond_wait(&self->changed, &self->mutex);
+    }
+
+    // The checkpoint has released the mutex for the last time; therefore, joining it here does not block.
+    if (self->checkpoint_joinable)
+    {
+        pthread_join(self->checkpointer, NULL);
+        self->checkpoint_joinable = false;
+    }
+
+    const bool ok = self->checkpoint_ok;
+    pthread_mutex_unlock(&self->mutex);
+    return ok;
 }
 
 /**
- * @brief Returns the reverse order comparator function for keys.
- * @return Function pointer to the reverse order comparator.
+ * @brief Retrieves the progress and timing counters of the checkpoints of a log.
+ * @param self Pointer to the log.
+ * @return Copy of the counters.
  */
-{{NAME}}_comparator_t {{NAME}}_comparator_reverseOrder ()
+{{NAME}}_wal_checkpoint_stats_t {{NAME}}_wal_checkpointStats ({{NAME}}_wal_t* self)
 {
-    return &{{NAME}}_reverseOrder;
+    pthread_mutex_lock(&self->mutex);
+    const {{NAME}}_wal_checkpoint_stats_t stats = self->checkpoint_stats;
+    pthread_mutex_unlock(&self->mutex);
+    return stats;
 }
+{% end %}
+
+{% if PACK_INTEGERS %}
+#define PACKED_MAGIC "TREEPACK"
+#define PACKED_VERSION 1
 
 /**
- * @brief Returns the default key value.
- * @return Default key.
+ * Number of entries in a block, which share a bit width for the keys and one for the values.
  */
-{{KEY_TYPE}} {{NAME}}_defaultKey ()
+#define PACKED_BLOCK 128
+
+typedef struct
 {
-{% if DEFAULT_KEY == "" %}
-    return 0;
-{% else %}
-    return {{DEFAULT_KEY}};
-{% end %}
-}
+    char magic[8];
 
-/**
- * @brief Returns the default data value.
- * @return Default data value.
- */
-{{VALUE_TYPE}} {{NAME}}_defaultValue ()
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint64_t count;
+
+    /**
+     * Number of bytes in the blocks, which follow the header.
+     */
+    uint64_t length;
+
+} {{NAME}}_packed_header_t;
+
+typedef struct
 {
-{% if DEFAULT_VALUE == "" %}
-    return 0;
-{% else %}
-    return {{DEFAULT_VALUE}};
-{% end %}
-}
+    /**
+     * Key of the first entry, sign-extended to 64 bits; the remaining keys are stored as differences.
+     */
+    uint64_t first_key;
+
+    /**
+     * Smallest value in the block, sign-extended to 64 bits; the values are stored as differences to it.
+     */
+    uint64_t value_base;
+
+    uint16_t count;
+
+    uint8_t key_width;
+
+    uint8_t value_width;
+
+    uint32_t reserved;
+
+} {{NAME}}_packed_block_t;
 
 /**
- * @brief Creates a new instance of the AVL tree.
- * @return Pointer to the newly created AVL tree.
+ * A block in its unpacked form.
  */
-{{NAME}}_t* {{NAME}}_new ()
+typedef struct
 {
-    {{NAME}}_allocator_t* allocator = {{NAME}}_allocator_dynamic();
-    {{NAME}}_comparator_t comparator = {{NAME}}_comparator_naturalOrder();
-    return {{NAME}}_make(allocator, comparator);
-}
+    size_t count;
 
-/**
- * @brief Creates a new AVL tree with a specified allocator and comparator.
- * @param allocator Pointer to the tree allocator.
- * @param comparator Function pointer for key comparison.
- * @return Pointer to the newly created AVL tree.
- */
-{{NAME}}_t* {{NAME}}_make ({{NAME}}_allocator_t* allocator, {{NAME}}_comparator_t comparator)
+    uint64_t keys[PACKED_BLOCK];
+
+    uint64_t values[PACKED_BLOCK];
+
+    uint64_t words[PACKED_BLOCK];
+
+} {{NAME}}_packed_buffer_t;
+
+static unsigned packed_width (uint64_t x)
 {
-    {{NAME}}_t* result = calloc(1, sizeof({{NAME}}_t));
+    unsigned width = 0;
 
-    if (NULL == result)
+    while (x > 0)
     {
-        return NULL;
+        ++width;
+        x >>= 1;
     }
 
-    result->allocator = allocator;
-    result->size = 0;
-    result->root = NULL;
-    result->comparator = comparator;
+    return width;
+}
 
-    return result;
+static size_t packed_words (size_t count, unsigned width)
+{
+    return (count * width + 63) / 64;
 }
 
-/**
- * @brief Frees the resources of an AVL tree.
- * @param self Pointer to the AVL tree to free.
- */
-void {{NAME}}_free ({{NAME}}_t* self)
+static void packed_encode (const uint64_t* input, size_t count, unsigned width, uint64_t* output)
 {
-    if (NULL != self)
+    memset(output, 0, packed_words(count, width) * sizeof(uint64_t));
+
+    for (size_t i = 0; width > 0 && i < count; i++)
     {
-        {{NAME}}_clear(self);
-        self->allocator = NULL;
-        free(self);
+        const size_t bit = i * width;
+        const unsigned shift = bit % 64;
+        output[bit / 64] |= input[i] << shift;
+
+        if (shift + width > 64)
+        {
+            output[bit / 64 + 1] |= input[i] >> (64 - shift);
+        }
     }
 }
 
-/**
- * @brief Creates an AVL tree with stack-allocated properties.
- * @param allocator Pointer to the tree allocator.
- * @param comparator Function pointer for key comparison.
- * @return Stack-allocated AVL tree structure.
- */
-{{NAME}}_t {{NAME}}_make_stackalloc ({{NAME}}_allocator_t* allocator, {{NAME}}_comparator_t comparator)
+static void packed_decode (const uint64_t* input, size_t count, unsigned width, uint64_t* output)
 {
-    {{NAME}}_t result;
-    result.allocator = allocator;
-    result.comparator = comparator;
-    return result;
-}
+    const uint64_t mask = 64 == width ? UINT64_MAX : (UINT64_C(1) << width) - 1;
 
-/**
- * @brief Frees the resources of a stack-allocated AVL tree.
- * @param self Pointer to the stack-allocated AVL tree.
- */
-void {{NAME}}_free_stackalloc ({{NAME}}_t* self)
-{
-    if (NULL != self)
+    for (size_t i = 0; i < count; i++)
     {
-        {{NAME}}_clear(self);
-        self->allocator = NULL;
-        self->comparator = NULL;
+        const size_t bit = i * width;
+        const unsigned shift = bit % 64;
+        const uint64_t low = 0 == width ? 0 : input[bit / 64] >> shift;
+        const uint64_t high = shift + width > 64 ? input[bit / 64 + 1] << (64 - shift) : 0;
+        output[i] = (low | high) & mask;
     }
 }
 
 /**
- * @brief Creates a copy of an existing AVL tree.
- * @param self Pointer to the tree to be copied.
- * @return Pointer to the newly created copy of the tree.
+ * Encodes and writes the block in a buffer, or only measures it, if the stream is NULL.
  */
-{{NAME}}_t* {{NAME}}_copy ({{NAME}}_t* self)
+static bool packed_flush ({{NAME}}_snapshot_stream_t* stream, {{NAME}}_packed_buffer_t* buffer, uint64_t* length)
 {
-    {{NAME}}_t* copy = {{NAME}}_make(self->allocator, self->comparator);
+    {{NAME}}_packed_block_t block;
+    memset(&block, 0, sizeof(block));
+    block.count = (uint16_t) buffer->count;
+    block.first_key = buffer->keys[0];
+    block.value_base = buffer->values[0];
 
-    if (NULL == copy)
+    // Modular differences also round trip, when the comparator does not order the keys numerically.
+    uint64_t key_bits = 0;
+    uint64_t value_bits = 0;
+
+    for (size_t i = 1; i < buffer->count; i++)
     {
-        return NULL;
+        block.value_base = (int64_t) buffer->values[i] < (int64_t) block.value_base ? buffer->values[i] : block.value_base;
     }
-    else if ({{NAME}}_putAll(copy, self))
+
+    for (size_t i = buffer->count - 1; i > 0; i--)
     {
-        return copy;
+        buffer->keys[i] -= buffer->keys[i - 1];
+        key_bits |= buffer->keys[i];
     }
-    else
+
+    for (size_t i = 0; i < buffer->count; i++)
     {
-        {{NAME}}_free(copy);
-        return NULL;
+        buffer->values[i] -= block.value_base;
+        value_bits |= buffer->values[i];
+    }
+
+    block.key_width = (uint8_t) packed_width(key_bits);
+    block.value_width = (uint8_t) packed_width(value_bits);
+
+    const size_t key_words = packed_words(buffer->count - 1, block.key_width);
+    const size_t value_words = packed_words(buffer->count, block.value_width);
+    *length += sizeof(block) + (key_words + value_words) * sizeof(uint64_t);
+
+    if (NULL == stream)
+    {
+        buffer->count = 0;
+        return true;
     }
+
+    bool ok = snapshot_put(stream, &block, sizeof(block));
+    packed_encode(buffer->keys + 1, buffer->count - 1, block.key_width, buffer->words);
+    ok = ok && snapshot_put(stream, buffer->words, key_words * sizeof(uint64_t));
+    packed_encode(buffer->values, buffer->count, block.value_width, buffer->words);
+    ok = ok && snapshot_put(stream, buffer->words, value_words * sizeof(uint64_t));
+
+    buffer->count = 0;
+    return ok;
 }
 
 /**
- * @brief Retrieves the number of nodes in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Number of nodes in the tree.
+ * Encodes the entries of the tree in order, either writing them, or only measuring their length, if the stream is NULL.
  */
-size_t {{NAME}}_size ({{NAME}}_t* self)
+static bool packed_blocks ({{NAME}}_t* self, {{NAME}}_snapshot_stream_t* stream, {{NAME}}_packed_buffer_t* buffer, uint64_t* length)
 {
-    return self->size;
+    {{NAME}}_node_t* stack[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    {{NAME}}_node_t* node = self->root;
+    bool ok = true;
+
+    buffer->count = 0;
+    *length = 0;
+
+    while (ok && (NULL != node || depth > 0))
+    {
+        while (NULL != node)
+        {
+            stack[depth++] = node;
+            node = node->left;
+        }
+
+        node = stack[--depth];
+        buffer->keys[buffer->count] = (uint64_t) (int64_t) node->key;
+        buffer->values[buffer->count] = (uint64_t) (int64_t) node->value;
+        node = node->right;
+
+        if (++buffer->count == PACKED_BLOCK)
+        {
+            ok = packed_flush(stream, buffer, length);
+        }
+    }
+
+    return ok && (0 == buffer->count || packed_flush(stream, buffer, length));
+}
+
+static void packed_header ({{NAME}}_packed_header_t* header, uint64_t count, uint64_t length)
+{
+    memset(header, 0, sizeof({{NAME}}_packed_header_t));
+    memcpy(header->magic, PACKED_MAGIC, sizeof(header->magic));
+    header->version = PACKED_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->key_size = (uint32_t) sizeof({{KEY_TYPE}});
+    header->value_size = (uint32_t) sizeof({{VALUE_TYPE}});
+    header->count = count;
+    header->length = length;
 }
 
 /**
- * @brief Checks if the AVL tree is empty.
+ * @brief Writes a packed binary snapshot of the AVL tree, whose keys and values are integers, to a file descriptor.
  * @param self Pointer to the AVL tree.
- * @return true if the tree is empty, false otherwise.
- */
-bool {{NAME}}_isEmpty ({{NAME}}_t* self)
+ * @param fd File descriptor, which is written sequentially (pipes and sockets are fine).
+ * @return true if the snapshot was written completely, false if an I/O error occurred.
+ *
+ * The entries are stored in blocks of 128. Within a block, the differences between consecutive keys,
+ * and the differences between the values and the smallest value, are bit-packed using the fewest bits
+ * that fit the largest difference (frame-of-reference encoding). Dense ascending keys take about one bit each.
+ * Like a plain snapshot, a packed snapshot has a header and a trailing checksum.
+ */
+bool {{NAME}}_savePacked ({{NAME}}_t* self, int fd)
 {
-    // This is implemented as a pointer comparison,
-    // because isEmpty() is called by other functions,
-    // wheren nodes are being added and/or removed.
-    // In those cases, size() may be momentarily inaccurate.
-    return (NULL == self) || (NULL == self->root);
+    {{NAME}}_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    {{NAME}}_packed_buffer_t* buffer = ({{NAME}}_packed_buffer_t*) malloc(sizeof({{NAME}}_packed_buffer_t));
+    bool ok = NULL != stream.buffer && NULL != buffer;
+
+    // The header records the length of the blocks, so that a reader never consumes the checksum early.
+    // Measuring first takes an extra pass over the tree, but no seeking; therefore, pipes remain usable.
+    uint64_t length = 0;
+    ok = ok && packed_blocks(self, NULL, buffer, &length);
+
+    {{NAME}}_packed_header_t header;
+    packed_header(&header, self->size, length);
+    ok = ok && snapshot_put(&stream, &header, sizeof(header));
+    ok = ok && packed_blocks(self, &stream, buffer, &length);
+    ok = ok && snapshot_flush(&stream);
+    ok = ok && snapshot_write_fully(fd, &stream.checksum, sizeof(stream.checksum));
+
+    free(stream.buffer);
+    free(buffer);
+    return ok;
 }
 
 /**
- * @brief Clears all nodes from the AVL tree.
- * @param self Pointer to the AVL tree.
+ * @brief Reads a packed binary snapshot from a file descriptor into the AVL tree.
+ * @param self Pointer to the AVL tree, which must use the same comparator as the saved tree.
+ * @param fd File descriptor, which is read sequentially.
+ * @return true if the snapshot was loaded, false otherwise (the tree is then left unchanged).
+ *
+ * Decoding a block takes fixed-width shifts and masks, followed by a prefix sum of the key differences,
+ * without any data-dependent branches.
  */
-void {{NAME}}_clear ({{NAME}}_t* self)
+bool {{NAME}}_loadPacked ({{NAME}}_t* self, int fd)
 {
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {{NAME}}_snapshot_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = fd;
+    stream.remaining = sizeof({{NAME}}_packed_header_t);
+    stream.buffer = (unsigned char*) malloc(SNAPSHOT_BUFFER_SIZE);
+
+    {{NAME}}_packed_buffer_t* buffer = ({{NAME}}_packed_buffer_t*) malloc(sizeof({{NAME}}_packed_buffer_t));
+    {{NAME}}_packed_header_t header;
+    {{NAME}}_packed_header_t expected;
+
+    if (NULL == stream.buffer || NULL == buffer || false == snapshot_get(&stream, &header, sizeof(header)))
     {
-        while ({{NAME}}_isEmpty(self) == false)
+        free(stream.buffer);
+        free(buffer);
+        return false;
+    }
+
+    packed_header(&expected, header.count, header.length);
+
+    if (0 != memcmp(&header, &expected, sizeof(header)) || header.count > (SIZE_MAX / 2 - self->size) / sizeof({{NAME}}_node_t*))
+    {
+        free(stream.buffer);
+        free(buffer);
+        return false;
+    }
+
+    const size_t count = (size_t) header.count;
+    stream.remaining = header.length;
+
+    // Neither the count nor the length is trusted until the checksum matches; therefore, the array only grows as the entries arrive.
+    {{NAME}}_node_t** fresh = NULL;
+    size_t capacity = 0;
+    size_t loaded = 0;
+    bool ok = true;
+
+    while (ok && loaded < count)
+    {
+        {{NAME}}_packed_block_t block;
+        ok = snapshot_get(&stream, &block, sizeof(block))
+             && block.count > 0 && block.count <= PACKED_BLOCK && block.count <= count - loaded
+             && block.key_width <= 64 && block.value_width <= 64;
+
+        if (false == ok)
         {
-            {{NAME}}_removeFirst(self);
+            break;
+        }
+
+        // Unpack the key differences, and then sum them up, starting from the first key.
+        const size_t key_words = packed_words(block.count - 1, block.key_width);
+        const size_t value_words = packed_words(block.count, block.value_width);
+        ok = snapshot_get(&stream, buffer->words, key_words * sizeof(uint64_t));
+        packed_decode(buffer->words, block.count - 1, block.key_width, buffer->keys + 1);
+        ok = ok && snapshot_get(&stream, buffer->words, value_words * sizeof(uint64_t));
+        packed_decode(buffer->words, block.count, block.value_width, buffer->values);
+
+        buffer->keys[0] = block.first_key;
+
+        for (size_t i = 1; i < block.count; i++)
+        {
+            buffer->keys[i] += buffer->keys[i - 1];
+        }
+
+        for (size_t i = 0; ok && i < block.count; i++)
+        {
+            {{NAME}}_node_t* node = snapshot_reserve(&fresh, &capacity, loaded, count) ? self->allocator->allocate(self->allocator) : NULL;
+
+            if (NULL == node)
+            {
+                ok = false;
+                break;
+            }
+
+            node->key = ({{KEY_TYPE}}) (int64_t) buffer->keys[i];
+            node->value = ({{VALUE_TYPE}}) (int64_t) (buffer->values[i] + block.value_base);
+            node->height = 0;
+            node->size = 1;
+            node->left = NULL;
+            node->right = NULL;
+            fresh[loaded++] = node;
         }
     }
-    {{NAME}}_iter_free(&iter);
+
+    // The checksum must match, before the tree is modified.
+    uint64_t checksum = 0;
+    ok = ok && 0 == stream.remaining && stream.position == stream.length;
+    ok = ok && snapshot_read_fully(fd, &checksum, sizeof(checksum)) && checksum == stream.checksum;
+    ok = ok && snapshot_attach(self, &fresh, count);
+
+    if (false == ok)
+    {
+        while (loaded > 0)
+        {
+            self->allocator->release(self->allocator, fresh[--loaded]);
+        }
+    }
+
+    free(stream.buffer);
+    free(buffer);
+    free(fresh);
+    return ok;
 }
+{% end %}
 
+{% if SUBTREE_HASH %}
 /**
- * @brief Checks if a specific key exists in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to check for existence.
- * @return true if the key exists, false otherwise.
+ * Counts and hashes the entries, whose keys are less than a bound (or all of the entries, if the bound is NULL).
  */
-bool {{NAME}}_containsKey ({{NAME}}_t* self, {{KEY_TYPE}} key)
+static void hash_below ({{NAME}}_t* self, {{KEY_TYPE}}* bound, size_t* count, uint64_t* hash)
 {
-    return NULL != find_node(self, self->root, &key);
+    if (NULL == bound)
+    {
+        *count = size_of(self->root);
+        *hash = hash_of(self->root);
+        return;
+    }
+
+    *count = 0;
+    *hash = 0;
+
+    for ({{NAME}}_node_t* node = self->root; NULL != node;)
+    {
+        if (self->comparator(self, &node->key, bound) < 0)
+        {
+            // The node and its left subtree are below the bound.
+            *count += size_of(node->left) + 1;
+            *hash += hash_of(node) - hash_of(node->right);
+            node = node->right;
+        }
+        else
+        {
+            node = node->left;
+        }
+    }
 }
 
 /**
- * @brief Checks if the current tree contains all elements of another tree.
- * @param self Pointer to the AVL tree.
- * @param other Pointer to the other AVL tree.
- * @return true if all keys in other are present in self, false otherwise.
+ * Counts and hashes the entries, whose keys are in a half-open range, where NULL means unbounded.
  */
-bool {{NAME}}_containsValue ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+static void hash_between ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi, size_t* count, uint64_t* hash)
 {
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    if (NULL != lo && NULL != hi && self->comparator(self, lo, hi) >= 0)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
-        {
-            {{NAME}}_iter_next(&iter);
+        *count = 0;
+        *hash = 0;
+        return;
+    }
 
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+    hash_below(self, hi, count, hash);
 
-            if (predicate(self, node, context))
-            {
-                return true;
-            }
-        }
+    if (NULL != lo)
+    {
+        size_t lower_count;
+        uint64_t lower_hash;
+        hash_below(self, lo, &lower_count, &lower_hash);
+        *count -= lower_count;
+        *hash -= lower_hash;
     }
-    {{NAME}}_iter_free(&iter);
-    return false;
 }
 
+typedef struct
+{
+    {{NAME}}_t* self;
+
+    {{NAME}}_t* other;
+
+    size_t leaf_size;
+
+    bool (*callback)({{NAME}}_t*, {{KEY_TYPE}}*, {{KEY_TYPE}}*, void*);
+
+    void* context;
+
+} {{NAME}}_mismatch_t;
+
 /**
- * @brief Inserts a node with a specified key and returns the inserted node.
- * @param self Pointer to the AVL tree.
- * @param key Key for the node to insert.
- * @return Pointer to the created node.
+ * Reports the mismatched parts of a range, after splitting it at the median key of the tree,
+ * which has more entries in the range, until the parts are small enough.
  */
-{{NAME}}_node_t* {{NAME}}_putNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+static bool mismatch_range ({{NAME}}_mismatch_t* search, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi)
 {
-    {{NAME}}_node_t* root = insert_node(self, self->root, &key);
-    if (NULL == root)
+    size_t count;
+    uint64_t hash;
+    hash_between(search->self, lo, hi, &count, &hash);
+
+    size_t other_count;
+    uint64_t other_hash;
+    hash_between(search->other, lo, hi, &other_count, &other_hash);
+
+    if (count == other_count && hash == other_hash)
     {
-        return NULL;
+        return true;
     }
-    else
+    else if (count + other_count <= search->leaf_size || (count < 2 && other_count < 2))
     {
-        self->root = root;
-        return find_node(self, self->root, &key); // TODO: improve performance
+        return search->callback(search->self, lo, hi, search->context);
+    }
+
+    // The larger side has at least two entries in the range, so that both parts become smaller.
+    {{NAME}}_t* larger = count >= other_count ? search->self : search->other;
+    const size_t larger_count = count >= other_count ? count : other_count;
+
+    size_t first = 0;
+    uint64_t ignored;
+
+    if (NULL != lo)
+    {
+        hash_below(larger, lo, &first, &ignored);
     }
+
+    {{KEY_TYPE}} middle = {{NAME}}_nthNode(larger, first + larger_count / 2)->key;
+
+    return mismatch_range(search, lo, &middle) && mismatch_range(search, &middle, hi);
+}
+
+static void rehash_nodes ({{NAME}}_node_t* node)
+{
+    if (NULL != node)
+    {
+        rehash_nodes(node->left);
+        rehash_nodes(node->right);
+        update_size(node);
+    }
+}
+
+/**
+ * @brief Computes the hash of a single entry, which is the unit of the subtree hashes.
+ * @param key Key of the entry.
+ * @param value Data value of the entry.
+ * @return Hash of the bytes of the key and the value (pointers are hashed by address).
+ */
+uint64_t {{NAME}}_hashEntry ({{KEY_TYPE}} key, {{VALUE_TYPE}} value)
+{
+    return hash_entry(&key, &value);
+}
+
+/**
+ * @brief Retrieves the hash of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Hash of the tree, which is zero, if the tree is empty.
+ */
+uint64_t {{NAME}}_hash ({{NAME}}_t* self)
+{
+    return hash_of(self->root);
 }
 
 /**
- * @brief Retrieves a node by its key.
+ * @brief Computes the hash of the entries, whose keys are in a half-open range, in logarithmic time.
  * @param self Pointer to the AVL tree.
- * @param key Key of the node to find.
- * @return Pointer to the found node or NULL if not found.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Hash of the entries in the range.
  */
-{{NAME}}_node_t* {{NAME}}_getNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+uint64_t {{NAME}}_hashRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi)
 {
-    return find_node(self, self->root, &key);
+    size_t count;
+    uint64_t hash;
+    hash_between(self, lo, hi, &count, &hash);
+    return hash;
 }
 
 /**
- * @brief Retrieves the root node of the AVL tree.
+ * @brief Finds the key ranges, where two AVL trees differ, by descending only into mismatched ranges.
  * @param self Pointer to the AVL tree.
- * @return Pointer to the root node.
- */
-{{NAME}}_node_t* {{NAME}}_rootNode ({{NAME}}_t* self)
+ * @param other Pointer to the other AVL tree, which must use the same comparator.
+ * @param leaf_size Largest number of entries (in both trees together) of a reported range.
+ * @param callback Function that receives each range as an inclusive lower bound and an exclusive upper bound,
+ *                 where NULL means unbounded, and returns false to stop the search.
+ * @param context User-defined context for the callback.
+ * @return true if the search completed, false if the callback stopped it.
+ */
+bool {{NAME}}_mismatches ({{NAME}}_t* self, {{NAME}}_t* other, size_t leaf_size, bool (*callback)({{NAME}}_t*, {{KEY_TYPE}}*, {{KEY_TYPE}}*, void*), void* context)
 {
-    return self->root;
+    {{NAME}}_mismatch_t search;
+    search.self = self;
+    search.other = other;
+    search.leaf_size = leaf_size;
+    search.callback = callback;
+    search.context = context;
+    return mismatch_range(&search, NULL, NULL);
 }
 
 /**
- * @brief Retrieves the first node (minimum key) of the AVL tree.
+ * @brief Recomputes the hashes of all of the subtrees in linear time.
  * @param self Pointer to the AVL tree.
- * @return Pointer to the first node or NULL if the tree is empty.
  */
-{{NAME}}_node_t* {{NAME}}_firstNode ({{NAME}}_t* self)
+void {{NAME}}_rehash ({{NAME}}_t* self)
 {
-    {{NAME}}_node_t* p = self->root;
-
-    if (NULL == p)
-    {
-        return NULL;
-    }
-    else
-    {
-        while (true)
-        {
-            if (NULL == p->left)
-            {
-                return p;
-            }
-            else
-            {
-                p = p->left;
-            }
-        }
-    }
+    rehash_nodes(self->root);
 }
+{% end %}
+
+{% if DISK %}
+#define DISK_MAGIC "TREEDSK1"
+#define DISK_VERSION 1
+#define DISK_PAGE_SIZE 4096
+#define DISK_LEAF 1
+#define DISK_INNER 2
 
 /**
- * @brief Retrieves the last node (maximum key) of the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Pointer to the last node or NULL if the tree is empty.
+ * Smallest number of pages in the cache. An insertion pins at most three pages at once.
  */
-{{NAME}}_node_t* {{NAME}}_lastNode ({{NAME}}_t* self)
+#define DISK_MIN_CACHE_PAGES 8
+
+/**
+ * Largest number of keys that getMany() looks up together. A batch pins at most a quarter of the cache.
+ */
+#define DISK_BATCH 1024
+
+/**
+ * Number of threads that read pages, when io_uring is not used.
+ */
+#define DISK_READERS 8
+{% if IO_URING %}
+
+/**
+ * Number of entries of the submission queue, which bounds the number of reads in flight.
+ */
+#define DISK_RING_ENTRIES 256
+{% end %}
+
+/**
+ * Layout of the header, which is stored at the start of page zero.
+ */
+typedef struct
 {
-    {{NAME}}_node_t* p = self->root;
+    char magic[8];
 
-    if (NULL == p)
-    {
-        return NULL;
-    }
-    else
-    {
-        while (true)
-        {
-            if (NULL == p->right)
-            {
-                return p;
-            }
-            else
-            {
-                p = p->right;
-            }
-        }
-    }
-}
+    uint32_t version;
+
+    uint32_t byte_order;
+
+    uint32_t key_size;
+
+    uint32_t value_size;
+
+    uint32_t page_size;
+
+    /**
+     * Number of levels of the tree, which is zero if the tree has no pages yet.
+     */
+    uint32_t height;
+
+    uint64_t root;
+
+    uint64_t first_leaf;
+
+    uint64_t count;
+
+    uint64_t page_count;
+
+} {{NAME}}_disk_header_t;
 
 /**
- * @brief Finds the successor node (next higher key) of a given key.
- * @param self Pointer to the AVL tree.
- * @param key Key for which to find the higher node.
- * @return Pointer to the higher node or NULL if not found.
+ * Layout of the start of a page. A leaf page continues with an array of keys and an array of values.
+ * An inner page continues with an array of keys and an array of child page numbers, which has one more element.
+ * In an inner page, key i is the smallest key in the subtree of child i + 1.
  */
-{{NAME}}_node_t* {{NAME}}_higherNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+typedef struct
 {
-    {{NAME}}_node_t* current = self->root;
-    {{NAME}}_node_t* successor = NULL;
+    uint32_t kind;
 
-    while (current != NULL)
-    {
-        if (self->comparator(self, &key, &current->key) < 0)
-        {
-            // Update successor and go left
-            successor = current;
-            current = current->left;
-        }
-        else
-        {
-            // Go right
-            current = current->right;
-        }
-    }
+    uint32_t count;
 
-    return successor;
+    /**
+     * Number of the next leaf page in key order, or zero for the last leaf page (and for inner pages).
+     */
+    uint64_t next;
 
-}
+} {{NAME}}_disk_page_t;
 
 /**
- * @brief Finds the predecessor node (next lower key) of a given key.
- * @param self Pointer to the AVL tree.
- * @param key Key for which to find the lower node.
- * @return Pointer to the lower node or NULL if not found.
+ * State of a slot in the page cache.
  */
-{{NAME}}_node_t* {{NAME}}_lowerNode ({{NAME}}_t* self, {{KEY_TYPE}} key)
+typedef struct
 {
-    {{NAME}}_node_t* current = self->root;
-    {{NAME}}_node_t* predecessor = NULL;
+    /**
+     * Number of the cached page, or zero if the slot is free (the header page is never cached).
+     */
+    uint64_t page;
 
-    // Traverse the tree to find the lower node
-    while (current != NULL)
-    {
-        if (self->comparator(self, &key, &current->key) <= 0)
-        {
-            // Move left; we need to find a smaller key
-            current = current->left;
-        }
-        else
-        {
-            // Current key is smaller than the searched key
-            // This could be a candidate for lower node
-            predecessor = current;
-            // Move right to find larger keys
-            current = current->right;
-        }
-    }
+    uint32_t pins;
 
-    return predecessor;
-}
+    bool dirty;
 
-static {{NAME}}_node_t* find_nth (size_t prior, {{NAME}}_node_t* node, size_t index)
+    /**
+     * Set on every access, and cleared when the clock hand passes the slot.
+     */
+    bool referenced;
+
+    /**
+     * Number of the last batch, which pinned this slot.
+     */
+    uint64_t batch;
+
+} {{NAME}}_disk_frame_t;
+
+/**
+ * A page read, which is part of a batch.
+ */
+typedef struct
 {
-    if (NULL == node)
-    {
-        return NULL; // Base case: If the node is null, return null.
-    }
+    uint64_t page;
 
-    // Get the size of the left subtree.
-    const size_t left_size = size_of(node->left);
+    size_t frame;
 
-    if (prior + left_size == index)
-    {
-        // If prior + left_size matches the index, we've found the nth node.
-        return node;
-    }
-    else if (prior + left_size > index)
-    {
-        // If the index is less than the size of the left subtree,
-        // we need to search in the left subtree.
-        return find_nth(prior, node->left, index);
-    }
-    else
-    {
-        // If the index is greater, we search in the right subtree.
-        // Update the prior value to include the current node and left subtree size.
-        return find_nth(prior + left_size + 1, node->right, index);
-    }
-}
+    bool done;
+
+    bool ok;
+
+} {{NAME}}_disk_read_t;
+{% if IO_URING %}
 
 /**
- * @brief Finds the nth node (0-based index) in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param index The index of the node to find.
- * @return Pointer to the nth node or NULL if not found.
+ * An io_uring instance, which is set up using the raw system calls, since liburing is not required.
  */
-{{NAME}}_node_t* {{NAME}}_nthNode ({{NAME}}_t* self, size_t index)
+typedef struct
+{
+    int fd;
+
+    unsigned entries;
+
+    void* sq_ring;
+
+    size_t sq_length;
+
+    void* cq_ring;
+
+    size_t cq_length;
+
+    struct io_uring_sqe* sqes;
+
+    size_t sqes_length;
+
+    unsigned* sq_head;
+
+    unsigned* sq_tail;
+
+    unsigned* sq_mask;
+
+    unsigned* sq_array;
+
+    unsigned* cq_head;
+
+    unsigned* cq_tail;
+
+    unsigned* cq_mask;
+
+    struct io_uring_cqe* cqes;
+
+} {{NAME}}_disk_ring_t;
+{% end %}
+
+struct {{NAME}}_disk
+{
+    int fd;
+
+    {{NAME}}_comparator_t comparator;
+
+    {{NAME}}_disk_header_t header;
+
+    size_t leaf_capacity;
+
+    size_t inner_capacity;
+
+    /**
+     * Offset of the values in a leaf page, and of the children in an inner page, which are suitably aligned.
+     */
+    size_t values_offset;
+
+    size_t children_offset;
+
+    size_t frame_count;
+
+    {{NAME}}_disk_frame_t* frames;
+
+    unsigned char* data;
+
+    /**
+     * Open addressing hash table with linear probing, which maps page numbers to frames (plus one, so zero is empty).
+     */
+    uint32_t* table;
+
+    size_t table_mask;
+
+    unsigned table_shift;
+
+    size_t hand;
+
+    bool failed;
+
+    {{NAME}}_disk_stats_t stats;
+
+    pthread_mutex_t read_mutex;
+
+    /**
+     * Signals the reader threads, when a batch of reads is available.
+     */
+    pthread_cond_t read_start;
+
+    /**
+     * Signals the thread, which waits for a batch of reads, when all of them are done.
+     */
+    pthread_cond_t read_done;
+
+    pthread_t readers[DISK_READERS];
+
+    size_t reader_count;
+
+    {{NAME}}_disk_read_t* read_jobs;
+
+    size_t read_count;
+
+    size_t read_next;
+
+    size_t read_pending;
+
+    bool read_stopping;
+
+    /**
+     * Number of the last batch of getMany().
+     */
+    uint64_t batch;
+{% if IO_URING %}
+
+    {{NAME}}_disk_ring_t ring;
+
+    bool use_ring;
+{% end %}
+
+};
+
+static size_t disk_align (size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static {{KEY_TYPE}}* disk_keys ({{NAME}}_disk_page_t* page)
+{
+    return ({{KEY_TYPE}}*) ((unsigned char*) page + sizeof({{NAME}}_disk_page_t));
+}
+
+static {{VALUE_TYPE}}* disk_values ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* page)
+{
+    return ({{VALUE_TYPE}}*) ((unsigned char*) page + self->values_offset);
+}
+
+static uint64_t* disk_children ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* page)
 {
-    return find_nth(0, self->root, index);
+    return (uint64_t*) ((unsigned char*) page + self->children_offset);
 }
 
-{% if DEQUE %}
+static size_t disk_frame_of ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* page)
+{
+    return (size_t) ((unsigned char*) page - self->data) / DISK_PAGE_SIZE;
+}
 
-/**
- * @brief Adds a value as the first element in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param value Data value to add.
- * @return true if the addition was successful, false otherwise.
- */
-bool {{NAME}}_addFirst ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+static uint64_t disk_number_of ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* page)
 {
-    return {{NAME}}_pushFirst(self, value);
+    return self->frames[disk_frame_of(self, page)].page;
 }
 
-/**
- * @brief Adds a value as the last element in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param value Data value to add.
- * @return true if the addition was successful, false otherwise.
- */
-bool {{NAME}}_addLast ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+static size_t disk_home ({{NAME}}_disk_t* self, uint64_t page)
 {
-    return {{NAME}}_pushLast(self, value);
+    return (size_t) ((page * UINT64_C(0x9E3779B97F4A7C15)) >> self->table_shift);
 }
 
 /**
- * @brief Pushes a value to the front of the AVL tree (Deque operation).
- * @param self Pointer to the AVL tree.
- * @param value Data value to push.
- * @return true if the push was successful, false otherwise.
+ * Finds the slot of the hash table, which holds a page, or the empty slot, where the page would be inserted.
  */
-bool {{NAME}}_pushFirst ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+static size_t disk_slot ({{NAME}}_disk_t* self, uint64_t page)
 {
-    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+    size_t slot = disk_home(self, page);
 
-    if (NULL == node)
-    {
-        return {{NAME}}_put(self, 0, value);
-    }
-    else
+    while (0 != self->table[slot] && self->frames[self->table[slot] - 1].page != page)
     {
-        return {{NAME}}_put(self, node->key - 1, value);
+        slot = (slot + 1) & self->table_mask;
     }
+
+    return slot;
 }
 
 /**
- * @brief Pushes a value to the end of the AVL tree (Deque operation).
- * @param self Pointer to the AVL tree.
- * @param value Data value to push.
- * @return true if the push was successful, false otherwise.
+ * Removes a page from the hash table, and then shifts the following entries back into the gap,
+ * so that no probe sequence is broken (which avoids tombstones).
  */
-bool {{NAME}}_pushLast ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+static void disk_unmap ({{NAME}}_disk_t* self, uint64_t page)
 {
-    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+    size_t gap = disk_slot(self, page);
+    self->table[gap] = 0;
 
-    if (NULL == node)
+    for (size_t slot = (gap + 1) & self->table_mask; 0 != self->table[slot]; slot = (slot + 1) & self->table_mask)
     {
-        return {{NAME}}_put(self, 0, value);
+        const size_t home = disk_home(self, self->frames[self->table[slot] - 1].page);
+
+        // The entry may move into the gap, unless its home lies cyclically in (gap, slot].
+        const bool stays = gap <= slot ? (gap < home && home <= slot) : (gap < home || home <= slot);
+
+        if (false == stays)
+        {
+            self->table[gap] = self->table[slot];
+            self->table[slot] = 0;
+            gap = slot;
+        }
     }
-    else
+}
+
+static bool disk_write_page ({{NAME}}_disk_t* self, size_t frame)
+{
+    const ssize_t written = pwrite(self->fd, self->data + frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (self->frames[frame].page * DISK_PAGE_SIZE));
+
+    if (DISK_PAGE_SIZE != written)
     {
-        return {{NAME}}_put(self, node->key + 1, value);
+        self->failed = true;
+        return false;
     }
+
+    self->frames[frame].dirty = false;
+    ++self->stats.writes;
+    return true;
 }
 
 /**
- * @brief Pushes a value to the AVL tree (equivalent to pushLast).
- * @param self Pointer to the AVL tree.
- * @param value Data value to push.
- * @return true if the push was successful, false otherwise.
+ * Advances the clock hand to an unpinned slot, whose page has not been accessed since the hand passed it last.
+ * A dirty page is written back, before its slot is returned.
  */
-bool {{NAME}}_push ({{NAME}}_t* self, {{VALUE_TYPE}} value)
+static bool disk_victim ({{NAME}}_disk_t* self, size_t* victim)
 {
-    return {{NAME}}_pushLast(self, value);
-}
+    for (size_t step = 0; step < 2 * self->frame_count; step++)
+    {
+        const size_t frame = self->hand;
+        self->hand = (self->hand + 1) % self->frame_count;
 
-{% end %}
+        if (self->frames[frame].pins > 0)
+        {
+            continue;
+        }
+        else if (0 == self->frames[frame].page)
+        {
+            *victim = frame;
+            return true;
+        }
+        else if (self->frames[frame].referenced)
+        {
+            self->frames[frame].referenced = false;
+            continue;
+        }
+        else if (self->frames[frame].dirty && false == disk_write_page(self, frame))
+        {
+            return false;
+        }
 
-/**
- * @brief Peeks at the last value in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
- */
-{{VALUE_TYPE}} {{NAME}}_peek ({{NAME}}_t* self)
-{
-    return {{NAME}}_peekLast(self);
+        disk_unmap(self, self->frames[frame].page);
+        self->frames[frame].page = 0;
+        ++self->stats.evictions;
+        *victim = frame;
+        return true;
+    }
+
+    // Every slot is pinned.
+    return false;
 }
 
 /**
- * @brief Peeks at the first value in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return First data value in the tree or default value if empty.
+ * Pins a page in the cache, after reading it (unless it is a fresh page, which is zeroed instead).
  */
-{{VALUE_TYPE}} {{NAME}}_peekFirst ({{NAME}}_t* self)
+static {{NAME}}_disk_page_t* disk_fetch ({{NAME}}_disk_t* self, uint64_t page, bool fresh)
 {
-    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+    const size_t slot = disk_slot(self, page);
 
-    if (NULL == node)
+    if (0 != self->table[slot])
     {
-        return {{NAME}}_defaultValue();
+        const size_t frame = self->table[slot] - 1;
+        ++self->frames[frame].pins;
+        self->frames[frame].referenced = true;
+        ++self->stats.hits;
+        return ({{NAME}}_disk_page_t*) (self->data + frame * DISK_PAGE_SIZE);
     }
-    else
+
+    ++self->stats.misses;
+
+    size_t frame;
+
+    if (false == disk_victim(self, &frame))
     {
-        return node->value;
+        return NULL;
     }
-}
 
-/**
- * @brief Peeks at the last value in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
- */
-{{VALUE_TYPE}} {{NAME}}_peekLast ({{NAME}}_t* self)
-{
-    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+    unsigned char* data = self->data + frame * DISK_PAGE_SIZE;
 
-    if (NULL == node)
+    if (fresh)
     {
-        return {{NAME}}_defaultValue();
+        memset(data, 0, DISK_PAGE_SIZE);
+    }
+    else if (DISK_PAGE_SIZE != pread(self->fd, data, DISK_PAGE_SIZE, (off_t) (page * DISK_PAGE_SIZE)))
+    {
+        self->failed = true;
+        return NULL;
     }
     else
     {
-        return node->value;
+        ++self->stats.reads;
     }
+
+    // The eviction may have moved entries of the hash table; therefore, the slot is looked up again.
+    self->table[disk_slot(self, page)] = (uint32_t) frame + 1;
+    self->frames[frame].page = page;
+    self->frames[frame].pins = 1;
+    self->frames[frame].dirty = fresh;
+    self->frames[frame].referenced = true;
+    return ({{NAME}}_disk_page_t*) data;
 }
 
-/**
- * @brief Pops the last value from the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
- */
-{{VALUE_TYPE}} {{NAME}}_pop ({{NAME}}_t* self)
+static void disk_release ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* page, bool dirty)
 {
-    return {{NAME}}_popLast(self);
+    {{NAME}}_disk_frame_t* frame = self->frames + disk_frame_of(self, page);
+    frame->dirty = frame->dirty || dirty;
+    --frame->pins;
 }
 
 /**
- * @brief Pops the first value from the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return First data value in the tree or default value if empty.
+ * Appends a new, empty page to the file, which is pinned in the cache.
  */
-{{VALUE_TYPE}} {{NAME}}_popFirst ({{NAME}}_t* self)
+static {{NAME}}_disk_page_t* disk_allocate ({{NAME}}_disk_t* self, uint32_t kind)
 {
-    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+    {{NAME}}_disk_page_t* page = disk_fetch(self, self->header.page_count, true);
 
-    if (NULL == node)
-    {
-        return {{NAME}}_defaultValue();
-    }
-    else
+    if (NULL != page)
     {
-        {{VALUE_TYPE}} value = node->value;
-        {{NAME}}_removeFirst(self);
-        return value;
+        ++self->header.page_count;
+        page->kind = kind;
     }
+
+    return page;
 }
 
 /**
- * @brief Pops the last value from the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Last data value in the tree or default value if empty.
+ * Finds the index of the first key in a page, which is not less than a given key (if upper is false),
+ * or which is greater than the given key (if upper is true).
  */
-{{VALUE_TYPE}} {{NAME}}_popLast ({{NAME}}_t* self)
+static size_t disk_search ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* page, {{KEY_TYPE}}* key, bool upper)
 {
-    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+    {{KEY_TYPE}}* keys = disk_keys(page);
+    size_t lo = 0;
+    size_t hi = page->count;
 
-    if (NULL == node)
-    {
-        return {{NAME}}_defaultValue();
-    }
-    else
+    while (lo < hi)
     {
-        {{VALUE_TYPE}} value = node->value;
-        {{NAME}}_removeLast(self);
-        return value;
+        const size_t middle = lo + (hi - lo) / 2;
+        const int cmp = self->comparator(NULL, &keys[middle], key);
+
+        if (cmp < 0 || (upper && 0 == cmp))
+        {
+            lo = middle + 1;
+        }
+        else
+        {
+            hi = middle;
+        }
     }
+
+    return lo;
 }
 
-bool {{NAME}}_containsAll ({{NAME}}_t* self, {{NAME}}_t* other)
+/**
+ * Descends from the root to the leaf page, which would hold a key, without modifying any pages.
+ * Returns NULL if the tree has no pages yet, or if a page could not be read.
+ */
+static {{NAME}}_disk_page_t* disk_find_leaf ({{NAME}}_disk_t* self, {{KEY_TYPE}}* key)
 {
-    if ({{NAME}}_size(self) < {{NAME}}_size(other))
+    if (0 == self->header.root)
     {
-        return false;
+        return NULL;
     }
 
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(other);
+    {{NAME}}_disk_page_t* page = disk_fetch(self, self->header.root, false);
+
+    while (NULL != page && DISK_INNER == page->kind)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
-        {
-            {{NAME}}_iter_next(&iter);
+        const uint64_t child = disk_children(self, page)[disk_search(self, page, key, true)];
+        disk_release(self, page, false);
+        page = disk_fetch(self, child, false);
+    }
 
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+    return page;
+}
 
-            if ({{NAME}}_containsKey(self, node->key) == false)
-            {
-                return false;
-            }
-        }
-    }
-    {{NAME}}_iter_free(&iter);
-    return true;
+static bool disk_full ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* page)
+{
+    return page->count == (DISK_LEAF == page->kind ? self->leaf_capacity : self->inner_capacity);
 }
 
 /**
- * @brief Copies keys from the tree into an array.
- * @param self Pointer to the AVL tree.
- * @param array Array to store keys.
- * @param array_size Size of the provided array.
- * @return Number of keys copied into the array.
+ * Splits a full child of a page, which is not full, by moving the upper half of the child into a new page.
+ * Returns the new page, which is pinned, or NULL if it could not be allocated.
  */
-size_t {{NAME}}_keysToArray ({{NAME}}_t* self, {{KEY_TYPE}}* array, size_t array_size)
+static {{NAME}}_disk_page_t* disk_split ({{NAME}}_disk_t* self, {{NAME}}_disk_page_t* parent, size_t index, {{NAME}}_disk_page_t* child)
 {
-    size_t count = 0;
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {{NAME}}_disk_page_t* sibling = disk_allocate(self, child->kind);
+
+    if (NULL == sibling)
     {
-        for (count = 0; {{NAME}}_iter_hasNext(&iter) && (count < array_size); count++)
-        {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            array[count] = node->key;
-        }
+        return NULL;
     }
-    {{NAME}}_iter_free(&iter);
-    return count;
+
+    const size_t middle = child->count / 2;
+    {{KEY_TYPE}} separator;
+
+    if (DISK_LEAF == child->kind)
+    {
+        sibling->count = child->count - middle;
+        memcpy(disk_keys(sibling), disk_keys(child) + middle, sibling->count * sizeof({{KEY_TYPE}}));
+        memcpy(disk_values(self, sibling), disk_values(self, child) + middle, sibling->count * sizeof({{VALUE_TYPE}}));
+        sibling->next = child->next;
+        child->next = disk_number_of(self, sibling);
+        separator = disk_keys(sibling)[0];
+    }
+    else
+    {
+        // The middle key moves up into the parent.
+        sibling->count = child->count - middle - 1;
+        memcpy(disk_keys(sibling), disk_keys(child) + middle + 1, sibling->count * sizeof({{KEY_TYPE}}));
+        memcpy(disk_children(self, sibling), disk_children(self, child) + middle + 1, (sibling->count + 1) * sizeof(uint64_t));
+        separator = disk_keys(child)[middle];
+    }
+
+    child->count = (uint32_t) middle;
+
+    {{KEY_TYPE}}* keys = disk_keys(parent);
+    uint64_t* children = disk_children(self, parent);
+    memmove(keys + index + 1, keys + index, (parent->count - index) * sizeof({{KEY_TYPE}}));
+    memmove(children + index + 2, children + index + 1, (parent->count - index) * sizeof(uint64_t));
+    keys[index] = separator;
+    children[index + 1] = disk_number_of(self, sibling);
+    ++parent->count;
+
+    self->frames[disk_frame_of(self, parent)].dirty = true;
+    self->frames[disk_frame_of(self, child)].dirty = true;
+    self->frames[disk_frame_of(self, sibling)].dirty = true;
+    return sibling;
 }
 
 /**
- * @brief Copies values from the tree into an array.
- * @param self Pointer to the AVL tree.
- * @param array Array to store values.
- * @param array_size Size of the provided array.
- * @return Number of values copied into the array.
+ * Descends from the root to the leaf page, which should hold a key, while splitting every full page on the way,
+ * so that there is always room for a separator in the parent. The returned leaf page is pinned and not full.
  */
-size_t {{NAME}}_valuesToArray ({{NAME}}_t* self, {{VALUE_TYPE}}* array, size_t array_size)
+static {{NAME}}_disk_page_t* disk_prepare_leaf ({{NAME}}_disk_t* self, {{KEY_TYPE}}* key)
 {
-    size_t count = 0;
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    if (0 == self->header.root)
     {
-        for (count = 0; {{NAME}}_iter_hasNext(&iter) && (count < array_size); count++)
+        {{NAME}}_disk_page_t* leaf = disk_allocate(self, DISK_LEAF);
+
+        if (NULL != leaf)
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            array[count] = node->value;
+            self->header.root = disk_number_of(self, leaf);
+            self->header.first_leaf = self->header.root;
+            self->header.height = 1;
         }
+
+        return leaf;
     }
-    {{NAME}}_iter_free(&iter);
-    return count;
-}
 
-/**
- * @brief Allocates a new array and copies the keys from the tree into it.
- * @param self Pointer to the AVL tree.
- * @return Pointer to the newly allocated array of keys or NULL if empty.
- */
-{{KEY_TYPE}}* {{NAME}}_keysToNewArray ({{NAME}}_t* self)
-{
-    if (NULL == self)
+    {{NAME}}_disk_page_t* page = disk_fetch(self, self->header.root, false);
+
+    if (NULL != page && disk_full(self, page))
     {
-        return NULL;
+        // The tree grows at the root.
+        {{NAME}}_disk_page_t* root = disk_allocate(self, DISK_INNER);
+
+        if (NULL == root)
+        {
+            disk_release(self, page, false);
+            return NULL;
+        }
+
+        disk_children(self, root)[0] = self->header.root;
+        {{NAME}}_disk_page_t* sibling = disk_split(self, root, 0, page);
+        disk_release(self, page, false);
+
+        if (NULL == sibling)
+        {
+            // The new root is unreachable, which wastes a page, but leaves the tree intact.
+            disk_release(self, root, false);
+            return NULL;
+        }
+
+        disk_release(self, sibling, false);
+        self->header.root = disk_number_of(self, root);
+        ++self->header.height;
+        page = root;
     }
-    else if ({{NAME}}_isEmpty(self))
+
+    while (NULL != page && DISK_INNER == page->kind)
     {
-        return NULL;
+        const size_t index = disk_search(self, page, key, true);
+        {{NAME}}_disk_page_t* child = disk_fetch(self, disk_children(self, page)[index], false);
+
+        if (NULL != child && disk_full(self, child))
+        {
+            {{NAME}}_disk_page_t* sibling = disk_split(self, page, index, child);
+
+            if (NULL == sibling)
+            {
+                disk_release(self, child, false);
+                child = NULL;
+            }
+            else if (self->comparator(NULL, key, &disk_keys(page)[index]) >= 0)
+            {
+                // The key belongs to the upper half, which moved into the new page.
+                disk_release(self, child, false);
+                child = sibling;
+            }
+            else
+            {
+                disk_release(self, sibling, false);
+            }
+        }
+
+        disk_release(self, page, false);
+        page = child;
     }
 
-    size_t size = {{NAME}}_size(self);
+    return page;
+}
 
-    {{KEY_TYPE}}* array = ({{KEY_TYPE}}*) calloc(size, sizeof({{KEY_TYPE}}));
+static bool disk_lookup ({{NAME}}_disk_t* self, {{KEY_TYPE}}* key, {{VALUE_TYPE}}* value)
+{
+    {{NAME}}_disk_page_t* leaf = disk_find_leaf(self, key);
 
-    if (NULL == array)
+    if (NULL == leaf)
     {
-        return NULL;
+        return false;
     }
-    else
+
+    const size_t index = disk_search(self, leaf, key, false);
+    const bool found = index < leaf->count && 0 == self->comparator(NULL, &disk_keys(leaf)[index], key);
+
+    if (found && NULL != value)
     {
-        {{NAME}}_keysToArray(self, array, size);
-        return array;
+        *value = disk_values(self, leaf)[index];
     }
+
+    disk_release(self, leaf, false);
+    return found;
 }
 
 /**
- * @brief Allocates a new array and copies the values from the tree into it.
- * @param self Pointer to the AVL tree.
- * @return Pointer to the newly allocated array of values or NULL if empty.
+ * Moves an iterator past the leaf pages, which have no more entries.
  */
-{{VALUE_TYPE}}* {{NAME}}_valuesToNewArray ({{NAME}}_t* self)
+static void disk_iter_settle ({{NAME}}_disk_iterator_t* self)
 {
-    if (NULL == self)
+    while (0 != self->page)
     {
-        return NULL;
+        {{NAME}}_disk_page_t* leaf = disk_fetch(self->owner, self->page, false);
+
+        if (NULL == leaf)
+        {
+            self->page = 0;
+            return;
+        }
+
+        const bool done = self->index >= leaf->count;
+        const uint64_t next = leaf->next;
+        disk_release(self->owner, leaf, false);
+
+        if (false == done)
+        {
+            return;
+        }
+
+        self->page = next;
+        self->index = 0;
     }
-    else if ({{NAME}}_isEmpty(self))
+}
+
+{% if IO_URING %}
+static bool disk_ring_setup ({{NAME}}_disk_ring_t* ring)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof({{NAME}}_disk_ring_t));
+    ring->fd = (int) syscall(__NR_io_uring_setup, DISK_RING_ENTRIES, &params);
+
+    if (ring->fd < 0)
     {
-        return NULL;
+        ring->fd = -1;
+        return false;
     }
 
-    size_t size = {{NAME}}_size(self);
-
-    {{VALUE_TYPE}}* array = ({{VALUE_TYPE}}*) calloc(size, sizeof({{VALUE_TYPE}}));
+    ring->entries = params.sq_entries;
+    ring->sq_length = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_length = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_length = params.sq_entries * sizeof(struct io_uring_sqe);
 
-    if (NULL == array)
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
     {
-        return NULL;
+        // Both rings share a single mapping, which must be large enough for either of them.
+        ring->sq_length = ring->sq_length > ring->cq_length ? ring->sq_length : ring->cq_length;
+        ring->cq_length = 0;
     }
-    else
+
+    ring->sq_ring = mmap(NULL, ring->sq_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = 0 == ring->cq_length ? ring->sq_ring : mmap(NULL, ring->cq_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqes_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if (MAP_FAILED == ring->sq_ring || MAP_FAILED == ring->cq_ring || MAP_FAILED == (void*) ring->sqes)
     {
-        {{NAME}}_valuesToArray(self, array, size);
-        return array;
+        if (MAP_FAILED != ring->sq_ring)
+        {
+            munmap(ring->sq_ring, ring->sq_length);
+        }
+
+        if (0 != ring->cq_length && MAP_FAILED != ring->cq_ring)
+        {
+            munmap(ring->cq_ring, ring->cq_length);
+        }
+
+        if (MAP_FAILED != (void*) ring->sqes)
+        {
+            munmap(ring->sqes, ring->sqes_length);
+        }
+
+        close(ring->fd);
+        ring->fd = -1;
+        return false;
     }
+
+    unsigned char* sq = (unsigned char*) ring->sq_ring;
+    unsigned char* cq = (unsigned char*) ring->cq_ring;
+    ring->sq_head = (unsigned*) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return true;
 }
 
-/**
- * @brief Reduces tree elements to a double value using a provided function.
- * @param self Pointer to the AVL tree.
- * @param functor Function for reduction.
- * @param initial Initial value for reduction.
- * @param context Additional context passed to the functor.
- * @return Reduced double value.
- */
-double {{NAME}}_reduceToDouble ({{NAME}}_t* self, double (*functor)({{NAME}}_t*, {{NAME}}_node_t*, double, void*), double initial, void* context)
+static void disk_ring_teardown ({{NAME}}_disk_ring_t* ring)
 {
-    double result = initial;
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    if (ring->fd >= 0)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        munmap(ring->sqes, ring->sqes_length);
+
+        if (0 != ring->cq_length)
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            result = functor(self, node, result, context);
+            munmap(ring->cq_ring, ring->cq_length);
         }
+
+        munmap(ring->sq_ring, ring->sq_length);
+        close(ring->fd);
+        ring->fd = -1;
     }
-    {{NAME}}_iter_free(&iter);
-    return result;
 }
 
 /**
- * @brief Reduces tree elements to an int64 value using a provided function.
- * @param self Pointer to the AVL tree.
- * @param functor Function for reduction.
- * @param initial Initial value for reduction.
- * @param context Additional context passed to the functor.
- * @return Reduced int64 value.
+ * Reads a batch of pages using io_uring, while keeping at most a ring full of reads in flight.
+ * Returns false if the ring failed, in which case the reads, which are not done, must be retried otherwise.
  */
-int64_t {{NAME}}_reduceToInt64 ({{NAME}}_t* self, int64_t (*functor)({{NAME}}_t*, {{NAME}}_node_t*, int64_t, void*), int64_t initial, void* context)
+static bool disk_ring_read ({{NAME}}_disk_t* self, {{NAME}}_disk_read_t* jobs, size_t count)
 {
-    int64_t result = initial;
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {{NAME}}_disk_ring_t* ring = &self->ring;
+    size_t submitted = 0;
+    size_t completed = 0;
+
+    while (completed < count)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        unsigned tail = *ring->sq_tail;
+
+        while (submitted < count && submitted - completed < ring->entries)
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            result = functor(self, node, result, context);
+            const unsigned index = tail & *ring->sq_mask;
+            struct io_uring_sqe* sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(struct io_uring_sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = self->fd;
+            sqe->addr = (uint64_t) (uintptr_t) (self->data + jobs[submitted].frame * DISK_PAGE_SIZE);
+            sqe->len = DISK_PAGE_SIZE;
+            sqe->off = jobs[submitted].page * DISK_PAGE_SIZE;
+            sqe->user_data = submitted;
+            ring->sq_array[index] = index;
+            ++tail;
+            ++submitted;
+        }
+
+        // The kernel sees the entries, once it sees the new tail.
+        atomic_store_explicit((_Atomic unsigned*) ring->sq_tail, tail, memory_order_release);
+
+        // Entries, which an interrupted call did not consume, are submitted again.
+        const unsigned unconsumed = tail - atomic_load_explicit((_Atomic unsigned*) ring->sq_head, memory_order_acquire);
+        const long rc = syscall(__NR_io_uring_enter, ring->fd, unconsumed, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        if (rc < 0 && EINTR != errno && EAGAIN != errno && EBUSY != errno)
+        {
+            return false;
         }
+
+        unsigned head = *ring->cq_head;
+
+        while (head != atomic_load_explicit((_Atomic unsigned*) ring->cq_tail, memory_order_acquire))
+        {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            jobs[cqe->user_data].ok = DISK_PAGE_SIZE == cqe->res;
+            jobs[cqe->user_data].done = true;
+            ++completed;
+            ++head;
+        }
+
+        atomic_store_explicit((_Atomic unsigned*) ring->cq_head, head, memory_order_release);
     }
-    {{NAME}}_iter_free(&iter);
-    return result;
+
+    return true;
 }
+{% end %}
 
-/**
- * @brief Sums tree elements to a double value using a provided function.
- * @param self Pointer to the AVL tree.
- * @param functor Function for summation.
- * @param context Additional context passed to the functor.
- * @return Sum as a double value.
- */
-double {{NAME}}_sumToDouble ({{NAME}}_t* self, double (*functor)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+static void* disk_reader_main (void* argument)
 {
-    double result = 0;
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    {{NAME}}_disk_t* self = ({{NAME}}_disk_t*) argument;
+
+    pthread_mutex_lock(&self->read_mutex);
+
+    while (true)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        while (false == self->read_stopping && self->read_next >= self->read_count)
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            result += functor(self, node, context);
+            pthread_cond_wait(&self->read_start, &self->read_mutex);
+        }
+
+        if (self->read_stopping)
+        {
+            break;
+        }
+
+        {{NAME}}_disk_read_t* job = &self->read_jobs[self->read_next++];
+        pthread_mutex_unlock(&self->read_mutex);
+
+        job->ok = DISK_PAGE_SIZE == pread(self->fd, self->data + job->frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (job->page * DISK_PAGE_SIZE));
+        job->done = true;
+
+        pthread_mutex_lock(&self->read_mutex);
+
+        if (0 == --self->read_pending)
+        {
+            pthread_cond_signal(&self->read_done);
         }
     }
-    {{NAME}}_iter_free(&iter);
-    return result;
+
+    pthread_mutex_unlock(&self->read_mutex);
+    return NULL;
 }
 
 /**
- * @brief Sums tree elements to an int64 value using a provided function.
- * @param self Pointer to the AVL tree.
- * @param functor Function for summation.
- * @param context Additional context passed to the functor.
- * @return Sum as an int64 value.
+ * Reads a batch of pages using the pool of reader threads, which is started on first use.
  */
-int64_t {{NAME}}_sumToInt64 ({{NAME}}_t* self, int64_t (*functor)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+static void disk_pool_read ({{NAME}}_disk_t* self, {{NAME}}_disk_read_t* jobs, size_t count)
 {
-    int64_t result = 0;
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    pthread_mutex_lock(&self->read_mutex);
+
+    while (self->reader_count < DISK_READERS && 0 == pthread_create(&self->readers[self->reader_count], NULL, &disk_reader_main, self))
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        ++self->reader_count;
+    }
+
+    if (0 == self->reader_count)
+    {
+        // Without any threads, the reads are simply done one after another.
+        pthread_mutex_unlock(&self->read_mutex);
+
+        for (size_t i = 0; i < count; i++)
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            result += functor(self, node, context);
+            jobs[i].ok = DISK_PAGE_SIZE == pread(self->fd, self->data + jobs[i].frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (jobs[i].page * DISK_PAGE_SIZE));
+            jobs[i].done = true;
         }
+
+        return;
     }
-    {{NAME}}_iter_free(&iter);
-    return result;
+
+    self->read_jobs = jobs;
+    self->read_count = count;
+    self->read_next = 0;
+    self->read_pending = count;
+    pthread_cond_broadcast(&self->read_start);
+
+    while (self->read_pending > 0)
+    {
+        pthread_cond_wait(&self->read_done, &self->read_mutex);
+    }
+
+    self->read_jobs = NULL;
+    self->read_count = 0;
+    self->read_next = 0;
+    pthread_mutex_unlock(&self->read_mutex);
 }
 
-/**
- * @brief Puts all elements from another tree into this tree.
- * @param self Pointer to the current AVL tree.
- * @param other Pointer to the other AVL tree.
- * @return true if all elements were successfully added, false otherwise.
- */
-bool {{NAME}}_putAll ({{NAME}}_t* self, {{NAME}}_t* other)
+static void disk_read_batch ({{NAME}}_disk_t* self, {{NAME}}_disk_read_t* jobs, size_t count)
 {
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(other);
+    ++self->stats.batches;
+{% if IO_URING %}
+
+    if (self->use_ring)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        if (false == disk_ring_read(self, jobs, count))
         {
-            {{NAME}}_iter_next(&iter);
-
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            // The ring is not used again, and the reads, which are not done, are repeated synchronously.
+            self->use_ring = false;
 
-            if ({{NAME}}_put(self, node->key, node->value) == false)
+            for (size_t i = 0; i < count; i++)
             {
-                return false;
+                if (false == jobs[i].done)
+                {
+                    jobs[i].ok = DISK_PAGE_SIZE == pread(self->fd, self->data + jobs[i].frame * DISK_PAGE_SIZE, DISK_PAGE_SIZE, (off_t) (jobs[i].page * DISK_PAGE_SIZE));
+                    jobs[i].done = true;
+                }
             }
         }
+
+        return;
     }
-    {{NAME}}_iter_free(&iter);
-    return true;
+{% end %}
+
+    disk_pool_read(self, jobs, count);
 }
 
 /**
- * @brief Removes all elements that exist in another tree from this tree.
- * @param self Pointer to the current AVL tree.
- * @param other Pointer to the other AVL tree.
+ * Pins the distinct pages of a batch in the cache, after reading the missing ones together.
+ * The pinned slots are recorded, so that they can be released after the batch. A page,
+ * which could not be cached or read, is simply left out.
  */
-void {{NAME}}_removeAll ({{NAME}}_t* self, {{NAME}}_t* other)
+static size_t disk_prefetch ({{NAME}}_disk_t* self, uint64_t* pages, size_t count, {{NAME}}_disk_read_t* jobs, size_t* pinned)
 {
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(other);
+    const uint64_t batch = ++self->batch;
+    size_t pinned_count = 0;
+    size_t job_count = 0;
+
+    for (size_t i = 0; i < count; i++)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        if (0 == pages[i])
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            {{NAME}}_remove(self, node->key);
+            continue;
         }
-    }
-    {{NAME}}_iter_free(&iter);
-}
 
-/**
- * @brief Retains only elements that exist in another tree.
- * @param self Pointer to the current AVL tree.
- * @param other Pointer to the other AVL tree.
- */
-void {{NAME}}_retainAll ({{NAME}}_t* self, {{NAME}}_t* other)
-{
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
-    {
-        while ({{NAME}}_iter_hasNext(&iter))
+        const size_t slot = disk_slot(self, pages[i]);
+        size_t frame;
+
+        if (0 != self->table[slot])
         {
-            {{NAME}}_iter_next(&iter);
+            frame = self->table[slot] - 1;
 
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
+            if (batch == self->frames[frame].batch)
+            {
+                continue;
+            }
+
+            ++self->frames[frame].pins;
+            self->frames[frame].referenced = true;
+            ++self->stats.hits;
+        }
+        else
+        {
+            ++self->stats.misses;
 
-            if ({{NAME}}_containsKey(other, node->key) == false)
+            if (false == disk_victim(self, &frame))
             {
-                {{NAME}}_iter_next(&iter);
-                {{NAME}}_remove(self, node->key);
+                continue;
             }
+
+            self->table[disk_slot(self, pages[i])] = (uint32_t) frame + 1;
+            self->frames[frame].page = pages[i];
+            self->frames[frame].pins = 1;
+            self->frames[frame].dirty = false;
+            self->frames[frame].referenced = true;
+
+            jobs[job_count].page = pages[i];
+            jobs[job_count].frame = frame;
+            jobs[job_count].done = false;
+            jobs[job_count].ok = false;
+            ++job_count;
         }
-    }
-    {{NAME}}_iter_free(&iter);
-}
 
-/**
- * @brief Inserts a key-value pair into the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to insert.
- * @param value Data value to associate with the key.
- * @return true if insertion was successful, false otherwise.
- */
-bool {{NAME}}_put ({{NAME}}_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
-{
-    {{NAME}}_node_t* node = {{NAME}}_putNode(self, key);
+        self->frames[frame].batch = batch;
+        pinned[pinned_count++] = frame;
+    }
 
-    if (NULL == node)
+    if (job_count > 0)
     {
-        return false;
+        disk_read_batch(self, jobs, job_count);
     }
-    else
+
+    for (size_t i = 0; i < job_count; i++)
     {
-        node->value = value;
-        return true;
+        if (jobs[i].ok)
+        {
+            ++self->stats.reads;
+        }
+        else
+        {
+            // The slot becomes free again, which the release after the batch skips.
+            self->failed = true;
+            disk_unmap(self, jobs[i].page);
+            self->frames[jobs[i].frame].page = 0;
+            self->frames[jobs[i].frame].pins = 0;
+        }
     }
+
+    return pinned_count;
 }
 
 /**
- * @brief Retrieves the value associated with a key in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to search for.
- * @return The associated value or default value if key not found.
+ * @brief Opens a disk tree using the natural ordering of keys, and creates the file if it does not exist yet.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
  */
-{{VALUE_TYPE}} {{NAME}}_get ({{NAME}}_t* self, {{KEY_TYPE}} key)
-{
-    {{NAME}}_node_t* node = {{NAME}}_getNode(self, key);
-
-    if (NULL == node)
-    {
-        return {{NAME}}_defaultValue();
-    }
-    else
-    {
-        return node->value;
-    }
+{{NAME}}_disk_t* {{NAME}}_disk_open (const char* path, size_t cache_pages)
+{
+    return {{NAME}}_disk_make(path, cache_pages, &{{NAME}}_naturalOrder);
 }
 
 /**
- * @brief Removes a key and its value from the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to remove.
+ * @brief Opens a disk tree with a specified comparator, which must be the same every time the file is opened.
+ * @param path Path of the file.
+ * @param cache_pages Number of pages (of 4096 bytes) that the cache holds, which is at least eight.
+ * @param comparator Function pointer for key comparison, which is invoked with NULL as its tree argument.
+ * @return Pointer to the opened disk tree or NULL if the file could not be opened or is not a compatible disk tree.
  */
-void {{NAME}}_remove ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{{NAME}}_disk_t* {{NAME}}_disk_make (const char* path, size_t cache_pages, {{NAME}}_comparator_t comparator)
 {
-    {{NAME}}_node_t* deleted = NULL;
-    self->root = delete_node(self, self->root, &key, &deleted);
+    const size_t leaf_entry = sizeof({{KEY_TYPE}}) + sizeof({{VALUE_TYPE}});
+    const size_t inner_entry = sizeof({{KEY_TYPE}}) + sizeof(uint64_t);
+    const size_t usable = DISK_PAGE_SIZE - sizeof({{NAME}}_disk_page_t) - 2 * sizeof(uint64_t);
 
-    if (NULL != deleted)
+    // Both kinds of pages must hold at least four entries, and the cache must fit in the hash table.
+    if (usable / leaf_entry < 4 || usable / inner_entry < 4 || cache_pages >= UINT32_MAX / 2)
     {
-        self->allocator->release(self->allocator, deleted);
-        --self->size;
+        return NULL;
     }
-}
 
-/**
- * @brief Removes the first value in the AVL tree.
- * @param self Pointer to the AVL tree.
- */
-void {{NAME}}_removeFirst ({{NAME}}_t* self)
-{
-    {{NAME}}_node_t* node = {{NAME}}_firstNode(self);
+    {{NAME}}_disk_t* self = ({{NAME}}_disk_t*) calloc(1, sizeof({{NAME}}_disk_t));
 
-    if (NULL != node)
+    if (NULL == self)
     {
-        {{NAME}}_remove(self, node->key);
+        return NULL;
     }
-}
 
-/**
- * @brief Removes the last value in the AVL tree.
- * @param self Pointer to the AVL tree.
- */
-void {{NAME}}_removeLast ({{NAME}}_t* self)
-{
-    {{NAME}}_node_t* node = {{NAME}}_lastNode(self);
+    self->comparator = comparator;
+    pthread_mutex_init(&self->read_mutex, NULL);
+    pthread_cond_init(&self->read_start, NULL);
+    pthread_cond_init(&self->read_done, NULL);
+    self->leaf_capacity = usable / leaf_entry;
+    self->inner_capacity = usable / inner_entry - 1;
+    self->values_offset = disk_align(sizeof({{NAME}}_disk_page_t) + self->leaf_capacity * sizeof({{KEY_TYPE}}), sizeof(uint64_t));
+    self->children_offset = disk_align(sizeof({{NAME}}_disk_page_t) + self->inner_capacity * sizeof({{KEY_TYPE}}), sizeof(uint64_t));
+    self->frame_count = cache_pages < DISK_MIN_CACHE_PAGES ? DISK_MIN_CACHE_PAGES : cache_pages;
 
-    if (NULL != node)
+    size_t table_size = 2;
+    self->table_shift = 63;
+
+    while (table_size < 2 * self->frame_count)
     {
-        {{NAME}}_remove(self, node->key);
+        table_size *= 2;
+        --self->table_shift;
+    }
+
+    self->table_mask = table_size - 1;
+    self->frames = ({{NAME}}_disk_frame_t*) calloc(self->frame_count, sizeof({{NAME}}_disk_frame_t));
+    self->table = (uint32_t*) calloc(table_size, sizeof(uint32_t));
+    self->data = (unsigned char*) aligned_alloc(DISK_PAGE_SIZE, self->frame_count * DISK_PAGE_SIZE);
+    self->fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    struct stat info;
+    bool ok = NULL != self->frames && NULL != self->table && NULL != self->data && self->fd >= 0 && 0 == fstat(self->fd, &info);
+
+    if (ok && 0 == info.st_size)
+    {
+        // A new file starts with just the header page.
+        memcpy(self->header.magic, DISK_MAGIC, sizeof(self->header.magic));
+        self->header.version = DISK_VERSION;
+        self->header.byte_order = SNAPSHOT_BYTE_ORDER;
+        self->header.key_size = (uint32_t) sizeof({{KEY_TYPE}});
+        self->header.value_size = (uint32_t) sizeof({{VALUE_TYPE}});
+        self->header.page_size = DISK_PAGE_SIZE;
+        self->header.page_count = 1;
+
+        ok = 0 == ftruncate(self->fd, DISK_PAGE_SIZE) && {{NAME}}_disk_flush(self);
+    }
+    else if (ok)
+    {
+        ok = sizeof({{NAME}}_disk_header_t) == pread(self->fd, &self->header, sizeof({{NAME}}_disk_header_t), 0);
+        ok = ok && 0 == memcmp(self->header.magic, DISK_MAGIC, sizeof(self->header.magic));
+        ok = ok && DISK_VERSION == self->header.version;
+        ok = ok && SNAPSHOT_BYTE_ORDER == self->header.byte_order;
+        ok = ok && sizeof({{KEY_TYPE}}) == self->header.key_size;
+        ok = ok && sizeof({{VALUE_TYPE}}) == self->header.value_size;
+        ok = ok && DISK_PAGE_SIZE == self->header.page_size;
+        ok = ok && (uint64_t) info.st_size >= self->header.page_count * DISK_PAGE_SIZE;
+    }
+
+    if (false == ok)
+    {
+        if (self->fd >= 0)
+        {
+            close(self->fd);
+        }
+
+        pthread_mutex_destroy(&self->read_mutex);
+        pthread_cond_destroy(&self->read_start);
+        pthread_cond_destroy(&self->read_done);
+        free(self->frames);
+        free(self->table);
+        free(self->data);
+        free(self);
+        return NULL;
     }
+{% if IO_URING %}
+
+    self->use_ring = disk_ring_setup(&self->ring);
+{% end %}
+
+    return self;
 }
 
 /**
- * @brief Removes nodes from the tree based on a predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
+ * @brief Writes all dirty pages and the header to the file, and then syncs the file.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
  */
-void {{NAME}}_removeIf ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+bool {{NAME}}_disk_flush ({{NAME}}_disk_t* self)
 {
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    for (size_t frame = 0; frame < self->frame_count; frame++)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        if (0 != self->frames[frame].page && self->frames[frame].dirty)
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            if (predicate(self, node, context))
-            {
-                {{NAME}}_iter_next(&iter);
-                {{NAME}}_remove(self, node->key);
-            }
+            disk_write_page(self, frame);
         }
     }
-    {{NAME}}_iter_free(&iter);
+
+    const ssize_t written = pwrite(self->fd, &self->header, sizeof({{NAME}}_disk_header_t), 0);
+    self->failed = self->failed || sizeof({{NAME}}_disk_header_t) != written || 0 != fsync(self->fd);
+    return false == self->failed;
 }
 
 /**
- * @brief Applies a function to each node in the AVL tree.
- * @param self Pointer to the AVL tree.
- * @param functor Function to apply to each node.
- * @param context Additional context passed to the functor.
+ * @brief Flushes a disk tree, closes its file, and frees its resources.
+ * @param self Pointer to the disk tree.
+ * @return true if the file is up to date, false if an I/O error occurred at any point.
  */
-void {{NAME}}_forEach ({{NAME}}_t* self, void (*functor)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+bool {{NAME}}_disk_close ({{NAME}}_disk_t* self)
 {
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    if (NULL == self)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
-        {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            functor(self, node, context);
-        }
+        return true;
     }
-    {{NAME}}_iter_free(&iter);
+
+    const bool ok = {{NAME}}_disk_flush(self);
+
+    pthread_mutex_lock(&self->read_mutex);
+    self->read_stopping = true;
+    pthread_cond_broadcast(&self->read_start);
+    pthread_mutex_unlock(&self->read_mutex);
+
+    for (size_t i = 0; i < self->reader_count; i++)
+    {
+        pthread_join(self->readers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&self->read_mutex);
+    pthread_cond_destroy(&self->read_start);
+    pthread_cond_destroy(&self->read_done);
+{% if IO_URING %}
+    disk_ring_teardown(&self->ring);
+{% end %}
+    close(self->fd);
+    free(self->frames);
+    free(self->table);
+    free(self->data);
+    free(self);
+    return ok;
 }
 
 /**
- * @brief Checks if any nodes match the given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return true if any match found, false otherwise.
+ * @brief Retrieves the number of entries in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Number of entries in the disk tree.
  */
-bool {{NAME}}_anyMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+size_t {{NAME}}_disk_size ({{NAME}}_disk_t* self)
 {
-    return {{NAME}}_count(self, predicate, context) > 0;
+    return (size_t) self->header.count;
 }
 
 /**
- * @brief Checks if all nodes match the given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return true if all nodes match, false otherwise.
+ * @brief Retrieves the value associated with a key in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return The associated value or default value if key not found (or if the page could not be read).
  */
-bool {{NAME}}_allMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+{{VALUE_TYPE}} {{NAME}}_disk_get ({{NAME}}_disk_t* self, {{KEY_TYPE}} key)
 {
-    size_t size = {{NAME}}_size(self);
-    return {{NAME}}_count(self, predicate, context) == size;
+    {{VALUE_TYPE}} value;
+    return disk_lookup(self, &key, &value) ? value : {{NAME}}_defaultValue();
 }
 
 /**
- * @brief Checks if none of the nodes match the given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return true if none match, false otherwise.
+ * @brief Checks if a key exists in a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to search for.
+ * @return true if the key exists, false otherwise.
  */
-bool {{NAME}}_noneMatch ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+bool {{NAME}}_disk_containsKey ({{NAME}}_disk_t* self, {{KEY_TYPE}} key)
 {
-    return {{NAME}}_count(self, predicate, context) == 0;
+    return disk_lookup(self, &key, NULL);
 }
 
 /**
- * @brief Counts the number of nodes matching a given predicate.
- * @param self Pointer to the AVL tree.
- * @param predicate Function pointer to the predicate to evaluate.
- * @param context Additional context passed to the predicate.
- * @return Count of nodes matching the predicate.
+ * @brief Retrieves the values associated with many keys in a disk tree, reading the missing pages in batches.
+ * @param self Pointer to the disk tree.
+ * @param keys Keys to search for, in any order.
+ * @param values Array that receives the associated values (or the default value for keys that are not found).
+ * @param found Optional array that receives whether each key was found, or NULL.
+ * @param count Number of keys.
+ * @return Number of keys that were found.
  */
-size_t {{NAME}}_count ({{NAME}}_t* self, bool (*predicate)({{NAME}}_t*, {{NAME}}_node_t*, void*), void* context)
+size_t {{NAME}}_disk_getMany ({{NAME}}_disk_t* self, {{KEY_TYPE}}* keys, {{VALUE_TYPE}}* values, bool* found, size_t count)
 {
-    size_t count = 0;
-    {{NAME}}_iterator_t iter = {{NAME}}_iter(self);
+    size_t window = self->frame_count / 4;
+    window = window < DISK_BATCH ? window : DISK_BATCH;
+
+    uint64_t* pages = (uint64_t*) malloc(window * sizeof(uint64_t));
+    size_t* pinned = (size_t*) malloc(window * sizeof(size_t));
+    {{NAME}}_disk_read_t* jobs = ({{NAME}}_disk_read_t*) malloc(window * sizeof({{NAME}}_disk_read_t));
+    size_t result = 0;
+
+    if (NULL == pages || NULL == pinned || NULL == jobs)
     {
-        while ({{NAME}}_iter_hasNext(&iter))
+        // Without memory for the batches, the keys are looked up one by one.
+        for (size_t i = 0; i < count; i++)
         {
-            {{NAME}}_iter_next(&iter);
-            {{NAME}}_node_t* node = {{NAME}}_iter_node(&iter);
-            if (predicate(self, node, context))
+            const bool hit = disk_lookup(self, &keys[i], &values[i]);
+            values[i] = hit ? values[i] : {{NAME}}_defaultValue();
+            result += hit;
+
+            if (NULL != found)
             {
-                ++count;
+                found[i] = hit;
             }
         }
+
+        free(pages);
+        free(pinned);
+        free(jobs);
+        return result;
     }
-    {{NAME}}_iter_free(&iter);
-    return count;
-}
 
-/**
- * @brief Checks if two trees are equal based on a comparison predicate.
- * @param self Pointer to the first AVL tree.
- * @param other Pointer to the second AVL tree.
- * @param predicate Function pointer for node comparison.
- * @param context Additional context passed to the predicate.
- * @return true if the trees are equal, false otherwise.
- */
-bool {{NAME}}_isEqual ({{NAME}}_t* self, {{NAME}}_t* other, bool (*predicate)({{NAME}}_node_t*, {{NAME}}_node_t*, void*), void* context)
-{
-    if ({{NAME}}_size(self) != {{NAME}}_size(other))
+    for (size_t i = 0; i < count; i++)
     {
-        return false;
+        values[i] = {{NAME}}_defaultValue();
+
+        if (NULL != found)
+        {
+            found[i] = false;
+        }
     }
 
-    {{NAME}}_iterator_t iterX = {{NAME}}_iter(self);
+    for (size_t base = 0; base < count && 0 != self->header.root; base += window)
     {
-        {{NAME}}_iterator_t iterY = {{NAME}}_iter(other);
+        const size_t n = count - base < window ? count - base : window;
+
+        for (size_t i = 0; i < n; i++)
         {
-            while ({{NAME}}_iter_hasNext(&iterX))
+            pages[i] = self->header.root;
+        }
+
+        // Every level of the tree is a batch, since all of the leaves are equally deep.
+        for (uint32_t level = 0; level < self->header.height; level++)
+        {
+            const size_t pinned_count = disk_prefetch(self, pages, n, jobs, pinned);
+
+            for (size_t i = 0; i < n; i++)
             {
-                {{NAME}}_iter_next(&iterX);
-                {{NAME}}_iter_next(&iterY);
+                const size_t slot = 0 == pages[i] ? 0 : disk_slot(self, pages[i]);
 
-                {{NAME}}_node_t* nodeX = {{NAME}}_iter_node(&iterX);
-                {{NAME}}_node_t* nodeY = {{NAME}}_iter_node(&iterY);
+                if (0 == pages[i] || 0 == self->table[slot])
+                {
+                    // The page could not be read.
+                    pages[i] = 0;
+                    continue;
+                }
 
-                if (predicate(nodeX, nodeY, context) == false)
+                {{NAME}}_disk_page_t* page = ({{NAME}}_disk_page_t*) (self->data + (self->table[slot] - 1) * DISK_PAGE_SIZE);
+
+                if (DISK_INNER == page->kind)
                 {
-                    return false;
+                    pages[i] = disk_children(self, page)[disk_search(self, page, &keys[base + i], true)];
+                    continue;
+                }
+
+                const size_t index = disk_search(self, page, &keys[base + i], false);
+
+                if (index < page->count && 0 == self->comparator(NULL, &disk_keys(page)[index], &keys[base + i]))
+                {
+                    values[base + i] = disk_values(self, page)[index];
+                    ++result;
+
+                    if (NULL != found)
+                    {
+                        found[base + i] = true;
+                    }
+                }
+
+                pages[i] = 0;
+            }
+
+            for (size_t i = 0; i < pinned_count; i++)
+            {
+                if (0 != self->frames[pinned[i]].page)
+                {
+                    --self->frames[pinned[i]].pins;
                 }
             }
         }
-        {{NAME}}_iter_free(&iterY);
     }
-    {{NAME}}_iter_free(&iterX);
+
+    free(pages);
+    free(pinned);
+    free(jobs);
+    return result;
+}
+
+/**
+ * @brief Inserts a key-value pair into a disk tree, or replaces the value of an existing key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to insert.
+ * @param value Data value to associate with the key.
+ * @return true if insertion was successful, false if a page could not be read, written, or cached.
+ */
+bool {{NAME}}_disk_put ({{NAME}}_disk_t* self, {{KEY_TYPE}} key, {{VALUE_TYPE}} value)
+{
+    {{NAME}}_disk_page_t* leaf = disk_prepare_leaf(self, &key);
+
+    if (NULL == leaf)
+    {
+        return false;
+    }
+
+    {{KEY_TYPE}}* keys = disk_keys(leaf);
+    {{VALUE_TYPE}}* values = disk_values(self, leaf);
+    const size_t index = disk_search(self, leaf, &key, false);
+
+    if (index == leaf->count || 0 != self->comparator(NULL, &keys[index], &key))
+    {
+        memmove(keys + index + 1, keys + index, (leaf->count - index) * sizeof({{KEY_TYPE}}));
+        memmove(values + index + 1, values + index, (leaf->count - index) * sizeof({{VALUE_TYPE}}));
+        keys[index] = key;
+        ++leaf->count;
+        ++self->header.count;
+    }
+
+    values[index] = value;
+    disk_release(self, leaf, true);
     return true;
 }
 
 /**
- * @brief Creates an iterator for the AVL tree.
- * @param self Pointer to the AVL tree.
- * @return Iterator structure for the tree.
+ * @brief Removes a key from a disk tree.
+ * @param self Pointer to the disk tree.
+ * @param key Key to remove.
+ * @return true if the key was removed, false if it was not found (or if a page could not be read).
  */
-{{NAME}}_iterator_t {{NAME}}_iter ({{NAME}}_t* self)
+bool {{NAME}}_disk_remove ({{NAME}}_disk_t* self, {{KEY_TYPE}} key)
 {
-    return {{NAME}}_iter_atNode(self, NULL);
+    {{NAME}}_disk_page_t* leaf = disk_find_leaf(self, &key);
+
+    if (NULL == leaf)
+    {
+        return false;
+    }
+
+    {{KEY_TYPE}}* keys = disk_keys(leaf);
+    {{VALUE_TYPE}}* values = disk_values(self, leaf);
+    const size_t index = disk_search(self, leaf, &key, false);
+    const bool found = index < leaf->count && 0 == self->comparator(NULL, &keys[index], &key);
+
+    if (found)
+    {
+        memmove(keys + index, keys + index + 1, (leaf->count - index - 1) * sizeof({{KEY_TYPE}}));
+        memmove(values + index, values + index + 1, (leaf->count - index - 1) * sizeof({{VALUE_TYPE}}));
+        --leaf->count;
+        --self->header.count;
+    }
+
+    disk_release(self, leaf, found);
+    return found;
 }
 
 /**
- * @brief Creates an iterator starting at a specific key in the tree.
- * @param self Pointer to the AVL tree.
- * @param key Key to start the iteration at.
- * @return Iterator structure for the tree starting at the given key.
+ * @brief Creates an iterator, which starts before the first entry of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Iterator over the entries in ascending order of keys.
  */
-{{NAME}}_iterator_t {{NAME}}_iter_at ({{NAME}}_t* self, {{KEY_TYPE}} key)
+{{NAME}}_disk_iterator_t {{NAME}}_disk_iter ({{NAME}}_disk_t* self)
 {
-    {{NAME}}_node_t* node = find_node(self, self->root, &key);
-    return {{NAME}}_iter_atNode(self, node);
+    {{NAME}}_disk_iterator_t iter;
+    memset(&iter, 0, sizeof(iter));
+    iter.owner = self;
+    iter.page = self->header.first_leaf;
+    disk_iter_settle(&iter);
+    return iter;
 }
 
 /**
- * @brief Creates an iterator starting at a specific node in the tree.
- * @param self Pointer to the AVL tree.
- * @param node Node to start the iteration at.
- * @return Iterator structure for the tree starting at the given node.
+ * @brief Creates an iterator, which starts before the first entry, whose key is not less than a given key.
+ * @param self Pointer to the disk tree.
+ * @param key Key to start at.
+ * @return Iterator over the remaining entries in ascending order of keys.
  */
-{{NAME}}_iterator_t {{NAME}}_iter_atNode ({{NAME}}_t* self, {{NAME}}_node_t* node)
+{{NAME}}_disk_iterator_t {{NAME}}_disk_iter_at ({{NAME}}_disk_t* self, {{KEY_TYPE}} key)
 {
-    {{NAME}}_iterator_t result;
-    result.owner = self;
-    result.node = node;
-    return result;
+    {{NAME}}_disk_iterator_t iter;
+    memset(&iter, 0, sizeof(iter));
+    iter.owner = self;
+
+    {{NAME}}_disk_page_t* leaf = disk_find_leaf(self, &key);
+
+    if (NULL != leaf)
+    {
+        iter.page = disk_number_of(self, leaf);
+        iter.index = disk_search(self, leaf, &key, false);
+        disk_release(self, leaf, false);
+        disk_iter_settle(&iter);
+    }
+
+    return iter;
 }
 
 /**
- * @brief Frees the resources associated with a tree iterator.
- * @param self Pointer to the tree iterator to free.
+ * @brief Checks if there are more entries to iterate over.
+ * @param self Pointer to the iterator.
+ * @return true if there is a next entry, false otherwise.
  */
-void {{NAME}}_iter_free ({{NAME}}_iterator_t* self)
+bool {{NAME}}_disk_iter_hasNext ({{NAME}}_disk_iterator_t* self)
 {
-    if (NULL != self)
+    return 0 != self->page;
+}
+
+/**
+ * @brief Moves the iterator to the next entry, and copies that entry into the iterator.
+ * @param self Pointer to the iterator.
+ */
+void {{NAME}}_disk_iter_next ({{NAME}}_disk_iterator_t* self)
+{
+    if (0 == self->page)
     {
-        self->owner = NULL;
-        self->node = NULL;
+        return;
+    }
+
+    {{NAME}}_disk_page_t* leaf = disk_fetch(self->owner, self->page, false);
+
+    if (NULL == leaf)
+    {
+        self->page = 0;
+        return;
     }
+
+    self->key = disk_keys(leaf)[self->index];
+    self->value = disk_values(self->owner, leaf)[self->index];
+    ++self->index;
+    disk_release(self->owner, leaf, false);
+    disk_iter_settle(self);
+}
+
+/**
+ * @brief Retrieves the key of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Key of the current entry.
+ */
+{{KEY_TYPE}} {{NAME}}_disk_iter_key ({{NAME}}_disk_iterator_t* self)
+{
+    return self->key;
+}
+
+/**
+ * @brief Retrieves the data value of the current entry of the iterator.
+ * @param self Pointer to the iterator.
+ * @return Data value of the current entry.
+ */
+{{VALUE_TYPE}} {{NAME}}_disk_iter_get ({{NAME}}_disk_iterator_t* self)
+{
+    return self->value;
 }
 
 /**
- * @brief Checks if the iterator has a next element.
- * @param self Pointer to the tree iterator.
- * @return true if there is a next element, false otherwise.
+ * @brief Retrieves the counters of the page cache of a disk tree.
+ * @param self Pointer to the disk tree.
+ * @return Copy of the counters.
  */
-bool {{NAME}}_iter_hasNext ({{NAME}}_iterator_t* self)
+{{NAME}}_disk_stats_t {{NAME}}_disk_stats ({{NAME}}_disk_t* self)
 {
-    if ({{NAME}}_isEmpty(self->owner))
-    {
-        return false;
-    }
-    else if (NULL == self->node)
-    {
-        return true;
-    }
-    else
-    {
-        {{KEY_TYPE}} key = self->node->key;
-        return NULL != {{NAME}}_higherNode(self->owner, key);
-    }
+    {{NAME}}_disk_stats_t stats = self->stats;
+    stats.pages = self->header.page_count;
+    stats.cache_pages = self->frame_count;
+{% if IO_URING %}
+    stats.io_uring = self->use_ring;
+{% end %}
+    return stats;
 }
+{% if IO_URING %}
 
 /**
- * @brief Checks if the iterator has a previous element.
- * @param self Pointer to the tree iterator.
- * @return true if there is a previous element, false otherwise.
+ * @brief Chooses whether the batches of page reads use io_uring or the pool of threads.
+ * @param self Pointer to the disk tree.
+ * @param enabled Whether io_uring should be used, which is the default.
+ * @return true if io_uring is used from now on, false if the pool of threads is used (io_uring may be unavailable).
  */
-bool {{NAME}}_iter_hasPrev ({{NAME}}_iterator_t* self)
+bool {{NAME}}_disk_setIoUring ({{NAME}}_disk_t* self, bool enabled)
 {
-    if ({{NAME}}_isEmpty(self->owner))
-    {
-        return false;
-    }
-    else if (NULL == self->node)
-    {
-        return true;
-    }
-    else
-    {
-        {{KEY_TYPE}} key = self->node->key;
-        return NULL != {{NAME}}_lowerNode(self->owner, key);
-    }
+    self->use_ring = enabled && self->ring.fd >= 0;
+    return self->use_ring;
 }
+{% end %}
+{% end %}
 
+{% if AGGREGATE %}
 /**
- * @brief Advances the iterator to the next element.
- * @param self Pointer to the tree iterator.
+ * Aggregates the entries of a subtree, whose keys are not less than a bound, in logarithmic time.
  */
-void {{NAME}}_iter_next ({{NAME}}_iterator_t* self)
+static {{AGGREGATE_TYPE}} aggregate_above ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* bound)
 {
-    if ({{NAME}}_isEmpty(self->owner) == false)
+    {{AGGREGATE_TYPE}} result = aggregate_of(NULL);
+
+    while (NULL != node)
     {
-        if (NULL == self->node)
+        if (NULL != bound && self->comparator(self, &node->key, bound) < 0)
         {
-            self->node = {{NAME}}_firstNode(self->owner);
+            node = node->right;
+        }
+        else if (NULL == bound)
+        {
+            // The whole subtree precedes the entries, which were already aggregated.
+            {{AGGREGATE_TYPE}} subtree = aggregate_of(node);
+            return aggregate_combine(&subtree, &result);
         }
         else
         {
-            {{KEY_TYPE}} key = self->node->key;
-            self->node = {{NAME}}_higherNode(self->owner, key);
-
-            // Iterators can be circular.
-            if (NULL == self->node)
-            {
-                self->node = {{NAME}}_firstNode(self->owner);
-            }
+            // The node and its right subtree are above the bound, and precede the entries found so far.
+            {{AGGREGATE_TYPE}} entry = aggregate_entry(&node->key, &node->value);
+            {{AGGREGATE_TYPE}} right = aggregate_of(node->right);
+            {{AGGREGATE_TYPE}} part = aggregate_combine(&entry, &right);
+            result = aggregate_combine(&part, &result);
+            node = node->left;
         }
     }
+
+    return result;
 }
 
 /**
- * @brief Moves the iterator to the previous element.
- * @param self Pointer to the tree iterator.
+ * Aggregates the entries of a subtree, whose keys are less than a bound, in logarithmic time.
  */
-void {{NAME}}_iter_prev ({{NAME}}_iterator_t* self)
+static {{AGGREGATE_TYPE}} aggregate_below ({{NAME}}_t* self, {{NAME}}_node_t* node, {{KEY_TYPE}}* bound)
 {
-    if ({{NAME}}_isEmpty(self->owner) == false)
+    {{AGGREGATE_TYPE}} result = aggregate_of(NULL);
+
+    while (NULL != node)
     {
-        if (NULL == self->node)
+        if (NULL == bound)
         {
-            self->node = {{NAME}}_lastNode(self->owner);
+            // The whole subtree follows the entries, which were already aggregated.
+            {{AGGREGATE_TYPE}} subtree = aggregate_of(node);
+            return aggregate_combine(&result, &subtree);
+        }
+        else if (self->comparator(self, &node->key, bound) < 0)
+        {
+            // The left subtree and the node are below the bound, and follow the entries found so far.
+            {{AGGREGATE_TYPE}} left = aggregate_of(node->left);
+            {{AGGREGATE_TYPE}} entry = aggregate_entry(&node->key, &node->value);
+            {{AGGREGATE_TYPE}} part = aggregate_combine(&left, &entry);
+            result = aggregate_combine(&result, &part);
+            node = node->right;
         }
         else
         {
-            {{KEY_TYPE}} key = self->node->key;
-            self->node = {{NAME}}_lowerNode(self->owner, key);
-
-            // Iterators can be circular.
-            if (NULL == self->node)
-            {
-                self->node = {{NAME}}_lastNode(self->owner);
-            }
+            node = node->left;
         }
     }
-}
 
-/**
- * @brief Retrieves the current node from the iterator.
- * @param self Pointer to the tree iterator.
- * @return Pointer to the current node.
- */
-{{NAME}}_node_t* {{NAME}}_iter_node ({{NAME}}_iterator_t* self)
-{
-    return self->node;
+    return result;
 }
 
-/**
- * @brief Retrieves the key of the current node from the iterator.
- * @param self Pointer to the tree iterator.
- * @return Key of the current node.
- */
-{{KEY_TYPE}} {{NAME}}_iter_key ({{NAME}}_iterator_t* self)
+static void reaggregate_nodes ({{NAME}}_node_t* node)
 {
-    if (NULL == self->node)
-    {
-        return {{NAME}}_defaultKey();
-    }
-    else
+    if (NULL != node)
     {
-        return self->node->key;
+        reaggregate_nodes(node->left);
+        reaggregate_nodes(node->right);
+        node->aggregate = aggregate_node(node);
     }
 }
 
 /**
- * @brief Sets the data value of the current node in the iterator.
- * @param self Pointer to the tree iterator.
- * @param value Data value to set.
+ * @brief Retrieves the identity of the aggregate, which is the aggregate of an empty range.
+ * @return Identity of the combine operation.
  */
-void {{NAME}}_iter_set ({{NAME}}_iterator_t* self, {{VALUE_TYPE}} value)
+{{AGGREGATE_TYPE}} {{NAME}}_aggregateIdentity ()
 {
-    self->node->value = value;
+    return aggregate_of(NULL);
 }
 
 /**
- * @brief Retrieves the data value of the current node from the iterator.
- * @param self Pointer to the tree iterator.
- * @return Data value of the current node.
+ * @brief Retrieves the aggregate of all of the entries in the AVL tree in constant time.
+ * @param self Pointer to the AVL tree.
+ * @return Aggregate of the tree, which is the identity, if the tree is empty.
  */
-{{VALUE_TYPE}} {{NAME}}_iter_get ({{NAME}}_iterator_t* self)
+{{AGGREGATE_TYPE}} {{NAME}}_aggregate ({{NAME}}_t* self)
 {
-    if (NULL == self->node)
-    {
-        return {{NAME}}_defaultValue();
-    }
-    else
-    {
-        return self->node->value;
-    }
+    return aggregate_of(self->root);
 }
 
 /**
- * @brief Retrieves the key of a given tree node.
- * @param self Pointer to the tree node.
- * @return Key of the node.
+ * @brief Computes the aggregate of the entries, whose keys are in a half-open range, in logarithmic time.
+ * @param self Pointer to the AVL tree.
+ * @param lo Pointer to the inclusive lower bound, or NULL for no lower bound.
+ * @param hi Pointer to the exclusive upper bound, or NULL for no upper bound.
+ * @return Aggregate of the entries in the range, combined in key order.
  */
-{{KEY_TYPE}} {{NAME}}_node_key ({{NAME}}_node_t* self)
+{{AGGREGATE_TYPE}} {{NAME}}_aggregateRange ({{NAME}}_t* self, {{KEY_TYPE}}* lo, {{KEY_TYPE}}* hi)
 {
-    if (NULL == self)
-    {
-        return {{NAME}}_defaultKey();
-    }
-    else
+    // Find the highest node in the range, where the paths to the two bounds part.
+    for ({{NAME}}_node_t* node = self->root; NULL != node;)
     {
-        return self->key;
+        if (NULL != lo && self->comparator(self, &node->key, lo) < 0)
+        {
+            node = node->right;
+        }
+        else if (NULL != hi && self->comparator(self, &node->key, hi) >= 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            {{AGGREGATE_TYPE}} left = aggregate_above(self, node->left, lo);
+            {{AGGREGATE_TYPE}} entry = aggregate_entry(&node->key, &node->value);
+            {{AGGREGATE_TYPE}} right = aggregate_below(self, node->right, hi);
+            {{AGGREGATE_TYPE}} result = aggregate_combine(&left, &entry);
+            return aggregate_combine(&result, &right);
+        }
     }
-}
 
-/**
- * @brief Sets the data value of a given tree node.
- * @param self Pointer to the tree node.
- * @param value The data value to set.
- */
-void {{NAME}}_node_set ({{NAME}}_node_t* self, {{VALUE_TYPE}} value)
-{
-    self->value = value;
+    return aggregate_of(NULL);
 }
 
 /**
- * @brief Retrieves the data value of a given tree node.
- * @param self Pointer to the tree node.
- * @return Data value of the node.
+ * @brief Recomputes the aggregates of all of the subtrees in linear time.
+ * @param self Pointer to the AVL tree.
  */
-{{VALUE_TYPE}} {{NAME}}_node_get ({{NAME}}_node_t* self)
+void {{NAME}}_reaggregate ({{NAME}}_t* self)
 {
-    if (NULL == self)
-    {
-        return {{NAME}}_defaultValue();
-    }
-    else
-    {
-        return self->value;
-    }
+    reaggregate_nodes(self->root);
 }
+{% end %}
 
 {{COPYRIGHT_FOOTER}}
 '''
 
+def render (template, kwargs):
+    # A line that holds nothing but a directive must not leave an empty line behind in the generated code.
+    template = re.sub(r"^([ \t]*\{%[^\n]*%\})[ \t]*\n", r"\1", template, flags=re.MULTILINE)
+    rendered = tornado.template.Template(template).generate(**kwargs)
+    return rendered.decode("utf-8").strip()
+
 def generate_tree_map (args):
     source = pathlib.Path(args.source[0])
     source = source.resolve()
@@ -2749,10 +12451,26 @@ def generate_tree_map (args):
     kwargs["HEADER"] = header.name
     kwargs["INCLUDE_PATHS"] = args.include
     kwargs["KEY_TYPE"] = args.key_type[0]
+    kwargs["MULTIQUEUE"] = args.multiqueue
     kwargs["NAME"] = args.name[0]
+    kwargs["PARALLEL"] = args.parallel
+    kwargs["RADIX"] = args.radix
     kwargs["STRNCMP"] = args.strncmp[0]
     kwargs["VALUE_TYPE"] = args.value_type[0]
     kwargs["WIPE"] = args.wipe
+    kwargs["CONCURRENT"] = args.concurrent
+    kwargs["SERIALIZE"] = args.serialize or args.wal or args.pack_integers or args.disk or args.io_uring
+    kwargs["DISK"] = args.disk or args.io_uring
+    kwargs["IO_URING"] = args.io_uring
+    kwargs["PACK_INTEGERS"] = args.pack_integers
+    kwargs["SUBTREE_HASH"] = args.subtree_hash
+    kwargs["WAL"] = args.wal
+    kwargs["WRITE_BEHIND"] = args.write_behind
+    kwargs["AGGREGATE"] = args.aggregate_type[0] != ""
+    kwargs["AGGREGATE_TYPE"] = args.aggregate_type[0]
+    kwargs["AGGREGATE_ENTRY"] = args.aggregate_entry[0]
+    kwargs["AGGREGATE_COMBINE"] = args.aggregate_combine[0]
+    kwargs["AGGREGATE_IDENTITY"] = args.aggregate_identity[0]
     kwargs["COPYRIGHT_HEADER"] = ""
     kwargs["COPYRIGHT_FOOTER"] = ""
 
@@ -2765,18 +12483,12 @@ def generate_tree_map (args):
             kwargs["COPYRIGHT_FOOTER"] = fd.read()
 
     # Generate Header File
-    template = tornado.template.Template(TREE_TEMPLATE_H);
-    rendered = template.generate(**kwargs)
-    rendered = rendered.decode("utf-8")
-    rendered = rendered.strip()
+    rendered = render(TREE_TEMPLATE_H, kwargs)
     with open(header, 'w') as hdr_file:
         hdr_file.write(rendered)
 
     # Generate Source File
-    template = tornado.template.Template(TREE_TEMPLATE_C);
-    rendered = template.generate(**kwargs)
-    rendered = rendered.decode("utf-8")
-    rendered = rendered.strip()
+    rendered = render(TREE_TEMPLATE_C, kwargs)
     with open(source, 'w') as src_file:
         src_file.write(rendered)
 
@@ -2853,6 +12565,30 @@ def main():
     kwargs["help"]     = "generate the deque related functions"
     parser.add_argument(*name_or_flags, **kwargs)
 
+    name_or_flags      = ["--multiqueue"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "generate the relaxed concurrent priority queue (multiqueue) functions"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--parallel"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "use pthreads to generate the multithreaded bulk functions"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--radix"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "keys are integers, so use radix sort for bulk functions under the natural ordering"
+    parser.add_argument(*name_or_flags, **kwargs)
+
     name_or_flags      = ["--strncmp"]
     kwargs = { }
     kwargs["action"]   = "store"
@@ -2897,6 +12633,50 @@ def main():
     kwargs["metavar"]  = "<code>"
     parser.add_argument(*name_or_flags, **kwargs)
 
+    name_or_flags      = ["--aggregate-type"]
+    kwargs = { }
+    kwargs["action"]   = "store"
+    kwargs["nargs"]    = 1
+    kwargs["default"]  = [""]
+    kwargs["type"]     = str
+    kwargs["required"] = False
+    kwargs["help"]     = "maintain an aggregate of this datatype in every node, for range aggregates in logarithmic time"
+    kwargs["metavar"]  = "<typename>"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--aggregate-entry"]
+    kwargs = { }
+    kwargs["action"]   = "store"
+    kwargs["nargs"]    = 1
+    kwargs["default"]  = ["*V"]
+    kwargs["type"]     = str
+    kwargs["required"] = False
+    kwargs["help"]     = "use custom code for the aggregate of the entry, whose key is *K and whose value is *V"
+    kwargs["metavar"]  = "<code>"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--aggregate-combine"]
+    kwargs = { }
+    kwargs["action"]   = "store"
+    kwargs["nargs"]    = 1
+    kwargs["default"]  = ["*X + *Y"]
+    kwargs["type"]     = str
+    kwargs["required"] = False
+    kwargs["help"]     = "use custom code for the associative combination of the aggregates *X and *Y"
+    kwargs["metavar"]  = "<code>"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--aggregate-identity"]
+    kwargs = { }
+    kwargs["action"]   = "store"
+    kwargs["nargs"]    = 1
+    kwargs["default"]  = ["0"]
+    kwargs["type"]     = str
+    kwargs["required"] = False
+    kwargs["help"]     = "use custom code for the identity of the combination, such as the aggregate of no entries"
+    kwargs["metavar"]  = "<code>"
+    parser.add_argument(*name_or_flags, **kwargs)
+
     name_or_flags      = ["--wipe"]
     kwargs = { }
     kwargs["action"]   = "store_true"
@@ -2905,6 +12685,70 @@ def main():
     kwargs["help"]     = "use memset to wipe nodes on deallocation"
     parser.add_argument(*name_or_flags, **kwargs)
 
+    name_or_flags      = ["--concurrent"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "generate the concurrent tree type, which uses fine-grained locking"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--serialize"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "generate the functions that save and load binary snapshots"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--disk"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "generate the disk-backed B+ tree with a bounded page cache (implies --serialize)"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--io-uring"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "use io_uring (on Linux) for the batched page reads of the disk tree (implies --disk)"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--pack-integers"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "generate the packed snapshot functions, which require integer keys and values (implies --serialize)"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--subtree-hash"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "maintain a hash of every subtree for fast consistency checks"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--wal"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "use pthreads to generate the write-ahead log functions (implies --serialize)"
+    parser.add_argument(*name_or_flags, **kwargs)
+
+    name_or_flags      = ["--write-behind"]
+    kwargs = { }
+    kwargs["action"]   = "store_true"
+    kwargs["default"]  = False
+    kwargs["required"] = False
+    kwargs["help"]     = "use pthreads to generate the write-behind queue functions"
+    parser.add_argument(*name_or_flags, **kwargs)
+
     name_or_flags      = ["--copyright-header"]
     kwargs = { }
     kwargs["action"]   = "store"